@@ -68,6 +68,23 @@ enum PVFS_event_op
      PVFS_EVENT_TROVE_KEYVAL_REMOVE_LIST = 28,
 };
 
+/* kind of span recorded by the server request trace buffer; reported in
+ * the api field of PVFS_mgmt_event, with the server op in the operation
+ * field, the span duration (usecs) in the value field and
+ * (client id << 32 | request id) in the id field
+ */
+enum PVFS_event_trace_kind
+{
+    PVFS_EVENT_TRACE_REQUEST = 1,   /* whole request, decode to completion */
+    PVFS_EVENT_TRACE_UNEXP = 2,     /* unexpected receive and decode */
+    PVFS_EVENT_TRACE_REQ_SCHED = 3, /* waiting in the request scheduler */
+    PVFS_EVENT_TRACE_BMI = 4,       /* BMI send or receive job */
+    PVFS_EVENT_TRACE_TROVE = 5,     /* trove job */
+    PVFS_EVENT_TRACE_FLOW = 6,      /* flow job */
+    PVFS_EVENT_TRACE_JOB = 7,       /* any other job type */
+    PVFS_EVENT_TRACE_RESPONSE = 8   /* encode and send final response */
+};
+
 #endif /* __PVFS2_EVENT_H */
 
 /*
@@ -89,6 +89,11 @@ enum PINT_server_perf_keys
     PINT_PERF_IO = 20,                  /* io requests called */
     PINT_PERF_SMALL_IO = 21,            /* small_io requests called */
     PINT_PERF_READDIR = 22,             /* readdir requests called */
+    PINT_PERF_BCACHE_HITS = 23,         /* bytes read from block cache */
+    PINT_PERF_BCACHE_MISSES = 24,       /* bytes missed in block cache */
+    PINT_PERF_ATTR_CACHE_HITS = 25,     /* trove attr cache hits */
+    PINT_PERF_ATTR_CACHE_MISSES = 26,   /* trove attr cache misses */
+    PINT_PERF_ATTR_CACHE_EVICTIONS = 27,/* trove attr cache evictions */
 };
 
 /*
@@ -191,6 +191,16 @@ struct PVFS_sysresp_readdirplus_s
 };
 typedef struct PVFS_sysresp_readdirplus_s PVFS_sysresp_readdirplus;
 
+/** Holds results of a remove_subtree operation (objects removed by this
+ *  call, whether the directory is empty now).
+ */
+struct PVFS_sysresp_remove_subtree_s
+{
+    uint32_t removed;
+    int32_t complete;
+};
+typedef struct PVFS_sysresp_remove_subtree_s PVFS_sysresp_remove_subtree;
+
 
 /* truncate */
 /* no data returned in truncate response */
@@ -420,6 +430,22 @@ PVFS_error PVFS_sys_remove(
     const PVFS_credential *credential,
     PVFS_hint hints);
 
+PVFS_error PVFS_isys_remove_subtree(
+    PVFS_object_ref ref,
+    uint32_t budget,
+    const PVFS_credential *credential,
+    PVFS_sysresp_remove_subtree *resp,
+    PVFS_sys_op_id *op_id,
+    PVFS_hint hints,
+    void *user_ptr);
+
+PVFS_error PVFS_sys_remove_subtree(
+    PVFS_object_ref ref,
+    uint32_t budget,
+    const PVFS_credential *credential,
+    PVFS_sysresp_remove_subtree *resp,
+    PVFS_hint hints);
+
 PVFS_error PVFS_isys_rename(
     char *old_entry,
     PVFS_object_ref old_parent_ref,
@@ -599,15 +599,25 @@ typedef struct {
         /* local info */
         int32_t server_no; /* 0 to num_servers-1, indicates which server is running this code */
         int32_t branch_level; /* level of branching on this server */
+
+        /* global info added after the fields above; records written
+         * before it existed are shorter and read back with hash_type 0 */
+        int32_t hash_type; /* PVFS_DIST_DIR_HASH_*, maps entry names to buckets */
 } PVFS_dist_dir_attr;
-endecode_fields_6(
+endecode_fields_8(
     PVFS_dist_dir_attr,
     int32_t, tree_height,
     int32_t, num_servers,
     int32_t, bitmap_size,
     int32_t, split_size,
     int32_t, server_no,
-    int32_t, branch_level);
+    int32_t, branch_level,
+    int32_t, hash_type,
+    skip4,);
+
+/* hash functions for distributed directory entry names */
+#define PVFS_DIST_DIR_HASH_MD5     0 /* directories created before hash_type */
+#define PVFS_DIST_DIR_HASH_MURMUR3 1
 
 typedef uint32_t PVFS_dist_dir_bitmap_basetype;
 typedef uint32_t *PVFS_dist_dir_bitmap;
@@ -2485,6 +2485,26 @@ dnl newer 3.3 kernels and above use d_make_root instead of d_alloc_root
 	])
         CFLAGS=$tmp_cflags
 
+	dnl flush has an fl_owner_t second parameter as of 2.6.18
+	tmp_cflags=$CFLAGS
+	CFLAGS="$CFLAGS -Werror"
+	AC_MSG_CHECKING(for fl_owner_t argument in flush)
+	AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[
+		#define __KERNEL__
+        #ifdef HAVE_KCONFIG
+        #include <linux/kconfig.h>
+        #endif
+		#include <linux/fs.h>
+		static struct file_operations f;
+		static int local_flush(struct file *f, fl_owner_t id)
+		{ return 0; }
+	]], [[
+	    f.flush = local_flush;
+	]])],[AC_MSG_RESULT(yes)
+	AC_DEFINE(HAVE_FLUSH_OWNER_PARAM, 1, Define if flush function in file_operations struct takes an fl_owner_t as the second parameter)],[AC_MSG_RESULT(no)
+	])
+        CFLAGS=$tmp_cflags
+
 	dnl file_operations has unlocked_ioctl instead of ioctl as of 2.6.36
 	tmp_cflags=$CFLAGS
 	CFLAGS="$CFLAGS -Werror"
@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/types.h>
 #include <fcntl.h>
 #include <sys/time.h>
 #include <time.h>
@@ -25,6 +26,20 @@
 
 #define HANDLE_BATCH 1000
 
+/* default number of operations kept in flight (-j) */
+#define FSCK_DEFAULT_WINDOW 64
+#define FSCK_TEST_TIMEOUT_MS 10
+
+#define FSCK_READDIR_COUNT 64
+
+/* records sorted in memory before being written out as a run, and the
+ * number of runs combined by each merge pass
+ */
+#define FSCK_RUN_RECORDS (1024 * 1024)
+#define FSCK_MERGE_FANIN 64
+
+#define FSCK_DEFAULT_SCRATCH_DIR "/tmp"
+
 #ifndef PVFS2_VERSION
 #define PVFS2_VERSION "Unknown"
 #endif
@@ -37,6 +52,8 @@ struct options
     int destructive;
     int safety_check;
     unsigned int safety_count;
+    char *scratch_dir;
+    int window;
 };
 struct options *fsck_opts = NULL;
 
@@ -44,8 +61,6 @@ struct options *fsck_opts = NULL;
 PVFS_object_ref laf_ref;
 unsigned long int global_removals = 0;
 
-static void handlelist_remove_handle_no_idx(struct handlelist *hl,
-				     PVFS_handle handle);
 static void get_user_action_to_continue( void );
 
 int main(int argc, char **argv)
@@ -56,7 +71,10 @@ int main(int argc, char **argv)
     PVFS_credential creds;
     int server_count;
     PVFS_BMI_addr_t *addr_array = NULL;
-    struct handlelist *hl_all, *hl_unrefd, *hl_notree;
+    PVFS_handle root_handle = PVFS_HANDLE_NULL;
+    struct recfile *inventory = NULL, *reserved = NULL;
+    struct recfile *refs = NULL, *prefs = NULL;
+    struct recfile *orphans = NULL, *missing = NULL, *detach = NULL;
     struct PVFS_mgmt_setparam_value param_value;
 
     fsck_opts = parse_args(argc, argv);
@@ -95,7 +113,7 @@ int main(int argc, char **argv)
     printf("# Current FSID is %u.\n", cur_fs);
 
     /* count how many servers we have */
-    ret = PVFS_mgmt_count_servers(cur_fs, 
+    ret = PVFS_mgmt_count_servers(cur_fs,
 	PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
 	&server_count);
     if (ret != 0)
@@ -122,6 +140,20 @@ int main(int argc, char **argv)
 	return -1;
     }
 
+    inventory = recfile_create("inventory");
+    reserved = recfile_create("reserved");
+    refs = recfile_create("refs");
+    prefs = recfile_create("prefs");
+    orphans = recfile_create("orphans");
+    missing = recfile_create("missing");
+    detach = recfile_create("detach");
+    if (!inventory || !reserved || !refs || !prefs ||
+        !orphans || !missing || !detach)
+    {
+        ret = -1;
+        goto exit_now;
+    }
+
     /* create /lost+found, if it isn't there already */
     ret = create_lost_and_found(cur_fs,
 				&creds);
@@ -133,7 +165,8 @@ int main(int argc, char **argv)
 		   "already in admin mode.  Use pvfs2-set-mode to change "
 		   "back to normal mode prior to running pvfs2-fsck.\n");
 	}
-	return -1;
+	ret = -1;
+	goto exit_now;
     }
 
     param_value.type = PVFS_MGMT_PARAM_TYPE_UINT64;
@@ -153,45 +186,90 @@ int main(int argc, char **argv)
 	ret = -1;
 	goto exit_now;
     }
-    
+
     in_admin_mode = 1;
 
-    hl_all = build_handlelist(cur_fs, addr_array, server_count, &creds);
-    if (hl_all == NULL) {
-	ret = -1;
-	goto exit_now;
+    /* first pass streams every handle on every server, concurrently,
+     * into a sorted inventory (and a list of reserved handles)
+     */
+    printf("# first pass: iterating handles on %d servers.\n", server_count);
+    ret = build_inventory(cur_fs,
+                          addr_array,
+                          server_count,
+                          &creds,
+                          inventory,
+                          reserved);
+    if (ret == 0)
+    {
+        ret = recfile_sort(inventory);
+    }
+    if (ret == 0)
+    {
+        ret = recfile_sort(reserved);
+    }
+    if (ret != 0)
+    {
+        ret = -1;
+        goto exit_now;
     }
 
-    /* first pass traverses the directory tree:
-     * - cleans up any direntries that refer to missing objects
-     * - verifies that files in the tree have all their datafiles 
-     *   (or repairs if possible)
-     * - verifies that all directories have their dirdata
-     *   (or repairs if possible)
+    /* second pass traverses the directory tree:
+     * - cleans up any direntries that refer to objects we cannot read
+     * - records a reference for every entry, datafile and dirdata
+     *   found from the root
      */
-    printf("# first pass: traversing directory tree.\n");
-    traverse_directory_tree(cur_fs,
-			    hl_all,
-			    addr_array,
-			    server_count,
-			    &creds);
-
-    /* second pass examines handles not in the directory tree:
-     * - finds orphaned "sub trees" and keeps references to head
-     *   - verifies files in the sub tree have all datafiles
-     *     (or repairs if possible)
-     *   - verifies all sub tree directories have their dirdata
-     *     (or repairs if possible)
-     * - builds list of metafile, dirdata, and datafiles not referenced
-     *   in some sub tree to be processed later
+    printf("# second pass: traversing directory tree.\n");
+    ret = traverse_directory_tree(cur_fs, &creds, refs, prefs, &root_handle);
+    if (ret == 0)
+    {
+        ret = recfile_sort(refs);
+    }
+    if (ret == 0)
+    {
+        ret = recfile_sort(prefs);
+    }
+    if (ret != 0)
+    {
+        ret = -1;
+        goto exit_now;
+    }
+
+    /* third pass joins the inventory with the references:
+     * - handles nobody refers to are orphans
+     * - files and directories missing a datafile or dirdata are removed,
+     *   along with their directory entries
+     * - entries of removed directories become orphans
      */
-    printf("# second pass: finding orphaned sub trees.\n");
-    hl_notree = find_sub_trees(cur_fs,
-			       hl_all,
-			       addr_array,
-			       &creds);
+    printf("# third pass: matching references against handles.\n");
+    ret = join_references(inventory, reserved, refs, orphans, missing, detach);
+    if (ret == 0)
+    {
+        ret = recfile_sort(missing);
+    }
+    if (ret == 0)
+    {
+        ret = repair_broken(cur_fs, &creds, root_handle, missing,
+                            refs, prefs, orphans, detach);
+    }
+    if (ret == 0)
+    {
+        ret = recfile_sort(detach);
+    }
+    if (ret == 0)
+    {
+        ret = detach_entries(cur_fs, &creds, detach);
+    }
+    if (ret != 0)
+    {
+        ret = -1;
+        goto exit_now;
+    }
 
-    handlelist_finalize(&hl_all);
+    recfile_destroy(&inventory);
+    recfile_destroy(&reserved);
+    recfile_destroy(&refs);
+    recfile_destroy(&prefs);
+    recfile_destroy(&detach);
 
     PVFS_util_refresh_credential(&creds);
 
@@ -208,27 +286,21 @@ int main(int argc, char **argv)
 			    NULL, NULL);
     in_admin_mode = 0;
 
-    /* third pass moves salvagable objects into lost+found:
-     * - moves sub trees into lost+found
-     * - verifies that orphaned files have all their datafiles
-     *   (or repairs if possible)
-     *   - if orphaned file is salvagable, moves into lost+found
-     * - builds list of remaining dirdata and datafiles not
-     *   referenced in sub tree or orphaned file
+    /* fourth pass salvages orphans:
+     * - finds the heads of orphaned sub trees and files
+     * - moves heads into lost+found, unless they are missing pieces
+     * - removes orphaned datafiles and dirdata
      */
-    printf("# third pass: moving orphaned sub trees and files to lost+found.\n");
-    hl_unrefd = fill_lost_and_found(cur_fs,
-				    hl_notree,
-				    addr_array,
-				    &creds);
-    handlelist_finalize(&hl_notree);
-
-    /* fourth pass removes orphaned dirdata and datafiles
-     * left from the previous passes.
-     */
-    printf("# fourth pass: removing unreferenced objects.\n");
-    cull_leftovers(cur_fs, hl_unrefd, addr_array, &creds);
-    handlelist_finalize(&hl_unrefd);
+    printf("# fourth pass: moving orphaned sub trees and files to lost+found.\n");
+    ret = recfile_sort(orphans);
+    if (ret == 0)
+    {
+        ret = salvage_orphans(cur_fs, &creds, orphans, missing);
+    }
+    if (ret != 0)
+    {
+        ret = -1;
+    }
 
  exit_now:
     PVFS_util_refresh_credential(&creds);
@@ -247,7 +319,15 @@ int main(int argc, char **argv)
 				server_count,
 				NULL, NULL);
     }
-    
+
+    recfile_destroy(&inventory);
+    recfile_destroy(&reserved);
+    recfile_destroy(&refs);
+    recfile_destroy(&prefs);
+    recfile_destroy(&orphans);
+    recfile_destroy(&missing);
+    recfile_destroy(&detach);
+
     PVFS_sys_finalize();
 
     if (addr_array != NULL) free(addr_array);
@@ -256,39 +336,69 @@ int main(int argc, char **argv)
     return(ret);
 }
 
-struct handlelist *build_handlelist(PVFS_fs_id cur_fs,
-				    PVFS_BMI_addr_t *addr_array,
-				    int server_count,
-				    PVFS_credential *creds)
+/* report_rate()
+ *
+ * Prints how many objects a pass went through and how fast.
+ */
+static void report_rate(const char *what,
+                        uint64_t count,
+                        const struct timeval *start)
 {
-    int ret, i, more_flag;
-    unsigned long j;
-    PVFS_handle **handle_matrix;
-    int  *hcount_array;
-    unsigned long *handle_count_array;
-    unsigned long *total_count_array;
-    PVFS_ds_position *position_array;
-    struct PVFS_mgmt_server_stat *stat_array;
-    struct handlelist *hl;
-    struct PVFS_mgmt_setparam_value param_value;
+    struct timeval now;
+    double secs;
+
+    gettimeofday(&now, NULL);
+    secs = (now.tv_sec - start->tv_sec) +
+        (now.tv_usec - start->tv_usec) / 1000000.0;
+
+    printf("# %s: %llu objects in %.2f seconds (%.0f objects/sec).\n",
+           what, llu(count), secs, (secs > 0) ? count / secs : 0.0);
+}
 
+/********************************************/
+
+/* build_inventory()
+ *
+ * Iterates the handles of every server concurrently, one stream of
+ * HANDLE_BATCH sized requests per server, and adds each handle to the
+ * inventory.  Once a server's normal handles are exhausted, its stream
+ * carries on with the reserved handles, which go to their own recfile.
+ */
+int build_inventory(PVFS_fs_id cur_fs,
+                    PVFS_BMI_addr_t *addr_array,
+                    int server_count,
+                    PVFS_credential *creds,
+                    struct recfile *inventory,
+                    struct recfile *reserved)
+{
+    struct iterate_stream
+    {
+        int server_idx;
+        int flags;
+        PVFS_handle *handles;
+        int count;
+        PVFS_ds_position position;
+        unsigned long total;
+    } *streams = NULL, *st;
+    struct PVFS_mgmt_server_stat *stat_array = NULL;
+    struct op_window win;
+    void *done_ptrs[FSCK_MAX_WINDOW];
+    int errors[FSCK_MAX_WINDOW];
+    struct timeval start;
+    PVFS_mgmt_op_id op_id;
+    int ret = -1, i, j, next_stream = 0, done_count;
+
+    gettimeofday(&start, NULL);
     PVFS_util_refresh_credential(creds);
 
     /* find out how many handles are in use on each */
     stat_array = (struct PVFS_mgmt_server_stat *)
 	malloc(server_count * sizeof(struct PVFS_mgmt_server_stat));
-    if (stat_array == NULL)
+    streams = calloc(server_count, sizeof(*streams));
+    if (stat_array == NULL || streams == NULL)
     {
-        param_value.type = PVFS_MGMT_PARAM_TYPE_UINT64;
-        param_value.u.value = PVFS_SERVER_NORMAL_MODE;
-	PVFS_mgmt_setparam_list(cur_fs,
-				creds,
-				PVFS_SERV_PARAM_MODE,
-				&param_value,
-				addr_array,
-				server_count,
-				NULL, NULL);
-	return NULL;
+        perror("malloc");
+        goto out;
     }
 
     ret = PVFS_mgmt_statfs_list(cur_fs,
@@ -300,883 +410,1690 @@ struct handlelist *build_handlelist(PVFS_fs_id cur_fs,
                 , NULL);
     if (ret != 0)
     {
-        param_value.type = PVFS_MGMT_PARAM_TYPE_UINT64;
-        param_value.u.value = PVFS_SERVER_NORMAL_MODE;
-
 	PVFS_perror("PVFS_mgmt_statfs_list", ret);
-	PVFS_mgmt_setparam_list(cur_fs,
-				creds,
-				PVFS_SERV_PARAM_MODE,
-                                &param_value,
-				addr_array,
-				server_count,
-				NULL, NULL);
-	return NULL;
+        goto out;
     }
 
-    /* allocate a 2 dimensional array for handles from mgmt fn. */
-    handle_matrix = (PVFS_handle **) calloc(server_count, sizeof(PVFS_handle));
-    if (handle_matrix == NULL)
-    {
-	perror("malloc");
-	return NULL;
-    }
-    for (i=0; i < server_count; i++)
+    for (i = 0; i < server_count; i++)
     {
-	handle_matrix[i] = (PVFS_handle *) calloc(HANDLE_BATCH, sizeof(PVFS_handle));
-	if (handle_matrix[i] == NULL)
-	{
-	    perror("malloc");
-	    return NULL;
-	}
+        streams[i].server_idx = i;
+        streams[i].position = PVFS_ITERATE_START;
+        streams[i].handles = calloc(HANDLE_BATCH, sizeof(PVFS_handle));
+        if (streams[i].handles == NULL)
+        {
+            perror("malloc");
+            ret = -1;
+            goto out;
+        }
     }
 
-    /* allocate some arrays to keep up with state */
-    handle_count_array = (unsigned long *) calloc(server_count, sizeof(unsigned long));
-    if (handle_count_array == NULL)
-    {
-	perror("malloc");
-	return NULL;
-    }
-    position_array = (PVFS_ds_position *) calloc(server_count, sizeof(PVFS_ds_position));
-    if (position_array == NULL)
-    {
-	perror("malloc");
-	return NULL;
-    }
-    /* total_count_array */
-    total_count_array = (unsigned long *) calloc(server_count, sizeof(unsigned long));
-    if (total_count_array == NULL)
-    {
-        perror("malloc");
-        return NULL;
-    }
-    /* hcount array */
-    hcount_array = (int *) calloc(server_count, sizeof(int));
-    if (hcount_array == NULL)
+    window_init(&win);
+    ret = 0;
+    while (ret == 0 && (next_stream < server_count || window_used(&win) > 0))
     {
-        perror("malloc:");
-        return NULL;
-    }
-
-    for (i=0; i < server_count; i++) {
-	handle_count_array[i] = stat_array[i].handles_total_count -
-	    stat_array[i].handles_available_count;
-        total_count_array[i] = 0;
-    }
-
+        /* start as many server streams as the window allows */
+        while (next_stream < server_count && window_used(&win) < win.limit)
+        {
+            st = &streams[next_stream++];
+            st->count = HANDLE_BATCH;
+            PVFS_util_refresh_credential(creds);
+            ret = PVFS_imgmt_iterate_handles_list(cur_fs,
+                                                  creds,
+                                                  &st->handles,
+                                                  &st->count,
+                                                  &st->position,
+                                                  &addr_array[st->server_idx],
+                                                  1,
+                                                  st->flags,
+                                                  NULL /* details */,
+                                                  NULL /* hints */,
+                                                  &op_id,
+                                                  st);
+            window_add(&win, ret, op_id, st);
+            ret = 0;
+        }
+        if (window_used(&win) == 0)
+        {
+            break;
+        }
 
-    hl = handlelist_initialize(handle_count_array, server_count);
+        done_count = window_test(&win, done_ptrs, errors);
+        if (done_count < 0)
+        {
+            ret = done_count;
+            break;
+        }
 
-    for (i=0; i < server_count; i++)
-    {
-	hcount_array[i] = HANDLE_BATCH;
-	position_array[i] = PVFS_ITERATE_START;
-    }
+        for (i = 0; i < done_count && ret == 0; i++)
+        {
+            st = done_ptrs[i];
+            if (errors[i] != 0)
+            {
+                PVFS_perror("PVFS_imgmt_iterate_handles_list", errors[i]);
+                ret = errors[i];
+                break;
+            }
 
-    /* iterate until we have retrieved all handles */
-    more_flag = 1;
-    while (more_flag)
-    {
-        PVFS_util_refresh_credential(creds);
+            for (j = 0; j < st->count && ret == 0; j++)
+            {
+                PVFS_BMI_addr_t tmp_addr;
 
-	ret = PVFS_mgmt_iterate_handles_list(cur_fs,
-					     creds,
-					     handle_matrix,
-					     hcount_array,
-					     position_array,
-					     addr_array,
-					     server_count,
-                                             0,
-					     NULL /* details */,
-                                             NULL /* hints */);
-	if (ret < 0)
-	{
-            param_value.type = PVFS_MGMT_PARAM_TYPE_UINT64;
-            param_value.u.value = PVFS_SERVER_NORMAL_MODE;
-
-	    PVFS_perror("PVFS_mgmt_iterate_handles_list", ret);
-	    PVFS_mgmt_setparam_list(cur_fs,
-				    creds,
-				    PVFS_SERV_PARAM_MODE,
-                                    &param_value,
-				    addr_array,
-				    server_count,
-				    NULL, NULL);
-	    return NULL;
-	}
+                if (st->flags & PVFS_MGMT_RESERVED)
+                {
+                    /* reserved handles can be reported by any server,
+                     * not just the server that owns the handle
+                     */
+                    ret = recfile_add(reserved, st->handles[j],
+                                      PVFS_HANDLE_NULL, PVFS_TYPE_NONE);
+                    continue;
+                }
 
-	for (i=0; i < server_count; i++)
-	{
-            total_count_array[i] += hcount_array[i];
-	    for (j=0; j < hcount_array[i]; j++)
-	    {
-                PVFS_BMI_addr_t tmp_addr;
-		/* verify that handles are
-		 * within valid ranges for the given server here.
-		 */
-                ret = PINT_cached_config_map_to_server(&tmp_addr, handle_matrix[i][j], cur_fs);
-                if (ret || tmp_addr != addr_array[i])
+                /* verify that handles are within valid ranges for the
+                 * given server here.
+                 */
+                ret = PINT_cached_config_map_to_server(&tmp_addr,
+                                                       st->handles[j],
+                                                       cur_fs);
+                if (ret || tmp_addr != addr_array[st->server_idx])
                 {
-                    fprintf(stderr, "Ugh! handle does not seem to be owned by the server!\n");
-                    return NULL;
+                    fprintf(stderr, "Ugh! handle does not seem to be owned "
+                            "by the server!\n");
+                    ret = -1;
+                    break;
                 }
-	    }
+                ret = recfile_add(inventory, st->handles[j],
+                                  PVFS_HANDLE_NULL, PVFS_TYPE_NONE);
+            }
+            if (ret != 0)
+            {
+                break;
+            }
+            if (!(st->flags & PVFS_MGMT_RESERVED))
+            {
+                st->total += st->count;
+            }
 
-	    handlelist_add_handles(hl,
-				   handle_matrix[i],
-				   hcount_array[i],
-				   i);
-	}
+            if (st->position == PVFS_ITERATE_END)
+            {
+                if (st->flags & PVFS_MGMT_RESERVED)
+                {
+                    continue;
+                }
+                /* now look for reserved handles on this server */
+                st->flags = PVFS_MGMT_RESERVED;
+                st->position = PVFS_ITERATE_START;
+            }
 
-	/* find out if any servers have more handles to dump */
-	more_flag = 0;
-	for (i=0; i < server_count; i++)
-	{
-	    if (position_array[i] != PVFS_ITERATE_END)
-	    {
-		more_flag = 1;
-		break;
-	    }
-	}
+            st->count = HANDLE_BATCH;
+            PVFS_util_refresh_credential(creds);
+            ret = PVFS_imgmt_iterate_handles_list(cur_fs,
+                                                  creds,
+                                                  &st->handles,
+                                                  &st->count,
+                                                  &st->position,
+                                                  &addr_array[st->server_idx],
+                                                  1,
+                                                  st->flags,
+                                                  NULL /* details */,
+                                                  NULL /* hints */,
+                                                  &op_id,
+                                                  st);
+            window_add(&win, ret, op_id, st);
+            ret = 0;
+        }
+    }
+    window_drain(&win);
+    if (ret != 0)
+    {
+        ret = -1;
+        goto out;
     }
 
     for (i = 0; i < server_count; i++)
     {
-        unsigned long used_handles = handle_count_array[i];
-        if (total_count_array[i] != used_handles)
+        unsigned long used_handles = stat_array[i].handles_total_count -
+            stat_array[i].handles_available_count;
+        if (streams[i].total != used_handles)
         {
-            fprintf(stderr, "Ugh! Server %d, Received %ld total handles instead of %ld\n",
-                    i, total_count_array[i], used_handles);
-            return NULL;
+            fprintf(stderr, "Ugh! Server %d, Received %ld total handles "
+                    "instead of %ld\n", i, streams[i].total, used_handles);
+            ret = -1;
+            goto out;
         }
     }
 
-    handlelist_finished_adding_handles(hl); /* sanity check */
-
-    /* now look for reserved handles */
-    for (i=0; i < server_count; i++)
-    {
-	hcount_array[i] = HANDLE_BATCH;
-	position_array[i] = PVFS_ITERATE_START;
-    }
-
-    more_flag = 1;
-    while (more_flag)
-    {
-        PVFS_util_refresh_credential(creds);
-
-	ret = PVFS_mgmt_iterate_handles_list(cur_fs,
-					     creds,
-					     handle_matrix,
-					     hcount_array,
-					     position_array,
-					     addr_array,
-					     server_count,
-                                             PVFS_MGMT_RESERVED,
-					     NULL /* details */,
-                                             NULL /* hints */);
-	if (ret < 0)
-	{
-	    PVFS_perror("PVFS_mgmt_iterate_handles_list", ret);
-            param_value.type = PVFS_MGMT_PARAM_TYPE_UINT64;
-            param_value.u.value = PVFS_SERVER_NORMAL_MODE;
-	    PVFS_mgmt_setparam_list(cur_fs,
-				    creds,
-				    PVFS_SERV_PARAM_MODE,
-				    &param_value,
-				    addr_array,
-				    server_count,
-				    NULL,
-				    NULL);
-	    return NULL;
-	}
-
-	for (i=0; i < server_count; i++)
-	{
-            /* remove any reserved handles from the handlelist.  These will
-             * not show up in normal objects when we walk the file system
-             * tree.
-             */
-	    for (j=0; j < hcount_array[i]; j++)
-	    {
-                /* we don't know the server index.  Reserved handles can be
-                 * reported by any server; not just the server that actually
-                 * owns that handle.
-                 */
-	        handlelist_remove_handle_no_idx(hl,
-				   handle_matrix[i][j]);
-            }
-	}
-
-	/* find out if any servers have more handles to dump */
-	more_flag = 0;
-	for (i=0; i < server_count; i++)
-	{
-	    if (position_array[i] != PVFS_ITERATE_END)
-	    {
-		more_flag = 1;
-                hcount_array[i] = HANDLE_BATCH;
-	    }
-	}
-    }
+    report_rate("handles iterated", inventory->count + reserved->count,
+                &start);
 
-    for (i = 0; i < server_count; i++)
+  out:
+    if (streams)
     {
-	free(handle_matrix[i]);
+        for (i = 0; i < server_count; i++)
+        {
+            free(streams[i].handles);
+        }
+        free(streams);
     }
-
-    free(handle_matrix);
-    free(handle_count_array);
-    free(hcount_array);
-    free(total_count_array);
-    free(position_array);
-
     free(stat_array);
-    stat_array = NULL;
-
-    return hl;
+    return ret;
 }
 
-int traverse_directory_tree(PVFS_fs_id cur_fs,
-			    struct handlelist *hl,
-			    PVFS_BMI_addr_t *addr_array,
-			    int server_count,
-			    PVFS_credential *creds)
-{
-    int ret, server_idx = 0;
-    PVFS_sysresp_lookup lookup_resp;
-    PVFS_sysresp_getattr getattr_resp;
-    PVFS_object_ref pref;
-
-    PVFS_util_refresh_credential(creds);
-
-    ret = PVFS_sys_lookup(cur_fs,
-			  "/",
-			  creds,
-			  &lookup_resp,
-			  PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
-    assert(ret == 0);
+/********************************************/
 
-    pref = lookup_resp.ref;
+enum fsck_op_type
+{
+    FSCK_OP_READDIR,
+    FSCK_OP_GETATTR,
+    FSCK_OP_DFILES,
+    FSCK_OP_DIRDATA
+};
 
-    PVFS_sys_getattr(pref,
-		     PVFS_ATTR_SYS_ALL_NOHINT,
-		     creds,
-		     &getattr_resp, NULL);
+/* one step of the walk: reading a page of a directory, the attributes
+ * of an object, or the datafile/dirdata handles of an object
+ */
+struct fsck_op
+{
+    enum fsck_op_type type;
+    PVFS_object_ref ref;
+    PVFS_object_ref parent;    /* directory holding ref, if known */
+    char *name;                /* name of ref in parent, if known */
+    int objtype;
+    PVFS_ds_position token;
+    PVFS_sysresp_readdir readdir_resp;
+    PVFS_sysresp_getattr getattr_resp;
+    PVFS_handle *handles;
+    int handle_count;
+    struct fsck_op *next;
+};
 
-    assert(getattr_resp.attr.objtype == PVFS_TYPE_DIRECTORY);
+/* state shared by the tree traversal and the orphan walk.  In tree mode
+ * directories found are read through the on-disk queue and every entry
+ * is examined; in orphan mode only the objects fed from the orphan
+ * recfile are examined, and directory entries are just recorded as
+ * references.
+ */
+struct walker
+{
+    PVFS_fs_id fs_id;
+    PVFS_credential *creds;
+    int orphan_mode;
+    int error;
+    struct op_window win;
+    struct fsck_op *backlog_head;
+    struct fsck_op *backlog_tail;
+    struct dirqueue *dirs;
+    struct recfile *feed;
+    struct recfile *skip;
+    PVFS_handle last_fed;
+    struct recfile *objs;
+    struct recfile *refs;
+    struct recfile *prefs;
+    uint64_t objects;
+};
 
-    ret = handlelist_find_handle(hl, pref.handle, &server_idx);
-    assert(ret == 0);
+static void walker_complete(struct walker *w, struct fsck_op *op, int error);
 
-    handlelist_remove_handle(hl, pref.handle, server_idx);
+static struct fsck_op *walker_op(enum fsck_op_type type,
+                                 PVFS_object_ref ref,
+                                 PVFS_object_ref parent,
+                                 const char *name)
+{
+    struct fsck_op *op = calloc(1, sizeof(*op));
 
-    ret = match_dirdata(hl,
-			NULL /* optional second handle list */,
-			pref,
-                        getattr_resp.attr.distr_dir_servers_max,
-			creds);
-    if (ret != 0) {
-	assert(0);
+    if (op == NULL)
+    {
+        return NULL;
     }
-
-    descend(cur_fs, hl, NULL, pref, creds);
-
-    return 0;
+    op->type = type;
+    op->ref = ref;
+    op->parent = parent;
+    op->token = PVFS_READDIR_START;
+    if (name)
+    {
+        op->name = strdup(name);
+        if (op->name == NULL)
+        {
+            free(op);
+            return NULL;
+        }
+    }
+    return op;
 }
 
-int match_dirdata(struct handlelist *hl,
-		  struct handlelist *alt_hl,
-		  PVFS_object_ref dir_ref,
-                  int dh_count,
-		  PVFS_credential *creds)
+static void walker_free_op(struct fsck_op *op)
 {
-    int ret, i, server_idx = 0, error = 0;
-    PVFS_handle *dh_handles;
+    free(op->name);
+    free(op->handles);
+    free(op);
+}
 
-    dh_handles = (PVFS_handle *) malloc(dh_count * sizeof(PVFS_handle));
-    if (dh_handles == NULL)
+static void walker_queue(struct walker *w, struct fsck_op *op)
+{
+    if (op == NULL)
     {
-        assert(0);
+        perror("malloc");
+        w->error = -PVFS_ENOMEM;
+        return;
     }
-
-    ret = PVFS_mgmt_get_dirdata_array(dir_ref,
-                                      creds,
-				      dh_handles,
-                                      dh_count,
-				      NULL);
-    if (ret != 0)
+    op->next = NULL;
+    if (w->backlog_tail)
     {
-        PVFS_perror("match_dirdata", ret);
-        free(dh_handles);
-	return -1;
+        w->backlog_tail->next = op;
     }
-
-    for (i = 0; i < dh_count; i++)
+    else
     {
-        int in_main_list = 0, in_alt_list = 0;
-
-        if (handlelist_find_handle(hl, dh_handles[i], &server_idx) == 0)
-        {
-            in_main_list = 1;
-        }
-        else if (alt_hl &&
-                 (handlelist_find_handle(alt_hl,
-                                         dh_handles[i],
-                                         &server_idx) == 0))
-        {
-            in_alt_list = 1;
-        }
+        w->backlog_head = op;
+    }
+    w->backlog_tail = op;
+}
 
-        if ((!in_main_list) && (!in_alt_list))
-        {
-            printf("# dirdata handle %llu missing from list\n",
-                   llu(dh_handles[i]));
-            /* if possible, rebuild the dirdata handle. */
-            /* otherwise delete dirdata, return error to get
-             * directory and dirent removed.
-             */
-            dh_handles[i] = PVFS_HANDLE_NULL;
-            error++;
-        }
+static void walker_emit_ref(struct walker *w,
+                            PVFS_handle handle,
+                            PVFS_handle parent,
+                            int type)
+{
+    int ret;
 
+    ret = recfile_add(w->refs, handle, parent, type);
+    if (ret == 0)
+    {
+        ret = recfile_add(w->prefs, parent, handle, type);
     }
-
-    for (i = 0; i < dh_count; i++)
+    if (ret != 0)
     {
-        if (dh_handles[i] != PVFS_HANDLE_NULL) {
-            /* TODO: THIS IS A HACK; NEED BETTER WAY TO REMOVE FROM
-             * ONE OF TWO LISTS...
-             */
-
-            if (handlelist_find_handle(hl, dh_handles[i], &server_idx) == 0)
-            {
-                handlelist_remove_handle(hl,
-                                         dh_handles[i],
-                                         server_idx);
-            }
-            else {
-                handlelist_remove_handle(alt_hl,
-                                         dh_handles[i],
-                                         server_idx);
-            }
-        }
+        w->error = ret;
     }
-
-    free(dh_handles);
-    return (error) ? -1 : 0;
-
 }
 
-int descend(PVFS_fs_id cur_fs,
-	    struct handlelist *hl,
-	    struct handlelist *alt_hl,
-	    PVFS_object_ref dir_ref,
-	    PVFS_credential *creds)
+/* walker_remove()
+ *
+ * Removes an object that cannot be used, along with the directory entry
+ * that led to it, if there is one.
+ */
+static void walker_remove(struct walker *w, struct fsck_op *op, int type)
 {
-    int i, count;
-    PVFS_ds_position token; 
-    PVFS_sysresp_readdir readdir_resp;
-    PVFS_sysresp_getattr getattr_resp;
-    PVFS_object_ref entry_ref = {0, 0};
+    remove_object(op->ref, type, w->creds);
+    if (op->name)
+    {
+        remove_directory_entry(op->parent, op->ref, op->name, w->creds);
+    }
+}
 
-    count = 64;
+static void walker_post(struct walker *w, struct fsck_op *op)
+{
+    PVFS_sys_op_id op_id;
+    int ret = -PVFS_EINVAL;
 
-    token = 0;
-    do {
-        memset(&readdir_resp, 0, sizeof(PVFS_sysresp_readdir));
-        PVFS_sys_readdir(dir_ref,
-                         (!token ? PVFS_READDIR_START : token),
-                         count,
-                         creds,
-                         &readdir_resp, NULL);
+    PVFS_util_refresh_credential(w->creds);
 
-        for (i = 0; i < readdir_resp.pvfs_dirent_outcount; i++)
-        {
-            int server_idx = 0, ret, in_main_list = 0, in_alt_list = 0;
-            char *cur_file;
-            PVFS_handle cur_handle;
+    switch (op->type)
+    {
+        case FSCK_OP_READDIR:
+            ret = PVFS_isys_readdir(op->ref, op->token, FSCK_READDIR_COUNT,
+                                    w->creds, &op->readdir_resp, &op_id,
+                                    NULL, op);
+            break;
+        case FSCK_OP_GETATTR:
+            ret = PVFS_isys_getattr(op->ref, PVFS_ATTR_SYS_ALL_NOSIZE,
+                                    w->creds, &op->getattr_resp, &op_id,
+                                    NULL, op);
+            break;
+        case FSCK_OP_DFILES:
+            ret = PVFS_imgmt_get_dfile_array(op->ref, w->creds, op->handles,
+                                             op->handle_count, &op_id,
+                                             NULL, op);
+            break;
+        case FSCK_OP_DIRDATA:
+            ret = PVFS_imgmt_get_dirdata_array(op->ref, w->creds,
+                                               op->handles,
+                                               op->handle_count, &op_id,
+                                               NULL, op);
+            break;
+    }
 
-            cur_handle = readdir_resp.dirent_array[i].handle;
-            cur_file   = readdir_resp.dirent_array[i].d_name;
+    window_add(&w->win, ret, op_id, op);
+}
 
-            entry_ref.handle = cur_handle;
-            entry_ref.fs_id  = cur_fs;
+/* walker_fetch_handles()
+ *
+ * Turns a completed getattr into a request for the datafile or dirdata
+ * handles of the object.
+ */
+static void walker_fetch_handles(struct walker *w,
+                                 struct fsck_op *op,
+                                 enum fsck_op_type type,
+                                 int count)
+{
+    if (op == NULL)
+    {
+        perror("malloc");
+        w->error = -PVFS_ENOMEM;
+        return;
+    }
+    op->type = type;
+    op->handle_count = count;
+    op->handles = calloc(count, sizeof(PVFS_handle));
+    if (op->handles == NULL)
+    {
+        perror("malloc");
+        w->error = -PVFS_ENOMEM;
+        walker_free_op(op);
+        return;
+    }
+    walker_queue(w, op);
+}
 
-            if (handlelist_find_handle(hl, cur_handle, &server_idx) == 0)
+/* walker_complete()
+ *
+ * Records what a completed operation found and queues the operations
+ * that follow from it.
+ */
+static void walker_complete(struct walker *w, struct fsck_op *op, int error)
+{
+    PVFS_sys_attr *attr;
+    int i, type, count;
+
+    switch (op->type)
+    {
+        case FSCK_OP_READDIR:
+            if (error)
             {
-                in_main_list = 1;
+                printf("warning: problem reading directory %llu.\n",
+                       llu(op->ref.handle));
+                break;
             }
-            if (!in_main_list &&
-                alt_hl &&
-                handlelist_find_handle(alt_hl,
-                                       cur_handle,
-                                       &server_idx) == 0)
+            for (i = 0; i < op->readdir_resp.pvfs_dirent_outcount; i++)
             {
-                in_alt_list = 1;
+                PVFS_dirent *d = &op->readdir_resp.dirent_array[i];
+                PVFS_object_ref entry_ref;
+
+                if (w->orphan_mode)
+                {
+                    walker_emit_ref(w, d->handle, op->ref.handle,
+                                    PVFS_TYPE_NONE);
+                    continue;
+                }
+                entry_ref = op->ref;
+                entry_ref.handle = d->handle;
+                walker_queue(w, walker_op(FSCK_OP_GETATTR, entry_ref,
+                                          op->ref, d->d_name));
             }
-            if (!in_main_list && !in_alt_list) {
-                ret = remove_directory_entry(dir_ref,
-                                             entry_ref,
-                                             cur_file,
-                                             creds);
-                assert(ret == 0);
+            if (op->readdir_resp.pvfs_dirent_outcount == FSCK_READDIR_COUNT)
+            {
+                struct fsck_op *more = walker_op(FSCK_OP_READDIR, op->ref,
+                                                 op->parent, NULL);
+                if (more)
+                {
+                    more->token = op->readdir_resp.token;
+                }
+                walker_queue(w, more);
+            }
+            if (op->readdir_resp.pvfs_dirent_outcount)
+            {
+                free(op->readdir_resp.dirent_array);
+            }
+            break;
+
+        case FSCK_OP_GETATTR:
+            w->objects++;
+            if (error)
+            {
+                if (op->name)
+                {
+                    remove_directory_entry(op->parent, op->ref, op->name,
+                                           w->creds);
+                }
+                else
+                {
+                    /* remove anything we can't get attributes on */
+                    remove_object(op->ref, PVFS_TYPE_NONE, w->creds);
+                }
+                break;
+            }
+
+            attr = &op->getattr_resp.attr;
+            type = attr->objtype;
+            op->objtype = type;
+            count = (type == PVFS_TYPE_METAFILE) ? attr->dfile_count :
+                attr->distr_dir_servers_max;
+            PVFS_util_release_sys_attr(attr);
+
+            if (w->orphan_mode &&
+                (type == PVFS_TYPE_METAFILE || type == PVFS_TYPE_DIRECTORY ||
+                 type == PVFS_TYPE_SYMLINK || type == PVFS_TYPE_DATAFILE ||
+                 type == PVFS_TYPE_DIRDATA))
+            {
+                if (recfile_add(w->objs, op->ref.handle,
+                                PVFS_HANDLE_NULL, type) != 0)
+                {
+                    w->error = -PVFS_EIO;
+                }
+            }
+            else if (!w->orphan_mode &&
+                     (type == PVFS_TYPE_METAFILE ||
+                      type == PVFS_TYPE_DIRECTORY ||
+                      type == PVFS_TYPE_SYMLINK))
+            {
+                walker_emit_ref(w, op->ref.handle, op->parent.handle, type);
+            }
+
+            switch (type)
+            {
+                case PVFS_TYPE_METAFILE:
+                    if (count > 0)
+                    {
+                        walker_fetch_handles(w, op, FSCK_OP_DFILES, count);
+                        return;
+                    }
+                    break;
+                case PVFS_TYPE_DIRECTORY:
+                    if (count > 0)
+                    {
+                        walker_fetch_handles(w, op, FSCK_OP_DIRDATA, count);
+                        return;
+                    }
+                    printf("* Directory %llu has no DirData.\n",
+                           llu(op->ref.handle));
+                    walker_remove(w, op, type);
+                    break;
+                case PVFS_TYPE_SYMLINK:
+                    /* nothing to do */
+                    break;
+                case PVFS_TYPE_DATAFILE:
+                case PVFS_TYPE_DIRDATA:
+                case PVFS_TYPE_INTERNAL:
+                    /* the servers keep private objects outside the tree */
+                    if (w->orphan_mode)
+                    {
+                        break;
+                    }
+                    /* fall through */
+                default:
+                    /* whatever this is, blow it away now. */
+                    walker_remove(w, op, type);
+                    break;
+            }
+            break;
+
+        case FSCK_OP_DFILES:
+        case FSCK_OP_DIRDATA:
+            type = (op->type == FSCK_OP_DFILES) ?
+                PVFS_TYPE_DATAFILE : PVFS_TYPE_DIRDATA;
+            if (error)
+            {
+                printf("* %s %llu is not recoverable; cannot read its "
+                       "%s handles.\n", get_type_str(op->objtype),
+                       llu(op->ref.handle), get_type_str(type));
+                walker_remove(w, op, op->objtype);
+                break;
+            }
+            for (i = 0; i < op->handle_count; i++)
+            {
+                walker_emit_ref(w, op->handles[i], op->ref.handle, type);
+            }
+            if (op->type == FSCK_OP_DIRDATA)
+            {
+                if (w->orphan_mode)
+                {
+                    walker_queue(w, walker_op(FSCK_OP_READDIR, op->ref,
+                                              op->parent, NULL));
+                }
+                else if (dirqueue_push(w->dirs, op->ref.handle) != 0)
+                {
+                    w->error = -PVFS_EIO;
+                }
+            }
+            break;
+    }
+
+    walker_free_op(op);
+}
+
+/* walker_next()
+ *
+ * Finds the next operation to post: queued operations first, so that
+ * the backlog stays bounded, then the next directory to read (tree
+ * mode) or the next orphan to examine (orphan mode).
+ */
+static struct fsck_op *walker_next(struct walker *w)
+{
+    struct fsck_op *op = w->backlog_head;
+    PVFS_object_ref ref, none = {PVFS_HANDLE_NULL, 0};
+
+    if (op)
+    {
+        w->backlog_head = op->next;
+        if (w->backlog_head == NULL)
+        {
+            w->backlog_tail = NULL;
+        }
+        return op;
+    }
 
+    ref.fs_id = w->fs_id;
+    if (w->dirs)
+    {
+        if (dirqueue_pop(w->dirs, &ref.handle) != 0)
+        {
+            return NULL;
+        }
+        op = walker_op(FSCK_OP_READDIR, ref, none, NULL);
+    }
+    else
+    {
+        while (1)
+        {
+            if (w->feed->eof)
+            {
+                return NULL;
+            }
+            ref.handle = w->feed->cur.handle;
+            recfile_next(w->feed);
+            if (ref.handle == w->last_fed ||
+                (w->skip && recfile_seek(w->skip, ref.handle)))
+            {
                 continue;
             }
+            w->last_fed = ref.handle;
+            break;
+        }
+        op = walker_op(FSCK_OP_GETATTR, ref, none, NULL);
+    }
 
-            ret = PVFS_sys_getattr(entry_ref,
-                                   PVFS_ATTR_SYS_ALL_NOHINT,
-                                   creds,
-                                   &getattr_resp, NULL);
-            if (ret != 0) {
-                ret = remove_directory_entry(dir_ref,
-                                             entry_ref,
-                                             cur_file,
-                                             creds);
-                assert(ret == 0);
-                /* handle removed from list below */
+    if (op == NULL)
+    {
+        perror("malloc");
+        w->error = -PVFS_ENOMEM;
+    }
+    return op;
+}
+
+/* walker_run()
+ *
+ * Keeps up to the window size of operations in flight until the walk
+ * has nothing left to do.
+ */
+static int walker_run(struct walker *w)
+{
+    void *done_ptrs[FSCK_MAX_WINDOW];
+    int errors[FSCK_MAX_WINDOW];
+    struct fsck_op *op;
+    int i, done_count;
+
+    while (1)
+    {
+        while (!w->error && window_used(&w->win) < w->win.limit &&
+               (op = walker_next(w)) != NULL)
+        {
+            walker_post(w, op);
+        }
+        if (window_used(&w->win) == 0)
+        {
+            break;
+        }
+
+        done_count = window_test(&w->win, done_ptrs, errors);
+        if (done_count < 0)
+        {
+            w->error = done_count;
+            window_drain(&w->win);
+            break;
+        }
+        for (i = 0; i < done_count; i++)
+        {
+            walker_complete(w, done_ptrs[i], errors[i]);
+        }
+    }
+
+    while ((op = w->backlog_head) != NULL)
+    {
+        w->backlog_head = op->next;
+        walker_free_op(op);
+    }
+    w->backlog_tail = NULL;
+    return w->error;
+}
+
+/* traverse_directory_tree()
+ *
+ * Walks the directory tree breadth first from the root, recording a
+ * reference for every object found.
+ */
+int traverse_directory_tree(PVFS_fs_id cur_fs,
+			    PVFS_credential *creds,
+			    struct recfile *refs,
+			    struct recfile *prefs,
+			    PVFS_handle *root_handle)
+{
+    int ret;
+    PVFS_sysresp_lookup lookup_resp;
+    PVFS_sysresp_getattr getattr_resp;
+    PVFS_object_ref pref, none = {PVFS_HANDLE_NULL, 0};
+    struct fsck_op *op;
+    struct walker w;
+    struct timeval start;
+
+    gettimeofday(&start, NULL);
+    PVFS_util_refresh_credential(creds);
+
+    ret = PVFS_sys_lookup(cur_fs,
+			  "/",
+			  creds,
+			  &lookup_resp,
+			  PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+    assert(ret == 0);
+
+    pref = lookup_resp.ref;
+    *root_handle = pref.handle;
+
+    memset(&getattr_resp, 0, sizeof(getattr_resp));
+    ret = PVFS_sys_getattr(pref,
+			   PVFS_ATTR_SYS_ALL_NOSIZE,
+			   creds,
+			   &getattr_resp, NULL);
+    assert(ret == 0);
+    assert(getattr_resp.attr.objtype == PVFS_TYPE_DIRECTORY);
+
+    memset(&w, 0, sizeof(w));
+    w.fs_id = cur_fs;
+    w.creds = creds;
+    w.refs = refs;
+    w.prefs = prefs;
+    window_init(&w.win);
+    w.dirs = dirqueue_create();
+    if (w.dirs == NULL)
+    {
+        PVFS_util_release_sys_attr(&getattr_resp.attr);
+        return -1;
+    }
+
+    /* the root is referenced by the file system itself */
+    walker_emit_ref(&w, pref.handle, PVFS_HANDLE_NULL, PVFS_TYPE_DIRECTORY);
+    op = walker_op(FSCK_OP_DIRDATA, pref, none, NULL);
+    if (op)
+    {
+        op->objtype = PVFS_TYPE_DIRECTORY;
+    }
+    walker_fetch_handles(&w, op, FSCK_OP_DIRDATA,
+                         getattr_resp.attr.distr_dir_servers_max);
+    PVFS_util_release_sys_attr(&getattr_resp.attr);
+
+    ret = walker_run(&w);
+    dirqueue_destroy(&w.dirs);
+
+    report_rate("objects traversed", w.objects + 1, &start);
+    return ret;
+}
+
+/********************************************/
+
+/* join_references()
+ *
+ * Merges the sorted object set (and reserved handles, if any) with the
+ * sorted references to it:
+ * - objects nobody refers to are added to unrefd
+ * - datafile and dirdata references to missing objects are added to
+ *   missing, keyed by the object that is now broken
+ * - directory entries for missing objects are added to detach, keyed by
+ *   the directory
+ */
+int join_references(struct recfile *objs,
+                    struct recfile *reserved,
+                    struct recfile *refs,
+                    struct recfile *unrefd,
+                    struct recfile *missing,
+                    struct recfile *detach)
+{
+    PVFS_handle handle;
+    int has_obj, referenced, type, ret = 0;
+    uint64_t joined = 0, unrefd_count = 0, missing_count = 0;
+    struct timeval start;
+
+    gettimeofday(&start, NULL);
+
+    while (ret == 0 && (!objs->eof || !refs->eof))
+    {
+        if (objs->eof)
+        {
+            handle = refs->cur.handle;
+        }
+        else if (refs->eof)
+        {
+            handle = objs->cur.handle;
+        }
+        else
+        {
+            handle = (objs->cur.handle < refs->cur.handle) ?
+                objs->cur.handle : refs->cur.handle;
+        }
+        joined++;
+
+        has_obj = 0;
+        type = PVFS_TYPE_NONE;
+        while (!objs->eof && objs->cur.handle == handle)
+        {
+            has_obj = 1;
+            type = objs->cur.type;
+            recfile_next(objs);
+        }
+
+        referenced = 0;
+        while (ret == 0 && !refs->eof && refs->cur.handle == handle)
+        {
+            referenced = 1;
+            if (!has_obj)
+            {
+                missing_count++;
+                if (refs->cur.type == PVFS_TYPE_DATAFILE ||
+                    refs->cur.type == PVFS_TYPE_DIRDATA)
+                {
+                    printf("# %s handle %llu of %llu is missing.\n",
+                           get_type_str(refs->cur.type), llu(handle),
+                           llu(refs->cur.ref));
+                    ret = recfile_add(missing, refs->cur.ref, handle,
+                                      refs->cur.type);
+                }
+                else if (refs->cur.ref != PVFS_HANDLE_NULL)
+                {
+                    ret = recfile_add(detach, refs->cur.ref, handle,
+                                      refs->cur.type);
+                }
+            }
+            recfile_next(refs);
+        }
+
+        if (ret == 0 && has_obj && !referenced &&
+            !(reserved && recfile_seek(reserved, handle)))
+        {
+            unrefd_count++;
+            ret = recfile_add(unrefd, handle, PVFS_HANDLE_NULL, type);
+        }
+    }
+
+    if (fsck_opts->verbose)
+    {
+        printf("# %llu unreferenced objects, %llu missing objects.\n",
+               llu(unrefd_count), llu(missing_count));
+    }
+    report_rate("handles joined", joined, &start);
+    return ret;
+}
+
+/* repair_broken()
+ *
+ * Removes the objects in missing (files missing a datafile, directories
+ * missing dirdata) and queues their directory entries for removal.  The
+ * remaining datafiles and dirdata of a removed object are removed too;
+ * entries of a removed directory are added to unrefd as orphans.
+ */
+int repair_broken(PVFS_fs_id cur_fs,
+                  PVFS_credential *creds,
+                  PVFS_handle root_handle,
+                  struct recfile *missing,
+                  struct recfile *refs,
+                  struct recfile *prefs,
+                  struct recfile *unrefd,
+                  struct recfile *detach)
+{
+    PVFS_object_ref ref;
+    PVFS_handle broken, last_parent = PVFS_HANDLE_NULL;
+    int type, is_broken, ret = 0;
+
+    ref.fs_id = cur_fs;
+
+    /* remove each broken object, remembering where it was linked */
+    recfile_rewind(missing);
+    recfile_rewind(refs);
+    while (ret == 0 && !missing->eof)
+    {
+        broken = missing->cur.handle;
+        while (!missing->eof && missing->cur.handle == broken)
+        {
+            recfile_next(missing);
+        }
+
+        type = PVFS_TYPE_NONE;
+        recfile_seek(refs, broken);
+        while (ret == 0 && !refs->eof && refs->cur.handle == broken)
+        {
+            type = refs->cur.type;
+            if (refs->cur.ref != PVFS_HANDLE_NULL)
+            {
+                ret = recfile_add(detach, refs->cur.ref, broken, type);
+            }
+            recfile_next(refs);
+        }
+
+        if (broken == root_handle)
+        {
+            printf("* root directory %llu is damaged; not removing it.\n",
+                   llu(broken));
+            continue;
+        }
+        printf("* %s %llu is not recoverable.\n", get_type_str(type),
+               llu(broken));
+        ref.handle = broken;
+        remove_object(ref, type, creds);
+    }
+
+    /* then deal with what the broken objects referred to */
+    recfile_rewind(missing);
+    recfile_rewind(prefs);
+    while (ret == 0 && !prefs->eof)
+    {
+        while (!missing->eof &&
+               recfile_compare(&missing->cur, &prefs->cur) < 0)
+        {
+            last_parent = missing->cur.handle;
+            recfile_next(missing);
+        }
+
+        is_broken = (prefs->cur.handle != PVFS_HANDLE_NULL) &&
+            (prefs->cur.handle != root_handle) &&
+            ((!missing->eof && missing->cur.handle == prefs->cur.handle) ||
+             last_parent == prefs->cur.handle);
+
+        /* skip the pieces that are already gone */
+        if (is_broken &&
+            !(!missing->eof && recfile_compare(&missing->cur,
+                                               &prefs->cur) == 0))
+        {
+            ref.handle = prefs->cur.ref;
+            type = prefs->cur.type;
+            if (type == PVFS_TYPE_DATAFILE || type == PVFS_TYPE_DIRDATA)
+            {
+                remove_object(ref, type, creds);
             }
             else
             {
-                switch (getattr_resp.attr.objtype)
+                printf("# %s %llu was in removed directory %llu.\n",
+                       get_type_str(type), llu(ref.handle),
+                       llu(prefs->cur.handle));
+                ret = recfile_add(unrefd, ref.handle, PVFS_HANDLE_NULL,
+                                  type);
+            }
+        }
+        recfile_next(prefs);
+    }
+
+    return ret;
+}
+
+static int handle_compare(const void *a, const void *b)
+{
+    PVFS_handle ha = *(const PVFS_handle *) a;
+    PVFS_handle hb = *(const PVFS_handle *) b;
+
+    return (ha < hb) ? -1 : (ha > hb);
+}
+
+/* detach_entries()
+ *
+ * Removes the directory entries in detach, reading each directory once.
+ */
+int detach_entries(PVFS_fs_id cur_fs,
+                   PVFS_credential *creds,
+                   struct recfile *detach)
+{
+    PVFS_handle *children = NULL, *tmp;
+    int child_count, child_max = 0, i, ret;
+    PVFS_object_ref dir_ref, entry_ref;
+    PVFS_sysresp_readdir readdir_resp;
+    PVFS_ds_position token;
+
+    dir_ref.fs_id = cur_fs;
+    entry_ref.fs_id = cur_fs;
+
+    recfile_rewind(detach);
+    while (!detach->eof)
+    {
+        dir_ref.handle = detach->cur.handle;
+        child_count = 0;
+        while (!detach->eof && detach->cur.handle == dir_ref.handle)
+        {
+            if (child_count == child_max)
+            {
+                child_max = child_max ? child_max * 2 : 16;
+                tmp = realloc(children, child_max * sizeof(PVFS_handle));
+                if (tmp == NULL)
                 {
-                    case PVFS_TYPE_METAFILE:
-                        if (verify_datafiles(cur_fs,
-                                             hl,
-                                             alt_hl,
-                                             entry_ref,
-                                             getattr_resp.attr.dfile_count,
-                                             creds) < 0)
-                        {
-                            /* not recoverable; remove */
-                            printf("* File %s (%llu) is not recoverable.\n",
-                                   cur_file,
-                                   llu(cur_handle));
-
-                            /* verify_datafiles() removed the datafiles */
-                            ret = remove_object(entry_ref,
-                                                getattr_resp.attr.objtype,
-                                                creds);
-                            assert(ret == 0);
-
-                            ret = remove_directory_entry(dir_ref,
-                                                         entry_ref,
-                                                         cur_file,
-                                                         creds);
-                            assert(ret == 0);
-                        }
-                        
-                        break;
-                    case PVFS_TYPE_DIRECTORY:
-                        ret = match_dirdata(hl,
-                                            alt_hl,
-                                            entry_ref,
-                                            getattr_resp.attr.distr_dir_servers_max,
-                                            creds);
-                        if (ret != 0)
-                        {
-                            printf("* Directory %s (%llu) is missing DirData.\n",
-                                   cur_file,
-                                   llu(cur_handle));
-
-                            ret = remove_object(entry_ref,
-                                                getattr_resp.attr.objtype,
-                                                creds);
-                            assert(ret == 0);
-
-                            ret = remove_directory_entry(dir_ref,
-                                                         entry_ref,
-                                                         cur_file,
-                                                         creds);
-                            break;
-                        }
-
-                        if (in_main_list) {
-                            ret = descend(cur_fs,
-                                          hl,
-                                          alt_hl,
-                                          entry_ref,
-                                          creds);
-                            assert(ret == 0);
-                        }
-                        break;
-                    case PVFS_TYPE_SYMLINK:
-                        /* nothing to do */
-                        break;
-                    default:
-                        /* whatever this is, blow it away now. */
-                        ret = remove_object(entry_ref,
-                                            getattr_resp.attr.objtype,
-                                            creds);
-                        assert(ret == 0);
-                        
-                        ret = remove_directory_entry(dir_ref,
-                                                     entry_ref,
-                                                     cur_file,
-                                                     creds);
-                        assert(ret == 0);
-                        break;
+                    perror("malloc");
+                    free(children);
+                    return -1;
                 }
+                children = tmp;
             }
+            children[child_count++] = detach->cur.ref;
+            recfile_next(detach);
+        }
 
-            /* remove from appropriate handle list */
-            if (in_alt_list) {
-                handlelist_remove_handle(alt_hl, cur_handle, server_idx);
+        token = PVFS_READDIR_START;
+        do {
+            PVFS_util_refresh_credential(creds);
+            memset(&readdir_resp, 0, sizeof(PVFS_sysresp_readdir));
+            ret = PVFS_sys_readdir(dir_ref, token, FSCK_READDIR_COUNT,
+                                   creds, &readdir_resp, NULL);
+            if (ret != 0)
+            {
+                printf("warning: problem reading directory %llu.\n",
+                       llu(dir_ref.handle));
+                break;
+            }
+
+            for (i = 0; i < readdir_resp.pvfs_dirent_outcount; i++)
+            {
+                entry_ref.handle = readdir_resp.dirent_array[i].handle;
+                if (bsearch(&entry_ref.handle, children, child_count,
+                            sizeof(PVFS_handle), handle_compare))
+                {
+                    remove_directory_entry(dir_ref,
+                                           entry_ref,
+                                           readdir_resp.dirent_array[i].d_name,
+                                           creds);
+                }
+            }
+            token = readdir_resp.token;
+            if (readdir_resp.pvfs_dirent_outcount)
+            {
+                free(readdir_resp.dirent_array);
             }
-            else if (in_main_list) {
-                handlelist_remove_handle(hl, cur_handle, server_idx);
+        } while (readdir_resp.pvfs_dirent_outcount == FSCK_READDIR_COUNT);
+    }
+
+    free(children);
+    return 0;
+}
+
+/* salvage_orphans()
+ *
+ * Examines the orphans (skipping objects already removed as broken),
+ * works out which of them head an orphaned sub tree or file with the
+ * same join used for the directory tree, and links the heads into
+ * lost+found.
+ */
+int salvage_orphans(PVFS_fs_id cur_fs,
+                    PVFS_credential *creds,
+                    struct recfile *orphans,
+                    struct recfile *removed)
+{
+    static char filename[64] = "lostfile.";
+    static char dirname[64] = "lostdir.";
+    struct recfile *objs, *orefs, *oprefs, *heads, *omissing, *odetach;
+    struct walker w;
+    struct timeval start;
+    PVFS_object_ref ref;
+    PVFS_handle handle, last = PVFS_HANDLE_NULL;
+    int ret = -1, type;
+
+    gettimeofday(&start, NULL);
+
+    objs = recfile_create("orphan-objs");
+    orefs = recfile_create("orphan-refs");
+    oprefs = recfile_create("orphan-prefs");
+    heads = recfile_create("orphan-heads");
+    omissing = recfile_create("orphan-missing");
+    odetach = recfile_create("orphan-detach");
+    if (!objs || !orefs || !oprefs || !heads || !omissing || !odetach)
+    {
+        goto out;
+    }
+
+    memset(&w, 0, sizeof(w));
+    w.fs_id = cur_fs;
+    w.creds = creds;
+    w.orphan_mode = 1;
+    w.feed = orphans;
+    w.skip = removed;
+    w.last_fed = PVFS_HANDLE_NULL;
+    w.objs = objs;
+    w.refs = orefs;
+    w.prefs = oprefs;
+    window_init(&w.win);
+    recfile_rewind(orphans);
+    recfile_rewind(removed);
+
+    ret = walker_run(&w);
+    if (ret == 0)
+    {
+        report_rate("orphans examined", w.objects, &start);
+        ret = recfile_sort(objs);
+    }
+    if (ret == 0)
+    {
+        ret = recfile_sort(orefs);
+    }
+    if (ret == 0)
+    {
+        ret = recfile_sort(oprefs);
+    }
+    if (ret == 0)
+    {
+        ret = join_references(objs, NULL, orefs, heads, omissing, odetach);
+    }
+    if (ret == 0)
+    {
+        ret = recfile_sort(omissing);
+    }
+    if (ret == 0)
+    {
+        ret = repair_broken(cur_fs, creds, PVFS_HANDLE_NULL, omissing,
+                            orefs, oprefs, heads, odetach);
+    }
+    if (ret == 0)
+    {
+        ret = recfile_sort(odetach);
+    }
+    if (ret == 0)
+    {
+        ret = detach_entries(cur_fs, creds, odetach);
+    }
+    if (ret == 0)
+    {
+        ret = recfile_sort(heads);
+    }
+    if (ret != 0)
+    {
+        goto out;
+    }
+
+    ref.fs_id = cur_fs;
+    recfile_rewind(objs);
+    recfile_rewind(omissing);
+    while (!heads->eof)
+    {
+        handle = heads->cur.handle;
+        recfile_next(heads);
+        if (handle == last || recfile_seek(omissing, handle))
+        {
+            continue;
+        }
+        last = handle;
+
+        type = recfile_seek(objs, handle) ? objs->cur.type : PVFS_TYPE_NONE;
+        ref.handle = handle;
+
+        PVFS_util_refresh_credential(creds);
+        switch (type)
+        {
+            case PVFS_TYPE_METAFILE:
+		sprintf(filename + 9, "%llu", llu(handle));
+		ret = create_dirent(laf_ref,
+				    filename,
+				    handle,
+				    creds);
+                assert(ret == 0);
+                break;
+            case PVFS_TYPE_DIRECTORY:
+		sprintf(dirname + 8, "%llu", llu(handle));
+		ret = create_dirent(laf_ref,
+				    dirname,
+				    handle,
+				    creds);
+                if (ret != 0)
+                {
+                    remove_object(ref, type, creds);
+                }
+                break;
+            case PVFS_TYPE_SYMLINK:
+		printf("* not salvaging orphaned symlink %llu.\n",
+		       llu(handle));
+                break;
+            default:
+                remove_object(ref, type, creds);
+                break;
+        }
+    }
+    ret = 0;
+
+  out:
+    recfile_destroy(&objs);
+    recfile_destroy(&orefs);
+    recfile_destroy(&oprefs);
+    recfile_destroy(&heads);
+    recfile_destroy(&omissing);
+    recfile_destroy(&odetach);
+    return ret;
+}
+
+/********************************************/
+
+/* window_init()
+ *
+ * Sets up an empty window of at most the configured number of
+ * operations.
+ */
+static void window_init(struct op_window *win)
+{
+    memset(win, 0, sizeof(*win));
+    win->limit = fsck_opts->window;
+}
+
+/* window_add()
+ *
+ * Adds a posted operation to the window.  Operations that failed to
+ * post, or that ran to completion while being posted (op_id of -1),
+ * are kept aside and handed back by the next window_test().
+ */
+static void window_add(struct op_window *win,
+                       int ret,
+                       PVFS_sys_op_id op_id,
+                       void *user_ptr)
+{
+    assert(window_used(win) < FSCK_MAX_WINDOW);
+    if (ret < 0 || op_id == -1)
+    {
+        win->ready_ptrs[win->ready] = user_ptr;
+        win->ready_errors[win->ready] = (ret < 0) ? ret : 0;
+        win->ready++;
+        return;
+    }
+    win->op_ids[win->count] = op_id;
+    win->user_ptrs[win->count] = user_ptr;
+    win->count++;
+}
+
+static int window_used(struct op_window *win)
+{
+    return win->count + win->ready;
+}
+
+/* window_test()
+ *
+ * Waits briefly for operations in the window to complete.  Returns the
+ * number completed, with their user pointers and errors filled in, and
+ * takes them out of the window.
+ */
+static int window_test(struct op_window *win, void **user_ptrs, int *errors)
+{
+    PVFS_sys_op_id op_ids[FSCK_MAX_WINDOW];
+    int i, j, count = win->ready, ret;
+
+    if (count > 0)
+    {
+        memcpy(user_ptrs, win->ready_ptrs, count * sizeof(void *));
+        memcpy(errors, win->ready_errors, count * sizeof(int));
+        win->ready = 0;
+        return count;
+    }
+
+    count = win->count;
+    memcpy(op_ids, win->op_ids, count * sizeof(PVFS_sys_op_id));
+    ret = PVFS_sys_testsome(op_ids, &count, user_ptrs, errors,
+                            FSCK_TEST_TIMEOUT_MS);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_testsome", ret);
+        return ret;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        for (j = 0; j < win->count; j++)
+        {
+            if (win->op_ids[j] == op_ids[i])
+            {
+                win->count--;
+                win->op_ids[j] = win->op_ids[win->count];
+                win->user_ptrs[j] = win->user_ptrs[win->count];
+                break;
             }
         }
-        token = readdir_resp.token;
-        if (readdir_resp.pvfs_dirent_outcount)
+    }
+    return count;
+}
+
+/* window_drain()
+ *
+ * Waits out whatever is still in flight after an error, discarding the
+ * results.
+ */
+static void window_drain(struct op_window *win)
+{
+    void *done_ptrs[FSCK_MAX_WINDOW];
+    int errors[FSCK_MAX_WINDOW];
+
+    win->ready = 0;
+    while (win->count > 0)
+    {
+        if (window_test(win, done_ptrs, errors) < 0)
+        {
+            break;
+        }
+    }
+}
+
+/********************************************/
+
+/* recfile_create()
+ *
+ * Creates an empty record stream named after name in the scratch
+ * directory.
+ */
+static struct recfile *recfile_create(const char *name)
+{
+    struct recfile *rf;
+    int len;
+
+    rf = calloc(1, sizeof(*rf));
+    if (rf == NULL)
+    {
+        perror("malloc");
+        return NULL;
+    }
+
+    len = strlen(fsck_opts->scratch_dir) + strlen(name) + 64;
+    rf->path = malloc(len);
+    rf->buf = malloc(FSCK_RUN_RECORDS * sizeof(struct fsck_rec));
+    if (rf->path == NULL || rf->buf == NULL)
+    {
+        perror("malloc");
+        free(rf->path);
+        free(rf->buf);
+        free(rf);
+        return NULL;
+    }
+    snprintf(rf->path, len, "%s/pvfs2-fsck.%d.%s",
+             fsck_opts->scratch_dir, (int) getpid(), name);
+    rf->eof = 1;
+    return rf;
+}
+
+static int recfile_compare(const struct fsck_rec *a, const struct fsck_rec *b)
+{
+    if (a->handle != b->handle)
+    {
+        return (a->handle < b->handle) ? -1 : 1;
+    }
+    if (a->ref != b->ref)
+    {
+        return (a->ref < b->ref) ? -1 : 1;
+    }
+    return (a->type < b->type) ? -1 : (a->type > b->type);
+}
+
+static int recfile_qsort_compare(const void *a, const void *b)
+{
+    return recfile_compare(a, b);
+}
+
+static void recfile_run_path(struct recfile *rf, int run, char *buf, int len)
+{
+    snprintf(buf, len, "%s.%d", rf->path, run);
+}
+
+static FILE *recfile_open_run(struct recfile *rf, int run, const char *mode)
+{
+    char path[PATH_MAX];
+    FILE *fp;
+
+    recfile_run_path(rf, run, path, sizeof(path));
+    fp = fopen(path, mode);
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error: cannot open %s: %s\n", path, strerror(errno));
+    }
+    return fp;
+}
+
+/* recfile_flush()
+ *
+ * Sorts the buffered records and writes them out as the next run,
+ * dropping duplicates.
+ */
+static int recfile_flush(struct recfile *rf)
+{
+    FILE *fp;
+    int i, ret = 0;
+
+    qsort(rf->buf, rf->buf_count, sizeof(struct fsck_rec),
+          recfile_qsort_compare);
+
+    fp = recfile_open_run(rf, rf->next_run, "w");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    for (i = 0; i < rf->buf_count; i++)
+    {
+        if (i > 0 && recfile_compare(&rf->buf[i - 1], &rf->buf[i]) == 0)
+        {
+            continue;
+        }
+        if (fwrite(&rf->buf[i], sizeof(struct fsck_rec), 1, fp) != 1)
+        {
+            perror("fwrite");
+            ret = -1;
+            break;
+        }
+    }
+    if (fclose(fp) != 0 && ret == 0)
+    {
+        perror("fclose");
+        ret = -1;
+    }
+    rf->next_run++;
+    rf->buf_count = 0;
+    return ret;
+}
+
+static int recfile_add(struct recfile *rf,
+                       PVFS_handle handle,
+                       PVFS_handle ref,
+                       int type)
+{
+    struct fsck_rec *rec;
+
+    assert(rf->fp == NULL);
+
+    if (rf->buf_count == FSCK_RUN_RECORDS && recfile_flush(rf) != 0)
+    {
+        return -1;
+    }
+    rec = &rf->buf[rf->buf_count++];
+    memset(rec, 0, sizeof(*rec));
+    rec->handle = handle;
+    rec->ref = ref;
+    rec->type = type;
+    rf->count++;
+    return 0;
+}
+
+/* recfile_merge()
+ *
+ * Merges runs [first, first + count) into the next run with a heap of
+ * the current record of each input, dropping duplicates, and unlinks
+ * the inputs.
+ */
+static int recfile_merge(struct recfile *rf, int first, int count)
+{
+    FILE *in[FSCK_MERGE_FANIN], *out;
+    struct fsck_rec head[FSCK_MERGE_FANIN], last;
+    int heap[FSCK_MERGE_FANIN];
+    int i, n = 0, have_last = 0, ret = 0;
+    char path[PATH_MAX];
+
+    out = recfile_open_run(rf, rf->next_run, "w");
+    if (out == NULL)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        in[i] = recfile_open_run(rf, first + i, "r");
+        if (in[i] == NULL)
+        {
+            ret = -1;
+            continue;
+        }
+        if (fread(&head[i], sizeof(struct fsck_rec), 1, in[i]) == 1)
+        {
+            /* sift the new input up into the heap */
+            int c = n++, p, tmp;
+            heap[c] = i;
+            while (c > 0)
+            {
+                p = (c - 1) / 2;
+                if (recfile_compare(&head[heap[p]], &head[heap[c]]) <= 0)
+                {
+                    break;
+                }
+                tmp = heap[c];
+                heap[c] = heap[p];
+                heap[p] = tmp;
+                c = p;
+            }
+        }
+    }
+
+    while (ret == 0 && n > 0)
+    {
+        int top = heap[0], c, p, tmp;
+
+        if (!have_last || recfile_compare(&last, &head[top]) != 0)
+        {
+            if (fwrite(&head[top], sizeof(struct fsck_rec), 1, out) != 1)
+            {
+                perror("fwrite");
+                ret = -1;
+                break;
+            }
+            last = head[top];
+            have_last = 1;
+        }
+
+        if (fread(&head[top], sizeof(struct fsck_rec), 1, in[top]) != 1)
+        {
+            heap[0] = heap[--n];
+        }
+
+        /* sift the top down */
+        p = 0;
+        while ((c = 2 * p + 1) < n)
+        {
+            if (c + 1 < n &&
+                recfile_compare(&head[heap[c + 1]], &head[heap[c]]) < 0)
+            {
+                c++;
+            }
+            if (recfile_compare(&head[heap[p]], &head[heap[c]]) <= 0)
+            {
+                break;
+            }
+            tmp = heap[c];
+            heap[c] = heap[p];
+            heap[p] = tmp;
+            p = c;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (in[i])
         {
-            free(readdir_resp.dirent_array);
-            readdir_resp.dirent_array = NULL;
+            fclose(in[i]);
         }
-    } while (readdir_resp.pvfs_dirent_outcount == count);
-
-    if (readdir_resp.pvfs_dirent_outcount)
+        recfile_run_path(rf, first + i, path, sizeof(path));
+        unlink(path);
+    }
+    if (fclose(out) != 0 && ret == 0)
     {
-        free(readdir_resp.dirent_array);
-        readdir_resp.dirent_array = NULL;
+        perror("fclose");
+        ret = -1;
     }
-    return 0;
+    rf->next_run++;
+    return ret;
 }
 
-/* verify_datafiles()
+/* recfile_sort()
  *
- * Discovers the datafile handles for a given metafile,
- * verifies that they exist, and removes them from the handlelist.
- *
- * TODO: RENAME AS I FIGURE OUT WHAT EXACTLY I WANT THIS TO DO?
+ * Finishes adding records: writes out the last run and merges the runs
+ * FSCK_MERGE_FANIN at a time until one sorted run remains, then opens
+ * it for reading with the cursor on the first record.
  */
-int verify_datafiles(PVFS_fs_id cur_fs,
-		     struct handlelist *hl,
-		     struct handlelist *alt_hl,
-		     PVFS_object_ref mf_ref,
-		     int df_count,
-		     PVFS_credential *creds)
+static int recfile_sort(struct recfile *rf)
 {
-    int ret, i, server_idx = 0, error = 0;
-    PVFS_handle *df_handles;
+    int count;
 
-    df_handles = (PVFS_handle *) malloc(df_count * sizeof(PVFS_handle));
-    if (df_handles == NULL)
+    if ((rf->buf_count > 0 || rf->next_run == 0) && recfile_flush(rf) != 0)
     {
-	assert(0);
+        return -1;
     }
-    ret = PVFS_mgmt_get_dfile_array(mf_ref, creds, df_handles, df_count, NULL);
-    if (ret != 0)
+    free(rf->buf);
+    rf->buf = NULL;
+
+    while (rf->next_run - rf->first_run > 1)
     {
-	/* what does this mean? */
-	assert(0);
+        count = rf->next_run - rf->first_run;
+        if (count > FSCK_MERGE_FANIN)
+        {
+            count = FSCK_MERGE_FANIN;
+        }
+        if (recfile_merge(rf, rf->first_run, count) != 0)
+        {
+            return -1;
+        }
+        rf->first_run += count;
     }
 
-    for (i = 0; i < df_count; i++)
+    rf->fp = recfile_open_run(rf, rf->first_run, "r");
+    if (rf->fp == NULL)
     {
-	int in_main_list = 0, in_alt_list = 0;
-
-	if (handlelist_find_handle(hl, df_handles[i], &server_idx) == 0)
-	{
-	    in_main_list = 1;
-	}
-	else if (alt_hl &&
-		 (handlelist_find_handle(alt_hl,
-					 df_handles[i],
-					 &server_idx) == 0))
-	{
-	    in_alt_list = 1;
-	}
-
-	if ((!in_main_list) && (!in_alt_list))
-	{
-	    printf("# datafile handle %llu missing from list\n",
-		   llu(df_handles[i]));
-	    /* if possible, rebuild the datafile. */
-	    /* otherwise delete datafiles, return error to get 
-	     * handle and dirent removed.
-	     */
-	    df_handles[i] = PVFS_HANDLE_NULL;
-	    error++;
-	}
-
+        return -1;
     }
+    rf->eof = 0;
+    recfile_next(rf);
+    return 0;
+}
 
-    for (i = 0; i < df_count; i++)
+static void recfile_rewind(struct recfile *rf)
+{
+    if (rf->fp)
     {
-	if (df_handles[i] != PVFS_HANDLE_NULL) {
-	    /* TODO: THIS IS A HACK; NEED BETTER WAY TO REMOVE FROM
-	     * ONE OF TWO LISTS...
-	     */
-
-	    if (handlelist_find_handle(hl, df_handles[i], &server_idx) == 0)
-	    {
-		handlelist_remove_handle(hl,
-					 df_handles[i],
-					 server_idx);
-	    }
-	    else {
-		handlelist_remove_handle(alt_hl,
-					 df_handles[i],
-					 server_idx);
-	    }
-	}
+        rewind(rf->fp);
+        rf->eof = 0;
+        recfile_next(rf);
     }
-
-    free(df_handles);
-    return (error) ? -1 : 0;
 }
 
-struct handlelist *find_sub_trees(PVFS_fs_id cur_fs,
-				  struct handlelist *hl_all,
-				  PVFS_BMI_addr_t *addr_array,
-				  PVFS_credential *creds)
+/* recfile_next()
+ *
+ * Moves the cursor to the next record.  Returns 0 once past the end.
+ */
+static int recfile_next(struct recfile *rf)
 {
-    int ret;
-    int server_idx;
-    PVFS_handle handle;
-    struct handlelist *alt_hl;
-
-    /* TODO: DON'T DIRECTLY USE THESE MEMBERS... */
-    alt_hl = handlelist_initialize(hl_all->size_array,
-				   hl_all->server_ct);
-
-    /* make a pass working on directories first */
-    /* Q: do we want to try to figure out who the root of the tree
-     *    really is?  that could be tricky.  we could build this though.
-     */
-    while (handlelist_return_handle(hl_all,
-				    &handle,
-				    &server_idx) == 0)
-    {
-	PVFS_object_ref handle_ref;
-	PVFS_sysresp_getattr getattr_resp;
-
-	PVFS_util_refresh_credential(creds);
-
-	handle_ref.handle = handle;
-	handle_ref.fs_id  = cur_fs;
-
-	ret = PVFS_sys_getattr(handle_ref,
-			       PVFS_ATTR_SYS_ALL_NOHINT,
-			       creds,
-			       &getattr_resp, NULL);
-	if (ret) {
-	    /* remove anything we can't get attributes on */
-	    ret = remove_object(handle_ref,
-				0,
-				creds);
-	    continue;
-	}
-
-	switch (getattr_resp.attr.objtype)
-	{
-	    case PVFS_TYPE_METAFILE:
-		/* just hold onto this for now */
-		handlelist_add_handle(alt_hl, handle, server_idx);
-		break;
-	    case PVFS_TYPE_DIRECTORY:
-		/* add to directory list */
-		printf("# looking for dirdata array for %llu.\n", llu(handle));
-
-		descend(cur_fs,
-			hl_all,
-			alt_hl,
-			handle_ref,
-			creds);
-
-		handlelist_add_handle(alt_hl, handle, server_idx);
-		break;
-	    case PVFS_TYPE_DATAFILE:
-		/* save for later */
-		handlelist_add_handle(alt_hl, handle, server_idx);
-		break;
-	    case PVFS_TYPE_DIRDATA:
-		handlelist_add_handle(alt_hl, handle, server_idx);
-		break;
-	    case PVFS_TYPE_SYMLINK:
-		handlelist_add_handle(alt_hl, handle, server_idx);
-		break;
-	    default:
-		ret = remove_object(handle_ref,
-				    getattr_resp.attr.objtype,
-				    creds);
-		assert(ret == 0);
-		break;
-	}
-
+    if (rf->eof)
+    {
+        return 0;
     }
-
-    return alt_hl;
+    if (fread(&rf->cur, sizeof(struct fsck_rec), 1, rf->fp) != 1)
+    {
+        if (ferror(rf->fp))
+        {
+            fprintf(stderr, "Error: cannot read %s.%d\n",
+                    rf->path, rf->first_run);
+        }
+        rf->eof = 1;
+        return 0;
+    }
+    return 1;
 }
 
-
-struct handlelist *fill_lost_and_found(PVFS_fs_id cur_fs,
-				       struct handlelist *hl_all,
-				       PVFS_BMI_addr_t *addr_array,
-				       PVFS_credential *creds)
+/* recfile_seek()
+ *
+ * Moves the cursor forward to the first record at or past handle.
+ * Returns 1 if that record is for handle.
+ */
+static int recfile_seek(struct recfile *rf, PVFS_handle handle)
 {
-    int ret;
-    int server_idx;
-    PVFS_handle handle;
-    struct handlelist *alt_hl;
-    static char filename[64] = "lostfile.";
-    static char dirname[64] = "lostdir.";
-
-    /* TODO: DON'T DIRECTLY USE THESE MEMBERS... */
-    alt_hl = handlelist_initialize(hl_all->size_array,
-				   hl_all->server_ct);
-
-    /* recall that return_handle removes from list */
-    while (handlelist_return_handle(hl_all,
-				    &handle,
-				    &server_idx) == 0)
+    while (!rf->eof && rf->cur.handle < handle)
     {
-	PVFS_object_ref handle_ref;
-	PVFS_sysresp_getattr getattr_resp;
-
-	PVFS_util_refresh_credential(creds);
-
-	handle_ref.handle = handle;
-	handle_ref.fs_id  = cur_fs;
+        recfile_next(rf);
+    }
+    return (!rf->eof && rf->cur.handle == handle);
+}
 
-	ret = PVFS_sys_getattr(handle_ref,
-			       PVFS_ATTR_SYS_ALL_NOHINT,
-			       creds,
-			       &getattr_resp, NULL);
-	if (ret) {
-	    printf("warning: problem calling getattr on %llu; assuming datafile for now.\n",
-		   llu(handle));
-	    getattr_resp.attr.objtype = PVFS_TYPE_DATAFILE;
-	}
+static void recfile_destroy(struct recfile **rfp)
+{
+    struct recfile *rf = *rfp;
+    char path[PATH_MAX];
+    int i;
 
-	switch (getattr_resp.attr.objtype)
-	{
-	    case PVFS_TYPE_METAFILE:
-		printf("# trying to salvage %s %lld.\n",
-		       get_type_str(getattr_resp.attr.objtype),
-		       llu(handle));
-		if (verify_datafiles(cur_fs,
-				     hl_all,
-				     alt_hl,
-				     handle_ref, 
-				     getattr_resp.attr.dfile_count,
-				     creds) != 0)
-		{
-		    ret = remove_object(handle_ref,
-					getattr_resp.attr.objtype,
-					creds);
-		    assert(ret == 0);
-		}
-		else
-		{
-		    sprintf(filename + 9, "%llu", llu(handle));
-		    ret = create_dirent(laf_ref,
-					filename,
-					handle,
-					creds);
-                    assert(ret == 0);
-		}
-		break;
-	    case PVFS_TYPE_DIRECTORY:
-                /* assumption: we will often suceed in creating a new entry,
-                 * but if the file system is messed up we may not be able to
-                 * find dirdata, so match_dirdata before create_dirent */
-		if (match_dirdata(hl_all,
-				    alt_hl,
-				    handle_ref,
-                                    getattr_resp.attr.distr_dir_servers_max,
-				    creds)  != 0)
-                {
-                    ret = remove_object(handle_ref, 
-                            getattr_resp.attr.objtype,
-                            creds);
-                    assert(ret == 0);
-                }
+    if (rf == NULL)
+    {
+        return;
+    }
+    if (rf->fp)
+    {
+        fclose(rf->fp);
+    }
+    for (i = rf->first_run; i < rf->next_run; i++)
+    {
+        recfile_run_path(rf, i, path, sizeof(path));
+        unlink(path);
+    }
+    free(rf->buf);
+    free(rf->path);
+    free(rf);
+    *rfp = NULL;
+}
 
-		sprintf(dirname + 8, "%llu", llu(handle));
-		ret = create_dirent(laf_ref,
-				    dirname,
-				    handle,
-				    creds);
-                if (ret != 0)
-                {
-                    ret = remove_object(handle_ref,
-                            getattr_resp.attr.objtype,
-                            creds);
-                }
+/********************************************/
 
-		break;
-	    case PVFS_TYPE_DATAFILE:
-#if 0
-		printf("# saving %llu (datafile) for later.\n", llu(handle));
-#endif
-		handlelist_add_handle(alt_hl, handle, server_idx);
-		break;
-	    case PVFS_TYPE_DIRDATA:
-#if 0
-		printf("# saving %llu (dirdata) for later.\n", llu(handle));
-#endif
-		handlelist_add_handle(alt_hl, handle, server_idx);
-		break;
-	    case PVFS_TYPE_SYMLINK:
-	    default:
-		/* delete on handle -- unknown type */
-		printf("* delete handle %llu (unknown type).\n",
-		       llu(handle));
-		break;
-	}
+static struct dirqueue *dirqueue_create(void)
+{
+    struct dirqueue *dq;
+    int len;
 
+    dq = calloc(1, sizeof(*dq));
+    if (dq == NULL)
+    {
+        perror("malloc");
+        return NULL;
     }
-
-    return alt_hl;
+    len = strlen(fsck_opts->scratch_dir) + 64;
+    dq->path = malloc(len);
+    if (dq->path == NULL)
+    {
+        perror("malloc");
+        free(dq);
+        return NULL;
+    }
+    snprintf(dq->path, len, "%s/pvfs2-fsck.%d.dirs",
+             fsck_opts->scratch_dir, (int) getpid());
+    dq->fp = fopen(dq->path, "w+");
+    if (dq->fp == NULL)
+    {
+        fprintf(stderr, "Error: cannot open %s: %s\n", dq->path,
+                strerror(errno));
+        free(dq->path);
+        free(dq);
+        return NULL;
+    }
+    return dq;
 }
 
-void cull_leftovers(PVFS_fs_id cur_fs,
-		    struct handlelist *hl_all,
-		    PVFS_BMI_addr_t *addr_array,
-		    PVFS_credential *creds)
+static int dirqueue_push(struct dirqueue *dq, PVFS_handle handle)
 {
-    int ret;
-    int server_idx;
-    PVFS_handle handle;
-
-    /* recall that return_handle removes from list */
-    while (handlelist_return_handle(hl_all,
-				    &handle,
-				    &server_idx) == 0)
+    if (fseeko(dq->fp, dq->tail, SEEK_SET) != 0 ||
+        fwrite(&handle, sizeof(handle), 1, dq->fp) != 1)
     {
-	PVFS_object_ref handle_ref;
-	PVFS_sysresp_getattr getattr_resp;
-
-	PVFS_util_refresh_credential(creds);
-
-	handle_ref.handle = handle;
-	handle_ref.fs_id  = cur_fs;
+        perror("fwrite");
+        return -1;
+    }
+    dq->tail += sizeof(handle);
+    return 0;
+}
 
-	ret = PVFS_sys_getattr(handle_ref,
-			       PVFS_ATTR_SYS_ALL_NOHINT,
-			       creds,
-			       &getattr_resp, NULL);
-	if (ret) {
-	    printf("warning: problem calling getattr on %llu\n",
-		   llu(handle));
-	    getattr_resp.attr.objtype = 0;
-	}
+static int dirqueue_pop(struct dirqueue *dq, PVFS_handle *handle)
+{
+    if (dq->head == dq->tail)
+    {
+        return -1;
+    }
+    if (fseeko(dq->fp, dq->head, SEEK_SET) != 0 ||
+        fread(handle, sizeof(*handle), 1, dq->fp) != 1)
+    {
+        perror("fread");
+        return -1;
+    }
+    dq->head += sizeof(*handle);
+    return 0;
+}
 
-	/* metafile and directory handles should have been removed
-	 * in the previous pass.
-	 */
-	assert(getattr_resp.attr.objtype != PVFS_TYPE_METAFILE);
-	assert(getattr_resp.attr.objtype != PVFS_TYPE_DIRECTORY);
+static void dirqueue_destroy(struct dirqueue **dqp)
+{
+    struct dirqueue *dq = *dqp;
 
-	ret = remove_object(handle_ref,
-			    getattr_resp.attr.objtype,
-			    creds);
-	assert(ret == 0);
+    if (dq == NULL)
+    {
+        return;
     }
+    fclose(dq->fp);
+    unlink(dq->path);
+    free(dq->path);
+    free(dq);
+    *dqp = NULL;
 }
 
 /********************************************/
@@ -1330,291 +2247,6 @@ int remove_object(PVFS_object_ref obj_ref,
     return 0;
 }
 
-/********************************************/
-
-/* handlelist_initialize()
- *
- * handle_counts - array of counts per server
- * server_count  - number of servers
- */
-static struct handlelist *handlelist_initialize(unsigned long *handle_counts,
-						int server_count)
-{
-    int i;
-    struct handlelist *hl;
-
-    do {
-        hl = (struct handlelist *) calloc(1, sizeof(struct handlelist));
-        if (hl == NULL)
-            goto err;
-
-        hl->server_ct = server_count;
-        hl->list_array = (PVFS_handle **) calloc(server_count, sizeof(PVFS_handle *));
-        if (hl->list_array == NULL)
-        {
-            free(hl);
-            goto err;
-        }
-        hl->size_array = (unsigned long *) calloc(server_count, sizeof(unsigned long));
-        if (hl->size_array == NULL)
-        {
-            free(hl->list_array);
-            free(hl);
-            goto err;
-        }
-        hl->used_array = (unsigned long *) calloc(server_count, sizeof(unsigned long));
-        if (hl->used_array == NULL)
-        {
-            free(hl->size_array);
-            free(hl->list_array);
-            free(hl);
-            goto err;
-        }
-        for (i = 0; i < server_count; i++) 
-        {
-            hl->list_array[i] = (PVFS_handle *) calloc(handle_counts[i], sizeof(PVFS_handle));
-            if (hl->list_array[i] == NULL)
-                break;
-            hl->size_array[i] = handle_counts[i];
-            hl->used_array[i] = 0;
-        }
-        if (i != server_count)
-        {
-            int j;
-            for (j = 0; j < i; j++) {
-                free(hl->list_array[j]);
-            }
-            goto err;
-        }
-        return hl;
-    } while (0);
-err:
-    return NULL;
-}
-
-/* handlelist_add_handles()
- *
- * Adds an array of new handle values to the list of handles for
- * a particular server.
- */
-static void handlelist_add_handles(struct handlelist *hl,
-				   PVFS_handle *handles,
-				   unsigned long handle_count,
-				   int server_idx)
-{
-    unsigned long i, start_off;
-
-    start_off = hl->used_array[server_idx];
-
-    if ((hl->size_array[server_idx] - start_off) < handle_count)
-    {
-        fprintf(stderr, "server %d, exceeding number of handles it declared (%ld), currently (%ld)\n",
-                server_idx, hl->size_array[server_idx], (start_off + handle_count));
-	assert(0);
-    }
-
-    for (i = 0; i < handle_count; i++) {
-	hl->list_array[server_idx][start_off + i] = handles[i];
-    }
-
-    hl->used_array[server_idx] += handle_count;
-
-}
-
-static void handlelist_add_handle(struct handlelist *hl,
-				  PVFS_handle handle,
-				  int server_idx)
-{
-    unsigned long start_off;
-
-    start_off = hl->used_array[server_idx];
-
-    if ((hl->size_array[server_idx] - start_off) < 1)
-    {
-        fprintf(stderr, "server %d, exceeding number of handles it declared (%ld), currently (%ld)\n",
-                server_idx, hl->size_array[server_idx], (start_off + 1));
-	assert(0);
-    }
-
-    hl->list_array[server_idx][start_off] = handle;
-    hl->used_array[server_idx]++;
-}
-
-static void handlelist_finished_adding_handles(struct handlelist *hl)
-{
-    int i;
-    
-    for (i = 0; i < hl->server_ct; i++) {
-	if (hl->used_array[i] != hl->size_array[i]) {
-	    printf("warning: only found %ld of %ld handles for server %d.\n",
-		   hl->used_array[i],
-		   hl->size_array[i],
-		   i);
-	}
-    }
-}
-
-/* handlelist_find_handle()
- *
- * Looks to see if a particular {handle, server} pair exists in the
- * handlelist for some server_idx.  Returns 0 on success (presence),
- * -1 on failure (absence).  On success also fills in server_idx.
- */
-static int handlelist_find_handle(struct handlelist *hl,
-				  PVFS_handle handle,
-				  int *server_idx_p)
-{
-    int i;
-
-    for (i = 0; i < hl->server_ct; i++) {
-	int j;
-
-	for (j = 0; j < hl->used_array[i]; j++) {
-	    if (hl->list_array[i][j] == handle) {
-		*server_idx_p = i;
-		return 0;
-	    }
-	}
-    }
-
-    return -1;
-}
-
-/* handlelist_remove_handle_no_idx()
- *
- * same as handlelist_remove_handle(), but will search for the correct
- * server index
- */
-/* TODO: we could speed this up by resolving which server the handle
- * belongs to using the cached_config api
- */
-static void handlelist_remove_handle_no_idx(struct handlelist *hl,
-				     PVFS_handle handle)
-{
-    unsigned long i;
-    int server_idx = 0;
-    int found = 0;
-
-    for(server_idx = 0; server_idx<hl->server_ct; server_idx++)
-    {
-        for (i = 0; i < hl->used_array[server_idx]; i++)
-        {
-            if (hl->list_array[server_idx][i] == handle)
-            {
-                if (i < (hl->used_array[server_idx] - 1))
-                {
-                    /* move last entry to this position before decrement */
-                    hl->list_array[server_idx][i] =
-                        hl->list_array[server_idx][hl->used_array[server_idx]-1];
-                    
-                }
-                hl->used_array[server_idx]--;
-                found = 1;
-                break;
-            }
-        }
-        if(found)
-        {
-            break;
-        }
-    }
-
-    if (!found) {
-	printf("! problem removing %llu.\n", llu(handle));
-    }
-}
-
-static void handlelist_remove_handle(struct handlelist *hl,
-				     PVFS_handle handle,
-				     int server_idx)
-{
-    unsigned long i;
-
-    assert(server_idx < hl->server_ct);
-
-    for (i = 0; i < hl->used_array[server_idx]; i++)
-    {
-	if (hl->list_array[server_idx][i] == handle)
-	{
-	    if (i < (hl->used_array[server_idx] - 1))
-	    {
-		/* move last entry to this position before decrement */
-		hl->list_array[server_idx][i] =
-		    hl->list_array[server_idx][hl->used_array[server_idx]-1];
-		
-	    }
-	    hl->used_array[server_idx]--;
-	    break;
-	}
-    }
-
-    if (i > hl->used_array[server_idx]) {
-	printf("! problem removing %llu/%d.\n", llu(handle), server_idx);
-    }
-
-    assert(i <= hl->used_array[server_idx]); /* <= because of decrement! */
-}
-
-/* handlelist_return_handle()
- *
- * Places some handle still in the handlelist in the location pointed
- * to by handle_p, removing it from the list.
- *
- * Returns 0 on success, -1 on failure (out of handles).
- */
-static int handlelist_return_handle(struct handlelist *hl,
-				    PVFS_handle *handle_p,
-				    int *server_idx_p)
-{
-    int i;
-
-    for (i = 0; i < hl->server_ct; i++)
-    {
-	if (hl->used_array[i] > 0) {
-	    *handle_p = hl->list_array[i][hl->used_array[i]-1];
-	    hl->used_array[i]--;
-	    *server_idx_p = i;
-	    return 0;
-	}
-    }
-    return -1;
-}
-
-static void handlelist_finalize(struct handlelist **hlp)
-{
-    int i;
-    struct handlelist *hl = *hlp;
-
-    for (i=0; i < hl->server_ct; i++)
-    {
-	free(hl->list_array[i]);
-    }
-
-    free(hl->list_array);
-    free(hl->size_array);
-    free(hl->used_array);
-
-    free(hl);
-
-    *hlp = NULL;
-
-    return;
-}
-
-#if 0
-static void handlelist_print(struct handlelist *hl)
-{
-    unsigned long i;
-
-    /* NOTE: REALLY ONLY PRINTS FOR ONE SERVER RIGHT NOW */
-    for (i=0; i < hl->used_array[0]; i++) {
-	printf("%llu ", llu(hl->list_array[0][i]));
-    }
-    printf("\n");
-}
-#endif
-
-
 /**********************************************/
 
 static struct options *parse_args(int argc, char *argv[])
@@ -1629,9 +2261,11 @@ static struct options *parse_args(int argc, char *argv[])
 	return NULL;
     }
     memset(opts, 0, sizeof(struct options));
+    opts->scratch_dir = FSCK_DEFAULT_SCRATCH_DIR;
+    opts->window = FSCK_DEFAULT_WINDOW;
 
     /* look at command line arguments */
-    while((one_opt = getopt(argc, argv, "apyns:vVm:")) != EOF){
+    while((one_opt = getopt(argc, argv, "apyns:vVm:d:j:")) != EOF){
 	switch(one_opt)
         {
 	    case 'a':
@@ -1646,6 +2280,19 @@ static struct options *parse_args(int argc, char *argv[])
                 opts->safety_count = atoi(optarg);
                 opts->safety_check = 1;
                 break;
+            case 'd':
+                opts->scratch_dir = optarg;
+                break;
+            case 'j':
+                opts->window = atoi(optarg);
+                if (opts->window < 1 || opts->window > FSCK_MAX_WINDOW)
+                {
+                    fprintf(stderr, "Error: -j must be between 1 and %d.\n",
+                            FSCK_MAX_WINDOW);
+                    free(opts);
+                    return NULL;
+                }
+                break;
             case 'V':
                 printf("%s\n", PVFS2_VERSION);
                 exit(0);
@@ -1693,7 +2340,8 @@ static struct options *parse_args(int argc, char *argv[])
 static void usage(int argc, char** argv)
 {
     fprintf(stderr, "\n");
-    fprintf(stderr, "Usage  : %s [-vV] <-ayp -s N> [-m fs_mount_point]\n",
+    fprintf(stderr, "Usage  : %s [-vV] <-ayp -s N> [-d dir] [-j N] "
+            "[-m fs_mount_point]\n",
 	argv[0]);
     fprintf(stderr, "Display information about contents of file system.\n");
     fprintf(stderr, "  -V              print version and exit\n");
@@ -1704,6 +2352,12 @@ static void usage(int argc, char** argv)
     fprintf(stderr, "  -y              answer \"yes\" to all questions\n");
     fprintf(stderr, "  -p              automatically repair with no questions\n");
     fprintf(stderr, "  -a              equivalent to \"-p\"\n");
+    fprintf(stderr, "  -d dir          directory for sorted scratch files "
+                                       "(default %s)\n",
+            FSCK_DEFAULT_SCRATCH_DIR);
+    fprintf(stderr, "  -j N            operations kept in flight at once "
+                                       "(default %d, max %d)\n",
+            FSCK_DEFAULT_WINDOW, FSCK_MAX_WINDOW);
 
     fprintf(stderr, "Example: %s -m /mnt/pvfs2\n",
 	argv[0]);
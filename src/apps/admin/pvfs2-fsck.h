@@ -7,56 +7,107 @@
 #ifndef __PVFS2_FSCK_H
 #define __PVFS2_FSCK_H
 
+/* operations kept in flight at once; testsome() returns at most 256 */
+#define FSCK_MAX_WINDOW 256
+
+/* one (handle, reference, type) record.  Inventory records have a ref
+ * of PVFS_HANDLE_NULL; reference records name the object that refers
+ * to the handle (the directory holding an entry, the metafile owning a
+ * datafile, and so on).
+ */
+struct fsck_rec
+{
+    PVFS_handle handle;
+    PVFS_handle ref;
+    int32_t type;
+    int32_t __pad1;
+};
+
+/* a stream of records kept on disk as sorted runs in the scratch
+ * directory.  Records are added in any order; recfile_sort() merges the
+ * runs into a single sorted file that is then read with a cursor.
+ */
+struct recfile
+{
+    char *path;
+    struct fsck_rec *buf;
+    int buf_count;
+    int first_run;
+    int next_run;
+    FILE *fp;
+    struct fsck_rec cur;
+    int eof;
+    uint64_t count;
+};
+
+/* FIFO of directory handles still to be read during the traversal */
+struct dirqueue
+{
+    char *path;
+    FILE *fp;
+    off_t head;
+    off_t tail;
+};
+
+/* asynchronous operations in flight, completed through testsome() */
+struct op_window
+{
+    int limit;
+    int count;
+    PVFS_sys_op_id op_ids[FSCK_MAX_WINDOW];
+    void *user_ptrs[FSCK_MAX_WINDOW];
+    int ready;
+    void *ready_ptrs[FSCK_MAX_WINDOW];
+    int ready_errors[FSCK_MAX_WINDOW];
+};
+
+
 /* utility functions */
 static struct options *parse_args(int argc, char* argv[]);
 static void usage(int argc, char** argv);
 static char *get_type_str(int type);
+static void report_rate(const char *what,
+                        uint64_t count,
+                        const struct timeval *start);
 
 /* processing functions */
-struct handlelist *build_handlelist(PVFS_fs_id cur_fs,
-				    PVFS_BMI_addr_t *addr_array,
-				    int server_count,
-				    PVFS_credential *creds);
+int build_inventory(PVFS_fs_id cur_fs,
+                    PVFS_BMI_addr_t *addr_array,
+                    int server_count,
+                    PVFS_credential *creds,
+                    struct recfile *inventory,
+                    struct recfile *reserved);
 
 int traverse_directory_tree(PVFS_fs_id cur_fs,
-			    struct handlelist *hl,
-			    PVFS_BMI_addr_t *addr_array,
-			    int server_count,
-			    PVFS_credential *creds);
-
-int match_dirdata(struct handlelist *hl,
-		  struct handlelist *alt_hl,
-		  PVFS_object_ref dir_ref,
-                  int dh_count,
-		  PVFS_credential *creds);
-
-int descend(PVFS_fs_id cur_fs,
-	    struct handlelist *hl,
-	    struct handlelist *alt_hl,
-	    PVFS_object_ref pref,
-	    PVFS_credential *creds);
-
-int verify_datafiles(PVFS_fs_id cur_fs,
-		     struct handlelist *hl,
-		     struct handlelist *alt_hl,
-		     PVFS_object_ref mf_ref,
-		     int df_count,
-		     PVFS_credential *creds);
-
-struct handlelist *find_sub_trees(PVFS_fs_id cur_fs,
-				  struct handlelist *hl,
-				  PVFS_id_gen_t *addr_array,
-				  PVFS_credential *creds);
-
-struct handlelist *fill_lost_and_found(PVFS_fs_id cur_fs,
-				       struct handlelist *hl,
-				       PVFS_id_gen_t *addr_array,
-				       PVFS_credential *creds);
-
-void cull_leftovers(PVFS_fs_id cur_fs,
-		    struct handlelist *hl,
-		    PVFS_id_gen_t *addr_array,
-		    PVFS_credential *creds);
+			    PVFS_credential *creds,
+			    struct recfile *refs,
+			    struct recfile *prefs,
+			    PVFS_handle *root_handle);
+
+int join_references(struct recfile *objs,
+                    struct recfile *reserved,
+                    struct recfile *refs,
+                    struct recfile *unrefd,
+                    struct recfile *missing,
+                    struct recfile *detach);
+
+int repair_broken(PVFS_fs_id cur_fs,
+                  PVFS_credential *creds,
+                  PVFS_handle root_handle,
+                  struct recfile *missing,
+                  struct recfile *refs,
+                  struct recfile *prefs,
+                  struct recfile *unrefd,
+                  struct recfile *detach);
+
+int detach_entries(PVFS_fs_id cur_fs,
+                   PVFS_credential *creds,
+                   struct recfile *detach);
+
+int salvage_orphans(PVFS_fs_id cur_fs,
+                    PVFS_credential *creds,
+                    struct recfile *orphans,
+                    struct recfile *removed);
 
 /* fs modification functions */
 int create_lost_and_found(PVFS_fs_id cur_fs,
@@ -76,45 +127,54 @@ int remove_directory_entry(PVFS_object_ref dir_ref,
 			   char *name,
 			   PVFS_credential *creds);
 
-/* handlelist structure, functions */
-struct handlelist {
-    int server_ct;
-    PVFS_handle **list_array;
-    unsigned long *size_array;
-    unsigned long *used_array;
-};
+/* async operation window functions */
+static void window_init(struct op_window *win);
 
-static struct handlelist *handlelist_initialize(unsigned long *handle_counts,
-						int server_count);
+static void window_add(struct op_window *win,
+                       int ret,
+                       PVFS_sys_op_id op_id,
+                       void *user_ptr);
 
-static void handlelist_add_handle(struct handlelist *hl,
-				  PVFS_handle handles,
-				  int server_idx);
+static int window_used(struct op_window *win);
 
-static void handlelist_add_handles(struct handlelist *hl,
-				   PVFS_handle *handles,
-				   unsigned long handle_count,
-				   int server_idx);
+static int window_test(struct op_window *win,
+                       void **user_ptrs,
+                       int *errors);
 
-static void handlelist_finished_adding_handles(struct handlelist *hl);
+static void window_drain(struct op_window *win);
 
-static int handlelist_find_handle(struct handlelist *hl,
-				  PVFS_handle handle,
-				  int *server_idx_p);
+/* recfile functions */
+static struct recfile *recfile_create(const char *name);
 
-static void handlelist_remove_handle(struct handlelist *hl,
-				     PVFS_handle handle,
-				     int server_idx);
+static int recfile_add(struct recfile *rf,
+                       PVFS_handle handle,
+                       PVFS_handle ref,
+                       int type);
 
-static int handlelist_return_handle(struct handlelist *hl,
-				    PVFS_handle *handle_p,
-				    int *server_idx_p);
+static int recfile_sort(struct recfile *rf);
 
-static void handlelist_finalize(struct handlelist **hl);
+static int recfile_compare(const struct fsck_rec *a,
+                           const struct fsck_rec *b);
 
-#if 0
-static void handlelist_print(struct handlelist *hl);
-#endif
+static void recfile_rewind(struct recfile *rf);
+
+static int recfile_next(struct recfile *rf);
+
+static int recfile_seek(struct recfile *rf,
+                        PVFS_handle handle);
+
+static void recfile_destroy(struct recfile **rfp);
+
+/* dirqueue functions */
+static struct dirqueue *dirqueue_create(void);
+
+static int dirqueue_push(struct dirqueue *dq,
+                         PVFS_handle handle);
+
+static int dirqueue_pop(struct dirqueue *dq,
+                        PVFS_handle *handle);
+
+static void dirqueue_destroy(struct dirqueue **dqp);
 
 #endif
 
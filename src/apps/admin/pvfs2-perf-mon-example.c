@@ -27,7 +27,7 @@
 #define PVFS2_VERSION "Unknown"
 #endif
 
-#define MAX_KEY_CNT 23
+#define MAX_KEY_CNT 28
 /* macros for accessing data returned from server */
 #define VALID_FLAG(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + key_cnt] != 0.0)
 #define ID(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + key_cnt])
@@ -56,6 +56,11 @@
 #define IO(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 20])
 #define SMALLIO(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 21])
 #define READDIR(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 22])
+#define BCACHE_HITS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 23])
+#define BCACHE_MISSES(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 24])
+#define ACACHE_HITS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 25])
+#define ACACHE_MISSES(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 26])
+#define ACACHE_EVICTIONS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 27])
 
 int key_cnt; /* holds the Number of keys */
 
@@ -322,6 +327,11 @@ int main(int argc, char **argv)
             PRINT_COUNTER("\nrmdir:   ", RMDIRS(i, j));
             PRINT_COUNTER("\ngetattrs: ", GETATTRS(i, j));
             PRINT_COUNTER("\nsetattrs: ", SETATTRS(i, j));
+            PRINT_COUNTER("\ncache hits: ", BCACHE_HITS(i, j));
+            PRINT_COUNTER("\ncache misses: ", BCACHE_MISSES(i, j));
+            PRINT_COUNTER("\nattr cache hits: ", ACACHE_HITS(i, j));
+            PRINT_COUNTER("\nattr cache misses: ", ACACHE_MISSES(i, j));
+            PRINT_COUNTER("\nattr cache evictions: ", ACACHE_EVICTIONS(i, j));
 	    PRINT_COUNTER("\ntimestep: ", (unsigned)ID(i, j));
 	    printf("\n");
 	}
@@ -0,0 +1,315 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Dumps the request trace buffers of all servers (see the
+ * RequestTraceEntries server option) in Chrome trace event JSON format,
+ * suitable for chrome://tracing or Perfetto.  Each server is shown as a
+ * process and each client request as a thread within it.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "pvfs2.h"
+#include "pvfs2-mgmt.h"
+#include "pvfs2-event.h"
+#include "pvfs2-internal.h"
+
+#ifndef PVFS2_VERSION
+#define PVFS2_VERSION "Unknown"
+#endif
+
+#define DEFAULT_EVENT_DEPTH 2048
+
+struct options
+{
+    char *mnt_point;
+    int mnt_point_set;
+    int depth;
+    uint32_t request_id;
+    int request_id_set;
+    char *out_file;
+};
+
+static struct options *parse_args(int argc, char *argv[]);
+static void usage(int argc, char **argv);
+static const char *trace_kind_name(int32_t kind);
+
+int main(int argc, char **argv)
+{
+    int ret = -1;
+    PVFS_fs_id cur_fs;
+    struct options *user_opts = NULL;
+    char pvfs_path[PVFS_NAME_MAX] = {0};
+    int i, j;
+    PVFS_credential cred;
+    int server_count;
+    int server_type;
+    struct PVFS_mgmt_event **event_matrix;
+    struct PVFS_mgmt_event *ev;
+    PVFS_BMI_addr_t *addr_array;
+    FILE *out = stdout;
+    int first = 1;
+
+    user_opts = parse_args(argc, argv);
+    if (!user_opts)
+    {
+        fprintf(stderr, "Error: failed to parse command line arguments.\n");
+        usage(argc, argv);
+        return -1;
+    }
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return -1;
+    }
+
+    ret = PVFS_util_resolve(user_opts->mnt_point,
+                            &cur_fs, pvfs_path, PVFS_NAME_MAX);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_resolve", ret);
+        return -1;
+    }
+
+    ret = PVFS_util_gen_credential_defaults(&cred);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_gen_credential_defaults", ret);
+        return -1;
+    }
+
+    ret = PVFS_mgmt_count_servers(cur_fs,
+                                  PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                                  &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_count_servers", ret);
+        return -1;
+    }
+
+    event_matrix = (struct PVFS_mgmt_event **)
+        malloc(server_count * sizeof(struct PVFS_mgmt_event *));
+    addr_array = (PVFS_BMI_addr_t *)
+        malloc(server_count * sizeof(PVFS_BMI_addr_t));
+    if (!event_matrix || !addr_array)
+    {
+        perror("malloc");
+        return -1;
+    }
+    for (i = 0; i < server_count; i++)
+    {
+        event_matrix[i] = (struct PVFS_mgmt_event *)
+            calloc(user_opts->depth, sizeof(struct PVFS_mgmt_event));
+        if (!event_matrix[i])
+        {
+            perror("malloc");
+            return -1;
+        }
+    }
+
+    ret = PVFS_mgmt_get_server_array(cur_fs,
+                                     PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                                     addr_array,
+                                     &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_get_server_array", ret);
+        return -1;
+    }
+
+    ret = PVFS_mgmt_event_mon_list(cur_fs,
+                                   &cred,
+                                   event_matrix,
+                                   addr_array,
+                                   server_count,
+                                   user_opts->depth,
+                                   NULL,
+                                   NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_event_mon_list", ret);
+        return -1;
+    }
+
+    if (user_opts->out_file)
+    {
+        out = fopen(user_opts->out_file, "w");
+        if (!out)
+        {
+            perror(user_opts->out_file);
+            return -1;
+        }
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (i = 0; i < server_count; i++)
+    {
+        fprintf(out, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", i,
+                PVFS_mgmt_map_addr(cur_fs, addr_array[i], &server_type));
+        first = 0;
+
+        for (j = 0; j < user_opts->depth; j++)
+        {
+            ev = &event_matrix[i][j];
+            if (ev->flags & PVFS_EVENT_FLAG_INVALID)
+            {
+                continue;
+            }
+            if (user_opts->request_id_set &&
+                (uint32_t)(ev->id & 0xffffffff) != user_opts->request_id)
+            {
+                continue;
+            }
+            /* one thread per client request so that the spans of a
+             * request nest under its REQUEST span
+             */
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"op%d\",\"ph\":\"X\","
+                    "\"pid\":%d,\"tid\":%llu,\"ts\":%lld,\"dur\":%lld,"
+                    "\"args\":{\"client\":%u,\"request\":%u,\"op\":%d}}",
+                    trace_kind_name(ev->api), (int)ev->operation, i,
+                    llu(ev->id),
+                    lld((int64_t)ev->tv_sec * 1000000 + ev->tv_usec),
+                    lld(ev->value),
+                    (unsigned)(ev->id >> 32),
+                    (unsigned)(ev->id & 0xffffffff),
+                    (int)ev->operation);
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    for (i = 0; i < server_count; i++)
+    {
+        free(event_matrix[i]);
+    }
+    free(event_matrix);
+    free(addr_array);
+
+    PVFS_sys_finalize();
+
+    return 0;
+}
+
+static const char *trace_kind_name(int32_t kind)
+{
+    switch (kind)
+    {
+        case PVFS_EVENT_TRACE_REQUEST:
+            return "request";
+        case PVFS_EVENT_TRACE_UNEXP:
+            return "unexp_recv";
+        case PVFS_EVENT_TRACE_REQ_SCHED:
+            return "req_sched";
+        case PVFS_EVENT_TRACE_BMI:
+            return "bmi";
+        case PVFS_EVENT_TRACE_TROVE:
+            return "trove";
+        case PVFS_EVENT_TRACE_FLOW:
+            return "flow";
+        case PVFS_EVENT_TRACE_RESPONSE:
+            return "response";
+        default:
+            return "job";
+    }
+}
+
+/* parse_args()
+ *
+ * parses command line arguments
+ *
+ * returns pointer to options structure on success, NULL on failure
+ */
+static struct options *parse_args(int argc, char *argv[])
+{
+    char flags[] = "vm:n:r:o:";
+    int one_opt = 0;
+    struct options *tmp_opts = NULL;
+
+    tmp_opts = (struct options *) malloc(sizeof(struct options));
+    if (tmp_opts == NULL)
+    {
+        return NULL;
+    }
+    memset(tmp_opts, 0, sizeof(struct options));
+    tmp_opts->depth = DEFAULT_EVENT_DEPTH;
+
+    while ((one_opt = getopt(argc, argv, flags)) != EOF)
+    {
+        switch (one_opt)
+        {
+            case('v'):
+                printf("%s\n", PVFS2_VERSION);
+                exit(0);
+            case('m'):
+                /* trailing slash expected by PVFS_util_resolve() */
+                tmp_opts->mnt_point = (char *) malloc(strlen(optarg) + 2);
+                if (tmp_opts->mnt_point == NULL)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                sprintf(tmp_opts->mnt_point, "%s/", optarg);
+                tmp_opts->mnt_point_set = 1;
+                break;
+            case('n'):
+                tmp_opts->depth = atoi(optarg);
+                if (tmp_opts->depth <= 0)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('r'):
+                tmp_opts->request_id = (uint32_t) strtoul(optarg, NULL, 0);
+                tmp_opts->request_id_set = 1;
+                break;
+            case('o'):
+                tmp_opts->out_file = optarg;
+                break;
+            case('?'):
+                usage(argc, argv);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!tmp_opts->mnt_point_set)
+    {
+        free(tmp_opts);
+        return NULL;
+    }
+
+    return tmp_opts;
+}
+
+static void usage(int argc, char **argv)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage  : %s -m fs_mount_point [-n entries] "
+            "[-r request_id] [-o out_file]\n", argv[0]);
+    fprintf(stderr, "Example: %s -m /mnt/pvfs2 -o trace.json\n", argv[0]);
+    return;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stddef.h>
 #include <getopt.h>
 #include <errno.h>
 
@@ -386,6 +387,19 @@ void print_keyval( struct dbpf_data key, struct dbpf_data val )
 
                 if (val.len == sizeof(PVFS_dist_dir_attr))
                 {
+                    printf("(/dda)(%zu) -> (%d)(%d)(%d)(%d)(%d)(%d)(%d)\n",
+                        key.len,
+                        dist_dir_attr->tree_height,
+                        dist_dir_attr->num_servers,
+                        dist_dir_attr->bitmap_size,
+                        dist_dir_attr->split_size,
+                        dist_dir_attr->server_no,
+                        dist_dir_attr->branch_level,
+                        dist_dir_attr->hash_type);
+                }
+                else if (val.len == offsetof(PVFS_dist_dir_attr, hash_type))
+                {
+                    /* written before hash_type existed, md5 */
                     printf("(/dda)(%zu) -> (%d)(%d)(%d)(%d)(%d)(%d)\n",
                         key.len,
                         dist_dir_attr->tree_height,
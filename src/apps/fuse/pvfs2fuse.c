@@ -16,52 +16,98 @@
  */
 
 /* char *pvfs2fuse_version = "$Id: pvfs2fuse.c,v 1.3.8.2 2010-12-21 15:34:13 mtmoore Exp $"; */
-char *pvfs2fuse_version = "0.01";
+char *pvfs2fuse_version = "0.02";
 
-#define FUSE_USE_VERSION 27
+/* configure passes the API version matching the installed libfuse:
+ * 30 for libfuse 3, 29 for libfuse 2.9 (the first 2.x release with
+ * write_buf and fuse_reply_data)
+ */
+#ifndef FUSE_USE_VERSION
+#define FUSE_USE_VERSION 29
+#endif
 
-#include <fuse.h>
+#include <fuse_lowlevel.h>
 #include <fuse_opt.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
-#include <utime.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "pvfs2-compat.h"
 #include "pint-dev-shared.h"
 #include "pint-util.h"
-#include "str-utils.h"
 #include "pvfs2-util.h"
 #include "pint-security.h"
 #include "security-util.h"
 
+/* FUSE inode numbers are PVFS handles, except that FUSE_ROOT_ID stands
+ * for the root directory handle.  No lookup table is kept, so forget()
+ * has nothing to do and any handle the kernel still knows about can be
+ * used directly in the next request.
+ */
+typedef char pvfs_fuse_ino_check[
+   (sizeof(fuse_ino_t) >= sizeof(PVFS_handle)) ? 1 : -1];
+
 typedef struct {
 	  PVFS_object_ref	ref;
 	  PVFS_credential	cred;
 } pvfs_fuse_handle_t;
 
+/* one directory entry read ahead of the kernel; attributes are only
+ * filled in when the entry came from a readdirplus
+ */
+typedef struct {
+   char		*name;
+   PVFS_handle	handle;
+   int		have_attr;
+   struct stat	attr;
+} pvfs_fuse_dirent_t;
+
+/* state of an open directory.  FUSE hands back the offset of the next
+ * entry it wants, which is an index into entries[]; the PVFS readdir
+ * token only says where the next batch starts, so entries are kept
+ * until the directory is released or rewound.
+ */
+typedef struct {
+   PVFS_object_ref	ref;
+   PVFS_credential	cred;
+   PVFS_ds_position	token;
+   pvfs_fuse_dirent_t	*entries;
+   int			count;
+   int			size;
+} pvfs_fuse_dir_t;
+
 struct pvfs2fuse {
 	  char	*fs_spec;
 	  char	*mntpoint;
 	  PVFS_fs_id	fs_id;
 	  struct PVFS_sys_mntent mntent;
+	  PVFS_handle	root_handle;
+	  int	acache_timeout;
+	  int	ncache_timeout;
+	  double	attr_timeout;
+	  double	entry_timeout;
 };
 
 static struct pvfs2fuse pvfs2fuse;
 
-#if __LP64__
-#define SET_FUSE_HANDLE( fi, pfh ) \
-	fi->fh = (uint64_t)pfh
-#define GET_FUSE_HANDLE( fi ) \
-	(pvfs_fuse_handle_t *)fi->fh
-#else
+/* per thread bounce buffer for reads and spliced writes */
+static pthread_key_t pvfs_fuse_buffer_key;
+
+struct pvfs_fuse_buffer {
+   void		*mem;
+   size_t	size;
+};
+
 #define SET_FUSE_HANDLE( fi, pfh ) \
-	*((pvfs_fuse_handle_t **)(&fi->fh)) = pfh
+	((fi)->fh = (uint64_t)(uintptr_t)(pfh))
 #define GET_FUSE_HANDLE( fi ) \
-	*((pvfs_fuse_handle_t **)(&fi->fh))
-#endif
+	((pvfs_fuse_handle_t *)(uintptr_t)(fi)->fh)
+#define GET_FUSE_DIR( fi ) \
+	((pvfs_fuse_dir_t *)(uintptr_t)(fi)->fh)
 
 #define PVFS_VERSION(a,b,c) (((a) << 16) + ((b) << 8) + (c))
 #define THIS_PVFS_VERSION \
@@ -75,11 +121,49 @@ static struct pvfs2fuse pvfs2fuse;
 
 #define pvfs_fuse_cleanup_credential(cred) PINT_cleanup_credential(cred)
 
+/* largest write the kernel is asked to send in one request */
+#define PVFS2FUSE_MAX_WRITE	(512 * 1024)
+
+/* directory entries fetched per readdir call to the servers; a
+ * readdirplus can return no more attributes than one listattr
+ */
+#define MAX_NUM_DIRENTS    64
+#define MAX_NUM_DIRENTS_PLUS    PVFS_SYS_LIMIT_LISTATTR
+
+static void pvfs_fuse_reply_err(fuse_req_t req, int ret)
+{
+   fuse_reply_err(req, -PVFS_ERROR_TO_ERRNO_N(ret));
+}
+
+static PVFS_object_ref pvfs_fuse_ino_to_ref(fuse_ino_t ino)
+{
+   PVFS_object_ref ref;
+
+   ref.handle = (ino == FUSE_ROOT_ID) ?
+      pvfs2fuse.root_handle : (PVFS_handle)ino;
+   ref.fs_id = pvfs2fuse.fs_id;
+   ref.__pad1 = 0;
+
+   return ref;
+}
+
+static fuse_ino_t pvfs_fuse_handle_to_ino(PVFS_handle handle)
+{
+   return (handle == pvfs2fuse.root_handle) ?
+      FUSE_ROOT_ID : (fuse_ino_t)handle;
+}
+
+/* pvfs_fuse_gen_credential()
+ *
+ * builds a credential for the user issuing the request.  Credentials
+ * are cached per user by PVFS_util_gen_credential(), so this is cheap
+ * after the first request from a given uid/gid.
+ */
 static int pvfs_fuse_gen_credential(
+   fuse_req_t req,
    PVFS_credential *credential)
 {
-   struct fuse_context *ctx = fuse_get_context();
-   PVFS_credential *new_cred;
+   const struct fuse_ctx *ctx = fuse_req_ctx(req);
    char uid[16], gid[16];
    int ret;
 
@@ -87,92 +171,70 @@ static int pvfs_fuse_gen_credential(
    ret = snprintf(uid, sizeof(uid), "%u", ctx->uid);
    if (ret < 0 || ret >= sizeof(uid))
    {
-      return -1;
+      return -PVFS_EINVAL;
    }
 
    ret = snprintf(gid, sizeof(gid), "%u", ctx->gid);
    if (ret < 0 || ret >= sizeof(gid))
    {
-       return -1;
+       return -PVFS_EINVAL;
    }
 
-   /* allocate new credential */
-   new_cred = (PVFS_credential *) malloc(sizeof(PVFS_credential));
-   if (!new_cred)
-   {
-       return -ENOMEM;
-   }
-   memset(new_cred, 0, sizeof(PVFS_credential));
+   memset(credential, 0, sizeof(PVFS_credential));
 
    /* generate credential -- this process must be running as root */
-   ret = PVFS_util_gen_credential(uid, 
-                                  gid, 
-                                  PVFS2_DEFAULT_CREDENTIAL_TIMEOUT, 
-                                  NULL, NULL,
-                                  new_cred);
-
-   if (ret == 0)
-   {
-       /* copy credential to provided buffer */
-       ret = PINT_copy_credential(new_cred, credential);      
-   }
+   return PVFS_util_gen_credential(uid,
+                                   gid,
+                                   PVFS2_DEFAULT_CREDENTIAL_TIMEOUT,
+                                   NULL, NULL,
+                                   credential);
+}
 
-   /* free generated credential */
-   pvfs_fuse_cleanup_credential(new_cred);
-   free(new_cred);
+static void pvfs_fuse_free_buffer(void *arg)
+{
+   struct pvfs_fuse_buffer *buffer = arg;
 
-   return ret;
+   free(buffer->mem);
+   free(buffer);
 }
 
-static int lookup( const char *path, pvfs_fuse_handle_t *pfh, 
-				   int32_t follow_link )
+/* pvfs_fuse_get_buffer()
+ *
+ * returns this thread's bounce buffer, grown to at least size bytes.
+ * Reads are replied to before the buffer is used again, and the
+ * session loop runs each request on a single thread.
+ */
+static void *pvfs_fuse_get_buffer(size_t size)
 {
-   PVFS_sysresp_lookup lk_response;
-   int			ret;
-
-   /* we don't have to do a PVFS_util_resolve
-	* because FUSE resolves the path for us
-	*/
+   struct pvfs_fuse_buffer *buffer;
 
-   ret = pvfs_fuse_gen_credential(&pfh->cred);
-   if (ret < 0)
+   buffer = pthread_getspecific(pvfs_fuse_buffer_key);
+   if (buffer == NULL)
    {
-      return ret;
+      buffer = calloc(1, sizeof(*buffer));
+      if (buffer == NULL)
+      {
+         return NULL;
+      }
+      pthread_setspecific(pvfs_fuse_buffer_key, buffer);
    }
 
-   memset(&lk_response, 0, sizeof(lk_response));
-   ret = PVFS_sys_lookup(pvfs2fuse.fs_id, 
-						 (char *)path,
-						 &pfh->cred, 
-						 &lk_response, 
-						 follow_link);
-   if ( ret < 0 ) {
-      pvfs_fuse_cleanup_credential(&pfh->cred);
-	  return ret;
+   if (buffer->size < size)
+   {
+      free(buffer->mem);
+      buffer->mem = malloc(size);
+      buffer->size = buffer->mem ? size : 0;
    }
 
-   pfh->ref.handle = lk_response.ref.handle;
-   pfh->ref.fs_id  = pvfs2fuse.fs_id;
-
-   return 0;
+   return buffer->mem;
 }
 
-static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
+static void pvfs_fuse_attr_to_stat(PVFS_handle handle,
+                                   const PVFS_sys_attr *attrs,
+                                   struct stat *stbuf)
 {
-   PVFS_sysresp_getattr getattr_response;
-   PVFS_sys_attr*	attrs;
-   int			ret;
    int			perm_mode = 0;
 
-   memset(&getattr_response,0, sizeof(PVFS_sysresp_getattr));
-    
-   ret = PVFS_sys_getattr(pfhp->ref, 
-                          PVFS_ATTR_SYS_ALL_NOHINT,
-                          (PVFS_credential *) &pfhp->cred, 
-                          &getattr_response);
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
    memset(stbuf, 0, sizeof(struct stat));
 
    /* Code copied from kernel/linux-2.x/pvfs2-utils.c */
@@ -190,8 +252,6 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 
    */
 
-   attrs = &getattr_response.attr;
-   
    if (attrs->objtype == PVFS_TYPE_METAFILE)
    {
 	  if (attrs->mask & PVFS_ATTR_SYS_SIZE)
@@ -255,6 +315,11 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 
    stbuf->st_mode |= perm_mode;
 
+   /* PVFS has no hard links; the kernel takes a link count of 0 for an
+    * unlinked inode, so report 1 like the kernel module does
+    */
+   stbuf->st_nlink = 1;
+
    /* FIXME special case: mark the root inode as sticky
 	  if (is_root_handle(inode))
 	  {
@@ -268,11 +333,10 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 		 break;
 	  case PVFS_TYPE_DIRECTORY:
 		 stbuf->st_mode |= S_IFDIR;
-		 /* NOTE: we have no good way to keep nlink consistent for 
+		 /* NOTE: we have no good way to keep nlink consistent for
 		  * directories across clients; keep constant at 1.  Why 1?  If
 		  * we go with 2, then find(1) gets confused and won't work
 		  * properly withouth the -noleaf option */
-		 stbuf->st_nlink = 1;
 		 break;
 	  case PVFS_TYPE_SYMLINK:
 		 stbuf->st_mode |= S_IFLNK;
@@ -281,402 +345,430 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 		 break;
    }
 
-   stbuf->st_dev = pfhp->ref.fs_id;
-   stbuf->st_ino = pfhp->ref.handle;
+   stbuf->st_dev = pvfs2fuse.fs_id;
+   stbuf->st_ino = pvfs_fuse_handle_to_ino(handle);
 
    stbuf->st_rdev = 0;
    stbuf->st_blksize = 4096;
-
-   PVFS_util_release_sys_attr(attrs);
-    
-   return 0;
 }
 
-static int pvfs_fuse_getattr(const char *path, struct stat *stbuf)
+static int pvfs_fuse_stat(PVFS_object_ref ref, const PVFS_credential *cred,
+                          struct stat *stbuf)
 {
+   PVFS_sysresp_getattr getattr_response;
    int			ret;
-   pvfs_fuse_handle_t	pfh;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_NO_FOLLOW );
+   memset(&getattr_response,0, sizeof(PVFS_sysresp_getattr));
+
+   ret = PVFS_sys_getattr(ref,
+                          PVFS_ATTR_SYS_ALL_NOHINT,
+                          (PVFS_credential *) cred,
+                          &getattr_response);
    if ( ret < 0 )
-   {
-      return PVFS_ERROR_TO_ERRNO_N( ret );
-   }
+	  return ret;
 
-   ret = pvfs_fuse_getattr_pfhp( &pfh, stbuf );
+   pvfs_fuse_attr_to_stat(ref.handle, &getattr_response.attr, stbuf);
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   PVFS_util_release_sys_attr(&getattr_response.attr);
 
-   return ret;
+   return 0;
 }
 
-static int pvfs_fuse_fgetattr(const char *path, struct stat *stbuf,
-							  struct fuse_file_info *fi)
+static void pvfs_fuse_fill_entry(struct fuse_entry_param *e,
+                                 const struct stat *stbuf)
 {
-   return pvfs_fuse_getattr_pfhp( GET_FUSE_HANDLE( fi ), stbuf );
+   memset(e, 0, sizeof(*e));
+   e->ino = stbuf->st_ino;
+   e->attr = *stbuf;
+   e->attr_timeout = pvfs2fuse.attr_timeout;
+   e->entry_timeout = pvfs2fuse.entry_timeout;
 }
 
-static int pvfs_fuse_readlink(const char *path, char *buf, size_t size)
+/* pvfs_fuse_reply_entry()
+ *
+ * answers a request that made or found the object ref with its
+ * attributes, so the kernel can cache both the name and the inode
+ */
+static void pvfs_fuse_reply_entry(fuse_req_t req, PVFS_object_ref ref,
+                                  const PVFS_credential *cred)
 {
-   PVFS_sysresp_getattr getattr_response;
+   struct fuse_entry_param e;
+   struct stat		stbuf;
    int			ret;
-   size_t		len;
-   pvfs_fuse_handle_t	pfh;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_NO_FOLLOW );
-   if ( ret < 0 )
+   ret = pvfs_fuse_stat(ref, cred, &stbuf);
+   if (ret < 0)
    {
-      return PVFS_ERROR_TO_ERRNO_N( ret );
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
 
-   ret = PVFS_sys_getattr(pfh.ref, 
-						  PVFS_ATTR_SYS_ALL_NOHINT,
-						  (PVFS_credential *) &pfh.cred, 
-						  &getattr_response);
-
-   pvfs_fuse_cleanup_credential(&pfh.cred);
-
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-
-   if (getattr_response.attr.objtype != PVFS_TYPE_SYMLINK)
-	  return -EINVAL;
-
-   len = strlen( getattr_response.attr.link_target );
-   if ( len < (size-1) )
-	  size = len;
-
-   bcopy( getattr_response.attr.link_target, buf, size );
-
-   buf[len] = '\0';
-
-   return 0;
+   pvfs_fuse_fill_entry(&e, &stbuf);
+   fuse_reply_entry(req, &e);
 }
 
-static int pvfs_fuse_mkdir(const char *path, mode_t mode)
+static void pvfs_fuse_init(void *userdata, struct fuse_conn_info *conn)
 {
-   int rc;
-   int num_segs;
-   PVFS_sys_attr attr;
-   char parent[PVFS_NAME_MAX];
-   char dirname[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	parent_pfh;
+   (void) userdata;
+
+   /* move read data to the kernel and write data from it through
+    * pipes instead of copying it through the request buffers
+    */
+   if (conn->capable & FUSE_CAP_SPLICE_WRITE)
+      conn->want |= FUSE_CAP_SPLICE_WRITE;
+   if (conn->capable & FUSE_CAP_SPLICE_MOVE)
+      conn->want |= FUSE_CAP_SPLICE_MOVE;
+   if (conn->capable & FUSE_CAP_SPLICE_READ)
+      conn->want |= FUSE_CAP_SPLICE_READ;
+#ifdef FUSE_CAP_BIG_WRITES
+   if (conn->capable & FUSE_CAP_BIG_WRITES)
+      conn->want |= FUSE_CAP_BIG_WRITES;
+#endif
+#ifdef FUSE_CAP_READDIRPLUS
+   if (conn->capable & FUSE_CAP_READDIRPLUS)
+      conn->want |= FUSE_CAP_READDIRPLUS;
+#endif
 
-   PVFS_sysresp_mkdir resp_mkdir;
+   conn->max_write = PVFS2FUSE_MAX_WRITE;
+}
 
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, parent, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  dirname, PVFS_SEGMENT_MAX);
+static void pvfs_fuse_lookup(fuse_req_t req, fuse_ino_t parent,
+                             const char *name)
+{
+   PVFS_sysresp_lookup	lk_response;
+   PVFS_credential	cred;
+   int			ret;
 
-   if (rc)
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
 
-   rc = lookup( parent, &parent_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc)
+   memset(&lk_response, 0, sizeof(lk_response));
+   ret = PVFS_sys_ref_lookup(pvfs2fuse.fs_id,
+                             (char *)name,
+                             pvfs_fuse_ino_to_ref(parent),
+                             &cred,
+                             &lk_response,
+                             PVFS2_LOOKUP_LINK_NO_FOLLOW);
+   if (ret < 0)
    {
-      return PVFS_ERROR_TO_ERRNO_N( rc );
+      pvfs_fuse_reply_err(req, ret);
    }
-
-   /* Set attributes */
-   memset(&attr, 0, sizeof(PVFS_sys_attr));
-   attr.owner = parent_pfh.cred.userid;
-   attr.group = parent_pfh.cred.group_array[0];
-   attr.perms = mode;
-   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
-
-   rc = PVFS_sys_mkdir(dirname,
-					   parent_pfh.ref,
-					   attr,
-					   &parent_pfh.cred,
-					   &resp_mkdir);
-
-   pvfs_fuse_cleanup_credential(&parent_pfh.cred);
-
-   if (rc)
+   else
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      pvfs_fuse_reply_entry(req, lk_response.ref, &cred);
    }
 
-   return 0;
+   pvfs_fuse_cleanup_credential(&cred);
 }
 
-static int pvfs_fuse_remove( const char *path )
+static void pvfs_fuse_forget(fuse_req_t req, fuse_ino_t ino,
+#if FUSE_MAJOR_VERSION >= 3
+                             uint64_t nlookup)
+#else
+                             unsigned long nlookup)
+#endif
 {
-   int rc;
-   int num_segs;
-   char parent[PVFS_NAME_MAX];
-   char filename[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	parent_pfh;
+   /* inode numbers are handles; there is nothing to release */
+   (void) ino;
+   (void) nlookup;
 
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, parent, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  filename, PVFS_SEGMENT_MAX);
+   fuse_reply_none(req);
+}
 
-   if (rc)
-   {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-   }
+static void pvfs_fuse_getattr(fuse_req_t req, fuse_ino_t ino,
+                              struct fuse_file_info *fi)
+{
+   PVFS_credential	cred;
+   struct stat		stbuf;
+   int			ret;
+
+   (void) fi;
 
-   rc = lookup( parent, &parent_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc)
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
    {
-      return PVFS_ERROR_TO_ERRNO_N( rc );
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
 
-   rc = PVFS_sys_remove(filename, parent_pfh.ref, &parent_pfh.cred);
+   ret = pvfs_fuse_stat(pvfs_fuse_ino_to_ref(ino), &cred, &stbuf);
 
-   pvfs_fuse_cleanup_credential(&parent_pfh.cred);
+   pvfs_fuse_cleanup_credential(&cred);
 
-   if (rc)
+   if (ret < 0)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
 
-   return 0;
-}
-
-static int pvfs_fuse_unlink(const char *path)
-{
-   return pvfs_fuse_remove(path);
-}
-
-static int pvfs_fuse_rmdir(const char *path)
-{
-   return pvfs_fuse_remove(path);
+   fuse_reply_attr(req, &stbuf, pvfs2fuse.attr_timeout);
 }
 
-static int pvfs_fuse_symlink(const char *from, const char *to)
+static void pvfs_fuse_setattr(fuse_req_t req, fuse_ino_t ino,
+                              struct stat *attr, int to_set,
+                              struct fuse_file_info *fi)
 {
-   int                  ret = 0;
-   PVFS_sys_attr        attr;
-   PVFS_sysresp_lookup  resp_lookup;
-   PVFS_object_ref      parent_ref;
-   PVFS_sysresp_symlink resp_sym;
-   PVFS_credential      credential;
-   pvfs_fuse_handle_t	dir_pfh;
-   char *tofile, *todir, *cp;
-
-   pvfs_fuse_gen_credential(&credential);
+   PVFS_object_ref	ref = pvfs_fuse_ino_to_ref(ino);
+   PVFS_credential	cred;
+   PVFS_sys_attr	new_attr;
+   struct stat		stbuf;
+   int			ret;
 
-   /* Initialize any variables */
-   memset(&attr,        0, sizeof(attr));
-   memset(&resp_lookup, 0, sizeof(resp_lookup));
-   memset(&parent_ref,  0, sizeof(parent_ref));
-   memset(&resp_sym,    0, sizeof(resp_sym));
+   (void) fi;
 
-   /* Set the attributes for the new directory */
-   attr.owner = credential.userid;
-   attr.group = credential.group_array[0];
-   attr.perms = 0777;              
-   attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      pvfs_fuse_reply_err(req, ret);
+      return;
+   }
 
-   todir = strdup( to );
-   if ( todir == NULL )
-	  return -ENOMEM;
+   if (to_set & FUSE_SET_ATTR_SIZE)
+   {
+      ret = PVFS_sys_truncate(ref, attr->st_size, &cred);
+      if (ret < 0)
+         goto out;
+   }
 
-   /* find the last / to get the parent directory */
-   cp = rindex( todir,  '/' );
-   if ( cp == NULL )
+   memset(&new_attr, 0, sizeof(new_attr));
+   if (to_set & FUSE_SET_ATTR_MODE)
    {
-	  free( todir );
-	  return -ENOTDIR;
+      /* FUSE passes in 5 octets in 'mode'. However, the the first
+       * octet is not related to permissions, hence checking only
+       *  the lower 4 octets */
+      new_attr.perms = attr->st_mode & 07777;
+      new_attr.mask |= PVFS_ATTR_SYS_PERM;
    }
-   tofile = strdup( cp+1 );
-   if ( cp == todir )
+   if (to_set & FUSE_SET_ATTR_UID)
    {
-	  /* we're creating a link at the root, so keep the slash */
-	  *(cp+1) = '\0';
+      new_attr.owner = attr->st_uid;
+      new_attr.mask |= PVFS_ATTR_SYS_UID;
    }
-   else
+   if (to_set & FUSE_SET_ATTR_GID)
+   {
+      new_attr.group = attr->st_gid;
+      new_attr.mask |= PVFS_ATTR_SYS_GID;
+   }
+   /* without an explicit time the server uses the current time */
+   if (to_set & FUSE_SET_ATTR_ATIME)
    {
-	  *cp = '\0';
+      new_attr.mask |= PVFS_ATTR_SYS_ATIME;
+      if (!(to_set & FUSE_SET_ATTR_ATIME_NOW))
+      {
+         new_attr.atime = (PVFS_time)attr->st_atime;
+         new_attr.mask |= PVFS_ATTR_SYS_ATIME_SET;
+      }
+   }
+   if (to_set & FUSE_SET_ATTR_MTIME)
+   {
+      new_attr.mask |= PVFS_ATTR_SYS_MTIME;
+      if (!(to_set & FUSE_SET_ATTR_MTIME_NOW))
+      {
+         new_attr.mtime = (PVFS_time)attr->st_mtime;
+         new_attr.mask |= PVFS_ATTR_SYS_MTIME_SET;
+      }
    }
 
-   ret = lookup( todir, &dir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if(ret < 0)
+   if (new_attr.mask)
    {
-	  free( tofile );
-	  free( todir );
-	  PVFS_perror("lookup", ret);
-	  return(-1);
+      ret = PVFS_sys_setattr(ref, new_attr, &cred);
+      if (ret < 0)
+         goto out;
    }
 
-   ret = PVFS_sys_symlink(tofile, 
-						  dir_pfh.ref, 
-						  (char *) from,
-						  attr, 
-						  &credential, 
-						  &resp_sym);
+   ret = pvfs_fuse_stat(ref, &cred, &stbuf);
 
-   pvfs_fuse_cleanup_credential(&credential);
-   pvfs_fuse_cleanup_credential(&dir_pfh.cred);
+out:
+   pvfs_fuse_cleanup_credential(&cred);
 
    if (ret < 0)
    {
-	  PVFS_perror("PVFS_sys_symlink", ret);
-	  return(ret);
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
-   else
-   {
-	  ret = 0;
-   }
-    
-   free( tofile );
-   free( todir );
-   return(ret);
+
+   fuse_reply_attr(req, &stbuf, pvfs2fuse.attr_timeout);
 }
 
-static int pvfs_fuse_rename(const char *from, const char *to)
+static void pvfs_fuse_readlink(fuse_req_t req, fuse_ino_t ino)
 {
-   int rc;
-   int num_segs;
-   char fromdir[PVFS_NAME_MAX], todir[PVFS_NAME_MAX];
-   char fromname[PVFS_SEGMENT_MAX], toname[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	todir_pfh, fromdir_pfh;
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)from, fromdir, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)from);
-   rc = PINT_get_path_element((char *)from, num_segs - 1,
-							  fromname, PVFS_SEGMENT_MAX);
-
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   rc = lookup( fromdir, &fromdir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)to, todir, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)to);
-   rc = PINT_get_path_element((char *)to, num_segs - 1,
-							  toname, PVFS_SEGMENT_MAX);
+   PVFS_sysresp_getattr getattr_response;
+   PVFS_credential	cred;
+   int			ret;
 
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      pvfs_fuse_reply_err(req, ret);
+      return;
+   }
 
-   lookup( todir, &todir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+   memset(&getattr_response, 0, sizeof(getattr_response));
+   ret = PVFS_sys_getattr(pvfs_fuse_ino_to_ref(ino),
+                          PVFS_ATTR_SYS_ALL_NOHINT,
+                          &cred,
+                          &getattr_response);
 
-   rc = PVFS_sys_rename(fromname,
-						fromdir_pfh.ref,
-						toname,
-						todir_pfh.ref,
-						&todir_pfh.cred);
+   pvfs_fuse_cleanup_credential(&cred);
 
-   pvfs_fuse_cleanup_credential(&fromdir_pfh.cred);
-   pvfs_fuse_cleanup_credential(&todir_pfh.cred);
+   if ( ret < 0 )
+   {
+      pvfs_fuse_reply_err(req, ret);
+      return;
+   }
 
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+   if (getattr_response.attr.objtype != PVFS_TYPE_SYMLINK ||
+       getattr_response.attr.link_target == NULL)
+      fuse_reply_err(req, EINVAL);
+   else
+      fuse_reply_readlink(req, getattr_response.attr.link_target);
 
-   return 0;
+   PVFS_util_release_sys_attr(&getattr_response.attr);
 }
 
-static int pvfs_fuse_chmod(const char *path, mode_t mode)
+static void pvfs_fuse_mkdir(fuse_req_t req, fuse_ino_t parent,
+                            const char *name, mode_t mode)
 {
-   int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
+   PVFS_sys_attr	attr;
+   PVFS_credential	cred;
+   PVFS_sysresp_mkdir	resp_mkdir;
+   int			rc;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   /* FUSE passes in 5 octets in 'mode'. However, the the first 
-    * octet is not related to permissions, hence checking only
-    *  the lower 4 octets */
-   new_attr.perms = mode & 07777;
-   new_attr.mask = PVFS_ATTR_SYS_PERM;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
+   rc = pvfs_fuse_gen_credential(req, &cred);
+   if (rc < 0)
+   {
+      pvfs_fuse_reply_err(req, rc);
+      return;
+   }
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   /* Set attributes */
+   memset(&attr, 0, sizeof(PVFS_sys_attr));
+   attr.owner = cred.userid;
+   attr.group = cred.group_array[0];
+   attr.perms = mode & 07777;
+   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   rc = PVFS_sys_mkdir((char *)name,
+                       pvfs_fuse_ino_to_ref(parent),
+                       attr,
+                       &cred,
+                       &resp_mkdir);
+   if (rc < 0)
+      pvfs_fuse_reply_err(req, rc);
+   else
+      pvfs_fuse_reply_entry(req, resp_mkdir.ref, &cred);
 
-   return 0;
+   pvfs_fuse_cleanup_credential(&cred);
 }
 
-static int pvfs_fuse_chown(const char *path, uid_t uid, gid_t gid)
+static void pvfs_fuse_remove(fuse_req_t req, fuse_ino_t parent,
+                             const char *name)
 {
-   int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
+   PVFS_credential	cred;
+   int			rc;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   new_attr.owner = uid;
-   new_attr.group = gid;
-   new_attr.mask = PVFS_ATTR_SYS_UID | PVFS_ATTR_SYS_GID;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
+   rc = pvfs_fuse_gen_credential(req, &cred);
+   if (rc < 0)
+   {
+      pvfs_fuse_reply_err(req, rc);
+      return;
+   }
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   rc = PVFS_sys_remove((char *)name, pvfs_fuse_ino_to_ref(parent), &cred);
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   pvfs_fuse_cleanup_credential(&cred);
 
-   return 0;
+   if (rc < 0)
+      pvfs_fuse_reply_err(req, rc);
+   else
+      fuse_reply_err(req, 0);
 }
 
-static int pvfs_fuse_truncate(const char *path, off_t size)
+static void pvfs_fuse_symlink(fuse_req_t req, const char *link,
+                              fuse_ino_t parent, const char *name)
 {
-   int			ret;
-   pvfs_fuse_handle_t	pfh;
+   PVFS_sys_attr        attr;
+   PVFS_sysresp_symlink resp_sym;
+   PVFS_credential      cred;
+   int                  ret;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   ret = PVFS_sys_truncate(pfh.ref,size,&pfh.cred);
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      pvfs_fuse_reply_err(req, ret);
+      return;
+   }
+
+   memset(&attr,        0, sizeof(attr));
+   memset(&resp_sym,    0, sizeof(resp_sym));
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   /* Set the attributes for the new link */
+   attr.owner = cred.userid;
+   attr.group = cred.group_array[0];
+   attr.perms = 0777;
+   attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   ret = PVFS_sys_symlink((char *)name,
+                          pvfs_fuse_ino_to_ref(parent),
+                          (char *)link,
+                          attr,
+                          &cred,
+                          &resp_sym);
+   if (ret < 0)
+      pvfs_fuse_reply_err(req, ret);
+   else
+      pvfs_fuse_reply_entry(req, resp_sym.ref, &cred);
 
-   return 0;
+   pvfs_fuse_cleanup_credential(&cred);
 }
 
-static int pvfs_fuse_utime(const char *path, struct utimbuf *timbuf)
+static void pvfs_fuse_rename(fuse_req_t req, fuse_ino_t parent,
+                             const char *name, fuse_ino_t newparent,
+#if FUSE_MAJOR_VERSION >= 3
+                             const char *newname, unsigned int flags)
+#else
+                             const char *newname)
+#endif
 {
-   int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
+   PVFS_credential	cred;
+   int			rc;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   new_attr.atime = (PVFS_time)timbuf->actime;
-   new_attr.mtime = (PVFS_time)timbuf->modtime;
-   new_attr.mask = PVFS_ATTR_SYS_ATIME | PVFS_ATTR_SYS_MTIME;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
+#if FUSE_MAJOR_VERSION >= 3
+   /* RENAME_EXCHANGE and RENAME_NOREPLACE are not atomic in PVFS */
+   if (flags)
+   {
+      fuse_reply_err(req, EINVAL);
+      return;
+   }
+#endif
+
+   rc = pvfs_fuse_gen_credential(req, &cred);
+   if (rc < 0)
+   {
+      pvfs_fuse_reply_err(req, rc);
+      return;
+   }
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   rc = PVFS_sys_rename((char *)name,
+                        pvfs_fuse_ino_to_ref(parent),
+                        (char *)newname,
+                        pvfs_fuse_ino_to_ref(newparent),
+                        &cred);
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   pvfs_fuse_cleanup_credential(&cred);
 
-   return 0;
+   if (rc < 0)
+      pvfs_fuse_reply_err(req, rc);
+   else
+      fuse_reply_err(req, 0);
 }
 
-static int pvfs_fuse_open(const char *path, struct fuse_file_info *fi)
+static void pvfs_fuse_open(fuse_req_t req, fuse_ino_t ino,
+                           struct fuse_file_info *fi)
 {
    pvfs_fuse_handle_t *pfhp;
    int			ret;
@@ -684,79 +776,149 @@ static int pvfs_fuse_open(const char *path, struct fuse_file_info *fi)
    pfhp = (pvfs_fuse_handle_t *)malloc( sizeof( pvfs_fuse_handle_t ) );
    if (pfhp == NULL)
    {
-	  return -ENOMEM;
+      fuse_reply_err(req, ENOMEM);
+      return;
    }
 
-   ret = lookup( path, pfhp, PVFS2_LOOKUP_LINK_FOLLOW );
+   /* I/O uses the opener's credential, as permissions are checked
+    * at open time */
+   ret = pvfs_fuse_gen_credential(req, &pfhp->cred);
    if ( ret < 0 ) {
       free( pfhp );
-      return PVFS_ERROR_TO_ERRNO_N( ret );
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
+   pfhp->ref = pvfs_fuse_ino_to_ref(ino);
 
    SET_FUSE_HANDLE( fi, pfhp );
+   fi->direct_io = 1;
 
-   return 0;
+   if (fuse_reply_open(req, fi) == -ENOENT)
+   {
+      /* interrupted; release will not be called */
+      pvfs_fuse_cleanup_credential(&pfhp->cred);
+      free( pfhp );
+   }
 }
 
-static int pvfs_fuse_read(const char *path, char *buf, size_t size, off_t offset,
-						  struct fuse_file_info *fi)
+static void pvfs_fuse_read(fuse_req_t req, fuse_ino_t ino, size_t size,
+                           off_t offset, struct fuse_file_info *fi)
 {
-   PVFS_Request	mem_req, file_req;
+   struct fuse_bufvec	bufv = FUSE_BUFVEC_INIT(size);
+   PVFS_Request	mem_req;
    PVFS_sysresp_io	resp_io;
    int			ret;
    pvfs_fuse_handle_t	*pfh = GET_FUSE_HANDLE( fi );
-  
-   file_req = PVFS_BYTE;
-   ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
-   if (ret < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   void			*buf;
 
-   ret = PVFS_sys_read(pfh->ref, file_req, offset, buf,
-					   mem_req, &pfh->cred, &resp_io);
+   (void) ino;
 
-   if (ret == 0) 
+   buf = pvfs_fuse_get_buffer(size);
+   if (buf == NULL)
    {
-	  PVFS_Request_free(&mem_req);
-	  return(resp_io.total_completed);
+      fuse_reply_err(req, ENOMEM);
+      return;
    }
-   else
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-}
 
-static int pvfs_fuse_write(const char *path, const char *buf, size_t size,
-						   off_t offset, struct fuse_file_info *fi)
-{
-   PVFS_Request	mem_req, file_req;
-   PVFS_sysresp_io	resp_io;
-   int			ret;
-   pvfs_fuse_handle_t	*pfh = GET_FUSE_HANDLE( fi );
-  
-   file_req = PVFS_BYTE;
    ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
    if (ret < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-
-   ret = PVFS_sys_write(pfh->ref, file_req, offset, (char*)buf,
-						mem_req, &pfh->cred, &resp_io);
-   if (ret == 0) 
    {
-	  PVFS_Request_free(&mem_req);
-	  return(resp_io.total_completed);
+      pvfs_fuse_reply_err(req, ret);
+      return;
+   }
+
+   ret = PVFS_sys_read(pfh->ref, PVFS_BYTE, offset, buf,
+					   mem_req, &pfh->cred, &resp_io);
+
+   PVFS_Request_free(&mem_req);
+
+   if (ret < 0)
+   {
+      pvfs_fuse_reply_err(req, ret);
+      return;
+   }
+
+   /* the buffer is spliced to the kernel when it supports that */
+   bufv.buf[0].mem = buf;
+   bufv.buf[0].size = resp_io.total_completed;
+   fuse_reply_data(req, &bufv, FUSE_BUF_SPLICE_MOVE);
+}
+
+static void pvfs_fuse_write_buf(fuse_req_t req, fuse_ino_t ino,
+                                struct fuse_bufvec *in_buf, off_t offset,
+                                struct fuse_file_info *fi)
+{
+   PVFS_Request	mem_req;
+   PVFS_sysresp_io	resp_io;
+   int			ret;
+   pvfs_fuse_handle_t	*pfh = GET_FUSE_HANDLE( fi );
+   size_t		size = fuse_buf_size(in_buf);
+   void			*buf;
+
+   (void) ino;
+
+   if (in_buf->count == 1 && in_buf->idx == 0 && in_buf->off == 0 &&
+       !(in_buf->buf[0].flags & FUSE_BUF_IS_FD))
+   {
+      /* already in memory; write it from where it is */
+      buf = in_buf->buf[0].mem;
    }
    else
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   {
+      /* the data is still in the pipe it was spliced into; this is
+       * the only copy made of it */
+      struct fuse_bufvec mem_buf = FUSE_BUFVEC_INIT(size);
+      ssize_t copied;
+
+      buf = pvfs_fuse_get_buffer(size);
+      if (buf == NULL)
+      {
+         fuse_reply_err(req, ENOMEM);
+         return;
+      }
+      mem_buf.buf[0].mem = buf;
+
+      copied = fuse_buf_copy(&mem_buf, in_buf, 0);
+      if (copied < 0)
+      {
+         fuse_reply_err(req, -copied);
+         return;
+      }
+      size = copied;
+   }
+
+   ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
+   if (ret < 0)
+   {
+      pvfs_fuse_reply_err(req, ret);
+      return;
+   }
+
+   ret = PVFS_sys_write(pfh->ref, PVFS_BYTE, offset, buf,
+						mem_req, &pfh->cred, &resp_io);
+
+   PVFS_Request_free(&mem_req);
+
+   if (ret < 0)
+      pvfs_fuse_reply_err(req, ret);
+   else
+      fuse_reply_write(req, resp_io.total_completed);
 }
 
-static int pvfs_fuse_statfs(const char *path, struct statvfs *stbuf)
+static void pvfs_fuse_statfs(fuse_req_t req, fuse_ino_t ino)
 {
    int			ret;
    PVFS_credential	cred;
    PVFS_sysresp_statfs resp_statfs;
+   struct statvfs	stbuf;
+
+   (void) ino;
 
-   ret = pvfs_fuse_gen_credential(&cred);
+   ret = pvfs_fuse_gen_credential(req, &cred);
    if (ret < 0)
    {
-       return PVFS_ERROR_TO_ERRNO_N(ret);
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
 
    /* gather normal statfs statistics from system interface */
@@ -768,274 +930,428 @@ static int pvfs_fuse_statfs(const char *path, struct statvfs *stbuf)
    if (ret < 0)
    {
 	  if(ret != ERANGE)
-		 return PVFS_ERROR_TO_ERRNO_N( ret );
+	  {
+		 pvfs_fuse_reply_err(req, ret);
+		 return;
+	  }
    }
 
-   memcpy(&stbuf->f_fsid, &resp_statfs.statfs_buf.fs_id, 
+   memset(&stbuf, 0, sizeof(stbuf));
+   memcpy(&stbuf.f_fsid, &resp_statfs.statfs_buf.fs_id,
 		  sizeof(resp_statfs.statfs_buf.fs_id));
    /* FIXME is this bsize right? */
 
-   stbuf->f_bsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
-   stbuf->f_frsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
-   stbuf->f_namemax = PVFS_NAME_MAX;
+   stbuf.f_bsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
+   stbuf.f_frsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
+   stbuf.f_namemax = PVFS_NAME_MAX;
 
-   stbuf->f_blocks = resp_statfs.statfs_buf.bytes_total / stbuf->f_bsize;
-   stbuf->f_bfree = resp_statfs.statfs_buf.bytes_available / stbuf->f_bsize;
-   stbuf->f_bavail = resp_statfs.statfs_buf.bytes_available / stbuf->f_bsize;
-   stbuf->f_files = resp_statfs.statfs_buf.handles_total_count;
-   stbuf->f_ffree = resp_statfs.statfs_buf.handles_available_count;
-   stbuf->f_favail = resp_statfs.statfs_buf.handles_available_count;
+   stbuf.f_blocks = resp_statfs.statfs_buf.bytes_total / stbuf.f_bsize;
+   stbuf.f_bfree = resp_statfs.statfs_buf.bytes_available / stbuf.f_bsize;
+   stbuf.f_bavail = resp_statfs.statfs_buf.bytes_available / stbuf.f_bsize;
+   stbuf.f_files = resp_statfs.statfs_buf.handles_total_count;
+   stbuf.f_ffree = resp_statfs.statfs_buf.handles_available_count;
+   stbuf.f_favail = resp_statfs.statfs_buf.handles_available_count;
 
-   stbuf->f_flag = 0;
+   stbuf.f_flag = 0;
 
-   return 0;
+   fuse_reply_statfs(req, &stbuf);
 }
 
-static int pvfs_fuse_release(const char *path, struct fuse_file_info *fi)
+static void pvfs_fuse_release(fuse_req_t req, fuse_ino_t ino,
+                              struct fuse_file_info *fi)
 {
    pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
-  
+
+   (void) ino;
+
    if ( pfh != NULL ) {
       pvfs_fuse_cleanup_credential(&pfh->cred);
       free( pfh );
       SET_FUSE_HANDLE( fi, NULL );
    }
 
-   return 0;
+   fuse_reply_err(req, 0);
 }
 
-static int pvfs_fuse_fsync(const char *path, int isdatasync,
-						   struct fuse_file_info *fi)
+static void pvfs_fuse_fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
+                            struct fuse_file_info *fi)
 {
-   /* Just a stub.  This method is optional and can safely be left
-	  unimplemented */
+   pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
+   int			ret;
 
-   (void) path;
-   (void) isdatasync;
-   (void) fi;
+   (void) ino;
+   (void) datasync;
 
-   return 0;
+   ret = PVFS_sys_flush(pfh->ref, &pfh->cred);
+   if (ret < 0)
+      pvfs_fuse_reply_err(req, ret);
+   else
+      fuse_reply_err(req, 0);
 }
 
-#define MAX_NUM_DIRENTS    32
+static void pvfs_fuse_dir_reset(pvfs_fuse_dir_t *dir)
+{
+   int i;
+
+   for (i = 0; i < dir->count; i++)
+   {
+      free(dir->entries[i].name);
+   }
+   dir->count = 0;
+   dir->token = PVFS_READDIR_START;
+}
 
-static int pvfs_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
-							 off_t offset, struct fuse_file_info *fi)
+/* pvfs_fuse_dir_fetch()
+ *
+ * appends the next batch of entries of an open directory, with
+ * attributes when plus is set.  Returns 0 when the end of the directory
+ * has already been reached.
+ */
+static int pvfs_fuse_dir_fetch(pvfs_fuse_dir_t *dir, int plus)
 {
-   int			ret;
-   PVFS_ds_position	token;
-   pvfs_fuse_handle_t	pfh;
-   int			pvfs_dirent_incount;
+   PVFS_sysresp_readdirplus rdplus_response;
    PVFS_sysresp_readdir rd_response;
+   PVFS_dirent		*dirents;
+   int			count, i, ret;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   if (dir->token == PVFS_READDIR_END)
+      return 0;
 
-   pvfs_dirent_incount = MAX_NUM_DIRENTS;
-   token = 0;
-   do
+   memset(&rdplus_response, 0, sizeof(rdplus_response));
+   memset(&rd_response, 0, sizeof(rd_response));
+   if (plus)
    {
-	  char *cur_file = NULL;
-	  int i;
+      ret = PVFS_sys_readdirplus(dir->ref, dir->token, MAX_NUM_DIRENTS_PLUS,
+                                 &dir->cred, PVFS_ATTR_SYS_ALL_NOHINT,
+                                 &rdplus_response, PVFS_HINT_NULL);
+      dirents = rdplus_response.dirent_array;
+      count = rdplus_response.pvfs_dirent_outcount;
+      dir->token = rdplus_response.token;
+   }
+   else
+   {
+      ret = PVFS_sys_readdir(dir->ref, dir->token, MAX_NUM_DIRENTS,
+                             &dir->cred, &rd_response);
+      dirents = rd_response.dirent_array;
+      count = rd_response.pvfs_dirent_outcount;
+      dir->token = rd_response.token;
+   }
+   if (ret < 0)
+      return ret;
 
-	  memset(&rd_response, 0, sizeof(PVFS_sysresp_readdir));
-	  ret = PVFS_sys_readdir(
-		 pfh.ref, (!token ? PVFS_READDIR_START : token),
-		 pvfs_dirent_incount, &pfh.cred, &rd_response);
-	  if(ret < 0)
+   if (dir->count + count > dir->size)
+   {
+      int size = dir->size ? dir->size : MAX_NUM_DIRENTS;
+      pvfs_fuse_dirent_t *entries;
+
+      while (size < dir->count + count)
+         size *= 2;
+      entries = realloc(dir->entries, size * sizeof(*entries));
+      if (entries == NULL)
       {
-         pvfs_fuse_cleanup_credential(&pfh.cred);
-         return PVFS_ERROR_TO_ERRNO_N( ret );
+         ret = -PVFS_ENOMEM;
+         goto out;
       }
+      dir->entries = entries;
+      dir->size = size;
+   }
 
-	  for(i = 0; i < rd_response.pvfs_dirent_outcount; i++)
-	  {
-		 cur_file = rd_response.dirent_array[i].d_name;
-
-		 if (filler(buf, cur_file, NULL, 0))
-			break;
-	  }
-	  token = rd_response.token;
-
-	  if (rd_response.pvfs_dirent_outcount)
-	  {
-		 free(rd_response.dirent_array);
-		 rd_response.dirent_array = NULL;
-	  }
+   for (i = 0; i < count; i++)
+   {
+      pvfs_fuse_dirent_t *ent = &dir->entries[dir->count];
 
-   } while(token != PVFS_READDIR_END);
+      ent->name = strdup(dirents[i].d_name);
+      if (ent->name == NULL)
+      {
+         ret = -PVFS_ENOMEM;
+         goto out;
+      }
+      ent->handle = dirents[i].handle;
+      ent->have_attr = plus && rdplus_response.stat_err_array[i] == 0;
+      if (ent->have_attr)
+      {
+         pvfs_fuse_attr_to_stat(ent->handle,
+                                &rdplus_response.attr_array[i],
+                                &ent->attr);
+      }
+      dir->count++;
+   }
+   ret = count;
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+out:
+   free(dirents);
+   if (plus)
+   {
+      for (i = 0; i < count; i++)
+      {
+         PVFS_util_release_sys_attr(&rdplus_response.attr_array[i]);
+      }
+      free(rdplus_response.stat_err_array);
+      free(rdplus_response.attr_array);
+   }
 
-   return 0;
+   return ret;
 }
 
-static int pvfs_fuse_access(const char *path, int mask)
+static void pvfs_fuse_opendir(fuse_req_t req, fuse_ino_t ino,
+                              struct fuse_file_info *fi)
 {
-   PVFS_sysresp_getattr getattr_response;
-   PVFS_sys_attr*	attrs;
+   pvfs_fuse_dir_t	*dir;
    int			ret;
-   pvfs_fuse_handle_t	pfh;
-   int			in_group_flag = 0;
-   PVFS_uid     uid;
-   PVFS_gid     gid;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-
-   /* give root permission, no matter what */
-   if ( pfh.cred.userid == 0 )
-	  return 0;
-
-   /* if checking for file existence, return 0 */
-   if ( mask == F_OK )
-	  return 0;
-
-   ret = PVFS_sys_getattr(pfh.ref, 
-                          PVFS_ATTR_SYS_ALL_NOHINT,
-                          (PVFS_credential *) &pfh.cred, 
-                          &getattr_response);
-
-   /* copy uid and gid so credential can be freed */
-   uid = pfh.cred.userid;
-   gid = pfh.cred.group_array[0];
-   pvfs_fuse_cleanup_credential(&pfh.cred);
-
-   if ( ret < 0 )
-   {            
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   dir = calloc(1, sizeof(*dir));
+   if (dir == NULL)
+   {
+      fuse_reply_err(req, ENOMEM);
+      return;
    }
 
-   attrs = &getattr_response.attr;
-
-   /* basic code is copied from PINT_check_mode() */
-
-   /* see if uid matches object owner */
-   if ( attrs->owner == uid )
+   ret = pvfs_fuse_gen_credential(req, &dir->cred);
+   if (ret < 0)
    {
-	  /* see if object user permissions match access type */
-	  if( (mask & R_OK) && (attrs->perms & PVFS_U_READ))
-	  {
-		 return(0);
-	  }
-	  if( (mask & W_OK) && (attrs->perms & PVFS_U_WRITE))
-	  {
-		 return(0);
-	  }
-	  if( (mask & X_OK) && (attrs->perms & PVFS_U_EXECUTE))
-	  {
-		 return(0);
-	  }
+      free(dir);
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
+   dir->ref = pvfs_fuse_ino_to_ref(ino);
+   dir->token = PVFS_READDIR_START;
 
-   /* see if other bits allow access */
-   if( (mask & R_OK) && (attrs->perms & PVFS_O_READ))
+   SET_FUSE_HANDLE( fi, dir );
+
+   if (fuse_reply_open(req, fi) == -ENOENT)
    {
-	  return(0);
+      pvfs_fuse_cleanup_credential(&dir->cred);
+      free(dir);
    }
-   if( (mask & W_OK) && (attrs->perms & PVFS_O_WRITE))
+}
+
+/* pvfs_fuse_do_readdir()
+ *
+ * fills a reply of up to size bytes with the entries from index offset
+ * on, reading more of the directory from the servers as needed
+ */
+static void pvfs_fuse_do_readdir(fuse_req_t req, size_t size, off_t offset,
+                                 struct fuse_file_info *fi, int plus)
+{
+   pvfs_fuse_dir_t	*dir = GET_FUSE_DIR( fi );
+   char			*buf;
+   size_t		pos = 0;
+   off_t		i;
+   int			ret = 0;
+
+   buf = malloc(size);
+   if (buf == NULL)
    {
-	  return(0);
+      fuse_reply_err(req, ENOMEM);
+      return;
    }
-   if( (mask & X_OK) && (attrs->perms & PVFS_O_EXECUTE))
+
+   /* rewinddir() */
+   if (offset == 0)
+      pvfs_fuse_dir_reset(dir);
+
+   for (i = offset; ; i++)
    {
-	  return(0);
+      pvfs_fuse_dirent_t *ent;
+      size_t len;
+
+      while (i >= dir->count)
+      {
+         ret = pvfs_fuse_dir_fetch(dir, plus);
+         if (ret <= 0)
+            break;
+      }
+      if (i >= dir->count)
+      {
+         if (ret < 0 && pos == 0)
+         {
+            free(buf);
+            pvfs_fuse_reply_err(req, ret);
+            return;
+         }
+         break;
+      }
+
+      ent = &dir->entries[i];
+#if FUSE_MAJOR_VERSION >= 3
+      if (plus)
+      {
+         struct fuse_entry_param e;
+         PVFS_object_ref ref = dir->ref;
+
+         /* read by an earlier plain readdir */
+         ref.handle = ent->handle;
+         if (!ent->have_attr &&
+             pvfs_fuse_stat(ref, &dir->cred, &ent->attr) == 0)
+         {
+            ent->have_attr = 1;
+         }
+
+         if (ent->have_attr)
+         {
+            pvfs_fuse_fill_entry(&e, &ent->attr);
+         }
+         else
+         {
+            /* a zero ino lists the name without creating an entry */
+            memset(&e, 0, sizeof(e));
+            e.attr.st_ino = pvfs_fuse_handle_to_ino(ent->handle);
+         }
+         len = fuse_add_direntry_plus(req, buf + pos, size - pos,
+                                      ent->name, &e, i + 1);
+      }
+      else
+#endif
+      {
+         struct stat stbuf;
+
+         memset(&stbuf, 0, sizeof(stbuf));
+         stbuf.st_ino = pvfs_fuse_handle_to_ino(ent->handle);
+         if (ent->have_attr)
+            stbuf.st_mode = ent->attr.st_mode;
+         len = fuse_add_direntry(req, buf + pos, size - pos,
+                                 ent->name, &stbuf, i + 1);
+      }
+      if (len > size - pos)
+         break;
+      pos += len;
    }
 
-   /* see if gid matches object group 
-      TODO: check all groups */
-   if(attrs->group == gid)
+   fuse_reply_buf(req, buf, pos);
+   free(buf);
+}
+
+static void pvfs_fuse_readdir(fuse_req_t req, fuse_ino_t ino, size_t size,
+                              off_t offset, struct fuse_file_info *fi)
+{
+   (void) ino;
+
+   pvfs_fuse_do_readdir(req, size, offset, fi, 0);
+}
+
+#if FUSE_MAJOR_VERSION >= 3
+static void pvfs_fuse_readdirplus(fuse_req_t req, fuse_ino_t ino,
+                                  size_t size, off_t offset,
+                                  struct fuse_file_info *fi)
+{
+   (void) ino;
+
+   pvfs_fuse_do_readdir(req, size, offset, fi, 1);
+}
+#endif
+
+static void pvfs_fuse_releasedir(fuse_req_t req, fuse_ino_t ino,
+                                 struct fuse_file_info *fi)
+{
+   pvfs_fuse_dir_t *dir = GET_FUSE_DIR( fi );
+
+   (void) ino;
+
+   pvfs_fuse_dir_reset(dir);
+   free(dir->entries);
+   pvfs_fuse_cleanup_credential(&dir->cred);
+   free(dir);
+
+   fuse_reply_err(req, 0);
+}
+
+static void pvfs_fuse_access(fuse_req_t req, fuse_ino_t ino, int mask)
+{
+   const struct fuse_ctx *ctx = fuse_req_ctx(req);
+   PVFS_credential	cred;
+   struct stat		stbuf;
+   mode_t		granted;
+   int			ret;
+
+   /* give root permission, no matter what; the inode exists, so
+    * F_OK needs no further checks */
+   if ( ctx->uid == 0 || mask == F_OK )
    {
-	  /* default group match */
-	  in_group_flag = 1;
+      fuse_reply_err(req, 0);
+      return;
    }
-   else
+
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
    {
-#if 0
-	  /* no default group match, check supplementary groups */
-	  ret = PINT_check_group(uid, attrs->group);
-	  if(ret == 0)
-	  {
-		 in_group_flag = 1;
-	  }
-	  else
-	  {
-		 if(ret != -PVFS_ENOENT)
-		 {
-			/* system error; not just failed match */
-			return(ret);
-		 }
-	  }
-#endif
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
 
-   if(in_group_flag)
+   ret = pvfs_fuse_stat(pvfs_fuse_ino_to_ref(ino), &cred, &stbuf);
+
+   pvfs_fuse_cleanup_credential(&cred);
+
+   if ( ret < 0 )
    {
-	  /* see if object group permissions match access type */
-	  if( (mask & R_OK) && (attrs->perms & PVFS_G_READ))
-	  {
-		 return(0);
-	  }
-	  if( (mask & W_OK) && (attrs->perms & PVFS_G_WRITE))
-	  {
-		 return(0);
-	  }
-	  if( (mask & X_OK) && (attrs->perms & PVFS_G_EXECUTE))
-	  {
-		 return(0);
-	  }
+      pvfs_fuse_reply_err(req, ret);
+      return;
    }
-  
-   /* default case: access denied */
-   return -EACCES;
+
+   /* see PINT_check_mode(); supplementary groups are not checked */
+   if (stbuf.st_uid == ctx->uid)
+      granted = (stbuf.st_mode >> 6) & 07;
+   else if (stbuf.st_gid == ctx->gid)
+      granted = (stbuf.st_mode >> 3) & 07;
+   else
+      granted = stbuf.st_mode & 07;
+
+   if ( ((mask & R_OK) && !(granted & 04)) ||
+        ((mask & W_OK) && !(granted & 02)) ||
+        ((mask & X_OK) && !(granted & 01)) )
+      fuse_reply_err(req, EACCES);
+   else
+      fuse_reply_err(req, 0);
 }
 
-static int pvfs_fuse_create(const char *path, mode_t mode,
-							struct fuse_file_info *fi)
+static void pvfs_fuse_create(fuse_req_t req, fuse_ino_t parent,
+                             const char *name, mode_t mode,
+                             struct fuse_file_info *fi)
 {
    int rc;
-   int num_segs;
    PVFS_sys_attr attr;
-   char directory[PVFS_NAME_MAX];
-   char filename[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	dir_pfh, *pfhp;
+   pvfs_fuse_handle_t	*pfhp;
+   struct fuse_entry_param e;
+   struct stat		stbuf;
 
    PVFS_sysresp_create resp_create;
 
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, directory, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  filename, PVFS_SEGMENT_MAX);
-
-   if (rc)
+   pfhp = (pvfs_fuse_handle_t *)malloc( sizeof( pvfs_fuse_handle_t ) );
+   if (pfhp == NULL)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      fuse_reply_err(req, ENOMEM);
+      return;
    }
 
-   rc = lookup( directory, &dir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
+   rc = pvfs_fuse_gen_credential(req, &pfhp->cred);
    if ( rc < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+   {
+      free( pfhp );
+      pvfs_fuse_reply_err(req, rc);
+      return;
+   }
 
    /* Set attributes */
    memset(&attr, 0, sizeof(PVFS_sys_attr));
-   attr.owner = dir_pfh.cred.userid;
-   attr.group = dir_pfh.cred.group_array[0];
-   attr.perms = mode;
+   attr.owner = pfhp->cred.userid;
+   attr.group = pfhp->cred.group_array[0];
+   attr.perms = mode & 07777;
    attr.atime = time(NULL);
    attr.mtime = attr.atime;
    attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
    attr.dfile_count = 0;
 
-   rc = PVFS_sys_create(filename,
-						dir_pfh.ref,
+   rc = PVFS_sys_create((char *)name,
+						pvfs_fuse_ino_to_ref(parent),
 						attr,
-						&dir_pfh.cred,
+						&pfhp->cred,
 						NULL,
 						&resp_create);
-   if (rc)
+   if (rc == 0)
+   {
+      rc = pvfs_fuse_stat(resp_create.ref, &pfhp->cred, &stbuf);
+   }
+   else if ( rc == -PVFS_ENOENT )
    {
       /* FIXME
        * the PVFS2 server code returns a ENOENT instead of an EACCES
@@ -1044,49 +1360,54 @@ static int pvfs_fuse_create(const char *path, mode_t mode,
        * just passed up in prelude_check_acls (server/prelude.c).  I'm
        * not sure that's the right thing to do.
        */
-	  if ( rc == -PVFS_ENOENT ) 
-	  {
-		 return -EACCES;
-	  }
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      rc = -PVFS_EACCES;
    }
-
-   pfhp = (pvfs_fuse_handle_t *)malloc( sizeof( pvfs_fuse_handle_t ) );
-   if (pfhp == NULL)
+   if (rc < 0)
    {
-	  return -ENOMEM;
+      pvfs_fuse_cleanup_credential(&pfhp->cred);
+      free( pfhp );
+      pvfs_fuse_reply_err(req, rc);
+      return;
    }
 
    pfhp->ref = resp_create.ref;
-   pfhp->cred = dir_pfh.cred;
 
    SET_FUSE_HANDLE( fi, pfhp );
+   fi->direct_io = 1;
 
-   return 0;
+   pvfs_fuse_fill_entry(&e, &stbuf);
+   if (fuse_reply_create(req, &e, fi) == -ENOENT)
+   {
+      pvfs_fuse_cleanup_credential(&pfhp->cred);
+      free( pfhp );
+   }
 }
 
-static struct fuse_operations pvfs_fuse_oper = {
+static struct fuse_lowlevel_ops pvfs_fuse_oper = {
+   .init	= pvfs_fuse_init,
+   .lookup	= pvfs_fuse_lookup,
+   .forget	= pvfs_fuse_forget,
    .getattr	= pvfs_fuse_getattr,
-   .fgetattr	= pvfs_fuse_fgetattr,
+   .setattr	= pvfs_fuse_setattr,
    .readlink	= pvfs_fuse_readlink,
    .mkdir	= pvfs_fuse_mkdir,
-   .unlink	= pvfs_fuse_unlink,
-   .rmdir	= pvfs_fuse_rmdir,
+   .unlink	= pvfs_fuse_remove,
+   .rmdir	= pvfs_fuse_remove,
    .symlink	= pvfs_fuse_symlink,
    .rename	= pvfs_fuse_rename,
    /* .link	= pvfs_fuse_link, */ /* hard links not supported on PVFS */
-   .chmod	= pvfs_fuse_chmod,
-   .chown	= pvfs_fuse_chown,
-   .truncate	= pvfs_fuse_truncate,
-   .utime	= pvfs_fuse_utime,
    .open	= pvfs_fuse_open,
    .read	= pvfs_fuse_read,
-   .write	= pvfs_fuse_write,
+   .write_buf	= pvfs_fuse_write_buf,
    .statfs	= pvfs_fuse_statfs,
-/*  .flush	= pvfs_fuse_flush, */
    .release	= pvfs_fuse_release,
    .fsync	= pvfs_fuse_fsync,
+   .opendir	= pvfs_fuse_opendir,
    .readdir	= pvfs_fuse_readdir,
+#if FUSE_MAJOR_VERSION >= 3
+   .readdirplus	= pvfs_fuse_readdirplus,
+#endif
+   .releasedir	= pvfs_fuse_releasedir,
    .access	= pvfs_fuse_access,
    .create	= pvfs_fuse_create,
 };
@@ -1103,6 +1424,8 @@ enum {
 
 static struct fuse_opt pvfs2fuse_opts[] = {
    PVFS2FUSE_OPT("fs_spec=%s",     fs_spec, 0),
+   PVFS2FUSE_OPT("acache_timeout=%d", acache_timeout, 0),
+   PVFS2FUSE_OPT("ncache_timeout=%d", ncache_timeout, 0),
 
    FUSE_OPT_KEY("-V",             KEY_VERSION),
    FUSE_OPT_KEY("--version",      KEY_VERSION),
@@ -1120,21 +1443,18 @@ static void usage(const char *progname)
 		   "    -o opt,[opt...]        mount options\n"
 		   "    -h   --help            print help\n"
 		   "    -V   --version         print version\n"
+		   "    -f                     stay in the foreground\n"
+		   "    -s                     single threaded operation\n"
 		   "\n"
 		   "PVFS2FUSE options:\n"
 		   "    -o fs_spec=FS_SPEC     PVFS2 fs_spec URI (eg. tcp://localhost:3334/pvfs2-fs)\n"
+		   "    -o acache_timeout=MS   attribute cache timeout, also used for the\n"
+		   "                           kernel attribute timeout\n"
+		   "    -o ncache_timeout=MS   name cache timeout, also used for the\n"
+		   "                           kernel entry timeout\n"
 		   "\n", progname);
 }
 
-static int pvfs_fuse_main(struct fuse_args *args)
-{
-#if FUSE_VERSION >= 26
-   return fuse_main(args->argc, args->argv, &pvfs_fuse_oper, NULL);
-#else
-   return fuse_main(args->argc, args->argv, &pvfs_fuse_oper);
-#endif
-}
-
 static int pvfs2fuse_opt_proc(void *data, const char *arg, int key,
 							  struct fuse_args *outargs)
 {
@@ -1158,18 +1478,13 @@ static int pvfs2fuse_opt_proc(void *data, const char *arg, int key,
 
 	  case KEY_HELP:
 		 usage(outargs->argv[0]);
-		 /* FIXME don't show the FUSE arguments
-			fuse_opt_add_arg(outargs, "-ho");
-			pvfs_fuse_main(outargs); */
 		 exit(1);
 
 	  case KEY_VERSION:
 		 fprintf(stderr, "PVFS2FUSE version %s (PVFS2 %s) (%s, %s)\n",
 				 pvfs2fuse_version, PVFS2_VERSION, __DATE__, __TIME__);
-#if FUSE_VERSION >= 25
-		 fuse_opt_add_arg(outargs, "--version");
-		 pvfs_fuse_main(outargs);
-#endif
+		 fprintf(stderr, "FUSE library version %d.%d\n",
+				 FUSE_MAJOR_VERSION, FUSE_MINOR_VERSION);
 		 exit(0);
 
 	  default:
@@ -1178,54 +1493,16 @@ static int pvfs2fuse_opt_proc(void *data, const char *arg, int key,
    }
 }
 
-int main(int argc, char *argv[])
+/* pvfs_fuse_parse_fs_spec()
+ *
+ * fills in the mount entry from the fs_spec option
+ */
+static int pvfs_fuse_parse_fs_spec(void)
 {
-   int ret;
-   struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
-
-   umask(0);
-
-   if (fuse_opt_parse(&args, &pvfs2fuse, pvfs2fuse_opts,
-					  pvfs2fuse_opt_proc) == -1 )
-	  exit(1);
-
-   if (pvfs2fuse.fs_spec == NULL)
-   {
-	  ret = PVFS_util_init_defaults();
-	  if(ret < 0)
-	  {
-		 PVFS_perror("PVFS_util_init_defaults", ret);
-		 return(-1);
-	  }
-
-	  ret = PVFS_util_get_default_fsid(&pvfs2fuse.fs_id);
-	  if( ret < 0 )
-	  {
-		 PVFS_perror("No default PVFS2 filesystem found", ret);
-		 return(-1);
-	  }
-
-	  PVFS_util_get_mntent_copy( pvfs2fuse.fs_id, &pvfs2fuse.mntent );
-	  /* Set timeouts for PVFS2's name cache and attribute cache */
-	  PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, 0);
-	  PVFS_sys_set_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS, 0);
-   }
-   else
-   {
 	  struct PVFS_sys_mntent *me = &pvfs2fuse.mntent;
 	  char *cp;
 	  int cur_server;
 
-	  /* the following is copied from PVFS_util_init_defaults()
-		 in fuse/lib/pvfs2-util.c */
-
-	  /* initialize pvfs system interface */
-	  ret = PVFS_sys_initialize(GOSSIP_NO_DEBUG);
-	  if (ret < 0)
-	  {
-		 return(ret);
-	  }
-
 	  /* the following is copied from PVFS_util_parse_pvfstab()
 		 in fuse/lib/pvfs2-util.c */
 	  memset( me, 0, sizeof(pvfs2fuse.mntent) );
@@ -1244,7 +1521,7 @@ int main(int argc, char *argv[])
 		 malloc(me->num_pvfs_config_servers *
 				sizeof(*me->pvfs_config_servers));
 	  if (!me->pvfs_config_servers)
-		 exit(-1);
+		 return -1;
 	  memset(me->pvfs_config_servers, 0,
 			 me->num_pvfs_config_servers * sizeof(*me->pvfs_config_servers));
 
@@ -1273,37 +1550,37 @@ int main(int argc, char *argv[])
 		 {
 			fprintf(stderr,"Error: invalid FS spec: %s\n",
 					pvfs2fuse.fs_spec);
-			exit(-1);
+			return -1;
 		 }
 
 		 /* find a reference point in the string */
 		 last_slash = rindex(tok, '/');
 		 *last_slash = '\0';
 
-		 /* config server and fs name are a special case, take one 
+		 /* config server and fs name are a special case, take one
 		  * string and split it in half on "/" delimiter
 		  */
 		 me->pvfs_config_servers[cur_server] = strdup(tok);
 		 if (!me->pvfs_config_servers[cur_server])
-			exit(-1);
+			return -1;
 
 		 ++last_slash;
 
 		 if (cur_server == 0) {
 			me->pvfs_fs_name = strdup(last_slash);
 			if (!me->pvfs_fs_name)
-			   exit(-1);
+			   return -1;
 		 } else {
 			if (strcmp(last_slash, me->pvfs_fs_name) != 0) {
 			   fprintf(stderr,
 					   "Error: different fs names in server addresses: %s\n",
 					   pvfs2fuse.fs_spec);
-			   exit(-1);
+			   return -1;
 			}
 		 }
 		 ++cur_server;
 	  }
-	
+
 	  /* FIXME flowproto should be an option */
 	  me->flowproto = FLOWPROTO_DEFAULT;
 
@@ -1312,52 +1589,242 @@ int main(int argc, char *argv[])
 
 	  /* FIXME default_num_dfiles should be an option */
 
-	  ret = PVFS_sys_fs_add(me);
+	  return 0;
+}
+
+/* pvfs_fuse_init_pvfs()
+ *
+ * brings up the system interface and finds the root handle.  This
+ * starts the job threads, so it must run after fuse_daemonize().
+ */
+static int pvfs_fuse_init_pvfs(void)
+{
+   PVFS_sysresp_lookup	lk_response;
+   PVFS_credential	cred;
+   unsigned int		msecs;
+   int			ret;
+
+   if (pvfs2fuse.fs_spec == NULL)
+   {
+	  ret = PVFS_util_init_defaults();
+	  if(ret < 0)
+	  {
+		 PVFS_perror("PVFS_util_init_defaults", ret);
+		 return(-1);
+	  }
+
+	  ret = PVFS_util_get_default_fsid(&pvfs2fuse.fs_id);
+	  if( ret < 0 )
+	  {
+		 PVFS_perror("No default PVFS2 filesystem found", ret);
+		 return(-1);
+	  }
+
+	  PVFS_util_get_mntent_copy( pvfs2fuse.fs_id, &pvfs2fuse.mntent );
+   }
+   else
+   {
+	  /* the following is copied from PVFS_util_init_defaults()
+		 in fuse/lib/pvfs2-util.c */
+
+	  /* initialize pvfs system interface */
+	  ret = PVFS_sys_initialize(GOSSIP_NO_DEBUG);
+	  if (ret < 0)
+	  {
+		 PVFS_perror("PVFS_sys_initialize", ret);
+		 return(ret);
+	  }
+
+	  ret = PVFS_sys_fs_add(&pvfs2fuse.mntent);
 	  if( ret < 0 )
 	  {
 		 PVFS_perror("Could not add mnt entry", ret);
 		 return(-1);
 	  }
-	  pvfs2fuse.fs_id = me->fs_id;
+	  pvfs2fuse.fs_id = pvfs2fuse.mntent.fs_id;
    }
 
-   /* FIXME should we allow all the FUSE options?  Maybe we should
-	* pass only some of the FUSE options to fuse_main.  For now,
-	* force the direct_io and allow_other options.  Also turn off
-	* multithreaded operation since it doesnt work with PVFS.
+   /* the kernel caches names and attributes as long as the client
+    * library would have */
+   if (pvfs2fuse.acache_timeout >= 0)
+	  PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS,
+						pvfs2fuse.acache_timeout);
+   if (pvfs2fuse.ncache_timeout >= 0)
+	  PVFS_sys_set_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS,
+						pvfs2fuse.ncache_timeout);
+   if (PVFS_sys_get_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, &msecs) == 0)
+	  pvfs2fuse.attr_timeout = msecs / 1000.0;
+   if (PVFS_sys_get_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS, &msecs) == 0)
+	  pvfs2fuse.entry_timeout = msecs / 1000.0;
+
+   ret = PVFS_util_gen_credential_defaults(&cred);
+   if (ret < 0)
+   {
+	  PVFS_perror("PVFS_util_gen_credential_defaults", ret);
+	  return(-1);
+   }
+
+   memset(&lk_response, 0, sizeof(lk_response));
+   ret = PVFS_sys_lookup(pvfs2fuse.fs_id, "/", &cred, &lk_response,
+						 PVFS2_LOOKUP_LINK_NO_FOLLOW);
+   pvfs_fuse_cleanup_credential(&cred);
+   if (ret < 0)
+   {
+	  PVFS_perror("Could not look up the root directory", ret);
+	  return(-1);
+   }
+   pvfs2fuse.root_handle = lk_response.ref.handle;
+
+   return 0;
+}
+
+int main(int argc, char *argv[])
+{
+   int ret;
+   struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+   struct fuse_session *se;
+#if FUSE_MAJOR_VERSION >= 3
+   struct fuse_cmdline_opts opts;
+#else
+   struct fuse_chan *ch;
+   char *mountpoint;
+   int multithreaded, foreground;
+#endif
+
+   umask(0);
+
+   pvfs2fuse.acache_timeout = -1;
+   pvfs2fuse.ncache_timeout = -1;
+
+   if (fuse_opt_parse(&args, &pvfs2fuse, pvfs2fuse_opts,
+					  pvfs2fuse_opt_proc) == -1 )
+	  exit(1);
+
+   if (pvfs2fuse.mntpoint == NULL)
+   {
+	  usage(argv[0]);
+	  exit(1);
+   }
+
+   if (pvfs2fuse.fs_spec != NULL && pvfs_fuse_parse_fs_spec() < 0)
+	  exit(-1);
+
+   if (pthread_key_create(&pvfs_fuse_buffer_key, pvfs_fuse_free_buffer))
+	  exit(-1);
+
+   /* FIXME should we allow all the FUSE options?  For now force
+	* allow_other when running as root.  Requests are handled on
+	* multiple threads unless -s is given.
 	*/
 
-   fuse_opt_insert_arg( &args, 1, "-odirect_io" );
-   fuse_opt_insert_arg( &args, 1, "-oattr_timeout=0");
-   fuse_opt_insert_arg( &args, 1, "-omax_write=524288");
    if ( getuid() == 0 )
 	  fuse_opt_insert_arg( &args, 1, "-oallow_other" );
-   fuse_opt_insert_arg( &args, 1, "-s" );
-    
+
    {
 	  /* set the fsname and volname */
 	  char name[200];
-	  char *config = pvfs2fuse.mntent.the_pvfs_config_server;
+	  const struct PVFS_sys_mntent *me = &pvfs2fuse.mntent;
+
+	  if (pvfs2fuse.fs_spec == NULL)
+	  {
+		 /* PVFS_util_init_defaults() will use the first tab entry */
+		 const PVFS_util_tab *tab = PVFS_util_parse_pvfstab(NULL);
+
+		 me = (tab && tab->mntent_count > 0) ? &tab->mntent_array[0] : NULL;
+	  }
+
+	  if (me)
+	  {
+		 char *config = me->the_pvfs_config_server;
 
-	  if ( !config )
-		 config = pvfs2fuse.mntent.pvfs_config_servers[0];
+		 if ( !config )
+			config = me->pvfs_config_servers[0];
 
-	  snprintf( name, 200, "-ofsname=pvfs2fuse#%s/%s", config, pvfs2fuse.mntent.pvfs_fs_name );
-	  fuse_opt_insert_arg( &args, 1, name );
+		 snprintf( name, 200, "-ofsname=pvfs2fuse#%s/%s", config, me->pvfs_fs_name );
+		 fuse_opt_insert_arg( &args, 1, name );
 #if (__FreeBSD__ >= 10)
-	  snprintf( name, 200, "-ovolname=%s", pvfs2fuse.mntent.pvfs_fs_name );
-	  fuse_opt_insert_arg( &args, 1, name );
+		 snprintf( name, 200, "-ovolname=%s", me->pvfs_fs_name );
+		 fuse_opt_insert_arg( &args, 1, name );
 #endif
+	  }
    }
-    
-#if (__FreeBSD__ >= 10)
+
+   /* the client library's threads do not survive the fork in
+	* fuse_daemonize(), so the file system is mounted and the process
+	* detached before the PVFS system interface is brought up
+	*/
+#if FUSE_MAJOR_VERSION >= 3
+   if (fuse_parse_cmdline(&args, &opts) != 0)
+	  exit(1);
+
+   se = fuse_session_new(&args, &pvfs_fuse_oper,
+						 sizeof(pvfs_fuse_oper), NULL);
+   if (se == NULL)
+	  exit(1);
+
+   if (fuse_set_signal_handlers(se) != 0 ||
+	   fuse_session_mount(se, opts.mountpoint) != 0)
+   {
+	  fuse_session_destroy(se);
+	  exit(1);
+   }
+
+   fuse_daemonize(opts.foreground);
+
+   ret = pvfs_fuse_init_pvfs();
+   if (ret == 0)
+   {
+	  if (opts.singlethread)
+		 ret = fuse_session_loop(se);
+	  else
+		 ret = fuse_session_loop_mt(se, opts.clone_fd);
+   }
+
+   fuse_session_unmount(se);
+   fuse_remove_signal_handlers(se);
+   fuse_session_destroy(se);
+   /* allocated by libfuse, not by our malloc */
+   clean_free(opts.mountpoint);
+#else
+   if (fuse_parse_cmdline(&args, &mountpoint, &multithreaded,
+						  &foreground) == -1)
+	  exit(1);
+
+   ch = fuse_mount(mountpoint, &args);
+   if (ch == NULL)
+	  exit(1);
+
+   se = fuse_lowlevel_new(&args, &pvfs_fuse_oper,
+						  sizeof(pvfs_fuse_oper), NULL);
+   if (se == NULL || fuse_set_signal_handlers(se) != 0)
    {
-	  /* MacFUSE has a bug where cached attributes
-	   * arent invalidated on direct_io writes
-	   */
-	  fuse_opt_insert_arg( &args, 1, "-oattr_timeout=0" );
+	  if (se)
+		 fuse_session_destroy(se);
+	  fuse_unmount(mountpoint, ch);
+	  exit(1);
    }
+   fuse_session_add_chan(se, ch);
+
+   fuse_daemonize(foreground);
+
+   ret = pvfs_fuse_init_pvfs();
+   if (ret == 0)
+   {
+	  if (multithreaded)
+		 ret = fuse_session_loop_mt(se);
+	  else
+		 ret = fuse_session_loop(se);
+   }
+
+   fuse_remove_signal_handlers(se);
+   fuse_session_remove_chan(ch);
+   fuse_session_destroy(se);
+   fuse_unmount(mountpoint, ch);
+   clean_free(mountpoint);
 #endif
 
-   return pvfs_fuse_main(&args);
+   fuse_opt_free_args(&args);
+   PVFS_sys_finalize();
+
+   return ret ? 1 : 0;
 }
@@ -60,12 +60,12 @@
 /* only relevant if USE_RA_CACHE is on */
 
 /*
-  an arbitrary limit to the max number of operations we'll support in
-  flight at once, and the max number of items we can write into the
+  the default number of operations we'll support in flight at once
+  (--max-ops), and the max number of items we can write into the
   device file as a response
 */
-#define MAX_NUM_OPS                 64
-#define MAX_LIST_SIZE      MAX_NUM_OPS
+#define DEFAULT_MAX_NUM_OPS        256
+#define MAX_LIST_SIZE               64
 #define IOX_HINDEXED_COUNT          64
 
 #define REMOUNT_PENDING     0xFFEEFF33
@@ -77,6 +77,9 @@
 */
 #define PVFS2_CLIENT_DEFAULT_TEST_TIMEOUT_MS 10
 
+/* default age at which write-behind data is written out */
+#define DEFAULT_WRITE_BEHIND_TIMEOUT_MS 1000
+
 /*
   uncomment for timing of individual operation information to be
   emitted to the pvfs2-client logging output
@@ -143,6 +146,14 @@ typedef struct
     int readahead_readcnt;
     int readahead_pinned;
     char *bmi_opts;
+    /* request processing threads and operations kept in flight */
+    unsigned int num_threads;
+    unsigned int max_ops;
+    /* socket of a device emulator to use instead of the kernel device */
+    char *dev_emulator;
+    /* per-file write-behind buffer size (0 disables) and flush age */
+    unsigned int write_behind_size;
+    unsigned int write_behind_timeout;
 } options_t;
 
 /*
@@ -168,6 +179,7 @@ char *iotype = NULL;
 
 /* used for generating unique dynamic mount point names */
 static int dynamic_mount_id = 1;
+static gen_mutex_t dynamic_mount_id_mutex = GEN_MUTEX_INITIALIZER;
 
 typedef struct
 {
@@ -206,6 +218,10 @@ typedef struct
     int was_handled_inline; /* does not see to have any effect */
     int was_cancelled_io;
 
+    /* worker thread that processes every completion of this request */
+    int owner;
+    int mount_id; /* used only by mount */
+
     struct qlist_head hash_link;
 
 #ifdef CLIENT_CORE_OP_TIMING
@@ -259,15 +275,80 @@ static struct PINT_dev_params s_desc_params[NUM_MAP_DESC];
 /* static char hostname[100]; */
 
 /* used only for deleting all allocated vfs_request objects */
-vfs_request_t *s_vfs_request_array[MAX_NUM_OPS] = {NULL};
+static vfs_request_t **s_vfs_request_array = NULL;
 
 static struct PINT_tcache *credential_cache = NULL;
+static gen_mutex_t credential_cache_mutex = GEN_MUTEX_INITIALIZER;
 
 /* this hashtable is used to keep track of operations in progress */
 #define DEFAULT_OPS_IN_PROGRESS_HTABLE_SIZE 67
 static int hash_key(const void *key, int table_size);
 static int hash_key_compare(const void *key, struct qlist_head *link);
 static struct qhash_table *s_ops_in_progress_table = NULL;
+static gen_mutex_t s_ops_in_progress_mutex = GEN_MUTEX_INITIALIZER;
+
+/*
+  with --threads=N (N > 1) the main thread only drives sysint progress
+  and hands each completed operation to the worker that owns its
+  vfs_request; the workers decode upcalls, post operations and write
+  downcalls in parallel.  Every completion of a given vfs_request goes
+  to the same worker, so a request is never handled by two threads at
+  once.
+*/
+typedef struct
+{
+    vfs_request_t *vfs_request;
+    PVFS_sys_op_id op_id;
+    int error_code;
+} vfs_completion_t;
+
+typedef struct
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    /* ring of completions waiting for this worker; grows as needed */
+    vfs_completion_t *queue;
+    int queue_size;
+    int queue_head;
+    int queue_count;
+} vfs_worker_t;
+
+static vfs_worker_t *s_workers = NULL;
+static int s_workers_stop = 0;
+
+/*
+  with --write-behind=BYTES, a small write that continues where the
+  buffered data of its file ends is copied into a per-file buffer and
+  acknowledged at once.  The buffer is written out up to a stripe
+  boundary when it fills, in full once its oldest data is
+  --write-behind-timeout msecs old, and before any other operation that
+  could observe the file's data or size.  An error writing deferred
+  data is returned by the next I/O, fsync or close of the file.
+*/
+#define WRITE_BEHIND_HTABLE_SIZE 67
+
+typedef struct
+{
+    struct qlist_head hash_link;
+    PVFS_object_ref refn;
+    /* held while the buffer is filled or written out */
+    gen_mutex_t mutex;
+    /* threads using the record; freed at zero once empty */
+    int refcount;
+    PVFS_uid uid;
+    PVFS_gid gid;
+    char *buf;
+    PVFS_size buf_size;
+    PVFS_offset offset; /* file offset of buf[0] */
+    PVFS_size len;
+    PVFS_time first_write_ms;
+    PVFS_error error; /* deferred for the next operation on the file */
+} write_behind_t;
+
+static struct qhash_table *s_write_behind_table = NULL;
+static gen_mutex_t s_write_behind_mutex = GEN_MUTEX_INITIALIZER;
+static int s_write_behind_count = 0;
 
 static void parse_args(int argc, char **argv, options_t *opts);
 static void print_help(char *progname);
@@ -284,6 +365,8 @@ static int set_ncache_parameters(options_t* s_opts);
 static int set_capcache_parameters(options_t* s_opts);
 static void finalize_perf_items(int n, ... );
 inline static void fill_hints(vfs_request_t *req);
+static PVFS_error write_behind_flush(PVFS_object_ref refn, int report);
+static void write_behind_flush_all(PVFS_fs_id fs_id, PVFS_time age_ms);
 
 #ifdef USE_RA_CACHE
 static PVFS_error post_io_readahead_request(vfs_request_t *vfs_request,
@@ -461,9 +544,11 @@ static PVFS_error add_op_to_ops_in_progress_table(
 
     if (vfs_request)
     {
+        gen_mutex_lock(&s_ops_in_progress_mutex);
         qhash_add(s_ops_in_progress_table,
                   (void *)(&vfs_request->info.tag),
                   &vfs_request->hash_link);
+        gen_mutex_unlock(&s_ops_in_progress_mutex);
         ret = 0;
     }
     return ret;
@@ -481,6 +566,12 @@ static PVFS_error cancel_op_in_progress(PVFS_id_gen_t tag)
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
                  "cancel_op_in_progress called\n");
 
+    /*
+      the request being cancelled may belong to another worker; holding
+      the table lock keeps it from completing and being reused until we
+      are done with it
+    */
+    gen_mutex_lock(&s_ops_in_progress_mutex);
     hash_link = qhash_search( s_ops_in_progress_table, (void *)(&tag));
     if (hash_link)
     {
@@ -520,6 +611,7 @@ static PVFS_error cancel_op_in_progress(PVFS_id_gen_t tag)
         gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "op in progress cannot "
                      "be found (tag = %lld)\n", lld(tag));
     }
+    gen_mutex_unlock(&s_ops_in_progress_mutex);
     return ret;
 }
 
@@ -534,6 +626,7 @@ static int is_op_in_progress(vfs_request_t *vfs_request)
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "is_op_in_progress called on "
                  "tag %lld\n", lld(vfs_request->info.tag));
 
+    gen_mutex_lock(&s_ops_in_progress_mutex);
     hash_link = qhash_search( s_ops_in_progress_table, 
                               (void *)(&vfs_request->info.tag));
     if (hash_link)
@@ -545,6 +638,7 @@ static int is_op_in_progress(vfs_request_t *vfs_request)
                     (tmp_request->in_upcall.type ==
                      vfs_request->in_upcall.type));
     }
+    gen_mutex_unlock(&s_ops_in_progress_mutex);
     return op_found;
 }
 
@@ -557,8 +651,10 @@ static PVFS_error remove_op_from_ops_in_progress_table(
 
     if (vfs_request)
     {
+        gen_mutex_lock(&s_ops_in_progress_mutex);
         hash_link = qhash_search_and_remove(s_ops_in_progress_table,
                                             (void *)(&vfs_request->info.tag));
+        gen_mutex_unlock(&s_ops_in_progress_mutex);
         if (hash_link)
         {
             tmp_vfs_request = qhash_entry(hash_link,
@@ -827,6 +923,9 @@ static PVFS_error post_getattr_request(vfs_request_t *vfs_request)
                   &(vfs_request->in_upcall.req.getattr.refn.khandle));
     refn.fs_id = vfs_request->in_upcall.req.getattr.refn.fs_id;
 
+    /* the size must include anything still in write-behind */
+    write_behind_flush(refn, 0);
+
     ret = PVFS_isys_getattr(
             refn,
             vfs_request->in_upcall.req.getattr.mask,
@@ -875,6 +974,8 @@ static PVFS_error post_setattr_request(vfs_request_t *vfs_request)
                        &(vfs_request->in_upcall.req.setattr.refn.khandle));
     refn.fs_id = vfs_request->in_upcall.req.setattr.refn.fs_id;
 
+    write_behind_flush(refn, 0);
+
     ret = PVFS_isys_setattr(refn,
                             vfs_request->in_upcall.req.setattr.attributes,
                             credential,
@@ -922,6 +1023,10 @@ static PVFS_error post_remove_request(vfs_request_t *vfs_request)
 
     refn.fs_id = vfs_request->in_upcall.req.remove.parent_refn.fs_id;
 
+    /* the upcall names only the parent, so write out every buffered
+     * file of the file system before the entry may disappear */
+    write_behind_flush_all(refn.fs_id, 0);
+
     ret = PVFS_isys_remove(vfs_request->in_upcall.req.remove.d_name,
                            refn,
                            credential,
@@ -1180,6 +1285,8 @@ static PVFS_error post_truncate_request(vfs_request_t *vfs_request)
 
     refn.fs_id = vfs_request->in_upcall.req.truncate.refn.fs_id;
 
+    write_behind_flush(refn, 0);
+
     ret = PVFS_isys_truncate(refn,
                              vfs_request->in_upcall.req.truncate.size,
                              credential,
@@ -1493,7 +1600,7 @@ static PVFS_error post_listxattr_request(vfs_request_t *vfs_request)
 
 
 static inline int generate_upcall_mntent(struct PVFS_sys_mntent *mntent,
-        pvfs2_upcall_t *in_upcall, int mount) 
+        pvfs2_upcall_t *in_upcall, int mount, int mount_id) 
 {
     char *ptr = NULL, *ptrcomma = NULL;
     char buf[PATH_MAX] = {0};
@@ -1504,7 +1611,7 @@ static inline int generate_upcall_mntent(struct PVFS_sys_mntent *mntent,
       passed in id from the upcall
     */
     if (mount)
-        snprintf(buf, PATH_MAX, "<DYNAMIC-%d>", dynamic_mount_id);
+        snprintf(buf, PATH_MAX, "<DYNAMIC-%d>", mount_id);
     else
         snprintf(buf, PATH_MAX, "<DYNAMIC-%d>", in_upcall->req.fs_umount.id);
 
@@ -1623,7 +1730,12 @@ static PVFS_error post_fs_mount_request(vfs_request_t *vfs_request)
         "Got an fs mount request for host:\n  %s\n",
         vfs_request->in_upcall.req.fs_mount.pvfs2_config_server);
 
-    ret = generate_upcall_mntent(vfs_request->mntent, &vfs_request->in_upcall, 1);
+    gen_mutex_lock(&dynamic_mount_id_mutex);
+    vfs_request->mount_id = dynamic_mount_id++;
+    gen_mutex_unlock(&dynamic_mount_id_mutex);
+
+    ret = generate_upcall_mntent(vfs_request->mntent, &vfs_request->in_upcall,
+                                 1, vfs_request->mount_id);
     if (ret < 0)
     {
         goto failed;
@@ -1656,7 +1768,9 @@ static PVFS_error service_fs_umount_request(vfs_request_t *vfs_request)
         "Got an fs umount request via host %s\n",
         vfs_request->in_upcall.req.fs_umount.pvfs2_config_server);
 
-    ret = generate_upcall_mntent(&mntent, &vfs_request->in_upcall, 0);
+    write_behind_flush_all(vfs_request->in_upcall.req.fs_umount.fs_id, 0);
+
+    ret = generate_upcall_mntent(&mntent, &vfs_request->in_upcall, 0, 0);
     if (ret < 0)
     {
         goto fail_downcall;
@@ -1754,6 +1868,24 @@ static PVFS_error service_perf_count_request(vfs_request_t *vfs_request)
                 vfs_request->out_downcall.status = 0;
             }
             break;
+
+#ifdef USE_RA_CACHE
+        case PVFS2_PERF_COUNT_REQUEST_RACACHE:
+            tmp_str = PINT_perf_generate_text(pint_racache_get_pc(),
+                PERF_COUNT_BUF_SIZE);
+            if(!tmp_str)
+            {
+                vfs_request->out_downcall.status = -PVFS_EINVAL;
+            }
+            else
+            {
+                strncpy(vfs_request->out_downcall.resp.perf_count.buffer,
+                    tmp_str, PERF_COUNT_BUF_SIZE - 1);
+                free(tmp_str);
+                vfs_request->out_downcall.status = 0;
+            }
+            break;
+#endif
            
         default:
             /* unsupported request, didn't match anything in case statement */
@@ -2111,8 +2243,10 @@ static PVFS_error service_param_request(vfs_request_t *vfs_request)
         }
         else if (tmp_subsystem == CCACHE)
         {
+            gen_mutex_lock(&credential_cache_mutex);
             vfs_request->out_downcall.status = 
                 PINT_tcache_get_info(credential_cache, tmp_param, &val);
+            gen_mutex_unlock(&credential_cache_mutex);
             if (vfs_request->in_upcall.req.param.op == 
                 PVFS2_PARAM_REQUEST_OP_CCACHE_TIMEOUT_SECS)
             {
@@ -2153,8 +2287,10 @@ static PVFS_error service_param_request(vfs_request_t *vfs_request)
             {
                 val *= 1000;
             }
+            gen_mutex_lock(&credential_cache_mutex);
             vfs_request->out_downcall.status = 
                 PINT_tcache_set_info(credential_cache, tmp_param, val);
+            gen_mutex_unlock(&credential_cache_mutex);
         }
         else /* CAPCACHE */
         {
@@ -2267,6 +2403,439 @@ out:
     return 0;
 }
 
+/* file_stripe_size()
+ *
+ * returns the full stripe width of a file (strip size times datafile
+ * count for simple_stripe) from the attribute cache, or 0 if the
+ * attributes are not cached
+ */
+static PVFS_size file_stripe_size(PVFS_object_ref refn)
+{
+    PVFS_object_attr attr;
+    PVFS_size size = 0;
+    PVFS_size stripe_sz = 0;
+    int attr_status = 0;
+    int size_status = 0;
+
+    memset(&attr, 0, sizeof(attr));
+    if (PINT_acache_get_cached_entry(refn, &attr, &attr_status,
+                                     &size, &size_status) == 0 &&
+        attr_status == 0)
+    {
+        if (attr.objtype == PVFS_TYPE_METAFILE &&
+            (attr.mask & PVFS_ATTR_META_DIST) &&
+            attr.u.meta.dist && attr.u.meta.dist->methods->get_blksize)
+        {
+            stripe_sz = attr.u.meta.dist->methods->get_blksize(
+                                                attr.u.meta.dist->params,
+                                                attr.u.meta.dfile_count);
+        }
+        PINT_free_object_attr(&attr);
+    }
+    return stripe_sz;
+}
+
+/* write_behind_hash()
+ *
+ * hash and compare functions of the write-behind table, which is
+ * keyed by object reference
+ */
+static int write_behind_hash(const void *key, int table_size)
+{
+    const PVFS_object_ref *refn = (const PVFS_object_ref *)key;
+    return (int)((refn->handle + refn->fs_id) % table_size);
+}
+
+static int write_behind_compare(const void *key, struct qlist_head *link)
+{
+    const PVFS_object_ref *refn = (const PVFS_object_ref *)key;
+    write_behind_t *wb = qlist_entry(link, write_behind_t, hash_link);
+
+    return ((wb->refn.handle == refn->handle &&
+             wb->refn.fs_id == refn->fs_id) ? 1 : 0);
+}
+
+/* write_behind_get()
+ *
+ * finds the write-behind record of a file, creating it if asked, and
+ * returns it locked with a reference held; NULL if there is none
+ */
+static write_behind_t *write_behind_get(PVFS_object_ref refn, int create)
+{
+    struct qlist_head *link = NULL;
+    write_behind_t *wb = NULL;
+
+    if (!s_write_behind_table || (s_write_behind_count == 0 && !create))
+    {
+        return NULL;
+    }
+
+    gen_mutex_lock(&s_write_behind_mutex);
+    link = qhash_search(s_write_behind_table, &refn);
+    if (link)
+    {
+        wb = qlist_entry(link, write_behind_t, hash_link);
+    }
+    else if (create)
+    {
+        wb = calloc(1, sizeof(write_behind_t));
+        if (wb)
+        {
+            wb->refn = refn;
+            gen_mutex_init(&wb->mutex);
+            qhash_add(s_write_behind_table, &wb->refn, &wb->hash_link);
+            s_write_behind_count++;
+        }
+    }
+    if (wb)
+    {
+        wb->refcount++;
+    }
+    gen_mutex_unlock(&s_write_behind_mutex);
+
+    if (wb)
+    {
+        gen_mutex_lock(&wb->mutex);
+    }
+    return wb;
+}
+
+/* write_behind_put()
+ *
+ * unlocks a record and drops its reference; the last user frees it
+ * if nothing is buffered and no error is waiting to be reported
+ */
+static void write_behind_put(write_behind_t *wb)
+{
+    int free_wb = 0;
+
+    gen_mutex_unlock(&wb->mutex);
+
+    gen_mutex_lock(&s_write_behind_mutex);
+    if (--wb->refcount == 0 && wb->len == 0 && wb->error == 0)
+    {
+        qhash_del(&wb->hash_link);
+        s_write_behind_count--;
+        free_wb = 1;
+    }
+    gen_mutex_unlock(&s_write_behind_mutex);
+
+    if (free_wb)
+    {
+        gen_mutex_destroy(&wb->mutex);
+        free(wb->buf);
+        free(wb);
+    }
+}
+
+/* write_behind_write_out()
+ *
+ * writes the first amount bytes buffered in a locked record to the
+ * file.  On failure the buffered data is dropped and the error kept
+ * in the record for the next operation on the file.
+ */
+static PVFS_error write_behind_write_out(write_behind_t *wb,
+                                         PVFS_size amount)
+{
+    PVFS_error ret = 0;
+    PVFS_Request mem_req = NULL, file_req = NULL;
+    PVFS_credential *credential = NULL;
+    PVFS_sysresp_io resp;
+
+    if (amount <= 0)
+    {
+        return 0;
+    }
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "write-behind: writing %lld of "
+                 "%lld bytes at %lld to %llu,%d\n", lld(amount),
+                 lld(wb->len), lld(wb->offset), llu(wb->refn.handle),
+                 wb->refn.fs_id);
+
+    ret = PVFS_Request_contiguous((int32_t)amount, PVFS_BYTE, &mem_req);
+    if (ret == 0)
+    {
+        ret = PVFS_Request_contiguous((int32_t)amount, PVFS_BYTE, &file_req);
+    }
+    if (ret == 0)
+    {
+        credential = lookup_credential(wb->uid, wb->gid);
+        memset(&resp, 0, sizeof(resp));
+        ret = PVFS_sys_write(wb->refn, file_req, wb->offset, wb->buf,
+                             mem_req, credential, &resp, NULL);
+        if (ret == 0 && resp.total_completed != amount)
+        {
+            ret = -PVFS_EIO;
+        }
+        if (credential)
+        {
+            PINT_cleanup_credential(credential);
+            free(credential);
+        }
+    }
+    if (file_req)
+    {
+        PVFS_Request_free(&file_req);
+    }
+    if (mem_req)
+    {
+        PVFS_Request_free(&mem_req);
+    }
+
+    if (ret < 0)
+    {
+        PVFS_perror_gossip("Write-behind of buffered data failed", ret);
+        wb->error = ret;
+        wb->len = 0;
+        return ret;
+    }
+
+    wb->len -= amount;
+    memmove(wb->buf, wb->buf + amount, wb->len);
+    wb->offset += amount;
+    return 0;
+}
+
+/* write_behind_flush()
+ *
+ * writes out anything buffered for a file.  With report set, a
+ * deferred write error is returned and cleared; otherwise it is left
+ * for the next I/O, fsync or close of the file.
+ */
+static PVFS_error write_behind_flush(PVFS_object_ref refn, int report)
+{
+    PVFS_error ret = 0;
+    write_behind_t *wb = NULL;
+
+    wb = write_behind_get(refn, 0);
+    if (!wb)
+    {
+        return 0;
+    }
+    write_behind_write_out(wb, wb->len);
+    if (report)
+    {
+        ret = wb->error;
+        wb->error = 0;
+    }
+    write_behind_put(wb);
+    return ret;
+}
+
+/* write_behind_flush_all()
+ *
+ * writes out every buffered file of fs_id (of all file systems if
+ * fs_id is PVFS_FS_ID_NULL) whose oldest data is at least age_ms old
+ */
+static void write_behind_flush_all(PVFS_fs_id fs_id, PVFS_time age_ms)
+{
+    struct qlist_head *link = NULL;
+    write_behind_t *wb = NULL;
+    write_behind_t **flush = NULL;
+    PVFS_time now = 0;
+    int i = 0, count = 0;
+
+    if (!s_write_behind_table || s_write_behind_count == 0)
+    {
+        return;
+    }
+
+    now = PINT_util_get_time_ms();
+    gen_mutex_lock(&s_write_behind_mutex);
+    flush = malloc(s_write_behind_count * sizeof(write_behind_t *));
+    for(i = 0; flush && i < s_write_behind_table->table_size; i++)
+    {
+        qhash_for_each(link, &s_write_behind_table->array[i])
+        {
+            wb = qlist_entry(link, write_behind_t, hash_link);
+            if ((fs_id == PVFS_FS_ID_NULL || wb->refn.fs_id == fs_id) &&
+                wb->len > 0 && now - wb->first_write_ms >= age_ms)
+            {
+                wb->refcount++;
+                flush[count++] = wb;
+            }
+        }
+    }
+    gen_mutex_unlock(&s_write_behind_mutex);
+
+    for(i = 0; i < count; i++)
+    {
+        wb = flush[i];
+        gen_mutex_lock(&wb->mutex);
+        if (now - wb->first_write_ms >= age_ms)
+        {
+            write_behind_write_out(wb, wb->len);
+        }
+        write_behind_put(wb);
+    }
+    free(flush);
+}
+
+/* write_behind_finalize()
+ *
+ * writes out all buffered data and frees the write-behind table
+ */
+static void write_behind_finalize(void)
+{
+    struct qlist_head *link = NULL, *tmp = NULL;
+    write_behind_t *wb = NULL;
+    int i = 0;
+
+    if (!s_write_behind_table)
+    {
+        return;
+    }
+    write_behind_flush_all(PVFS_FS_ID_NULL, 0);
+
+    for(i = 0; i < s_write_behind_table->table_size; i++)
+    {
+        qhash_for_each_safe(link, tmp, &s_write_behind_table->array[i])
+        {
+            wb = qlist_entry(link, write_behind_t, hash_link);
+            qhash_del(&wb->hash_link);
+            gen_mutex_destroy(&wb->mutex);
+            free(wb->buf);
+            free(wb);
+        }
+    }
+    qhash_finalize(s_write_behind_table);
+    s_write_behind_table = NULL;
+    s_write_behind_count = 0;
+}
+
+/* post_write_behind_request()
+ *
+ * passes a file I/O upcall through the write-behind buffer of its
+ * file.  A small write that continues the buffered data is copied in
+ * and completed inline (*absorbed is set); before anything else the
+ * buffered data is written out.  Returns a deferred write error, if
+ * there is one.
+ */
+static PVFS_error post_write_behind_request(vfs_request_t *vfs_request,
+                                            PVFS_object_ref refn,
+                                            int *absorbed)
+{
+    PVFS_error ret = 0;
+    write_behind_t *wb = NULL;
+    PVFS_size count = vfs_request->in_upcall.req.io.count;
+    PVFS_offset offset = vfs_request->in_upcall.req.io.offset;
+    PVFS_size capacity = s_opts.write_behind_size;
+    PVFS_size stripe_sz = 0, amount = 0, new_size = 0;
+    char *new_buf = NULL;
+
+    *absorbed = 0;
+    if (vfs_request->in_upcall.req.io.io_type != PVFS_IO_WRITE ||
+        count <= 0 || count > capacity / 4)
+    {
+        return write_behind_flush(refn, 1);
+    }
+
+    wb = write_behind_get(refn, 1);
+    if (!wb)
+    {
+        /* no memory for a record, write through */
+        return 0;
+    }
+    if (wb->error)
+    {
+        goto report;
+    }
+
+    /* only a continuation of the buffered data by the same user can be
+     * added to it
+     */
+    if (wb->len > 0 &&
+        (offset != wb->offset + wb->len ||
+         wb->uid != vfs_request->in_upcall.uid ||
+         wb->gid != vfs_request->in_upcall.gid))
+    {
+        if (write_behind_write_out(wb, wb->len) < 0)
+        {
+            goto report;
+        }
+    }
+
+    if (wb->len + count > capacity)
+    {
+        /* write out whole stripes and keep the partial one buffered,
+         * unless the new data would still not fit
+         */
+        stripe_sz = file_stripe_size(refn);
+        amount = wb->len;
+        if (stripe_sz > 0)
+        {
+            amount -= (wb->offset + wb->len) % stripe_sz;
+        }
+        if (amount <= 0 || wb->len - amount + count > capacity)
+        {
+            amount = wb->len;
+        }
+        if (write_behind_write_out(wb, amount) < 0)
+        {
+            goto report;
+        }
+    }
+
+    if (wb->len + count > wb->buf_size)
+    {
+        /* buffers grow as needed so idle or slow files stay small */
+        new_size = (wb->buf_size ? wb->buf_size : 4 * count);
+        while(new_size < wb->len + count)
+        {
+            new_size *= 2;
+        }
+        if (new_size > capacity)
+        {
+            new_size = capacity;
+        }
+        new_buf = realloc(wb->buf, new_size);
+        if (!new_buf)
+        {
+            /* write through */
+            if (write_behind_write_out(wb, wb->len) < 0)
+            {
+                goto report;
+            }
+            goto out;
+        }
+        wb->buf = new_buf;
+        wb->buf_size = new_size;
+    }
+
+    assert((vfs_request->in_upcall.req.io.buf_index > -1) &&
+           (vfs_request->in_upcall.req.io.buf_index <
+            s_desc_params[BM_IO].dev_buffer_count));
+    vfs_request->io_kernel_mapped_buf =
+           PINT_dev_get_mapped_buffer(BM_IO,
+                                      s_io_desc,
+                                      vfs_request->in_upcall.req.io.buf_index);
+    assert(vfs_request->io_kernel_mapped_buf);
+
+    if (wb->len == 0)
+    {
+        wb->offset = offset;
+        wb->uid = vfs_request->in_upcall.uid;
+        wb->gid = vfs_request->in_upcall.gid;
+        wb->first_write_ms = PINT_util_get_time_ms();
+    }
+    memcpy(wb->buf + wb->len, vfs_request->io_kernel_mapped_buf, count);
+    wb->len += count;
+
+    vfs_request->out_downcall.type = PVFS2_VFS_OP_FILE_IO;
+    vfs_request->out_downcall.status = 0;
+    vfs_request->response.io.total_completed = count;
+    vfs_request->op_id = -1;
+    *absorbed = 1;
+    goto out;
+
+report:
+    ret = wb->error;
+    wb->error = 0;
+out:
+    write_behind_put(wb);
+    return ret;
+}
+
 #ifdef USE_RA_CACHE
 static PVFS_error post_io_readahead_request(vfs_request_t *vfs_request,
                                             racache_buffer_t *buff)
@@ -2404,7 +2973,9 @@ static PVFS_error create_phantom_req(vfs_request_t **reqpp,
 
 /* This checks to see if we should do a speculative readahead
  * by seeing if there is already a buffer beyond the current one
- * for this file
+ * for this file.  The number of buffers comes from the file's
+ * readahead window, which grows while the file is read sequentially,
+ * stretched to end on a stripe boundary.
  */
 static PVFS_error check_for_speculative(vfs_request_t *vfs_request,
                                       racache_buffer_t *prev_buff)
@@ -2415,16 +2986,17 @@ static PVFS_error check_for_speculative(vfs_request_t *vfs_request,
     PVFS_object_ref refn;
     int amt_returned;
     int b;
+    int count;
 
     gossip_debug(GOSSIP_RACACHE_DEBUG,
                  "CHECK_for_speculative called\n");
 
     /* buff is the readahead buffer we just finished reading 
-     * don't start a speculative on a speculative or if we are
-     * at EOF */
-    if (vfs_request->is_readahead_speculative)
+     * don't read further ahead from a speculative buffer nobody has
+     * asked for yet, or if we are at EOF */
+    if (vfs_request->is_readahead_speculative && prev_buff->hits == 0)
     {
-        /* don't double up on speculative */
+        /* don't run ahead of the reader */
         gossip_debug(GOSSIP_RACACHE_DEBUG,
                      "--- check_for_speculative negative:SPEC\n");
         return 0;
@@ -2438,19 +3010,21 @@ static PVFS_error check_for_speculative(vfs_request_t *vfs_request,
         return 0;
     }
 
-    if (prev_buff->readcnt < 1)
+    /* compat */
+    refn.handle = pvfs2_khandle_to_ino(
+                        &(vfs_request->in_upcall.req.io.refn.khandle));
+    refn.fs_id = vfs_request->in_upcall.req.io.refn.fs_id;
+
+    count = pint_racache_readahead_count(prev_buff,
+                                         file_stripe_size(refn));
+    if (count < 1)
     {
-        /* read count less than one so don't readahead */
+        /* window closed or just this buffer so don't readahead */
         gossip_debug(GOSSIP_RACACHE_DEBUG,
                      "--- check_for_speculative readcnt:NONE\n");
         return 0;
     }
 
-    /* compat */
-    refn.handle = pvfs2_khandle_to_ino(
-                        &(vfs_request->in_upcall.req.io.refn.khandle));
-    refn.fs_id = vfs_request->in_upcall.req.io.refn.fs_id;
-
     /* We need a request struct in order to search for
      * a buffer, so we build one here.  
      * If we find a buffer we will free this, * otherwise
@@ -2466,12 +3040,11 @@ static PVFS_error check_for_speculative(vfs_request_t *vfs_request,
     }
 
     /* The first read was the original buffer
-     * so potentially issue prev_buff->readcnt - 1 more
+     * so potentially issue count more
      */
     gossip_debug(GOSSIP_RACACHE_DEBUG,
-              "--- check_for_speculative issue %d more reads\n",
-              (int)(prev_buff->readcnt - 1));
-    for(b = 1; b < prev_buff->readcnt; b++)
+              "--- check_for_speculative issue %d more reads\n", count);
+    for(b = 1; b <= count; b++)
     {
 
         /* select the desired buffer */
@@ -2567,15 +3140,38 @@ static PVFS_error post_io_request(vfs_request_t *vfs_request)
     PVFS_error ret = -PVFS_EINVAL;
     PVFS_credential *credential;
     PVFS_object_ref refn;
+    int absorbed = 0;
     
 #ifdef USE_RA_CACHE
     char *s = NULL;
     int amt_returned = 0;
     racache_buffer_t *buff;
+#endif
 
-    vfs_request->racache_status = RACACHE_NONE;
-    vfs_request->racache_buff = NULL;
-    vfs_request->is_readahead_speculative = 0;
+    if (s_opts.write_behind_size > 0)
+    {
+        /* compat */
+        refn.handle = pvfs2_khandle_to_ino(
+                      &(vfs_request->in_upcall.req.io.refn.khandle));
+        refn.fs_id = vfs_request->in_upcall.req.io.refn.fs_id;
+
+        ret = post_write_behind_request(vfs_request, refn, &absorbed);
+        if (ret < 0 || absorbed)
+        {
+#ifdef USE_RA_CACHE
+            if (absorbed)
+            {
+                pint_racache_flush(refn);
+            }
+#endif
+            return ret;
+        }
+    }
+
+#ifdef USE_RA_CACHE
+    vfs_request->racache_status = RACACHE_NONE;
+    vfs_request->racache_buff = NULL;
+    vfs_request->is_readahead_speculative = 0;
     if (vfs_request->in_upcall.req.io.io_type == PVFS_IO_READ)
     {
         s = calloc(1, HANDLESTRINGSIZE);
@@ -2706,10 +3302,17 @@ static PVFS_error post_io_request(vfs_request_t *vfs_request)
                  * an actual read in RCACHE_READ below which causes
                  * check_for_speculative to run when that request
                  * returns in package_downcall_members
+                 * Only the first read served from a buffer extends
+                 * the window; later hits on it would find the same
+                 * buffers already in flight.
                  */
 #define PVFS2_RACACHE_ALWAYS_READ 1
 #if PVFS2_RACACHE_ALWAYS_READ
-                ret = check_for_speculative(vfs_request, buff);
+                ret = 0;
+                if (buff->hits == 1)
+                {
+                    ret = check_for_speculative(vfs_request, buff);
+                }
 #endif
 
                 buff = NULL; /* just being safe */
@@ -2888,6 +3491,17 @@ static PVFS_error post_iox_request(vfs_request_t *vfs_request)
         goto out;
     }
 
+    /* compat */
+    refn.handle = pvfs2_khandle_to_ino(
+                    &(vfs_request->in_upcall.req.iox.refn.khandle));
+    refn.fs_id = vfs_request->in_upcall.req.iox.refn.fs_id;
+
+    ret = write_behind_flush(refn, 1);
+    if (ret < 0)
+    {
+        goto out;
+    }
+
     /* get a shared kernel/userspace buffer for the I/O transfer */
     vfs_request->io_kernel_mapped_buf = 
           PINT_dev_get_mapped_buffer(BM_IO,
@@ -3115,6 +3729,29 @@ static PVFS_error service_mmap_ra_flush_request(vfs_request_t *vfs_request)
 }
 #endif
 
+/* service_write_behind_flush_request()
+ *
+ * the kernel sends a cache flush when a file is closed if write-behind
+ * is among the reported features; buffered data is written out and a
+ * deferred write error returned
+ */
+static PVFS_error service_write_behind_flush_request(
+    vfs_request_t *vfs_request)
+{
+    PVFS_object_ref refn;
+
+    /* compat */
+    refn.handle = pvfs2_khandle_to_ino(
+                    &(vfs_request->in_upcall.req.ra_cache_flush.refn.khandle));
+    refn.fs_id = vfs_request->in_upcall.req.ra_cache_flush.refn.fs_id;
+
+    vfs_request->out_downcall.type = PVFS2_VFS_OP_RA_FLUSH;
+    vfs_request->out_downcall.status = write_behind_flush(refn, 1);
+    vfs_request->op_id = -1;
+
+    return 0;
+}
+
 static PVFS_error service_operation_cancellation(
     vfs_request_t *vfs_request)
 {
@@ -3163,6 +3800,17 @@ static PVFS_error post_fsync_request(vfs_request_t *vfs_request)
                     &(vfs_request->in_upcall.req.fsync.refn.khandle));
     refn.fs_id = vfs_request->in_upcall.req.fsync.refn.fs_id;
 
+    ret = write_behind_flush(refn, 1);
+    if (ret < 0)
+    {
+        if (credential)
+        {
+            PINT_cleanup_credential(credential);
+            free(credential);
+        }
+        return ret;
+    }
+
     ret = PVFS_isys_flush(refn,
                           credential,
                           &vfs_request->op_id,
@@ -3840,7 +4488,7 @@ static inline void package_downcall_members(vfs_request_t *vfs_request,
                       &(vfs_request->out_downcall.resp.fs_mount.root_khandle));
 
                 vfs_request->out_downcall.resp.fs_mount.id =
-                                                 dynamic_mount_id++;
+                                                 vfs_request->mount_id;
             }
 
             PVFS_util_free_mntent(vfs_request->mntent);
@@ -3896,8 +4544,10 @@ static inline void package_downcall_members(vfs_request_t *vfs_request,
                                       "Posted Readahead Completed"
                                       " %d bytes into buffer %d\n",
                                       (int)buff->data_sz, (int)buff->buff_id);
-                        check_for_speculative(vfs_request, buff);    
                     }
+                    /* a speculative buffer with waiters means the
+                     * reader has caught up with the readahead */
+                    check_for_speculative(vfs_request, buff);
 
                     PVFS_Request_free(&vfs_request->mem_req);
                     PVFS_Request_free(&vfs_request->file_req);
@@ -3985,7 +4635,7 @@ static inline void package_downcall_members(vfs_request_t *vfs_request,
                                   "--- Completing cache hit vfs_request %p\n",
                                   vfs_request);
                     }
-                    else /* plain old IO */
+                    else if (vfs_request->mem_req) /* plain old IO */
                     {
                         iotype = (vfs_request->in_upcall.req.io.io_type ==
                                          PVFS_IO_READ) ? ior : iow;
@@ -4000,10 +4650,14 @@ static inline void package_downcall_members(vfs_request_t *vfs_request,
                             (size_t)vfs_request->response.io.total_completed;
                 }
 #else
-                /* RA_CACHE disabled so do this */
-                PVFS_Request_free(&vfs_request->mem_req);
-                PVFS_Request_free(&vfs_request->file_req);
-                PVFS_hint_free(&vfs_request->hints);
+                /* RA_CACHE disabled so do this; writes absorbed by
+                 * write-behind have no requests to free */
+                if (vfs_request->mem_req)
+                {
+                    PVFS_Request_free(&vfs_request->mem_req);
+                    PVFS_Request_free(&vfs_request->file_req);
+                    PVFS_hint_free(&vfs_request->hints);
+                }
 
                 vfs_request->out_downcall.resp.io.amt_complete =
                         (size_t)vfs_request->response.io.total_completed;
@@ -4200,6 +4854,7 @@ static inline PVFS_error repost_unexp_vfs_request(
     vfs_request_t *vfs_request, char *completion_handle_desc)
 {
     PVFS_error ret = -PVFS_EINVAL;
+    int owner;
 
     assert(vfs_request);
     
@@ -4226,9 +4881,11 @@ static inline PVFS_error repost_unexp_vfs_request(
     PINT_sys_release(vfs_request->op_id);
     PVFS_hint_free(&vfs_request->hints);
     /* wipe the vfs_request here before we resubmit */
+    owner = vfs_request->owner;
     memset(vfs_request, 0, sizeof(vfs_request_t));
 
     vfs_request->is_dev_unexp = 1;
+    vfs_request->owner = owner;
 
     ret = PINT_sys_dev_unexp(&vfs_request->info, &vfs_request->jstat,
                              &vfs_request->op_id, vfs_request);
@@ -4431,15 +5088,16 @@ static inline PVFS_error handle_unexp_vfs_request(vfs_request_t *vfs_request)
         case PVFS2_VFS_OP_FILE_IOX:
             ret = post_iox_request(vfs_request);
             break;
-#ifdef USE_RA_CACHE
             /*
-              if the mmap-readahead-cache is enabled, cache
-              flushes are handled inline
+              cache flushes (readahead and write-behind) are handled
+              inline
             */
         case PVFS2_VFS_OP_RA_FLUSH:
+#ifdef USE_RA_CACHE
             ret = service_mmap_ra_flush_request(vfs_request);
-            break;
 #endif
+            ret = service_write_behind_flush_request(vfs_request);
+            break;
         case PVFS2_VFS_OP_CANCEL:
             ret = service_operation_cancellation(vfs_request);
             break;
@@ -4456,6 +5114,11 @@ static inline PVFS_error handle_unexp_vfs_request(vfs_request_t *vfs_request)
 #else
             vfs_request->out_downcall.resp.features.features = 0;
 #endif
+            if (s_opts.write_behind_size > 0)
+            {
+                vfs_request->out_downcall.resp.features.features |=
+                    PVFS2_FEATURE_WRITE_BEHIND;
+            }
             vfs_request->out_downcall.status = 0;
             vfs_request->out_downcall.type = vfs_request->in_upcall.type;
             vfs_request->op_id = -1;
@@ -4579,14 +5242,18 @@ static PVFS_error write_downcall(vfs_request_t *vfs_request)
     return ret;
 }
 
-static PVFS_error process_vfs_requests(void)
+/* process_vfs_completion()
+ *
+ * handles one completed operation of a vfs_request: either a new upcall
+ * read from the device, which is decoded and posted, or a finished
+ * sysint operation, whose downcall is written before the request goes
+ * back to waiting on the device.
+ */
+static void process_vfs_completion(vfs_request_t *vfs_request,
+                                   PVFS_sys_op_id op_id,
+                                   int error_code)
 {
-    PVFS_error ret = 0; 
-    int op_count = 0, i = 0;
-    vfs_request_t *vfs_request = NULL;
-    vfs_request_t *vfs_request_array[MAX_NUM_OPS] = {NULL};
-    PVFS_sys_op_id op_id_array[MAX_NUM_OPS];
-    int error_code_array[MAX_NUM_OPS] = {0};
+    PVFS_error ret = 0;
 #ifdef USE_RA_CACHE
     struct qlist_head *link = NULL;
     gen_link_t *glink = NULL;
@@ -4594,13 +5261,547 @@ static PVFS_error process_vfs_requests(void)
     vfs_request_t *vl = NULL;
 #endif
 
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                 "*** New vfs_request = %p\n", vfs_request);
+
+    assert(vfs_request);
+/*             assert(vfs_request->op_id == op_id); */
+    if (vfs_request->num_ops == 1 &&
+            vfs_request->op_id != op_id)
+    {
+        gossip_err("op_id %Ld != completed op id %Ld\n",
+                lld(vfs_request->op_id), lld(op_id));
+#ifdef USE_RA_CACHE
+        if (vfs_request->is_readahead_speculative)
+        {
+            gossip_err("SPEC request returned too early 1\n");
+        }
+#endif
+        return;
+    }
+    else if (vfs_request->num_ops > 1)
+    {
+        int j;
+        /* assert that completed op is one that we posted earlier */
+        for (j = 0; j < vfs_request->num_ops; j++)
+        {
+            if (op_id == vfs_request->op_ids[j])
+            {
+                break; /* for j loop */
+            }
+        }
+        if (j == vfs_request->num_ops)
+        {
+            gossip_err("completed op id (%Ld) is weird\n",
+                      lld(op_id));
+#ifdef USE_RA_CACHE
+            if (vfs_request->is_readahead_speculative)
+            {
+                gossip_err("SPEC request returned too early 2\n");
+            }
+#endif
+            return;
+        }
+    }
+
+    /* check if this is a new dev unexp request */
+    if (vfs_request->is_dev_unexp)
+    {
+        /*
+         * NOTE: possible optimization -- if we detect that
+         * we're about to handle an inlined/blocking operation,
+         * make sure all non-inline ops are posted beforehand
+         * so that the sysint test() calls from the blocking
+         * operation handling can be making progress on the
+         * other ops in progress
+        */
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PINT_sys_testsome"
+                     " returned unexp vfs_request %p, tag: %llu\n",
+                     vfs_request,
+                     llu(vfs_request->info.tag));
+        ret = handle_unexp_vfs_request(vfs_request);
+        if (ret != 0)
+        {
+            /* assert(ret == 0); */
+            gossip_err("error returned from handle_enexp_vfs_request "
+                       "probably unknown request code = %d\n", ret);
+            vfs_request->jstat.error_code = ret;
+        }
+
+        /* We've handled this unexpected request (posted the
+         * client isys call), we can move
+         * on to the next request in the queue.
+         */
+#ifdef USE_RA_CACHE
+        if (vfs_request->is_readahead_speculative)
+        {
+            gossip_err("SPEC request returned too early 3\n");
+        }
+#endif
+        return;
+    }
+
+    /* We've just completed an (expected) operation on this request,
+     * now we must figure out its completion state and act accordingly.
+     */
+    vfs_request->num_incomplete_ops--;
+
+    /* if operation is not complete, we gotta continue */
+    if (vfs_request->num_incomplete_ops != 0)
+    {
+#ifdef USE_RA_CACHE
+        if (vfs_request->is_readahead_speculative)
+        {
+            gossip_err("SPEC request returned to early 4\n");
+        }
+#endif
+        return;
+    }
+    log_operation_timing(vfs_request);
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PINT_sys_testsome"
+                 " returned completed vfs_request %p\n",
+                 vfs_request);
+    /*
+     * if this is not a dev unexp msg, it's a non-blocking
+     * sysint operation that has just completed
+     */
+    assert(vfs_request->in_upcall.type);
+
+    /*
+     * even if the op was cancelled, if we get here, we
+     * will have to remove the op from the in progress
+     * table.  the error code on cancelled operations is
+     * already set appropriately
+     */
+#ifdef USE_RA_CACHE
+    /*
+     * first deal with waiters, if any
+     * note that even if primary req is spec, waiters
+     * may or may not be.
+     */
+    if (vfs_request->in_upcall.type == PVFS2_VFS_OP_FILE_IO &&
+        vfs_request->racache_status == RACACHE_POSTED &&
+        vfs_request->racache_buff != NULL)
+    {
+        gossip_debug(GOSSIP_RACACHE_DEBUG,
+                     "Process Waiting Racache Requests \n");
+        qlist_for_each_entry(glink,
+                             &vfs_request->racache_buff->vfs_link,
+                             link)
+        {
+            vl = glink->payload;
+            gossip_debug(GOSSIP_RACACHE_DEBUG, "Loop 1 vl = %p\n", vl);
+            /* get a shared kernel/userspace buffer for the I/O
+             * transfer
+             */
+            if (!vl->is_readahead_speculative)
+            {
+                gossip_debug(GOSSIP_RACACHE_DEBUG,
+                     "--- Remove waiting req from in_progress\n");
+                ret = remove_op_from_ops_in_progress_table(vl);
+                if (ret < 0)
+                {
+                    gossip_err(
+                        "remove in_progress failed "
+                        "(tag=%lld)\n", lld(vl->info.tag));
+                    ret = repost_unexp_vfs_request(vfs_request,
+                                               "error completion 1");
+                    assert(ret == 0);
+                }
+            }
+        }
+    }
+    /* now deal with primary request */
+    else
+#endif
+    {
+        ret = remove_op_from_ops_in_progress_table(vfs_request);
+        if (ret)
+        {
+            PVFS_perror_gossip("Failed to remove op in progress "
+                               "from table", ret);
+
+            /* repost the unexpected request since we're done
+             * with this one.
+             */
+            ret = repost_unexp_vfs_request(vfs_request,
+                                           "error completion 2");
+
+            assert(ret == 0);
+#ifdef USE_RA_CACHE
+            if (vfs_request->is_readahead_speculative)
+            {
+                gossip_err("SPEC request returned to early 5\n");
+            }
+#endif
+            return;
+        }
+    }
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                 "Calling package_downcall_members\n");
+    package_downcall_members(vfs_request, &error_code);
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                 "package_downcall_members Returns\n");
+
+    /*
+     * write the downcall if the operation was NOT a
+     * cancelled I/O operation.  while it's safe to write
+     * cancelled I/O operations to the kernel, it's a waste
+     * of time since it will be discarded.  just repost the
+     * op instead
+     */
+    if (!vfs_request->was_cancelled_io)
+    {
+#ifdef USE_RA_CACHE
+        /* if there are waiters process them first */
+        if (vfs_request->racache_status == RACACHE_POSTED)
+        {
+            /* by definition all requests on this list are
+             * waiting for the same buffer, referenced from
+             * the vfs_request.
+             * disassemble the waiter list as we go.
+             */
+            gossip_debug(GOSSIP_RACACHE_DEBUG,
+                         "Downcalls on waiter req list\n");
+            buff = vfs_request->racache_buff;
+            while((link = qlist_pop(&buff->vfs_link)))
+            {
+                /* remove waiting req from list */
+                glink = qlist_entry(link, gen_link_t, link);
+                assert(glink);
+                vl = (vfs_request_t *)glink->payload;
+                gossip_debug(GOSSIP_RACACHE_DEBUG, "Loop 2 vl = %p\n", vl);
+                free(glink);
+                buff->vfs_cnt--; /* this should decrement to 0 */
+    
+                /* the first vl is equal for vfs_request
+                 * if it is speculative don't free here
+                 * because we need it below - we will have
+                 * to free it later
+                 */
+                if (vl->is_readahead_speculative &&
+                    vl != vfs_request)
+                {
+                    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                                 "--- Free speculative vl\n");
+                    /* clean up */
+                    PVFS_hint_free(&vl->hints);
+                    vl->racache_buff = NULL;
+                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Free vl = %p\n", vl);
+                    free(vl);
+                }
+                else if (!vl->is_readahead_speculative)
+                {
+                    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                                "--- Racache downcall write %p \n", vl);
+                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Copy vreq = %p\n", vfs_request);
+                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Copy vl = %p\n", vl);
+                    /* first vl equals vfs_request so don't need
+                     * to copy these
+                     */
+                    if (vl != vfs_request)
+                    {
+                        vl->out_downcall.status =
+                                        vfs_request->out_downcall.status;
+                        vl->out_downcall.type =
+                                        vfs_request->out_downcall.type;
+                    }
+
+                    ret = write_downcall(vl);
+                    if (ret < 0)
+                    {
+                        gossip_err(
+                            "--- write_downcall failed "
+                            "(tag=%lld)\n", lld(vl->info.tag));
+                    }
+
+                    /* clean up */
+                    vl->racache_buff = NULL;
+                    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                                "--- Repost unexp %p\n", vl);
+                    ret = repost_unexp_vfs_request(vl,
+                                               "waiting_completion");
+                    if (ret < 0)
+                    {
+                        gossip_err(
+                            "--- repost_unexp_vfs_request failed "
+                            "(tag=%lld)\n", lld(vl->info.tag));
+                    }
+                }
+            } /* while link */
+            gossip_debug(GOSSIP_RACACHE_DEBUG,
+                         "--- List Processing Complete\n");
+            /* If the main request was speculative we will
+             * free it here because we are done with it now
+             */
+            if (vfs_request->is_readahead_speculative)
+            {
+                    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                                 "--- Free speculative vfs_request\n");
+                    /* clean up */
+                    PVFS_hint_free(&vfs_request->hints);
+                    vfs_request->racache_buff = NULL;
+                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Free vfs_request = %p\n", vl);
+                    free(vfs_request);
+                /* done with this vfs_request */
+                return;
+            }
+#if 0
+            /* spec requests are not part of the main pool
+             * they are malloced so we need to free them
+             * here and not repost them
+             */
+            if (vfs_request->is_readahead_speculative)
+            {
+                gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                             "--- Free speculative vfs_request\n");
+                free(vfs_request);
+            }
+#endif
+            /* see if this buffer is a remainder from a resize
+             * and if so deal with it directly
+             */
+            if (buff->resizing)
+            {
+                gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                             "--- Finish resizing a buffer\n");
+                /* this wipes the buffer so don't try to use it
+                 * after this
+                 */
+                pint_racache_finish_resize(buff);
+                return;
+            }
+            /* if buffer being freed then add to free list 
+             * and remove from lru and buffer lists
+             */
+            if (buff->being_freed)
+            {
+                gossip_debug(GOSSIP_RACACHE_DEBUG,
+                             "--- Buffer %d made free\n",
+                             buff->buff_id);
+                pint_racache_make_free(buff);
+                vfs_request->racache_buff = NULL;
+            }
+            /* whether an racache op is spec or not we called
+             * downcall and repost on it above as the primary
+             * is also considered a waiter.
+             */
+            gossip_debug(GOSSIP_RACACHE_DEBUG,
+                         "--- Racache transaction %p complete\n",
+                         vfs_request);
+            return;
+        }
+#endif
+        /* this handles non-readahead non-cancelled requests 
+         * and racache hits which act like regular requests
+         */
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                     "normal downcall write\n");
+        ret = write_downcall(vfs_request);
+        ret = repost_unexp_vfs_request(vfs_request,
+                                       "normal_completion");
+        assert(ret == 0);
+    }
+    else
+    {
+        /* this handles cancelled requests 
+         * we cannot cancel a speculative request because
+         * the kernel and user don't know it exists - we just
+         * let them run and free resources later if they are
+         * nolonger needed.
+         */
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "skipping "
+                     "downcall write due to previous "
+                     "cancellation\n");
+        /* normal request just repost */
+        ret = repost_unexp_vfs_request(vfs_request, "cancellation");
+        assert(ret == 0);
+    }
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Done with Request %p\n",
+                 vfs_request);
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "***\n");
+}
+
+/* dispatch_vfs_completion()
+ *
+ * queues a completed operation for the worker that owns its vfs_request
+ */
+static void dispatch_vfs_completion(vfs_request_t *vfs_request,
+                                    PVFS_sys_op_id op_id,
+                                    int error_code)
+{
+    vfs_worker_t *worker = &s_workers[vfs_request->owner];
+    vfs_completion_t *new_queue = NULL;
+    int i = 0, tail = 0;
+
+    pthread_mutex_lock(&worker->mutex);
+    if (worker->queue_count == worker->queue_size)
+    {
+        /* grow the ring, unwrapping it into the new buffer */
+        new_queue = malloc(2 * worker->queue_size * sizeof(vfs_completion_t));
+        assert(new_queue);
+        for(i = 0; i < worker->queue_count; i++)
+        {
+            new_queue[i] = worker->queue[
+                (worker->queue_head + i) % worker->queue_size];
+        }
+        free(worker->queue);
+        worker->queue = new_queue;
+        worker->queue_head = 0;
+        worker->queue_size *= 2;
+    }
+    tail = (worker->queue_head + worker->queue_count) % worker->queue_size;
+    worker->queue[tail].vfs_request = vfs_request;
+    worker->queue[tail].op_id = op_id;
+    worker->queue[tail].error_code = error_code;
+    worker->queue_count++;
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+static void *vfs_worker_thread(void *ptr)
+{
+    vfs_worker_t *worker = (vfs_worker_t *)ptr;
+    vfs_completion_t completion;
+
+    pthread_mutex_lock(&worker->mutex);
+    while(1)
+    {
+        while(worker->queue_count == 0 && !s_workers_stop)
+        {
+            pthread_cond_wait(&worker->cond, &worker->mutex);
+        }
+        if (worker->queue_count == 0)
+        {
+            break;
+        }
+        completion = worker->queue[worker->queue_head];
+        worker->queue_head = (worker->queue_head + 1) % worker->queue_size;
+        worker->queue_count--;
+        pthread_mutex_unlock(&worker->mutex);
+
+        process_vfs_completion(completion.vfs_request,
+                               completion.op_id,
+                               completion.error_code);
+
+        pthread_mutex_lock(&worker->mutex);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+    return NULL;
+}
+
+static int start_vfs_workers(int num_threads)
+{
+    int i = 0;
+
+    s_workers = calloc(num_threads, sizeof(vfs_worker_t));
+    if (!s_workers)
+    {
+        return -PVFS_ENOMEM;
+    }
+    for(i = 0; i < num_threads; i++)
+    {
+        pthread_mutex_init(&s_workers[i].mutex, NULL);
+        pthread_cond_init(&s_workers[i].cond, NULL);
+        s_workers[i].queue_size = 64;
+        s_workers[i].queue = malloc(s_workers[i].queue_size *
+                                    sizeof(vfs_completion_t));
+        if (!s_workers[i].queue ||
+            pthread_create(&s_workers[i].thread, NULL,
+                           vfs_worker_thread, &s_workers[i]))
+        {
+            gossip_err("Cannot create request processing thread %d\n", i);
+            free(s_workers[i].queue);
+            s_workers[i].queue = NULL;
+            break;
+        }
+    }
+    if (i < num_threads)
+    {
+        /* run with the threads we managed to start */
+        gossip_err("Continuing with %d request processing threads\n", i);
+        if (i == 0)
+        {
+            free(s_workers);
+            s_workers = NULL;
+        }
+        return i;
+    }
+    return num_threads;
+}
+
+/* stop_vfs_workers()
+ *
+ * lets each worker drain its queue, then joins it
+ */
+static void stop_vfs_workers(int num_threads)
+{
+    int i = 0;
+
+    if (!s_workers)
+    {
+        return;
+    }
+    for(i = 0; i < num_threads; i++)
+    {
+        pthread_mutex_lock(&s_workers[i].mutex);
+        s_workers_stop = 1;
+        pthread_cond_signal(&s_workers[i].cond);
+        pthread_mutex_unlock(&s_workers[i].mutex);
+    }
+    for(i = 0; i < num_threads; i++)
+    {
+        pthread_join(s_workers[i].thread, NULL);
+        pthread_mutex_destroy(&s_workers[i].mutex);
+        pthread_cond_destroy(&s_workers[i].cond);
+        free(s_workers[i].queue);
+    }
+    free(s_workers);
+    s_workers = NULL;
+}
+
+static PVFS_error process_vfs_requests(void)
+{
+    PVFS_error ret = 0; 
+    int op_count = 0, i = 0;
+    int max_ops = s_opts.max_ops;
+    int num_threads = s_opts.num_threads;
+    vfs_request_t *vfs_request = NULL;
+    vfs_request_t **vfs_request_array = NULL;
+    PVFS_sys_op_id *op_id_array = NULL;
+    int *error_code_array = NULL;
 
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
                  "process_vfs_requests called\n");
 
+    vfs_request_array = calloc(max_ops, sizeof(vfs_request_t *));
+    op_id_array = calloc(max_ops, sizeof(PVFS_sys_op_id));
+    error_code_array = calloc(max_ops, sizeof(int));
+    s_vfs_request_array = calloc(max_ops, sizeof(vfs_request_t *));
+    if (!vfs_request_array || !op_id_array || !error_code_array ||
+        !s_vfs_request_array)
+    {
+        ret = -PVFS_ENOMEM;
+        goto out;
+    }
+
+    if (num_threads > 1)
+    {
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                     "Start %d Request Processing Threads\n", num_threads);
+        num_threads = start_vfs_workers(num_threads);
+        if (num_threads < 0)
+        {
+            ret = num_threads;
+            goto out;
+        }
+    }
+
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Post Initial Unexp Requests\n");
     /* allocate and post all of our initial unexpected vfs requests */
-    for(i = 0; i < MAX_NUM_OPS; i++)
+    for(i = 0; i < max_ops; i++)
     {
         vfs_request = (vfs_request_t *)malloc(sizeof(vfs_request_t));
         assert(vfs_request);
@@ -4609,6 +5810,7 @@ static PVFS_error process_vfs_requests(void)
 
         memset(vfs_request, 0, sizeof(vfs_request_t));
         vfs_request->is_dev_unexp = 1;
+        vfs_request->owner = (s_workers ? i % num_threads : 0);
 
         ret = PINT_sys_dev_unexp(&vfs_request->info,
                                  &vfs_request->jstat,
@@ -4618,7 +5820,8 @@ static PVFS_error process_vfs_requests(void)
         if (ret < 0)
         {
 	    PVFS_perror_gossip("PINT_sys_dev_unexp()", ret);
-            return -PVFS_ENOMEM;
+            ret = -PVFS_ENOMEM;
+            goto out;
         }
     }
 
@@ -4631,9 +5834,9 @@ static PVFS_error process_vfs_requests(void)
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Start Processing Loop\n");
     while(s_client_is_processing)
     {
-        op_count = MAX_NUM_OPS;
-        memset(error_code_array, 0, (MAX_NUM_OPS * sizeof(int)));
-        memset(vfs_request_array, 0, (MAX_NUM_OPS * sizeof(vfs_request_t *)));
+        op_count = max_ops;
+        memset(error_code_array, 0, (max_ops * sizeof(int)));
+        memset(vfs_request_array, 0, (max_ops * sizeof(vfs_request_t *)));
 
 #if 0
         /* generates too much logging, but useful sometimes */
@@ -4648,373 +5851,25 @@ static PVFS_error process_vfs_requests(void)
                                error_code_array,
                                PVFS2_CLIENT_DEFAULT_TEST_TIMEOUT_MS);
 
-        /* gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Process Request Array\n"); */
         for(i = 0; i < op_count; i++)
         {
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                         "Process Request Array(%d)\n",i);
-            vfs_request = vfs_request_array[i];
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                         "*** New vfs_request = %p\n", vfs_request);
-
-            assert(vfs_request);
-/*             assert(vfs_request->op_id == op_id_array[i]); */
-            if (vfs_request->num_ops == 1 &&
-                    vfs_request->op_id != op_id_array[i])
-            {
-                gossip_err("op_id %Ld != completed op id %Ld\n",
-                        lld(vfs_request->op_id), lld(op_id_array[i]));
-#ifdef USE_RA_CACHE
-                if (vfs_request->is_readahead_speculative)
-                {
-                    gossip_err("SPEC request returned too early 1\n");
-                }
-#endif
-                continue; /* for i loop */
-            }
-            else if (vfs_request->num_ops > 1)
-            {
-                int j;
-                /* assert that completed op is one that we posted earlier */
-                for (j = 0; j < vfs_request->num_ops; j++)
-                {
-                    if (op_id_array[i] == vfs_request->op_ids[j])
-                    {
-                        break; /* for j loop */
-                    }
-                }
-                if (j == vfs_request->num_ops)
-                {
-                    gossip_err("completed op id (%Ld) is weird\n",
-                              lld(op_id_array[i]));
-#ifdef USE_RA_CACHE
-                    if (vfs_request->is_readahead_speculative)
-                    {
-                        gossip_err("SPEC request returned too early 2\n");
-                    }
-#endif
-                    continue; /* for i loop */
-                }
-            }
-
-            /* check if this is a new dev unexp request */
-            if (vfs_request->is_dev_unexp)
-            {
-                /*
-                 * NOTE: possible optimization -- if we detect that
-                 * we're about to handle an inlined/blocking operation,
-                 * make sure all non-inline ops are posted beforehand
-                 * so that the sysint test() calls from the blocking
-                 * operation handling can be making progress on the
-                 * other ops in progress
-                */
-                gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PINT_sys_testsome"
-                             " returned unexp vfs_request %p, tag: %llu\n",
-                             vfs_request,
-                             llu(vfs_request->info.tag));
-                ret = handle_unexp_vfs_request(vfs_request);
-                if (ret != 0)
-                {
-                    /* assert(ret == 0); */
-                    gossip_err("error returned from handle_enexp_vfs_request "
-                               "probably unknown request code = %d\n", ret);
-                    vfs_request->jstat.error_code = ret;
-                }
-
-                /* We've handled this unexpected request (posted the
-                 * client isys call), we can move
-                 * on to the next request in the queue.
-                 */
-#ifdef USE_RA_CACHE
-                if (vfs_request->is_readahead_speculative)
-                {
-                    gossip_err("SPEC request returned too early 3\n");
-                }
-#endif
-                continue; /* for i loop */
-            }
-
-            /* We've just completed an (expected) operation on this request,
-             * now we must figure out its completion state and act accordingly.
-             */
-            vfs_request->num_incomplete_ops--;
-
-            /* if operation is not complete, we gotta continue */
-            if (vfs_request->num_incomplete_ops != 0)
+            assert(vfs_request_array[i]);
+            if (s_workers)
             {
-#ifdef USE_RA_CACHE
-                if (vfs_request->is_readahead_speculative)
-                {
-                    gossip_err("SPEC request returned to early 4\n");
-                }
-#endif
-                continue; /* for i loop */
+                dispatch_vfs_completion(vfs_request_array[i],
+                                        op_id_array[i],
+                                        error_code_array[i]);
             }
-            log_operation_timing(vfs_request);
-
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PINT_sys_testsome"
-                         " returned completed vfs_request %p\n",
-                         vfs_request);
-            /*
-             * if this is not a dev unexp msg, it's a non-blocking
-             * sysint operation that has just completed
-             */
-            assert(vfs_request->in_upcall.type);
-
-            /*
-             * even if the op was cancelled, if we get here, we
-             * will have to remove the op from the in progress
-             * table.  the error code on cancelled operations is
-             * already set appropriately
-             */
-#ifdef USE_RA_CACHE
-            /*
-             * first deal with waiters, if any
-             * note that even if primary req is spec, waiters
-             * may or may not be.
-             */
-            if (vfs_request->in_upcall.type == PVFS2_VFS_OP_FILE_IO &&
-                vfs_request->racache_status == RACACHE_POSTED &&
-                vfs_request->racache_buff != NULL)
-            {
-                gossip_debug(GOSSIP_RACACHE_DEBUG,
-                             "Process Waiting Racache Requests \n");
-                qlist_for_each_entry(glink,
-                                     &vfs_request->racache_buff->vfs_link,
-                                     link)
-                {
-                    vl = glink->payload;
-                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Loop 1 vl = %p\n", vl);
-                    /* get a shared kernel/userspace buffer for the I/O
-                     * transfer
-                     */
-                    if (!vl->is_readahead_speculative)
-                    {
-                        gossip_debug(GOSSIP_RACACHE_DEBUG,
-                             "--- Remove waiting req from in_progress\n");
-                        ret = remove_op_from_ops_in_progress_table(vl);
-                        if (ret < 0)
-                        {
-                            gossip_err(
-                                "remove in_progress failed "
-                                "(tag=%lld)\n", lld(vl->info.tag));
-                            ret = repost_unexp_vfs_request(vfs_request,
-                                                       "error completion 1");
-                            assert(ret == 0);
-                        }
-                    }
-                }
-            }
-            /* now deal with primary request */
             else
-#endif
             {
-                ret = remove_op_from_ops_in_progress_table(vfs_request);
-                if (ret)
-                {
-                    PVFS_perror_gossip("Failed to remove op in progress "
-                                       "from table", ret);
-
-                    /* repost the unexpected request since we're done
-                     * with this one.
-                     */
-                    ret = repost_unexp_vfs_request(vfs_request,
-                                                   "error completion 2");
-
-                    assert(ret == 0);
-#ifdef USE_RA_CACHE
-                    if (vfs_request->is_readahead_speculative)
-                    {
-                        gossip_err("SPEC request returned to early 5\n");
-                    }
-#endif
-                    continue; /* for i loop */
-                }
+                process_vfs_completion(vfs_request_array[i],
+                                       op_id_array[i],
+                                       error_code_array[i]);
             }
+        }
 
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                         "Calling package_downcall_members\n");
-            package_downcall_members(vfs_request, &error_code_array[i]);
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                         "package_downcall_members Returns\n");
-
-            /*
-             * write the downcall if the operation was NOT a
-             * cancelled I/O operation.  while it's safe to write
-             * cancelled I/O operations to the kernel, it's a waste
-             * of time since it will be discarded.  just repost the
-             * op instead
-             */
-            if (!vfs_request->was_cancelled_io)
-            {
-#ifdef USE_RA_CACHE
-                /* if there are waiters process them first */
-                if (vfs_request->racache_status == RACACHE_POSTED)
-                {
-                    /* by definition all requests on this list are
-                     * waiting for the same buffer, referenced from
-                     * the vfs_request.
-                     * disassemble the waiter list as we go.
-                     */
-                    gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                 "Downcalls on waiter req list\n");
-                    buff = vfs_request->racache_buff;
-                    while((link = qlist_pop(&buff->vfs_link)))
-                    {
-                        /* remove waiting req from list */
-                        glink = qlist_entry(link, gen_link_t, link);
-                        assert(glink);
-                        vl = (vfs_request_t *)glink->payload;
-                        gossip_debug(GOSSIP_RACACHE_DEBUG, "Loop 2 vl = %p\n", vl);
-                        free(glink);
-                        buff->vfs_cnt--; /* this should decrement to 0 */
-    
-                        /* the first vl is equal for vfs_request
-                         * if it is speculative don't free here
-                         * because we need it below - we will have
-                         * to free it later
-                         */
-                        if (vl->is_readahead_speculative &&
-                            vl != vfs_request)
-                        {
-                            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                                         "--- Free speculative vl\n");
-                            /* clean up */
-                            PVFS_hint_free(&vl->hints);
-                            vl->racache_buff = NULL;
-                            gossip_debug(GOSSIP_RACACHE_DEBUG, "Free vl = %p\n", vl);
-                            free(vl);
-                        }
-                        else if (!vl->is_readahead_speculative)
-                        {
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                        "--- Racache downcall write %p \n", vl);
-                            gossip_debug(GOSSIP_RACACHE_DEBUG, "Copy vreq = %p\n", vfs_request);
-                            gossip_debug(GOSSIP_RACACHE_DEBUG, "Copy vl = %p\n", vl);
-                            /* first vl equals vfs_request so don't need
-                             * to copy these
-                             */
-                            if (vl != vfs_request)
-                            {
-                                vl->out_downcall.status =
-                                                vfs_request->out_downcall.status;
-                                vl->out_downcall.type =
-                                                vfs_request->out_downcall.type;
-                            }
-
-                            ret = write_downcall(vl);
-                            if (ret < 0)
-                            {
-                                gossip_err(
-                                    "--- write_downcall failed "
-                                    "(tag=%lld)\n", lld(vl->info.tag));
-                            }
-
-                            /* clean up */
-                            vl->racache_buff = NULL;
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                        "--- Repost unexp %p\n", vl);
-                            ret = repost_unexp_vfs_request(vl,
-                                                       "waiting_completion");
-                            if (ret < 0)
-                            {
-                                gossip_err(
-                                    "--- repost_unexp_vfs_request failed "
-                                    "(tag=%lld)\n", lld(vl->info.tag));
-                            }
-                        }
-                    } /* while link */
-                    gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                 "--- List Processing Complete\n");
-                    /* If the main request was speculative we will
-                     * free it here because we are done with it now
-                     */
-                    if (vfs_request->is_readahead_speculative)
-                    {
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                         "--- Free speculative vfs_request\n");
-                            /* clean up */
-                            PVFS_hint_free(&vfs_request->hints);
-                            vfs_request->racache_buff = NULL;
-                            gossip_debug(GOSSIP_RACACHE_DEBUG, "Free vfs_request = %p\n", vl);
-                            free(vfs_request);
-                        /* done with this vfs_request */
-                        continue; /* for i loop */
-                    }
-#if 0
-                    /* spec requests are not part of the main pool
-                     * they are malloced so we need to free them
-                     * here and not repost them
-                     */
-                    if (vfs_request->is_readahead_speculative)
-                    {
-                        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                                     "--- Free speculative vfs_request\n");
-                        free(vfs_request);
-                    }
-#endif
-                    /* see if this buffer is a remainder from a resize
-                     * and if so deal with it directly
-                     */
-                    if (buff->resizing)
-                    {
-                        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                                     "--- Finish resizing a buffer\n");
-                        /* this wipes the buffer so don't try to use it
-                         * after this
-                         */
-                        pint_racache_finish_resize(buff);
-                        continue; /* for i loop */
-                    }
-                    /* if buffer being freed then add to free list 
-                     * and remove from lru and buffer lists
-                     */
-                    if (buff->being_freed)
-                    {
-                        gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                     "--- Buffer %d made free\n",
-                                     buff->buff_id);
-                        pint_racache_make_free(buff);
-                        vfs_request->racache_buff = NULL;
-                    }
-                    /* whether an racache op is spec or not we called
-                     * downcall and repost on it above as the primary
-                     * is also considered a waiter.
-                     */
-                    gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                 "--- Racache transaction %p complete\n",
-                                 vfs_request);
-                    continue; /* for i loop */
-                }
-#endif
-                /* this handles non-readahead non-cancelled requests 
-                 * and racache hits which act like regular requests
-                 */
-                gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                             "normal downcall write\n");
-                ret = write_downcall(vfs_request);
-                ret = repost_unexp_vfs_request(vfs_request,
-                                               "normal_completion");
-                assert(ret == 0);
-            }
-            else
-            {
-                /* this handles cancelled requests 
-                 * we cannot cancel a speculative request because
-                 * the kernel and user don't know it exists - we just
-                 * let them run and free resources later if they are
-                 * nolonger needed.
-                 */
-                gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "skipping "
-                             "downcall write due to previous "
-                             "cancellation\n");
-                /* normal request just repost */
-                ret = repost_unexp_vfs_request(vfs_request, "cancellation");
-                assert(ret == 0);
-            }
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Done with Request(%d)\n",i);
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "***\n");
-        } /* for i loop */
+        /* write out write-behind data that has waited long enough */
+        write_behind_flush_all(PVFS_FS_ID_NULL, s_opts.write_behind_timeout);
 
         /* The status of the remount thread needs to be checked in the event 
          * the remount fails on client-core startup. If this is the initial 
@@ -5036,12 +5891,20 @@ static PVFS_error process_vfs_requests(void)
             gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
                          "%s: remount not completed successfully, no longer "
                          "handling requests.\n", __func__);
-            return -PVFS_EAGAIN; 
+            ret = -PVFS_EAGAIN;
+            goto out;
         }
     }
     gossip_err("Client Core Caught Signal %d - Halt Processing\n",
                s_client_signal);
-    return 0;
+    ret = 0;
+
+out:
+    stop_vfs_workers(num_threads);
+    free(vfs_request_array);
+    free(op_id_array);
+    free(error_code_array);
+    return ret;
 }
 
 int main(int argc, char **argv)
@@ -5290,6 +6153,12 @@ int main(int argc, char **argv)
     ret = client_perf_start_rollover(PINT_acache_get_pc(), NULL);
     ret = client_perf_start_rollover(PINT_ncache_get_pc(), NULL);
     ret = client_perf_start_rollover(PINT_client_capcache_get_pc(), NULL);
+#ifdef USE_RA_CACHE
+    if (pint_racache_get_pc())
+    {
+        ret = client_perf_start_rollover(pint_racache_get_pc(), NULL);
+    }
+#endif
 
     /* set up structure for kernel interaction */
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Init Ops In Progress Table\n");
@@ -5302,7 +6171,14 @@ int main(int argc, char **argv)
     }   
 
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Initialize Device\n");
-    ret = PINT_dev_initialize("/dev/pvfs2-req", 0);
+    if (s_opts.dev_emulator)
+    {
+        ret = PINT_dev_initialize(s_opts.dev_emulator, PINT_DEV_EMULATED);
+    }
+    else
+    {
+        ret = PINT_dev_initialize("/dev/pvfs2-req", 0);
+    }
     if (ret < 0)
     {
         PVFS_perror_gossip("PINT_dev_initialize", ret);
@@ -5321,6 +6197,19 @@ int main(int argc, char **argv)
         return ret;
     }
 
+    if (s_opts.write_behind_size > 0)
+    {
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Initialize Write-Behind\n");
+        s_write_behind_table = qhash_init(write_behind_compare,
+                                          write_behind_hash,
+                                          WRITE_BEHIND_HTABLE_SIZE);
+        if (!s_write_behind_table)
+        {
+            gossip_err("Cannot allocate write-behind table\n");
+            return -PVFS_ENOMEM;
+        }
+    }
+
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Open Job Context\n");
     ret = job_open_context(&s_client_dev_context);
     if (ret < 0)
@@ -5354,6 +6243,8 @@ int main(int argc, char **argv)
     /********************* End Processing **************************/
 
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Shutting Down\n");
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Finalize Write-Behind\n");
+    write_behind_finalize();
     /* join remount thread; should be long done by now */
     if (remount_complete == REMOUNT_COMPLETED )
     {
@@ -5369,12 +6260,18 @@ int main(int argc, char **argv)
 
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Freeing Allocated Resources\n");
     /* free all allocated resources */
-    for(i = 0; i < MAX_NUM_OPS; i++)
+    for(i = 0; s_vfs_request_array && i < s_opts.max_ops; i++)
     {
+        if (!s_vfs_request_array[i])
+        {
+            break;
+        }
         PINT_dev_release_unexpected(&s_vfs_request_array[i]->info);
         PINT_sys_release(s_vfs_request_array[i]->op_id);
         free(s_vfs_request_array[i]);
     }
+    free(s_vfs_request_array);
+    s_vfs_request_array = NULL;
 
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Close Job Context\n");
     job_close_context(s_client_dev_context);
@@ -5469,7 +6366,7 @@ static void print_help(char *progname)
 #ifdef USE_RA_CACHE
     printf("--readahead-size=VALUE        size of readahead buffers\n");
     printf("--readahead-count=VALUE       number of readahead buffers\n");
-    printf("--readahead-readcnt=VALUE     number of buffers to read ahead\n");
+    printf("--readahead-readcnt=VALUE     largest readahead window in buffers\n");
     printf("--readahead-pinned=VALUE      use pinned buffers T(1) or F(0)\n");
 #endif
     printf("--logfile=VALUE               override the default log file\n");
@@ -5480,6 +6377,16 @@ static void print_help(char *progname)
     printf("--desc-count=VALUE            overrides the default # of kernel buffer descriptors\n");
     printf("--desc-size=VALUE             overrides the default size of each kernel buffer descriptor\n");
     printf("--events=EVENT_LIST           specify the events to enable\n");
+    printf("--threads=VALUE               number of request processing threads "
+           "(default is 1)\n");
+    printf("--max-ops=VALUE               max # of operations in flight "
+           "(default is %d)\n", DEFAULT_MAX_NUM_OPS);
+    printf("--dev-emulator=SOCKET         talk to a device emulator on SOCKET "
+           "instead of the kernel module\n");
+    printf("--write-behind=BYTES          per-file write-behind buffer size "
+           "(default is 0, disabled)\n");
+    printf("--write-behind-timeout=MSECS  age at which buffered writes are "
+           "written out (default is %d)\n", DEFAULT_WRITE_BEHIND_TIMEOUT_MS);
 }
 
 static void parse_args(int argc, char **argv, options_t *opts)
@@ -5523,12 +6430,20 @@ static void parse_args(int argc, char **argv, options_t *opts)
         {"events",1,0,0},
         {"keypath",1,0,0},
         {"bmi-opts",1,0,0},
+        {"threads",1,0,0},
+        {"max-ops",1,0,0},
+        {"dev-emulator",1,0,0},
+        {"write-behind",1,0,0},
+        {"write-behind-timeout",1,0,0},
         {0,0,0,0}
     };
 
     assert(opts);
     opts->perf_time_interval_secs = PERF_DEFAULT_UPDATE_INTERVAL / 1000;
     opts->perf_history_size = PERF_DEFAULT_HISTORY_SIZE;
+    opts->num_threads = 1;
+    opts->max_ops = DEFAULT_MAX_NUM_OPS;
+    opts->write_behind_timeout = DEFAULT_WRITE_BEHIND_TIMEOUT_MS;
 
     while((ret = getopt_long(argc, argv, "ha:n:c:L:b:",
                              long_opts, &option_index)) != -1)
@@ -5829,6 +6744,50 @@ static void parse_args(int argc, char **argv, options_t *opts)
                 {
                     opts->bmi_opts = optarg;
                 }
+                else if (strcmp("threads", cur_option) == 0)
+                {
+                    ret = sscanf(optarg, "%u", &opts->num_threads);
+                    if(ret != 1 || opts->num_threads < 1)
+                    {
+                        gossip_err(
+                            "Error: invalid thread count value.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                else if (strcmp("max-ops", cur_option) == 0)
+                {
+                    ret = sscanf(optarg, "%u", &opts->max_ops);
+                    if(ret != 1 || opts->max_ops < 1)
+                    {
+                        gossip_err(
+                            "Error: invalid max-ops value.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                else if (strcmp("dev-emulator", cur_option) == 0)
+                {
+                    opts->dev_emulator = optarg;
+                }
+                else if (strcmp("write-behind", cur_option) == 0)
+                {
+                    ret = sscanf(optarg, "%u", &opts->write_behind_size);
+                    if(ret != 1 || opts->write_behind_size > (1U << 30))
+                    {
+                        gossip_err(
+                            "Error: invalid write-behind size value.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                else if (strcmp("write-behind-timeout", cur_option) == 0)
+                {
+                    ret = sscanf(optarg, "%u", &opts->write_behind_timeout);
+                    if(ret != 1)
+                    {
+                        gossip_err(
+                            "Error: invalid write-behind timeout value.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                }
                 break;
             case 'h':
           do_help:
@@ -5890,6 +6849,17 @@ static void parse_args(int argc, char **argv, options_t *opts)
                 exit(1);
         }
     }
+#ifdef USE_RA_CACHE
+    /* readahead waiter lists span requests, so they must all be
+     * handled by one thread
+     */
+    if (opts->num_threads > 1)
+    {
+        gossip_err("Warning: readahead cache requires --threads=1; "
+                   "ignoring --threads=%u\n", opts->num_threads);
+        opts->num_threads = 1;
+    }
+#endif
     if (!opts->logfile)
     {
         opts->logfile = DEFAULT_LOGFILE;
@@ -6454,8 +7424,10 @@ static PVFS_credential *generate_credential(PVFS_uid uid, PVFS_gid gid)
         return NULL;
     }
 
+    gen_mutex_lock(&credential_cache_mutex);
     ret = PINT_tcache_get_info(credential_cache, TCACHE_TIMEOUT_MSECS,
                                &timeout);
+    gen_mutex_unlock(&credential_cache_mutex);
 
     timeout = (ret != 0 || timeout == 0) ? PVFS2_DEFAULT_CREDENTIAL_TIMEOUT :
                                            timeout/1000;
@@ -6491,6 +7463,7 @@ static PVFS_credential *lookup_credential(PVFS_uid uid, PVFS_gid gid)
     ckey.uid = uid;
     ckey.gid = gid;
 
+    gen_mutex_lock(&credential_cache_mutex);
     gossip_debug(GOSSIP_SECURITY_DEBUG, "credential cache lookup for (%u, %u)"
                  " num_entries: %d\n", uid, gid, credential_cache->num_entries);
     /* see if a fresh credential is in the cache */
@@ -6502,7 +7475,9 @@ static PVFS_credential *lookup_credential(PVFS_uid uid, PVFS_gid gid)
         gossip_debug(GOSSIP_SECURITY_DEBUG,
                      "credential cache HIT for (%u, %u)\n", uid, gid);
         cpayload = (struct credential_payload*) entry->payload;
-        return (PVFS_credential*) PINT_dup_credential(cpayload->credential);
+        credential = PINT_dup_credential(cpayload->credential);
+        gen_mutex_unlock(&credential_cache_mutex);
+        return credential;
     }
     else if (ret == 0 && status == -PVFS_ETIME)
     {
@@ -6512,6 +7487,7 @@ static PVFS_credential *lookup_credential(PVFS_uid uid, PVFS_gid gid)
                      uid, gid);
         PINT_tcache_delete(credential_cache, entry);
     }
+    gen_mutex_unlock(&credential_cache_mutex);
 
     /* request a new credential and store it in the cache */
     gossip_debug(GOSSIP_SECURITY_DEBUG,
@@ -6547,11 +7523,13 @@ static PVFS_credential *lookup_credential(PVFS_uid uid, PVFS_gid gid)
     tval.tv_sec = credential->timeout - CRED_TIMEOUT_BUFFER;
     tval.tv_usec = 0;
 
+    gen_mutex_lock(&credential_cache_mutex);
     ret = PINT_tcache_insert_entry_ex(credential_cache,
                                       &ckey,
                                       cpayload,
                                       &tval,
                                       &status);
+    gen_mutex_unlock(&credential_cache_mutex);
 
     if (ret == 0)
     {
@@ -6584,6 +7562,7 @@ void remove_credential(PVFS_uid uid,
     ckey.gid = gid;
 
     /* lookup credential */
+    gen_mutex_lock(&credential_cache_mutex);
     ret = PINT_tcache_lookup(credential_cache, &ckey, &entry, &status);
 
     if (ret == 0)
@@ -6597,6 +7576,7 @@ void remove_credential(PVFS_uid uid,
         gossip_debug(GOSSIP_SECURITY_DEBUG, "... cache lookup returned %d\n", 
                      ret);
     }
+    gen_mutex_unlock(&credential_cache_mutex);
 
 }
 
@@ -77,6 +77,10 @@ typedef struct
     char *readahead_readcnt;
     char *readahead_pinned;
     char *bmi_opts;
+    char *num_threads;
+    char *max_ops;
+    char *write_behind;
+    char *write_behind_timeout;
 } options_t;
 
 static void client_sig_handler(int signum);
@@ -529,6 +533,30 @@ static int monitor_pvfs2_client(options_t *opts)
                 arg_list[arg_index+1] = opts->bmi_opts;
                 arg_index+=2;
             }
+            if (opts->num_threads)
+            {
+                arg_list[arg_index] = "--threads";
+                arg_list[arg_index+1] = opts->num_threads;
+                arg_index+=2;
+            }
+            if (opts->max_ops)
+            {
+                arg_list[arg_index] = "--max-ops";
+                arg_list[arg_index+1] = opts->max_ops;
+                arg_index+=2;
+            }
+            if (opts->write_behind)
+            {
+                arg_list[arg_index] = "--write-behind";
+                arg_list[arg_index+1] = opts->write_behind;
+                arg_index+=2;
+            }
+            if (opts->write_behind_timeout)
+            {
+                arg_list[arg_index] = "--write-behind-timeout";
+                arg_list[arg_index+1] = opts->write_behind_timeout;
+                arg_index+=2;
+            }
 
             if(opts->verbose)
             {
@@ -600,6 +628,10 @@ static void print_help(char *progname)
     printf("--events=EVENTS               enable tracing of certain EVENTS\n");
     printf("--keypath=PATH                path to credential key file\n");
     printf("--bmi-opts=\"OPTIONS\"          comma-seperated options string to pass to bmi\n");
+    printf("--threads=VALUE               number of request processing threads in pvfs2-client-core\n");
+    printf("--max-ops=VALUE               max # of operations pvfs2-client-core keeps in flight\n");
+    printf("--write-behind=BYTES          per-file write-behind buffer size in pvfs2-client-core (0 disables)\n");
+    printf("--write-behind-timeout=MSECS  age at which pvfs2-client-core writes out buffered writes\n");
 }
 
 static void parse_args(int argc, char **argv, options_t *opts)
@@ -646,6 +678,10 @@ static void parse_args(int argc, char **argv, options_t *opts)
         {"events",1,0,0},
         {"keypath",1,0,0},
         {"bmi-opts",1,0,0},
+        {"threads",1,0,0},
+        {"max-ops",1,0,0},
+        {"write-behind",1,0,0},
+        {"write-behind-timeout",1,0,0},
         {0,0,0,0}
     };
 
@@ -805,6 +841,22 @@ static void parse_args(int argc, char **argv, options_t *opts)
                 {
                     opts->bmi_opts = optarg;
                 }
+                else if (strcmp("threads", cur_option) == 0)
+                {
+                    opts->num_threads = optarg;
+                }
+                else if (strcmp("max-ops", cur_option) == 0)
+                {
+                    opts->max_ops = optarg;
+                }
+                else if (strcmp("write-behind", cur_option) == 0)
+                {
+                    opts->write_behind = optarg;
+                }
+                else if (strcmp("write-behind-timeout", cur_option) == 0)
+                {
+                    opts->write_behind_timeout = optarg;
+                }
 
                 break;
             case 'h':
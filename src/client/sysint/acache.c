@@ -510,10 +510,14 @@ int PINT_acache_update(
     }
 
     tmp_payload->refn = refn;
-    /* copy attrs into payload, excluding capability and size_array */
+    /* copy attrs into payload, excluding capability, size_array, inline
+     * file data and the size cached on the metafile (which are only valid
+     * for the op that fetched them)
+     */
     save_mask = attr->mask;
     /* Don't cache size_array (indicated by PVFS_ATTR_DIR_DIRENT_COUNT). */
-    attr->mask &= ~(PVFS_ATTR_CAPABILITY | PVFS_ATTR_DIR_DIRENT_COUNT);
+    attr->mask &= ~(PVFS_ATTR_CAPABILITY | PVFS_ATTR_DIR_DIRENT_COUNT |
+                    PVFS_ATTR_META_INLINE_DATA | PVFS_ATTR_META_SIZE);
     ret = PINT_copy_object_attr(&tmp_payload->attr, attr);
     attr->mask = save_mask;
     if(ret != 0)
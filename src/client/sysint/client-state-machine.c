@@ -34,19 +34,27 @@
 job_context_id pint_client_sm_context = -1;
 
 extern int pint_client_pid;
+extern int pint_client_req_trace;
 
 extern PINT_event_id PINT_client_sys_event_id;
 
 /*
  * used for locally storing completed operations from test() call so
  * that we can retrieve them in testsome() while still making progress
- * (and possible completing operations in the test() call
+ * (and possible completing operations in the test() call.  The list
+ * grows as needed so callers may keep any number of operations in
+ * flight.
  */
 static int s_completion_list_index = 0;
-static PINT_smcb *s_completion_list[MAX_RETURNED_JOBS] = {NULL};
+static int s_completion_list_size = 0;
+static PINT_smcb **s_completion_list = NULL;
 static gen_mutex_t s_completion_list_mutex = GEN_MUTEX_INITIALIZER;
 static gen_mutex_t test_mutex = GEN_MUTEX_INITIALIZER;
 
+/* next request id handed out when request tracing is enabled */
+static uint32_t s_next_request_id = 1;
+static gen_mutex_t s_request_id_mutex = GEN_MUTEX_INITIALIZER;
+
 static void PINT_sys_release_smcb(PINT_smcb *smcb);
 
 #define CLIENT_SM_ASSERT_INITIALIZED()  \
@@ -69,8 +77,24 @@ job_context_id PINT_client_get_sm_context(void)
 
 static PVFS_error add_sm_to_completion_list(PINT_smcb *smcb)
 {
+    PINT_smcb **new_list;
+    int new_size;
+
     gen_mutex_lock(&s_completion_list_mutex);
-    assert(s_completion_list_index < MAX_RETURNED_JOBS);
+    if (s_completion_list_index == s_completion_list_size)
+    {
+        new_size = s_completion_list_size ?
+            2 * s_completion_list_size : MAX_RETURNED_JOBS;
+        new_list = realloc(s_completion_list,
+                           new_size * sizeof(PINT_smcb *));
+        if (!new_list)
+        {
+            gen_mutex_unlock(&s_completion_list_mutex);
+            return -PVFS_ENOMEM;
+        }
+        s_completion_list = new_list;
+        s_completion_list_size = new_size;
+    }
     if (!smcb->op_completed)
     {
         smcb->op_completed = 1;
@@ -117,85 +141,80 @@ static int conditional_remove_sm_if_in_completion_list(PINT_smcb *smcb)
 }
 
 /** Moves completed jobs to the provided io_id_array from global
- *  completion array - only checks first limit slots in comp array
- *  scoots any beyond limit down for future calls
+ *  completion array - returns at most limit of them and keeps the rest
+ *  in order for future calls.
+ *
+ *  When user pointers are requested, operations posted without one are
+ *  left on the list: those belong to blocking calls (PVFS_sys_wait())
+ *  that another thread is waiting on, and that thread releases them.
  */
 static PVFS_error completion_list_retrieve_any_completed(
    PVFS_sys_op_id *op_id_array, /* out */
    void **user_ptr_array,       /* out if present */
    int *error_code_array,       /* out */
    int limit,                   /* in  */
-   int *out_count)              /* what exactly is this supposed to return */
+   int *out_count)              /* out, number of entries filled in */
 {
-   int i = 0, new_list_index = 0;
+   int i = 0, out = 0, new_list_index = 0;
    PINT_smcb *smcb = NULL;
-   PINT_smcb *tmp_completion_list[MAX_RETURNED_JOBS] = {NULL};
    PINT_client_sm *sm_p;
+   void *user_ptr;
  
    assert(op_id_array);
    assert(error_code_array);
    assert(out_count);
  
-   memset(tmp_completion_list, 0,
-          (MAX_RETURNED_JOBS * sizeof(PINT_smcb *)));
- 
    gen_mutex_lock(&s_completion_list_mutex);
    for(i = 0; i < s_completion_list_index; i++)
    {
-       if (s_completion_list[i] == NULL)
-       {
-           continue;
-       }
- 
        smcb = s_completion_list[i];
        assert(smcb);
  
-       if (i < limit)
+       sm_p = PINT_sm_frame(smcb, PINT_FRAME_CURRENT);
+
+       /* if this smcb has been set cancelled and is a PVFS_SYS_IO
+        * state machine then use the user_ptr of the base frame
+        * instead of the standard sm_p user_ptr. This prevents
+        * segfaults back in process_vfs_requests which expects the
+        * pointer to be a vfs_request.
+        */
+       if( smcb->op_cancelled && smcb->op == PVFS_SYS_IO )
        {
-           sm_p = PINT_sm_frame(smcb, PINT_FRAME_CURRENT);
-           op_id_array[i] = sm_p->sys_op_id;
-           error_code_array[i] = sm_p->error_code;
- 
+           PINT_client_sm *sm_base_p = PINT_sm_frame(smcb,
+                                        (-(smcb->frame_count -1)));
+           assert(sm_base_p);
+           gossip_debug(GOSSIP_CANCEL_DEBUG, "%s: assignment of "
+                        "PVFS_SYS_IO user_ptr from sm_base_p(%p), "
+                        "user_ptr(%p)\n", __func__, sm_base_p,
+                        sm_base_p->user_ptr);
+           user_ptr = sm_base_p->user_ptr;
+       }
+       else
+       {
+           user_ptr = (void *)sm_p->user_ptr;
+       }
+
+       if ((out < limit) && !(user_ptr_array && !user_ptr))
+       {
+           op_id_array[out] = sm_p->sys_op_id;
+           error_code_array[out] = sm_p->error_code;
            if (user_ptr_array)
            {
-               /* if this smcb has been set cancelled and is a PVFS_SYS_IO
-                 * state machine then stick the user_ptr of the base frame
-                 * in to the user_ptr_array instead of the standard sm_p 
-                 * user_ptr. This prevents segfaults back in 
-                 * process_vfs_requests which expects the pointer to be a 
-                 * vfs_request.
-                 */
-               if( smcb->op_cancelled && smcb->op == PVFS_SYS_IO )
-               {
-                   PINT_client_sm *sm_base_p = PINT_sm_frame(smcb,
-                                                (-(smcb->frame_count -1)));
-                   assert(sm_base_p);
-                   gossip_debug(GOSSIP_CANCEL_DEBUG, "%s: assignment of "
-                                "PVFS_SYS_IO user_ptr from sm_base_p(%p), "
-                                "user_ptr(%p)\n", __func__, sm_base_p,
-                                sm_base_p->user_ptr);
-                   user_ptr_array[i] = sm_base_p->user_ptr;
-               }
-               else
-               {
-                   user_ptr_array[i] = (void *)sm_p->user_ptr;
-               }
+               user_ptr_array[out] = user_ptr;
            }
-           s_completion_list[i] = NULL;
+           out++;
  
            PINT_sys_release(sm_p->sys_op_id);
        }
        else
        {
-           tmp_completion_list[new_list_index++] = smcb;
+           s_completion_list[new_list_index++] = smcb;
        }
    }
-   *out_count = PVFS_util_min(i, limit);
+   *out_count = out;
  
    /* clean up and adjust the list and it's book keeping */
    s_completion_list_index = new_list_index;
-   memcpy(s_completion_list, tmp_completion_list,
-          (MAX_RETURNED_JOBS * sizeof(struct PINT_smcb *)));
    
    gen_mutex_unlock(&s_completion_list_mutex);
    return 0;
@@ -217,7 +236,6 @@ static PVFS_error completion_list_retrieve_some_completed(
     int out_op_count = 0;
     int found;
     PINT_smcb *smcb = NULL;
-    PINT_smcb *tmp_completion_list[MAX_RETURNED_JOBS] = {NULL};
     PINT_client_sm *sm_p;
     PVFS_sys_op_id out_ops[MAX_RETURNED_JOBS] = {0};
 
@@ -225,9 +243,6 @@ static PVFS_error completion_list_retrieve_some_completed(
     assert(error_code_array);
     assert(out_count);
 
-    memset(tmp_completion_list, 0,
-           (MAX_RETURNED_JOBS * sizeof(PINT_smcb *)));
-
     gen_mutex_lock(&s_completion_list_mutex);
     for(i = 0; i < s_completion_list_index; i++)
     {
@@ -282,22 +297,19 @@ static PVFS_error completion_list_retrieve_some_completed(
                     user_ptr_array[out_op_count] = (void *)sm_p->user_ptr;
                 }
             }
-            s_completion_list[i] = NULL;
             out_op_count++;
 
             PINT_sys_release(sm_p->sys_op_id);
         }
         else
         {
-            tmp_completion_list[new_list_index++] = smcb;
+            s_completion_list[new_list_index++] = smcb;
         }
     }
     *out_count = out_op_count;
 
     /* clean up and adjust the list and it's book keeping */
     s_completion_list_index = new_list_index;
-    memcpy(s_completion_list, tmp_completion_list,
-           (MAX_RETURNED_JOBS * sizeof(struct PINT_smcb *)));
     gossip_debug(GOSSIP_CLIENT_DEBUG, "%s has %d items left on completed list\n", __func__, new_list_index);    
     /* return only the op_ids that were found in the input list */
     memcpy(op_id_array, out_ops, (out_op_count * sizeof(PVFS_sys_op_id)));
@@ -364,7 +376,8 @@ struct PINT_client_op_entry_s PINT_client_sm_sys_table[] =
     {&pvfs2_client_statfs_sm},
     {&pvfs2_fs_add_sm},
     {&pvfs2_client_readdirplus_sm},
-    {&pvfs2_client_atomic_eattr_sm}
+    {&pvfs2_client_atomic_eattr_sm},
+    {&pvfs2_client_remove_subtree_sm}
 };
 
 struct PINT_client_op_entry_s PINT_client_sm_mgmt_table[] =
@@ -528,6 +541,29 @@ PVFS_error PINT_client_state_machine_post(
                            sizeof(pvfs_sys_op),
                            &pvfs_sys_op);
 
+    /* keep any ids the caller supplied through hints */
+    if (pint_client_req_trace)
+    {
+        uint32_t tmp_id;
+
+        if (!PINT_hint_get_value_by_type(sm_p->hints,
+                                         PINT_HINT_REQUEST_ID, NULL))
+        {
+            gen_mutex_lock(&s_request_id_mutex);
+            tmp_id = s_next_request_id++;
+            gen_mutex_unlock(&s_request_id_mutex);
+            PVFS_hint_add_internal(&sm_p->hints, PINT_HINT_REQUEST_ID,
+                                   sizeof(tmp_id), &tmp_id);
+        }
+        if (!PINT_hint_get_value_by_type(sm_p->hints,
+                                         PINT_HINT_CLIENT_ID, NULL))
+        {
+            tmp_id = pint_client_pid;
+            PVFS_hint_add_internal(&sm_p->hints, PINT_HINT_CLIENT_ID,
+                                   sizeof(tmp_id), &tmp_id);
+        }
+    }
+
     PINT_EVENT_START(PINT_client_sys_event_id,
                      pint_client_pid,
                      NULL,
@@ -639,11 +675,26 @@ PVFS_error PINT_client_state_machine_release(PINT_smcb * smcb)
     return 0;
 }
 
+static PVFS_error client_io_cancel(PVFS_sys_op_id id);
+
 /** Cancels in progress I/O operations.
+ *
+ * Holds test_mutex so the operation cannot be advanced by another
+ * thread's test calls while its jobs are being cancelled.
  *
  * \return 0 on success, -PVFS_error on failure.
  */
 PVFS_error PINT_client_io_cancel(PVFS_sys_op_id id)
+{
+    PVFS_error ret;
+
+    gen_mutex_lock(&test_mutex);
+    ret = client_io_cancel(id);
+    gen_mutex_unlock(&test_mutex);
+    return ret;
+}
+
+static PVFS_error client_io_cancel(PVFS_sys_op_id id)
 {
     int i = 0;
     PVFS_error ret = -PVFS_EINVAL;
@@ -879,6 +930,10 @@ PVFS_error PINT_client_state_machine_test(
  *  NOTE: checks if ANY state machine is completed and does not
  *  look at what if anything is passed in via op_id_array. To check
  *  on specific op_ids, use testsome().
+ *
+ *  The wait for job completions happens without test_mutex held, so
+ *  other threads can post new operations while this one is idle; the
+ *  state machines are still only advanced under the lock.
  */
 PVFS_error PINT_client_state_machine_testany(
    PVFS_sys_op_id *op_id_array,  /* out */
@@ -905,7 +960,7 @@ PVFS_error PINT_client_state_machine_testany(
        return ret;
    }
  
-   if ((*op_count < 1) || (*op_count > MAX_RETURNED_JOBS))
+   if (*op_count < 1)
    {
        PVFS_perror_gossip("testany() got invalid op_count", ret);
        gen_mutex_unlock(&test_mutex);
@@ -929,6 +984,7 @@ PVFS_error PINT_client_state_machine_testany(
        gen_mutex_unlock(&test_mutex);
        return ret;
    }
+   gen_mutex_unlock(&test_mutex);
  
    /* see if there are requests ready to make progress */
    ret = job_testcontext(job_id_array,
@@ -942,6 +998,8 @@ PVFS_error PINT_client_state_machine_testany(
                        * should at least test for
                        * ETIMEDOUT
                        */
+
+   gen_mutex_lock(&test_mutex);
  
    /* do as much as we can on every job that has completed */
    for(i = 0; i < job_count; i++)
@@ -1235,6 +1293,7 @@ const char *PINT_client_get_name_str(int op_type)
         { PVFS_SYS_GETEATTR, "PVFS_SYS_GETEATTR" },
         { PVFS_SYS_SETEATTR, "PVFS_SYS_SETEATTR" },
         { PVFS_SYS_ATOMICEATTR, "PVFS_SYS_ATOMICEATTR" },
+        { PVFS_SYS_REMOVE_SUBTREE, "PVFS_SYS_REMOVE_SUBTREE" },
         { PVFS_SYS_DELEATTR, "PVFS_SYS_DELEATTR" },
         { PVFS_SYS_LISTEATTR, "PVFS_SYS_LISTEATTR" },
         { PVFS_SERVER_GET_CONFIG, "PVFS_SERVER_GET_CONFIG" },
@@ -352,6 +352,9 @@ struct PINT_client_io_sm
 
     PVFS_size * dfile_size_array;
     int small_io;
+
+    int size_suspect;            /* a write attempt failed */
+    PVFS_error size_saved_error; /* held across the size invalidation */
 };
 
 struct PINT_client_flush_sm
@@ -361,6 +364,12 @@ struct PINT_client_flush_sm
 #endif
 };
 
+struct PINT_client_remove_subtree_sm
+{
+    uint32_t budget;                        /* input parameter */
+    PVFS_sysresp_remove_subtree *resp;      /* in/out parameter */
+};
+
 struct PINT_client_readdir_sm
 {
     PVFS_ds_position pos_token;         /* in/out parameter */
@@ -437,6 +446,7 @@ struct PINT_client_lookup_sm
     int skipped_final_resolution;
     int current_context;
     int context_count;
+    int retry_count;                  /* retries after -PVFS_EAGAIN */
     PINT_client_lookup_sm_ctx * contexts;
 };
 
@@ -530,6 +540,8 @@ struct PINT_client_mgmt_get_dirdata_array_sm
 struct PINT_client_truncate_sm
 {
     PVFS_size size; /* new logical size of object*/
+    PVFS_size *dfile_size_array; /* new size of each datafile */
+    uint32_t size_version; /* of the size cached on the metafile */
 };
 
 struct PINT_server_get_config_sm
@@ -702,6 +714,7 @@ typedef struct PINT_client_sm
         struct PINT_client_setattr_sm setattr;
         struct PINT_client_io_sm io;
         struct PINT_client_flush_sm flush;
+        struct PINT_client_remove_subtree_sm remove_subtree;
         struct PINT_client_readdirplus_sm readdirplus;
         struct PINT_client_lookup_sm lookup;
         struct PINT_client_rename_sm rename;
@@ -814,6 +827,7 @@ enum
     PVFS_SYS_FS_ADD                = 19,
     PVFS_SYS_READDIRPLUS           = 20,
     PVFS_SYS_ATOMICEATTR           = 21,
+    PVFS_SYS_REMOVE_SUBTREE        = 22,
     PVFS_MGMT_SETPARAM_LIST        = 70,
     PVFS_MGMT_NOOP                 = 71,
     PVFS_MGMT_STATFS_LIST          = 72,
@@ -834,7 +848,7 @@ enum
     PVFS_DEV_UNEXPECTED            = 400
 };
 
-#define PVFS_OP_SYS_MAXVALID  22
+#define PVFS_OP_SYS_MAXVALID  23
 #define PVFS_OP_SYS_MAXVAL 69
 #define PVFS_OP_MGMT_MAXVALID 84
 #define PVFS_OP_MGMT_MAXVAL 199
@@ -911,6 +925,7 @@ extern struct PINT_state_machine_s pvfs2_client_setattr_sm;
 extern struct PINT_state_machine_s pvfs2_client_io_sm;
 extern struct PINT_state_machine_s pvfs2_client_small_io_sm;
 extern struct PINT_state_machine_s pvfs2_client_flush_sm;
+extern struct PINT_state_machine_s pvfs2_client_remove_subtree_sm;
 extern struct PINT_state_machine_s pvfs2_client_sysint_readdir_sm;
 extern struct PINT_state_machine_s pvfs2_client_readdir_sm;
 extern struct PINT_state_machine_s pvfs2_client_readdirplus_sm;
@@ -47,6 +47,7 @@ extern job_context_id pint_client_sm_context;
 PINT_event_id PINT_client_sys_event_id;
 
 int pint_client_pid;
+int pint_client_req_trace = 0;
 
 /* set to one when init is done */
 #ifdef WIN32
@@ -187,6 +188,14 @@ int PVFS_sys_initialize(uint64_t default_debug_mask)
         PINT_event_enable(event_mask);
     }
 
+    /* stamp every request with a client and request id so that it can
+     * be followed through the server request trace buffers
+     */
+    if (getenv("PVFS2_REQ_TRACE"))
+    {
+        pint_client_req_trace = 1;
+    }
+
     ret = id_gen_safe_initialize();
     if(ret < 0)
     {
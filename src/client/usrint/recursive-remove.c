@@ -11,10 +11,50 @@
 #include <pvfs2-types.h>
 #include <usrint.h>
 #include <posix-pvfs.h>
+#include <posix-ops.h>
+#include <openfile-util.h>
+#include <iocommon.h>
 #include <gossip.h>
 #include <recursive-remove.h>
 #include <str-utils.h>
 
+/* Have the servers empty the open PVFS directory "dirp", which saves a
+ * lookup, getattr and remove round trip per entry.  Returns 0 once the
+ * directory is empty, -1 if it is not a PVFS directory or the servers
+ * could not empty it, in which case the caller walks the tree itself.
+ */
+static int remove_subtree_on_servers(DIR *dirp)
+{
+    int ret = -1;
+    pvfs_descriptor *pd = NULL;
+    PVFS_credential *credential = NULL;
+    PVFS_sysresp_remove_subtree resp;
+
+    pd = pvfs_find_descriptor(dirfd(dirp));
+    if (!pd || !pd->s || pd->s->fsops != &pvfs_ops)
+    {
+        return -1;
+    }
+    if (iocommon_cred(&credential) != 0)
+    {
+        return -1;
+    }
+
+    do
+    {
+        ret = PVFS_sys_remove_subtree(pd->s->pvfs_ref, 0, credential,
+                                      &resp, NULL);
+        if (ret < 0)
+        {
+            RR_ERROR("PVFS_sys_remove_subtree failed: %d\n", ret);
+            return -1;
+        }
+        RR_PRINT("servers removed %u objects\n", resp.removed);
+    } while (!resp.complete && resp.removed > 0);
+
+    return resp.complete ? 0 : -1;
+}
+
 /* Recursively delete the absolute path "dir".
  * Returns 0 on success, -1 on failure.
  */
@@ -34,6 +74,11 @@ int recursive_delete_dir(char *dir)
         return -1;
     }
 
+    if (remove_subtree_on_servers(dirp) == 0)
+    {
+        goto remove_dir;
+    }
+
     /* Remove all files in the current directory */
     if (remove_files_in_dir(dir, dirp) != 0)
     {
@@ -102,6 +147,7 @@ int recursive_delete_dir(char *dir)
      * recursive_delete_dir failed on path: /mnt/orangefs/
      */ 
 
+remove_dir:
     /* Close current directory before we attempt removal */
     RR_PRINT("closing dir: %s\n", dir);
     if (closedir(dirp) != 0)
@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #ifdef WIN32
@@ -62,6 +63,83 @@ static int internal_syslog_priority = LOG_INFO;
 /* what type of timestamp to put on logs */
 static enum gossip_logstamp internal_logstamp = GOSSIP_LOGSTAMP_DEFAULT;
 
+#if defined(__GEN_POSIX_LOCKING__) && defined(__GNUC__)
+#define GOSSIP_HAVE_ASYNC
+#endif
+
+#ifdef GOSSIP_HAVE_ASYNC
+/* Asynchronous logging
+ *
+ * Each thread that logs gets its own single producer, single consumer
+ * byte ring.  A debug message is formatted into the ring by the calling
+ * thread along with a raw timeval; no locks are taken and nothing is
+ * written.  A background writer thread drains all of the rings every
+ * GOSSIP_ASYNC_FLUSH_MSECS (or sooner when a ring passes half full),
+ * renders the prefix and time stamp, merges the rings in time stamp
+ * order and issues a single fflush() per batch.  When a ring is full
+ * the message is dropped and counted rather than blocking the caller.
+ *
+ * Only the message body is formatted on the calling thread; %s
+ * arguments are not guaranteed to outlive the call so they cannot be
+ * deferred.  gossip_err() and syslog output remain synchronous.
+ */
+#define GOSSIP_ASYNC_FLUSH_MSECS 10
+#define GOSSIP_ASYNC_MIN_RING 4096
+
+struct gossip_async_hdr
+{
+    uint32_t len;               /* bytes of message text that follow */
+    int32_t usec;
+    int64_t sec;
+    long tid;
+    char prefix;
+};
+
+struct gossip_async_ring
+{
+    char *buf;
+    uint32_t size;              /* power of two */
+    uint64_t head;              /* advanced by the owning thread only */
+    uint64_t tail;              /* advanced by the writer only */
+    uint64_t drain_head;        /* writer's snapshot of head */
+    uint64_t dropped;           /* written by the owning thread only */
+    uint64_t dropped_reported;  /* written by the writer only */
+    int orphaned;               /* owning thread has exited */
+    struct gossip_async_ring *next;
+};
+
+static int gossip_async_on = 0;
+static int gossip_async_stop = 0;
+static int gossip_async_kicked = 0;
+static uint32_t gossip_async_ring_size = 0;
+/* protects the ring list, the consumer side of every ring and the
+ * log file pointer while async logging is active
+ */
+static gen_mutex_t gossip_async_mutex = GEN_MUTEX_INITIALIZER;
+static gen_cond_t gossip_async_cond = GEN_COND_INITIALIZER;
+static struct gossip_async_ring *gossip_async_rings = NULL;
+static pthread_t gossip_async_thread;
+static pthread_key_t gossip_async_key;
+static int gossip_async_key_created = 0;
+static __thread struct gossip_async_ring *gossip_my_ring = NULL;
+
+/* rate limiting: one fixed one second window per debug mask bit */
+struct gossip_rate_bucket
+{
+    int64_t window;
+    uint32_t count;
+    uint32_t suppressed;
+};
+static uint32_t gossip_rate_limit = 0;
+static struct gossip_rate_bucket gossip_rate_buckets[64];
+
+#define gossip_async_lock() gen_mutex_lock(&gossip_async_mutex)
+#define gossip_async_unlock() gen_mutex_unlock(&gossip_async_mutex)
+#else
+#define gossip_async_lock() do {} while (0)
+#define gossip_async_unlock() do {} while (0)
+#endif /* GOSSIP_HAVE_ASYNC */
+
 /*****************************************************************
  * prototypes
  */
@@ -70,6 +148,8 @@ static int gossip_disable_file(void);
 
 static int gossip_debug_fp_va(FILE *fp, char prefix, const char *format, va_list ap, enum
 gossip_logstamp ts);
+static int gossip_format_stamp(char *buf, char prefix,
+    enum gossip_logstamp ts, const struct timeval *tv, long tid);
 static int gossip_debug_syslog(
     char prefix,
     const char *format,
@@ -79,7 +159,14 @@ static int gossip_err_syslog(
     va_list ap);
 static int gossip_disable_syslog(
     void);
-
+#ifdef GOSSIP_HAVE_ASYNC
+static int gossip_rate_check(uint64_t mask, int64_t now);
+static int gossip_async_put(char prefix, const struct timeval *tv,
+    const char *format, va_list ap);
+static void gossip_async_drain(void);
+static void gossip_async_orphan(void *arg);
+static void *gossip_async_writer(void *arg);
+#endif
 
 /*****************************************************************
  * visible functions
@@ -164,16 +251,21 @@ int gossip_enable_file(
     int tmp_debug_on = gossip_debug_on;
     uint64_t tmp_debug_mask = gossip_debug_mask;
 
+    FILE *fp;
+
     /* turn off any running facility */
     gossip_disable();
 
-    internal_log_file = fopen(filename, mode);
-    if (!internal_log_file)
+    fp = fopen(filename, mode);
+    if (!fp)
     {
         return -errno;
     }
 
+    gossip_async_lock();
+    internal_log_file = fp;
     gossip_facility = GOSSIP_FILE;
+    gossip_async_unlock();
 
     /* restore the logging settings */
     gossip_debug_on = tmp_debug_on;
@@ -208,6 +300,9 @@ int gossip_disable(
 {
     int ret = -EINVAL;
 
+    /* write out anything still buffered for the old facility */
+    gossip_flush();
+
     switch (gossip_facility)
     {
     case GOSSIP_STDERR:
@@ -276,6 +371,142 @@ int gossip_set_logstamp(
     return(0);
 }
 
+#ifdef GOSSIP_HAVE_ASYNC
+/* gossip_enable_async()
+ *
+ * switches debug messages written to stderr or a log file over to
+ * per-thread rings of (at least) ring_size bytes drained by a
+ * background writer thread.  Must be called after any fork().
+ *
+ * returns 0 on success, -errno on failure
+ */
+int gossip_enable_async(int ring_size)
+{
+    uint32_t size = GOSSIP_ASYNC_MIN_RING;
+    int ret;
+
+    if (ring_size <= 0)
+    {
+        return -EINVAL;
+    }
+    while (size < (uint32_t)ring_size && size < (1U << 30))
+    {
+        size <<= 1;
+    }
+
+    gen_mutex_lock(&gossip_async_mutex);
+    if (gossip_async_on)
+    {
+        gen_mutex_unlock(&gossip_async_mutex);
+        return -EALREADY;
+    }
+    if (!gossip_async_key_created)
+    {
+        ret = pthread_key_create(&gossip_async_key, gossip_async_orphan);
+        if (ret != 0)
+        {
+            gen_mutex_unlock(&gossip_async_mutex);
+            return -ret;
+        }
+        gossip_async_key_created = 1;
+    }
+    gossip_async_ring_size = size;
+    gossip_async_stop = 0;
+    ret = pthread_create(&gossip_async_thread, NULL,
+                         gossip_async_writer, NULL);
+    if (ret != 0)
+    {
+        gen_mutex_unlock(&gossip_async_mutex);
+        return -ret;
+    }
+    gossip_async_on = 1;
+    gen_mutex_unlock(&gossip_async_mutex);
+
+    return 0;
+}
+
+/* gossip_disable_async()
+ *
+ * stops the background writer and returns to synchronous logging.
+ * Rings owned by live threads are kept for reuse.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int gossip_disable_async(void)
+{
+    gen_mutex_lock(&gossip_async_mutex);
+    if (!gossip_async_on)
+    {
+        gen_mutex_unlock(&gossip_async_mutex);
+        return 0;
+    }
+    gossip_async_on = 0;
+    gossip_async_stop = 1;
+    gen_cond_signal(&gossip_async_cond);
+    gen_mutex_unlock(&gossip_async_mutex);
+
+    pthread_join(gossip_async_thread, NULL);
+
+    gen_mutex_lock(&gossip_async_mutex);
+    gossip_async_drain();
+    gen_mutex_unlock(&gossip_async_mutex);
+
+    return 0;
+}
+
+/* gossip_flush()
+ *
+ * writes out all buffered debug messages before returning
+ *
+ * returns 0 on success, -errno on failure
+ */
+int gossip_flush(void)
+{
+    if (gossip_async_on)
+    {
+        gen_mutex_lock(&gossip_async_mutex);
+        gossip_async_drain();
+        gen_mutex_unlock(&gossip_async_mutex);
+    }
+    return 0;
+}
+
+/* gossip_set_rate_limit()
+ *
+ * limits each debug mask bit to msgs_per_sec messages per second;
+ * excess messages are counted and reported once the next second
+ * starts.  Zero removes the limit.  Errors are never rate limited.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int gossip_set_rate_limit(unsigned int msgs_per_sec)
+{
+    memset(gossip_rate_buckets, 0, sizeof(gossip_rate_buckets));
+    gossip_rate_limit = msgs_per_sec;
+    return 0;
+}
+#else
+int gossip_enable_async(int ring_size)
+{
+    return -ENOSYS;
+}
+
+int gossip_disable_async(void)
+{
+    return 0;
+}
+
+int gossip_flush(void)
+{
+    return 0;
+}
+
+int gossip_set_rate_limit(unsigned int msgs_per_sec)
+{
+    return (msgs_per_sec ? -ENOSYS : 0);
+}
+#endif /* GOSSIP_HAVE_ASYNC */
+
 #ifndef __GNUC__
 /* __gossip_debug_stub()
  * 
@@ -346,6 +577,24 @@ int __gossip_debug_va(
         prefix = 'D';
     }
 
+#ifdef GOSSIP_HAVE_ASYNC
+    if (gossip_rate_limit || gossip_async_on)
+    {
+        struct timeval tv;
+
+        gettimeofday(&tv, 0);
+        if (gossip_rate_limit && !gossip_rate_check(mask, tv.tv_sec))
+        {
+            return 0;
+        }
+        if (gossip_async_on && (gossip_facility == GOSSIP_STDERR ||
+                                gossip_facility == GOSSIP_FILE))
+        {
+            return gossip_async_put(prefix, &tv, format, ap);
+        }
+    }
+#endif
+
     switch (gossip_facility)
     {
     case GOSSIP_STDERR:
@@ -386,6 +635,31 @@ int gossip_err(
     /* rip out the variable arguments */
     va_start(ap, format);
 
+#ifdef GOSSIP_HAVE_ASYNC
+    /* errors are written synchronously, after any debug messages that
+     * preceded them.  trylock so that a crash report from inside the
+     * writer cannot deadlock.
+     */
+    if (gossip_async_on && gossip_facility != GOSSIP_SYSLOG &&
+        gen_mutex_trylock(&gossip_async_mutex) == 0)
+    {
+        gossip_async_drain();
+        if (gossip_facility == GOSSIP_STDERR)
+        {
+            ret = gossip_debug_fp_va(stderr, 'E', format, ap,
+                                     internal_logstamp);
+        }
+        else if (internal_log_file)
+        {
+            ret = gossip_debug_fp_va(internal_log_file, 'E', format, ap,
+                                     internal_logstamp);
+        }
+        gen_mutex_unlock(&gossip_async_mutex);
+        va_end(ap);
+        return ret;
+    }
+#endif
+
     switch (gossip_facility)
     {
     case GOSSIP_STDERR:
@@ -521,80 +795,413 @@ static int gossip_debug_fp_va(FILE *fp, char prefix,
     int bsize = sizeof(buffer), temp_size;
     int ret = -EINVAL;
     struct timeval tv;
-    time_t tp;
+    long tid;
+
+    gettimeofday(&tv, 0);
+#ifdef WIN32
+    tid = (long)GetThreadId(GetCurrentThread());
+#else
+    tid = (long)gen_thread_self();
+#endif
+    temp_size = gossip_format_stamp(bptr, prefix, ts, &tv, tid);
+    bptr += temp_size;
+    bsize -= temp_size;
+
+#ifndef WIN32
+    ret = vsnprintf(bptr, bsize, format, ap);
+    if (ret < 0)
+    {
+        return -errno;
+    }
+#else
+    ret = vsnprintf_s(bptr, bsize, _TRUNCATE, format, ap);
+    if (ret == -1 && errno != 0)
+    {
+        return -errno;
+    }
+#endif
+
+    ret = fprintf(fp, "%s", buffer);
+    if (ret < 0)
+    {
+        return -errno;
+    }
+    fflush(fp);
+
+    return 0;
+}
+
+/* gossip_format_stamp()
+ *
+ * writes the "[prefix timestamp] " lead-in of a message into buf, which
+ * must hold at least 64 bytes
+ *
+ * returns the number of characters written
+ */
+static int gossip_format_stamp(char *buf, char prefix,
+    enum gossip_logstamp ts, const struct timeval *tv, long tid)
+{
+    char *bptr = buf;
+    time_t tp = tv->tv_sec;
 
     sprintf(bptr, "[%c ", prefix);
     bptr += 3;
-    bsize -= 3;
 
     switch(ts)
     {
         case GOSSIP_LOGSTAMP_USEC:
-            gettimeofday(&tv, 0);
-            tp = tv.tv_sec;
             strftime(bptr, 9, "%H:%M:%S", localtime(&tp));
-            sprintf(bptr+8, ".%06ld] ", (long)tv.tv_usec);
+            sprintf(bptr+8, ".%06ld] ", (long)tv->tv_usec);
             bptr += 17;
-            bsize -= 17;
             break;
         case GOSSIP_LOGSTAMP_DATETIME:
-            gettimeofday(&tv, 0);
-            tp = tv.tv_sec;
             strftime(bptr, 22, "%m/%d/%Y %H:%M:%S] ", localtime(&tp));
             bptr += 21;
-            bsize -= 21;
             break;
         case GOSSIP_LOGSTAMP_THREAD:
-            gettimeofday(&tv, 0);
-            tp = tv.tv_sec;
             strftime(bptr, 9, "%H:%M:%S", localtime(&tp));
             bptr += 8;
-            bsize -= 8;
 #ifdef WIN32
-            temp_size = sprintf(bptr, ".%03ld (%4ld)] ", (long)tv.tv_usec / 1000,
-                           GetThreadId(GetCurrentThread()));
+            bptr += sprintf(bptr, ".%03ld (%4ld)] ",
+                            (long)tv->tv_usec / 1000, tid);
 #else
-            temp_size = sprintf(bptr, ".%06ld (%ld)] ", (long)tv.tv_usec, 
-                           (long int)gen_thread_self());
+            bptr += sprintf(bptr, ".%06ld (%ld)] ", (long)tv->tv_usec, tid);
 #endif
-            bptr += temp_size;
-            bsize -= temp_size;
             break;
 
         case GOSSIP_LOGSTAMP_NONE:
             bptr--;
             sprintf(bptr, "] ");
             bptr += 2;
-            bsize++;
             break;
         default:
             break;
     }
-    
-#ifndef WIN32
-    ret = vsnprintf(bptr, bsize, format, ap);
-    if (ret < 0)
+
+    return (int)(bptr - buf);
+}
+
+#ifdef GOSSIP_HAVE_ASYNC
+/* gossip_rate_check()
+ *
+ * charges one message against the rate limit bucket of the lowest
+ * enabled bit of mask, reporting how many messages were suppressed
+ * when a new window begins
+ *
+ * returns 1 if the message should be logged, 0 if it is suppressed
+ */
+static int gossip_rate_check(uint64_t mask, int64_t now)
+{
+    struct gossip_rate_bucket *bucket;
+    uint64_t bits = mask & gossip_debug_mask;
+    int64_t window;
+    uint32_t suppressed = 0;
+
+    if (!bits)
     {
-        return -errno;
+        return 1;
     }
-#else
-    ret = vsnprintf_s(bptr, bsize, _TRUNCATE, format, ap);
-    if (ret == -1 && errno != 0)
+    bucket = &gossip_rate_buckets[__builtin_ctzll(bits)];
+
+    window = __atomic_load_n(&bucket->window, __ATOMIC_RELAXED);
+    if (window != now &&
+        __atomic_compare_exchange_n(&bucket->window, &window, now, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
     {
-        return -errno;
+        __atomic_store_n(&bucket->count, 0, __ATOMIC_RELAXED);
+        suppressed = __atomic_exchange_n(&bucket->suppressed, 0,
+                                         __ATOMIC_RELAXED);
     }
-#endif
 
-    ret = fprintf(fp, "%s", buffer);
-    if (ret < 0)
+    if (suppressed)
+    {
+        /* mask of zero bypasses the limit */
+        __gossip_debug(0, 'D', "gossip: suppressed %u messages for debug "
+                       "mask 0x%llx (limit %u/sec)\n", suppressed,
+                       (unsigned long long)(bits & -bits), gossip_rate_limit);
+    }
+
+    if (__atomic_add_fetch(&bucket->count, 1, __ATOMIC_RELAXED) >
+        gossip_rate_limit)
+    {
+        __atomic_add_fetch(&bucket->suppressed, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    return 1;
+}
+
+static void gossip_ring_copy_in(struct gossip_async_ring *ring,
+    uint64_t pos, const void *src, uint32_t len)
+{
+    uint32_t off = (uint32_t)(pos & (ring->size - 1));
+    uint32_t first = ring->size - off;
+
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(ring->buf + off, src, first);
+    memcpy(ring->buf, (const char *)src + first, len - first);
+}
+
+static void gossip_ring_copy_out(struct gossip_async_ring *ring,
+    uint64_t pos, void *dst, uint32_t len)
+{
+    uint32_t off = (uint32_t)(pos & (ring->size - 1));
+    uint32_t first = ring->size - off;
+
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(dst, ring->buf + off, first);
+    memcpy((char *)dst + first, ring->buf, len - first);
+}
+
+/* gossip_async_orphan()
+ *
+ * thread specific data destructor; hands the exiting thread's ring to
+ * the writer, which frees it once it has been drained
+ */
+static void gossip_async_orphan(void *arg)
+{
+    struct gossip_async_ring *ring = arg;
+
+    gossip_my_ring = NULL;
+    __atomic_store_n(&ring->orphaned, 1, __ATOMIC_RELEASE);
+}
+
+static struct gossip_async_ring *gossip_async_ring_create(void)
+{
+    struct gossip_async_ring *ring;
+
+    ring = calloc(1, sizeof(*ring));
+    if (!ring)
+    {
+        return NULL;
+    }
+    ring->size = gossip_async_ring_size;
+    ring->buf = malloc(ring->size);
+    if (!ring->buf)
+    {
+        free(ring);
+        return NULL;
+    }
+
+    gen_mutex_lock(&gossip_async_mutex);
+    ring->next = gossip_async_rings;
+    gossip_async_rings = ring;
+    gen_mutex_unlock(&gossip_async_mutex);
+
+    pthread_setspecific(gossip_async_key, ring);
+    gossip_my_ring = ring;
+    return ring;
+}
+
+/* gossip_async_put()
+ *
+ * formats a message into the calling thread's ring.  Never blocks; the
+ * message is dropped if the ring is full.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int gossip_async_put(char prefix, const struct timeval *tv,
+    const char *format, va_list ap)
+{
+    struct gossip_async_ring *ring = gossip_my_ring;
+    struct gossip_async_hdr hdr;
+    char buffer[GOSSIP_BUF_SIZE];
+    uint64_t head, tail, used;
+    int len;
+
+    if (!ring)
+    {
+        ring = gossip_async_ring_create();
+        if (!ring)
+        {
+            return -ENOMEM;
+        }
+    }
+
+    len = vsnprintf(buffer, sizeof(buffer), format, ap);
+    if (len < 0)
     {
         return -errno;
     }
-    fflush(fp);
+    if (len >= (int)sizeof(buffer))
+    {
+        len = sizeof(buffer) - 1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.len = len;
+    hdr.prefix = prefix;
+    hdr.sec = tv->tv_sec;
+    hdr.usec = tv->tv_usec;
+    hdr.tid = (long)gen_thread_self();
+
+    head = ring->head;
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    used = head - tail + sizeof(hdr) + len;
+    if (used > ring->size)
+    {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1,
+                         __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    gossip_ring_copy_in(ring, head, &hdr, sizeof(hdr));
+    gossip_ring_copy_in(ring, head + sizeof(hdr), buffer, len);
+    __atomic_store_n(&ring->head, head + sizeof(hdr) + len,
+                     __ATOMIC_RELEASE);
+
+    /* wake the writer early rather than let the ring fill up */
+    if (used > ring->size / 2 &&
+        !__atomic_exchange_n(&gossip_async_kicked, 1, __ATOMIC_ACQ_REL))
+    {
+        gen_cond_signal(&gossip_async_cond);
+    }
 
     return 0;
 }
 
+/* gossip_async_drain()
+ *
+ * writes every message buffered so far, oldest first across all rings,
+ * then flushes the output once.  Caller must hold gossip_async_mutex.
+ */
+static void gossip_async_drain(void)
+{
+    struct gossip_async_ring *ring, *oldest, **pp;
+    struct gossip_async_hdr hdr, oldest_hdr;
+    char line[GOSSIP_BUF_SIZE + 64];
+    struct timeval tv;
+    uint64_t dropped;
+    FILE *fp;
+    int wrote = 0;
+    int len;
+
+    if (gossip_facility == GOSSIP_STDERR)
+    {
+        fp = stderr;
+    }
+    else if (gossip_facility == GOSSIP_FILE && internal_log_file)
+    {
+        fp = internal_log_file;
+    }
+    else
+    {
+        /* nowhere to write yet; leave the messages buffered */
+        return;
+    }
+
+    for (ring = gossip_async_rings; ring; ring = ring->next)
+    {
+        ring->drain_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    }
+
+    /* merge the rings by time stamp */
+    for (;;)
+    {
+        oldest = NULL;
+        for (ring = gossip_async_rings; ring; ring = ring->next)
+        {
+            if (ring->tail == ring->drain_head)
+            {
+                continue;
+            }
+            gossip_ring_copy_out(ring, ring->tail, &hdr, sizeof(hdr));
+            if (!oldest || hdr.sec < oldest_hdr.sec ||
+                (hdr.sec == oldest_hdr.sec && hdr.usec < oldest_hdr.usec))
+            {
+                oldest = ring;
+                oldest_hdr = hdr;
+            }
+        }
+        if (!oldest)
+        {
+            break;
+        }
+
+        tv.tv_sec = oldest_hdr.sec;
+        tv.tv_usec = oldest_hdr.usec;
+        len = gossip_format_stamp(line, oldest_hdr.prefix,
+                                  internal_logstamp, &tv, oldest_hdr.tid);
+        gossip_ring_copy_out(oldest, oldest->tail + sizeof(hdr),
+                             line + len, oldest_hdr.len);
+        fwrite(line, 1, len + oldest_hdr.len, fp);
+        wrote = 1;
+
+        __atomic_store_n(&oldest->tail,
+                         oldest->tail + sizeof(hdr) + oldest_hdr.len,
+                         __ATOMIC_RELEASE);
+    }
+
+    pp = &gossip_async_rings;
+    while ((ring = *pp))
+    {
+        dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        if (dropped != ring->dropped_reported)
+        {
+            gettimeofday(&tv, 0);
+            len = gossip_format_stamp(line, 'E', internal_logstamp, &tv,
+                                      (long)gen_thread_self());
+            fprintf(fp, "%.*sgossip: dropped %llu messages, log buffer "
+                    "full\n", len, line,
+                    (unsigned long long)(dropped - ring->dropped_reported));
+            ring->dropped_reported = dropped;
+            wrote = 1;
+        }
+
+        /* the orphaned flag is only set after the owner's last put */
+        if (__atomic_load_n(&ring->orphaned, __ATOMIC_ACQUIRE) &&
+            ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+        {
+            *pp = ring->next;
+            free(ring->buf);
+            free(ring);
+            continue;
+        }
+        pp = &ring->next;
+    }
+
+    if (wrote)
+    {
+        fflush(fp);
+    }
+}
+
+static void *gossip_async_writer(void *arg)
+{
+    struct timespec abstime;
+    struct timeval now;
+
+    gen_mutex_lock(&gossip_async_mutex);
+    while (!gossip_async_stop)
+    {
+        if (!__atomic_load_n(&gossip_async_kicked, __ATOMIC_ACQUIRE))
+        {
+            gettimeofday(&now, 0);
+            abstime.tv_sec = now.tv_sec;
+            abstime.tv_nsec = now.tv_usec * 1000 +
+                GOSSIP_ASYNC_FLUSH_MSECS * 1000000;
+            if (abstime.tv_nsec >= 1000000000)
+            {
+                abstime.tv_sec++;
+                abstime.tv_nsec -= 1000000000;
+            }
+            gen_cond_timedwait(&gossip_async_cond, &gossip_async_mutex,
+                               &abstime);
+        }
+        __atomic_store_n(&gossip_async_kicked, 0, __ATOMIC_RELEASE);
+        gossip_async_drain();
+    }
+    gen_mutex_unlock(&gossip_async_mutex);
+
+    return NULL;
+}
+#endif /* GOSSIP_HAVE_ASYNC */
+
 /* gossip_err_syslog()
  * 
  * error message function for the syslog logging facility
@@ -652,11 +1259,19 @@ static int gossip_disable_stderr(
 static int gossip_disable_file(
     void)
 {
+    gossip_async_lock();
     if (internal_log_file)
     {
+#ifdef GOSSIP_HAVE_ASYNC
+        if (gossip_async_on)
+        {
+            gossip_async_drain();
+        }
+#endif
         fclose(internal_log_file);
         internal_log_file = NULL;
     }
+    gossip_async_unlock();
     return 0;
 }
 
@@ -95,6 +95,10 @@ int gossip_disable(void);
 int gossip_set_debug_mask(int debug_on, uint64_t mask);
 int gossip_get_debug_mask(int *debug_on, uint64_t *mask);
 int gossip_set_logstamp(enum gossip_logstamp ts);
+int gossip_enable_async(int ring_size);
+int gossip_disable_async(void);
+int gossip_flush(void);
+int gossip_set_rate_limit(unsigned int msgs_per_sec);
 
 void gossip_backtrace(void);
 
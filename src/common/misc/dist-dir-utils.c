@@ -13,7 +13,9 @@
 #include "pvfs2-internal.h"
 #include "dist-dir-utils.h"
 #include "md5.h"
+#include "murmur3.h"
 #include "bmi-byteswap.h"
+#include "gossip.h"
 
 
 /****************************
@@ -68,6 +70,7 @@ static int dist_dir_calc_branch_level(
 /* init dir state function, set all parameters
  * server_no <- -1..(num_servers-1)
  * pre_dsg_num_server: pre-set a number of servers, used for known large directory. default value can be 1.
+ * hash_type: PVFS_DIST_DIR_HASH_* used to map entry names to buckets.
  */
 
 int PINT_init_dist_dir_state(
@@ -76,7 +79,8 @@ int PINT_init_dist_dir_state(
 		const int num_servers, 
 		const int server_no, 
 		int pre_dsg_num_server,
-                const int split_size)
+                const int split_size,
+                const int hash_type)
 {
 	int i;
         double cval;
@@ -135,6 +139,7 @@ int PINT_init_dist_dir_state(
 
 	/* set split size */
 	dist_dir_attr->split_size = split_size;
+	dist_dir_attr->hash_type = hash_type;
 	return 0;
 }
 
@@ -277,13 +282,12 @@ int PINT_update_dist_dir_bitmap_from_bitmap(
 }
 
 
-/** a md5 encrypt function
- * MD5 encryption returns a 128bit value, the hash value takes the last 64bit
- * and save as an uint64_t
+/* dist_dir_hash_md5()
  *
- * ?? later, may add an option to be able to use other hash algorithm?
+ * MD5 returns a 128bit value, the hash value takes the last 64bit
+ * and save as an uint64_t
  */
-PVFS_dist_dir_hash_type PINT_encrypt_dirdata(const char *const name)
+static PVFS_dist_dir_hash_type dist_dir_hash_md5(const char *const name)
 {
 	PVFS_dist_dir_hash_type *hash_val;
 	md5_state_t state;
@@ -297,7 +301,108 @@ PVFS_dist_dir_hash_type PINT_encrypt_dirdata(const char *const name)
         return bmitoh64(*hash_val);
 }
 
+/* dist_dir_hash_murmur3()
+ *
+ * MurmurHash3_x64_128 of the name, the hash value takes the first 64bit.
+ * The hash reads the name as native 64bit words, so big endian hosts
+ * hash a byte swapped copy to compute the same value as little endian
+ * ones.
+ */
+static PVFS_dist_dir_hash_type dist_dir_hash_murmur3(const char *const name)
+{
+	uint64_t out[2];
+	int len = strlen(name);
+#ifdef WORDS_BIGENDIAN
+	uint64_t words[(PVFS_NAME_MAX / 8) + 1];
+	uint64_t *buf = words;
+	int i;
+
+	if(len > sizeof(words))
+	{
+		buf = malloc(len + 8);
+		if(!buf)
+		{
+			gossip_lerr("out of memory hashing dirent %s\n", name);
+			return dist_dir_hash_md5(name);
+		}
+	}
+	memcpy(buf, name, len);
+	for(i = 0; i < len / 8; i++)
+	{
+		buf[i] = bmitoh64(buf[i]);
+	}
+	MurmurHash3_x64_128(buf, len, 0, out);
+	if(buf != words)
+	{
+		free(buf);
+	}
+#else
+	MurmurHash3_x64_128(name, len, 0, out);
+#endif
+	return out[0];
+}
+
+/* PINT_encrypt_dirdata()
+ *
+ * hash an entry name with the hash function recorded in the directory's
+ * dist_dir_attr; only the rightmost bits of the result are used to pick
+ * the dirdata bucket.
+ *
+ * returns the hash value
+ */
+PVFS_dist_dir_hash_type PINT_encrypt_dirdata(
+		const PVFS_dist_dir_attr *const dist_dir_attr,
+		const char *const name)
+{
+	switch(dist_dir_attr->hash_type)
+	{
+		case PVFS_DIST_DIR_HASH_MURMUR3:
+			return dist_dir_hash_murmur3(name);
+		case PVFS_DIST_DIR_HASH_MD5:
+			return dist_dir_hash_md5(name);
+		default:
+			gossip_lerr("unknown dist dir hash type %d, using md5\n",
+				dist_dir_attr->hash_type);
+			return dist_dir_hash_md5(name);
+	}
+}
+
+/* PINT_dist_dir_hash_type_from_name()
+ *
+ * map a hash function name ("md5", "murmur3") to its PVFS_DIST_DIR_HASH_*
+ * value.
+ *
+ * returns the hash type, -PVFS_EINVAL if the name is unknown
+ */
+int PINT_dist_dir_hash_type_from_name(const char *name)
+{
+	if(!strcasecmp(name, "md5"))
+	{
+		return PVFS_DIST_DIR_HASH_MD5;
+	}
+	if(!strcasecmp(name, "murmur3"))
+	{
+		return PVFS_DIST_DIR_HASH_MURMUR3;
+	}
+	return -PVFS_EINVAL;
+}
 
+/* PINT_dist_dir_hash_type_name()
+ *
+ * returns the name of a PVFS_DIST_DIR_HASH_* value, "unknown" otherwise
+ */
+const char *PINT_dist_dir_hash_type_name(const int hash_type)
+{
+	switch(hash_type)
+	{
+		case PVFS_DIST_DIR_HASH_MD5:
+			return "md5";
+		case PVFS_DIST_DIR_HASH_MURMUR3:
+			return "murmur3";
+		default:
+			return "unknown";
+	}
+}
 
 /* set server_no field and update branch_level if necessary */
 int PINT_dist_dir_set_serverno(const int server_no, 
@@ -317,6 +422,64 @@ int PINT_dist_dir_set_serverno(const int server_no,
         return 0;
 }
 
+/* grow a distributed directory to num_servers dirdata servers.
+ * The tree height and the bitmap are extended, the new bits left unset;
+ * since buckets are found from the set bits only, every entry stays in
+ * its current bucket.  *bitmap_ptr is reallocated if it needs to grow.
+ */
+int PINT_grow_dist_dir_state(
+		PVFS_dist_dir_attr *dist_dir_attr,
+		PVFS_dist_dir_bitmap *bitmap_ptr,
+		const int num_servers)
+{
+	PVFS_dist_dir_bitmap bitmap;
+	int tree_height, bitmap_size;
+
+	assert(dist_dir_attr != NULL && bitmap_ptr != NULL &&
+			*bitmap_ptr != NULL);
+
+	if (num_servers <= dist_dir_attr->num_servers)
+	{
+		return -1;
+	}
+
+	tree_height = (int)ceil(my_log2((double)num_servers));
+	if( (1l << tree_height) >
+		(sizeof(PVFS_dist_dir_bitmap_basetype) * 8))
+	{
+		bitmap_size = ((1l << tree_height) >> 5);
+	}
+	else
+	{
+		bitmap_size = 1;
+	}
+
+	if (bitmap_size > dist_dir_attr->bitmap_size)
+	{
+		bitmap = realloc(*bitmap_ptr,
+				bitmap_size * sizeof(PVFS_dist_dir_bitmap_basetype));
+		if (bitmap == NULL)
+		{
+			return -1;
+		}
+		memset(bitmap + dist_dir_attr->bitmap_size, 0,
+				(bitmap_size - dist_dir_attr->bitmap_size) *
+				sizeof(PVFS_dist_dir_bitmap_basetype));
+		*bitmap_ptr = bitmap;
+	}
+
+	dist_dir_attr->num_servers = num_servers;
+	dist_dir_attr->tree_height = tree_height;
+	dist_dir_attr->bitmap_size = bitmap_size;
+
+	if(dist_dir_attr->server_no > -1) /* dirdata server */
+	{
+		dist_dir_attr->branch_level =
+			dist_dir_calc_branch_level(dist_dir_attr, *bitmap_ptr);
+	}
+	return 0;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -13,10 +13,11 @@
 #define PINT_debug_dist_dir_attr(debugmask,dist_dir_attr) \
     do {gossip_debug(debugmask, \
         "dist_dir_attr: tree_height=%d, num_servers=%d, bitmap_size=%d, "\
-        "split_size=%d, server_no=%d and branch_level=%d\n", \
+        "split_size=%d, server_no=%d, branch_level=%d and hash_type=%d\n", \
         dist_dir_attr.tree_height, dist_dir_attr.num_servers, \
         dist_dir_attr.bitmap_size, dist_dir_attr.split_size, \
-        dist_dir_attr.server_no, dist_dir_attr.branch_level); } while (0)
+        dist_dir_attr.server_no, dist_dir_attr.branch_level, \
+        dist_dir_attr.hash_type); } while (0)
 
 #define PINT_debug_dist_dir_bitmap(debugmask,dist_dir_attr,dist_dir_bitmap) \
     do { int i; \
@@ -78,7 +79,8 @@ int PINT_init_dist_dir_state(
 		const int num_servers, 
 		const int server_no, 
 		int pre_dsg_num_server,
-                const int split_size);
+                const int split_size,
+                const int hash_type);
 int PINT_is_dist_dir_bucket_active(
 		const PVFS_dist_dir_attr *dist_dir_attr_p, 
 		const PVFS_dist_dir_bitmap bitmap,
@@ -95,10 +97,18 @@ int PINT_update_dist_dir_bitmap_from_bitmap(
 		PVFS_dist_dir_bitmap to_dir_bitmap,
 		const PVFS_dist_dir_attr *from_dir_attr, 
 		const PVFS_dist_dir_bitmap from_dir_bitmap);
-PVFS_dist_dir_hash_type PINT_encrypt_dirdata(const char *const name);
+PVFS_dist_dir_hash_type PINT_encrypt_dirdata(
+		const PVFS_dist_dir_attr *const dist_dir_attr,
+		const char *const name);
+int PINT_dist_dir_hash_type_from_name(const char *name);
+const char *PINT_dist_dir_hash_type_name(const int hash_type);
 int PINT_dist_dir_set_serverno(const int server_no, 
 	PVFS_dist_dir_attr *ddattr, 
 	PVFS_dist_dir_bitmap ddbitmap);
+int PINT_grow_dist_dir_state(
+		PVFS_dist_dir_attr *dist_dir_attr,
+		PVFS_dist_dir_bitmap *bitmap_ptr,
+		const int num_servers);
 
 #define PINT_dist_dir_attr_copyto(to_attr, from_attr) \
 do { \
@@ -108,6 +118,7 @@ do { \
 	to_attr.split_size = from_attr.split_size; \
 	to_attr.server_no = from_attr.server_no; \
 	to_attr.branch_level = from_attr.branch_level; \
+	to_attr.hash_type = from_attr.hash_type; \
 } while(0)
 	
 
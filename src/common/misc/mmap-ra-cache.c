@@ -61,6 +61,36 @@ static struct racache_s racache =
     0      /* oldarray_sz */
 };
 
+struct PINT_perf_key racache_keys[] =
+{
+   {"RACACHE_BUFFERS", PERF_RACACHE_BUFFERS, PINT_PERF_PRESERVE},
+   {"RACACHE_BUFFER_SIZE", PERF_RACACHE_BUFFER_SIZE, PINT_PERF_PRESERVE},
+   {"RACACHE_MAX_WINDOW", PERF_RACACHE_MAX_WINDOW, PINT_PERF_PRESERVE},
+   {"RACACHE_READS", PERF_RACACHE_READS, 0},
+   {"RACACHE_HITS", PERF_RACACHE_HITS, 0},
+   {"RACACHE_WAITS", PERF_RACACHE_WAITS, 0},
+   {"RACACHE_MISSES", PERF_RACACHE_MISSES, 0},
+   {"RACACHE_BYPASSES", PERF_RACACHE_BYPASSES, 0},
+   {"RACACHE_RA_ISSUED", PERF_RACACHE_RA_ISSUED, 0},
+   {"RACACHE_RA_USED", PERF_RACACHE_RA_USED, 0},
+   {"RACACHE_RA_WASTED", PERF_RACACHE_RA_WASTED, 0},
+   {"RACACHE_HIT_PERCENT", PERF_RACACHE_HIT_PERCENT, PINT_PERF_PRESERVE},
+   {"RACACHE_WASTE_PERCENT", PERF_RACACHE_WASTE_PERCENT, PINT_PERF_PRESERVE},
+   {NULL, 0, 0},
+};
+
+static struct PINT_perf_counter *racache_pc = NULL;
+
+/* totals since startup behind the hit and waste percentages; the
+ * interval counters above roll over */
+static struct
+{
+    uint64_t reads;
+    uint64_t hits;
+    uint64_t ra_issued;
+    uint64_t ra_wasted;
+} racache_totals;
+
 #define RACACHE_INITIALIZED() (racache.hash_table)
 
 #define DEFAULT_RACACHE_HTABLE_SIZE  19
@@ -100,12 +130,80 @@ int pint_racache_read_count(void)
     return racache.readcnt;
 }
 
+/* the read count is the largest window a sequential stream ramps up to */
 int pint_racache_set_read_count(int readcnt)
 {
     racache.readcnt = readcnt;
+    PINT_perf_count(racache_pc, PERF_RACACHE_MAX_WINDOW, readcnt,
+                    PINT_PERF_SET);
     return 0;
 }
 
+struct PINT_perf_counter *pint_racache_get_pc(void)
+{
+    return racache_pc;
+}
+
+/* racache_count()
+ *
+ * adds one to a racache perf counter and keeps the hit and waste
+ * percentages current.  Caller holds racache.mutex.
+ */
+static void racache_count(int key)
+{
+    PINT_perf_count(racache_pc, key, 1, PINT_PERF_ADD);
+    switch (key)
+    {
+    case PERF_RACACHE_READS:
+        racache_totals.reads++;
+        break;
+    case PERF_RACACHE_HITS:
+    case PERF_RACACHE_WAITS:
+        racache_totals.hits++;
+        break;
+    case PERF_RACACHE_RA_ISSUED:
+        racache_totals.ra_issued++;
+        break;
+    case PERF_RACACHE_RA_WASTED:
+        racache_totals.ra_wasted++;
+        break;
+    default:
+        return;
+    }
+    if (racache_totals.reads)
+    {
+        PINT_perf_count(racache_pc, PERF_RACACHE_HIT_PERCENT,
+                        100 * racache_totals.hits / racache_totals.reads,
+                        PINT_PERF_SET);
+    }
+    if (racache_totals.ra_issued)
+    {
+        PINT_perf_count(racache_pc, PERF_RACACHE_WASTE_PERCENT,
+                        100 * racache_totals.ra_wasted /
+                        racache_totals.ra_issued,
+                        PINT_PERF_SET);
+    }
+}
+
+/* a demand read was served from buff */
+static void racache_buf_used(racache_buffer_t *buff)
+{
+    if (buff->speculative && buff->hits == 0)
+    {
+        racache_count(PERF_RACACHE_RA_USED);
+    }
+    buff->hits++;
+}
+
+/* buff is being recycled; readahead nobody read was wasted */
+static void racache_buf_retire(racache_buffer_t *buff)
+{
+    if (buff->speculative && buff->hits == 0)
+    {
+        racache_count(PERF_RACACHE_RA_WASTED);
+    }
+}
+
 int pint_racache_pinned(void)
 {
     return racache.pinned;
@@ -139,6 +237,19 @@ int pint_racache_initialize(int bufcnt, int bufsz, int readcnt, int pinned)
         {
             racache.pinned = pinned;
         }
+        if (!racache_pc)
+        {
+            racache_pc = PINT_perf_initialize(PINT_PERF_COUNTER,
+                                              racache_keys,
+                                              NULL);
+            if (!racache_pc)
+            {
+                gossip_err("Error: PINT_perf_initialize failure.\n");
+                return -1;
+            }
+            PINT_perf_count(racache_pc, PERF_RACACHE_MAX_WINDOW,
+                            racache.readcnt, PINT_PERF_SET);
+        }
         if (racache_buf_init(&racache) < 0)
         {
             return -1;
@@ -171,8 +282,11 @@ static void racache_init_file(racache_file_t *file)
 {
     memset(&file->refn, 0, sizeof(PVFS_object_ref));
 
-    /* eventually want a way to pass this in from the file */
-    file->readcnt = racache.readcnt;
+    /* the window opens once the file is seen to be read sequentially */
+    file->readcnt = 0;
+    file->last_offset = 0;
+    file->next_offset = -1;
+    file->seq_count = 0;
 
     INIT_QLIST_HEAD(&file->hash_link);
     INIT_QLIST_HEAD(&file->buff_list);
@@ -186,6 +300,8 @@ static void racache_init_buff(racache_buffer_t *buff)
     buff->valid = 0;
     buff->being_freed = 0;
     buff->resizing = 0;
+    buff->speculative = 0;
+    buff->hits = 0;
     buff->vfs_cnt = 0;
     buff->file_offset = 0;
     buff->data_sz = 0;
@@ -201,6 +317,10 @@ static int racache_buf_init(racache_t *racache)
 {
     int i = 0;
 
+    PINT_perf_count(racache_pc, PERF_RACACHE_BUFFERS, racache->bufcnt,
+                    PINT_PERF_SET);
+    PINT_perf_count(racache_pc, PERF_RACACHE_BUFFER_SIZE, racache->bufsz,
+                    PINT_PERF_SET);
     if (racache->bufcnt * racache->bufsz == 0)
     {
         /* racache turned off */
@@ -456,6 +576,7 @@ static racache_buffer_t *racache_buf_get(racache_file_t *racache_file)
         }
         /* remove from prev file's buffer list */
         qlist_del(&buff->buff_link);
+        racache_buf_retire(buff);
     }
     else /* can't find a usable buffer */
     {
@@ -495,6 +616,91 @@ static void racache_buf_lru(racache_buffer_t *buff)
     qlist_add_tail(&buff->buff_lru, &racache.buff_lru);
 }
 
+/* racache_file_access()
+ *
+ * updates the sequential-stream state of a file for a demand read of
+ * len bytes at offset.  The first read of a file, and any read that
+ * starts where the previous one ended or a little past it (within one
+ * buffer), is sequential.  After PVFS2_RACACHE_SEQ_THRESHOLD sequential
+ * reads in a row the readahead window opens at one buffer, and it
+ * doubles each time the stream moves into a new buffer, up to the
+ * configured read count.  Rereading the previous read's range leaves
+ * the state alone; any other read closes the window.
+ */
+static void racache_file_access(racache_file_t *file,
+                                PVFS_size offset,
+                                PVFS_size len)
+{
+    PVFS_size bufsz = racache.bufsz;
+
+    if (file->next_offset < 0 ||
+        (offset >= file->next_offset && offset < file->next_offset + bufsz))
+    {
+        if (file->seq_count < PVFS2_RACACHE_SEQ_THRESHOLD)
+        {
+            file->seq_count++;
+        }
+        if (file->seq_count >= PVFS2_RACACHE_SEQ_THRESHOLD)
+        {
+            if (file->readcnt == 0)
+            {
+                file->readcnt = 1;
+            }
+            else if (offset / bufsz != (file->next_offset - 1) / bufsz)
+            {
+                file->readcnt *= 2;
+            }
+            if (file->readcnt > racache.readcnt)
+            {
+                file->readcnt = racache.readcnt;
+            }
+        }
+    }
+    else if (offset < file->last_offset || offset >= file->next_offset)
+    {
+        /* random access - this read may start a new stream */
+        gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_file_access "
+                     "non-sequential read at %llu (expected %llu) - "
+                     "readahead off\n",
+                     llu(offset), llu(file->next_offset));
+        file->seq_count = 1;
+        file->readcnt = 0;
+    }
+    file->last_offset = offset;
+    if (offset + len > file->next_offset)
+    {
+        file->next_offset = offset + len;
+    }
+}
+
+int pint_racache_readahead_count(racache_buffer_t *buff, PVFS_size stripe_sz)
+{
+    PVFS_size count = 0;
+    PVFS_size end;
+
+    gen_mutex_lock(&racache.mutex);
+    if (buff->file && buff->file->readcnt > 1 && buff->buff_sz > 0)
+    {
+        /* the window includes buff itself */
+        count = buff->file->readcnt - 1;
+        if (stripe_sz > buff->buff_sz && stripe_sz % buff->buff_sz == 0)
+        {
+            /* stretch the window to the next stripe boundary so each
+             * window reads whole strips from every server */
+            end = buff->file_offset + (count + 1) * buff->buff_sz;
+            end += (stripe_sz - end % stripe_sz) % stripe_sz;
+            count = (end - buff->file_offset) / buff->buff_sz - 1;
+        }
+        /* one stream never holds more than half the cache */
+        if (count > racache.bufcnt / 2)
+        {
+            count = racache.bufcnt / 2;
+        }
+    }
+    gen_mutex_unlock(&racache.mutex);
+    return (int)count;
+}
+
 int pint_racache_get_block(PVFS_object_ref refn,
                            PVFS_size offset,
                            PVFS_size len,
@@ -512,207 +718,207 @@ int pint_racache_get_block(PVFS_object_ref refn,
                  " %d bytes at offset %lu\n",
                  (int)len, (unsigned long)offset);
 
-    if (RACACHE_INITIALIZED())
+    if (!RACACHE_INITIALIZED())
     {
-        gen_mutex_lock(&racache.mutex);
-        /* find file rec in hash table */
-        hash_link = qhash_search(racache.hash_table, &refn);
-        if (hash_link)
+        gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block error \n");
+        return -1;
+    }
+
+    gen_mutex_lock(&racache.mutex);
+    /* find file rec in hash table */
+    hash_link = qhash_search(racache.hash_table, &refn);
+    if (hash_link)
+    {
+        gossip_debug(GOSSIP_RACACHE_DEBUG, "found file rec\n");
+        racache_file = qhash_entry(hash_link,
+                                   racache_file_t,
+                                   hash_link);
+        assert(racache_file);
+    }
+    else /* hash lookup miss */
+    {
+        /* cache miss  - no file rec found */
+        gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
+                     "clean cache miss (nothing here)\n");
+        racache_file = (racache_file_t *)malloc(sizeof(racache_file_t));
+        if (!racache_file)
         {
-            gossip_debug(GOSSIP_RACACHE_DEBUG, "found file rec\n");
-            racache_file = qhash_entry(hash_link,
-                                       racache_file_t,
-                                       hash_link);
-            assert(racache_file);
+            gen_mutex_unlock(&racache.mutex);
+            return RACACHE_NONE;
+        }
+        racache_init_file(racache_file);
+        racache_file->refn = refn;
+        gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
+                     "adding new file rec to hash table\n");
+        qhash_add(racache.hash_table, &refn, &racache_file->hash_link);
+    }
+
+    if (!readahead_speculative)
+    {
+        racache_count(PERF_RACACHE_READS);
+        racache_file_access(racache_file, offset, len);
+    }
 
-            /* found the file, now search for a buffer */
-            qlist_for_each_entry(buff, &racache_file->buff_list, buff_link)
+    /* search the file's buffers */
+    qlist_for_each_entry(buff, &racache_file->buff_list, buff_link)
+    {
+        /* cache hit must have all of the requested data */
+        if (offset >= buff->file_offset &&
+            (offset + len) <= buff->file_offset + buff->buff_sz)
+        {
+            /* data in cache - reset lru and set up return */
+            racache_buf_lru(buff);
+            /* found a matching buffer */
+            if (buff->valid)
             {
-                /* cache hit must have all of the requested data */
-                if (offset >= buff->file_offset &&
-                    (offset + len) <= buff->file_offset + buff->buff_sz)
+                gossip_debug(GOSSIP_RACACHE_DEBUG,
+                             "racache_get_block got buffer %d at "
+                             "file_offset %llu, data_sz %llu\n",
+                             buff->buff_id,
+                             llu(buff->file_offset),
+                             llu(buff->data_sz));
+                if (!readahead_speculative)
                 {
-                    /* data in cache - reset lru and set up return */
-                    racache_buf_lru(buff);
-                    /* found a matching buffer */
-                    if (buff->valid)
-                    {
-                        gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                     "racache_get_block got buffer %d at "
-                                     "file_offset %llu, data_sz %llu\n",  
-                                     buff->buff_id,
-                                     llu(buff->file_offset),
-                                     llu(buff->data_sz));
-                        if (rbuf)
-                        {
-                            *rbuf = buff;
-                        }
-                        if (amt_returned)
-                        {
-                            *amt_returned = (buff->file_offset +
-                                             buff->data_sz) - offset;
-                            if (len < *amt_returned)
-                            {
-                                *amt_returned = len;
-                            }
-                        }
-
-                        gen_mutex_unlock(&racache.mutex);
-                        return RACACHE_HIT;
-                    }
-                    else /* found buffer but not valid */
+                    racache_count(PERF_RACACHE_HITS);
+                    racache_buf_used(buff);
+                }
+                if (rbuf)
+                {
+                    *rbuf = buff;
+                }
+                if (amt_returned)
+                {
+                    *amt_returned = (buff->file_offset +
+                                     buff->data_sz) - offset;
+                    if (len < *amt_returned)
                     {
-                        if (!readahead_speculative)
-                        {
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                         "racache_get_block "
-                                         "found invalid buffer %d "
-                                         "- will wait\n",
-                                         buff->buff_id);
-                            /* add request to waiting list */
-                            glink = (gen_link_t *)malloc(sizeof(gen_link_t));
-                            glink->payload = vfs_req;
-                            /* makes list FIFO */
-                            qlist_add_tail(&glink->link, &buff->vfs_link);
-                            buff->vfs_cnt++;
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                         "racache_get_block "
-                                         "adding request %p to buffer "
-                                         "%d vfs list #%d \n",
-                                         vfs_req, buff->buff_id, buff->vfs_cnt);
-                        }
-                        else
-                        {
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                         "racache_get_block "
-                                         "found invalid buffer %d\n",
-                                         buff->buff_id);
-                        }
-                        /* return buffer */
-                        if (rbuf)
-                        {
-                            *rbuf = buff;
-                        }
-                        if (amt_returned)
-                        {
-                            *amt_returned = 0;
-                        }
-                        gen_mutex_unlock(&racache.mutex);
-                        return RACACHE_WAIT;
+                        *amt_returned = len;
                     }
                 }
-            } /* end of for loop */
-            /* No matching buffer for this file found */
-            gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
-                         "short cache miss (no buffer)\n");
 
-            buff = racache_buf_get(racache_file);
-            if (!buff)
-            {
                 gen_mutex_unlock(&racache.mutex);
-                /* This forces a regular io read in post_io_request */
-                return RACACHE_NONE;
+                return RACACHE_HIT;
             }
-            buff->file = racache_file;
-            buff->file_offset = pint_racache_buff_offset(offset);
-            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                         "racache_get_block offset %llu(%llu) size %llu\n",
-                         llu(offset), llu(buff->file_offset),
-                         llu(buff->buff_sz));
-
-            /* add request to waiting list */
-            glink = (gen_link_t *)malloc(sizeof(gen_link_t));
-            INIT_QLIST_HEAD(&glink->link);
-            glink->payload = vfs_req;
-            /* makes list FIFO */
-            qlist_add_tail(&glink->link, &buff->vfs_link);
-            buff->vfs_cnt++;
-            gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
-                         "adding request %p to buffer %d vfs list #%d \n",
-                         vfs_req, buff->buff_id, buff->vfs_cnt);
-            /* return new buffer */
-            if (rbuf)
+            else /* found buffer but not valid */
             {
-                *rbuf = buff;
-            }
-            if (amt_returned)
-            {
-                *amt_returned = 0;
+                if (!readahead_speculative)
+                {
+                    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                                 "racache_get_block "
+                                 "found invalid buffer %d "
+                                 "- will wait\n",
+                                 buff->buff_id);
+                    racache_count(PERF_RACACHE_WAITS);
+                    racache_buf_used(buff);
+                    /* add request to waiting list */
+                    glink = (gen_link_t *)malloc(sizeof(gen_link_t));
+                    glink->payload = vfs_req;
+                    /* makes list FIFO */
+                    qlist_add_tail(&glink->link, &buff->vfs_link);
+                    buff->vfs_cnt++;
+                    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                                 "racache_get_block "
+                                 "adding request %p to buffer "
+                                 "%d vfs list #%d \n",
+                                 vfs_req, buff->buff_id, buff->vfs_cnt);
+                }
+                else
+                {
+                    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                                 "racache_get_block "
+                                 "found invalid buffer %d\n",
+                                 buff->buff_id);
+                }
+                /* return buffer */
+                if (rbuf)
+                {
+                    *rbuf = buff;
+                }
+                if (amt_returned)
+                {
+                    *amt_returned = 0;
+                }
+                gen_mutex_unlock(&racache.mutex);
+                return RACACHE_WAIT;
             }
-
-            /* set up new request */
-            gen_mutex_unlock(&racache.mutex);
-            return RACACHE_READ;
         }
-        else /* hash lookup miss */
+    } /* end of for loop */
+    /* No matching buffer for this file found */
+    gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
+                 "short cache miss (no buffer)\n");
+
+    if (!readahead_speculative && racache_file->readcnt == 0)
+    {
+        /* not a sequential stream - read around the cache rather
+         * than fill a whole buffer for it */
+        gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
+                     "readahead window closed - returning NONE\n");
+        racache_count(PERF_RACACHE_BYPASSES);
+        gen_mutex_unlock(&racache.mutex);
+        return RACACHE_NONE;
+    }
+
+    gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
+                 "calling racache_buf_get\n");
+    buff = racache_buf_get(racache_file);
+    if (!buff)
+    {
+        gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
+                     "no buffer returned - returning NONE\n");
+        if (!readahead_speculative)
         {
-            racache_file_t *rcfile;
-
-            /* cache miss  - no file rec found */
-            gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
-                         "clean cache miss (nothing here)\n");
-            /* try to get a buffer, if we can set up a file
-             * rec and indicate a new readahead */
-            rcfile = (racache_file_t *)malloc(sizeof(racache_file_t));
-            if (!rcfile)
-            {
-                gen_mutex_unlock(&racache.mutex);
-                return RACACHE_NONE;
-            }
-            racache_init_file(rcfile);
-            rcfile->refn = refn;
-            gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
-                         "adding new file rec to hash table\n");
-            qhash_add(racache.hash_table, &refn, &rcfile->hash_link);
-
-            gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
-                        "calling racache_buf_get\n");
-            buff = racache_buf_get(rcfile);
-            if (!buff)
-            {
-                gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
-                        "no buffer returned - returning NONE\n");
-                gen_mutex_unlock(&racache.mutex);
-                return RACACHE_NONE;
-            }
-            gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
-                         "got buffer number %d\n", buff->buff_id);
-                
-            buff->file = rcfile;
-            buff->file_offset = pint_racache_buff_offset(offset);
-            buff->data_sz = 0;
-
-            /* add request to waiting list */
-            glink = (gen_link_t *)malloc(sizeof(gen_link_t));
-            if (!glink)
-            {
-                /* out of memory - try to keep going - skip ra */
-                return RACACHE_NONE;
-            }
-            INIT_QLIST_HEAD(&glink->link);
-            glink->payload = vfs_req;
-            /* makes lists FIFO */
-            qlist_add_tail(&glink->link, &buff->vfs_link);
-            buff->vfs_cnt++;
-            gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
-                         "adding request %p to buffer %d vfs list #%d \n",
-                         vfs_req, buff->buff_id, buff->vfs_cnt);
-
-            /* return new buffer */
-            if (rbuf)
-            {
-                *rbuf = buff;
-            }
-            if (amt_returned)
-            {
-                *amt_returned = 0;
-            }
-            gen_mutex_unlock(&racache.mutex);
-            return RACACHE_READ;
+            racache_count(PERF_RACACHE_BYPASSES);
         }
+        gen_mutex_unlock(&racache.mutex);
+        /* This forces a regular io read in post_io_request */
+        return RACACHE_NONE;
     }
-    gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block error \n");
-    return -1;
+    gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
+                 "got buffer number %d\n", buff->buff_id);
+
+    /* add request to waiting list */
+    glink = (gen_link_t *)malloc(sizeof(gen_link_t));
+    if (!glink)
+    {
+        /* out of memory - try to keep going - skip ra */
+        qlist_del(&buff->buff_lru);
+        qlist_del(&buff->buff_link);
+        pint_racache_make_free(buff);
+        gen_mutex_unlock(&racache.mutex);
+        return RACACHE_NONE;
+    }
+    buff->file = racache_file;
+    buff->file_offset = pint_racache_buff_offset(offset);
+    buff->data_sz = 0;
+    buff->speculative = readahead_speculative;
+    racache_count(readahead_speculative ? PERF_RACACHE_RA_ISSUED :
+                                          PERF_RACACHE_MISSES);
+    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                 "racache_get_block offset %llu(%llu) size %llu\n",
+                 llu(offset), llu(buff->file_offset),
+                 llu(buff->buff_sz));
+
+    INIT_QLIST_HEAD(&glink->link);
+    glink->payload = vfs_req;
+    /* makes list FIFO */
+    qlist_add_tail(&glink->link, &buff->vfs_link);
+    buff->vfs_cnt++;
+    gossip_debug(GOSSIP_RACACHE_DEBUG, "racache_get_block "
+                 "adding request %p to buffer %d vfs list #%d \n",
+                 vfs_req, buff->buff_id, buff->vfs_cnt);
+    /* return new buffer */
+    if (rbuf)
+    {
+        *rbuf = buff;
+    }
+    if (amt_returned)
+    {
+        *amt_returned = 0;
+    }
+
+    /* set up new request */
+    gen_mutex_unlock(&racache.mutex);
+    return RACACHE_READ;
 }
 
 int pint_racache_flush(PVFS_object_ref refn)
@@ -747,6 +953,7 @@ int pint_racache_flush(PVFS_object_ref refn)
                 qlist_del(&buff->buff_lru);
                 /* clear reference to file record */
                 buff->file = NULL;
+                racache_buf_retire(buff);
                 /* check for active requests */
                 if (!buff->valid ||
                     !qlist_empty(&buff->vfs_link))
@@ -870,6 +1077,8 @@ int pint_racache_finalize(void)
             free(racache.oldarray);
         }
         racache.hash_table = NULL; /* is this properly freed? */
+        PINT_perf_finalize(racache_pc);
+        racache_pc = NULL;
         gen_mutex_unlock(&racache.mutex);
 
         /* FIXME: race condition here */
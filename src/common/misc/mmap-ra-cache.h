@@ -9,6 +9,7 @@
 
 #include "quickhash.h"
 #include "pvfs2-internal.h"
+#include "pint-perf-counter.h"
 
 #define PVFS2_DEFAULT_RACACHE_BUFSZ   (2 * 1024 * 1024)
 #define PVFS2_MAX_RACACHE_BUFSZ       (256 * 1024 * 1024)
@@ -21,6 +22,9 @@
 
 #define PVFS2_DEFAULT_RACACHE_PINNED  (1)
 
+/* sequential reads of a file needed before readahead starts */
+#define PVFS2_RACACHE_SEQ_THRESHOLD   (2)
+
 #define PVFS2_RACACHE_READSZ_NOVALUE  -1
 
 /* racache_status values */
@@ -42,7 +46,10 @@ typedef struct racache_file_s
     struct qlist_head hash_link; /* hash table link */
     PVFS_object_ref refn;
     struct qlist_head buff_list; /* list of buffers for this file in cache */
-    PVFS_size readcnt;
+    PVFS_size readcnt;           /* readahead window in buffers, 0 = off */
+    PVFS_size last_offset;       /* offset of the last demand read */
+    PVFS_size next_offset;       /* where a sequential reader reads next */
+    int seq_count;               /* consecutive sequential reads */
 } racache_file_t;
 
 /* one for each buffer in cache */
@@ -54,6 +61,8 @@ typedef struct racache_buffer_s
     int valid;                   /* non zero if read into buffer is complete */
     int being_freed;             /* non zero if file has been flushed */
     int resizing;                /* non zero if buffers are resizing */
+    int speculative;             /* non zero if filled by readahead */
+    int hits;                    /* demand reads served from this buffer */
     int buff_id;
     int vfs_cnt;
     PVFS_size file_offset;
@@ -82,6 +91,24 @@ typedef struct racache_s
     int    oldarray_sz;                /* size of busy bufs in oldarray */
 } racache_t;
 
+/* keys of the racache perf counter */
+enum
+{
+    PERF_RACACHE_BUFFERS = 0,
+    PERF_RACACHE_BUFFER_SIZE = 1,
+    PERF_RACACHE_MAX_WINDOW = 2,
+    PERF_RACACHE_READS = 3,
+    PERF_RACACHE_HITS = 4,
+    PERF_RACACHE_WAITS = 5,
+    PERF_RACACHE_MISSES = 6,
+    PERF_RACACHE_BYPASSES = 7,
+    PERF_RACACHE_RA_ISSUED = 8,
+    PERF_RACACHE_RA_USED = 9,
+    PERF_RACACHE_RA_WASTED = 10,
+    PERF_RACACHE_HIT_PERCENT = 11,
+    PERF_RACACHE_WASTE_PERCENT = 12,
+};
+
 
 /***********************************************
  * mmap_ra_cache methods - specifically for
@@ -123,6 +150,9 @@ int pint_racache_finish_resize(racache_buffer_t *buff);
 
 /*
  * search for a buffer in the cache
+ * demand reads (readahead_speculative == 0) also update the file's
+ * sequential-stream state; a miss on a file that is not being read
+ * sequentially returns RACACHE_NONE
  * returns RACACHE_NONE if no buffers are available - do normal IO
  * returns RACACHE_HIT  on cache hit - data has been copied
  * returns RACACHE_WAIT if the block is currently being read
@@ -136,6 +166,15 @@ int pint_racache_get_block(PVFS_object_ref refn,
                             racache_buffer_t **rbuf,
                             int *amt_returned);
 
+/*
+ * number of buffers to read ahead after buff, from the file's current
+ * window; stripe_sz (0 if unknown) stretches the window to end on a
+ * stripe boundary
+ */
+int pint_racache_readahead_count(racache_buffer_t *buff, PVFS_size stripe_sz);
+
+struct PINT_perf_counter *pint_racache_get_pc(void);
+
 /* remove all cache entries for a given file */
 int pint_racache_flush(PVFS_object_ref refn);
 
@@ -100,6 +100,12 @@ struct PINT_perf_key server_keys[] =
     {"io requests called", PINT_PERF_IO, PINT_PERF_PRESERVE},
     {"small_io requests called", PINT_PERF_SMALL_IO, PINT_PERF_PRESERVE},
     {"readdir requests called", PINT_PERF_READDIR, PINT_PERF_PRESERVE},
+    {"block cache bytes hit", PINT_PERF_BCACHE_HITS, PINT_PERF_PRESERVE},
+    {"block cache bytes missed", PINT_PERF_BCACHE_MISSES, PINT_PERF_PRESERVE},
+    {"attr cache hits", PINT_PERF_ATTR_CACHE_HITS, PINT_PERF_PRESERVE},
+    {"attr cache misses", PINT_PERF_ATTR_CACHE_MISSES, PINT_PERF_PRESERVE},
+    {"attr cache evictions", PINT_PERF_ATTR_CACHE_EVICTIONS,
+        PINT_PERF_PRESERVE},
     {NULL, 0, 0},
 };
 
@@ -0,0 +1,187 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pvfs2-internal.h"
+#include "pvfs2-types.h"
+#include "pvfs2-mgmt.h"
+#include "pint-req-trace.h"
+#include "pint-hint.h"
+#include "pint-util.h"
+#include "gen-locks.h"
+#include "gossip.h"
+#include "pvfs2-debug.h"
+
+/* one compact trace record; 24 bytes */
+struct PINT_req_trace_rec
+{
+    uint64_t start_us;
+    uint32_t dur_us;
+    uint32_t request_id;
+    uint32_t client_id;
+    uint16_t kind;
+    uint16_t op;
+};
+
+int PINT_req_trace_active = 0;
+
+static struct PINT_req_trace_rec *trace_ring = NULL;
+static uint32_t trace_ring_size = 0;
+/* total number of records ever written; (trace_ring_next % size) is
+ * the next slot to be overwritten
+ */
+static uint64_t trace_ring_next = 0;
+static gen_mutex_t trace_mutex = GEN_MUTEX_INITIALIZER;
+
+/* PINT_req_trace_init()
+ *
+ * allocates a ring buffer holding entry_count spans and turns on
+ * tracing.  An entry_count of zero leaves tracing disabled.
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+int PINT_req_trace_init(int entry_count)
+{
+    if (entry_count <= 0)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&trace_mutex);
+    if (trace_ring)
+    {
+        gen_mutex_unlock(&trace_mutex);
+        return -PVFS_EALREADY;
+    }
+    trace_ring = calloc(entry_count, sizeof(struct PINT_req_trace_rec));
+    if (!trace_ring)
+    {
+        gen_mutex_unlock(&trace_mutex);
+        return -PVFS_ENOMEM;
+    }
+    trace_ring_size = entry_count;
+    trace_ring_next = 0;
+    PINT_req_trace_active = 1;
+    gen_mutex_unlock(&trace_mutex);
+
+    gossip_debug(GOSSIP_SERVER_DEBUG,
+                 "request trace buffer enabled (%d entries, %d bytes)\n",
+                 entry_count,
+                 (int)(entry_count * sizeof(struct PINT_req_trace_rec)));
+    return 0;
+}
+
+void PINT_req_trace_finalize(void)
+{
+    gen_mutex_lock(&trace_mutex);
+    PINT_req_trace_active = 0;
+    if (trace_ring)
+    {
+        free(trace_ring);
+        trace_ring = NULL;
+    }
+    trace_ring_size = 0;
+    trace_ring_next = 0;
+    gen_mutex_unlock(&trace_mutex);
+}
+
+PVFS_time PINT_req_trace_now(void)
+{
+    return PINT_util_get_time_us();
+}
+
+/* PINT_req_trace_record()
+ *
+ * appends one span to the trace ring, overwriting the oldest span when
+ * the ring is full.  Spans without hints cannot be attributed to a
+ * request and are dropped.
+ */
+void PINT_req_trace_record(enum PVFS_event_trace_kind kind,
+                           PVFS_hint hints,
+                           PVFS_time start_us,
+                           PVFS_time end_us)
+{
+    struct PINT_req_trace_rec rec;
+
+    if (!PINT_req_trace_active || !hints)
+    {
+        return;
+    }
+
+    rec.start_us = start_us;
+    rec.dur_us = (end_us > start_us) ? (uint32_t)(end_us - start_us) : 0;
+    rec.request_id = PINT_HINT_GET_REQUEST_ID(hints);
+    rec.client_id = PINT_HINT_GET_CLIENT_ID(hints);
+    rec.kind = kind;
+    rec.op = PINT_HINT_GET_OP_ID(hints);
+
+    gen_mutex_lock(&trace_mutex);
+    if (trace_ring)
+    {
+        trace_ring[trace_ring_next % trace_ring_size] = rec;
+        trace_ring_next++;
+    }
+    gen_mutex_unlock(&trace_mutex);
+}
+
+/* PINT_req_trace_fetch()
+ *
+ * copies up to event_count of the most recent spans, oldest first, into
+ * event_array.  Unused slots are marked with PVFS_EVENT_FLAG_INVALID.
+ *
+ * returns the number of valid spans copied
+ */
+int PINT_req_trace_fetch(struct PVFS_mgmt_event *event_array,
+                         int event_count)
+{
+    struct PINT_req_trace_rec *rec;
+    uint64_t first;
+    int avail;
+    int i;
+
+    memset(event_array, 0, event_count * sizeof(struct PVFS_mgmt_event));
+
+    gen_mutex_lock(&trace_mutex);
+    avail = (trace_ring_next < trace_ring_size) ?
+        (int)trace_ring_next : (int)trace_ring_size;
+    if (avail > event_count)
+    {
+        avail = event_count;
+    }
+    first = trace_ring_next - avail;
+
+    for (i = 0; i < avail; i++)
+    {
+        rec = &trace_ring[(first + i) % trace_ring_size];
+        event_array[i].api = rec->kind;
+        event_array[i].operation = rec->op;
+        event_array[i].value = rec->dur_us;
+        event_array[i].id =
+            ((PVFS_id_gen_t)rec->client_id << 32) | rec->request_id;
+        event_array[i].flags = PVFS_EVENT_FLAG_START | PVFS_EVENT_FLAG_END;
+        event_array[i].tv_sec = (int32_t)(rec->start_us / 1000000);
+        event_array[i].tv_usec = (int32_t)(rec->start_us % 1000000);
+    }
+    gen_mutex_unlock(&trace_mutex);
+
+    for (i = avail; i < event_count; i++)
+    {
+        event_array[i].flags = PVFS_EVENT_FLAG_INVALID;
+    }
+
+    return avail;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
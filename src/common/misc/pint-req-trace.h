@@ -0,0 +1,65 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Per-request latency tracing.
+ *
+ * Spans (start, duration) are recorded into a fixed size binary ring
+ * buffer, keyed on the client id and request id that the client carries
+ * in the request hints.  The server records a span for the lifetime of
+ * each request, for every job posted on its behalf (request scheduler,
+ * BMI, trove, flow) and for the final response.  The most recent spans
+ * can be retrieved remotely with the mgmt_event_mon request.
+ */
+
+#ifndef __PINT_REQ_TRACE_H
+#define __PINT_REQ_TRACE_H
+
+#include "pvfs2-types.h"
+#include "pvfs2-hint.h"
+#include "pvfs2-event.h"
+
+struct PVFS_mgmt_event;
+
+/* non-zero when the trace buffer has been allocated */
+extern int PINT_req_trace_active;
+
+int PINT_req_trace_init(int entry_count);
+void PINT_req_trace_finalize(void);
+
+PVFS_time PINT_req_trace_now(void);
+
+void PINT_req_trace_record(enum PVFS_event_trace_kind kind,
+                           PVFS_hint hints,
+                           PVFS_time start_us,
+                           PVFS_time end_us);
+
+int PINT_req_trace_fetch(struct PVFS_mgmt_event *event_array,
+                         int event_count);
+
+/* returns a start timestamp, or zero if tracing is disabled */
+#define PINT_REQ_TRACE_START() \
+    (PINT_req_trace_active ? PINT_req_trace_now() : 0)
+
+/* records a span begun with PINT_REQ_TRACE_START() */
+#define PINT_REQ_TRACE_END(__kind, __hints, __start)                     \
+do {                                                                     \
+    if (PINT_req_trace_active && (__start))                              \
+    {                                                                    \
+        PINT_req_trace_record((__kind), (__hints), (__start),            \
+                              PINT_req_trace_now());                     \
+    }                                                                    \
+} while (0)
+
+#endif /* __PINT_REQ_TRACE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -374,6 +374,34 @@ int PINT_copy_object_attr(PVFS_object_attr *dest, PVFS_object_attr *src)
                 }
                 dest->u.meta.dist_size = src->u.meta.dist_size;
             }
+
+            if(src->mask & PVFS_ATTR_META_INLINE_DATA)
+            {
+                if ((dest->mask & PVFS_ATTR_META_INLINE_DATA) &&
+                    dest->u.meta.inline_data)
+                {
+                    free(dest->u.meta.inline_data);
+                    dest->u.meta.inline_data = NULL;
+                }
+                if (src->u.meta.inline_size)
+                {
+                    dest->u.meta.inline_data = malloc(src->u.meta.inline_size);
+                    if (!dest->u.meta.inline_data)
+                    {
+                        return ret;
+                    }
+                    memcpy(dest->u.meta.inline_data,
+                           src->u.meta.inline_data, src->u.meta.inline_size);
+                }
+                dest->u.meta.inline_size = src->u.meta.inline_size;
+            }
+
+            if(src->mask & PVFS_ATTR_META_SIZE)
+            {
+                dest->u.meta.cached_size = src->u.meta.cached_size;
+                dest->u.meta.cached_size_version =
+                    src->u.meta.cached_size_version;
+            }
             memcpy(&dest->u.meta.hint, &src->u.meta.hint, sizeof(dest->u.meta.hint));
         }
 
@@ -449,6 +477,15 @@ void PINT_free_object_attr(PVFS_object_attr *attr)
                 attr->u.meta.dist = NULL;
             }
         }
+        if (attr->mask & PVFS_ATTR_META_INLINE_DATA)
+        {
+            if (attr->u.meta.inline_data)
+            {
+                free(attr->u.meta.inline_data);
+                attr->u.meta.inline_data = NULL;
+            }
+            attr->u.meta.inline_size = 0;
+        }
         if (attr->mask & PVFS_ATTR_SYMLNK_TARGET)
         {
             if ((attr->u.sym.target_path_len > 0) &&
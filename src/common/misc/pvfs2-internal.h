@@ -162,6 +162,14 @@
 #define DIST_DIRDATA_BITMAP_KEYSTR    "/ddb\0"
 #define DIST_DIRDATA_BITMAP_KEYLEN    5
 
+/* contents of a tiny file, stored on its datafile in place of a bstream */
+#define DATAFILE_INLINE_KEYSTR        "/di\0"
+#define DATAFILE_INLINE_KEYLEN        4
+
+/* logical size of a striped file, stored on its metafile */
+#define METAFILE_SIZE_KEYSTR          "/sz\0"
+#define METAFILE_SIZE_KEYLEN          4
+
 /* Optional xattrs have "user.pvfs2." as a prefix */
 #define SPECIAL_PREFIX                 "user.pvfs2."
 
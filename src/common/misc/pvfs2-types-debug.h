@@ -60,6 +60,8 @@ static inline void PINT_attrmask_print(int debug, uint32_t attrmask)
     if (attrmask & PVFS_ATTR_META_DIST) gossip_debug(debug, "\tPVFS_ATTR_META_DIST\n");
     if (attrmask & PVFS_ATTR_META_DFILES) gossip_debug(debug, "\tPVFS_ATTR_META_DFILES\n");
     if (attrmask & PVFS_ATTR_META_MIRROR_DFILES) gossip_debug(debug, "\tPVFS_ATTR_META_MIRROR_DFILES\n");
+    if (attrmask & PVFS_ATTR_META_INLINE_DATA) gossip_debug(debug, "\tPVFS_ATTR_META_INLINE_DATA\n");
+    if (attrmask & PVFS_ATTR_META_SIZE) gossip_debug(debug, "\tPVFS_ATTR_META_SIZE\n");
     if (attrmask & PVFS_ATTR_DATA_SIZE) gossip_debug(debug, "\tPVFS_ATTR_DATA_SIZE\n");
     if (attrmask & PVFS_ATTR_SYMLNK_TARGET) gossip_debug(debug, "\tPVFS_ATTR_SYMLINK_TARGET\n");
     if (attrmask & PVFS_ATTR_DIR_DIRENT_COUNT) gossip_debug(debug, "\tPVFS_ATTR_DIR_DIRENT_COUNT\n");
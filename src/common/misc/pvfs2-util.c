@@ -17,6 +17,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <errno.h>
@@ -46,6 +47,8 @@
 
 
 #ifdef ENABLE_SECURITY_MODE
+#include "client-gencred.h"
+
 void debug_gencred(char *args[]);
 #endif
 
@@ -118,7 +121,56 @@ static int parse_encoding_string(const char *cp,
 static int parse_num_dfiles_string(const char* cp, int* num_dfiles);
 static int parse_bmi_opts_string(char *cp, char **bmi_opts);
 
-#ifndef ENABLE_SECURITY_MODE
+/* credentials generated by PVFS_util_gen_credential are kept and handed
+   out again for the same user, group, timeout and key until they have
+   less than an eighth of their lifetime (and at least
+   PINT_CREDENTIAL_CACHE_MIN_LEFT seconds) left.  Signed credentials are
+   also kept in a file per caller in a private directory of the user, so
+   that short-lived processes share them */
+#define PINT_CREDENTIAL_CACHE_SIZE      64
+#define PINT_CREDENTIAL_CACHE_MIN_LEFT  10
+#define PINT_CREDENTIAL_FILE_MAGIC      0x50564343
+#define PINT_CREDENTIAL_FILE_VERSION    1
+#define PINT_CREDENTIAL_FILE_HEADER     16
+#define PINT_CREDENTIAL_KEY_MAX         (3 * PATH_MAX)
+
+struct PINT_credential_cache_entry
+{
+    int in_use;
+    uid_t caller_uid;
+    gid_t caller_gid;
+    char *user;
+    char *group;
+    unsigned int timeout;
+    char *keypath;
+    char *certpath;
+    PVFS_credential cred;
+};
+
+static struct PINT_credential_cache_entry
+    s_credential_cache[PINT_CREDENTIAL_CACHE_SIZE];
+static gen_mutex_t s_credential_cache_mutex = GEN_MUTEX_INITIALIZER;
+
+static int PINT_credential_cache_lookup(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    PVFS_credential *cred);
+static void PINT_credential_cache_insert(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    const PVFS_credential *cred);
+#ifdef ENABLE_SECURITY_MODE
+static int PINT_credential_file_lookup(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    PVFS_credential *cred);
+static void PINT_credential_file_insert(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    const PVFS_credential *cred);
+#endif
+
+#ifdef ENABLE_SECURITY_MODE
+static int PINT_gen_signed_credential(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    PVFS_credential *cred);
+#else
 static int PINT_is_idnum(const char *str);
 
 static int PINT_gen_unsigned_credential(const char *user, const char *group,
@@ -225,18 +277,11 @@ void debug_gencred(char *args[])
     free(str);
 }
 
-/* PVFS_util_gen_credential
+/* PINT_gen_credential_exec
  * 
  * Generate signed credential object using external app pvfs2-gencred.
- *
- * user - string representation of numeric uid
- * group - string representation of numeric gid
- * timeout - in seconds; value of 0 will result in default (1 hour)
- * keypath - path to client private key file
- * certpath - path to client certificate file
- * cred - the credential object
  */
-int PVFS_util_gen_credential(const char *user, const char *group,
+static int PINT_gen_credential_exec(const char *user, const char *group,
     unsigned int timeout, const char *keypath, const char *certpath,
     PVFS_credential *cred)
 {
@@ -245,18 +290,6 @@ int PVFS_util_gen_credential(const char *user, const char *group,
     int filedes[2], errordes[2];
     int ret;
 
-    if (!keypath && getenv("PVFS2KEY_FILE"))
-    {
-        keypath = getenv("PVFS2KEY_FILE");
-    }
-
-#ifdef ENABLE_SECURITY_CERT
-    if (!certpath && getenv("PVFS2CERT_FILE"))
-    {
-        certpath = getenv("PVFS2CERT_FILE");
-    }
-#endif
-
     memset(&newsa, 0, sizeof(newsa));
     newsa.sa_handler = SIG_DFL;
     sigaction(SIGCHLD, &newsa, &oldsa);
@@ -422,6 +455,35 @@ int PVFS_util_gen_credential(const char *user, const char *group,
 
     return ret;
 }
+
+/* PINT_gen_signed_credential
+ *
+ * Generate signed credential object, in-process when the calling user
+ * may sign it and can read the key, otherwise with pvfs2-gencred.
+ * Setting PVFS2_GENCRED_EXEC always uses pvfs2-gencred.
+ */
+static int PINT_gen_signed_credential(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    PVFS_credential *cred)
+{
+    int ret;
+
+    if (getenv("PVFS2_GENCRED_EXEC") == NULL)
+    {
+        ret = PINT_client_gencred_sign(user, group, timeout, keypath,
+                                       certpath, cred);
+        if (ret == 0)
+        {
+            return 0;
+        }
+
+        gossip_debug(GOSSIP_SECURITY_DEBUG, "In-process credential "
+                     "generation failed (%d); using pvfs2-gencred\n", ret);
+    }
+
+    return PINT_gen_credential_exec(user, group, timeout, keypath, certpath,
+                                    cred);
+}
 #else /* ENABLE_SECURITY_MODE */
 
 /* This macro will call a user info function, e.g. getpwuid_r, and 
@@ -645,14 +707,483 @@ pvfs2_util_gen_cred:
     return 0;
 }
 
-/*
- * This function generates an unsigned credential for use when
- * robust security is disabled.
+#endif /* ENABLE_SECURITY_MODE */
+
+/* compare two optional strings */
+static int PINT_credential_cache_streq(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL)
+    {
+        return (a == b);
+    }
+    return (strcmp(a, b) == 0);
+}
+
+static struct PINT_credential_cache_entry *PINT_credential_cache_find(
+    const char *user, const char *group, unsigned int timeout,
+    const char *keypath, const char *certpath)
+{
+    uid_t uid = getuid();
+    gid_t gid = getgid();
+    int i;
+
+    for (i = 0; i < PINT_CREDENTIAL_CACHE_SIZE; i++)
+    {
+        struct PINT_credential_cache_entry *entry = &s_credential_cache[i];
+
+        if (entry->in_use &&
+            entry->caller_uid == uid &&
+            entry->caller_gid == gid &&
+            entry->timeout == timeout &&
+            PINT_credential_cache_streq(entry->user, user) &&
+            PINT_credential_cache_streq(entry->group, group) &&
+            PINT_credential_cache_streq(entry->keypath, keypath) &&
+            PINT_credential_cache_streq(entry->certpath, certpath))
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void PINT_credential_cache_clear(
+    struct PINT_credential_cache_entry *entry)
+{
+    free(entry->user);
+    free(entry->group);
+    free(entry->keypath);
+    free(entry->certpath);
+    if (entry->in_use)
+    {
+        PINT_cleanup_credential(&entry->cred);
+    }
+    memset(entry, 0, sizeof(*entry));
+}
+
+/* PINT_credential_cache_usable
+ *
+ * whether a credential generated with the given timeout is far enough
+ * from expiry to be handed out again
+ */
+static int PINT_credential_cache_usable(const PVFS_credential *cred,
+                                        unsigned int timeout)
+{
+    PVFS_time left = cred->timeout - PINT_util_get_current_time();
+
+    return (left > (PVFS_time) (timeout / 8) &&
+            left > PINT_CREDENTIAL_CACHE_MIN_LEFT);
+}
+
+/* PINT_credential_cache_lookup
+ *
+ * Copies a cached credential that is not yet near expiry into cred.
+ *
+ * returns 0 on a hit, -PVFS_ENOENT otherwise.
+ */
+static int PINT_credential_cache_lookup(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    PVFS_credential *cred)
+{
+    struct PINT_credential_cache_entry *entry;
+    int ret = -PVFS_ENOENT;
+
+    gen_mutex_lock(&s_credential_cache_mutex);
+
+    entry = PINT_credential_cache_find(user, group, timeout, keypath,
+                                       certpath);
+    if (entry != NULL)
+    {
+        if (PINT_credential_cache_usable(&entry->cred, timeout))
+        {
+            ret = PINT_copy_credential(&entry->cred, cred);
+        }
+        else
+        {
+            PINT_credential_cache_clear(entry);
+        }
+    }
+
+    gen_mutex_unlock(&s_credential_cache_mutex);
+
+    return ret;
+}
+
+/* PINT_credential_cache_insert
+ *
+ * Keeps a copy of a newly generated credential, replacing an older one
+ * for the same arguments or else the entry closest to expiry.
+ */
+static void PINT_credential_cache_insert(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    const PVFS_credential *cred)
+{
+    struct PINT_credential_cache_entry *entry;
+    int i;
+
+    gen_mutex_lock(&s_credential_cache_mutex);
+
+    entry = PINT_credential_cache_find(user, group, timeout, keypath,
+                                       certpath);
+    for (i = 0; entry == NULL && i < PINT_CREDENTIAL_CACHE_SIZE; i++)
+    {
+        if (!s_credential_cache[i].in_use)
+        {
+            entry = &s_credential_cache[i];
+        }
+    }
+    if (entry == NULL)
+    {
+        entry = &s_credential_cache[0];
+        for (i = 1; i < PINT_CREDENTIAL_CACHE_SIZE; i++)
+        {
+            if (s_credential_cache[i].cred.timeout < entry->cred.timeout)
+            {
+                entry = &s_credential_cache[i];
+            }
+        }
+    }
+
+    PINT_credential_cache_clear(entry);
+
+    entry->caller_uid = getuid();
+    entry->caller_gid = getgid();
+    entry->timeout = timeout;
+    entry->user = user ? strdup(user) : NULL;
+    entry->group = group ? strdup(group) : NULL;
+    entry->keypath = keypath ? strdup(keypath) : NULL;
+    entry->certpath = certpath ? strdup(certpath) : NULL;
+
+    if ((user && !entry->user) || (group && !entry->group) ||
+        (keypath && !entry->keypath) || (certpath && !entry->certpath) ||
+        PINT_copy_credential(cred, &entry->cred) != 0)
+    {
+        PINT_credential_cache_clear(entry);
+    }
+    else
+    {
+        entry->in_use = 1;
+    }
+
+    gen_mutex_unlock(&s_credential_cache_mutex);
+}
+
+#ifdef ENABLE_SECURITY_MODE
+
+/* PINT_credential_file_dir
+ *
+ * Finds the directory for the caller's credential files:
+ * PVFS2_CREDENTIAL_CACHE_DIR, else pvfs2 in XDG_RUNTIME_DIR, else
+ * /tmp/pvfs2-cred-<uid>.  It is created if missing and only used if it
+ * is a directory owned by the caller that nobody else can access.
+ *
+ * returns 0 on success, -PVFS_EACCES or -PVFS_ENAMETOOLONG otherwise.
+ */
+static int PINT_credential_file_dir(char *dir, int len)
+{
+    const char *env;
+    struct stat st;
+    int ret;
+
+    if ((env = getenv("PVFS2_CREDENTIAL_CACHE_DIR")) != NULL)
+    {
+        ret = snprintf(dir, len, "%s", env);
+    }
+    else if ((env = getenv("XDG_RUNTIME_DIR")) != NULL)
+    {
+        ret = snprintf(dir, len, "%s/pvfs2", env);
+    }
+    else
+    {
+        ret = snprintf(dir, len, "/tmp/pvfs2-cred-%u",
+                       (unsigned int) geteuid());
+    }
+    if (ret < 0 || ret >= len)
+    {
+        return -PVFS_ENAMETOOLONG;
+    }
+
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+    {
+        return -PVFS_EACCES;
+    }
+    if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & 077) != 0)
+    {
+        return -PVFS_EACCES;
+    }
+
+    return 0;
+}
+
+/* PINT_credential_file_key
+ *
+ * Describes the caller and the arguments of a credential.  Key and
+ * certificate files, including the default key of key mode, are
+ * identified by inode and modification time as well, so that credentials
+ * signed with a replaced key are not reused.
+ */
+static int PINT_credential_file_key(char *key, int len, const char *user,
+    const char *group, unsigned int timeout, const char *keypath,
+    const char *certpath)
+{
+    struct stat kst, cst;
+    int ret;
+
+    memset(&kst, 0, sizeof(kst));
+    memset(&cst, 0, sizeof(cst));
+    if (keypath)
+    {
+        stat(keypath, &kst);
+    }
+#ifdef ENABLE_SECURITY_KEY
+    else
+    {
+        stat(PVFS2_DEFAULT_CREDENTIAL_KEYPATH, &kst);
+    }
+#endif
+    if (certpath)
+    {
+        stat(certpath, &cst);
+    }
+
+    ret = snprintf(key, len,
+                   "%u:%u:%u:%s%s:%s%s:%s%s@%llu.%lld:%s%s@%llu.%lld",
+                   (unsigned int) getuid(), (unsigned int) getgid(), timeout,
+                   (user ? "=" : ""), (user ? user : ""),
+                   (group ? "=" : ""), (group ? group : ""),
+                   (keypath ? "=" : ""), (keypath ? keypath : ""),
+                   llu(kst.st_ino), lld(kst.st_mtime),
+                   (certpath ? "=" : ""), (certpath ? certpath : ""),
+                   llu(cst.st_ino), lld(cst.st_mtime));
+    if (ret < 0 || ret >= len)
+    {
+        return -PVFS_ENAMETOOLONG;
+    }
+    return ret;
+}
+
+/* PINT_credential_file_path
+ *
+ * Fills in the directory and the file name, a hash of the key, for a
+ * credential file.
+ */
+static int PINT_credential_file_path(char *path, int len, const char *key)
+{
+    char dir[PATH_MAX];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const char *c;
+    int ret;
+
+    ret = PINT_credential_file_dir(dir, sizeof(dir));
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    /* FNV-1a; the key itself is checked when the file is read */
+    for (c = key; *c; c++)
+    {
+        hash = (hash ^ (unsigned char) *c) * 0x100000001b3ULL;
+    }
+
+    ret = snprintf(path, len, "%s/cred-%016llx", dir, llu(hash));
+    if (ret < 0 || ret >= len)
+    {
+        return -PVFS_ENAMETOOLONG;
+    }
+    return 0;
+}
+
+/* PINT_credential_file_lookup
+ *
+ * Reads a signed credential that another process of the caller stored
+ * for the same arguments.  The file holds a header, the key and the
+ * credential in its wire encoding.  Files that are damaged or near
+ * expiry are removed.
+ *
+ * returns 0 on a hit, -PVFS_ENOENT otherwise.
+ */
+static int PINT_credential_file_lookup(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    PVFS_credential *cred)
+{
+    char key[PINT_CREDENTIAL_KEY_MAX], path[PATH_MAX];
+    char *buf = NULL, *ptr;
+    uint32_t magic, version, key_len, cred_len;
+    int buf_size, key_size, fd, usable = 0;
+    ssize_t total = 0, cnt;
+    PVFS_credential tmp;
+    struct stat st;
+
+    key_size = PINT_credential_file_key(key, sizeof(key), user, group,
+                                        timeout, keypath, certpath);
+    if (key_size < 0 ||
+        PINT_credential_file_path(path, sizeof(path), key) != 0)
+    {
+        return -PVFS_ENOENT;
+    }
+
+    fd = open(path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0)
+    {
+        return -PVFS_ENOENT;
+    }
+
+    /* room for the largest credential, zeroed like the gencred pipe
+       buffer */
+    buf_size = PINT_CREDENTIAL_FILE_HEADER + roundup8(key_size) +
+        sizeof(PVFS_credential) + extra_size_PVFS_credential;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & 077) != 0 ||
+        st.st_size > buf_size ||
+        (buf = calloc(1, buf_size)) == NULL)
+    {
+        close(fd);
+        return -PVFS_ENOENT;
+    }
+
+    do
+    {
+        do
+        {
+            cnt = read(fd, buf + total, buf_size - total);
+        } while (cnt == -1 && errno == EINTR);
+        total += (cnt > 0 ? cnt : 0);
+    } while (cnt > 0 && total < buf_size);
+    close(fd);
+
+    ptr = buf;
+    if (cnt >= 0 && total >= PINT_CREDENTIAL_FILE_HEADER)
+    {
+        decode_uint32_t(&ptr, &magic);
+        decode_uint32_t(&ptr, &version);
+        decode_uint32_t(&ptr, &key_len);
+        decode_uint32_t(&ptr, &cred_len);
+        if (magic == PINT_CREDENTIAL_FILE_MAGIC &&
+            version == PINT_CREDENTIAL_FILE_VERSION &&
+            key_len == key_size &&
+            total == PINT_CREDENTIAL_FILE_HEADER + roundup8(key_len) +
+                     cred_len &&
+            memcmp(ptr, key, key_len) == 0)
+        {
+            ptr += roundup8(key_len);
+            decode_PVFS_credential(&ptr, &tmp);
+            usable = (ptr <= buf + total &&
+                      tmp.num_groups <= PVFS_SYS_LIMIT_GROUPS &&
+                      tmp.sig_size <= PVFS_SYS_LIMIT_SIGNATURE &&
+                      !IS_UNSIGNED_CRED(&tmp) &&
+                      PINT_credential_cache_usable(&tmp, timeout) &&
+                      PINT_copy_credential(&tmp, cred) == 0);
+
+            /* in the buffer */
+            tmp.issuer = NULL;
+            PINT_cleanup_credential(&tmp);
+        }
+    }
+    free(buf);
+
+    if (!usable)
+    {
+        unlink(path);
+        return -PVFS_ENOENT;
+    }
+    return 0;
+}
+
+/* PINT_credential_file_insert
+ *
+ * Stores a signed credential for other processes of the caller.  The
+ * file is written under a temporary name and renamed into place, so
+ * readers see either the old or the new credential.  Failures only
+ * mean the next process signs its own.
+ */
+static void PINT_credential_file_insert(const char *user, const char *group,
+    unsigned int timeout, const char *keypath, const char *certpath,
+    const PVFS_credential *cred)
+{
+    char key[PINT_CREDENTIAL_KEY_MAX], path[PATH_MAX];
+    char tmp_path[PATH_MAX + 8];
+    char *buf, *ptr;
+    int buf_size, key_size, fd, ok;
+    uint32_t magic = PINT_CREDENTIAL_FILE_MAGIC;
+    uint32_t version = PINT_CREDENTIAL_FILE_VERSION;
+    uint32_t key_len, cred_len;
+
+    key_size = PINT_credential_file_key(key, sizeof(key), user, group,
+                                        timeout, keypath, certpath);
+    if (key_size < 0 ||
+        PINT_credential_file_path(path, sizeof(path), key) != 0)
+    {
+        return;
+    }
+
+    buf_size = PINT_CREDENTIAL_FILE_HEADER + roundup8(key_size) +
+        sizeof(PVFS_credential) + extra_size_PVFS_credential;
+    buf = calloc(1, buf_size);
+    if (buf == NULL)
+    {
+        return;
+    }
+
+    /* the credential first, to learn its encoded size */
+    ptr = buf + PINT_CREDENTIAL_FILE_HEADER + roundup8(key_size);
+    encode_PVFS_credential(&ptr, cred);
+    cred_len = ptr - (buf + PINT_CREDENTIAL_FILE_HEADER +
+                      roundup8(key_size));
+
+    ptr = buf;
+    key_len = key_size;
+    encode_uint32_t(&ptr, &magic);
+    encode_uint32_t(&ptr, &version);
+    encode_uint32_t(&ptr, &key_len);
+    encode_uint32_t(&ptr, &cred_len);
+    memcpy(ptr, key, key_size);
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+    fd = mkstemp(tmp_path);
+    if (fd < 0)
+    {
+        free(buf);
+        return;
+    }
+    ok = (fchmod(fd, 0600) == 0 &&
+          write(fd, buf, PINT_CREDENTIAL_FILE_HEADER + roundup8(key_size) +
+                cred_len) ==
+          PINT_CREDENTIAL_FILE_HEADER + roundup8(key_size) + cred_len);
+    ok = (close(fd) == 0 && ok);
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        unlink(tmp_path);
+    }
+    free(buf);
+}
+
+#endif /* ENABLE_SECURITY_MODE */
+
+/* PVFS_util_gen_credential
+ * 
+ * Generate a credential object: signed, in security mode, either
+ * in-process or by the external app pvfs2-gencred; unsigned otherwise.
+ * Credentials are shared between calls for the same arguments until near
+ * expiry, and signed ones also between the processes of a user (see
+ * PINT_credential_file_dir); setting PVFS2_CREDENTIAL_CACHE=0 generates
+ * a new one each time.
+ *
+ * user - string representation of numeric uid
+ * group - string representation of numeric gid
+ * timeout - in seconds; value of 0 will result in default (1 hour)
+ * keypath - path to client private key file
+ * certpath - path to client certificate file
+ * cred - the credential object
  */
 int PVFS_util_gen_credential(const char *user, const char *group,
     unsigned int timeout, const char *keypath, const char *certpath,
     PVFS_credential *cred)
 {
+    const char *cache_env;
+    int use_cache, ret;
+
     if (cred == NULL)
     {
         gossip_lerr("PVFS_util_gen_credential: credential is null\n");
@@ -661,10 +1192,70 @@ int PVFS_util_gen_credential(const char *user, const char *group,
 
     memset(cred, 0, sizeof(*cred));
 
-    return PINT_gen_unsigned_credential(user, group, timeout, cred);
-}
+    if (timeout == 0)
+    {
+        timeout = PVFS2_DEFAULT_CREDENTIAL_TIMEOUT;
+    }
+
+#ifdef ENABLE_SECURITY_MODE
+    if (!keypath && getenv("PVFS2KEY_FILE"))
+    {
+        keypath = getenv("PVFS2KEY_FILE");
+    }
+
+#ifdef ENABLE_SECURITY_CERT
+    if (!certpath && getenv("PVFS2CERT_FILE"))
+    {
+        certpath = getenv("PVFS2CERT_FILE");
+    }
+#endif
 #endif /* ENABLE_SECURITY_MODE */
 
+    cache_env = getenv("PVFS2_CREDENTIAL_CACHE");
+    use_cache = (cache_env == NULL || atoi(cache_env) != 0);
+
+    if (use_cache &&
+        PINT_credential_cache_lookup(user, group, timeout, keypath, certpath,
+                                     cred) == 0)
+    {
+        return 0;
+    }
+
+#ifdef ENABLE_SECURITY_MODE
+    if (use_cache &&
+        PINT_credential_file_lookup(user, group, timeout, keypath, certpath,
+                                    cred) == 0)
+    {
+        PINT_credential_cache_insert(user, group, timeout, keypath, certpath,
+                                     cred);
+        return 0;
+    }
+
+    ret = PINT_gen_signed_credential(user, group, timeout, keypath,
+                                     certpath, cred);
+    /* an unsigned credential from pvfs2-gencred reports a problem that
+       should not be remembered */
+    if (ret == 0 && IS_UNSIGNED_CRED(cred))
+    {
+        use_cache = 0;
+    }
+#else
+    ret = PINT_gen_unsigned_credential(user, group, timeout, cred);
+#endif
+
+    if (ret == 0 && use_cache)
+    {
+        PINT_credential_cache_insert(user, group, timeout, keypath, certpath,
+                                     cred);
+#ifdef ENABLE_SECURITY_MODE
+        PINT_credential_file_insert(user, group, timeout, keypath, certpath,
+                                    cred);
+#endif
+    }
+
+    return ret;
+}
+
 #define PINT_REFRESH_CREDENTIAL_TIME    3
 /*
  * This function checks to see if the credential is still valid
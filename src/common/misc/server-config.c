@@ -35,6 +35,7 @@
 #include "extent-utils.h"
 #include "mkspace.h"
 #include "pint-distribution.h"
+#include "dist-dir-utils.h"
 #include "pvfs2-server.h"
 
 #ifdef HAVE_OPENSSL
@@ -44,6 +45,8 @@
 static const char * replace_old_keystring(const char * oldkey);
 
 static DOTCONF_CB(get_logstamp);
+static DOTCONF_CB(get_log_buffer_size);
+static DOTCONF_CB(get_log_rate_limit);
 static DOTCONF_CB(get_storage_path);
 static DOTCONF_CB(get_data_path);
 static DOTCONF_CB(get_meta_path);
@@ -104,10 +107,18 @@ static DOTCONF_CB(get_flow_buffers_per_flow);
 static DOTCONF_CB(get_attr_cache_keywords_list);
 static DOTCONF_CB(get_attr_cache_size);
 static DOTCONF_CB(get_attr_cache_max_num_elems);
+static DOTCONF_CB(get_attr_cache_memory_mb);
 static DOTCONF_CB(get_trove_sync_meta);
 static DOTCONF_CB(get_trove_sync_data);
 static DOTCONF_CB(get_file_stuffing);
+static DOTCONF_CB(get_async_datafile_removal);
+static DOTCONF_CB(get_datafile_reclaim_batch_size);
+static DOTCONF_CB(get_small_io_size);
+static DOTCONF_CB(get_inline_data_size);
 static DOTCONF_CB(get_trove_max_concurrent_io);
+static DOTCONF_CB(get_data_cache_size_mb);
+static DOTCONF_CB(get_data_cache_block_size);
+static DOTCONF_CB(get_request_trace_entries);
 /* Berkeley DB */
 static DOTCONF_CB(get_db_cache_size_bytes);
 static DOTCONF_CB(get_db_cache_type);
@@ -133,6 +144,8 @@ static DOTCONF_CB(get_small_file_size);
 static DOTCONF_CB(directio_thread_num);
 static DOTCONF_CB(directio_ops_per_queue);
 static DOTCONF_CB(directio_timeout);
+static DOTCONF_CB(trove_readahead_size);
+static DOTCONF_CB(trove_readahead_buffers);
 
 static DOTCONF_CB(get_key_store);
 static DOTCONF_CB(get_server_key);
@@ -141,6 +154,7 @@ static DOTCONF_CB(get_capability_timeout);
 static DOTCONF_CB(get_turn_off_timeouts);
 static DOTCONF_CB(get_credcache_timeout);
 static DOTCONF_CB(get_capcache_timeout);
+static DOTCONF_CB(get_capcache_size_mb);
 static DOTCONF_CB(get_certcache_timeout);
 static DOTCONF_CB(get_ca_file);
 static DOTCONF_CB(get_user_cert_dn);
@@ -164,6 +178,8 @@ static DOTCONF_CB(tree_threshold);
 static DOTCONF_CB(distr_dir_servers_initial);
 static DOTCONF_CB(distr_dir_servers_max);
 static DOTCONF_CB(distr_dir_split_size);
+static DOTCONF_CB(distr_dir_hash_function);
+static DOTCONF_CB(distr_dir_servers_grow_max);
 
 static FUNC_ERRORHANDLER(errorhandler);
 const char *contextchecker(command_t *cmd, unsigned long mask);
@@ -358,6 +374,13 @@ static const configoption_t options[] =
     {"CapabilityCacheTimeoutSecs", ARG_INT, get_capcache_timeout, NULL,
         CTX_SECURITY, "600"},
 
+    /* Memory, in MB, the server-side capability cache may use for
+     * verified and signed capabilities; least recently used entries are
+     * dropped beyond it.
+     */
+    {"CapabilityCacheSizeMB", ARG_INT, get_capcache_size_mb, NULL,
+        CTX_SECURITY, "64"},
+
     /* Server-side Certificate cache timeout in seconds */
     {"CertificateCacheTimeoutSecs", ARG_INT, get_certcache_timeout, NULL,
         CTX_SECURITY, "3600"},
@@ -681,6 +704,23 @@ static const configoption_t options[] =
     {"TroveMaxConcurrentIO", ARG_INT, get_trove_max_concurrent_io, NULL,
         CTX_DEFAULTS|CTX_SERVER_OPTIONS,"16"},
 
+    /* Size in megabytes of the server data block cache.  When non-zero,
+     * bytestream data read by I/O and small I/O requests is kept in
+     * memory and later reads of the same blocks are served without
+     * going to Trove.  Writes, truncates and removes invalidate the
+     * affected blocks.  The cache uses the 2Q replacement policy, so a
+     * single sequential pass over a large file does not evict blocks
+     * that are read repeatedly.  The default of 0 disables the cache.
+     */
+    {"DataCacheSizeMB", ARG_INT, get_data_cache_size_mb, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
+    /* Size in bytes of each block held in the data block cache.  Must
+     * be a power of two between 4096 and 4194304.
+     */
+    {"DataCacheBlockSize", ARG_INT, get_data_cache_block_size, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"65536"},
+
     /* The gossip interface in OrangeFS allows users to specify different
      * levels of logging for the OrangeFS server.  The output of these
      * different log levels is written to a file, which is specified in
@@ -726,6 +766,16 @@ static const configoption_t options[] =
     {"EnableTracing",ARG_STR, get_event_tracing,NULL,
         CTX_DEFAULTS|CTX_SERVER_OPTIONS,"no"},
 
+    /* Number of entries in the per-request latency trace buffer.  When
+     * non-zero, the server records how long each request spent in the
+     * request scheduler, in each BMI, trove and flow job, and sending its
+     * response, keyed on the client request id.  The most recent entries
+     * can be dumped with pvfs2-req-trace.  Each entry uses 24 bytes.
+     * The default of 0 disables request tracing.
+     */
+    {"RequestTraceEntries",ARG_INT, get_request_trace_entries,NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
     /* At startup each OrangeFS server allocates space for a set number
      * of incoming requests to prevent the allocation delay at the beginning
      * of each unexpected request.  This parameter specifies the number
@@ -868,6 +918,41 @@ static const configoption_t options[] =
     {"FileStuffing",ARG_STR, get_file_stuffing, NULL, 
         CTX_FILESYSTEM,"yes"},
 
+    /* Specifies if the metadata server should acknowledge a remove as
+     * soon as the metafile is gone, leaving the datafiles to be removed
+     * in the background in batches.  The datafile handles are kept in a
+     * persistent queue on the metadata server until they are reclaimed.
+     */
+    {"AsyncDatafileRemoval",ARG_STR, get_async_datafile_removal, NULL,
+        CTX_FILESYSTEM,"no"},
+
+    /* Maximum number of datafiles reclaimed per batch when
+     * <c>AsyncDatafileRemoval</c> is enabled.  Each batch is sent to a data
+     * server as a single request.
+     */
+    {"DatafileReclaimBatchSize",ARG_INT, get_datafile_reclaim_batch_size,
+        NULL, CTX_FILESYSTEM,"512"},
+
+    /* Largest amount of data, in bytes, that a client sends to or reads
+     * from one datafile by packing it in the request or response message
+     * (small I/O) instead of setting up a flow.  Each server connection
+     * is further limited by the unexpected message size of its BMI
+     * method.  Servers and clients of this release use a new protocol
+     * version and must be upgraded together; no value of this option
+     * lets them work with older ones.
+     */
+    {"SmallIOSize",ARG_INT, get_small_io_size, NULL,
+        CTX_FILESYSTEM,"16384"},
+
+    /* Files with a single datafile that are no larger than this many
+     * bytes keep their contents in a keyval next to the datafile instead
+     * of in a bstream, and stuffed files return it to readers with their
+     * attributes.  The data moves to the bstream as soon as the file
+     * grows past this size.  0 disables inline data.
+     */
+    {"InlineDataSize",ARG_INT, get_inline_data_size, NULL,
+        CTX_FILESYSTEM,"0"},
+
      /* This specifies the number of samples
       * that performance monitor should keep
       *
@@ -954,6 +1039,26 @@ static const configoption_t options[] =
     {"LogStamp",ARG_STR, get_logstamp,NULL,
         CTX_DEFAULTS|CTX_SERVER_OPTIONS,"usec"},
 
+    /* Size in bytes of the per-thread buffer used for debug logging.
+     * When non-zero, debug messages are copied into a buffer owned by
+     * the logging thread and written out in batches by a background
+     * thread, so that enabling EventLogging does not stall request
+     * processing on log file writes.  Messages are dropped (and the
+     * number dropped is logged) if a buffer fills up.  Error messages
+     * are always written immediately.  The default of 0 writes every
+     * message synchronously.
+     */
+    {"LogBufferSize",ARG_INT, get_log_buffer_size,NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
+    /* Maximum number of debug messages per second logged for each
+     * EventLogging mask.  Messages over the limit are discarded and a
+     * count of them is logged once per second.  The default of 0 does
+     * not limit logging.
+     */
+    {"LogRateLimit",ARG_INT, get_log_rate_limit,NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
     /* buffer size to use for bulk data transfers */
     {"FlowBufferSizeBytes", ARG_INT,
          get_flow_buffer_size_bytes, NULL, CTX_FILESYSTEM,"262144"},
@@ -1074,21 +1179,32 @@ static const configoption_t options[] =
         DIRECTORY_ENTRY_KEYSTR","SYMLINK_TARGET_KEYSTR},
     
     /* The attribute cache in the TROVE layer mentioned in the documentation
-     * for the AttrCacheKeywords option is managed as a hashtable.  The
-     * AttrCacheSize adjusts the number of buckets that this hashtable contains.
-     * This value can be adjusted for better performance.  A good hashtable
-     * size should always be a prime number.
+     * for the AttrCacheKeywords option is managed as a set of hashtables,
+     * one for each of its independently locked stripes.  The
+     * AttrCacheSize adjusts the total number of buckets over all of these
+     * hashtables.  The default of 0 sizes the hashtables from the memory
+     * limit set by AttrCacheMemoryMB.
      */
     {"AttrCacheSize",ARG_INT, get_attr_cache_size, NULL,
-        CTX_STORAGEHINTS,"511"},
+        CTX_STORAGEHINTS,"0"},
 
-    /* This option specifies the max cache size of the attribute cache 
-     * in the TROVE layer mentioned in the documentation
-     * for the AttrCacheKeywords option.  This value can be adjusted for
-     * better performance.
+    /* This option specifies the max number of entries in the attribute
+     * cache in the TROVE layer mentioned in the documentation
+     * for the AttrCacheKeywords option.  The default of 0 limits the
+     * cache by memory use (AttrCacheMemoryMB) only.
      */
     {"AttrCacheMaxNumElems",ARG_INT,get_attr_cache_max_num_elems,NULL,
-        CTX_STORAGEHINTS,"1024"},
+        CTX_STORAGEHINTS,"0"},
+
+    /* This option specifies the amount of memory, in megabytes, that the
+     * attribute cache in the TROVE layer may use for cached attributes
+     * and keyvals.  The default of 0 uses 1/64th of physical memory.
+     * New entries must be referenced a second time before they are
+     * protected from eviction, so a scan over many files only displaces
+     * other entries that were used once.
+     */
+    {"AttrCacheMemoryMB",ARG_INT,get_attr_cache_memory_mb,NULL,
+        CTX_STORAGEHINTS,"0"},
     
     /* The TroveSyncMeta option allows users to turn off metadata
      * synchronization with every metadata write.  This can greatly improve
@@ -1219,6 +1335,21 @@ static const configoption_t options[] =
     {"DirectIOTimeout", ARG_INT, directio_timeout, NULL,
         CTX_STORAGEHINTS, "1000"},
 
+    /* Specifies the largest readahead window, in bytes, kept in front of
+     * a client reading a datafile sequentially.  With the alt-aio and
+     * dbpf methods the window is passed to the kernel as a
+     * posix_fadvise() hint; with the directio method it is read into
+     * memory ahead of the flow.  Zero disables readahead.
+     */
+    {"TroveReadaheadSize", ARG_INT, trove_readahead_size, NULL,
+        CTX_STORAGEHINTS, "0"},
+
+    /* Specifies the number of 1 MiB buffers the directio method uses to
+     * hold readahead data.
+     */
+    {"TroveReadaheadBuffers", ARG_INT, trove_readahead_buffers, NULL,
+        CTX_STORAGEHINTS, "32"},
+
     /* Specifies the number of partitions to use for tree communication. */
     {"TreeWidth", ARG_INT, tree_width, NULL,
         CTX_FILESYSTEM, "2"},
@@ -1239,6 +1370,21 @@ static const configoption_t options[] =
     {"DistrDirSplitSize", ARG_INT, distr_dir_split_size, NULL,
         CTX_FILESYSTEM, "10000"},
 
+    /* Specifies the hash function used to place the entries of newly
+     * created directories on their dirdata servers: "md5" or "murmur3".
+     * The function is recorded in each directory, so changing this does
+     * not affect existing directories. */
+    {"DistrDirHashFunction", ARG_STR, distr_dir_hash_function, NULL,
+        CTX_FILESYSTEM, "murmur3"},
+
+    /* Specifies the number of servers a directory may grow to when a
+     * dirdata bucket is full and cannot be split further.  Growth adds
+     * servers that do not yet hold any of the directory's entries.  A
+     * value of 0 (the default) disables growth, limiting directories to
+     * the number of servers they were created with. */
+    {"DistrDirServersGrowMax", ARG_INT, distr_dir_servers_grow_max, NULL,
+        CTX_FILESYSTEM, "0"},
+
     LAST_OPTION
 };
 
@@ -1294,6 +1440,7 @@ int PINT_parse_config(struct server_configuration_s *config_obj,
     config_s->client_retry_limit = PVFS2_CLIENT_RETRY_LIMIT_DEFAULT;
     config_s->client_retry_delay_ms = PVFS2_CLIENT_RETRY_DELAY_MS_DEFAULT;
     config_s->trove_max_concurrent_io = 16;
+    config_s->data_cache_block_size = 65536;
     config_s->db_max_size = 536870912;
 
     if (cache_config_files(config_s, global_config_filename))
@@ -2811,6 +2958,24 @@ DOTCONF_CB(get_attr_cache_max_num_elems)
     return NULL;
 }
 
+DOTCONF_CB(get_attr_cache_memory_mb)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(cmd->data.value < 0)
+    {
+        return("AttrCacheMemoryMB must not be negative.\n");
+    }
+    fs_conf->attr_cache_memory_mb = (int)cmd->data.value;
+    return NULL;
+}
+
 DOTCONF_CB(get_file_stuffing)
 {
     struct filesystem_configuration_s *fs_conf = NULL;
@@ -2837,6 +3002,90 @@ DOTCONF_CB(get_file_stuffing)
     return NULL;
 }
 
+DOTCONF_CB(get_async_datafile_removal)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(strcasecmp(cmd->data.str, "yes") == 0)
+    {
+        fs_conf->async_datafile_removal = 1;
+    }
+    else if(strcasecmp(cmd->data.str, "no") == 0)
+    {
+        fs_conf->async_datafile_removal = 0;
+    }
+    else
+    {
+        return("AsyncDatafileRemoval value must be 'yes' or 'no'.\n");
+    }
+
+    return NULL;
+}
+
+DOTCONF_CB(get_datafile_reclaim_batch_size)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(cmd->data.value < 1 ||
+       cmd->data.value > PVFS_SYS_LIMIT_HANDLES_COUNT)
+    {
+        return("DatafileReclaimBatchSize must be between 1 and the "
+               "maximum handle count of a request (1024).\n");
+    }
+    fs_conf->datafile_reclaim_batch_size = (int)cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_small_io_size)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(cmd->data.value < 0 ||
+       cmd->data.value > PINT_SMALL_IO_MAXSIZE)
+    {
+        return("SmallIOSize must be between 0 and 262144.\n");
+    }
+    fs_conf->small_io_size = (int)cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_inline_data_size)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(cmd->data.value < 0 ||
+       cmd->data.value > PVFS_REQ_LIMIT_INLINE_DATA)
+    {
+        return("InlineDataSize must be between 0 and 4096.\n");
+    }
+    fs_conf->inline_data_size = (int)cmd->data.value;
+    return NULL;
+}
+
 
 DOTCONF_CB(get_trove_sync_meta)
 {
@@ -2914,6 +3163,94 @@ DOTCONF_CB(get_trove_max_concurrent_io)
     return NULL;
 }
 
+DOTCONF_CB(get_data_cache_size_mb)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return("DataCacheSizeMB must not be negative.\n");
+    }
+    config_s->data_cache_size_mb = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_data_cache_block_size)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 4096 || cmd->data.value > 4194304 ||
+       (cmd->data.value & (cmd->data.value - 1)))
+    {
+        return("DataCacheBlockSize must be a power of two between "
+               "4096 and 4194304.\n");
+    }
+    config_s->data_cache_block_size = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_log_buffer_size)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return("LogBufferSize must not be negative.\n");
+    }
+    config_s->log_buffer_size = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_log_rate_limit)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return("LogRateLimit must not be negative.\n");
+    }
+    config_s->log_rate_limit = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_request_trace_entries)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    config_s->request_trace_entries = cmd->data.value;
+    return NULL;
+}
+
 DOTCONF_CB(get_db_cache_size_bytes)
 {
     struct server_configuration_s *config_s = 
@@ -3456,6 +3793,42 @@ DOTCONF_CB(directio_timeout)
     return NULL;
 }
 
+DOTCONF_CB(trove_readahead_size)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if(cmd->data.value < 0)
+    {
+        return("TroveReadaheadSize must not be negative.\n");
+    }
+    fs_conf->readahead_size = cmd->data.value;
+
+    return NULL;
+}
+
+DOTCONF_CB(trove_readahead_buffers)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if(cmd->data.value < 1)
+    {
+        return("TroveReadaheadBuffers must be at least 1.\n");
+    }
+    fs_conf->readahead_buffers = cmd->data.value;
+
+    return NULL;
+}
+
 DOTCONF_CB(get_key_store)
 {
     struct server_configuration_s *config_s =
@@ -3628,6 +4001,20 @@ DOTCONF_CB(get_capcache_timeout)
     return NULL;
 }
 
+DOTCONF_CB(get_capcache_size_mb)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+
+    if (cmd->data.value < 1)
+    {
+        return("CapabilityCacheSizeMB must be at least 1.\n");
+    }
+    config_s->capcache_size_mb = (int) cmd->data.value;
+
+    return NULL;
+}
+
 DOTCONF_CB(get_certcache_timeout)
 {
     struct server_configuration_s *config_s =
@@ -3962,6 +4349,36 @@ DOTCONF_CB(distr_dir_split_size)
     return NULL;
 }
 
+DOTCONF_CB(distr_dir_hash_function)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    int hash_type;
+
+    hash_type = PINT_dist_dir_hash_type_from_name(cmd->data.str);
+    if(hash_type < 0)
+    {
+        return "DistrDirHashFunction must be md5 or murmur3\n";
+    }
+    config_s->distr_dir_hash_type = hash_type;
+
+    return NULL;
+}
+
+DOTCONF_CB(distr_dir_servers_grow_max)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+
+    if(cmd->data.value < 0)
+    {
+        return "DistrDirServersGrowMax must not be negative\n";
+    }
+    config_s->distr_dir_servers_grow_max = cmd->data.value;
+
+    return NULL;
+}
+
 
 /*
  * Function: PINT_config_release
@@ -4477,8 +4894,14 @@ static void copy_filesystem(struct filesystem_configuration_s *dest_fs,
         dest_fs->attr_cache_size = src_fs->attr_cache_size;
         dest_fs->attr_cache_max_num_elems =
             src_fs->attr_cache_max_num_elems;
+        dest_fs->attr_cache_memory_mb = src_fs->attr_cache_memory_mb;
         dest_fs->trove_sync_meta = src_fs->trove_sync_meta;
         dest_fs->trove_sync_data = src_fs->trove_sync_data;
+        dest_fs->async_datafile_removal = src_fs->async_datafile_removal;
+        dest_fs->datafile_reclaim_batch_size =
+            src_fs->datafile_reclaim_batch_size;
+        dest_fs->small_io_size = src_fs->small_io_size;
+        dest_fs->inline_data_size = src_fs->inline_data_size;
  
         /* copy all relevant export options */
         dest_fs->exp_flags    = src_fs->exp_flags;
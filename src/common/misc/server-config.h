@@ -86,12 +86,17 @@ typedef struct filesystem_configuration_s
     char *attr_cache_keywords;
     int attr_cache_size;
     int attr_cache_max_num_elems;
+    int attr_cache_memory_mb;
     int trove_sync_meta;
     int trove_sync_data;
     int immediate_completion;
     int coalescing_high_watermark;
     int coalescing_low_watermark;
     int file_stuffing;
+    int async_datafile_removal;
+    int datafile_reclaim_batch_size;
+    int small_io_size;
+    int inline_data_size;
 
     char *secret_key;
 
@@ -128,6 +133,9 @@ typedef struct filesystem_configuration_s
     int32_t directio_ops_per_queue;
     int32_t directio_timeout;
 
+    int32_t readahead_size;
+    int32_t readahead_buffers;
+
     /* size used to create keyval, dataspace, and collection_attributes databases. LMDB only.*/
     size_t db_max_size;
 } filesystem_configuration_s;
@@ -176,6 +184,8 @@ typedef struct server_configuration_s
     char *logfile;                  /* what log file to write to */
     char *logtype;                  /* "file" or "syslog" destination */
     enum gossip_logstamp logstamp_type; /* how to timestamp logs */
+    int log_buffer_size;            /* per-thread async log buffer, 0=off */
+    int log_rate_limit;             /* debug msgs/sec per mask, 0=off */
     char *event_logging;
     int enable_events;
     char *bmi_modules;              /* BMI modules                      */
@@ -218,6 +228,9 @@ typedef struct server_configuration_s
     int trove_max_concurrent_io;    /* allow the number of aio operations to
                                      * be configurable.
                                      */
+    int request_trace_entries;      /* size of request trace buffer */
+    int data_cache_size_mb;         /* data block cache size, 0=off */
+    int data_cache_block_size;      /* bytes per data block cache entry */
     int trove_method;
 	
     char *keystore_path;             /* location of trusted server public keys */
@@ -252,6 +265,7 @@ typedef struct server_configuration_s
 
     int credcache_timeout;           /* credential cache timeout in seconds */
     int capcache_timeout;            /* capability cache timeout in seconds */
+    int capcache_size_mb;            /* capability cache memory bound in MB */
     int certcache_timeout;           /* certificate cache timeout in seconds */
 
     void *private_data;
@@ -261,6 +275,8 @@ typedef struct server_configuration_s
     int32_t distr_dir_servers_initial;
     int32_t distr_dir_servers_max;
     int32_t distr_dir_split_size;
+    int32_t distr_dir_hash_type;     /* PVFS_DIST_DIR_HASH_* for new dirs */
+    int32_t distr_dir_servers_grow_max; /* 0 disables directory growth */
 } server_configuration_s;
 
 int PINT_parse_config(
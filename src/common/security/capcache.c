@@ -3,6 +3,17 @@
  *
  * Capability cache functions
  *
+ * Two caches are kept.  The verified cache remembers capabilities whose
+ * signatures have been checked, keyed on a digest of every signed field
+ * and the signature itself, so that a request carrying the same
+ * capability again skips the public key verify.  The signed cache maps
+ * the fields of capabilities this server issued to their signature, so
+ * getattr can hand out an identical capability without signing again.
+ *
+ * Each cache is split into CAPCACHE_STRIPES stripes, each with its own
+ * lock, hash buckets and LRU list, and each stripe is bounded to its
+ * share of the configured memory.
+ *
  * See COPYING in top-level directory.
  */
 
@@ -14,312 +25,453 @@
 #define ENABLE_SECURITY_MODE
 #endif
 
-#include <malloc.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <openssl/evp.h>
+
 #include "capcache.h"
 #include "security-util.h"
 #include "server-config.h"
 #include "pint-util.h"
 #include "pvfs2-internal.h"
-#include "murmur3.h"
+#include "quicklist.h"
+#include "gen-locks.h"
 #include "gossip.h"
 #include "pvfs2-debug.h"
 #include "server-config-mgr.h"
 
-/* global variables */
-seccache_t *capcache = NULL;
-
-/*** capability cache methods ***/
-static void PINT_capcache_set_expired(seccache_entry_t *entry,
-                                      PVFS_time timeout);
-static uint16_t PINT_capcache_get_index(void *data,
-                                        uint64_t hash_limit);
-static int PINT_capcache_compare(void *data, void *entry);
-static void PINT_capcache_cleanup(void *entry);
-static void PINT_capcache_debug(const char *prefix,
-                               void *data);
-int PINT_capcache_remove(seccache_entry_t * entry);
-
-/* method table */
-static seccache_methods_t capcache_methods = {    
-    PINT_seccache_expired_default,
-    PINT_capcache_set_expired,
-    PINT_capcache_get_index,
-    PINT_capcache_compare,
-    PINT_capcache_cleanup,
-    PINT_capcache_debug
+/* frequency (in lookups of the first stripe) of debugging stats */
+#define CAPCACHE_STATS_FREQ    1000
+
+/* average entries per hash bucket at the memory bound */
+#define CAPCACHE_BUCKET_LOAD   4
+
+#ifdef HAVE_OPENSSL_1_1
+#   define CAPCACHE_MD_CTX_FREE(ctx) EVP_MD_CTX_free((ctx))
+#else
+#   define CAPCACHE_MD_CTX_FREE(ctx) EVP_MD_CTX_cleanup((ctx))
+#endif
+
+struct capcache_entry
+{
+    struct qlist_head hash_link;
+    struct qlist_head lru_link;     /* most recently used first */
+    capcache_digest_t digest;
+    PVFS_time expiration;
+    PVFS_size size;                 /* memory charged to the stripe */
+    /* signed cache only */
+    PVFS_time cap_timeout;
+    uint32_t sig_size;
+    unsigned char signature[];
 };
 
-/*** capability cache helper functions ***/
-static int PINT_capcache_quick_cmp(void * data,
-                                   void * entry);
+struct capcache_stripe
+{
+    gen_mutex_t lock;
+    struct qlist_head *buckets;
+    struct qlist_head lru;
+    PVFS_size size;
+    uint64_t entry_count;
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t expired;
+    uint64_t inserts;
+    uint64_t evictions;
+};
 
-/*** capability cache methods ***/
+struct capcache_table
+{
+    const char *desc;
+    uint32_t bucket_mask;
+    PVFS_size stripe_size_limit;
+    struct capcache_stripe stripes[CAPCACHE_STRIPES];
+};
+
+static struct capcache_table *capcache_verified = NULL;
+static struct capcache_table *capcache_signed = NULL;
+static PVFS_time capcache_timeout = CAPCACHE_TIMEOUT;
+static int capcache_check_cap_timeout = 1;
+
+/*** capability cache helper functions ***/
 
-/** PINT_capcache_setexpired
- *  Sets the capcache entry's timeout to "now"
+/** capcache_digest
+ * Computes the SHA-256 digest of a capability's issuer, fsid, op_mask
+ * and handles, and, if with_signature is set, of its timeout and
+ * signature as well.
+ * Returns 0 on success, -PVFS_ESECURITY on failure.
  */
-static void PINT_capcache_set_expired(seccache_entry_t *entry,
-                                      PVFS_time timeout)
+static int capcache_digest(const PVFS_capability *cap,
+                           int with_signature,
+                           capcache_digest_t *digest)
 {
-    
-    PVFS_capability *cap = (PVFS_capability *) entry->data;
+    EVP_MD_CTX *tmp_mdctx = NULL;
+#ifdef HAVE_OPENSSL_1_1
+    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+    tmp_mdctx = mdctx;
+#else
+    EVP_MD_CTX mdctx = {0};
+    tmp_mdctx = &mdctx;
+#endif
+    unsigned int len = 0;
+    int ret;
 
-    entry->expiration = time(NULL) + timeout;
+    if (tmp_mdctx == NULL)
+    {
+        return -PVFS_ENOMEM;
+    }
 
-    /* do not set expiration past capability timeout */
-    if (cap->timeout < entry->expiration)
+    EVP_MD_CTX_init(tmp_mdctx);
+    ret = EVP_DigestInit_ex(tmp_mdctx, EVP_sha256(), NULL);
+    /* include the terminator so the issuer cannot run into the fsid */
+    ret &= EVP_DigestUpdate(tmp_mdctx, cap->issuer, strlen(cap->issuer) + 1);
+    ret &= EVP_DigestUpdate(tmp_mdctx, &cap->fsid, sizeof(PVFS_fs_id));
+    ret &= EVP_DigestUpdate(tmp_mdctx, &cap->op_mask, sizeof(uint32_t));
+    ret &= EVP_DigestUpdate(tmp_mdctx, &cap->num_handles, sizeof(uint32_t));
+    if (cap->num_handles)
     {
-        entry->expiration = cap->timeout;
+        ret &= EVP_DigestUpdate(tmp_mdctx, cap->handle_array,
+                                cap->num_handles * sizeof(PVFS_handle));
     }
+    if (with_signature)
+    {
+        ret &= EVP_DigestUpdate(tmp_mdctx, &cap->timeout, sizeof(PVFS_time));
+        ret &= EVP_DigestUpdate(tmp_mdctx, &cap->sig_size, sizeof(uint32_t));
+        ret &= EVP_DigestUpdate(tmp_mdctx, cap->signature, cap->sig_size);
+    }
+    if (ret)
+    {
+        ret = EVP_DigestFinal_ex(tmp_mdctx, digest->bytes, &len);
+    }
+
+    CAPCACHE_MD_CTX_FREE(tmp_mdctx);
+
+    return (ret && len == CAPCACHE_DIGEST_LEN) ? 0 : -PVFS_ESECURITY;
 }
 
-/** PINT_capcache_get_index
- * Determine the hash table index based on a certain key.
- * The key is a concatenation of serveral capability fields.
- * Returns index of hash table.
- */
-static uint16_t PINT_capcache_get_index(void *data,
-                                        uint64_t hash_limit)
-{    
-    PVFS_capability *cap = (PVFS_capability *) data;
-    uint32_t seed = 42;
-    uint64_t hash1[2] = { 0, 0};
-    uint64_t hash2[2] = { 0, 0};
-    uint16_t index = 0;
-
-    /* What to hash:
-        issuer
-        fsid
-        op_mask
-        handle_array
-    */
-    MurmurHash3_x64_128((const void *) cap->issuer,
-        strlen(cap->issuer), seed, hash2);
-    hash1[0] += hash2[0];
-    hash1[1] += hash2[1];
-
-    MurmurHash3_x64_128((const void *) &cap->fsid,
-        sizeof(PVFS_fs_id), seed, hash2);
-    hash1[0] += hash2[0];
-    hash1[1] += hash2[1];
-
-    MurmurHash3_x64_128((const void *) &cap->op_mask,
-        sizeof(uint32_t), seed, hash2);
-    hash1[0] += hash2[0];
-    hash1[1] += hash2[1];
-
-    MurmurHash3_x64_128((const void *) cap->handle_array,
-        sizeof(PVFS_handle) * cap->num_handles, seed, hash2);
-    hash1[0] += hash2[0];
-    hash1[1] += hash2[1];
-
-    index = (uint16_t) (hash1[0] % hash_limit);
-
-    return index;
+/* the digest is uniformly distributed; its first word picks the stripe
+   and the second the bucket within it */
+static inline struct capcache_stripe *capcache_get_stripe(
+    struct capcache_table *table,
+    const capcache_digest_t *digest)
+{
+    uint32_t word;
+
+    memcpy(&word, digest->bytes, sizeof(word));
+
+    return &table->stripes[word % CAPCACHE_STRIPES];
+}
+
+static inline struct qlist_head *capcache_get_bucket(
+    struct capcache_table *table,
+    struct capcache_stripe *stripe,
+    const capcache_digest_t *digest)
+{
+    uint32_t word;
+
+    memcpy(&word, digest->bytes + sizeof(word), sizeof(word));
+
+    return &stripe->buckets[word & table->bucket_mask];
 }
 
-/** PINT_capcache_capability_cmp
- * Compares two PVFS_capability structures. Returns 0 if the
- * capabilities are equivalent. Returns nonzero otherwise.
+/** capcache_table_new
+ * Allocates a cache table whose stripes share size_limit bytes.
  */
-static int PINT_capcache_compare(void * data,
-                                 void * entry)
+static struct capcache_table *capcache_table_new(const char *desc,
+                                                 PVFS_size size_limit,
+                                                 PVFS_size entry_size)
 {
-    seccache_entry_t *pentry = (seccache_entry_t *) entry;
-    PVFS_capability *kcap, *ecap;
+    struct capcache_table *table;
+    uint64_t buckets = 1, want;
+    int i, j;
 
-    /* ignore chain end marker */
-    if (pentry->data == NULL)
+    table = (struct capcache_table *) calloc(1, sizeof(*table));
+    if (table == NULL)
     {
-        return 1;
+        return NULL;
     }
 
-    ecap = (PVFS_capability *) pentry->data;
-    kcap = (PVFS_capability *) data;
+    table->desc = desc;
+    table->stripe_size_limit = size_limit / CAPCACHE_STRIPES;
 
-    /* if both sig_sizes are 0, they're null caps */
-    if (kcap->sig_size == 0 && ecap->sig_size == 0)
+    /* size buckets for the number of entries that fit in a stripe */
+    want = table->stripe_size_limit / entry_size / CAPCACHE_BUCKET_LOAD;
+    while (buckets < want)
     {
-        return 0;
+        buckets <<= 1;
     }
-    /* sizes don't match -- shouldn't happen */
-    else if (kcap->sig_size != ecap->sig_size)
+    table->bucket_mask = (uint32_t) (buckets - 1);
+
+    /* the bucket heads count against the bound too */
+    if (table->stripe_size_limit > buckets * sizeof(struct qlist_head))
     {
-        gossip_err("Warning: capability cache: signature size mismatch "
-                   "(key: %d   entry: %d)\n", kcap->sig_size, ecap->sig_size);
-        return 1;
+        table->stripe_size_limit -= buckets * sizeof(struct qlist_head);
     }
 
-    /* compare signatures */
-    return memcmp(kcap->signature, ecap->signature, kcap->sig_size);
-}
-
-/** PINT_capcache_cleanup
- *  Frees allocated capability.
- */
-static void PINT_capcache_cleanup(void *entry)
-{
-    if (entry != NULL)
+    for (i = 0; i < CAPCACHE_STRIPES; i++)
     {
-        if (((seccache_entry_t *) entry)->data != NULL)
+        struct capcache_stripe *stripe = &table->stripes[i];
+
+        gen_mutex_init(&stripe->lock);
+        INIT_QLIST_HEAD(&stripe->lru);
+        stripe->buckets = (struct qlist_head *)
+            malloc(buckets * sizeof(struct qlist_head));
+        if (stripe->buckets == NULL)
         {
-            PINT_cleanup_capability((PVFS_capability *) 
-                                    ((seccache_entry_t *)entry)->data);
-            free(((seccache_entry_t *)entry)->data);
+            for (j = 0; j < i; j++)
+            {
+                free(table->stripes[j].buckets);
+            }
+            free(table);
+            return NULL;
+        }
+        for (j = 0; j < buckets; j++)
+        {
+            INIT_QLIST_HEAD(&stripe->buckets[j]);
         }
-        free(entry);
-        entry = NULL;
     }
+
+    gossip_debug(GOSSIP_SECCACHE_DEBUG, "%s: %s cache - %d stripes of %llu "
+                 "buckets, %llu bytes each\n", __func__, desc,
+                 CAPCACHE_STRIPES, llu(buckets),
+                 llu(table->stripe_size_limit));
+
+    return table;
 }
 
-/* PINT_capcache_debug
- *
- * Outputs the fields of a capability.
- * prefix should typically be "caching" or "removing".
- */
-static void PINT_capcache_debug(const char *prefix,
-                                void *data)
+static void capcache_table_free(struct capcache_table *table)
 {
-    char sig_buf[16], mask_buf[16];
-    PVFS_capability *cap;
+    struct capcache_entry *entry, *tmp;
     int i;
 
-    if (data == NULL)
+    if (table == NULL)
     {
         return;
     }
 
-    cap = (PVFS_capability *) data;
-
-    if (strlen(cap->issuer) == 0)
+    for (i = 0; i < CAPCACHE_STRIPES; i++)
     {
-        gossip_debug(GOSSIP_SECCACHE_DEBUG, "%s null capability\n", prefix);
-        return;
+        struct capcache_stripe *stripe = &table->stripes[i];
+
+        qlist_for_each_entry_safe(entry, tmp, &stripe->lru, lru_link)
+        {
+            free(entry);
+        }
+        free(stripe->buckets);
+        gen_mutex_destroy(&stripe->lock);
     }
 
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "%s capability:\n", prefix);
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "\tissuer: %s\n", cap->issuer);
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "\tfsid: %u\n", cap->fsid);
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "\tsig_size: %u\n", cap->sig_size);
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "\tsignature: %s\n",
-                 PINT_util_bytes2str(cap->signature, sig_buf, 4));
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "\ttimeout: %d\n",
-                 (int) cap->timeout);
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "\top_mask: %s\n",
-                 PINT_print_op_mask(cap->op_mask, mask_buf));
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "\tnum_handles: %u\n",
-                 cap->num_handles);
-    gossip_debug(GOSSIP_SECCACHE_DEBUG, "\tfirst handle: %llu\n",
-                 cap->num_handles > 0 ? llu(cap->handle_array[0]) : 0LL);
-    for (i = 1; i < cap->num_handles; i++)
-    {
-        gossip_debug(GOSSIP_SECCACHE_DEBUG, "\thandle %d: %llu\n",
-                     i+1, llu(cap->handle_array[i]));
+    free(table);
+}
+
+/* the following helpers are called with the stripe lock held */
+
+static struct capcache_entry *capcache_stripe_find(
+    struct capcache_table *table,
+    struct capcache_stripe *stripe,
+    const capcache_digest_t *digest)
+{
+    struct qlist_head *bucket = capcache_get_bucket(table, stripe, digest);
+    struct capcache_entry *entry;
+
+    qlist_for_each_entry(entry, bucket, hash_link)
+    {
+        if (memcmp(entry->digest.bytes, digest->bytes,
+                   CAPCACHE_DIGEST_LEN) == 0)
+        {
+            return entry;
+        }
     }
+
+    return NULL;
+}
+
+static void capcache_stripe_remove(struct capcache_stripe *stripe,
+                                   struct capcache_entry *entry)
+{
+    qlist_del(&entry->hash_link);
+    qlist_del(&entry->lru_link);
+    stripe->size -= entry->size;
+    stripe->entry_count--;
+    free(entry);
 }
 
-/** PINT_capcache_capability_cmp
- * Compares two PVFS_capability structures. Returns 0 if the
- * capability fields are equivalent. Returns nonzero otherwise.
+/** capcache_stripe_insert
+ * Adds a new entry at the head of the stripe's LRU list, first dropping
+ * least recently used entries until it fits in the stripe's share of
+ * memory.
  */
-static int PINT_capcache_quick_cmp(void * data,
-                                   void * entry)
+static void capcache_stripe_insert(struct capcache_table *table,
+                                   struct capcache_stripe *stripe,
+                                   struct capcache_entry *entry)
 {
-    PVFS_capability *kcap, *ecap;
-    seccache_entry_t *pentry;
+    struct capcache_entry *victim;
+
+    while (!qlist_empty(&stripe->lru) &&
+           stripe->size + entry->size > table->stripe_size_limit)
+    {
+        victim = qlist_entry(stripe->lru.prev, struct capcache_entry,
+                             lru_link);
+        capcache_stripe_remove(stripe, victim);
+        stripe->evictions++;
+    }
 
-    pentry = (seccache_entry_t *) entry;
+    qlist_add(&entry->hash_link,
+              capcache_get_bucket(table, stripe, &entry->digest));
+    qlist_add(&entry->lru_link, &stripe->lru);
+    stripe->size += entry->size;
+    stripe->entry_count++;
+    stripe->inserts++;
+}
 
-    /* ignore chain end marker */
-    if (pentry->data == NULL)
+/* an entry lives for the cache timeout, but never past the capability */
+static PVFS_time capcache_expiration(const PVFS_capability *cap,
+                                     PVFS_time now)
+{
+    PVFS_time expiration = now + capcache_timeout;
+
+    if (capcache_check_cap_timeout && cap->timeout < expiration)
     {
-        return 1;
+        expiration = cap->timeout;
     }
 
-    ecap = pentry->data;
-    kcap = (PVFS_capability *) data;
+    return expiration;
+}
 
-    return (!(kcap->fsid == ecap->fsid &&
-              kcap->num_handles == ecap->num_handles &&
-              kcap->op_mask == ecap->op_mask &&
-              (strcmp(kcap->issuer, ecap->issuer) == 0) &&
-              (memcmp(kcap->handle_array, ecap->handle_array, 
-                      kcap->num_handles * sizeof(PVFS_handle)) == 0)));
+static void capcache_debug_stats(void)
+{
+    capcache_stats_t stats;
+
+    PINT_capcache_get_stats(&stats);
+
+    gossip_debug(GOSSIP_SECCACHE_DEBUG, "*** Capability cache statistics "
+                 "***\n");
+    gossip_debug(GOSSIP_SECCACHE_DEBUG, "*** entries: %llu (%llu bytes) "
+                 "inserts: %llu evictions: %llu\n", llu(stats.entry_count),
+                 llu(stats.cache_size), llu(stats.inserts),
+                 llu(stats.evictions));
+    gossip_debug(GOSSIP_SECCACHE_DEBUG, "*** lookups: %llu hits: %llu "
+                 "(%3.1f%%) misses: %llu expired: %llu\n",
+                 llu(stats.lookups), llu(stats.hits),
+                 stats.lookups ?
+                     ((float) stats.hits / stats.lookups * 100) : 0.0,
+                 llu(stats.misses), llu(stats.expired));
+    gossip_debug(GOSSIP_SECCACHE_DEBUG, "*** signature reuse: %llu of "
+                 "%llu\n", llu(stats.sign_hits), llu(stats.sign_lookups));
 }
 
+/*** externally visible capability cache API ***/
+
 /** PINT_capcache_quick_sign
- * Copy signature from cached capability if fields match
+ * Copy signature and timeout from a capability this server issued
+ * earlier with the same fields.
+ * Returns 0 if the capability was signed, nonzero otherwise.
  */
-int PINT_capcache_quick_sign(PVFS_capability * cap)
+int PINT_capcache_quick_sign(PVFS_capability *cap)
 {
-    seccache_entry_t *curr_entry = NULL;
-    uint16_t index = 0;
-    PVFS_capability *curr_cap;
+    struct capcache_stripe *stripe;
+    struct capcache_entry *entry;
+    capcache_digest_t digest;
+    PVFS_time now;
+    int ret = 1;
 
-    index = capcache->methods.get_index(cap, capcache->hash_limit);
+    if (capcache_signed == NULL || capcache_digest(cap, 0, &digest) != 0)
+    {
+        return 1;
+    }
 
-    PINT_seccache_lock(capcache);
-    
-    /* iterate over the hash table chain at the calculated index until a match
-     * is found.
-     */
-    curr_entry = (seccache_entry_t *) PINT_llist_search(
-        capcache->hash_table[index],
-        cap,
-        &PINT_capcache_quick_cmp);
+    now = PINT_util_get_current_time();
+    stripe = capcache_get_stripe(capcache_signed, &digest);
 
-    /* release the lock */
-    PINT_seccache_unlock(capcache);
+    gen_mutex_lock(&stripe->lock);
 
-    if (curr_entry != NULL)
+    stripe->lookups++;
+    entry = capcache_stripe_find(capcache_signed, stripe, &digest);
+    if (entry != NULL && (now > entry->expiration || now > entry->cap_timeout))
     {
-        gossip_debug(GOSSIP_SECCACHE_DEBUG, "%s: entry found\n",
+        gossip_debug(GOSSIP_SECCACHE_DEBUG, "%s: entry timed out\n",
                      __func__);
+        capcache_stripe_remove(stripe, entry);
+        stripe->expired++;
+        entry = NULL;
+        ret = -1;
     }
-    else
+
+    if (entry != NULL)
     {
-        return 1;
+        cap->timeout = entry->cap_timeout;
+        cap->sig_size = entry->sig_size;
+        memcpy(cap->signature, entry->signature, entry->sig_size);
+
+        qlist_del(&entry->lru_link);
+        qlist_add(&entry->lru_link, &stripe->lru);
+        stripe->hits++;
+        ret = 0;
     }
-
-    /* copy capability timeout & signature */
-    curr_cap = (PVFS_capability *) curr_entry->data;
-    /* check timeout */
-    if (PINT_util_get_current_time() > curr_cap->timeout)
+    else
     {
-        gossip_debug(GOSSIP_SECCACHE_DEBUG, "%s: entry timed out\n",
-                     __func__);
-        return -1;
+        stripe->misses++;
     }
-    cap->timeout = curr_cap->timeout;
-    cap->sig_size = curr_cap->sig_size;
-    memcpy(cap->signature, curr_cap->signature, 
-           curr_cap->sig_size);
 
-    return 0;
-}
+    gen_mutex_unlock(&stripe->lock);
+
+    gossip_debug(GOSSIP_SECCACHE_DEBUG, "%s: entry %s\n", __func__,
+                 ret == 0 ? "found" : "not found");
 
+    return ret;
+}
 
-/** Initializes the capability cache.
+/** Initializes the capability cache from the server configuration.
  * Returns 0 on success.
  * Returns negative PVFS_error on failure.
  */
 int PINT_capcache_init(void)
 {
     struct server_configuration_s *config = PINT_server_config_mgr_get_config();
+    PVFS_size size_limit = CAPCACHE_SIZE_LIMIT_DEFAULT;
+
+    if (config->capcache_size_mb > 0)
+    {
+        size_limit = (PVFS_size) config->capcache_size_mb * 1024 * 1024;
+    }
+
+    return PINT_capcache_init_limits(config->capcache_timeout, size_limit,
+                                     !config->bypass_timeout_check);
+}
+
+/** Initializes the capability cache with explicit limits: entries live
+ * timeout_secs seconds (and, if check_cap_timeout is set, not past the
+ * capability's own timeout) and both caches together use at most
+ * size_limit bytes.
+ * Returns 0 on success.
+ * Returns negative PVFS_error on failure.
+ */
+int PINT_capcache_init_limits(int timeout_secs,
+                              PVFS_size size_limit,
+                              int check_cap_timeout)
+{
+    PVFS_size entry_size = sizeof(struct capcache_entry);
 
     gossip_debug(GOSSIP_SECURITY_DEBUG, "Initializing capability cache...\n");
 
-    capcache = PINT_seccache_new("Capability", &capcache_methods, 0);
-    if (capcache == NULL)
+    capcache_timeout = (timeout_secs > 0) ? timeout_secs : CAPCACHE_TIMEOUT;
+    capcache_check_cap_timeout = check_cap_timeout;
+
+    /* most memory goes to verified capabilities; signed entries also
+       hold a signature and are only made for capabilities we issue */
+    capcache_verified = capcache_table_new("Capability",
+                                           size_limit - size_limit / 4,
+                                           entry_size);
+    capcache_signed = capcache_table_new("Signed capability",
+                                         size_limit / 4,
+                                         entry_size + 256);
+    if (capcache_verified == NULL || capcache_signed == NULL)
     {
+        PINT_capcache_finalize();
         return -PVFS_ENOMEM;
     }
 
-    /* Set timeout */
-    PINT_seccache_set(capcache, SECCACHE_TIMEOUT, config->capcache_timeout);
-
     return 0;
 }
 
@@ -332,47 +484,225 @@ int PINT_capcache_finalize(void)
 
     gossip_debug(GOSSIP_SECURITY_DEBUG, "Finalizing capability cache...\n");
 
-    PINT_seccache_cleanup(capcache);
+    capcache_table_free(capcache_verified);
+    capcache_table_free(capcache_signed);
+    capcache_verified = NULL;
+    capcache_signed = NULL;
 
     return 0;
 }
 
-/* lookup entry using capability */
-seccache_entry_t * PINT_capcache_lookup(PVFS_capability * cap)
+/** PINT_capcache_lookup
+ * Checks whether this exact capability was verified before.  The
+ * capability digest is returned in digest for a later
+ * PINT_capcache_insert() after a successful verify.
+ * Returns 1 on a hit, 0 otherwise.
+ */
+int PINT_capcache_lookup(const PVFS_capability *cap,
+                         capcache_digest_t *digest)
 {
-    return PINT_seccache_lookup(capcache, cap);
+    struct capcache_stripe *stripe;
+    struct capcache_entry *entry;
+    PVFS_time now;
+    int hit = 0, print_stats = 0;
+
+    if (capcache_verified == NULL || capcache_digest(cap, 1, digest) != 0)
+    {
+        memset(digest, 0, sizeof(*digest));
+        return 0;
+    }
+
+    now = PINT_util_get_current_time();
+    stripe = capcache_get_stripe(capcache_verified, digest);
+
+    gen_mutex_lock(&stripe->lock);
+
+    stripe->lookups++;
+    entry = capcache_stripe_find(capcache_verified, stripe, digest);
+    if (entry != NULL && now > entry->expiration)
+    {
+        gossip_debug(GOSSIP_SECCACHE_DEBUG, "%s: entry %p expired\n",
+                     __func__, entry);
+        capcache_stripe_remove(stripe, entry);
+        stripe->expired++;
+        entry = NULL;
+    }
+
+    if (entry != NULL)
+    {
+        /* renew and move to the head of the LRU list */
+        entry->expiration = capcache_expiration(cap, now);
+        qlist_del(&entry->lru_link);
+        qlist_add(&entry->lru_link, &stripe->lru);
+        stripe->hits++;
+        hit = 1;
+    }
+    else
+    {
+        stripe->misses++;
+    }
+
+    print_stats = (stripe == &capcache_verified->stripes[0] &&
+                   stripe->lookups % CAPCACHE_STATS_FREQ == 0);
+
+    gen_mutex_unlock(&stripe->lock);
+
+    if (print_stats && gossip_debug_enabled(GOSSIP_SECCACHE_DEBUG))
+    {
+        capcache_debug_stats();
+    }
+
+    return hit;
 }
 
-/* insert entry for capability */
-int PINT_capcache_insert(PVFS_capability *cap)
+/** PINT_capcache_insert
+ * Records a capability whose signature has been verified.  digest is
+ * the one returned by PINT_capcache_lookup(), or NULL to compute it.
+ * Returns 0 on success, negative PVFS_error on failure.
+ */
+int PINT_capcache_insert(const PVFS_capability *cap,
+                         const capcache_digest_t *digest)
 {
-    PVFS_capability *cachecap;
-    int ret = 0;
+    struct capcache_stripe *stripe;
+    struct capcache_entry *entry, *old;
+    capcache_digest_t local_digest;
+    PVFS_time now;
+    int ret;
 
-    cachecap = PINT_dup_capability(cap);
-    if (cachecap == NULL)
+    if (capcache_verified == NULL)
     {
-        ret = -PVFS_ENOMEM;
+        return -PVFS_EINVAL;
     }
 
-    if (ret == 0)
+    if (digest == NULL)
     {
-        ret = PINT_seccache_insert(capcache, cachecap, 
-                                   sizeof(PVFS_capability));
+        ret = capcache_digest(cap, 1, &local_digest);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        digest = &local_digest;
+    }
+
+    entry = (struct capcache_entry *) calloc(1, sizeof(*entry));
+    if (entry == NULL)
+    {
+        return -PVFS_ENOMEM;
+    }
+    entry->digest = *digest;
+    entry->size = sizeof(*entry);
+
+    now = PINT_util_get_current_time();
+    entry->expiration = capcache_expiration(cap, now);
+
+    stripe = capcache_get_stripe(capcache_verified, digest);
+
+    gen_mutex_lock(&stripe->lock);
+
+    /* a concurrent request may have verified the same capability */
+    old = capcache_stripe_find(capcache_verified, stripe, digest);
+    if (old != NULL)
+    {
+        capcache_stripe_remove(stripe, old);
     }
+    capcache_stripe_insert(capcache_verified, stripe, entry);
 
+    gen_mutex_unlock(&stripe->lock);
+
+    return 0;
+}
+
+/** PINT_capcache_insert_signed
+ * Records a capability this server just signed, both for signature reuse
+ * by PINT_capcache_quick_sign() and as verified.
+ * Returns 0 on success, negative PVFS_error on failure.
+ */
+int PINT_capcache_insert_signed(const PVFS_capability *cap)
+{
+    struct capcache_stripe *stripe;
+    struct capcache_entry *entry, *old;
+    capcache_digest_t digest;
+    PVFS_time now;
+    int ret;
+
+    if (capcache_signed == NULL)
+    {
+        return -PVFS_EINVAL;
+    }
+
+    ret = capcache_digest(cap, 0, &digest);
     if (ret != 0)
     {
-        PVFS_perror_gossip("PINT_certcache_insert: insert failed", ret);
+        return ret;
     }
 
-    return ret;
+    entry = (struct capcache_entry *) calloc(1, sizeof(*entry) +
+                                             cap->sig_size);
+    if (entry == NULL)
+    {
+        return -PVFS_ENOMEM;
+    }
+    entry->digest = digest;
+    entry->size = sizeof(*entry) + cap->sig_size;
+    entry->cap_timeout = cap->timeout;
+    entry->sig_size = cap->sig_size;
+    memcpy(entry->signature, cap->signature, cap->sig_size);
+
+    now = PINT_util_get_current_time();
+    entry->expiration = capcache_expiration(cap, now);
+
+    stripe = capcache_get_stripe(capcache_signed, &digest);
+
+    gen_mutex_lock(&stripe->lock);
+
+    old = capcache_stripe_find(capcache_signed, stripe, &digest);
+    if (old != NULL)
+    {
+        capcache_stripe_remove(stripe, old);
+    }
+    capcache_stripe_insert(capcache_signed, stripe, entry);
+
+    gen_mutex_unlock(&stripe->lock);
+
+    return PINT_capcache_insert(cap, NULL);
 }
 
-/* remove capability entry */
-int PINT_capcache_remove(seccache_entry_t * entry)
-{    
-    return PINT_seccache_remove(capcache, entry);
+/** PINT_capcache_get_stats
+ * Sums the statistics of all stripes.  Verified cache counters are
+ * reported in full; of the signed cache only lookups and hits.
+ */
+void PINT_capcache_get_stats(capcache_stats_t *stats)
+{
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (i = 0; capcache_verified != NULL && i < CAPCACHE_STRIPES; i++)
+    {
+        struct capcache_stripe *stripe = &capcache_verified->stripes[i];
+
+        gen_mutex_lock(&stripe->lock);
+        stats->lookups += stripe->lookups;
+        stats->hits += stripe->hits;
+        stats->misses += stripe->misses;
+        stats->expired += stripe->expired;
+        stats->inserts += stripe->inserts;
+        stats->evictions += stripe->evictions;
+        stats->entry_count += stripe->entry_count;
+        stats->cache_size += stripe->size;
+        gen_mutex_unlock(&stripe->lock);
+    }
+
+    for (i = 0; capcache_signed != NULL && i < CAPCACHE_STRIPES; i++)
+    {
+        struct capcache_stripe *stripe = &capcache_signed->stripes[i];
+
+        gen_mutex_lock(&stripe->lock);
+        stats->sign_lookups += stripe->lookups;
+        stats->sign_hits += stripe->hits;
+        stats->cache_size += stripe->size;
+        gen_mutex_unlock(&stripe->lock);
+    }
 }
 
 #endif /* ENABLE_CAPCACHE */
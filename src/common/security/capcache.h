@@ -17,7 +17,7 @@
 #include <stdint.h>
 #include <time.h>
 
-#include "seccache.h"
+#include "pvfs2-types.h"
 
 /* capcache property defaults */
 /* Default timeout of capability-cache entry in seconds */
@@ -25,17 +25,58 @@
 #define CAPCACHE_TIMEOUT       10
 #endif
 
+/* Default memory bound of the cache (64 MB) */
+#define CAPCACHE_SIZE_LIMIT_DEFAULT   (1024 * 1024 * 64)
+
+/* number of independently locked partitions of the cache */
+#define CAPCACHE_STRIPES       64
+
+/* size of a capability digest (SHA-256) */
+#define CAPCACHE_DIGEST_LEN    32
+
+/* digest of all signed fields and the signature of a capability; the
+   key of the verified-capability cache */
+typedef struct
+{
+    unsigned char bytes[CAPCACHE_DIGEST_LEN];
+} capcache_digest_t;
+
+/* cache statistics, summed over all stripes */
+typedef struct
+{
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t expired;
+    uint64_t inserts;
+    uint64_t evictions;
+    uint64_t entry_count;
+    PVFS_size cache_size;
+    uint64_t sign_lookups;
+    uint64_t sign_hits;
+} capcache_stats_t;
+
 /* Externally Visible Capability Cache API */
 int PINT_capcache_init(void);
 
+int PINT_capcache_init_limits(int timeout_secs,
+                              PVFS_size size_limit,
+                              int check_cap_timeout);
+
 int PINT_capcache_finalize(void);
 
-seccache_entry_t *PINT_capcache_lookup(PVFS_capability *cap);
+int PINT_capcache_lookup(const PVFS_capability *cap,
+                         capcache_digest_t *digest);
 
-int PINT_capcache_insert(PVFS_capability *cap);
+int PINT_capcache_insert(const PVFS_capability *cap,
+                         const capcache_digest_t *digest);
+
+int PINT_capcache_insert_signed(const PVFS_capability *cap);
 
 int PINT_capcache_quick_sign(PVFS_capability *cap);
 
+void PINT_capcache_get_stats(capcache_stats_t *stats);
+
 /* End of Externally Visible Capability Cache API */
 #endif /* _CAPCACHE_H */
 
@@ -0,0 +1,632 @@
+/*
+ * (C) 2010-2014 Clemson University and The University of Chicago.
+ *
+ * See COPYING in top-level directory.
+ *
+ * In-process client credential signing.  This builds and signs the same
+ * credential pvfs2-gencred writes to its stdout, without spawning the
+ * helper, for callers that can read the signing key themselves.  Anything
+ * this code cannot do (service users, unreadable keys) is reported back
+ * so that PVFS_util_gen_credential() can fall back to pvfs2-gencred.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <grp.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "pvfs2-config.h"
+#include "pvfs2-types.h"
+#include "pvfs2-internal.h"
+#include "pvfs2-debug.h"
+#include "gossip.h"
+#include "gen-locks.h"
+#include "pint-util.h"
+#include "pvfs2-req-proto.h"
+#include "security-util.h"
+
+#include "client-gencred.h"
+
+/* FIXME: obtaining HOST_NAME_MAX is platform specific and should be handled more generally */
+#ifndef HOST_NAME_MAX
+#define HOST_NAME_MAX 64
+#endif
+
+#ifdef HAVE_OPENSSL_1_1
+#   define CLIENT_GENCRED_PKEY_UP_REF(key) EVP_PKEY_up_ref((key))
+#   define CLIENT_GENCRED_MD_CTX_FREE(ctx) EVP_MD_CTX_free((ctx))
+#else
+#   define CLIENT_GENCRED_PKEY_UP_REF(key) \
+        CRYPTO_add(&(key)->references, 1, CRYPTO_LOCK_EVP_PKEY)
+#   define CLIENT_GENCRED_MD_CTX_FREE(ctx) EVP_MD_CTX_cleanup((ctx))
+#endif
+
+/* number of private key files kept loaded */
+#define CLIENT_GENCRED_KEY_CACHE_SIZE 8
+
+/* a loaded private key and the identity of the file it came from, so
+   that a replaced key file is noticed */
+struct client_gencred_key
+{
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+    off_t size;
+    EVP_PKEY *privkey;
+};
+
+static struct client_gencred_key
+    client_gencred_keys[CLIENT_GENCRED_KEY_CACHE_SIZE];
+static int client_gencred_next_key = 0;
+static gen_mutex_t client_gencred_mutex = GEN_MUTEX_INITIALIZER;
+#ifndef HAVE_OPENSSL_1_1
+static int client_gencred_ssl_init = 0;
+#endif
+
+/* client_gencred_parse_id()
+ *
+ * Parses a numeric uid/gid string the way pvfs2-gencred does.
+ *
+ * returns 0 on success, -PVFS_EINVAL if str is not an id number.
+ */
+static int client_gencred_parse_id(const char *str, unsigned long *id)
+{
+    const char *pstr;
+    char *endptr;
+
+    if (str == NULL || *str == '\0')
+    {
+        return -PVFS_EINVAL;
+    }
+
+    for (pstr = str; *pstr; pstr++)
+    {
+        if (!isdigit(*pstr))
+        {
+            return -PVFS_EINVAL;
+        }
+    }
+
+    errno = 0;
+    *id = strtoul(str, &endptr, 10);
+    if (errno != 0 || *id > PVFS_UID_MAX)
+    {
+        return -PVFS_EINVAL;
+    }
+
+    return 0;
+}
+
+/* client_gencred_get_key()
+ *
+ * Returns a reference to the private key stored at keypath, reading and
+ * parsing the file only when it is not loaded yet or has been replaced
+ * since.  The caller drops the reference with EVP_PKEY_free().
+ *
+ * returns NULL if the calling user cannot read the key.
+ */
+static EVP_PKEY *client_gencred_get_key(const char *keypath)
+{
+    struct client_gencred_key *entry = NULL;
+    EVP_PKEY *privkey = NULL;
+    FILE *keyfile;
+    struct stat st;
+    int i;
+
+    /* the real user must be able to read the key; otherwise the setuid
+       pvfs2-gencred decides */
+    if (access(keypath, R_OK) != 0 || stat(keypath, &st) != 0)
+    {
+        return NULL;
+    }
+
+    gen_mutex_lock(&client_gencred_mutex);
+
+#ifndef HAVE_OPENSSL_1_1
+    if (!client_gencred_ssl_init)
+    {
+        OpenSSL_add_all_algorithms();
+        client_gencred_ssl_init = 1;
+    }
+#endif
+
+    for (i = 0; i < CLIENT_GENCRED_KEY_CACHE_SIZE; i++)
+    {
+        if (client_gencred_keys[i].path != NULL &&
+            strcmp(client_gencred_keys[i].path, keypath) == 0)
+        {
+            entry = &client_gencred_keys[i];
+            break;
+        }
+    }
+
+    if (entry != NULL && entry->privkey != NULL &&
+        entry->dev == st.st_dev && entry->ino == st.st_ino &&
+        entry->mtime == st.st_mtime && entry->size == st.st_size)
+    {
+        privkey = entry->privkey;
+        CLIENT_GENCRED_PKEY_UP_REF(privkey);
+        gen_mutex_unlock(&client_gencred_mutex);
+        return privkey;
+    }
+
+    keyfile = fopen(keypath, "rb");
+    if (keyfile == NULL)
+    {
+        gen_mutex_unlock(&client_gencred_mutex);
+        return NULL;
+    }
+
+    if (st.st_mode & (S_IROTH | S_IWOTH))
+    {
+        gossip_err("warning: insecure permissions on key file (%s)\n",
+                   keypath);
+    }
+
+    privkey = PEM_read_PrivateKey(keyfile, NULL, NULL, NULL);
+    fclose(keyfile);
+    if (privkey == NULL)
+    {
+        gossip_err("%s: cannot load private key %s\n", __func__, keypath);
+        ERR_clear_error();
+        gen_mutex_unlock(&client_gencred_mutex);
+        return NULL;
+    }
+
+    if (entry == NULL)
+    {
+        entry = &client_gencred_keys[client_gencred_next_key];
+        client_gencred_next_key = (client_gencred_next_key + 1) %
+            CLIENT_GENCRED_KEY_CACHE_SIZE;
+
+        free(entry->path);
+        entry->path = strdup(keypath);
+    }
+    if (entry->privkey != NULL)
+    {
+        EVP_PKEY_free(entry->privkey);
+        entry->privkey = NULL;
+    }
+
+    /* keep the key loaded, unless we could not record its path */
+    if (entry->path != NULL)
+    {
+        entry->dev = st.st_dev;
+        entry->ino = st.st_ino;
+        entry->mtime = st.st_mtime;
+        entry->size = st.st_size;
+        entry->privkey = privkey;
+        CLIENT_GENCRED_PKEY_UP_REF(privkey);
+    }
+
+    gen_mutex_unlock(&client_gencred_mutex);
+
+    gossip_debug(GOSSIP_SECURITY_DEBUG, "%s: loaded private key %s\n",
+                 __func__, keypath);
+
+    return privkey;
+}
+
+#ifdef ENABLE_SECURITY_CERT
+/* client_gencred_home_path()
+ *
+ * Builds the path of a file in the user's home directory.
+ */
+static int client_gencred_home_path(const struct passwd *pwd,
+                                    const char *file,
+                                    char *path)
+{
+    if (pwd == NULL ||
+        (strlen(pwd->pw_dir) + strlen(file)) >= (PATH_MAX - 1))
+    {
+        return -PVFS_ENAMETOOLONG;
+    }
+
+    strcpy(path, pwd->pw_dir);
+    strcat(path, file);
+
+    return 0;
+}
+
+/* client_gencred_add_cert()
+ *
+ * Reads the user certificate and stores it DER-encoded in the credential.
+ */
+static int client_gencred_add_cert(const char *certpath,
+                                   PVFS_credential *cred)
+{
+    FILE *f;
+    X509 *cert;
+    BIO *bio_mem = NULL;
+    char *cert_buf = NULL;
+    long cert_size;
+    int ret = -PVFS_ESECURITY;
+
+    f = fopen(certpath, "r");
+    if (f == NULL)
+    {
+        return -PVFS_errno_to_error(errno);
+    }
+
+    cert = PEM_read_X509(f, NULL, NULL, NULL);
+    fclose(f);
+    if (cert == NULL)
+    {
+        goto add_cert_exit;
+    }
+
+    bio_mem = BIO_new(BIO_s_mem());
+    if (bio_mem == NULL || i2d_X509_bio(bio_mem, cert) <= 0)
+    {
+        goto add_cert_exit;
+    }
+
+    cert_size = BIO_get_mem_data(bio_mem, &cert_buf);
+    if (cert_buf == NULL || cert_size <= 0)
+    {
+        goto add_cert_exit;
+    }
+
+    cred->certificate.buf = (PVFS_cert_data) malloc(cert_size);
+    if (cred->certificate.buf == NULL)
+    {
+        ret = -PVFS_ENOMEM;
+        goto add_cert_exit;
+    }
+    memcpy(cred->certificate.buf, cert_buf, cert_size);
+    cred->certificate.buf_size = (uint32_t) cert_size;
+
+    ret = 0;
+
+add_cert_exit:
+    if (ret != 0)
+    {
+        ERR_clear_error();
+    }
+    if (bio_mem != NULL)
+    {
+        BIO_free(bio_mem);
+    }
+    if (cert != NULL)
+    {
+        X509_free(cert);
+    }
+
+    return ret;
+}
+#else
+/* client_gencred_add_groups()
+ *
+ * Fills in the credential's group list: the requested group first, then
+ * the user's supplementary groups, or only the requested group if the
+ * list cannot be determined.
+ */
+static int client_gencred_add_groups(const struct passwd *pwd,
+                                     gid_t cred_gid,
+                                     PVFS_credential *cred)
+{
+    gid_t groups[PVFS_REQ_LIMIT_GROUPS];
+    int ngroups = 0, i;
+#ifdef HAVE_GETGROUPLIST_INT
+    int groups_int[PVFS_REQ_LIMIT_GROUPS];
+#endif
+
+#ifdef HAVE_GETGROUPLIST
+    if (pwd != NULL)
+    {
+        ngroups = sizeof(groups) / sizeof(*groups);
+#ifdef HAVE_GETGROUPLIST_INT
+        if (getgrouplist(pwd->pw_name, cred_gid, groups_int, &ngroups) == -1)
+        {
+            ngroups = 0;
+        }
+        for (i = 0; i < ngroups; i++)
+        {
+            if (groups_int[i] < 0)
+            {
+                ngroups = 0;
+                break;
+            }
+            groups[i] = (gid_t) groups_int[i];
+        }
+#else
+        if (getgrouplist(pwd->pw_name, cred_gid, groups, &ngroups) == -1)
+        {
+            ngroups = 0;
+        }
+#endif
+        /* primary gid may be in first or last position */
+        if (ngroups > 0 && groups[0] != cred_gid)
+        {
+            if (groups[ngroups-1] == cred_gid)
+            {
+                groups[ngroups-1] = groups[0];
+                groups[0] = cred_gid;
+            }
+            else
+            {
+                ngroups = 0;
+            }
+        }
+    }
+#endif /* HAVE_GETGROUPLIST */
+
+    if (ngroups == 0)
+    {
+        gossip_debug(GOSSIP_SECURITY_DEBUG, "%s: using primary group %u "
+                     "only\n", __func__, (unsigned int) cred_gid);
+        ngroups = 1;
+        groups[0] = cred_gid;
+    }
+
+    cred->group_array = calloc(ngroups, sizeof(PVFS_gid));
+    if (cred->group_array == NULL)
+    {
+        return -PVFS_ENOMEM;
+    }
+    for (i = 0; i < ngroups; i++)
+    {
+        cred->group_array[i] = (PVFS_gid) groups[i];
+    }
+    cred->num_groups = (uint32_t) ngroups;
+
+    return 0;
+}
+#endif /* ENABLE_SECURITY_CERT */
+
+/* client_gencred_sign_key()
+ *
+ * Signs the credential fields with privkey, over the same data and digest
+ * pvfs2-gencred uses.
+ */
+static int client_gencred_sign_key(PVFS_credential *cred, EVP_PKEY *privkey)
+{
+    EVP_MD_CTX *tmp_mdctx = NULL;
+#ifdef HAVE_OPENSSL_1_1
+    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+    tmp_mdctx = mdctx;
+#else
+    EVP_MD_CTX mdctx = {0};
+    tmp_mdctx = &mdctx;
+#endif
+    int ret;
+
+    if (tmp_mdctx == NULL)
+    {
+        return -PVFS_ENOMEM;
+    }
+
+    cred->sig_size = EVP_PKEY_size(privkey);
+    cred->signature = malloc(cred->sig_size);
+    if (cred->signature == NULL)
+    {
+        cred->sig_size = 0;
+        CLIENT_GENCRED_MD_CTX_FREE(tmp_mdctx);
+        return -PVFS_ENOMEM;
+    }
+
+    EVP_MD_CTX_init(tmp_mdctx);
+
+    ret = EVP_SignInit_ex(tmp_mdctx, EVP_sha1(), NULL);
+    ret &= EVP_SignUpdate(tmp_mdctx, &cred->userid, sizeof(PVFS_uid));
+    ret &= EVP_SignUpdate(tmp_mdctx, &cred->num_groups, sizeof(uint32_t));
+    if (cred->num_groups)
+    {
+        ret &= EVP_SignUpdate(tmp_mdctx, cred->group_array,
+                              cred->num_groups * sizeof(PVFS_gid));
+    }
+    if (cred->issuer)
+    {
+        ret &= EVP_SignUpdate(tmp_mdctx, cred->issuer,
+                              strlen(cred->issuer) * sizeof(char));
+    }
+    ret &= EVP_SignUpdate(tmp_mdctx, &cred->timeout, sizeof(PVFS_time));
+    if (ret)
+    {
+        ret = EVP_SignFinal(tmp_mdctx, cred->signature, &cred->sig_size,
+                            privkey);
+    }
+
+    CLIENT_GENCRED_MD_CTX_FREE(tmp_mdctx);
+
+    if (!ret)
+    {
+        gossip_err("%s: credential signing failed\n", __func__);
+        ERR_clear_error();
+        free(cred->signature);
+        cred->signature = NULL;
+        cred->sig_size = 0;
+        return -PVFS_ESECURITY;
+    }
+
+    return 0;
+}
+
+/* PINT_client_gencred_sign
+ *
+ * Generates and signs a credential in-process, with the same arguments and
+ * result as pvfs2-gencred.  Only root and the credential's own user may do
+ * this; other callers, and callers that cannot read the key, get
+ * -PVFS_EACCES and should use pvfs2-gencred, which applies the service user
+ * policy.
+ *
+ * returns 0 on success, negative PVFS error otherwise.
+ */
+int PINT_client_gencred_sign(const char *user,
+                             const char *group,
+                             unsigned int timeout,
+                             const char *keypath,
+                             const char *certpath,
+                             PVFS_credential *cred)
+{
+    uid_t curr_uid = getuid(), cred_uid;
+    gid_t curr_gid = getgid(), cred_gid;
+    unsigned long id;
+    struct passwd pwd, *presult = NULL;
+    char *pwdbuf = NULL, hostname[HOST_NAME_MAX+1];
+    size_t bufsize = 8192;
+    EVP_PKEY *privkey;
+#ifdef ENABLE_SECURITY_CERT
+    char def_keypath[PATH_MAX], def_certpath[PATH_MAX];
+#endif
+    int ret;
+
+    memset(cred, 0, sizeof(*cred));
+
+    cred_uid = curr_uid;
+    if (user != NULL)
+    {
+        ret = client_gencred_parse_id(user, &id);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        cred_uid = (uid_t) id;
+    }
+
+    cred_gid = curr_gid;
+    if (group != NULL)
+    {
+        ret = client_gencred_parse_id(group, &id);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        cred_gid = (gid_t) id;
+    }
+
+    if (!(curr_uid == 0 && curr_gid == 0) &&
+        !(curr_uid == cred_uid && curr_gid == cred_gid))
+    {
+        return -PVFS_EACCES;
+    }
+
+    /* user information; a missing user still gets a signed credential
+       with just the primary group, as from pvfs2-gencred */
+    do
+    {
+        free(pwdbuf);
+        pwdbuf = malloc(bufsize);
+        if (pwdbuf == NULL)
+        {
+            return -PVFS_ENOMEM;
+        }
+        ret = getpwuid_r(cred_uid, &pwd, pwdbuf, bufsize, &presult);
+        bufsize *= 8;
+    } while (ret == ERANGE && bufsize <= 8192 * 64);
+
+#ifdef ENABLE_SECURITY_CERT
+    /* in cert mode, the uid/gids are determined by server mapping */
+    if (keypath == NULL)
+    {
+        ret = client_gencred_home_path(presult, "/.pvfs2-cert-key.pem",
+                                       def_keypath);
+        if (ret < 0)
+        {
+            goto sign_error;
+        }
+        keypath = def_keypath;
+    }
+    if (certpath == NULL)
+    {
+        ret = client_gencred_home_path(presult, "/.pvfs2-cert.pem",
+                                       def_certpath);
+        if (ret < 0)
+        {
+            goto sign_error;
+        }
+        certpath = def_certpath;
+    }
+
+    cred->userid = PVFS_UID_MAX;
+    cred->num_groups = 1;
+    cred->group_array = calloc(1, sizeof(PVFS_gid));
+    if (cred->group_array == NULL)
+    {
+        ret = -PVFS_ENOMEM;
+        goto sign_error;
+    }
+    cred->group_array[0] = PVFS_GID_MAX;
+
+    ret = client_gencred_add_cert(certpath, cred);
+    if (ret < 0)
+    {
+        goto sign_error;
+    }
+#else
+    if (keypath == NULL)
+    {
+        keypath = PVFS2_DEFAULT_CREDENTIAL_KEYPATH;
+    }
+
+    cred->userid = (PVFS_uid) cred_uid;
+    ret = client_gencred_add_groups(presult, cred_gid, cred);
+    if (ret < 0)
+    {
+        goto sign_error;
+    }
+#endif /* ENABLE_SECURITY_CERT */
+
+    /* issuer field for clients is prefixed with "C:" */
+    cred->issuer = calloc(PVFS_REQ_LIMIT_ISSUER+1, 1);
+    if (cred->issuer == NULL)
+    {
+        ret = -PVFS_ENOMEM;
+        goto sign_error;
+    }
+    cred->issuer[0] = 'C';
+    cred->issuer[1] = ':';
+    gethostname(hostname, HOST_NAME_MAX);
+    hostname[sizeof(hostname)-1] = '\0';
+    strncpy(cred->issuer+2, hostname, PVFS_REQ_LIMIT_ISSUER-2);
+
+    cred->timeout = PINT_util_get_current_time() +
+        (timeout != 0 ? timeout : PVFS2_DEFAULT_CREDENTIAL_TIMEOUT);
+
+    privkey = client_gencred_get_key(keypath);
+    if (privkey == NULL)
+    {
+        ret = -PVFS_EACCES;
+        goto sign_error;
+    }
+
+    ret = client_gencred_sign_key(cred, privkey);
+    EVP_PKEY_free(privkey);
+    if (ret < 0)
+    {
+        goto sign_error;
+    }
+
+    free(pwdbuf);
+
+    return 0;
+
+sign_error:
+    free(pwdbuf);
+    PINT_cleanup_credential(cred);
+
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
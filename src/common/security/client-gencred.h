@@ -0,0 +1,30 @@
+/*
+ * (C) 2010-2014 Clemson University and The University of Chicago.
+ *
+ * See COPYING in top-level directory.
+ *
+ * In-process client credential signing definitions
+ *
+ */
+#ifndef __CLIENT_GENCRED_H
+#define __CLIENT_GENCRED_H
+
+#include "pvfs2-types.h"
+
+int PINT_client_gencred_sign(const char *user,
+                             const char *group,
+                             unsigned int timeout,
+                             const char *keypath,
+                             const char *certpath,
+                             PVFS_credential *cred);
+
+#endif /* __CLIENT_GENCRED_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -449,10 +449,16 @@ enum
     TCP_MODE_REND = 8
 };
 
-/* Allowable sizes for each mode */
+/* Allowable sizes for each mode.  TCP_MODE_UNEXP_LIMIT has to hold a
+ * small I/O request carrying PINT_SMALL_IO_MAXSIZE (pvfs2-req-proto.h)
+ * bytes of data plus its headers; change the two together.  Clients
+ * pack no more than the file system's SmallIOSize into one request, so
+ * a lower SmallIOSize keeps unexpected messages small regardless.
+ */
 enum
 {
     TCP_MODE_EAGER_LIMIT = 16384,	/* 16K */
+    TCP_MODE_UNEXP_LIMIT = 278528,	/* 256K of small I/O data + 16K */
     TCP_MODE_REND_LIMIT = 16777216	/* 16M */
 };
 
@@ -1206,7 +1212,7 @@ int BMI_tcp_get_info(int option,
 	break;
 
     case BMI_GET_UNEXP_SIZE:
-        *((int *) inout_parameter) = TCP_MODE_EAGER_LIMIT;
+        *((int *) inout_parameter) = TCP_MODE_UNEXP_LIMIT;
         ret = 0;
         break;
 
@@ -1311,7 +1317,7 @@ int BMI_tcp_post_sendunexpected(bmi_op_id_t *id,
     /* clear the id field for safety */
     *id = 0;
 
-    if (size > TCP_MODE_EAGER_LIMIT)
+    if (size > TCP_MODE_UNEXP_LIMIT)
     {
 	return (bmi_tcp_errno_to_pvfs(-EMSGSIZE));
     }
@@ -1787,7 +1793,7 @@ int BMI_tcp_post_sendunexpected_list(bmi_op_id_t *id,
     /* clear the id field for safety */
     *id = 0;
 
-    if (total_size > TCP_MODE_EAGER_LIMIT)
+    if (total_size > TCP_MODE_UNEXP_LIMIT)
     {
 	return (bmi_tcp_errno_to_pvfs(-EMSGSIZE));
     }
@@ -0,0 +1,677 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pvfs2-internal.h"
+#include "pvfs2-types.h"
+#include "pvfs2-mgmt.h"
+#include "block-cache.h"
+#include "quicklist.h"
+#include "quickhash.h"
+#include "gen-locks.h"
+#include "gossip.h"
+#include "pvfs2-debug.h"
+#include "pint-perf-counter.h"
+
+/* number of generation slots; handles hash onto these, so unrelated
+ * handles may occasionally share a slot and invalidate each other
+ */
+#define BCACHE_GEN_SLOTS 4096
+
+enum bcache_queue
+{
+    BCACHE_FREE = 0,
+    BCACHE_A1IN = 1,    /* resident, seen once */
+    BCACHE_AM = 2,      /* resident, seen again after leaving A1in */
+    BCACHE_A1OUT = 3    /* ghost: key only, data was evicted from A1in */
+};
+
+struct bcache_key
+{
+    PVFS_fs_id coll_id;
+    PVFS_handle handle;
+    PVFS_offset index;
+};
+
+struct bcache_block
+{
+    struct bcache_key key;
+    enum bcache_queue queue;
+    uint32_t epoch;             /* handle epoch the data belongs to */
+    uint32_t lo;                /* valid bytes are [lo, hi) of data */
+    uint32_t hi;
+    char *data;                 /* NULL for ghosts and free entries */
+    struct qhash_head hash_link;
+    struct qlist_head list_link;
+};
+
+/* gen is bumped by every invalidation of the handle and guards fills
+ * against racing writes; epoch is bumped when the whole handle is
+ * invalidated (resize, remove) and makes every resident block stale
+ */
+struct bcache_gen_slot
+{
+    uint32_t gen;
+    uint32_t epoch;
+};
+
+int PINT_bcache_active = 0;
+
+static gen_mutex_t bcache_mutex = GEN_MUTEX_INITIALIZER;
+static struct qhash_table *bcache_table = NULL;
+static struct bcache_block *bcache_entries = NULL;
+static struct bcache_gen_slot *bcache_gens = NULL;
+static char **bcache_spare = NULL;
+static int bcache_spare_count = 0;
+
+static QLIST_HEAD(bcache_a1in);
+static QLIST_HEAD(bcache_am);
+static QLIST_HEAD(bcache_a1out);
+static QLIST_HEAD(bcache_free);
+
+static int bcache_block_size = 0;
+static int bcache_block_shift = 0;
+static int bcache_nblocks = 0;      /* resident capacity */
+static int bcache_kin = 0;          /* A1in target size */
+static int bcache_kout = 0;         /* A1out (ghost) capacity */
+static int bcache_resident = 0;
+static int bcache_a1in_count = 0;
+static int bcache_a1out_count = 0;
+
+static uint64_t bcache_hit_bytes = 0;
+static uint64_t bcache_miss_bytes = 0;
+
+static int bcache_compare(const void *key, struct qhash_head *link);
+static int bcache_hash(const void *key, int table_size);
+
+/* PINT_bcache_init()
+ *
+ * allocates a block cache holding up to cache_size bytes of data in
+ * blocks of block_size bytes (a power of two).  A cache_size smaller
+ * than one block leaves the cache disabled.
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+int PINT_bcache_init(int64_t cache_size, int block_size)
+{
+    int entry_count;
+    int i;
+
+    if (block_size <= 0 || (block_size & (block_size - 1)))
+    {
+        return -PVFS_EINVAL;
+    }
+    if (cache_size < block_size)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&bcache_mutex);
+    if (PINT_bcache_active)
+    {
+        gen_mutex_unlock(&bcache_mutex);
+        return -PVFS_EALREADY;
+    }
+
+    bcache_block_size = block_size;
+    for (bcache_block_shift = 0; (1 << bcache_block_shift) < block_size;
+         bcache_block_shift++);
+    bcache_nblocks = (int)(cache_size / block_size);
+    bcache_kin = bcache_nblocks / 4 ? bcache_nblocks / 4 : 1;
+    bcache_kout = bcache_nblocks / 2 ? bcache_nblocks / 2 : 1;
+    entry_count = bcache_nblocks + bcache_kout + 1;
+
+    bcache_entries = calloc(entry_count, sizeof(struct bcache_block));
+    bcache_gens = calloc(BCACHE_GEN_SLOTS, sizeof(struct bcache_gen_slot));
+    bcache_spare = calloc(bcache_nblocks, sizeof(char *));
+    bcache_table = qhash_init(bcache_compare, bcache_hash,
+                              entry_count | 1);
+    if (!bcache_entries || !bcache_gens || !bcache_spare || !bcache_table)
+    {
+        free(bcache_entries);
+        free(bcache_gens);
+        free(bcache_spare);
+        if (bcache_table)
+        {
+            qhash_finalize(bcache_table);
+        }
+        bcache_entries = NULL;
+        bcache_gens = NULL;
+        bcache_spare = NULL;
+        bcache_table = NULL;
+        gen_mutex_unlock(&bcache_mutex);
+        return -PVFS_ENOMEM;
+    }
+
+    for (i = 0; i < entry_count; i++)
+    {
+        bcache_entries[i].queue = BCACHE_FREE;
+        qlist_add_tail(&bcache_entries[i].list_link, &bcache_free);
+    }
+    /* generation 0 is reserved to mean "do not fill" */
+    for (i = 0; i < BCACHE_GEN_SLOTS; i++)
+    {
+        bcache_gens[i].gen = 1;
+    }
+    bcache_spare_count = 0;
+    bcache_resident = 0;
+    bcache_a1in_count = 0;
+    bcache_a1out_count = 0;
+    bcache_hit_bytes = 0;
+    bcache_miss_bytes = 0;
+    PINT_bcache_active = 1;
+    gen_mutex_unlock(&bcache_mutex);
+
+    gossip_debug(GOSSIP_SERVER_DEBUG,
+                 "data block cache enabled (%d blocks of %d bytes)\n",
+                 bcache_nblocks, bcache_block_size);
+    return 0;
+}
+
+void PINT_bcache_finalize(void)
+{
+    struct bcache_block *b;
+    int i;
+
+    gen_mutex_lock(&bcache_mutex);
+    if (!PINT_bcache_active)
+    {
+        gen_mutex_unlock(&bcache_mutex);
+        return;
+    }
+    PINT_bcache_active = 0;
+
+    gossip_debug(GOSSIP_SERVER_DEBUG,
+                 "data block cache: %llu bytes hit, %llu bytes missed\n",
+                 llu(bcache_hit_bytes), llu(bcache_miss_bytes));
+
+    for (i = 0; i < bcache_nblocks + bcache_kout + 1; i++)
+    {
+        b = &bcache_entries[i];
+        if (b->data)
+        {
+            free(b->data);
+        }
+    }
+    for (i = 0; i < bcache_spare_count; i++)
+    {
+        free(bcache_spare[i]);
+    }
+    free(bcache_entries);
+    free(bcache_gens);
+    free(bcache_spare);
+    qhash_finalize(bcache_table);
+    bcache_entries = NULL;
+    bcache_gens = NULL;
+    bcache_spare = NULL;
+    bcache_table = NULL;
+    bcache_spare_count = 0;
+
+    INIT_QLIST_HEAD(&bcache_a1in);
+    INIT_QLIST_HEAD(&bcache_am);
+    INIT_QLIST_HEAD(&bcache_a1out);
+    INIT_QLIST_HEAD(&bcache_free);
+    gen_mutex_unlock(&bcache_mutex);
+}
+
+static int bcache_compare(const void *key, struct qhash_head *link)
+{
+    const struct bcache_key *k = key;
+    struct bcache_block *b = qhash_entry(link, struct bcache_block,
+                                         hash_link);
+
+    return (b->key.handle == k->handle && b->key.index == k->index &&
+            b->key.coll_id == k->coll_id);
+}
+
+static int bcache_hash(const void *key, int table_size)
+{
+    const struct bcache_key *k = key;
+    uint64_t h;
+
+    h = k->handle * 0x9e3779b97f4a7c15ULL;
+    h ^= (uint64_t)k->index * 0xc2b2ae3d27d4eb4fULL;
+    h ^= (uint64_t)(uint32_t)k->coll_id;
+    h ^= h >> 29;
+    return (int)(h % (uint64_t)table_size);
+}
+
+static struct bcache_gen_slot *bcache_gen_slot(PVFS_fs_id coll_id,
+                                               PVFS_handle handle)
+{
+    uint64_t h = (handle ^ (uint32_t)coll_id) * 0x9e3779b97f4a7c15ULL;
+
+    return &bcache_gens[(h >> 32) % BCACHE_GEN_SLOTS];
+}
+
+static struct bcache_block *bcache_lookup(PVFS_fs_id coll_id,
+                                          PVFS_handle handle,
+                                          PVFS_offset index)
+{
+    struct bcache_key key;
+    struct qhash_head *link;
+
+    key.coll_id = coll_id;
+    key.handle = handle;
+    key.index = index;
+    link = qhash_search(bcache_table, &key);
+    if (!link)
+    {
+        return NULL;
+    }
+    return qhash_entry(link, struct bcache_block, hash_link);
+}
+
+/* moves an entry back to the free list, keeping its buffer (if any) for
+ * reuse
+ */
+static void bcache_release(struct bcache_block *b)
+{
+    qhash_del(&b->hash_link);
+    qlist_del(&b->list_link);
+    if (b->queue == BCACHE_A1IN)
+    {
+        bcache_a1in_count--;
+    }
+    else if (b->queue == BCACHE_A1OUT)
+    {
+        bcache_a1out_count--;
+    }
+    if (b->data)
+    {
+        bcache_spare[bcache_spare_count++] = b->data;
+        b->data = NULL;
+        bcache_resident--;
+    }
+    b->queue = BCACHE_FREE;
+    qlist_add_tail(&b->list_link, &bcache_free);
+}
+
+/* bcache_evict()
+ *
+ * frees one resident block following 2Q: the oldest A1in block is
+ * demoted to a ghost in A1out while A1in is over its target size,
+ * otherwise the least recently used Am block is dropped
+ */
+static void bcache_evict(void)
+{
+    struct bcache_block *b;
+
+    if (bcache_a1in_count > bcache_kin || qlist_empty(&bcache_am))
+    {
+        b = qlist_entry(bcache_a1in.prev, struct bcache_block, list_link);
+        qlist_del(&b->list_link);
+        bcache_a1in_count--;
+        bcache_spare[bcache_spare_count++] = b->data;
+        b->data = NULL;
+        bcache_resident--;
+
+        b->queue = BCACHE_A1OUT;
+        qlist_add(&b->list_link, &bcache_a1out);
+        bcache_a1out_count++;
+        if (bcache_a1out_count > bcache_kout)
+        {
+            bcache_release(qlist_entry(bcache_a1out.prev,
+                                       struct bcache_block, list_link));
+        }
+    }
+    else
+    {
+        bcache_release(qlist_entry(bcache_am.prev,
+                                   struct bcache_block, list_link));
+    }
+}
+
+/* bcache_insert()
+ *
+ * creates a resident block for the given key, evicting if the cache is
+ * full.  A key that is still remembered in A1out goes straight to Am.
+ *
+ * returns the new block, or NULL if no memory could be allocated
+ */
+static struct bcache_block *bcache_insert(PVFS_fs_id coll_id,
+                                          PVFS_handle handle,
+                                          PVFS_offset index,
+                                          struct bcache_block *ghost,
+                                          uint32_t epoch)
+{
+    struct bcache_block *b;
+    enum bcache_queue queue = BCACHE_A1IN;
+
+    if (ghost)
+    {
+        bcache_release(ghost);
+        queue = BCACHE_AM;
+    }
+
+    if (bcache_resident >= bcache_nblocks)
+    {
+        bcache_evict();
+    }
+
+    if (!bcache_spare_count)
+    {
+        bcache_spare[bcache_spare_count] = malloc(bcache_block_size);
+        if (!bcache_spare[bcache_spare_count])
+        {
+            return NULL;
+        }
+        bcache_spare_count++;
+    }
+
+    b = qlist_entry(bcache_free.next, struct bcache_block, list_link);
+    qlist_del(&b->list_link);
+    b->data = bcache_spare[--bcache_spare_count];
+    bcache_resident++;
+
+    b->key.coll_id = coll_id;
+    b->key.handle = handle;
+    b->key.index = index;
+    b->epoch = epoch;
+    b->lo = 0;
+    b->hi = 0;
+    b->queue = queue;
+    qhash_add(bcache_table, &b->key, &b->hash_link);
+    if (queue == BCACHE_AM)
+    {
+        qlist_add(&b->list_link, &bcache_am);
+    }
+    else
+    {
+        qlist_add(&b->list_link, &bcache_a1in);
+        bcache_a1in_count++;
+    }
+    return b;
+}
+
+/* PINT_bcache_read_list()
+ *
+ * serves a bstream read list from the cache.  The read is only served
+ * if every byte is cached; otherwise nothing is copied and *gen_p is
+ * set to the generation to pass to PINT_bcache_fill_list() once the
+ * data has been read from Trove (0 if the data should not be cached).
+ *
+ * returns 1 if the read was served from the cache, 0 otherwise
+ */
+int PINT_bcache_read_list(PVFS_fs_id coll_id,
+                          PVFS_handle handle,
+                          char *buffer,
+                          const PVFS_offset *offset_array,
+                          const PVFS_size *size_array,
+                          int count,
+                          uint32_t *gen_p)
+{
+    struct bcache_gen_slot *slot;
+    struct bcache_block *b;
+    PVFS_offset pos, end;
+    PVFS_size total = 0;
+    uint32_t boff, len;
+    int i;
+
+    *gen_p = 0;
+    if (!PINT_bcache_active)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&bcache_mutex);
+    if (!PINT_bcache_active)
+    {
+        gen_mutex_unlock(&bcache_mutex);
+        return 0;
+    }
+    slot = bcache_gen_slot(coll_id, handle);
+
+    /* first pass: is everything here? */
+    for (i = 0; i < count; i++)
+    {
+        end = offset_array[i] + size_array[i];
+        for (pos = offset_array[i]; pos < end; pos += len)
+        {
+            boff = (uint32_t)(pos & (bcache_block_size - 1));
+            len = bcache_block_size - boff;
+            if (len > end - pos)
+            {
+                len = (uint32_t)(end - pos);
+            }
+            b = bcache_lookup(coll_id, handle, pos >> bcache_block_shift);
+            if (!b || !b->data || b->epoch != slot->epoch ||
+                boff < b->lo || boff + len > b->hi)
+            {
+                goto miss;
+            }
+        }
+        total += size_array[i];
+    }
+
+    /* second pass: copy out and update recency */
+    for (i = 0; i < count; i++)
+    {
+        end = offset_array[i] + size_array[i];
+        for (pos = offset_array[i]; pos < end; pos += len)
+        {
+            boff = (uint32_t)(pos & (bcache_block_size - 1));
+            len = bcache_block_size - boff;
+            if (len > end - pos)
+            {
+                len = (uint32_t)(end - pos);
+            }
+            b = bcache_lookup(coll_id, handle, pos >> bcache_block_shift);
+            memcpy(buffer, b->data + boff, len);
+            buffer += len;
+            /* 2Q leaves A1in blocks in FIFO order on a hit */
+            if (b->queue == BCACHE_AM)
+            {
+                qlist_del(&b->list_link);
+                qlist_add(&b->list_link, &bcache_am);
+            }
+        }
+    }
+    bcache_hit_bytes += total;
+    gen_mutex_unlock(&bcache_mutex);
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_BCACHE_HITS, total,
+                    PINT_PERF_ADD);
+    return 1;
+
+miss:
+    *gen_p = slot->gen;
+    for (total = 0, i = 0; i < count; i++)
+    {
+        total += size_array[i];
+    }
+    bcache_miss_bytes += total;
+    gen_mutex_unlock(&bcache_mutex);
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_BCACHE_MISSES, total,
+                    PINT_PERF_ADD);
+    return 0;
+}
+
+/* PINT_bcache_fill_list()
+ *
+ * stores data just read from Trove.  gen must be the value returned by
+ * the PINT_bcache_read_list() call made before the read was posted;
+ * if the handle has been written or invalidated since, the data may be
+ * stale and is not cached.
+ */
+void PINT_bcache_fill_list(PVFS_fs_id coll_id,
+                           PVFS_handle handle,
+                           uint32_t gen,
+                           const char *buffer,
+                           const PVFS_offset *offset_array,
+                           const PVFS_size *size_array,
+                           int count)
+{
+    struct bcache_gen_slot *slot;
+    struct bcache_block *b;
+    PVFS_offset pos, end, index;
+    uint32_t boff, len;
+    int i;
+
+    if (!gen || !PINT_bcache_active)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&bcache_mutex);
+    if (!PINT_bcache_active)
+    {
+        gen_mutex_unlock(&bcache_mutex);
+        return;
+    }
+    slot = bcache_gen_slot(coll_id, handle);
+    if (slot->gen != gen)
+    {
+        gen_mutex_unlock(&bcache_mutex);
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        end = offset_array[i] + size_array[i];
+        for (pos = offset_array[i]; pos < end; pos += len, buffer += len)
+        {
+            boff = (uint32_t)(pos & (bcache_block_size - 1));
+            len = bcache_block_size - boff;
+            if (len > end - pos)
+            {
+                len = (uint32_t)(end - pos);
+            }
+            index = pos >> bcache_block_shift;
+            b = bcache_lookup(coll_id, handle, index);
+            if (!b || !b->data)
+            {
+                b = bcache_insert(coll_id, handle, index, b, slot->epoch);
+                if (!b)
+                {
+                    gen_mutex_unlock(&bcache_mutex);
+                    return;
+                }
+            }
+            else if (b->epoch != slot->epoch)
+            {
+                b->epoch = slot->epoch;
+                b->lo = 0;
+                b->hi = 0;
+            }
+
+            memcpy(b->data + boff, buffer, len);
+            if (b->hi > b->lo && boff <= b->hi && boff + len >= b->lo)
+            {
+                /* extends the valid range */
+                if (boff < b->lo)
+                {
+                    b->lo = boff;
+                }
+                if (boff + len > b->hi)
+                {
+                    b->hi = boff + len;
+                }
+            }
+            else
+            {
+                b->lo = boff;
+                b->hi = boff + len;
+            }
+        }
+    }
+    gen_mutex_unlock(&bcache_mutex);
+}
+
+/* PINT_bcache_invalidate_list()
+ *
+ * drops the cached blocks overlapping a write list and makes pending
+ * fills of the handle stale.  Called both when a write is posted and
+ * when it completes.
+ */
+void PINT_bcache_invalidate_list(PVFS_fs_id coll_id,
+                                 PVFS_handle handle,
+                                 const PVFS_offset *offset_array,
+                                 const PVFS_size *size_array,
+                                 int count)
+{
+    struct bcache_gen_slot *slot;
+    struct bcache_block *b;
+    PVFS_offset index, last;
+    int i;
+
+    if (!PINT_bcache_active)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&bcache_mutex);
+    if (!PINT_bcache_active)
+    {
+        gen_mutex_unlock(&bcache_mutex);
+        return;
+    }
+    slot = bcache_gen_slot(coll_id, handle);
+    if (++slot->gen == 0)
+    {
+        slot->gen = 1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (size_array[i] <= 0)
+        {
+            continue;
+        }
+        last = (offset_array[i] + size_array[i] - 1) >> bcache_block_shift;
+        for (index = offset_array[i] >> bcache_block_shift; index <= last;
+             index++)
+        {
+            b = bcache_lookup(coll_id, handle, index);
+            if (b && b->data)
+            {
+                bcache_release(b);
+            }
+        }
+    }
+    gen_mutex_unlock(&bcache_mutex);
+}
+
+/* PINT_bcache_invalidate_handle()
+ *
+ * makes every cached block of a handle stale, for operations that
+ * change the bstream without a write list (resize, remove).  Stale
+ * blocks are reclaimed as they age out.
+ */
+void PINT_bcache_invalidate_handle(PVFS_fs_id coll_id,
+                                   PVFS_handle handle)
+{
+    struct bcache_gen_slot *slot;
+
+    if (!PINT_bcache_active)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&bcache_mutex);
+    if (PINT_bcache_active)
+    {
+        slot = bcache_gen_slot(coll_id, handle);
+        slot->epoch++;
+        if (++slot->gen == 0)
+        {
+            slot->gen = 1;
+        }
+    }
+    gen_mutex_unlock(&bcache_mutex);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,69 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Server data block cache.
+ *
+ * Caches fixed size, aligned blocks of bytestream data in memory so that
+ * repeated reads of hot data (small files, shared input decks) do not go
+ * to Trove every time.  Replacement follows the 2Q policy: blocks seen
+ * once enter a small FIFO (A1in) and are only promoted to the main LRU
+ * (Am) if they are read again after having aged out of the FIFO, which
+ * keeps a sequential scan from flushing the working set.
+ *
+ * Callers look up a read with PINT_bcache_read_list() before posting it
+ * to Trove; on a miss they get back a generation number which they pass
+ * to PINT_bcache_fill_list() once the read completes.  Writes invalidate
+ * the affected blocks when they are posted and again when they complete;
+ * a fill whose generation was overtaken by a write in between is ignored,
+ * so the cache never holds data older than a completed write.
+ */
+
+#ifndef __BLOCK_CACHE_H
+#define __BLOCK_CACHE_H
+
+#include "pvfs2-types.h"
+
+/* non-zero when the cache has been allocated */
+extern int PINT_bcache_active;
+
+int PINT_bcache_init(int64_t cache_size, int block_size);
+void PINT_bcache_finalize(void);
+
+int PINT_bcache_read_list(PVFS_fs_id coll_id,
+                          PVFS_handle handle,
+                          char *buffer,
+                          const PVFS_offset *offset_array,
+                          const PVFS_size *size_array,
+                          int count,
+                          uint32_t *gen_p);
+
+void PINT_bcache_fill_list(PVFS_fs_id coll_id,
+                           PVFS_handle handle,
+                           uint32_t gen,
+                           const char *buffer,
+                           const PVFS_offset *offset_array,
+                           const PVFS_size *size_array,
+                           int count);
+
+void PINT_bcache_invalidate_list(PVFS_fs_id coll_id,
+                                 PVFS_handle handle,
+                                 const PVFS_offset *offset_array,
+                                 const PVFS_size *size_array,
+                                 int count);
+
+void PINT_bcache_invalidate_handle(PVFS_fs_id coll_id,
+                                   PVFS_handle handle);
+
+#endif /* __BLOCK_CACHE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -12,6 +12,7 @@
 #include <pvfs2-debug.h>
 #include <pint-request.h>
 #include <pint-distribution.h>
+#include "pvfs2-dist-simple-stripe.h"
 #include "pvfs2-internal.h"
 
 #ifdef WIN32
@@ -20,6 +21,116 @@ typedef uint32_t u_int32_t;
 
 static PVFS_offset PINT_request_disp(PINT_Request *request);
 
+extern PINT_dist simple_stripe_dist;
+
+/* when set, PINT_distribute() maps simple_stripe files with the closed
+ * form below instead of calling through the distribution methods
+ */
+int PINT_distribute_fast_path = 1;
+
+/* Stripe geometry of the file being distributed, computed once per call
+ * to PINT_distribute().  For the simple_stripe distribution every
+ * mapping the loop needs has a closed form, which saves three indirect
+ * calls (and their divisions) per strip.
+ */
+typedef struct
+{
+    int simple;                 /* closed form applies */
+    PVFS_size strip_size;
+    PVFS_size stripe_size;      /* strip_size * server_ct */
+    PVFS_offset server_start;   /* offset of our strip within a stripe */
+} PINT_stripe_geom;
+
+static inline void geom_init(PINT_stripe_geom *geom,
+                             PINT_request_file_data *rfdata)
+{
+    PVFS_simple_stripe_params *dparam;
+
+    memset(geom, 0, sizeof(*geom));
+    if (PINT_distribute_fast_path &&
+        rfdata->dist->methods == simple_stripe_dist.methods)
+    {
+        dparam = (PVFS_simple_stripe_params *)rfdata->dist->params;
+        if (dparam->strip_size > 0 && rfdata->server_ct > 0)
+        {
+            geom->simple = 1;
+            geom->strip_size = dparam->strip_size;
+            geom->stripe_size = dparam->strip_size * rfdata->server_ct;
+            geom->server_start = dparam->strip_size * rfdata->server_nr;
+        }
+    }
+}
+
+static inline PVFS_offset geom_next_mapped_offset(
+    PINT_stripe_geom *geom,
+    PINT_request_file_data *rfdata,
+    PVFS_offset loff)
+{
+    PVFS_offset diff;
+
+    if (!geom->simple)
+    {
+        return (*rfdata->dist->methods->next_mapped_offset)
+            (rfdata->dist->params, rfdata, loff);
+    }
+    diff = (loff - geom->server_start) % geom->stripe_size;
+    if (diff < 0)
+    {
+        /* before our first strip */
+        return geom->server_start;
+    }
+    if (diff >= geom->strip_size)
+    {
+        /* past our strip in this stripe - go to the next one */
+        return loff + (geom->stripe_size - diff);
+    }
+    return loff;
+}
+
+static inline PVFS_offset geom_logical_to_physical_offset(
+    PINT_stripe_geom *geom,
+    PINT_request_file_data *rfdata,
+    PVFS_offset loff)
+{
+    PVFS_size full_stripes;
+    PVFS_offset leftover;
+    PVFS_offset poff;
+
+    if (!geom->simple)
+    {
+        return (*rfdata->dist->methods->logical_to_physical_offset)
+            (rfdata->dist->params, rfdata, loff);
+    }
+    full_stripes = loff / geom->stripe_size;
+    poff = full_stripes * geom->strip_size;
+    leftover = loff - full_stripes * geom->stripe_size;
+    if (leftover >= geom->server_start)
+    {
+        if (leftover < geom->server_start + geom->strip_size)
+        {
+            poff += leftover - geom->server_start;
+        }
+        else
+        {
+            poff += geom->strip_size;
+        }
+    }
+    return poff;
+}
+
+static inline PVFS_size geom_contiguous_length(
+    PINT_stripe_geom *geom,
+    PINT_request_file_data *rfdata,
+    PVFS_offset poff)
+{
+    if (!geom->simple)
+    {
+        return (*rfdata->dist->methods->contiguous_length)
+            (rfdata->dist->params, rfdata, poff);
+    }
+    return geom->strip_size - (poff % geom->strip_size);
+}
+
 /* this macro is only used in this file to add a segment to the
  * result list.
  */
@@ -554,6 +665,7 @@ PVFS_size PINT_distribute(PVFS_offset offset,
     PVFS_size   sz;      /* number of bytes in requested region after loff */
     PVFS_size   fraglen; /* length of physical strip contiguous on server */
     PVFS_size   retval;
+    PINT_stripe_geom geom;
 
     gossip_debug(GOSSIP_REQUEST_DEBUG,"\tPINT_distribute\n");
     gossip_debug(GOSSIP_REQUEST_DEBUG,
@@ -601,10 +713,10 @@ PVFS_size PINT_distribute(PVFS_offset offset,
         return 0;
     }
     
+    geom_init(&geom, rfdata);
+
     /* find next logical offset on this server */
-    loff = (*rfdata->dist->methods->next_mapped_offset)(rfdata->dist->params,
-                                                        rfdata,
-                                                        offset);
+    loff = geom_next_mapped_offset(&geom, rfdata, offset);
 
     /* If there is no data on this server, immediately return */
     if (-1 == loff)
@@ -612,6 +724,36 @@ PVFS_size PINT_distribute(PVFS_offset offset,
         gossip_debug(GOSSIP_REQUEST_DEBUG,"\t\treturn, dist says no data\n");
         return -1;
     }
+
+    /* On the server every strip of a simple_stripe file that falls in
+     * the region is physically adjacent to the previous one, so the
+     * whole region maps to a single segment.  Take that in one step
+     * unless a segment, byte or EOF limit would cut it short, in which
+     * case the loop below handles it strip by strip.
+     */
+    if (geom.simple && PINT_EQ_SERVER(mode) && (loff - offset) < size)
+    {
+        PVFS_offset pend;
+
+        poff = geom_logical_to_physical_offset(&geom, rfdata, loff);
+        pend = geom_logical_to_physical_offset(&geom, rfdata, offset + size);
+        sz = pend - poff;
+        if (result->segs + 1 < result->segmax &&
+            result->bytes + sz <= result->bytemax &&
+            (rfdata->extend_flag || pend <= rfdata->fsize))
+        {
+            gossip_debug(GOSSIP_REQUEST_DEBUG,
+                         "\t\tsimple stripe region po %lld sz %lld\n",
+                         lld(poff), lld(sz));
+            if (pend > rfdata->fsize)
+            {
+                rfdata->fsize = pend;
+            }
+            PINT_ADD_SEGMENT(result, poff, sz, mode);
+            *eof_flag = (pend >= rfdata->fsize && !rfdata->extend_flag);
+            return size;
+        }
+    }
     
     /* make sure loff is still within requested region */
     while ((diff = loff - offset) < size)
@@ -620,19 +762,13 @@ PVFS_size PINT_distribute(PVFS_offset offset,
                      lld(loff));
         
         /* find physical offset for this loff */
-        poff = (*rfdata->dist->methods->logical_to_physical_offset)
-            (rfdata->dist->params,
-             rfdata,
-             loff);
+        poff = geom_logical_to_physical_offset(&geom, rfdata, loff);
         
         /* find how much of requested region remains after loff */
         sz = size - diff;
         
         /* find how much data after loff/poff is on this server */
-        fraglen = (*rfdata->dist->methods->contiguous_length)
-            (rfdata->dist->params,
-             rfdata,
-             poff);
+        fraglen = geom_contiguous_length(&geom, rfdata, poff);
         
         /* compare that amount to amount of data in requested region */
         if (sz > fraglen && rfdata->server_ct != 1)
@@ -734,10 +870,7 @@ PVFS_size PINT_distribute(PVFS_offset offset,
         size  -= loff - offset;
         offset = loff;
         /* find next logical offset on this server */
-        loff = (*rfdata->dist->methods->next_mapped_offset)
-            (rfdata->dist->params,
-             rfdata,
-             offset);
+        loff = geom_next_mapped_offset(&geom, rfdata, offset);
         assert(-1 != loff);
         
         gossip_debug(GOSSIP_REQUEST_DEBUG,"\t\tend iteration\n");
@@ -758,8 +891,7 @@ PVFS_size PINT_distribute(PVFS_offset offset,
                  lld(result->bytemax));
     
     /* find physical offset for this loff */
-    poff = (*rfdata->dist->methods->logical_to_physical_offset)
-        (rfdata->dist->params, rfdata, loff);
+    poff = geom_logical_to_physical_offset(&geom, rfdata, loff);
     
     gossip_debug(GOSSIP_REQUEST_DEBUG,
                  "\t\t\tnext loff: %lld next poff: %lld\n",
@@ -122,6 +122,9 @@ int PINT_process_request(PINT_Request_state *req,
 		PINT_Request_result *result,
 		int mode);
 
+/* nonzero (the default) to map simple_stripe files in closed form */
+extern int PINT_distribute_fast_path;
+
 /* internal function */
 PVFS_size PINT_distribute(PVFS_offset offset,
                           PVFS_size size,
@@ -22,6 +22,8 @@
 #include <sys/ioctl.h>
 #include <sys/poll.h>
 #include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #endif
 #include <assert.h>
 #ifndef WIN32
@@ -61,6 +63,9 @@ static int parse_devices(
     const char *targetfile,
     const char *devname, 
     int *majornum);
+
+static int emu_connect(
+    const char *sock_name);
 #endif  /* __linux__ */
 
 
@@ -70,6 +75,8 @@ static int32_t pdev_magic;
 static int32_t pdev_max_upsize;
 static int32_t pdev_max_downsize;
 #endif  /* __linux__ */
+/* set when talking to a device emulator instead of the kernel module */
+static int pdev_emulated = 0;
 
 int32_t pvfs2_bufmap_total_size, pvfs2_bufmap_desc_size;
 int32_t pvfs2_bufmap_desc_count, pvfs2_bufmap_desc_shift;
@@ -101,6 +108,11 @@ int PINT_dev_initialize(
         debug_string = "none";
     }
 
+    if (flags & PINT_DEV_EMULATED)
+    {
+        return emu_connect(dev_name);
+    }
+
     /* we have to be root to access the device */
     if ((getuid() != 0) && (geteuid() != 0))
     {
@@ -335,7 +347,7 @@ int PINT_dev_get_mapped_regions(int ndesc, struct PVFS_dev_map_desc *desc,
         /* fixes a corruption issue on linux 2.4 kernels where the buffers are
          * not being pinned in memory properly 
          */
-        if(mlock( (const char *) ptr, total_size) != 0)
+        if(!pdev_emulated && mlock( (const char *) ptr, total_size) != 0)
         { 
            gossip_err("Error: FAILED to mlock shared buffer\n");
            break;
@@ -355,7 +367,7 @@ int PINT_dev_get_mapped_regions(int ndesc, struct PVFS_dev_map_desc *desc,
         /* ioctl to ask driver to map pages if needed */
         if (ioctl_cmd[i] != 0)
         {
-            ret = ioctl(pdev_fd, ioctl_cmd[i], &desc[i]);
+            ret = pdev_emulated ? 0 : ioctl(pdev_fd, ioctl_cmd[i], &desc[i]);
             if (ret < 0)
             {
                 gossip_err("Error: ioctl FAILED returned %d\n", errno);
@@ -407,7 +419,8 @@ void PINT_dev_put_mapped_regions(int ndesc, struct PVFS_dev_map_desc *desc)
          * not being pinned in memory properly
          */
 #ifndef WIN32
-        if(munlock( (const char *) ptr, desc[i].total_size) != 0)
+        if(!pdev_emulated &&
+           munlock( (const char *) ptr, desc[i].total_size) != 0)
         { 
            gossip_err("Error: FAILED to munlock shared buffer\n");
         }
@@ -811,6 +824,17 @@ int PINT_dev_write_list(
     free(buffer);
 #else
     ret = writev(pdev_fd, io_array, io_count);
+    while (ret < 0 && pdev_emulated && (errno == EAGAIN || errno == EINTR))
+    {
+        /* the device never refuses a downcall, but an emulator's socket
+         * queue can fill; wait for it to drain rather than drop it */
+        struct pollfd pfd;
+
+        pfd.fd = pdev_fd;
+        pfd.events = POLLOUT;
+        poll(&pfd, 1, -1);
+        ret = writev(pdev_fd, io_array, io_count);
+    }
 #endif
 
     if (ret == bytes_to_write) {
@@ -836,6 +860,11 @@ int PINT_dev_remount(void)
     int ret = -PVFS_EINVAL;
 
 #ifdef __linux__
+    if (pdev_emulated)
+    {
+        /* an emulator sends its mount upcalls on its own */
+        return 0;
+    }
     if (pdev_fd > -1)
     {
         ret = ((ioctl(pdev_fd, PVFS_DEV_REMOUNT_ALL, NULL) < 0) ?
@@ -1024,6 +1053,80 @@ static int parse_devices(
     fclose(devfile);
     return 0;
 }
+
+/* emu_connect()
+ *
+ * connects to a device emulator listening on the unix socket "sock_name"
+ * and reads the device parameters from its hello message.  Upcalls and
+ * downcalls then travel over the socket with the same framing the kernel
+ * device uses, one message per packet, so the rest of this interface
+ * works unchanged.  Used to load test pvfs2-client-core without the
+ * kernel module.
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int emu_connect(const char *sock_name)
+{
+    struct sockaddr_un addr;
+    struct PINT_dev_emu_hello hello;
+    int ret;
+
+    if (strlen(sock_name) >= sizeof(addr.sun_path))
+    {
+        return (-(PVFS_ENAMETOOLONG|PVFS_ERROR_DEV));
+    }
+
+    pdev_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (pdev_fd < 0)
+    {
+        return (-(PVFS_ENODEV|PVFS_ERROR_DEV));
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sock_name);
+    if (connect(pdev_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        gossip_err("Error: could not connect to device emulator %s: %s\n",
+                   sock_name, strerror(errno));
+        goto emu_error;
+    }
+
+    do
+    {
+        ret = recv(pdev_fd, &hello, sizeof(hello), 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret != sizeof(hello))
+    {
+        gossip_err("Error: no hello from device emulator %s\n", sock_name);
+        goto emu_error;
+    }
+    if (hello.proto_ver != PVFS_KERNEL_PROTO_VERSION)
+    {
+        gossip_err("Error: device emulator protocol version %d does not "
+                   "match %d.\n", hello.proto_ver, PVFS_KERNEL_PROTO_VERSION);
+        goto emu_error;
+    }
+
+    pdev_magic = hello.magic;
+    pdev_max_upsize = hello.max_upsize;
+    pdev_max_downsize = hello.max_downsize;
+
+    if (fcntl(pdev_fd, F_SETFL, O_NONBLOCK) < 0)
+    {
+        goto emu_error;
+    }
+
+    pdev_emulated = 1;
+    gossip_debug(GOSSIP_USER_DEV_DEBUG,
+                 "[DEV]: using device emulator %s\n", sock_name);
+    return 0;
+
+emu_error:
+    close(pdev_fd);
+    pdev_fd = -1;
+    return (-(PVFS_ENODEV|PVFS_ERROR_DEV));
+}
 #endif  /* __linux__ */
 
 /*
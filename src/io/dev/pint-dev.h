@@ -60,6 +60,22 @@ struct PINT_dev_params
     uint64_t dev_buffer_size;
 };
 
+/* PINT_dev_initialize() flag: dev_name is the path of a unix socket served
+ * by a device emulator rather than the kernel character device
+ */
+#define PINT_DEV_EMULATED 0x1
+
+/* first message a device emulator sends on connect; it stands in for the
+ * parameter ioctls of the real device
+ */
+struct PINT_dev_emu_hello
+{
+    int32_t proto_ver;
+    int32_t magic;
+    int32_t max_upsize;
+    int32_t max_downsize;
+};
+
 int PINT_dev_initialize(
     const char* dev_name,
     int flags);
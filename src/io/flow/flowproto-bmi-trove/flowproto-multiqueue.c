@@ -22,6 +22,7 @@
 #include "trove.h"
 #include "thread-mgr.h"
 #include "pint-perf-counter.h"
+#include "block-cache.h"
 #include "pvfs2-internal.h"
 
 /* the following buffer settings are used by default if none are specified in
@@ -56,6 +57,7 @@ struct result_chain_entry
     struct result_chain_entry *next;
     struct fp_queue_item *q_item;
     struct PINT_thread_mgr_trove_callback trove_callback;
+    uint32_t bcache_gen;
 };
 
 /* fp_queue_item describes an individual buffer being used within the flow */
@@ -943,6 +945,14 @@ static void trove_read_callback_fn(void *user_ptr,
         return;
     }
 
+    PINT_bcache_fill_list(q_item->parent->src.u.trove.coll_id,
+                          q_item->parent->src.u.trove.handle,
+                          result_tmp->bcache_gen,
+                          result_tmp->buffer_offset,
+                          result_tmp->result.offset_array,
+                          result_tmp->result.size_array,
+                          result_tmp->result.segs);
+
     /* don't do anything until the last read completes */
     if(q_item->result_chain_count > 1)
     {
@@ -1298,22 +1308,38 @@ static int bmi_send_callback_fn(void *user_ptr,
         tmp_user_ptr = result_tmp;
         assert(result_tmp->result.bytes);
 
-        ret = trove_bstream_read_list(q_item->parent->src.u.trove.coll_id,
-                                      q_item->parent->src.u.trove.handle,
-                                      (char**)&result_tmp->buffer_offset,
-                                      &result_tmp->result.bytes,
-                                      1,
-                                      result_tmp->result.offset_array,
-                                      result_tmp->result.size_array,
-                                      result_tmp->result.segs,
-                                      &q_item->out_size,
-                                      0, /* get_data_sync_mode(
-                                       q_item->parent->dest.u.trove.coll_id), */
-                                      NULL,
-                                      &result_tmp->trove_callback,
-                                      global_trove_context,
-                                      &result_tmp->posted_id,
-                                      flow_data->parent->hints);
+        if(PINT_bcache_read_list(q_item->parent->src.u.trove.coll_id,
+                                 q_item->parent->src.u.trove.handle,
+                                 result_tmp->buffer_offset,
+                                 result_tmp->result.offset_array,
+                                 result_tmp->result.size_array,
+                                 result_tmp->result.segs,
+                                 &result_tmp->bcache_gen))
+        {
+            /* served from the block cache */
+            q_item->out_size = result_tmp->result.bytes;
+            ret = 1;
+        }
+        else
+        {
+            ret = trove_bstream_read_list(
+                q_item->parent->src.u.trove.coll_id,
+                q_item->parent->src.u.trove.handle,
+                (char**)&result_tmp->buffer_offset,
+                &result_tmp->result.bytes,
+                1,
+                result_tmp->result.offset_array,
+                result_tmp->result.size_array,
+                result_tmp->result.segs,
+                &q_item->out_size,
+                0, /* get_data_sync_mode(
+                    q_item->parent->dest.u.trove.coll_id), */
+                NULL,
+                &result_tmp->trove_callback,
+                global_trove_context,
+                &result_tmp->posted_id,
+                flow_data->parent->hints);
+        }
 
         result_tmp = result_tmp->next;
 
@@ -1365,6 +1391,15 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
 
     result_tmp->posted_id = 0;
 
+    /* the blocks were invalidated when the write was posted; do it again
+     * in case a read that raced with the write refilled them
+     */
+    PINT_bcache_invalidate_list(q_item->parent->dest.u.trove.coll_id,
+                                q_item->parent->dest.u.trove.handle,
+                                result_tmp->result.offset_array,
+                                result_tmp->result.size_array,
+                                result_tmp->result.segs);
+
     if(error_code != 0 || flow_data->parent->error_code != 0)
     {
         gossip_err("%s: I/O error occurred\n", __func__);
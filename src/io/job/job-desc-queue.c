@@ -12,17 +12,72 @@
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/time.h>
 
 #include "job-desc-queue.h"
 #include "gossip.h"
 #include "id-generator.h"
 #include "pint-util.h"
+#include "pint-req-trace.h"
 #include "pvfs2-internal.h"
 
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 #ifdef WIN32
 typedef enum job_type job_type_t;
 #endif
 
+/* completion queue inboxes are lock-free stacks where the compiler
+ * provides atomics; otherwise they fall back to the wake mutex
+ */
+#ifdef __GNUC__
+#define JOB_DESC_CQ_LOCKFREE
+#endif
+
+#if defined(__GEN_POSIX_LOCKING__) && defined(__GNUC__)
+#define JOB_DESC_HAVE_CACHE
+
+/* Job descriptor cache
+ *
+ * Every job allocates a job_desc, and it is usually freed by whichever
+ * thread tests for its completion rather than the thread that posted it.
+ * Each thread keeps a magazine of free descriptors so that most allocs
+ * and frees take no lock; threads that mostly free hand full magazines
+ * to a shared depot, and threads that mostly allocate take them back.
+ */
+#define JOB_DESC_MAGAZINE_SIZE 64
+#define JOB_DESC_DEPOT_MAX 64   /* full magazines kept in the depot */
+
+struct job_desc_magazine
+{
+    int count;
+    struct job_desc *descs[JOB_DESC_MAGAZINE_SIZE];
+    struct job_desc_magazine *next;
+};
+
+static gen_mutex_t job_desc_depot_mutex = GEN_MUTEX_INITIALIZER;
+static struct job_desc_magazine *job_desc_depot_full = NULL;
+static struct job_desc_magazine *job_desc_depot_empty = NULL;
+static int job_desc_depot_full_count = 0;
+static pthread_once_t job_desc_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t job_desc_key;
+static int job_desc_key_created = 0;
+static __thread struct job_desc_magazine *job_desc_my_mag = NULL;
+
+static void job_desc_magazine_release(void *arg);
+static void job_desc_key_init(void);
+static struct job_desc_magazine *job_desc_magazine_get(void);
+static struct job_desc *job_desc_cache_get(void);
+static int job_desc_cache_put(struct job_desc *jd);
+#else
+#define job_desc_cache_get() NULL
+#define job_desc_cache_put(__jd) 0
+#endif /* JOB_DESC_HAVE_CACHE */
+
 /***************************************************************
  * Visible functions
  */
@@ -37,10 +92,14 @@ struct job_desc *alloc_job_desc(int type)
 {
     struct job_desc *jd = NULL;
 
-    jd = (struct job_desc *) malloc(sizeof(struct job_desc));
+    jd = job_desc_cache_get();
     if (!jd)
     {
-	return (NULL);
+        jd = (struct job_desc *) malloc(sizeof(struct job_desc));
+        if (!jd)
+        {
+            return (NULL);
+        }
     }
     memset(jd, 0, sizeof(struct job_desc));
 
@@ -52,6 +111,8 @@ struct job_desc *alloc_job_desc(int type)
     jd->type = type;
 #endif
 
+    jd->trace_post_us = PINT_REQ_TRACE_START();
+
     return (jd);
 };
 
@@ -64,7 +125,79 @@ struct job_desc *alloc_job_desc(int type)
 void dealloc_job_desc(struct job_desc *jd)
 {
     id_gen_safe_unregister(jd->job_id);
-    free(jd);
+    if (!job_desc_cache_put(jd))
+    {
+        free(jd);
+    }
+}
+
+/* job_desc_cache_finalize()
+ *
+ * releases descriptors held in the shared depot of the descriptor cache.
+ * Per-thread magazines are released when their threads exit.
+ *
+ * no return value
+ */
+void job_desc_cache_finalize(void)
+{
+#ifdef JOB_DESC_HAVE_CACHE
+    struct job_desc_magazine *mag;
+    int i;
+
+    gen_mutex_lock(&job_desc_depot_mutex);
+    while ((mag = job_desc_depot_full))
+    {
+        job_desc_depot_full = mag->next;
+        for (i = 0; i < mag->count; i++)
+        {
+            free(mag->descs[i]);
+        }
+        free(mag);
+    }
+    __atomic_store_n(&job_desc_depot_full_count, 0, __ATOMIC_RELAXED);
+    while ((mag = job_desc_depot_empty))
+    {
+        job_desc_depot_empty = mag->next;
+        free(mag);
+    }
+    gen_mutex_unlock(&job_desc_depot_mutex);
+#endif
+}
+
+/* job_desc_mark_completed()
+ *
+ * marks a job as completed
+ *
+ * returns 1 if this call completed the job, 0 if it was already complete
+ */
+int job_desc_mark_completed(struct job_desc *jd)
+{
+#ifdef JOB_DESC_CQ_LOCKFREE
+    return (__atomic_exchange_n(&jd->completed_flag, 1,
+                                __ATOMIC_ACQ_REL) == 0);
+#else
+    static gen_mutex_t flag_mutex = GEN_MUTEX_INITIALIZER;
+    int first;
+
+    gen_mutex_lock(&flag_mutex);
+    first = (jd->completed_flag == 0);
+    jd->completed_flag = 1;
+    gen_mutex_unlock(&flag_mutex);
+    return (first);
+#endif
+}
+
+/* job_desc_is_completed()
+ *
+ * returns 1 if the job has been marked completed, 0 otherwise
+ */
+int job_desc_is_completed(struct job_desc *jd)
+{
+#ifdef JOB_DESC_CQ_LOCKFREE
+    return (__atomic_load_n(&jd->completed_flag, __ATOMIC_ACQUIRE));
+#else
+    return (jd->completed_flag);
+#endif
 }
 
 /* job_desc_q_new()
@@ -172,6 +305,310 @@ struct job_desc *job_desc_q_shownext(job_desc_q_p jdqp)
 }
 
 
+/* job_desc_cq_new()
+ *
+ * creates a new completion queue
+ *
+ * returns pointer to queue on success, NULL on failure
+ */
+struct job_desc_cq *job_desc_cq_new(void)
+{
+    struct job_desc_cq *cq;
+
+    cq = (struct job_desc_cq *) malloc(sizeof(struct job_desc_cq));
+    if (!cq)
+    {
+        return (NULL);
+    }
+    memset(cq, 0, sizeof(struct job_desc_cq));
+    INIT_QLIST_HEAD(&cq->ready);
+    gen_mutex_init(&cq->mutex);
+#ifdef HAVE_SYS_EVENTFD_H
+    /* semaphore mode: each sleeping test call consumes one wakeup */
+    cq->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE);
+    if (cq->wake_fd < 0)
+    {
+        gossip_err("Error: unable to create completion queue eventfd: "
+                   "%s\n", strerror(errno));
+        gen_mutex_destroy(&cq->mutex);
+        free(cq);
+        return (NULL);
+    }
+#else
+    gen_mutex_init(&cq->wake_mutex);
+    gen_cond_init(&cq->wake_cond);
+#endif
+    return (cq);
+}
+
+/* job_desc_cq_cleanup()
+ *
+ * destroys a completion queue and any completed jobs still on it
+ *
+ * no return value
+ */
+void job_desc_cq_cleanup(struct job_desc_cq *cq)
+{
+    struct qlist_head *iterator = NULL;
+    struct qlist_head *scratch = NULL;
+
+    if (!cq)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&cq->mutex);
+    job_desc_cq_drain(cq);
+    qlist_for_each_safe(iterator, scratch, &cq->ready)
+    {
+        free(qlist_entry(iterator, struct job_desc, job_desc_q_link));
+    }
+    gen_mutex_unlock(&cq->mutex);
+
+#ifdef HAVE_SYS_EVENTFD_H
+    close(cq->wake_fd);
+#else
+    gen_cond_destroy(&cq->wake_cond);
+    gen_mutex_destroy(&cq->wake_mutex);
+#endif
+    gen_mutex_destroy(&cq->mutex);
+    free(cq);
+}
+
+/* job_desc_cq_push()
+ *
+ * adds a completed job to a completion queue.  Safe to call from any
+ * number of threads at once without holding cq->mutex.
+ *
+ * no return value
+ */
+void job_desc_cq_push(struct job_desc_cq *cq, struct job_desc *jd)
+{
+#ifdef JOB_DESC_CQ_LOCKFREE
+    struct job_desc *head = __atomic_load_n(&cq->inbox, __ATOMIC_RELAXED);
+
+    do
+    {
+        jd->cq_next = head;
+    } while (!__atomic_compare_exchange_n(&cq->inbox, &head, jd, 1,
+                                          __ATOMIC_SEQ_CST,
+                                          __ATOMIC_RELAXED));
+
+    /* pairs with the waiter count bump in job_desc_cq_wait().  Waiters
+     * recheck the inbox before sleeping and drain all of it once awake,
+     * so only the push that makes the inbox non-empty needs to wake them.
+     */
+    if (!head && __atomic_load_n(&cq->waiters, __ATOMIC_SEQ_CST))
+    {
+        job_desc_cq_wake(cq);
+    }
+#else
+    gen_mutex_lock(&cq->wake_mutex);
+    jd->cq_next = cq->inbox;
+    cq->inbox = jd;
+    if (cq->waiters)
+    {
+        gen_cond_broadcast(&cq->wake_cond);
+    }
+    gen_mutex_unlock(&cq->wake_mutex);
+#endif
+}
+
+/* job_desc_cq_drain()
+ *
+ * moves everything pushed so far onto the ready list in completion
+ * order.  Caller must hold cq->mutex.
+ *
+ * no return value
+ */
+void job_desc_cq_drain(struct job_desc_cq *cq)
+{
+    struct job_desc *list;
+    struct job_desc *next;
+    struct qlist_head *anchor;
+
+#ifdef JOB_DESC_CQ_LOCKFREE
+    if (!__atomic_load_n(&cq->inbox, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    list = __atomic_exchange_n(&cq->inbox, NULL, __ATOMIC_ACQUIRE);
+#else
+    gen_mutex_lock(&cq->wake_mutex);
+    list = cq->inbox;
+    cq->inbox = NULL;
+    gen_mutex_unlock(&cq->wake_mutex);
+#endif
+
+    /* the inbox is newest first; inserting each entry right behind the
+     * old tail of the ready list puts them back in completion order
+     */
+    anchor = cq->ready.prev;
+    for (; list; list = next)
+    {
+        next = list->cq_next;
+        qlist_add(&list->job_desc_q_link, anchor);
+        list->ready_flag = 1;
+    }
+}
+
+/* job_desc_cq_shownext()
+ *
+ * returns the oldest completed job without removing it, or NULL if
+ * there is none.  Caller must hold cq->mutex.
+ */
+struct job_desc *job_desc_cq_shownext(struct job_desc_cq *cq)
+{
+    job_desc_cq_drain(cq);
+    if (qlist_empty(&cq->ready))
+    {
+        return (NULL);
+    }
+    return (qlist_entry(cq->ready.next, struct job_desc, job_desc_q_link));
+}
+
+/* job_desc_cq_remove()
+ *
+ * removes a job from the ready list of its completion queue.  Caller
+ * must hold the queue's mutex.
+ *
+ * no return value
+ */
+void job_desc_cq_remove(struct job_desc *jd)
+{
+    assert(jd->ready_flag);
+    qlist_del(&jd->job_desc_q_link);
+    jd->ready_flag = 0;
+}
+
+/* job_desc_cq_pending()
+ *
+ * returns 1 if any completed jobs are waiting on the queue, 0 otherwise.
+ * Caller must hold cq->mutex.
+ */
+int job_desc_cq_pending(struct job_desc_cq *cq)
+{
+    if (!qlist_empty(&cq->ready))
+    {
+        return (1);
+    }
+#ifdef JOB_DESC_CQ_LOCKFREE
+    return (__atomic_load_n(&cq->inbox, __ATOMIC_RELAXED) != NULL);
+#else
+    return (cq->inbox != NULL);
+#endif
+}
+
+/* job_desc_cq_wake()
+ *
+ * wakes every test call sleeping on the queue
+ *
+ * no return value
+ */
+void job_desc_cq_wake(struct job_desc_cq *cq)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t count = __atomic_load_n(&cq->waiters, __ATOMIC_SEQ_CST);
+    ssize_t ret;
+
+    if (count)
+    {
+        ret = write(cq->wake_fd, &count, sizeof(count));
+        (void) ret;
+    }
+#else
+    gen_mutex_lock(&cq->wake_mutex);
+    gen_cond_broadcast(&cq->wake_cond);
+    gen_mutex_unlock(&cq->wake_mutex);
+#endif
+}
+
+/* job_desc_cq_wait()
+ *
+ * sleeps until something is pushed onto the queue or abstime passes
+ * (NULL waits forever).  Caller must hold cq->mutex; it is released
+ * while sleeping and held again on return.
+ *
+ * returns 0 when woken, ETIMEDOUT on timeout, or another errno value
+ */
+int job_desc_cq_wait(struct job_desc_cq *cq, const struct timespec *abstime)
+{
+    int ret = 0;
+#ifdef HAVE_SYS_EVENTFD_H
+    struct pollfd pfd;
+    struct timeval now;
+    uint64_t token;
+    long timeout_ms = -1;
+    ssize_t rret;
+
+    __atomic_add_fetch(&cq->waiters, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&cq->inbox, __ATOMIC_SEQ_CST))
+    {
+        if (abstime)
+        {
+            gettimeofday(&now, NULL);
+            timeout_ms = (abstime->tv_sec - now.tv_sec) * 1000 +
+                (abstime->tv_nsec / 1000 - now.tv_usec) / 1000;
+            if (timeout_ms < 0)
+            {
+                timeout_ms = 0;
+            }
+        }
+
+        gen_mutex_unlock(&cq->mutex);
+        pfd.fd = cq->wake_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, (int) timeout_ms);
+        if (ret > 0)
+        {
+            rret = read(cq->wake_fd, &token, sizeof(token));
+            (void) rret;
+            ret = 0;
+        }
+        else if (ret == 0)
+        {
+            ret = ETIMEDOUT;
+        }
+        else
+        {
+            ret = errno;
+        }
+        gen_mutex_lock(&cq->mutex);
+    }
+    __atomic_sub_fetch(&cq->waiters, 1, __ATOMIC_SEQ_CST);
+#else
+    gen_mutex_unlock(&cq->mutex);
+    gen_mutex_lock(&cq->wake_mutex);
+#ifdef JOB_DESC_CQ_LOCKFREE
+    __atomic_add_fetch(&cq->waiters, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&cq->inbox, __ATOMIC_SEQ_CST))
+#else
+    cq->waiters++;
+    if (!cq->inbox)
+#endif
+    {
+        if (abstime)
+        {
+            ret = gen_cond_timedwait(&cq->wake_cond, &cq->wake_mutex,
+                                     abstime);
+        }
+        else
+        {
+            ret = gen_cond_wait(&cq->wake_cond, &cq->wake_mutex);
+        }
+    }
+#ifdef JOB_DESC_CQ_LOCKFREE
+    __atomic_sub_fetch(&cq->waiters, 1, __ATOMIC_SEQ_CST);
+#else
+    cq->waiters--;
+#endif
+    gen_mutex_unlock(&cq->wake_mutex);
+    gen_mutex_lock(&cq->mutex);
+#endif
+    return (ret);
+}
+
 /* job_desc_q_dump()
  *
  * prints out the contents of the desired job desc queue
@@ -228,6 +665,178 @@ void job_desc_q_dump(job_desc_q_p jdqp)
     return;
 }
 
+#ifdef JOB_DESC_HAVE_CACHE
+/* job_desc_magazine_release()
+ *
+ * thread exit hook; hands the thread's magazine back to the depot
+ *
+ * no return value
+ */
+static void job_desc_magazine_release(void *arg)
+{
+    struct job_desc_magazine *mag = arg;
+    int i;
+
+    job_desc_my_mag = NULL;
+    gen_mutex_lock(&job_desc_depot_mutex);
+    if (mag->count > 0 &&
+        job_desc_depot_full_count < JOB_DESC_DEPOT_MAX)
+    {
+        mag->next = job_desc_depot_full;
+        job_desc_depot_full = mag;
+        __atomic_add_fetch(&job_desc_depot_full_count, 1, __ATOMIC_RELAXED);
+        mag = NULL;
+    }
+    gen_mutex_unlock(&job_desc_depot_mutex);
+
+    if (mag)
+    {
+        for (i = 0; i < mag->count; i++)
+        {
+            free(mag->descs[i]);
+        }
+        free(mag);
+    }
+}
+
+static void job_desc_key_init(void)
+{
+    if (pthread_key_create(&job_desc_key, job_desc_magazine_release) == 0)
+    {
+        job_desc_key_created = 1;
+    }
+}
+
+/* job_desc_magazine_get()
+ *
+ * returns the calling thread's magazine, creating it if needed, or NULL
+ * if the cache cannot be used
+ */
+static struct job_desc_magazine *job_desc_magazine_get(void)
+{
+    struct job_desc_magazine *mag = job_desc_my_mag;
+
+    if (mag)
+    {
+        return (mag);
+    }
+
+    pthread_once(&job_desc_key_once, job_desc_key_init);
+    if (!job_desc_key_created)
+    {
+        return (NULL);
+    }
+    mag = calloc(1, sizeof(*mag));
+    if (!mag)
+    {
+        return (NULL);
+    }
+    pthread_setspecific(job_desc_key, mag);
+    job_desc_my_mag = mag;
+    return (mag);
+}
+
+/* job_desc_cache_get()
+ *
+ * returns a free descriptor from the cache, or NULL if it is empty
+ */
+static struct job_desc *job_desc_cache_get(void)
+{
+    struct job_desc_magazine *mag = job_desc_magazine_get();
+    struct job_desc_magazine *full = NULL;
+
+    if (!mag)
+    {
+        return (NULL);
+    }
+
+    if (mag->count == 0 &&
+        __atomic_load_n(&job_desc_depot_full_count, __ATOMIC_RELAXED))
+    {
+        /* trade our empty magazine for a full one */
+        gen_mutex_lock(&job_desc_depot_mutex);
+        full = job_desc_depot_full;
+        if (full)
+        {
+            job_desc_depot_full = full->next;
+            __atomic_sub_fetch(&job_desc_depot_full_count, 1,
+                               __ATOMIC_RELAXED);
+            mag->next = job_desc_depot_empty;
+            job_desc_depot_empty = mag;
+        }
+        gen_mutex_unlock(&job_desc_depot_mutex);
+
+        if (full)
+        {
+            pthread_setspecific(job_desc_key, full);
+            job_desc_my_mag = full;
+            mag = full;
+        }
+    }
+
+    if (mag->count == 0)
+    {
+        return (NULL);
+    }
+    return (mag->descs[--mag->count]);
+}
+
+/* job_desc_cache_put()
+ *
+ * returns a descriptor to the cache
+ *
+ * returns 1 if the cache kept it, 0 if the caller should free it
+ */
+static int job_desc_cache_put(struct job_desc *jd)
+{
+    struct job_desc_magazine *mag = job_desc_magazine_get();
+    struct job_desc_magazine *empty = NULL;
+
+    if (!mag)
+    {
+        return (0);
+    }
+
+    if (mag->count == JOB_DESC_MAGAZINE_SIZE)
+    {
+        /* trade our full magazine for an empty one */
+        gen_mutex_lock(&job_desc_depot_mutex);
+        if (job_desc_depot_full_count < JOB_DESC_DEPOT_MAX)
+        {
+            empty = job_desc_depot_empty;
+            if (empty)
+            {
+                job_desc_depot_empty = empty->next;
+            }
+            else
+            {
+                empty = calloc(1, sizeof(*empty));
+            }
+            if (empty)
+            {
+                empty->count = 0;
+                mag->next = job_desc_depot_full;
+                job_desc_depot_full = mag;
+                __atomic_add_fetch(&job_desc_depot_full_count, 1,
+                                   __ATOMIC_RELAXED);
+            }
+        }
+        gen_mutex_unlock(&job_desc_depot_mutex);
+
+        if (!empty)
+        {
+            return (0);
+        }
+        pthread_setspecific(job_desc_key, empty);
+        job_desc_my_mag = empty;
+        mag = empty;
+    }
+
+    mag->descs[mag->count++] = jd;
+    return (1);
+}
+#endif /* JOB_DESC_HAVE_CACHE */
+
 /*
  * Local variables:
  *  c-indent-level: 4
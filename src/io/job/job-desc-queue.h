@@ -11,6 +11,8 @@
 #ifndef __JOB_DESC_QUEUE_H
 #define __JOB_DESC_QUEUE_H
 
+#include <time.h>
+
 #include "pvfs2-internal.h"
 #include "quicklist.h"
 #include "job.h"
@@ -18,6 +20,7 @@
 #include "trove-types.h"
 #include "src/server/request-scheduler/request-scheduler.h"
 #include "thread-mgr.h"
+#include "gen-locks.h"
 
 /* describes BMI operations */
 struct bmi_desc
@@ -126,6 +129,7 @@ struct job_desc
     struct PINT_thread_mgr_bmi_callback bmi_callback;  /* callback information */
     struct PINT_thread_mgr_trove_callback trove_callback;  /* callback information */
     PVFS_hint hints;
+    PVFS_time trace_post_us;    /* post time, if request tracing is on */
 
     /* union of information for lower level interfaces */
     union
@@ -144,10 +148,30 @@ struct job_desc
     struct qlist_head job_desc_q_link;	/* queue link */
     struct qlist_head job_time_link;	/* queue link */
     void* time_bucket;
+    struct job_desc *cq_next;   /* link while in a completion queue inbox */
+    int ready_flag;             /* on a completion queue's ready list? */
 };
 
 typedef struct qlist_head *job_desc_q_p;
 
+/* per-context completion queue.  Threads that complete jobs push them
+ * onto the inbox without taking a lock; test calls drain the inbox into
+ * the ready list under the mutex, and only sleep when both are empty.
+ */
+struct job_desc_cq
+{
+    struct job_desc *inbox;     /* newly completed jobs, newest first */
+    struct qlist_head ready;    /* drained jobs in completion order */
+    gen_mutex_t mutex;          /* protects ready and jobs on it */
+    int waiters;                /* test calls sleeping on this queue */
+#ifdef HAVE_SYS_EVENTFD_H
+    int wake_fd;
+#else
+    gen_mutex_t wake_mutex;
+    gen_cond_t wake_cond;
+#endif
+};
+
 struct job_desc *alloc_job_desc(int type);
 void dealloc_job_desc(struct job_desc *jd);
 job_desc_q_p job_desc_q_new(void);
@@ -158,6 +182,21 @@ void job_desc_q_remove(struct job_desc *desc);
 int job_desc_q_empty(job_desc_q_p jdqp);
 struct job_desc *job_desc_q_shownext(job_desc_q_p jdqp);
 void job_desc_q_dump(job_desc_q_p jdqp);
+void job_desc_cache_finalize(void);
+
+int job_desc_mark_completed(struct job_desc *jd);
+int job_desc_is_completed(struct job_desc *jd);
+
+struct job_desc_cq *job_desc_cq_new(void);
+void job_desc_cq_cleanup(struct job_desc_cq *cq);
+void job_desc_cq_push(struct job_desc_cq *cq, struct job_desc *jd);
+void job_desc_cq_drain(struct job_desc_cq *cq);
+struct job_desc *job_desc_cq_shownext(struct job_desc_cq *cq);
+void job_desc_cq_remove(struct job_desc *jd);
+int job_desc_cq_pending(struct job_desc_cq *cq);
+void job_desc_cq_wake(struct job_desc_cq *cq);
+int job_desc_cq_wait(struct job_desc_cq *cq,
+                     const struct timespec *abstime);
 
 #endif /* __JOB_DESC_QUEUE_H */
 
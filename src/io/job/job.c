@@ -26,6 +26,7 @@
 #include "gossip.h"
 #include "id-generator.h"
 #include "job-time-mgr.h"
+#include "pint-req-trace.h"
 #include "pvfs2-internal.h"
 
 /* contexts for use within the job interface */
@@ -35,7 +36,7 @@ static TROVE_context_id global_trove_context = -1;
 #endif
 
 /* queues of pending jobs */
-static job_desc_q_p completion_queue_array[JOB_MAX_CONTEXTS] = {NULL};
+static struct job_desc_cq* completion_queue_array[JOB_MAX_CONTEXTS] = {NULL};
 static int completion_error = 0;
 static job_desc_q_p bmi_unexp_queue = NULL;
 static int bmi_unexp_pending_count = 0;
@@ -49,15 +50,14 @@ static int dev_unexp_pending_count = 0;
 /* locks for internal queues */
 static gen_mutex_t bmi_unexp_mutex = GEN_MUTEX_INITIALIZER;
 static gen_mutex_t dev_unexp_mutex = GEN_MUTEX_INITIALIZER;
-static gen_mutex_t completion_mutex = GEN_MUTEX_INITIALIZER;
+/* protects opening and closing contexts; each completion queue has its
+ * own lock for test calls, and completing a job takes no lock at all
+ */
+static gen_mutex_t context_mutex = GEN_MUTEX_INITIALIZER;
 
 static int initialized = 0;
 static gen_mutex_t initialized_mutex = GEN_MUTEX_INITIALIZER;
 
-#ifdef __PVFS2_JOB_THREADED__
-static pthread_cond_t completion_cond = PTHREAD_COND_INITIALIZER;
-#endif /* __PVFS2_JOB_THREADED__ */
-
 /* number of jobs to test for at once inside of do_one_work_cycle() */
 enum
 {
@@ -70,6 +70,17 @@ enum
  */
 #define PRECREATE_POOL_MAX_KEYS 32
 
+/* number of handles claimed at once from a pool's keyval space into its
+ * in-memory cache.  get_handles() is served from the cache, and another
+ * claim is posted in the background when it drops below half of this.
+ */
+#define PRECREATE_POOL_CLAIM_BATCH 64
+
+/* set in the low order (per pool) bits of an iterate_handles() position
+ * while walking a pool's in-memory cache instead of its keyvals
+ */
+#define PRECREATE_POOL_POS_CACHED 0x80000000ULL
+
 #ifdef __PVFS2_TROVE_SUPPORT__
 
 static gen_mutex_t precreate_pool_mutex = GEN_MUTEX_INITIALIZER;
@@ -81,9 +92,30 @@ struct precreate_pool
 {
     struct qlist_head list_link;
     char* host;
+    PVFS_fs_id fsid;
     PVFS_handle pool_handle;
-    uint32_t pool_count; 
+    int32_t pool_count;         /* handles in keyval space plus cache */
     PVFS_ds_type pool_type;     /* ds type of pool */
+
+    /* ring of handles already removed from the keyval space, ready to be
+     * handed out without touching trove
+     */
+    PVFS_handle* cache;
+    int cache_size;
+    int cache_head;
+    int cache_count;
+
+    /* background claim of handles from the keyval space into the cache */
+    int claim_pending;
+    int claim_requested;
+    int claim_count;
+    int claim_size;
+    PVFS_ds_position claim_pos;
+    PVFS_handle* claim_handles;
+    TROVE_keyval_s* claim_keys;
+    struct PINT_thread_mgr_trove_callback claim_callback;
+
+    int need;                   /* scratch space for get_handles() */
 };
 
 struct fs_pool
@@ -97,16 +129,6 @@ struct fs_pool
     struct qlist_head* precreate_pool_initial;
 };
 
-struct precreate_pool_get_trove
-{
-    struct job_desc* jd; /* parent job descriptor */
-    /* variables needed per keyval_iterate_keys() call */
-    PVFS_ds_position pos;
-    PVFS_ds_keyval key;
-    int count;
-    struct PINT_thread_mgr_trove_callback trove_callback;
-    struct precreate_pool* pool;
-};
 #endif /* __PVFS2_TROVE_SUPPORT__ */
 
 /********************************************************
@@ -116,6 +138,9 @@ struct precreate_pool_get_trove
 static int setup_queues(void);
 static void teardown_queues(void);
 static int do_one_test_cycle_req_sched(void);
+static int job_initialized(void);
+static void job_complete(struct job_desc *jd);
+static void job_push_completion(struct job_desc *jd);
 static void fill_status(struct job_desc *jd,
                         void **returned_user_ptr_p,
                         job_status_s * status);
@@ -123,7 +148,8 @@ static int completion_query_some(job_id_t * id_array,
                                  int *inout_count_p,
                                  int *out_index_array,
                                  void **returned_user_ptr_array,
-                                 job_status_s * out_status_array_p);
+                                 job_status_s * out_status_array_p,
+                                 job_context_id context_id);
 static int completion_query_context(job_id_t * out_id_array_p,
                                   int *inout_count_p,
                                   void **returned_user_ptr_array,
@@ -145,10 +171,7 @@ static gen_mutex_t work_cycle_mutex = GEN_MUTEX_INITIALIZER;
 static void do_one_work_cycle_all(int idle_time_ms);
 #endif
 #ifdef __PVFS2_TROVE_SUPPORT__
-static void precreate_pool_get_thread_mgr_callback(
-    void* data, 
-    PVFS_error error_code);
-static void precreate_pool_get_thread_mgr_callback_unlocked(
+static void precreate_pool_claim_callback(
     void* data, 
     PVFS_error error_code);
 static void precreate_pool_fill_thread_mgr_callback(
@@ -157,7 +180,8 @@ static void precreate_pool_fill_thread_mgr_callback(
 static void precreate_pool_iterate_callback(
     void* data, 
     PVFS_error error_code);
-static void precreate_pool_get_handles_try_post(struct job_desc* jd);
+static int precreate_pool_get_handles_try_post(struct job_desc* jd);
+static int precreate_pool_claim_post(struct precreate_pool* pool, int count);
 static struct fs_pool* find_fs(PVFS_fs_id fsid);
 #endif
 
@@ -221,7 +245,11 @@ int job_initialize(int flags)
     id_gen_safe_initialize();
 
     gen_mutex_lock(&initialized_mutex);
+#ifdef __GNUC__
+    __atomic_store_n(&initialized, 1, __ATOMIC_RELEASE);
+#else
     initialized = 1;
+#endif
     gen_mutex_unlock(&initialized_mutex);
 
     return (0);
@@ -236,7 +264,11 @@ int job_initialize(int flags)
 int job_finalize(void)
 {
     gen_mutex_lock(&initialized_mutex);
+#ifdef __GNUC__
+    __atomic_store_n(&initialized, 0, __ATOMIC_RELEASE);
+#else
     initialized = 0;
+#endif
     gen_mutex_unlock(&initialized_mutex);
 
     id_gen_safe_finalize();
@@ -249,6 +281,7 @@ int job_finalize(void)
     PINT_thread_mgr_trove_stop();
 #endif
     teardown_queues();
+    job_desc_cache_finalize();
     return 0;
 }
 
@@ -264,7 +297,7 @@ int job_open_context(job_context_id* context_id)
     int context_index;
 
     /* find an unused context id */
-    gen_mutex_lock(&completion_mutex);
+    gen_mutex_lock(&context_mutex);
     for(context_index=0; context_index<JOB_MAX_CONTEXTS; context_index++)
     {
         if(completion_queue_array[context_index] == NULL)
@@ -276,18 +309,18 @@ int job_open_context(job_context_id* context_id)
     if(context_index >= JOB_MAX_CONTEXTS)
     {
         /* we don't have any more available! */
-        gen_mutex_unlock(&completion_mutex);
+        gen_mutex_unlock(&context_mutex);
         return(-EBUSY);
     }
 
     /* create a new completion queue for the context */
-    completion_queue_array[context_index] = job_desc_q_new();
+    completion_queue_array[context_index] = job_desc_cq_new();
     if(!completion_queue_array[context_index])
     {
-        gen_mutex_unlock(&completion_mutex);
+        gen_mutex_unlock(&context_mutex);
         return(-ENOMEM);
     }
-    gen_mutex_unlock(&completion_mutex);
+    gen_mutex_unlock(&context_mutex);
 
     *context_id = context_index;
     return(0);
@@ -302,18 +335,18 @@ int job_open_context(job_context_id* context_id)
  */
 void job_close_context(job_context_id context_id)
 {
-    gen_mutex_lock(&completion_mutex);
+    gen_mutex_lock(&context_mutex);
     if(!completion_queue_array[context_id])
     {
-        gen_mutex_unlock(&completion_mutex);
+        gen_mutex_unlock(&context_mutex);
         return;
     }
 
-    job_desc_q_cleanup(completion_queue_array[context_id]);
+    job_desc_cq_cleanup(completion_queue_array[context_id]);
 
     completion_queue_array[context_id] = NULL;
 
-    gen_mutex_unlock(&completion_mutex);
+    gen_mutex_unlock(&context_mutex);
     return;
 }
 
@@ -328,36 +361,51 @@ int job_reset_timeout(job_id_t id, int timeout_sec)
 {
     struct job_desc* query = NULL;
     int ret = -1;
+    int i;
 
-    /* lock completion queue to make sure that a concurrent test call
-     * doesn't pull the job out from under us somehow
+    /* lock every completion queue to make sure that a concurrent test
+     * call doesn't pull the job out from under us somehow; we don't know
+     * which context the job belongs to until we look at it
      */
-    gen_mutex_lock(&completion_mutex);
+    gen_mutex_lock(&context_mutex);
+    for(i = 0; i < JOB_MAX_CONTEXTS; i++)
+    {
+        if(completion_queue_array[i])
+        {
+            gen_mutex_lock(&completion_queue_array[i]->mutex);
+        }
+    }
 
     query = id_gen_safe_lookup(id);
     if(!query)
     {        
         /* this id is not valid */
-        gen_mutex_unlock(&completion_mutex);
-        return(-PVFS_EINVAL);
+        ret = -PVFS_EINVAL;
     }
-
-    if(query->type != JOB_BMI && query->type != JOB_FLOW)
+    else if(query->type != JOB_BMI && query->type != JOB_FLOW)
     {
         /* trying to reset timeouts on a job that doesn't support the
          * concept 
          */
-        gen_mutex_unlock(&completion_mutex);
-        return(-PVFS_EINVAL);
+        ret = -PVFS_EINVAL;
     }
+    else
+    {
+        /* pull the job out of the time mgr (thereby clearing old timer) */
+        job_time_mgr_rem(query);
 
-    /* pull the job out of the time mgr (thereby clearing old timer) */
-    job_time_mgr_rem(query);
-
-    /* put it back into the time mgr with new value */
-    ret = job_time_mgr_add(query, timeout_sec);
+        /* put it back into the time mgr with new value */
+        ret = job_time_mgr_add(query, timeout_sec);
+    }
 
-    gen_mutex_unlock(&completion_mutex);
+    for(i = JOB_MAX_CONTEXTS - 1; i >= 0; i--)
+    {
+        if(completion_queue_array[i])
+        {
+            gen_mutex_unlock(&completion_queue_array[i]->mutex);
+        }
+    }
+    gen_mutex_unlock(&context_mutex);
 
     return(ret);
 }
@@ -818,19 +866,7 @@ int job_bmi_unexp_cancel(job_id_t id)
     bmi_unexp_pending_count--;
     gen_mutex_unlock(&bmi_unexp_mutex);
 
-    gen_mutex_lock(&completion_mutex);
-    /* set completed flag while holding queue lock */
-    jd->completed_flag = 1;
-    if (completion_queue_array[jd->context_id])
-    {
-        job_desc_q_add(completion_queue_array[jd->context_id], jd);
-    }
-
-#ifdef __PVFS2_JOB_THREADED__
-    /* wake up anyone waiting for completion */
-    pthread_cond_signal(&completion_cond);
-#endif
-    gen_mutex_unlock(&completion_mutex);
+    job_complete(jd);
 
     return 0;
 }
@@ -845,15 +881,20 @@ int job_bmi_unexp_cancel(job_id_t id)
 int job_bmi_cancel(job_id_t id, job_context_id context_id)
 {
     struct job_desc* query = NULL;
+    struct job_desc_cq* cq = NULL;
     int ret = -1;
 
-    gen_mutex_lock(&completion_mutex);
+    /* hold the context's queue lock so that a test call can't complete
+     * and free the job while we are cancelling it
+     */
+    cq = completion_queue_array[context_id];
+    gen_mutex_lock(&cq->mutex);
 
     query = id_gen_safe_lookup(id);
-    if (!query || query->completed_flag)
+    if (!query || job_desc_is_completed(query))
     {
         /* job has already completed, no cancellation needed */
-        gen_mutex_unlock(&completion_mutex);
+        gen_mutex_unlock(&cq->mutex);
         return(0);
     }
 
@@ -863,7 +904,7 @@ int job_bmi_cancel(job_id_t id, job_context_id context_id)
     ret = PINT_thread_mgr_bmi_cancel(
         query->u.bmi.id, &(query->bmi_callback));
 
-    gen_mutex_unlock(&completion_mutex);
+    gen_mutex_unlock(&cq->mutex);
 
     return(ret);
 }
@@ -1055,7 +1096,8 @@ int job_req_sched_post(enum PVFS_server_op op,
                        job_aint status_user_tag,
                        job_status_s * out_status_p,
                        job_id_t * id,
-                       job_context_id context_id)
+                       job_context_id context_id,
+                       PVFS_hint hints)
 {
     /* post a request to the scheduler.  If it completes (or fails)
      * immediately, then return and fill in the status structure.
@@ -1080,6 +1122,7 @@ int job_req_sched_post(enum PVFS_server_op op,
     jd->u.req_sched.post_flag = 1;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
+    jd->hints = hints;
 
     ret = PINT_req_sched_post(
         op, fs_id, handle, access_type, sched_policy, jd, &(jd->u.req_sched.id));
@@ -1381,16 +1424,21 @@ int job_flow(flow_descriptor * flow_d,
 int job_flow_cancel(job_id_t id, job_context_id context_id)
 {
     struct job_desc* query = NULL;
+    struct job_desc_cq* cq = NULL;
     int ret = -1;
 
-    gen_mutex_lock(&completion_mutex);
+    /* hold the context's queue lock so that a test call can't complete
+     * and free the job while we are cancelling it
+     */
+    cq = completion_queue_array[context_id];
+    gen_mutex_lock(&cq->mutex);
 
     query = id_gen_safe_lookup(id);
 
-    if (!query || query->completed_flag)
+    if (!query || job_desc_is_completed(query))
     {
         /* job has already completed, no cancellation needed */
-        gen_mutex_unlock(&completion_mutex);
+        gen_mutex_unlock(&cq->mutex);
         return(0);
     }
 
@@ -1400,7 +1448,7 @@ int job_flow_cancel(job_id_t id, job_context_id context_id)
      */
     ret = PINT_flow_cancel(query->u.flow.flow_d);
 
-    gen_mutex_unlock(&completion_mutex);
+    gen_mutex_unlock(&cq->mutex);
 
     return(ret);
 }
@@ -3449,15 +3497,20 @@ int job_trove_dspace_cancel(PVFS_fs_id coll_id,
                             job_context_id context_id)
 {
     struct job_desc* query = NULL;
+    struct job_desc_cq* cq = NULL;
     int ret = -1;
 
-    gen_mutex_lock(&completion_mutex);
+    /* hold the context's queue lock so that a test call can't complete
+     * and free the job while we are cancelling it
+     */
+    cq = completion_queue_array[context_id];
+    gen_mutex_lock(&cq->mutex);
 
     query = id_gen_safe_lookup(id);
-    if (!query || query->completed_flag)
+    if (!query || job_desc_is_completed(query))
     {
         /* job has already completed, no cancellation needed */
-        gen_mutex_unlock(&completion_mutex);
+        gen_mutex_unlock(&cq->mutex);
         return(0);
     }
 
@@ -3466,7 +3519,7 @@ int job_trove_dspace_cancel(PVFS_fs_id coll_id,
     ret = PINT_thread_mgr_trove_cancel(
         query->u.trove.id, coll_id, &(query->trove_callback));
 
-    gen_mutex_unlock(&completion_mutex);
+    gen_mutex_unlock(&cq->mutex);
 
     return(ret);
 }
@@ -3914,16 +3967,7 @@ int job_null(
     jd->status_user_tag = status_user_tag;
     jd->u.null_info.error_code = error_code;
 
-    gen_mutex_lock(&completion_mutex);
-    job_desc_q_add(completion_queue_array[jd->context_id],
-        jd);
-    /* set completed flag while holding queue lock */
-    jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-    /* wake up anyone waiting for completion */
-    pthread_cond_signal(&completion_cond);
-#endif
-    gen_mutex_unlock(&completion_mutex);
+    job_complete(jd);
 
     return(0);
 }
@@ -3975,6 +4019,7 @@ int job_testsome(job_id_t * id_array,
     int ret = -1;
     struct timespec pthread_timeout;
     struct timeval start;
+    struct job_desc_cq* cq = NULL;
     int original_count = *inout_count_p;
     int pthread_ret = -1;
 
@@ -4004,22 +4049,22 @@ int job_testsome(job_id_t * id_array,
     }
 
     /* check for completed jobs */
-    gen_mutex_lock(&completion_mutex);
+    cq = completion_queue_array[context_id];
+    gen_mutex_lock(&cq->mutex);
     pthread_ret = 0;
     while(((ret = completion_query_some(id_array,
         inout_count_p,
         out_index_array,
         returned_user_ptr_array,
-        out_status_array_p)) == 0) &&
+        out_status_array_p,
+        context_id)) == 0) &&
         ((pthread_ret == EINTR) || (pthread_ret == 0)))
     {
         *inout_count_p = original_count;
 
         if(timeout_ms > 0)
         {
-            pthread_ret = pthread_cond_timedwait(&completion_cond,
-                &completion_mutex,
-                &pthread_timeout);
+            pthread_ret = job_desc_cq_wait(cq, &pthread_timeout);
         }
         else if(timeout_ms == 0)
         {
@@ -4028,11 +4073,17 @@ int job_testsome(job_id_t * id_array,
         else
         {
             /* block indefinitely */
-            pthread_ret = pthread_cond_wait(&completion_cond,
-                &completion_mutex);
+            pthread_ret = job_desc_cq_wait(cq, NULL);
         }
     }
-    gen_mutex_unlock(&completion_mutex);
+    /* we may have been woken for completions that someone else sleeping
+     * on this context is waiting for
+     */
+    if(ret > 0 && job_desc_cq_pending(cq))
+    {
+        job_desc_cq_wake(cq);
+    }
+    gen_mutex_unlock(&cq->mutex);
 
     if(ret == 0)
     {
@@ -4085,13 +4136,14 @@ int job_testsome(job_id_t * id_array,
     /* check before we do anything else to see if the completion queue
      * has anything in it
      */
-    gen_mutex_lock(&completion_mutex);
+    gen_mutex_lock(&completion_queue_array[context_id]->mutex);
     ret = completion_query_some(id_array,
                                  inout_count_p,
                                  out_index_array,
                                  returned_user_ptr_array,
-                                 out_status_array_p);
-    gen_mutex_unlock(&completion_mutex);
+                                 out_status_array_p,
+                                 context_id);
+    gen_mutex_unlock(&completion_queue_array[context_id]->mutex);
     /* return here on error or completion */
     if (ret < 0)
     {
@@ -4138,13 +4190,14 @@ int job_testsome(job_id_t * id_array,
         }
 
         /* check queue now to see if anything is done */
-        gen_mutex_lock(&completion_mutex);
+        gen_mutex_lock(&completion_queue_array[context_id]->mutex);
         ret = completion_query_some(id_array,
                                      inout_count_p,
                                      out_index_array,
                                      returned_user_ptr_array,
-                                     out_status_array_p);
-        gen_mutex_unlock(&completion_mutex);
+                                     out_status_array_p,
+                                     context_id);
+        gen_mutex_unlock(&completion_queue_array[context_id]->mutex);
         /* return here on error or completion */
         if (ret < 0)
         {
@@ -4215,6 +4268,7 @@ int job_testcontext(job_id_t * out_id_array_p,
     int ret = -1;
     struct timespec pthread_timeout;
     struct timeval start;
+    struct job_desc_cq* cq = NULL;
     int original_count = *inout_count_p;
     int pthread_ret = -1;
 
@@ -4244,7 +4298,8 @@ int job_testcontext(job_id_t * out_id_array_p,
     }
 
     /* check for completed jobs */
-    gen_mutex_lock(&completion_mutex);
+    cq = completion_queue_array[context_id];
+    gen_mutex_lock(&cq->mutex);
     pthread_ret = 0;
     while(((ret = completion_query_context(out_id_array_p,
                              inout_count_p,
@@ -4256,9 +4311,7 @@ int job_testcontext(job_id_t * out_id_array_p,
 
         if(timeout_ms > 0)
         {
-            pthread_ret = pthread_cond_timedwait(&completion_cond,
-                &completion_mutex,
-                &pthread_timeout);
+            pthread_ret = job_desc_cq_wait(cq, &pthread_timeout);
         }
         else if(timeout_ms == 0)
         {
@@ -4267,11 +4320,17 @@ int job_testcontext(job_id_t * out_id_array_p,
         else
         {
             /* block indefinitely */
-            pthread_ret = pthread_cond_wait(&completion_cond,
-                &completion_mutex);
+            pthread_ret = job_desc_cq_wait(cq, NULL);
         }
     }
-    gen_mutex_unlock(&completion_mutex);
+    /* pass along anything left over to other threads testing this
+     * context
+     */
+    if(ret > 0 && job_desc_cq_pending(cq))
+    {
+        job_desc_cq_wake(cq);
+    }
+    gen_mutex_unlock(&cq->mutex);
 
     if(ret == 0)
     {
@@ -4324,12 +4383,12 @@ int job_testcontext(job_id_t * out_id_array_p,
     /* check before we do anything else to see if the completion queue
      * has anything in it
      */
-    gen_mutex_lock(&completion_mutex);
+    gen_mutex_lock(&completion_queue_array[context_id]->mutex);
     ret = completion_query_context(out_id_array_p,
                                  inout_count_p,
                                  returned_user_ptr_array,
                                  out_status_array_p, context_id);
-    gen_mutex_unlock(&completion_mutex);
+    gen_mutex_unlock(&completion_queue_array[context_id]->mutex);
     /* return here on error or completion */
     if (ret < 0)
     {
@@ -4376,13 +4435,13 @@ int job_testcontext(job_id_t * out_id_array_p,
         }
 
         /* check queue now to see if anything is done */
-        gen_mutex_lock(&completion_mutex);
+        gen_mutex_lock(&completion_queue_array[context_id]->mutex);
         ret = completion_query_context(out_id_array_p,
                                      inout_count_p,
                                      returned_user_ptr_array,
                                      out_status_array_p,
                                      context_id);
-        gen_mutex_unlock(&completion_mutex);
+        gen_mutex_unlock(&completion_queue_array[context_id]->mutex);
         /* return here on error or completion */
         if (ret < 0)
         {
@@ -4494,69 +4553,6 @@ static void teardown_queues(void)
 
 #ifdef __PVFS2_TROVE_SUPPORT__
 
-/* precreate_pool_get_thread_mgr_callback_unlocked()
- *
- * callback function executed by the thread manager for precreate pool get
- * when a trove operation completes
- *
- * no return value
- */
-static void precreate_pool_get_thread_mgr_callback_unlocked(
-    void* data, 
-    PVFS_error error_code)
-{
-    struct precreate_pool_get_trove* tmp_trove = data;
-    
-    gen_mutex_lock(&initialized_mutex);
-    if(initialized == 0)
-    {
-        /* The job interface has been shutdown.  Silently ignore callback. */
-        gen_mutex_unlock(&initialized_mutex);
-        return;
-    }
-    gen_mutex_unlock(&initialized_mutex);
-
-    if(error_code == 0)
-    {
-        gossip_debug(GOSSIP_JOB_DEBUG,
-            "Got precreated handle: %llu\n",
-            llu(*((PVFS_handle*)tmp_trove->key.buffer)));
-    }
-
-    trove_pending_count--;
-    tmp_trove->jd->u.precreate_pool.trove_pending--;
-
-    /* don't overwrite error codes from other trove ops */
-    if(tmp_trove->jd->u.precreate_pool.error_code == 0)
-    {
-        tmp_trove->jd->u.precreate_pool.error_code = error_code;
-    }
-
-    /* is this job done? */
-    if(tmp_trove->jd->u.precreate_pool.trove_pending == 0)
-    {
-        gen_mutex_lock(&completion_mutex);
-
-        /* set job descriptor fields and put into completion queue */
-        tmp_trove->jd->u.precreate_pool.error_code = 0;
-        job_desc_q_add(completion_queue_array[tmp_trove->jd->context_id], 
-                       tmp_trove->jd);
-        /* set completed flag while holding queue lock */
-        tmp_trove->jd->completed_flag = 1;
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        free(tmp_trove->jd->u.precreate_pool.data);
-        gen_mutex_unlock(&completion_mutex);
-        return;
-    }
-
-    return;
-}
-
-
 /* precreate_pool_iterate_callback()
  *
  * callback function executed by the thread mgr when a trove iterate
@@ -4570,54 +4566,26 @@ static void precreate_pool_iterate_callback(
 {    
     struct job_desc* tmp_desc = (struct job_desc*)data; 
 
-    gen_mutex_lock(&initialized_mutex);
-    if(initialized == 0)
+    if(!job_initialized())
     {
         /* The job interface has been shutdown.  Silently ignore callback. */
-        gen_mutex_unlock(&initialized_mutex);
         return;
     }
-    gen_mutex_unlock(&initialized_mutex);
 
-    gen_mutex_lock(&completion_mutex);
-    if (tmp_desc->completed_flag == 0)
+    if (job_desc_mark_completed(tmp_desc))
     {
         /* set job descriptor fields and put into completion queue */
         tmp_desc->u.precreate_pool.error_code = error_code;
         free(tmp_desc->u.precreate_pool.key_array);
-        job_desc_q_add(completion_queue_array[tmp_desc->context_id], 
-                       tmp_desc);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
 
         trove_pending_count--;
 
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
+        job_push_completion(tmp_desc);
     }
-    gen_mutex_unlock(&completion_mutex);
 
     return;
 }
 
-/* precreate_pool_get_thread_mgr_callback()
- *
- * callback function executed by the thread manager for precreate pool get
- * when a trove operation completes
- *
- * no return value
- */
-static void precreate_pool_get_thread_mgr_callback(
-    void* data, 
-    PVFS_error error_code)
-{
-    gen_mutex_lock(&precreate_pool_mutex);
-    precreate_pool_get_thread_mgr_callback_unlocked(data, error_code);
-    gen_mutex_unlock(&precreate_pool_mutex);
-}
-
 /* precreate_pool_fill_thread_mgr_callback()
  *
  * callback function executed by the thread manager for precreate pool fill
@@ -4645,32 +4613,21 @@ static void precreate_pool_fill_thread_mgr_callback(
 
     assert(jd);
 
-    gen_mutex_lock(&initialized_mutex);
-    if(initialized == 0)
+    if(!job_initialized())
     {
         /* The job interface has been shutdown.  Silently ignore callback. */
-        gen_mutex_unlock(&initialized_mutex);
         return;
     }
-    gen_mutex_unlock(&initialized_mutex);
 
     if(error_code != 0)
     {
         gossip_err("Error: unable to write all precreated handles to pool.\n");
         gossip_err("Warning: fsck may be needed to recover stranded handles.\n");
         free(jd->u.precreate_pool.key_array);
-        gen_mutex_lock(&completion_mutex);
 
         /* set job descriptor fields and put into completion queue */
         jd->u.precreate_pool.error_code = error_code;
-        job_desc_q_add(completion_queue_array[jd->context_id], jd);
-        /* set completed flag while holding queue lock */
-        jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        job_complete(jd);
         return;
     }
 
@@ -4704,6 +4661,11 @@ static void precreate_pool_fill_thread_mgr_callback(
                     "Pool count for handle %llu (type %u) incremented to %d\n",
                     llu(pool->pool_handle), pool->pool_type, 
                     pool->pool_count);
+                /* start moving the new handles into memory */
+                if(pool->cache_count < PRECREATE_POOL_CLAIM_BATCH / 2)
+                {
+                    precreate_pool_claim_post(pool, PRECREATE_POOL_CLAIM_BATCH);
+                }
                 break;
             }
         }
@@ -4740,7 +4702,10 @@ static void precreate_pool_fill_thread_mgr_callback(
                 job_desc_q_link);
             qlist_del(&jd_checker->job_desc_q_link);
             gossip_debug(GOSSIP_JOB_DEBUG, "Pushing get_handles() sleeper for jd: %p.\n", jd_checker);
-            precreate_pool_get_handles_try_post(jd_checker);
+            if(precreate_pool_get_handles_try_post(jd_checker) == 1)
+            {
+                job_complete(jd_checker);
+            }
         }
     }
 
@@ -4749,20 +4714,10 @@ static void precreate_pool_fill_thread_mgr_callback(
         jd->u.precreate_pool.precreate_handle_count)
     {
         free(jd->u.precreate_pool.key_array);
-        gen_mutex_lock(&completion_mutex);
 
         /* set job descriptor fields and put into completion queue */
         jd->u.precreate_pool.error_code = 0;
-        job_desc_q_add(completion_queue_array[jd->context_id], 
-                       jd);
-        /* set completed flag while holding queue lock */
-        jd->completed_flag = 1;
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        job_complete(jd);
         return;
     }
 
@@ -4811,18 +4766,10 @@ static void precreate_pool_fill_thread_mgr_callback(
     {
         gossip_err("Error: unable to write all precreated handles to pool.\n");
         gossip_err("Warning: fsck may be needed to recover stranded handles.\n");
-        gen_mutex_lock(&completion_mutex);
 
         /* set job descriptor fields and put into completion queue */
         jd->u.precreate_pool.error_code = ret;
-        job_desc_q_add(completion_queue_array[jd->context_id], jd);
-        /* set completed flag while holding queue lock */
-        jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        job_complete(jd);
         return;
     }
     else if(ret == 1)
@@ -4854,24 +4801,16 @@ static void trove_thread_mgr_callback(
     struct job_desc* tmp_desc = (struct job_desc*)data; 
     assert(tmp_desc);
 
-    gen_mutex_lock(&initialized_mutex);
-    if(initialized == 0)
+    if(!job_initialized())
     {
         /* The job interface has been shutdown.  Silently ignore callback. */
-        gen_mutex_unlock(&initialized_mutex);
         return;
     }
-    gen_mutex_unlock(&initialized_mutex);
 
-    gen_mutex_lock(&completion_mutex);
-    if (tmp_desc->completed_flag == 0)
+    if (job_desc_mark_completed(tmp_desc))
     {
         /* set job descriptor fields and put into completion queue */
         tmp_desc->u.trove.state = error_code;
-        job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                       tmp_desc);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
 
 /* the value of trove_pending_count is only used in the non-threaded
  * situation. so, to prevent reported data races from helgrind, we
@@ -4881,12 +4820,8 @@ static void trove_thread_mgr_callback(
         trove_pending_count--;
 #endif
 
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
+        job_push_completion(tmp_desc);
     }
-    gen_mutex_unlock(&completion_mutex);
 }
 
 /* bmi_thread_mgr_callback()
@@ -4904,34 +4839,22 @@ static void bmi_thread_mgr_callback(
     struct job_desc* tmp_desc = (struct job_desc*)data;
     assert(tmp_desc);
 
-    gen_mutex_lock(&initialized_mutex);
-    if(initialized == 0)
+    if(!job_initialized())
     {
         /* The job interface has been shutdown.  Silently ignore callback. */
-        gen_mutex_unlock(&initialized_mutex);
         return;
     }
-    gen_mutex_unlock(&initialized_mutex);
 
-    gen_mutex_lock(&completion_mutex);
-    if (tmp_desc->completed_flag == 0)
+    if (job_desc_mark_completed(tmp_desc))
     {
         /* set job descriptor fields and put into completion queue */
         tmp_desc->u.bmi.error_code = error_code;
         tmp_desc->u.bmi.actual_size = actual_size;
-        job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                       tmp_desc);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
 
         bmi_pending_count--;
 
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
+        job_push_completion(tmp_desc);
     }
-    gen_mutex_unlock(&completion_mutex);
 }
 
 /* bmi_thread_mgr_unexp_handler()
@@ -4946,41 +4869,25 @@ static void bmi_thread_mgr_unexp_handler(
 {
     struct job_desc* tmp_desc = NULL;
 
-    gen_mutex_lock(&initialized_mutex);
-    if(initialized == 0)
+    if(!job_initialized())
     {
         /* The job interface has been shutdown.  Silently ignore callback. */
-        gen_mutex_unlock(&initialized_mutex);
         return;
     }
-    gen_mutex_unlock(&initialized_mutex);
 
     gen_mutex_lock(&bmi_unexp_mutex);
 
     /* remove the operation from the pending bmi_unexp queue */
     tmp_desc = job_desc_q_shownext(bmi_unexp_queue);
     assert(tmp_desc != NULL);
-    if (tmp_desc->completed_flag == 0)
+    if (!job_desc_is_completed(tmp_desc))
     {
         job_desc_q_remove(tmp_desc);
         bmi_unexp_pending_count--;
         gen_mutex_unlock(&bmi_unexp_mutex);
         /* set appropriate fields and store in completed queue */
         *(tmp_desc->u.bmi_unexp.info) = *unexp;
-        gen_mutex_lock(&completion_mutex);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
-        if (completion_queue_array[tmp_desc->context_id])
-        {
-            job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                           tmp_desc);
-        }
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        job_complete(tmp_desc);
     }
     else
     {
@@ -5007,27 +4914,14 @@ static void dev_thread_mgr_unexp_handler(struct PINT_dev_unexp_info* unexp)
      * dev_unexp job posted for us to hit this point.
      */
     assert(tmp_desc != NULL);
-    if (tmp_desc->completed_flag == 0)
+    if (!job_desc_is_completed(tmp_desc))
     {
         job_desc_q_remove(tmp_desc);
         dev_unexp_pending_count--;
         gen_mutex_unlock(&dev_unexp_mutex);
         /* set appropriate fields and store in completed queue */
         *(tmp_desc->u.dev_unexp.info) = *unexp;
-        gen_mutex_lock(&completion_mutex);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
-        if (completion_queue_array[tmp_desc->context_id])
-        {
-            job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                           tmp_desc);
-        }
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        job_complete(tmp_desc);
     }
     else
     {
@@ -5036,6 +4930,55 @@ static void dev_thread_mgr_unexp_handler(struct PINT_dev_unexp_info* unexp)
 }
 #endif /* __PVFS2_CLIENT__ */
 
+/* job_initialized()
+ *
+ * lets completion callbacks check for shutdown without taking a lock
+ *
+ * returns 1 if the job interface is initialized, 0 otherwise
+ */
+static int job_initialized(void)
+{
+#ifdef __GNUC__
+    return(__atomic_load_n(&initialized, __ATOMIC_ACQUIRE));
+#else
+    int ret;
+
+    gen_mutex_lock(&initialized_mutex);
+    ret = initialized;
+    gen_mutex_unlock(&initialized_mutex);
+    return(ret);
+#endif
+}
+
+/* job_push_completion()
+ *
+ * hands a job that has been marked complete to the completion queue of
+ * its context, waking any test call sleeping on it.  Takes no locks.
+ *
+ * no return value
+ */
+static void job_push_completion(struct job_desc *jd)
+{
+    struct job_desc_cq* cq = completion_queue_array[jd->context_id];
+
+    if(cq)
+    {
+        job_desc_cq_push(cq, jd);
+    }
+}
+
+/* job_complete()
+ *
+ * marks a job complete and hands it to its completion queue
+ *
+ * no return value
+ */
+static void job_complete(struct job_desc *jd)
+{
+    job_desc_mark_completed(jd);
+    job_push_completion(jd);
+}
+
 /* fill_status()
  *
  * fills in the completion status based on the given job descriptor
@@ -5046,6 +4989,8 @@ static void fill_status(struct job_desc *jd,
                         void **returned_user_ptr_p,
                         job_status_s * status)
 {
+    enum PVFS_event_trace_kind trace_kind = PVFS_EVENT_TRACE_JOB;
+
     assert(jd);
     assert(status);
 
@@ -5067,6 +5012,7 @@ static void fill_status(struct job_desc *jd,
         job_time_mgr_rem(jd);
         status->error_code = jd->u.bmi.error_code;
         status->actual_size = jd->u.bmi.actual_size;
+        trace_kind = PVFS_EVENT_TRACE_BMI;
         break;
     case JOB_BMI_UNEXP:
         status->error_code = jd->u.bmi_unexp.info->error_code;
@@ -5076,9 +5022,11 @@ static void fill_status(struct job_desc *jd,
         job_time_mgr_rem(jd);
         status->error_code = jd->u.flow.flow_d->error_code;
         status->actual_size = jd->u.flow.flow_d->total_transferred;
+        trace_kind = PVFS_EVENT_TRACE_FLOW;
         break;
     case JOB_REQ_SCHED:
         status->error_code = jd->u.req_sched.error_code;
+        trace_kind = PVFS_EVENT_TRACE_REQ_SCHED;
         break;
     case JOB_TROVE:
         status->error_code = jd->u.trove.state;
@@ -5090,6 +5038,7 @@ static void fill_status(struct job_desc *jd,
         status->position = jd->u.trove.position;
         status->count = jd->u.trove.count;
         status->type = jd->u.trove.type;
+        trace_kind = PVFS_EVENT_TRACE_TROVE;
         break;
     case JOB_DEV_UNEXP:
         status->error_code = 0;
@@ -5109,6 +5058,15 @@ static void fill_status(struct job_desc *jd,
         break;
     }
 
+    /* span from post to harvest; jobs that completed immediately never
+     * get here and unexpected jobs carry no request hints yet
+     */
+    if (jd->trace_post_us)
+    {
+        PINT_req_trace_record(trace_kind, jd->hints, jd->trace_post_us,
+                              PINT_req_trace_now());
+    }
+
     return;
 }
 
@@ -5147,12 +5105,7 @@ static int do_one_test_cycle_req_sched(void)
         tmp_desc = (struct job_desc *) user_ptr_array[i];
         /* set appropriate fields and place in completed queue */
         tmp_desc->u.req_sched.error_code = error_code_array[i];
-        gen_mutex_lock(&completion_mutex);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
-        job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-            tmp_desc);
-        gen_mutex_unlock(&completion_mutex);
+        job_complete(tmp_desc);
     }
 
     return (0);
@@ -5166,7 +5119,8 @@ static int completion_query_some(job_id_t * id_array,
                                  int *inout_count_p,
                                  int *out_index_array,
                                  void **returned_user_ptr_array,
-                                 job_status_s * out_status_array_p)
+                                 job_status_s * out_status_array_p,
+                                 job_context_id context_id)
 {
     int i;
     struct job_desc *tmp_desc;
@@ -5196,11 +5150,17 @@ static int completion_query_some(job_id_t * id_array,
         return (-EINVAL);
     }
 
+    /* a job only counts as done once it reaches the ready list; it may be
+     * marked complete but still on its way into the queue
+     */
+    job_desc_cq_drain(completion_queue_array[context_id]);
+
     /* don't do anything unless all of the target ops are done */
     for(i=0; i<incount; i++)
     {
         tmp_desc = id_gen_safe_lookup(id_array[i]);
-        if(tmp_desc && tmp_desc->completed_flag)
+        if(tmp_desc && tmp_desc->context_id == context_id &&
+           tmp_desc->ready_flag)
         {
             done_count++;
         }
@@ -5215,7 +5175,8 @@ static int completion_query_some(job_id_t * id_array,
     for(i=0; i<incount; i++)
     {
         tmp_desc = id_gen_safe_lookup(id_array[i]);
-        if(tmp_desc && tmp_desc->completed_flag)
+        if(tmp_desc && tmp_desc->context_id == context_id &&
+           tmp_desc->ready_flag)
         {
             if(returned_user_ptr_array)
             {
@@ -5228,7 +5189,7 @@ static int completion_query_some(job_id_t * id_array,
                 fill_status(tmp_desc, NULL,
                     &(out_status_array_p[*inout_count_p]));
             }
-            job_desc_q_remove(tmp_desc);
+            job_desc_cq_remove(tmp_desc);
             if (tmp_desc->type == JOB_REQ_SCHED &&
                 tmp_desc->u.req_sched.post_flag == 1)
             {
@@ -5277,7 +5238,7 @@ static int completion_query_context(job_id_t * out_id_array_p,
         return (completion_error);
     }
     while (*inout_count_p < incount && (query =
-                                        job_desc_q_shownext(
+                                        job_desc_cq_shownext(
                                         completion_queue_array[context_id])))
     {
         assert(query);
@@ -5292,7 +5253,7 @@ static int completion_query_context(job_id_t * out_id_array_p,
             fill_status(query, NULL, &(out_status_array_p[*inout_count_p]));
         }
         out_id_array_p[*inout_count_p] = query->job_id;
-        job_desc_q_remove(query);
+        job_desc_cq_remove(query);
         (*inout_count_p)++;
         /* special case for request scheduler */
         if (query->type == JOB_REQ_SCHED && query->u.req_sched.post_flag == 1)
@@ -5380,37 +5341,20 @@ static void flow_callback(flow_descriptor* flow_d, int cancel_path)
 {
     struct job_desc* tmp_desc = (struct job_desc*)flow_d->user_ptr;
 
-    gen_mutex_lock(&initialized_mutex);
-    if(initialized == 0)
+    if(!job_initialized())
     {
         /* The job interface has been shutdown.  Silently ignore callback. */
-        gen_mutex_unlock(&initialized_mutex);
         return;
     }
-    gen_mutex_unlock(&initialized_mutex);
-
-    /* set job descriptor fields and put into completion queue */
 
-    /* if this is being triggered directly from PINT_flow_cancel(), then the
-     * completion mutex is already held by the caller; skip the mutex.
+    /* put into completion queue; this takes no locks, so it is safe even
+     * when triggered directly from PINT_flow_cancel()
      */
-    if(!cancel_path)
-        gen_mutex_lock(&completion_mutex);
-    job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                   tmp_desc);
-    /* set completed flag while holding queue lock */
-    tmp_desc->completed_flag = 1;
-
     flow_pending_count--;
     gossip_debug(GOSSIP_FLOW_DEBUG, "Job flows in progress (callback time): %d\n",
             flow_pending_count);
 
-#ifdef __PVFS2_JOB_THREADED__
-    /* wake up anyone waiting for completion */
-    pthread_cond_signal(&completion_cond);
-#endif
-    if(!cancel_path)
-        gen_mutex_unlock(&completion_mutex);
+    job_complete(tmp_desc);
 
     return;
 }
@@ -5454,20 +5398,10 @@ int job_precreate_pool_fill_signal_error(
         qlist_del(&jd_checker->job_desc_q_link);
 
         gossip_debug(GOSSIP_FLOW_DEBUG, "job_precreate_pool_fill_signal_error() waking up a get_handles() caller.\n");
-        gen_mutex_lock(&completion_mutex);
 
         /* set job descriptor fields and put into completion queue */
         jd_checker->u.precreate_pool.error_code = error_code;
-        job_desc_q_add(completion_queue_array[jd_checker->context_id], 
-                       jd_checker);
-        /* set completed flag while holding queue lock */
-        jd_checker->completed_flag = 1;
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        job_complete(jd_checker);
     }
     gen_mutex_unlock(&precreate_pool_mutex);
 
@@ -5653,6 +5587,7 @@ int job_precreate_pool_register_server(
     {
         return(-ENOMEM);
     }
+    memset(tmp_pool, 0, sizeof(*tmp_pool));
 
     tmp_pool->host = strdup(host);
     if(!tmp_pool->host)
@@ -5661,9 +5596,12 @@ int job_precreate_pool_register_server(
         return(-ENOMEM);
     }
 
+    tmp_pool->fsid = fsid;
     tmp_pool->pool_handle = pool_handle;
     tmp_pool->pool_count = count;
     tmp_pool->pool_type = type;
+    tmp_pool->claim_callback.fn = precreate_pool_claim_callback;
+    tmp_pool->claim_callback.data = tmp_pool;
     gossip_debug(GOSSIP_JOB_DEBUG, 
         "Pool count for handle %llu (type %u) initially set to %d\n", 
         llu(tmp_pool->pool_handle), tmp_pool->pool_type, 
@@ -5793,6 +5731,10 @@ int job_precreate_pool_check_level(
  * servers is NULL, then it will provide handles from pools in round robin
  * manner.
  *
+ * Handles are taken from the pools' in-memory caches, so this normally
+ * completes immediately.  The job only queues if a cache must first be
+ * refilled from the pool's keyval space, or if a pool is empty.
+ *
  * returns 0 on success, 1 on immediate completion, and -PVFS_errno on failure
  */
 int job_precreate_pool_get_handles(
@@ -5836,7 +5778,6 @@ int job_precreate_pool_get_handles(
     jd->u.precreate_pool.precreate_handle_index = 0;
     jd->u.precreate_pool.fsid = fsid;
     jd->u.precreate_pool.servers = servers;
-    jd->u.precreate_pool.trove_pending = 0;
     jd->u.precreate_pool.flags = flags;
     jd->u.precreate_pool.type = type;
 
@@ -5852,6 +5793,7 @@ int job_precreate_pool_get_handles(
     if( fs->type_batch_count[index] < 1 )
     {
         gen_mutex_unlock(&precreate_pool_mutex);
+        dealloc_job_desc(jd);
         out_status_p->error_code = -PVFS_EINVAL;
         return 1;
     }
@@ -5860,35 +5802,312 @@ int job_precreate_pool_get_handles(
     fs->precreate_pool_initial = fs->precreate_pool_initial->next;
     gen_mutex_unlock(&precreate_pool_mutex);
     
-    precreate_pool_get_handles_try_post(jd);
+    if(precreate_pool_get_handles_try_post(jd) == 1)
+    {
+        out_status_p->error_code = jd->u.precreate_pool.error_code;
+        out_status_p->status_user_tag = status_user_tag;
+        dealloc_job_desc(jd);
+        return(1);
+    }
 
-    /* for the moment, this type of job cannot immediately complete */
     *id = jd->job_id;
     return(0);
 }
 
-/* precreate_pool_get_handles_try_post()
+/* precreate_pool_check_level_wake()
  *
- * Internal function used by job_precreate_pool_get_handles().  This
- * function will check to see if all pools are ready (at least one handle
- * available) and then post all required trove operations
+ * completes any check_level() callers waiting for this pool to drop below
+ * their threshold.  Must be called with precreate_pool_mutex held.
  *
  * no return value
  */
-static void precreate_pool_get_handles_try_post(struct job_desc* jd)
+static void precreate_pool_check_level_wake(struct precreate_pool* pool)
 {
-    struct precreate_pool* pool;
+    struct qlist_head* iterator;
+    struct qlist_head* scratch;
+    struct job_desc* jd_checker;
+
+    qlist_for_each_safe(iterator, scratch, &precreate_pool_check_level_list)
+    {
+        jd_checker = qlist_entry(iterator, struct job_desc, job_desc_q_link);
+
+        if(jd_checker->u.precreate_pool.precreate_pool == pool->pool_handle &&
+           pool->pool_count < jd_checker->u.precreate_pool.low_threshold)
+        {
+            /* the pool level is low */
+            gossip_debug(GOSSIP_JOB_DEBUG, "Pool count low, waking up waiter "
+                         "for handle %llu.\n", llu(pool->pool_handle));
+            qlist_del(&jd_checker->job_desc_q_link);
+            job_complete(jd_checker);
+        }
+    }
+}
+
+/* precreate_pool_cache_push()
+ *
+ * appends handles to a pool's in-memory cache, growing it if needed
+ *
+ * returns 0 on success, -PVFS_errno on failure
+ */
+static int precreate_pool_cache_push(
+    struct precreate_pool* pool, PVFS_handle* handles, int count)
+{
+    PVFS_handle* tmp;
+    int new_size;
+    int i;
+
+    if(pool->cache_count + count > pool->cache_size)
+    {
+        new_size = pool->cache_size ? pool->cache_size :
+            PRECREATE_POOL_CLAIM_BATCH;
+        while(new_size < pool->cache_count + count)
+        {
+            new_size *= 2;
+        }
+        tmp = malloc(new_size * sizeof(PVFS_handle));
+        if(!tmp)
+        {
+            return(-PVFS_ENOMEM);
+        }
+        for(i = 0; i < pool->cache_count; i++)
+        {
+            tmp[i] = pool->cache[(pool->cache_head + i) % pool->cache_size];
+        }
+        free(pool->cache);
+        pool->cache = tmp;
+        pool->cache_size = new_size;
+        pool->cache_head = 0;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        pool->cache[(pool->cache_head + pool->cache_count + i) %
+            pool->cache_size] = handles[i];
+    }
+    pool->cache_count += count;
+    return(0);
+}
+
+static PVFS_handle precreate_pool_cache_pop(struct precreate_pool* pool)
+{
+    PVFS_handle handle;
+
+    assert(pool->cache_count > 0);
+    handle = pool->cache[pool->cache_head];
+    pool->cache_head = (pool->cache_head + 1) % pool->cache_size;
+    pool->cache_count--;
+    return(handle);
+}
+
+/* precreate_pool_claim_done()
+ *
+ * moves the handles removed by a claim into the pool's cache.  Must be
+ * called with precreate_pool_mutex held.
+ *
+ * no return value
+ */
+static void precreate_pool_claim_done(
+    struct precreate_pool* pool, PVFS_error error_code)
+{
+    int got = 0;
+
+    pool->claim_pending = 0;
+
+    if(error_code != 0)
+    {
+        gossip_err("Error: unable to claim handles from precreate pool "
+                   "%llu.\n", llu(pool->pool_handle));
+        gossip_err("Warning: fsck may be needed to recover stranded "
+                   "handles.\n");
+        return;
+    }
+
+    got = pool->claim_count;
+    gossip_debug(GOSSIP_JOB_DEBUG, "Claimed %d of %d handles from pool "
+                 "%llu (type %u) into memory\n", got, pool->claim_requested,
+                 llu(pool->pool_handle), pool->pool_type);
+
+    if(got > 0 && precreate_pool_cache_push(pool, pool->claim_handles, got))
+    {
+        gossip_err("Error: unable to cache handles claimed from precreate "
+                   "pool %llu.\n", llu(pool->pool_handle));
+        gossip_err("Warning: fsck may be needed to recover stranded "
+                   "handles.\n");
+        pool->pool_count -= got;
+        got = 0;
+    }
+
+    if(got < pool->claim_requested)
+    {
+        /* the keyval space held fewer handles than we counted */
+        pool->pool_count -= (pool->claim_requested - got);
+        precreate_pool_check_level_wake(pool);
+    }
+}
+
+/* precreate_pool_claim_post()
+ *
+ * posts a trove operation that removes up to count handles from the
+ * pool's keyval space so that they can be handed out from memory.  The
+ * removal is synced before any of the handles are used, so a crash can
+ * strand claimed handles but never hand one out twice.  Must be called
+ * with precreate_pool_mutex held.
+ *
+ * returns 1 if the claim completed immediately, 0 if it is pending or
+ * there is nothing to claim, and -PVFS_errno on failure
+ */
+static int precreate_pool_claim_post(struct precreate_pool* pool, int count)
+{
+    int stored = pool->pool_count - pool->cache_count;
     TROVE_op_id tmp_id;
     int ret;
-    struct precreate_pool_get_trove* tmp_trove_array;
+    int i;
+
+    if(pool->claim_pending || stored < 1)
+    {
+        return(0);
+    }
+    if(count > stored)
+    {
+        count = stored;
+    }
+
+    if(count > pool->claim_size)
+    {
+        free(pool->claim_handles);
+        free(pool->claim_keys);
+        pool->claim_size = 0;
+        pool->claim_handles = malloc(count * sizeof(PVFS_handle));
+        pool->claim_keys = malloc(count * sizeof(TROVE_keyval_s));
+        if(!pool->claim_handles || !pool->claim_keys)
+        {
+            free(pool->claim_handles);
+            free(pool->claim_keys);
+            pool->claim_handles = NULL;
+            pool->claim_keys = NULL;
+            return(-PVFS_ENOMEM);
+        }
+        pool->claim_size = count;
+    }
+
+    memset(pool->claim_keys, 0, count * sizeof(TROVE_keyval_s));
+    for(i = 0; i < count; i++)
+    {
+        pool->claim_keys[i].buffer = &pool->claim_handles[i];
+        pool->claim_keys[i].buffer_sz = sizeof(PVFS_handle);
+    }
+    pool->claim_pos = PVFS_ITERATE_START;
+    pool->claim_requested = count;
+    pool->claim_count = count;
+    pool->claim_pending = 1;
+
+    gossip_debug(GOSSIP_JOB_DEBUG, "Claiming %d handles from pool %llu "
+                 "(type %u)\n", count, llu(pool->pool_handle),
+                 pool->pool_type);
+
+    ret = trove_keyval_iterate_keys(
+            pool->fsid,
+            pool->pool_handle,
+            &pool->claim_pos,
+            pool->claim_keys,
+            &pool->claim_count,
+            TROVE_BINARY_KEY | TROVE_KEYVAL_HANDLE_COUNT |
+                TROVE_KEYVAL_ITERATE_REMOVE | TROVE_SYNC,
+            NULL,
+            &pool->claim_callback,
+            global_trove_context,
+            &tmp_id,
+            NULL);
+    if(ret == 0)
+    {
+        /* callback will be triggered later */
+        trove_pending_count++;
+        return(0);
+    }
+
+    precreate_pool_claim_done(pool, (ret < 0) ? ret : 0);
+    return(ret);
+}
+
+/* precreate_pool_claim_callback()
+ *
+ * callback function executed by the thread manager when a claim of
+ * handles from a pool's keyval space completes
+ *
+ * no return value
+ */
+static void precreate_pool_claim_callback(
+    void* data, 
+    PVFS_error error_code)
+{
+    struct precreate_pool* pool = data;
     struct qlist_head* iterator;
     struct qlist_head* scratch;
     struct job_desc* jd_checker;
+    QLIST_HEAD(tmp_list);
+
+    if(!job_initialized())
+    {
+        /* The job interface has been shutdown.  Silently ignore callback. */
+        return;
+    }
+
+    gen_mutex_lock(&precreate_pool_mutex);
+    trove_pending_count--;
+    precreate_pool_claim_done(pool, error_code);
+
+    /* retry everyone who was waiting for handles */
+    qlist_for_each_safe(iterator, scratch, &precreate_pool_get_handles_list)
+    {
+        jd_checker = qlist_entry(iterator, struct job_desc, job_desc_q_link);
+        qlist_del(&jd_checker->job_desc_q_link);
+        qlist_add_tail(&jd_checker->job_desc_q_link, &tmp_list);
+    }
+    gen_mutex_unlock(&precreate_pool_mutex);
+
+    qlist_for_each_safe(iterator, scratch, &tmp_list)
+    {
+        jd_checker = qlist_entry(iterator, struct job_desc, job_desc_q_link);
+        qlist_del(&jd_checker->job_desc_q_link);
+        if(precreate_pool_get_handles_try_post(jd_checker) == 1)
+        {
+            job_complete(jd_checker);
+        }
+    }
+}
+
+/* precreate_pool_get_handles_try_post()
+ *
+ * Internal function used by job_precreate_pool_get_handles().  This
+ * function picks a pool for each requested handle and, if every pool's
+ * cache holds enough handles, fills in the caller's handle array from
+ * memory.  Otherwise it posts claims to refill the caches (or waits for
+ * the pools to be refilled) and queues the job to be retried.
+ *
+ * returns 1 if the job is done (see jd->u.precreate_pool.error_code) and
+ * 0 if it was queued
+ */
+static int precreate_pool_get_handles_try_post(struct job_desc* jd)
+{
+    struct precreate_pool* pool;
+    struct precreate_pool** pools;
+    struct qlist_head* iterator;
     int i, total_pool_count=0, j=0;
+    int ret;
+    int short_count;
+    int claimed;
     struct fs_pool* fs;
 
     gossip_debug(GOSSIP_JOB_DEBUG, "precreate_pool_get_handles_try_post\n");
 
+    pools = malloc((jd->u.precreate_pool.precreate_handle_count + 1) *
+                   sizeof(*pools));
+    if(!pools)
+    {
+        jd->u.precreate_pool.error_code = -PVFS_ENOMEM;
+        return(1);
+    }
+
     gen_mutex_lock(&precreate_pool_mutex);
 
     fs = find_fs(jd->u.precreate_pool.fsid);
@@ -5900,6 +6119,7 @@ static void precreate_pool_get_handles_try_post(struct job_desc* jd)
         pool = qlist_entry(iterator,
                            struct precreate_pool,
                            list_link);
+        pool->need = 0;
 
         /* only queue up for the type the call is looking for. no reason to
          * to wait on a type we don't need. it should get filled later */
@@ -5911,35 +6131,12 @@ static void precreate_pool_get_handles_try_post(struct job_desc* jd)
             gossip_debug(GOSSIP_JOB_DEBUG, "Found empty precreate pool %llu\n", 
                          llu(pool->pool_handle));
             gen_mutex_unlock(&precreate_pool_mutex);
-            return;
+            free(pools);
+            return(0);
         }
     }
 
-    /* if we get to this point, set up necessary information for all trove 
-     * operations needed to service job
-     */
-    tmp_trove_array = malloc(jd->u.precreate_pool.precreate_handle_count *
-                             sizeof(struct precreate_pool_get_trove));
-    if(!tmp_trove_array)
-    {
-        gen_mutex_unlock(&precreate_pool_mutex);
-        gen_mutex_lock(&completion_mutex);        
-        jd->u.precreate_pool.error_code = -PVFS_ENOMEM;
-        job_desc_q_add(completion_queue_array[jd->context_id], jd);
-        jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);        
-        return;
-
-    }
-    jd->u.precreate_pool.data = tmp_trove_array;
-
-    /* translate reqested servers and set up necessary fields to post 
-     * trove operations
-     */
+    /* pick the pool that each handle will come from */
     for(i = 0; i < jd->u.precreate_pool.precreate_handle_count; i++)
     {
         if(jd->u.precreate_pool.servers)
@@ -5967,19 +6164,10 @@ static void precreate_pool_get_handles_try_post(struct job_desc* jd)
                 gossip_err("Error: get_handles(): unknown server: %s\n",
                     jd->u.precreate_pool.servers[i]);
 
-                free(tmp_trove_array);
                 gen_mutex_unlock(&precreate_pool_mutex);
-
-                gen_mutex_lock(&completion_mutex);        
+                free(pools);
                 jd->u.precreate_pool.error_code = -PVFS_EINVAL;
-                job_desc_q_add(completion_queue_array[jd->context_id], jd);
-                jd->completed_flag = 1;
-        #ifdef __PVFS2_JOB_THREADED__
-                /* wake up anyone waiting for completion */
-                pthread_cond_signal(&completion_cond);
-        #endif
-                gen_mutex_unlock(&completion_mutex);        
-                return;
+                return(1);
             }
         }
         else
@@ -6036,116 +6224,155 @@ static void precreate_pool_get_handles_try_post(struct job_desc* jd)
                 gossip_err("Error %s : could not find pool of "
                            "type %u\n", __func__, jd->u.precreate_pool.type);
 
-                free(tmp_trove_array);
                 gen_mutex_unlock(&precreate_pool_mutex);
-
-                gen_mutex_lock(&completion_mutex);        
+                free(pools);
                 jd->u.precreate_pool.error_code = -PVFS_EINVAL;
-                job_desc_q_add(completion_queue_array[jd->context_id], jd);
-                jd->completed_flag = 1;
-        #ifdef __PVFS2_JOB_THREADED__
-                /* wake up anyone waiting for completion */
-                pthread_cond_signal(&completion_cond);
-        #endif
-                gen_mutex_unlock(&completion_mutex);        
-                return;
+                return(1);
             }
         }
 
-        tmp_trove_array[i].pool =
-                qlist_entry(jd->u.precreate_pool.current_pool,
-                            struct precreate_pool, list_link);
+        pools[i] = qlist_entry(jd->u.precreate_pool.current_pool,
+                               struct precreate_pool, list_link);
+        pools[i]->need++;
+    }
 
-        tmp_trove_array[i].jd = jd;
-        tmp_trove_array[i].pos = PVFS_ITERATE_START;
-        tmp_trove_array[i].count = 1;
-        tmp_trove_array[i].key.buffer 
-                = &jd->u.precreate_pool.precreate_handle_array[i];
-        tmp_trove_array[i].key.buffer_sz = sizeof(PVFS_handle);
-        tmp_trove_array[i].trove_callback.fn 
-                = precreate_pool_get_thread_mgr_callback;
-        tmp_trove_array[i].trove_callback.data 
-                = &tmp_trove_array[i];
+    /* make sure every cache can cover its share of the request */
+    do
+    {
+        short_count = 0;
+        claimed = 0;
+        qlist_for_each(iterator, &fs->precreate_pool_list)
+        {
+            pool = qlist_entry(iterator, struct precreate_pool, list_link);
+            if(pool->need <= pool->cache_count)
+            {
+                continue;
+            }
+            short_count++;
+            if(pool->need > pool->pool_count)
+            {
+                /* wait for the refiller */
+                continue;
+            }
+            ret = pool->need - pool->cache_count;
+            if(ret < PRECREATE_POOL_CLAIM_BATCH)
+            {
+                ret = PRECREATE_POOL_CLAIM_BATCH;
+            }
+            ret = precreate_pool_claim_post(pool, ret);
+            if(ret < 0)
+            {
+                gen_mutex_unlock(&precreate_pool_mutex);
+                free(pools);
+                jd->u.precreate_pool.error_code = ret;
+                return(1);
+            }
+            claimed += ret;
+        }
+    } while(short_count && claimed);
+
+    if(short_count)
+    {
+        /* queue up until a claim or a refill completes */
+        gossip_debug(GOSSIP_JOB_DEBUG, "Waiting for %d precreate pool "
+                     "cache(s) to be refilled\n", short_count);
+        qlist_add(&jd->job_desc_q_link, &precreate_pool_get_handles_list);
+        gen_mutex_unlock(&precreate_pool_mutex);
+        free(pools);
+        return(0);
     }
 
-    /* post all trove operations at once */
+    /* hand out handles from memory */
     for(i = 0; i < jd->u.precreate_pool.precreate_handle_count; i++)
     { 
-        /* go ahead and decrement count to avoid races with other consumers */
-        tmp_trove_array[i].pool->pool_count--;
+        jd->u.precreate_pool.precreate_handle_array[i] =
+            precreate_pool_cache_pop(pools[i]);
+        pools[i]->pool_count--;
+        gossip_debug(GOSSIP_JOB_DEBUG, 
+            "Got precreated handle: %llu\n",
+            llu(jd->u.precreate_pool.precreate_handle_array[i]));
         gossip_debug(GOSSIP_JOB_DEBUG, 
             "Pool count for handle %llu (type %u) decremented to %d\n", 
-            llu(tmp_trove_array[i].pool->pool_handle), 
-            tmp_trove_array[i].pool->pool_type,
-            tmp_trove_array[i].pool->pool_count);
+            llu(pools[i]->pool_handle), pools[i]->pool_type,
+            pools[i]->pool_count);
 
         /* is anyone waiting to check the count of this pool? */
         if(!qlist_empty(&precreate_pool_check_level_list))
         {
-            qlist_for_each_safe(iterator, scratch, 
-                &precreate_pool_check_level_list)
-            {
-                jd_checker = qlist_entry(iterator,
-                                         struct job_desc,
-                                         job_desc_q_link);
-
-                if(jd_checker->u.precreate_pool.precreate_pool == 
-                    tmp_trove_array[i].pool->pool_handle &&
-                    tmp_trove_array[i].pool->pool_count < 
-                    jd_checker->u.precreate_pool.low_threshold)
-                {
-                    /* the pool level is low */
-                    gossip_debug(GOSSIP_JOB_DEBUG, "Pool count low, waking up waiter for handle %llu.\n", llu(jd_checker->u.precreate_pool.precreate_pool));
-                    qlist_del(&jd_checker->job_desc_q_link);
-
-                    /* move waiting job to completion queue */
-                    gen_mutex_lock(&completion_mutex);        
-                    job_desc_q_add(completion_queue_array[jd->context_id],
-                                   jd_checker);
-                    jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-                    /* wake up anyone waiting for completion */
-                    pthread_cond_signal(&completion_cond);
-#endif
-                    gen_mutex_unlock(&completion_mutex);        
-                }
-            }
+            precreate_pool_check_level_wake(pools[i]);
         }
+    }
 
-        /* post trove operation to pull out a handle */
-        ret = trove_keyval_iterate_keys(
-                fs->fsid, 
-                tmp_trove_array[i].pool->pool_handle,
-                &tmp_trove_array[i].pos,
-                &tmp_trove_array[i].key,
-                &tmp_trove_array[i].count,
-                tmp_trove_array[i].jd->u.precreate_pool.flags|
-                        TROVE_BINARY_KEY| TROVE_KEYVAL_HANDLE_COUNT|
-                        TROVE_KEYVAL_ITERATE_REMOVE,
-                NULL, 
-                &tmp_trove_array[i].trove_callback, 
-                global_trove_context,
-                &tmp_id,
-                jd->hints);
-
-        if(ret < 0)
-        {
-            precreate_pool_get_thread_mgr_callback_unlocked(
-                    &tmp_trove_array[i], ret);
-        }
-        else if(ret == 1)
+    /* keep the caches topped up in the background */
+    qlist_for_each(iterator, &fs->precreate_pool_list)
+    {
+        pool = qlist_entry(iterator, struct precreate_pool, list_link);
+        if(pool->need && pool->cache_count < PRECREATE_POOL_CLAIM_BATCH / 2)
         {
-            precreate_pool_get_thread_mgr_callback_unlocked(
-                    &tmp_trove_array[i], 0);
+            precreate_pool_claim_post(pool, PRECREATE_POOL_CLAIM_BATCH);
         }
-        else
+        pool->need = 0;
+    }
+    gen_mutex_unlock(&precreate_pool_mutex);
+
+    free(pools);
+    jd->u.precreate_pool.error_code = 0;
+    return(1);
+}
+
+/* job_precreate_pool_drain_cache()
+ *
+ * detaches the in-memory handles of the next pool that has any, so that
+ * the caller can store them back in the pool's keyval space before
+ * shutting down.  The caller must free *handle_array.
+ *
+ * returns 1 if handles were returned, 0 if no pool has cached handles,
+ * and -PVFS_errno on failure
+ */
+int job_precreate_pool_drain_cache(
+    PVFS_fs_id* fsid,
+    PVFS_handle* pool_handle,
+    PVFS_handle** handle_array,
+    int* count)
+{
+    struct qlist_head* iterator;
+    struct qlist_head* iterator2;
+    struct precreate_pool* pool;
+    struct fs_pool* fs;
+    int i;
+
+    gen_mutex_lock(&precreate_pool_mutex);
+    qlist_for_each(iterator2, &precreate_pool_fs_list)
+    {
+        fs = qlist_entry(iterator2, struct fs_pool, list_link);
+        qlist_for_each(iterator, &fs->precreate_pool_list)
         {
-            /* callback will be triggered later */
-            trove_pending_count++;
-            jd->u.precreate_pool.trove_pending++;
+            pool = qlist_entry(iterator, struct precreate_pool, list_link);
+            if(pool->cache_count == 0)
+            {
+                continue;
+            }
+
+            *handle_array = malloc(pool->cache_count * sizeof(PVFS_handle));
+            if(!*handle_array)
+            {
+                gen_mutex_unlock(&precreate_pool_mutex);
+                return(-PVFS_ENOMEM);
+            }
+            *fsid = fs->fsid;
+            *pool_handle = pool->pool_handle;
+            *count = pool->cache_count;
+            for(i = 0; i < *count; i++)
+            {
+                (*handle_array)[i] = precreate_pool_cache_pop(pool);
+            }
+            pool->pool_count -= *count;
+            gen_mutex_unlock(&precreate_pool_mutex);
+            return(1);
         }
     }
     gen_mutex_unlock(&precreate_pool_mutex);
+    return(0);
 }
 
 /* job_precreate_pool_iterate_handles()
@@ -6241,19 +6468,58 @@ int job_precreate_pool_iterate_handles(PVFS_fs_id fsid,
 
     if(local_position == PVFS_ITERATE_END)
     {
-        /* we got all of the handles out of the pool */
-        /* pass back pool handle by itself and go to next pool */
+        /* we got all of the handles out of the pool's keyval space */
+        /* pass back pool handle by itself and move on to the handles
+         * cached in memory
+         */
         handle_array[0] = pool->pool_handle;
-        /* skip to next pool */
-        pool_index++;
-        out_status_p->position = pool_index << 32;
-        out_status_p->position |= PVFS_ITERATE_START;
+        if(pool->cache_count == 0)
+        {
+            /* nothing cached; skip to next pool */
+            pool_index++;
+            out_status_p->position = pool_index << 32;
+            out_status_p->position |= PVFS_ITERATE_START;
+        }
+        else
+        {
+            out_status_p->position = pool_index << 32;
+            out_status_p->position |= PRECREATE_POOL_POS_CACHED;
+        }
         out_status_p->count = 1;
         out_status_p->error_code = 0;
         gen_mutex_unlock(&precreate_pool_mutex);
         return(1);
     }
 
+    if(local_position & PRECREATE_POOL_POS_CACHED)
+    {
+        /* low order bits are an offset into the in-memory cache */
+        local_position &= ~PRECREATE_POOL_POS_CACHED;
+        for(i = 0; i < count && local_position + i < pool->cache_count; i++)
+        {
+            handle_array[i] = pool->cache[
+                (pool->cache_head + local_position + i) % pool->cache_size];
+        }
+        local_position += i;
+        if(local_position >= pool->cache_count)
+        {
+            /* skip to next pool */
+            pool_index++;
+            out_status_p->position = pool_index << 32;
+            out_status_p->position |= PVFS_ITERATE_START;
+        }
+        else
+        {
+            out_status_p->position = pool_index << 32;
+            out_status_p->position |= PRECREATE_POOL_POS_CACHED;
+            out_status_p->position |= local_position;
+        }
+        out_status_p->count = i;
+        out_status_p->error_code = 0;
+        gen_mutex_unlock(&precreate_pool_mutex);
+        return(1);
+    }
+
     /* get ready to post a job to trove to find handles */
     jd = alloc_job_desc(JOB_PRECREATE_POOL);
     if (!jd)
@@ -193,7 +193,8 @@ int job_req_sched_post(enum PVFS_server_op op,
 		       job_aint status_user_tag,
 		       job_status_s * out_status_p,
 		       job_id_t * id,
-		       job_context_id context_id);
+		       job_context_id context_id,
+		       PVFS_hint hints);
 
 /* change the mode */
 int job_req_sched_change_mode(enum PVFS_server_mode mode,
@@ -704,6 +705,12 @@ int job_precreate_pool_get_handles(
     job_context_id context_id,
     PVFS_hint hints);
 
+int job_precreate_pool_drain_cache(
+    PVFS_fs_id* fsid,
+    PVFS_handle* pool_handle,
+    PVFS_handle** handle_array,
+    int* count);
+
 int job_precreate_pool_register_server(
     const char* host, 
     PVFS_ds_type type,
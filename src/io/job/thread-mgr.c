@@ -330,6 +330,12 @@ static void *dev_thread_function(void *ptr)
         {
             /* we need to wait until more unexp dev operations are posted */
 #ifdef __PVFS2_JOB_THREADED__
+            if(!dev_thread_running)
+            {
+                /* PINT_thread_mgr_dev_stop() woke us up */
+                gen_mutex_unlock(&dev_mutex);
+                return(NULL);
+            }
             pthread_cond_wait(&dev_unexp_test_cond, &dev_mutex);
             incount = dev_unexp_count;
 #else
@@ -529,6 +535,12 @@ int PINT_thread_mgr_dev_stop(void)
     {
 	assert(dev_thread_ref_count == 0); /* sanity check */
 	dev_thread_running = 0;
+#ifdef __PVFS2_JOB_THREADED__
+        /* the thread may be waiting for unexpected operations to be
+         * posted; wake it up so that it sees it has to exit
+         */
+        pthread_cond_signal(&dev_unexp_test_cond);
+#endif
         gen_mutex_unlock(&dev_mutex);
 #ifdef __PVFS2_JOB_THREADED__
 	pthread_join(dev_thread_id, NULL);
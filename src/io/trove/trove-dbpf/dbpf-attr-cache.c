@@ -4,31 +4,98 @@
  * See COPYING in top-level directory.
  */
 
+/*
+  The attribute cache is split into DBPF_ATTR_CACHE_STRIPES stripes,
+  selected by a hash of the object reference.  Each stripe has its own
+  lock, hash table and memory budget, so lookups of unrelated handles
+  do not contend.
+
+  Replacement within a stripe is a simplified 2Q: new elements are
+  placed on a probation FIFO and only move to the protected CLOCK ring
+  if they are referenced again before reaching the head of the FIFO.
+  A single pass over many handles (e.g. a recursive listing) therefore
+  only cycles through the probation list and leaves the hot set alone.
+*/
+
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 #include "gossip.h"
 #include "dbpf-attr-cache.h"
 #include "gen-locks.h"
 #include "str-utils.h"
+#include "pint-perf-counter.h"
 #include "pvfs2-internal.h"
 
-/* public mutex lock */
+/* public mutex lock; serializes configuration, initialize and finalize */
 gen_mutex_t dbpf_attr_cache_mutex = GEN_MUTEX_INITIALIZER;
 
-/* these are based on code from src/server/request-scheduler.c */
+struct dbpf_attr_cache_stripe
+{
+    gen_mutex_t mutex;
+    struct qhash_table *table;
+    /* FIFO of elements not yet referenced twice; oldest first */
+    struct qlist_head probation_list;
+    /* CLOCK ring of protected elements; the hand is the list head */
+    struct qlist_head protected_ring;
+    int num_elems;
+    int num_probation;
+    PVFS_size mem_used;
+};
+
 static int hash_key(const void *key, int table_size);
 static int hash_key_compare(const void *key, struct qlist_head *link);
 
+static struct dbpf_attr_cache_stripe s_stripes[DBPF_ATTR_CACHE_STRIPES];
+/* set once the stripe mutexes are usable; never cleared */
+static int s_stripe_locks_ready = 0;
+
 static int s_cache_size = DBPF_ATTR_CACHE_DEFAULT_SIZE;
-static int s_max_num_cache_elems = 
+static int s_max_num_cache_elems =
 DBPF_ATTR_CACHE_DEFAULT_MAX_NUM_CACHE_ELEMS;
-static struct qhash_table *s_key_to_attr_table = NULL;
+static int s_cache_memory_mb = DBPF_ATTR_CACHE_DEFAULT_MEMORY_MB;
+static int s_stripe_max_elems = 0;
+static PVFS_size s_stripe_max_mem = 0;
+static int s_initialized = 0;
 static char **s_cacheable_keyword_array = NULL;
 static int s_cacheable_keyword_array_size = 0;
-static int s_current_num_cache_elems = 0;
 
 #define DBPF_ATTR_CACHE_INITIALIZED() \
-(s_key_to_attr_table)
+(s_initialized)
+
+/* hash_ref()
+ *
+ * Fibonacci hash of an object reference.  The top bits select the
+ * stripe and the low bits the bucket within the stripe.
+ */
+static inline uint64_t hash_ref(const TROVE_object_ref *ref)
+{
+    uint64_t tmp = ((uint64_t)(uint32_t)ref->fs_id << 32) ^ ref->handle;
+
+    return tmp * 0x9e3779b97f4a7c15ULL;
+}
+
+static inline struct dbpf_attr_cache_stripe *stripe_of(
+    const TROVE_object_ref *ref)
+{
+    return &s_stripes[hash_ref(ref) >> (64 - DBPF_ATTR_CACHE_STRIPE_BITS)];
+}
+
+void dbpf_attr_cache_lock(TROVE_object_ref key)
+{
+    if (s_stripe_locks_ready)
+    {
+        gen_mutex_lock(&stripe_of(&key)->mutex);
+    }
+}
+
+void dbpf_attr_cache_unlock(TROVE_object_ref key)
+{
+    if (s_stripe_locks_ready)
+    {
+        gen_mutex_unlock(&stripe_of(&key)->mutex);
+    }
+}
 
 int dbpf_attr_cache_set_keywords(char *keywords)
 {
@@ -41,7 +108,7 @@ int dbpf_attr_cache_set_keywords(char *keywords)
     return (s_cacheable_keyword_array ? 0 : -1);
 }
 
-       
+
 int dbpf_attr_cache_set_size(int cache_size)
 {
     s_cache_size = cache_size;
@@ -54,6 +121,12 @@ int dbpf_attr_cache_set_max_num_elems(int max_num_elems)
     return 0;
 }
 
+int dbpf_attr_cache_set_memory_mb(int memory_mb)
+{
+    s_cache_memory_mb = memory_mb;
+    return 0;
+}
+
 /*
   the idea is that the other parameters are filled in
   by setinfo calls so that by the time this is called,
@@ -66,21 +139,42 @@ int dbpf_attr_cache_do_initialize(void)
     gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "There are %d cacheable "
                  "keywords registered\n", s_cacheable_keyword_array_size);
     ret = dbpf_attr_cache_initialize(
-        s_cache_size, s_max_num_cache_elems,
+        s_cache_size, s_max_num_cache_elems, s_cache_memory_mb,
         s_cacheable_keyword_array, s_cacheable_keyword_array_size);
 
     return ret;
 }
 
+/* default_memory_budget()
+ *
+ * 1/DBPF_ATTR_CACHE_DEFAULT_RAM_FRACTION of physical memory
+ */
+static PVFS_size default_memory_budget(void)
+{
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    if (pages <= 0 || page_size <= 0)
+    {
+        return (PVFS_size)64 * 1024 * 1024;
+    }
+    return (PVFS_size)pages * page_size /
+        DBPF_ATTR_CACHE_DEFAULT_RAM_FRACTION;
+}
+
 int dbpf_attr_cache_initialize(
     int table_size,
     int cache_max_num_elems,
+    int cache_memory_mb,
     char **cacheable_keywords,
     int num_cacheable_keywords)
 {
     int ret = -1, i = 0;
+    int buckets;
+    PVFS_size memory;
+    PVFS_size expected_elems;
 
-    if (s_key_to_attr_table == NULL)
+    if (!DBPF_ATTR_CACHE_INITIALIZED())
     {
         if (cacheable_keywords)
         {
@@ -112,19 +206,94 @@ int dbpf_attr_cache_initialize(
             }
         }
 
-        s_current_num_cache_elems = 0;
+        if (cache_memory_mb > 0)
+        {
+            memory = (PVFS_size)cache_memory_mb * 1024 * 1024;
+        }
+        else
+        {
+            memory = default_memory_budget();
+        }
         s_max_num_cache_elems = cache_max_num_elems;
-        s_key_to_attr_table = qhash_init(
-            hash_key_compare, hash_key, table_size);
-        if (!s_key_to_attr_table)
+        s_stripe_max_mem = memory / DBPF_ATTR_CACHE_STRIPES;
+        s_stripe_max_elems = 0;
+        if (cache_max_num_elems > 0)
+        {
+            s_stripe_max_elems = (cache_max_num_elems +
+                DBPF_ATTR_CACHE_STRIPES - 1) / DBPF_ATTR_CACHE_STRIPES;
+        }
+
+        /*
+          size each stripe's table for about one element per bucket
+          when the budget is full, unless told otherwise
+        */
+        if (table_size > 0)
+        {
+            buckets = table_size / DBPF_ATTR_CACHE_STRIPES;
+            if (buckets < 1)
+            {
+                buckets = 1;
+            }
+        }
+        else
+        {
+            expected_elems = s_stripe_max_mem /
+                (PVFS_size)sizeof(dbpf_attr_cache_elem_t);
+            if (s_stripe_max_elems && expected_elems > s_stripe_max_elems)
+            {
+                expected_elems = s_stripe_max_elems;
+            }
+            if (expected_elems < 16)
+            {
+                expected_elems = 16;
+            }
+            else if (expected_elems > 65536)
+            {
+                expected_elems = 65536;
+            }
+            buckets = (int)expected_elems;
+        }
+
+        if (!s_stripe_locks_ready)
         {
-            goto return_error;
+            for(i = 0; i < DBPF_ATTR_CACHE_STRIPES; i++)
+            {
+                gen_mutex_init(&s_stripes[i].mutex);
+            }
+            s_stripe_locks_ready = 1;
         }
 
-        srand((unsigned int)time(NULL));
+        for(i = 0; i < DBPF_ATTR_CACHE_STRIPES; i++)
+        {
+            struct dbpf_attr_cache_stripe *stripe = &s_stripes[i];
+
+            gen_mutex_lock(&stripe->mutex);
+            INIT_QLIST_HEAD(&stripe->probation_list);
+            INIT_QLIST_HEAD(&stripe->protected_ring);
+            stripe->num_elems = 0;
+            stripe->num_probation = 0;
+            stripe->mem_used = 0;
+            stripe->table = qhash_init(hash_key_compare, hash_key, buckets);
+            gen_mutex_unlock(&stripe->mutex);
+            if (!stripe->table)
+            {
+                while(--i >= 0)
+                {
+                    gen_mutex_lock(&s_stripes[i].mutex);
+                    qhash_finalize(s_stripes[i].table);
+                    s_stripes[i].table = NULL;
+                    gen_mutex_unlock(&s_stripes[i].mutex);
+                }
+                goto return_error;
+            }
+        }
+        s_initialized = 1;
 
         gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG,
-                     "dbpf_attr_cache_initialize: initialized\n");
+                     "dbpf_attr_cache_initialize: initialized with %d "
+                     "stripes of %d buckets, %lld bytes and %d elems "
+                     "per stripe\n", DBPF_ATTR_CACHE_STRIPES, buckets,
+                     lld(s_stripe_max_mem), s_stripe_max_elems);
         ret = 0;
     }
     else
@@ -138,42 +307,147 @@ int dbpf_attr_cache_initialize(
     return ret;
 }
 
+/* free_elem()
+ *
+ * frees an element and any keyval data cached with it; the element
+ * must already be unlinked from its stripe
+ */
+static void free_elem(dbpf_attr_cache_elem_t *cache_elem)
+{
+    int i;
+
+    for(i = 0; i < cache_elem->num_keyval_pairs; i++)
+    {
+        if (cache_elem->keyval_pairs[i].data)
+        {
+            free(cache_elem->keyval_pairs[i].data);
+        }
+    }
+    free(cache_elem);
+}
+
+/* unlink_elem()
+ *
+ * removes an element from its stripe's hash table and replacement list
+ */
+static void unlink_elem(struct dbpf_attr_cache_stripe *stripe,
+                        dbpf_attr_cache_elem_t *cache_elem)
+{
+    qhash_del(&cache_elem->hash_link);
+    qlist_del(&cache_elem->lru_link);
+    if (!cache_elem->is_protected)
+    {
+        stripe->num_probation--;
+    }
+    stripe->num_elems--;
+    stripe->mem_used -= cache_elem->mem_size;
+}
+
+static inline int stripe_over_limit(struct dbpf_attr_cache_stripe *stripe,
+                                    int extra_mem, int extra_elems)
+{
+    return ((stripe->mem_used + extra_mem > s_stripe_max_mem) ||
+            (s_stripe_max_elems &&
+             stripe->num_elems + extra_elems > s_stripe_max_elems));
+}
+
+/* stripe_make_room()
+ *
+ * evicts elements until extra_mem more bytes and extra_elems more
+ * elements fit in the stripe.  Elements referenced since they were
+ * queued get a second chance: on the probation list they are promoted
+ * to the protected ring, and on the ring their reference bit is
+ * cleared.  The probation list is trimmed first while it is larger
+ * than DBPF_ATTR_CACHE_PROBATION_PCT of the stripe.
+ */
+static void stripe_make_room(struct dbpf_attr_cache_stripe *stripe,
+                             int extra_mem, int extra_elems)
+{
+    dbpf_attr_cache_elem_t *victim = NULL;
+    int evicted = 0;
+
+    while (stripe_over_limit(stripe, extra_mem, extra_elems) &&
+           (!qlist_empty(&stripe->probation_list) ||
+            !qlist_empty(&stripe->protected_ring)))
+    {
+        if (!qlist_empty(&stripe->probation_list) &&
+            (qlist_empty(&stripe->protected_ring) ||
+             (stripe->num_probation * 100 >
+              stripe->num_elems * DBPF_ATTR_CACHE_PROBATION_PCT)))
+        {
+            victim = qlist_entry(stripe->probation_list.next,
+                                 dbpf_attr_cache_elem_t, lru_link);
+            if (victim->referenced)
+            {
+                qlist_del(&victim->lru_link);
+                victim->referenced = 0;
+                victim->is_protected = 1;
+                stripe->num_probation--;
+                qlist_add_tail(&victim->lru_link, &stripe->protected_ring);
+                continue;
+            }
+        }
+        else
+        {
+            victim = qlist_entry(stripe->protected_ring.next,
+                                 dbpf_attr_cache_elem_t, lru_link);
+            if (victim->referenced)
+            {
+                qlist_del(&victim->lru_link);
+                victim->referenced = 0;
+                qlist_add_tail(&victim->lru_link, &stripe->protected_ring);
+                continue;
+            }
+        }
+
+        gossip_debug(
+            GOSSIP_DBPF_ATTRCACHE_DEBUG, "*** Cache is full -- "
+            "evicting %s key %llu\n",
+            (victim->is_protected ? "protected" : "probationary"),
+            llu(victim->key.handle));
+        unlink_elem(stripe, victim);
+        free_elem(victim);
+        evicted++;
+    }
+
+    if (evicted)
+    {
+        PINT_perf_count(PINT_server_pc, PINT_PERF_ATTR_CACHE_EVICTIONS,
+                        evicted, PINT_PERF_ADD);
+    }
+}
+
 int dbpf_attr_cache_finalize(void)
 {
-    int ret = -1, i = 0, j = 0;
-    struct qlist_head *hash_link = NULL;
-    dbpf_attr_cache_elem_t *cache_elem = NULL;
+    int i = 0;
+    struct dbpf_attr_cache_stripe *stripe = NULL;
+    dbpf_attr_cache_elem_t *cache_elem = NULL, *tmp = NULL;
 
     if (DBPF_ATTR_CACHE_INITIALIZED())
     {
-        for(i = 0; i < s_key_to_attr_table->table_size; i++)
+        s_initialized = 0;
+        for(i = 0; i < DBPF_ATTR_CACHE_STRIPES; i++)
         {
-            do
+            stripe = &s_stripes[i];
+            gen_mutex_lock(&stripe->mutex);
+            qlist_for_each_entry_safe(cache_elem, tmp,
+                                      &stripe->probation_list, lru_link)
             {
-                hash_link = qhash_search_and_remove_at_index(
-                    s_key_to_attr_table,i);
-                if (hash_link)
-                {
-                    cache_elem = qhash_entry(
-                        hash_link, dbpf_attr_cache_elem_t, hash_link);
-                    for( j = 0; j < cache_elem->num_keyval_pairs; j++ )
-                    {
-                        /* any elements still existing need their keyval pairs
-                         * data pointer free'd before the element is free'd */
-                        if( cache_elem->keyval_pairs[j].data )
-                            free(cache_elem->keyval_pairs[j].data);
-                    }
-                    free(cache_elem);
-                    s_current_num_cache_elems--;
-                }
-            } while(hash_link);
+                unlink_elem(stripe, cache_elem);
+                free_elem(cache_elem);
+            }
+            qlist_for_each_entry_safe(cache_elem, tmp,
+                                      &stripe->protected_ring, lru_link)
+            {
+                unlink_elem(stripe, cache_elem);
+                free_elem(cache_elem);
+            }
+            assert(stripe->num_elems == 0);
+            qhash_finalize(stripe->table);
+            stripe->table = NULL;
+            gen_mutex_unlock(&stripe->mutex);
         }
 
-        assert(s_current_num_cache_elems == 0);
-        ret = ((i == s_key_to_attr_table->table_size) ? 0 : -1);
-        qhash_finalize(s_key_to_attr_table);
-        s_key_to_attr_table = NULL;
-
         gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG,
                      "dbpf_attr_cache_finalized\n");
     }
@@ -185,28 +459,45 @@ int dbpf_attr_cache_finalize(void)
         s_cacheable_keyword_array = NULL;
         s_cacheable_keyword_array_size = 0;
     }
-    return ret;
+    return 0;
 }
 
-dbpf_attr_cache_elem_t *dbpf_attr_cache_elem_lookup(TROVE_object_ref key)
+/* stripe_lookup()
+ *
+ * finds the element for key in its (locked) stripe without touching
+ * its reference bit
+ */
+static dbpf_attr_cache_elem_t *stripe_lookup(
+    struct dbpf_attr_cache_stripe *stripe, TROVE_object_ref *key)
 {
     struct qlist_head *hash_link = NULL;
+
+    if (!stripe->table)
+    {
+        return NULL;
+    }
+    hash_link = qhash_search(stripe->table, key);
+    if (!hash_link)
+    {
+        return NULL;
+    }
+    return qhash_entry(hash_link, dbpf_attr_cache_elem_t, hash_link);
+}
+
+dbpf_attr_cache_elem_t *dbpf_attr_cache_elem_lookup(TROVE_object_ref key)
+{
+    struct dbpf_attr_cache_stripe *stripe = stripe_of(&key);
     dbpf_attr_cache_elem_t *cache_elem = NULL;
 
-    if (DBPF_ATTR_CACHE_INITIALIZED())
+    cache_elem = stripe_lookup(stripe, &key);
+    if (cache_elem)
     {
-        hash_link = qhash_search(s_key_to_attr_table,&(key));
-        if (hash_link)
-        {
-            cache_elem = qhash_entry(
-                hash_link, dbpf_attr_cache_elem_t, hash_link);
-            assert(cache_elem);
-            gossip_debug(
-                GOSSIP_DBPF_ATTRCACHE_DEBUG,
-                "dbpf_cache_elem_lookup: cache "
-                "elem matching %llu returned (num_elems=%d)\n",
-                llu(key.handle), s_current_num_cache_elems);
-        }
+        cache_elem->referenced = 1;
+        gossip_debug(
+            GOSSIP_DBPF_ATTRCACHE_DEBUG,
+            "dbpf_cache_elem_lookup: cache "
+            "elem matching %llu returned (num_elems=%d)\n",
+            llu(key.handle), stripe->num_elems);
     }
     return cache_elem;
 }
@@ -220,15 +511,12 @@ int dbpf_attr_cache_ds_attr_update_cached_data(
     cache_elem = dbpf_attr_cache_elem_lookup(key);
     if (cache_elem && src_ds_attr)
     {
-        if (cache_elem && src_ds_attr)
-        {
-            memcpy(&cache_elem->attr, src_ds_attr,
-                   sizeof(TROVE_ds_attributes));
-            gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "Updating "
-                         "cached attributes for key %llu\n",
-                         llu(key.handle));
-            ret = 0;
-        }
+        memcpy(&cache_elem->attr, src_ds_attr,
+               sizeof(TROVE_ds_attributes));
+        gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "Updating "
+                     "cached attributes for key %llu\n",
+                     llu(key.handle));
+        ret = 0;
     }
     return ret;
 }
@@ -242,14 +530,11 @@ int dbpf_attr_cache_ds_attr_update_cached_data_bsize(
     cache_elem = dbpf_attr_cache_elem_lookup(key);
     if (cache_elem)
     {
-        if (cache_elem)
-        {
-            cache_elem->attr.u.datafile.b_size = b_size;
-            gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "Updating "
-                         "cached b_size for key %llu\n",
-                         llu(key.handle));
-            ret = 0;
-        }
+        cache_elem->attr.u.datafile.b_size = b_size;
+        gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "Updating "
+                     "cached b_size for key %llu\n",
+                     llu(key.handle));
+        ret = 0;
     }
     return ret;
 }
@@ -257,24 +542,28 @@ int dbpf_attr_cache_ds_attr_update_cached_data_bsize(
 int dbpf_attr_cache_ds_attr_fetch_cached_data(
     TROVE_object_ref key, TROVE_ds_attributes *target_ds_attr)
 {
-    int ret = -1;
-    struct qlist_head *hash_link = NULL;
+    struct dbpf_attr_cache_stripe *stripe = stripe_of(&key);
     dbpf_attr_cache_elem_t *cache_elem = NULL;
 
-    if (DBPF_ATTR_CACHE_INITIALIZED() && target_ds_attr)
+    if (!target_ds_attr || !stripe->table)
     {
-        hash_link = qhash_search(s_key_to_attr_table,&(key));
-        if (hash_link)
-        {
-            cache_elem = qhash_entry(
-                hash_link, dbpf_attr_cache_elem_t, hash_link);
-            assert(cache_elem);
-            memcpy(target_ds_attr, &cache_elem->attr,
-                   sizeof(TROVE_ds_attributes));
-            ret = 0;
-        }
+        return -1;
     }
-    return ret;
+
+    cache_elem = stripe_lookup(stripe, &key);
+    if (!cache_elem)
+    {
+        PINT_perf_count(PINT_server_pc, PINT_PERF_ATTR_CACHE_MISSES,
+                        1, PINT_PERF_ADD);
+        return -1;
+    }
+
+    cache_elem->referenced = 1;
+    memcpy(target_ds_attr, &cache_elem->attr,
+           sizeof(TROVE_ds_attributes));
+    PINT_perf_count(PINT_server_pc, PINT_PERF_ATTR_CACHE_HITS,
+                    1, PINT_PERF_ADD);
+    return 0;
 }
 
 dbpf_keyval_pair_cache_elem_t *dbpf_attr_cache_elem_get_data_based_on_key(
@@ -287,17 +576,25 @@ dbpf_keyval_pair_cache_elem_t *dbpf_attr_cache_elem_get_data_based_on_key(
     {
         for(i = 0; i < cache_elem->num_keyval_pairs; i++)
         {
-            if ((strcmp(cache_elem->keyval_pairs[i].key, key) == 0) &&
-                (cache_elem->keyval_pairs[i].data != NULL))
+            if (strcmp(cache_elem->keyval_pairs[i].key, key) != 0)
             {
-                gossip_debug(
-                    GOSSIP_DBPF_ATTRCACHE_DEBUG, "Returning data %p "
-                    "based on key %llu and key_str %s (data_sz=%d)\n",
-                    cache_elem->keyval_pairs[i].data,
-                    llu(cache_elem->key.handle), key,
-                    cache_elem->keyval_pairs[i].data_sz);
-                return &cache_elem->keyval_pairs[i];
+                continue;
             }
+            if (cache_elem->keyval_pairs[i].data == NULL)
+            {
+                PINT_perf_count(PINT_server_pc, PINT_PERF_ATTR_CACHE_MISSES,
+                                1, PINT_PERF_ADD);
+                break;
+            }
+            gossip_debug(
+                GOSSIP_DBPF_ATTRCACHE_DEBUG, "Returning data %p "
+                "based on key %llu and key_str %s (data_sz=%d)\n",
+                cache_elem->keyval_pairs[i].data,
+                llu(cache_elem->key.handle), key,
+                cache_elem->keyval_pairs[i].data_sz);
+            PINT_perf_count(PINT_server_pc, PINT_PERF_ATTR_CACHE_HITS,
+                            1, PINT_PERF_ADD);
+            return &cache_elem->keyval_pairs[i];
         }
     }
     return NULL;
@@ -306,37 +603,69 @@ dbpf_keyval_pair_cache_elem_t *dbpf_attr_cache_elem_get_data_based_on_key(
 int dbpf_attr_cache_elem_set_data_based_on_key(
     TROVE_object_ref key, char *key_str, void *data, int data_sz)
 {
-    int ret = - 1, i = 0;
+    int ret = - 1, i = 0, grow = 0;
+    struct dbpf_attr_cache_stripe *stripe = stripe_of(&key);
     dbpf_attr_cache_elem_t *cache_elem = NULL;
+    void *new_data = NULL;
 
     cache_elem = dbpf_attr_cache_elem_lookup(key);
-    if (cache_elem && key_str && cache_elem->num_keyval_pairs)
+    if (!cache_elem || !key_str || !cache_elem->num_keyval_pairs)
     {
-        if (!cache_elem || !cache_elem->num_keyval_pairs)
-        {
-            return ret;
-        }
-        for(i = 0; i < cache_elem->num_keyval_pairs; i++)
+        return ret;
+    }
+    for(i = 0; i < cache_elem->num_keyval_pairs; i++)
+    {
+        if (strcmp(cache_elem->keyval_pairs[i].key, key_str) == 0)
         {
-            if (strcmp(cache_elem->keyval_pairs[i].key, key_str) == 0)
+            gossip_debug(
+                GOSSIP_DBPF_ATTRCACHE_DEBUG,
+                "Setting data %p based on key "
+                "%llu and key_str %s (data_sz=%d)\n", data,
+                llu(key.handle), key_str, data_sz);
+
+            new_data = malloc(data_sz);
+            if (!new_data)
             {
-                gossip_debug(
-                    GOSSIP_DBPF_ATTRCACHE_DEBUG,
-                    "Setting data %p based on key "
-                    "%llu and key_str %s (data_sz=%d)\n", data,
-                    llu(key.handle), key_str, data_sz);
+                break;
+            }
+            memcpy(new_data, data, data_sz);
 
-                if (cache_elem->keyval_pairs[i].data)
+            grow = data_sz - cache_elem->keyval_pairs[i].data_sz;
+            if (grow > 0)
+            {
+                /*
+                  take this element off its list while making room so
+                  that it cannot be chosen as a victim itself
+                */
+                qlist_del(&cache_elem->lru_link);
+                if (!cache_elem->is_protected)
                 {
-                    free(cache_elem->keyval_pairs[i].data);
+                    stripe->num_probation--;
                 }
-                cache_elem->keyval_pairs[i].data = malloc(data_sz);
-                assert(cache_elem->keyval_pairs[i].data);
-                memcpy(cache_elem->keyval_pairs[i].data, data, data_sz);
-                cache_elem->keyval_pairs[i].data_sz = data_sz;
-                ret = 0;
-                break;
+                stripe_make_room(stripe, grow, 0);
+                if (cache_elem->is_protected)
+                {
+                    qlist_add_tail(&cache_elem->lru_link,
+                                   &stripe->protected_ring);
+                }
+                else
+                {
+                    qlist_add_tail(&cache_elem->lru_link,
+                                   &stripe->probation_list);
+                    stripe->num_probation++;
+                }
+            }
+
+            if (cache_elem->keyval_pairs[i].data)
+            {
+                free(cache_elem->keyval_pairs[i].data);
             }
+            cache_elem->keyval_pairs[i].data = new_data;
+            cache_elem->keyval_pairs[i].data_sz = data_sz;
+            cache_elem->mem_size += grow;
+            stripe->mem_used += grow;
+            ret = 0;
+            break;
         }
     }
     return ret;
@@ -371,170 +700,108 @@ int dbpf_attr_cache_insert(
     TROVE_object_ref key,
     TROVE_ds_attributes *attr)
 {
-    int ret = -1, i = 0, already_exists = 0;
+    int i = 0;
+    struct dbpf_attr_cache_stripe *stripe = stripe_of(&key);
     dbpf_attr_cache_elem_t *cache_elem = NULL;
-    struct qlist_head *hash_link = NULL;
 
-    if (DBPF_ATTR_CACHE_INITIALIZED())
+    if (!stripe->table)
     {
-        if ((s_current_num_cache_elems + 1) > s_max_num_cache_elems)
-        {
-            TROVE_object_ref sacrificial_lamb_key =
-                {TROVE_HANDLE_NULL, TROVE_COLL_ID_NULL};
-            /*
-              we have the lock, so we can safely remove
-              any element in this cache at this point;
-              since our hashtable isn't sorted, and a hit/age
-              count would be too costly in a linear search
-              here, just remove the first element at an arbitrary
-              hashed index that we can find in the hash table
-            */
-            i = (rand() % s_key_to_attr_table->table_size);
-          hashtable_linear_scan:
-            for(; i < s_key_to_attr_table->table_size; i++)
-            {
-                hash_link =
-                    qhash_search_at_index(s_key_to_attr_table,i);
-                if (hash_link)
-                {
-                    cache_elem = qhash_entry(
-                        hash_link, dbpf_attr_cache_elem_t, hash_link);
-                    sacrificial_lamb_key = cache_elem->key;
-                    break;
-                }
-            }
+        return -1;
+    }
 
-            /*
-              handle a special case where the random index
-              yields a completely empty linked list; start again
-              at 0, as *something* must be in the hash table
-            */
-            if ((i == s_key_to_attr_table->table_size) &&
-                (sacrificial_lamb_key.handle == TROVE_HANDLE_NULL))
+    cache_elem = stripe_lookup(stripe, &key);
+    if (cache_elem)
+    {
+        /*
+          the attributes were reread from disk; drop any cached keyvals
+          since they may be older than the attributes
+        */
+        for(i = 0; i < cache_elem->num_keyval_pairs; i++)
+        {
+            if (cache_elem->keyval_pairs[i].data)
             {
-                i = 0;
-                goto hashtable_linear_scan;
+                free(cache_elem->keyval_pairs[i].data);
+                cache_elem->keyval_pairs[i].data = NULL;
+                cache_elem->mem_size -= cache_elem->keyval_pairs[i].data_sz;
+                stripe->mem_used -= cache_elem->keyval_pairs[i].data_sz;
+                cache_elem->keyval_pairs[i].data_sz = 0;
             }
-            assert(sacrificial_lamb_key.handle != TROVE_HANDLE_NULL);
-            gossip_debug(
-                GOSSIP_DBPF_ATTRCACHE_DEBUG, "*** Cache is full -- "
-                "removing key %llu to insert key %llu\n",
-                llu(sacrificial_lamb_key.handle), llu(key.handle));
-            dbpf_attr_cache_remove(sacrificial_lamb_key);
-        }
-
-        hash_link = qhash_search(s_key_to_attr_table,&(key));
-        if (!hash_link)
-        {
-            cache_elem = (dbpf_attr_cache_elem_t *)
-                malloc(sizeof(dbpf_attr_cache_elem_t));
-        }
-        else
-        {
-            cache_elem = qhash_entry(
-                hash_link, dbpf_attr_cache_elem_t, hash_link);
-            already_exists = 1;
         }
+        memcpy(&(cache_elem->attr), attr, sizeof(TROVE_ds_attributes));
+        cache_elem->referenced = 1;
+        return 0;
+    }
 
-        if (cache_elem)
-        {
-            if (!already_exists)
-            {
-                memset(cache_elem, 0, sizeof(dbpf_attr_cache_elem_t));
-            }
+    stripe_make_room(stripe, sizeof(dbpf_attr_cache_elem_t), 1);
 
-            if (s_cacheable_keyword_array)
-            {
-                /* initialize all of the keyvals we're able to cache */
-                for(i = 0; i < s_cacheable_keyword_array_size; i++)
-                {
-                    cache_elem->keyval_pairs[i].key =
-                        s_cacheable_keyword_array[i];
-                    cache_elem->keyval_pairs[i].data = NULL;
-                }
-                cache_elem->num_keyval_pairs =
-                    s_cacheable_keyword_array_size;
-            }
+    cache_elem = (dbpf_attr_cache_elem_t *)
+        malloc(sizeof(dbpf_attr_cache_elem_t));
+    if (!cache_elem)
+    {
+        return -1;
+    }
+    memset(cache_elem, 0, sizeof(dbpf_attr_cache_elem_t));
 
-            cache_elem->key = key;
-            memcpy(&(cache_elem->attr), attr,
-                   sizeof(TROVE_ds_attributes));
-            if (!already_exists)
-            {
-                qhash_add(
-                    s_key_to_attr_table,&(key),&(cache_elem->hash_link));
-                s_current_num_cache_elems++;
-                gossip_debug(
-                    GOSSIP_DBPF_ATTRCACHE_DEBUG,
-                    "dbpf_attr_cache_insert: inserting %llu "
-                    "(b_size is %llu)\n", llu(key.handle),
-                    llu(cache_elem->attr.u.datafile.b_size));
-            }
-            ret = 0;
+    if (s_cacheable_keyword_array)
+    {
+        /* initialize all of the keyvals we're able to cache */
+        for(i = 0; i < s_cacheable_keyword_array_size; i++)
+        {
+            cache_elem->keyval_pairs[i].key =
+                s_cacheable_keyword_array[i];
         }
+        cache_elem->num_keyval_pairs = s_cacheable_keyword_array_size;
     }
-    return ret;
+
+    cache_elem->key = key;
+    memcpy(&(cache_elem->attr), attr, sizeof(TROVE_ds_attributes));
+    cache_elem->mem_size = sizeof(dbpf_attr_cache_elem_t);
+
+    qhash_add(stripe->table, &(key), &(cache_elem->hash_link));
+    qlist_add_tail(&cache_elem->lru_link, &stripe->probation_list);
+    stripe->num_probation++;
+    stripe->num_elems++;
+    stripe->mem_used += cache_elem->mem_size;
+
+    gossip_debug(
+        GOSSIP_DBPF_ATTRCACHE_DEBUG,
+        "dbpf_attr_cache_insert: inserting %llu "
+        "(b_size is %llu)\n", llu(key.handle),
+        llu(cache_elem->attr.u.datafile.b_size));
+    return 0;
 }
 
 int dbpf_attr_cache_remove(TROVE_object_ref key)
 {
-    int ret = -1, i = 0;
-    struct qlist_head *hash_link = NULL;
+    struct dbpf_attr_cache_stripe *stripe = stripe_of(&key);
     dbpf_attr_cache_elem_t *cache_elem = NULL;
 
-    if (DBPF_ATTR_CACHE_INITIALIZED())
+    cache_elem = stripe_lookup(stripe, &key);
+    if (!cache_elem)
     {
-        hash_link = qhash_search_and_remove(s_key_to_attr_table,&(key));
-        if (hash_link)
-        {
-            cache_elem = qhash_entry(
-                hash_link, dbpf_attr_cache_elem_t, hash_link);
-            assert(cache_elem);
+        return -1;
+    }
 
-            gossip_debug(
-                GOSSIP_DBPF_ATTRCACHE_DEBUG, "dbpf_attr_cache_remove: "
-                "removing %llu\n", llu(key.handle));
+    gossip_debug(
+        GOSSIP_DBPF_ATTRCACHE_DEBUG, "dbpf_attr_cache_remove: "
+        "removing %llu\n", llu(key.handle));
 
-            /* free any keyval data cached as well */
-            if (s_cacheable_keyword_array)
-            {
-                /* free all of the keyvals we've cached */
-                assert(s_cacheable_keyword_array_size ==
-                       cache_elem->num_keyval_pairs);
-                for(i = 0; i < cache_elem->num_keyval_pairs; i++)
-                {
-                    cache_elem->keyval_pairs[i].key = NULL;
-                    if (cache_elem->keyval_pairs[i].data)
-                    {
-                        free(cache_elem->keyval_pairs[i].data);
-                        cache_elem->keyval_pairs[i].data = NULL;
-                    }
-                }
-            }
-            free(cache_elem);
-            s_current_num_cache_elems--;
-            ret = 0;
-        }
-    }
-    return ret;
+    unlink_elem(stripe, cache_elem);
+    free_elem(cache_elem);
+    return 0;
 }
 
 /* hash_key()
  *
- * hash function for fsids added to table
+ * hash function for object refs added to a stripe's table
  *
  * returns integer offset into table
  */
 static int hash_key(const void *key, int table_size)
 {
-    unsigned long tmp = 0;
     const TROVE_object_ref *ref = (const TROVE_object_ref *)key;
 
-    tmp = (ref->fs_id << 12);
-    tmp += ref->handle;
-    tmp = (tmp % table_size);
-
-    return ((int)tmp);
+    return ((int)((hash_ref(ref) & 0xffffffffULL) % table_size));
 }
 
 /* hash_key_compare()
@@ -18,8 +18,28 @@
 */
 #define DBPF_ATTR_CACHE_MAX_NUM_KEYVALS                 8
 
-#define DBPF_ATTR_CACHE_DEFAULT_SIZE                  511
-#define DBPF_ATTR_CACHE_DEFAULT_MAX_NUM_CACHE_ELEMS  1024
+/*
+  the cache is split into 2^DBPF_ATTR_CACHE_STRIPE_BITS independently
+  locked stripes, each with its own hash table and replacement lists
+*/
+#define DBPF_ATTR_CACHE_STRIPE_BITS                     6
+#define DBPF_ATTR_CACHE_STRIPES (1 << DBPF_ATTR_CACHE_STRIPE_BITS)
+
+/*
+  a table size or element limit of 0 means "derive it from the
+  memory budget"; a memory budget of 0 means a fraction of RAM
+*/
+#define DBPF_ATTR_CACHE_DEFAULT_SIZE                    0
+#define DBPF_ATTR_CACHE_DEFAULT_MAX_NUM_CACHE_ELEMS     0
+#define DBPF_ATTR_CACHE_DEFAULT_MEMORY_MB               0
+#define DBPF_ATTR_CACHE_DEFAULT_RAM_FRACTION           64
+
+/*
+  new entries are kept on probation until they are referenced again;
+  the probation list is trimmed first while it holds more than this
+  percentage of a stripe's entries
+*/
+#define DBPF_ATTR_CACHE_PROBATION_PCT                  25
 
 typedef struct
 {
@@ -35,6 +55,12 @@ typedef struct
 typedef struct
 {
     struct qlist_head hash_link;
+    /* link on the stripe's probation list or protected clock ring */
+    struct qlist_head lru_link;
+    int is_protected;
+    int referenced;
+    /* bytes charged to the memory budget for this element */
+    int mem_size;
 
     TROVE_object_ref key;
     TROVE_ds_attributes attr;
@@ -50,12 +76,23 @@ typedef struct
  * all methods return 0 on success; -1 on failure
  * (unless noted)
  *
+ * callers must hold the stripe lock for the key
+ * (see dbpf_attr_cache_lock) around every method
+ * that takes a key or a cached element, and must
+ * not use a cached element after unlocking
+ *
  ***********************************************/
 
+void dbpf_attr_cache_lock(TROVE_object_ref key);
+void dbpf_attr_cache_unlock(TROVE_object_ref key);
+
 /*
-  - table size is the hash table size
+  - table size is the total number of hash buckets over all
+    stripes (0 sizes the tables from the memory budget)
   - cache_max_num_elems bounds the number of elems stored
-    in that hash table
+    in the cache (0 for no bound other than memory)
+  - cache_memory_mb bounds the memory used by cached elems
+    and their keyval data (0 for a fraction of physical RAM)
   - cacheable_keywords are keywords that we are allowed to cache
     during keyval reads/writes
   - num_cacheable_keywords is the number of keywords in the
@@ -65,6 +102,7 @@ typedef struct
 int dbpf_attr_cache_initialize(
     int table_size,
     int cache_max_num_elems,
+    int cache_memory_mb,
     char **cacheable_keywords,
     int num_cacheable_keywords);
 
@@ -133,6 +171,7 @@ int dbpf_attr_cache_keyval_pair_fetch_cached_data(
 int dbpf_attr_cache_set_keywords(char *keywords);
 int dbpf_attr_cache_set_size(int cache_size);
 int dbpf_attr_cache_set_max_num_elems(int max_num_elems);
+int dbpf_attr_cache_set_memory_mb(int memory_mb);
 int dbpf_attr_cache_do_initialize(void);
 
 #endif /* __DBPF_ATTR_CACHE_H */
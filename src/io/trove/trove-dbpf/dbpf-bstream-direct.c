@@ -29,6 +29,7 @@
 #include "dbpf-attr-cache.h"
 #include "dbpf-bstream.h"
 #include "dbpf-sync.h"
+#include "dbpf-readahead.h"
 /* #include "pint-mem.h" obsolete */
 #include "pint-mgmt.h"
 #include "pint-context.h"
@@ -716,6 +717,7 @@ static int dbpf_bstream_direct_read_op_svc(void *ptr, PVFS_hint hint)
     struct dbpf_bstream_rw_list_op *rw_op;
     dbpf_stream_extents_t *stream_extents = NULL;
     int i, extent_count;
+    TROVE_size read_size;
 
     rw_op = (struct dbpf_bstream_rw_list_op *)ptr;
     qop_p = (dbpf_queued_op_t *)rw_op->queued_op_ptr;
@@ -770,8 +772,31 @@ static int dbpf_bstream_direct_read_op_svc(void *ptr, PVFS_hint hint)
         goto done;
     }
 
+    dbpf_readahead_direct(ref.fs_id, ref.handle,
+                          rw_op->stream_offset_array,
+                          rw_op->stream_size_array,
+                          rw_op->stream_array_count,
+                          attr.u.datafile.b_size);
+
     for(i = 0; i < extent_count; ++ i)
     {
+        /* serve the extent from readahead chunks if they cover it */
+        if(stream_extents[i].offset < attr.u.datafile.b_size)
+        {
+            read_size = attr.u.datafile.b_size - stream_extents[i].offset;
+            if(read_size > stream_extents[i].size)
+            {
+                read_size = stream_extents[i].size;
+            }
+            if(dbpf_readahead_copy(ref.fs_id, ref.handle,
+                                   stream_extents[i].buffer,
+                                   stream_extents[i].offset,
+                                   read_size))
+            {
+                continue;
+            }
+        }
+
         ret = direct_locked_read(rw_op->open_ref.fd,
                           stream_extents[i].buffer,
                           0,
@@ -1020,6 +1045,8 @@ static int dbpf_bstream_direct_write_op_svc(void *ptr, PVFS_hint hint)
 cache_put:
     dbpf_open_cache_put(&rw_op->open_ref);
 done:
+    /* drop readahead chunks that may predate this write */
+    dbpf_readahead_invalidate(ref.fs_id, ref.handle);
     if(stream_extents)
     {
         free(stream_extents);
@@ -1282,6 +1309,7 @@ static int dbpf_bstream_direct_resize_op_svc(struct dbpf_op *op_p)
     {
         return(ret);
     }
+    dbpf_readahead_invalidate(ref.fs_id, ref.handle);
 
     dbpf_open_cache_put(&open_ref);
 
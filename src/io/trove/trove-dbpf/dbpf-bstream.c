@@ -27,10 +27,10 @@
 #include "pint-event.h"
 #include "dbpf-open-cache.h"
 #include "dbpf-sync.h"
+#include "dbpf-readahead.h"
 
 #include "dbpf-alt-aio.h"
 
-extern gen_mutex_t dbpf_attr_cache_mutex;
 
 #define AIOCB_ARRAY_SZ 64
 
@@ -880,6 +880,13 @@ inline int dbpf_bstream_rw_list(TROVE_coll_id coll_id,
     }
     q_op_p->op.u.b_rw_list.fd = q_op_p->op.u.b_rw_list.open_ref.fd;
 
+    if (opcode == LIO_READ)
+    {
+        dbpf_readahead_advise(coll_id, handle, q_op_p->op.u.b_rw_list.fd,
+                              stream_offset_array, stream_size_array,
+                              stream_count);
+    }
+
     /*
       if we're doing an i/o write, remove the cached attribute for
       this handle if it's present
@@ -887,9 +894,9 @@ inline int dbpf_bstream_rw_list(TROVE_coll_id coll_id,
     if (opcode == LIO_WRITE)
     {
         TROVE_object_ref ref = {handle, coll_id};
-        gen_mutex_lock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_lock(ref);
         dbpf_attr_cache_remove(ref);
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_unlock(ref);
     }
 
 #ifndef __PVFS2_TROVE_AIO_THREADED__
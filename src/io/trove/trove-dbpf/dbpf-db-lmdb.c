@@ -264,7 +264,9 @@ int dbpf_db_get(struct dbpf_db *db, struct dbpf_data *key,
         return db_error(r);
     }
 
-    memcpy(val->data, db_data.mv_data, val->len);
+    /* a shorter record must not read past the end of the stored value */
+    memcpy(val->data, db_data.mv_data,
+           db_data.mv_size < val->len ? db_data.mv_size : val->len);
     val->len = db_data.mv_size;
     return 0;
 }
@@ -432,8 +434,10 @@ int dbpf_db_cursor_get(struct dbpf_cursor *dbc, struct dbpf_data *key,
         return db_error(r);
     }
 
-    memcpy(key->data, db_key.mv_data, key->len);
-    memcpy(val->data, db_data.mv_data, val->len);
+    memcpy(key->data, db_key.mv_data,
+           db_key.mv_size < key->len ? db_key.mv_size : key->len);
+    memcpy(val->data, db_data.mv_data,
+           db_data.mv_size < val->len ? db_data.mv_size : val->len);
     key->len = db_key.mv_size;
     val->len = db_data.mv_size;
     return 0;
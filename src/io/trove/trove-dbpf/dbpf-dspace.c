@@ -31,6 +31,7 @@
 #include "dbpf-op-queue.h"
 #include "dbpf-attr-cache.h"
 #include "dbpf-open-cache.h"
+#include "dbpf-readahead.h"
 
 #define TROVE_DEFAULT_DB_PAGESIZE 512
 
@@ -49,7 +50,6 @@ extern gen_mutex_t dbpf_completion_queue_array_mutex[TROVE_MAX_CONTEXTS];
 extern struct qlist_head dbpf_op_queue;
 extern gen_mutex_t dbpf_op_queue_mutex;
 #endif
-extern gen_mutex_t dbpf_attr_cache_mutex;
 
 int64_t s_dbpf_metadata_writes = 0, s_dbpf_metadata_reads = 0;
 
@@ -541,11 +541,11 @@ static int remove_one_handle(TROVE_object_ref ref,
     }
 
     /* if this attr is in the dbpf attr cache, remove it */
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     gossip_debug(GOSSIP_TROVE_DEBUG,
 		 "%s: removing attr from cache\n", __func__);
     dbpf_attr_cache_remove(ref);
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     /* remove bstream if it exists.  Not a fatal
      * error if this fails (may not have ever been created)
@@ -553,6 +553,7 @@ static int remove_one_handle(TROVE_object_ref ref,
     gossip_debug(GOSSIP_TROVE_DEBUG,
 		 "%s: removing bstream from cache\n", __func__);
     ret = dbpf_open_cache_remove(coll_p->coll_id, ref.handle);
+    dbpf_readahead_invalidate(coll_p->coll_id, ref.handle);
 
     /* remove the keyval entries for this handle if any exist.
      * this way seems a bit messy to me, i.e. we're operating
@@ -987,7 +988,7 @@ static int dbpf_dspace_getattr(TROVE_coll_id coll_id,
     PINT_event_type event_type;
 
     /* fast path cache hit; skips queueing */
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     if (dbpf_attr_cache_ds_attr_fetch_cached_data(ref, ds_attr_p) == 0)
     {
 #if 0
@@ -1021,11 +1022,11 @@ static int dbpf_dspace_getattr(TROVE_coll_id coll_id,
                          llu(ds_attr_p->u.dirdata.count));
         }
 
+        dbpf_attr_cache_unlock(ref);
         UPDATE_PERF_METADATA_READ();
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
         return 1;
     }
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     coll_p = dbpf_collection_find_registered(coll_id);
     if (coll_p == NULL)
@@ -1086,13 +1087,13 @@ static int dbpf_dspace_getattr_list(TROVE_coll_id coll_id,
     int i;
     int cache_hits = 0; 
 
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
     /* go ahead and try to hit attr cache for all handles up front */ 
     for (i = 0; i < nhandles; i++) 
     {
         ref.handle = handle_array[i];
         ref.fs_id = coll_id;
 
+        dbpf_attr_cache_lock(ref);
         if (dbpf_attr_cache_ds_attr_fetch_cached_data(ref, &ds_attr_p[i]) == 0)
         {
 #if 0
@@ -1129,19 +1130,20 @@ static int dbpf_dspace_getattr_list(TROVE_coll_id coll_id,
                              llu(ds_attr_p[i].u.dirdata.count));
             }
 
+            dbpf_attr_cache_unlock(ref);
             UPDATE_PERF_METADATA_READ();
             error_array[i] = 0;
             cache_hits++;
         }
         else
         {
+            dbpf_attr_cache_unlock(ref);
             /* no hit; mark attr entry so that we can detect that in the
              * service routine
              */
             ds_attr_p[i].type = PVFS_TYPE_NONE;
         }
     }
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
 
     /* All handles hit in the cache, return */
     if (cache_hits == nhandles) 
@@ -1262,9 +1264,9 @@ int dbpf_dspace_attr_set(struct dbpf_collection *coll_p,
     }
 
     /* now that the disk is updated, update the cache if necessary */
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     dbpf_attr_cache_ds_attr_update_cached_data(ref, attr);
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     return 0;
 }
@@ -1334,9 +1336,9 @@ int dbpf_dspace_attr_get(struct dbpf_collection *coll_p,
     }
 
     /* add retrieved ds_attr to dbpf_attr cache here */
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     dbpf_attr_cache_insert(ref, attr);
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     return 0;
 }
@@ -2001,9 +2003,9 @@ static int dbpf_dspace_create_store_handle(struct dbpf_collection* coll_p,
 
     /* add retrieved ds_attr to dbpf_attr cache here */
     ref.handle = new_handle;
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     dbpf_attr_cache_insert(ref, &attr);
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     return(0);
 }
@@ -48,7 +48,6 @@ static uint16_t readdir_session = 0;
  */
 /* extern int synccount; */
 
-extern gen_mutex_t dbpf_attr_cache_mutex;
 
 static int dbpf_keyval_do_remove(
     dbpf_db *db_p, TROVE_handle handle, char type,
@@ -126,7 +125,7 @@ static int dbpf_keyval_read(TROVE_coll_id coll_id,
     gossip_debug(GOSSIP_DBPF_KEYVAL_DEBUG, "*** Trove KeyVal Read "
                  "of %s\n", (char *)key_p->buffer);
 
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     cache_elem = dbpf_attr_cache_elem_lookup(ref);
     if (cache_elem && (!(flags & TROVE_BINARY_KEY)))
     {
@@ -142,7 +141,7 @@ static int dbpf_keyval_read(TROVE_coll_id coll_id,
             ret = dbpf_attr_cache_keyval_pair_fetch_cached_data(
                 cache_elem, keyval_pair, val_p->buffer,
                 &val_p->read_sz);
-            gen_mutex_unlock(&dbpf_attr_cache_mutex);
+            dbpf_attr_cache_unlock(ref);
             if(ret < 0)
             {
                 return ret;
@@ -150,7 +149,7 @@ static int dbpf_keyval_read(TROVE_coll_id coll_id,
             return 1;
         }
     }
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     coll_p = dbpf_collection_find_registered(coll_id);
     if (coll_p == NULL)
@@ -245,7 +244,7 @@ static int dbpf_keyval_read_op_svc(struct dbpf_op *op_p)
     /* cache this data in the attr cache if we can */
     if(!(op_p->flags & TROVE_BINARY_KEY))
     {
-        gen_mutex_lock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_lock(ref);
         if (dbpf_attr_cache_elem_set_data_based_on_key(
                 ref, key_entry.key,
                 op_p->u.k_read.val->buffer, data.len))
@@ -265,7 +264,7 @@ static int dbpf_keyval_read_op_svc(struct dbpf_op *op_p)
                 "retrieved (key is %s)\n",
                 (char *)key_entry.key);
         }
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_unlock(ref);
     }
 
     return 1;
@@ -461,7 +460,7 @@ static int dbpf_keyval_write_op_svc(struct dbpf_op *op_p)
     if(!(op_p->flags & TROVE_BINARY_KEY))
     {
         dbpf_attr_cache_elem_t *cache_elem;
-        gen_mutex_lock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_lock(ref);
         cache_elem = dbpf_attr_cache_elem_lookup(ref);
         if (cache_elem)
         {
@@ -485,7 +484,7 @@ static int dbpf_keyval_write_op_svc(struct dbpf_op *op_p)
                     (char *)key_entry.key);
             }
         }
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_unlock(ref);
     }
 
     ret = DBPF_OP_COMPLETE;
@@ -1373,7 +1372,7 @@ static int dbpf_keyval_write_list_op_svc(struct dbpf_op *op_p)
            */
         if(!(op_p->flags & TROVE_BINARY_KEY))
         {
-            gen_mutex_lock(&dbpf_attr_cache_mutex);
+            dbpf_attr_cache_lock(ref);
             cache_elem = dbpf_attr_cache_elem_lookup(ref);
             if (cache_elem)
             {
@@ -1398,7 +1397,7 @@ static int dbpf_keyval_write_list_op_svc(struct dbpf_op *op_p)
                         (char *)key_entry.key);
                 }
             }
-            gen_mutex_unlock(&dbpf_attr_cache_mutex);
+            dbpf_attr_cache_unlock(ref);
         }
     }
 
@@ -37,10 +37,12 @@
 #include "dbpf-attr-cache.h"
 #include "trove-ledger.h"
 #include "trove-handle-mgmt.h"
+#include "trove-handle-store.h"
 #include "gossip.h"
 #include "dbpf-open-cache.h"
 #include "pint-util.h"
 #include "dbpf-sync.h"
+#include "dbpf-readahead.h"
 
 #include "server-config.h"
 
@@ -166,6 +168,11 @@ int dbpf_collection_setinfo(TROVE_method_id method_id,
                          "dbpf collection %d - Setting collection handle "
                          "ranges to %s\n", 
                          (int) coll_id, (char *)parameter);
+            /* keep the handle ledger snapshot next to the databases */
+            if (coll)
+            {
+                trove_set_handle_store(coll_id, coll->meta_path);
+            }
             ret = trove_set_handle_ranges(
                 coll_id, context_id, (char *)parameter);
             break;
@@ -206,6 +213,15 @@ int dbpf_collection_setinfo(TROVE_method_id method_id,
             ret = dbpf_attr_cache_set_max_num_elems(*((int *)parameter));
             gen_mutex_unlock(&dbpf_attr_cache_mutex);
             break;
+        case TROVE_COLLECTION_ATTR_CACHE_MEMORY:
+            gossip_debug(GOSSIP_TROVE_DEBUG, 
+                         "dbpf collection %d - Setting memory limit of "
+                         "attribute cache to %d MB\n",
+                         (int) coll_id, *(int *)parameter);
+            gen_mutex_lock(&dbpf_attr_cache_mutex);
+            ret = dbpf_attr_cache_set_memory_mb(*((int *)parameter));
+            gen_mutex_unlock(&dbpf_attr_cache_mutex);
+            break;
         case TROVE_COLLECTION_ATTR_CACHE_INITIALIZE:
             gossip_debug(GOSSIP_TROVE_DEBUG, 
                          "dbpf collection %d - Initialize collection attr. "
@@ -260,6 +276,14 @@ int dbpf_collection_setinfo(TROVE_method_id method_id,
             trove_directio_timeout = *(int *)parameter;
             ret = 0;
             break;
+        case TROVE_READAHEAD_SIZE:
+            dbpf_readahead_set_size(*(int *)parameter);
+            ret = 0;
+            break;
+        case TROVE_READAHEAD_BUFFERS:
+            dbpf_readahead_set_buffers(*(int *)parameter);
+            ret = 0;
+            break;
     }
     return ret;
 }
@@ -616,6 +640,7 @@ static int stop_directio_threads(void)
         return 0;
     }
 
+    dbpf_readahead_stop();
     PINT_manager_queue_remove(io_thread_mgr, io_queue_id);
     PINT_queue_destroy(io_queue_id);
     PINT_manager_destroy(io_thread_mgr);
@@ -1293,6 +1318,8 @@ int dbpf_collection_remove(char *collname,
 
     DBPF_GET_COLL_DIRNAME(path_name, PATH_MAX,
 			  sto_p->meta_path, db_data.coll_id);
+    trove_set_handle_store(db_data.coll_id, NULL);
+    trove_handle_store_remove(path_name);
     if (rmdir(path_name) != 0)
     {
 		gossip_err("failure removing metadata collection directory\n");
@@ -1407,18 +1434,26 @@ int dbpf_collection_clear(TROVE_coll_id coll_id)
         gossip_lerr("db_close(coll_attr_db): %s\n", strerror(ret));
     }
 
+    /* journaled allocations go to disk ahead of their dspaces */
+    trove_handle_mgmt_sync(coll_p->coll_id);
+
     if ( (coll_p->ds_db != NULL ) &&
          (ret = dbpf_db_sync(coll_p->ds_db)) != 0)
     {
         gossip_err("db_sync(coll_ds_db): %s\n", strerror(ret));
+        trove_set_handle_store(coll_p->coll_id, NULL);
     }
 
     if ( (coll_p->ds_db != NULL ) &&
          (ret = dbpf_db_close(coll_p->ds_db)) != 0) 
     {
         gossip_lerr("db_close(coll_ds_db): %s\n", strerror(ret));
+        trove_set_handle_store(coll_p->coll_id, NULL);
     }
 
+    /* the dspaces are on disk; save the handle ledger for the next start */
+    trove_handle_mgmt_save(coll_p->coll_id);
+
     if ( (coll_p->keyval_db != NULL ) &&
          (ret = dbpf_db_sync(coll_p->keyval_db)) != 0)
     {
@@ -1462,6 +1497,13 @@ static int dbpf_direct_collection_lookup(char *collname,
         return(ret);
     }
 
+    /* the readahead settings are known by now; start the chunk pool */
+    ret = dbpf_readahead_start();
+    if(ret < 0)
+    {
+        gossip_err("Warning: failed to start direct I/O readahead\n");
+    }
+
     return(0);
 }
 
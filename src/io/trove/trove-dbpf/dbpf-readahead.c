@@ -0,0 +1,660 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "pvfs2-internal.h"
+#include "gossip.h"
+#include "pvfs2-debug.h"
+#include "quicklist.h"
+#include "gen-locks.h"
+#include "trove.h"
+#include "trove-internal.h"
+#include "dbpf.h"
+#include "dbpf-open-cache.h"
+#include "dbpf-readahead.h"
+
+/* number of streams tracked at once; direct mapped on the handle */
+#define DBPF_RA_STREAMS 256
+/* sequential reads required before readahead starts */
+#define DBPF_RA_TRIGGER 2
+/* a read may skip forward by this much and still count as sequential */
+#define DBPF_RA_SLACK (128*1024)
+/* smallest window issued once a stream is sequential */
+#define DBPF_RA_MIN_WINDOW (128*1024)
+/* threads filling direct readahead chunks */
+#define DBPF_RA_THREADS 4
+/* direct I/O alignment of the chunk buffers */
+#define DBPF_RA_ALIGN 4096
+
+struct ra_stream
+{
+    int valid;
+    TROVE_coll_id coll_id;
+    TROVE_handle handle;
+    TROVE_offset prev_offset;  /* start of the last read */
+    TROVE_offset next_offset;  /* end of the last read */
+    TROVE_offset ra_offset;    /* end of the readahead issued so far */
+    TROVE_size window;
+    int seq_count;
+};
+
+enum ra_chunk_state
+{
+    RA_CHUNK_FREE = 0,
+    RA_CHUNK_QUEUED,
+    RA_CHUNK_READING,
+    RA_CHUNK_READY
+};
+
+struct ra_chunk
+{
+    struct qlist_head link;    /* on ra_pending while queued */
+    enum ra_chunk_state state;
+    int stale;                 /* invalidated while reading or pinned */
+    int refs;                  /* readers copying out of the chunk */
+    TROVE_coll_id coll_id;
+    TROVE_handle handle;
+    TROVE_offset offset;       /* chunk aligned file offset */
+    TROVE_size len;            /* valid bytes once ready */
+    uint64_t stamp;            /* LRU stamp; 0 once fully consumed */
+    char *data;
+};
+
+static int ra_window_max = 0;
+static int ra_buffer_count = 32;
+
+static struct ra_stream ra_streams[DBPF_RA_STREAMS];
+static gen_mutex_t ra_stream_mutex = GEN_MUTEX_INITIALIZER;
+
+static struct ra_chunk *ra_chunks = NULL;
+static int ra_chunk_count = 0;
+static uint64_t ra_clock = 0;
+static QLIST_HEAD(ra_pending);
+static gen_mutex_t ra_pool_mutex = GEN_MUTEX_INITIALIZER;
+static pthread_cond_t ra_pool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t ra_threads[DBPF_RA_THREADS];
+static int ra_thread_count = 0;
+static int ra_running = 0;
+
+static void *ra_thread_function(void *ptr);
+
+void dbpf_readahead_set_size(int window_size)
+{
+    gen_mutex_lock(&ra_stream_mutex);
+    ra_window_max = (window_size > 0) ? window_size : 0;
+    memset(ra_streams, 0, sizeof(ra_streams));
+    gen_mutex_unlock(&ra_stream_mutex);
+}
+
+void dbpf_readahead_set_buffers(int buffer_count)
+{
+    ra_buffer_count = (buffer_count > 0) ? buffer_count : 0;
+}
+
+/* dbpf_readahead_start()
+ *
+ * allocates the direct readahead chunk pool and starts the threads that
+ * fill it.  Only the direct I/O method needs the pool; nothing is done
+ * if readahead is disabled or the pool is already running.
+ *
+ * returns 0 on success, -TROVE_error on failure
+ */
+int dbpf_readahead_start(void)
+{
+    int i, ret;
+
+    gen_mutex_lock(&ra_pool_mutex);
+    if (ra_running || ra_window_max == 0 || ra_buffer_count == 0)
+    {
+        gen_mutex_unlock(&ra_pool_mutex);
+        return 0;
+    }
+
+    ra_chunks = calloc(ra_buffer_count, sizeof(struct ra_chunk));
+    if (!ra_chunks)
+    {
+        gen_mutex_unlock(&ra_pool_mutex);
+        return -TROVE_ENOMEM;
+    }
+    for (i = 0; i < ra_buffer_count; i++)
+    {
+        if (posix_memalign((void **)&ra_chunks[i].data, DBPF_RA_ALIGN,
+                           DBPF_READAHEAD_CHUNK) != 0)
+        {
+            while (--i >= 0)
+            {
+                free(ra_chunks[i].data);
+            }
+            free(ra_chunks);
+            ra_chunks = NULL;
+            gen_mutex_unlock(&ra_pool_mutex);
+            return -TROVE_ENOMEM;
+        }
+    }
+    ra_chunk_count = ra_buffer_count;
+    INIT_QLIST_HEAD(&ra_pending);
+    ra_running = 1;
+
+    for (i = 0; i < DBPF_RA_THREADS; i++)
+    {
+        ret = pthread_create(&ra_threads[i], NULL, ra_thread_function, NULL);
+        if (ret != 0)
+        {
+            break;
+        }
+        ra_thread_count++;
+    }
+    gen_mutex_unlock(&ra_pool_mutex);
+
+    if (ra_thread_count == 0)
+    {
+        dbpf_readahead_stop();
+        return -TROVE_ENOMEM;
+    }
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "dbpf readahead: %d chunks of %d bytes, "
+                 "window up to %d bytes\n", ra_chunk_count,
+                 DBPF_READAHEAD_CHUNK, ra_window_max);
+    return 0;
+}
+
+void dbpf_readahead_stop(void)
+{
+    int i;
+
+    gen_mutex_lock(&ra_pool_mutex);
+    if (!ra_chunks)
+    {
+        gen_mutex_unlock(&ra_pool_mutex);
+        return;
+    }
+    ra_running = 0;
+    pthread_cond_broadcast(&ra_pool_cond);
+    gen_mutex_unlock(&ra_pool_mutex);
+
+    for (i = 0; i < ra_thread_count; i++)
+    {
+        pthread_join(ra_threads[i], NULL);
+    }
+    ra_thread_count = 0;
+
+    gen_mutex_lock(&ra_pool_mutex);
+    for (i = 0; i < ra_chunk_count; i++)
+    {
+        free(ra_chunks[i].data);
+    }
+    free(ra_chunks);
+    ra_chunks = NULL;
+    ra_chunk_count = 0;
+    INIT_QLIST_HEAD(&ra_pending);
+    gen_mutex_unlock(&ra_pool_mutex);
+}
+
+static struct ra_stream *ra_stream_slot(TROVE_coll_id coll_id,
+                                        TROVE_handle handle)
+{
+    uint64_t key = (uint64_t)handle * 0x9e3779b97f4a7c15ULL + coll_id;
+    return &ra_streams[(key >> 32) % DBPF_RA_STREAMS];
+}
+
+/* ra_stream_update()
+ *
+ * records a read of the given extents against the stream state of the
+ * handle and decides whether more readahead should be issued.
+ *
+ * returns 1 and fills in the range to read ahead, or 0 if nothing
+ * needs to be issued
+ */
+static int ra_stream_update(TROVE_coll_id coll_id,
+                            TROVE_handle handle,
+                            const TROVE_offset *stream_offset_array,
+                            const TROVE_size *stream_size_array,
+                            int stream_count,
+                            TROVE_offset *ra_start,
+                            TROVE_size *ra_len)
+{
+    struct ra_stream *st;
+    TROVE_offset first, end;
+    int i, issue = 0;
+
+    if (stream_count < 1)
+    {
+        return 0;
+    }
+    first = stream_offset_array[0];
+    end = first;
+    for (i = 0; i < stream_count; i++)
+    {
+        if (stream_offset_array[i] < first)
+        {
+            first = stream_offset_array[i];
+        }
+        if (stream_offset_array[i] + stream_size_array[i] > end)
+        {
+            end = stream_offset_array[i] + stream_size_array[i];
+        }
+    }
+    if (end <= first)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&ra_stream_mutex);
+    if (ra_window_max == 0)
+    {
+        gen_mutex_unlock(&ra_stream_mutex);
+        return 0;
+    }
+
+    st = ra_stream_slot(coll_id, handle);
+    if (st->valid && st->coll_id == coll_id && st->handle == handle)
+    {
+        if (end > st->next_offset && first >= st->prev_offset &&
+            first <= st->next_offset + DBPF_RA_SLACK)
+        {
+            st->seq_count++;
+            st->prev_offset = first;
+            st->next_offset = end;
+        }
+        else if (first < st->next_offset &&
+                 st->next_offset - first <= st->window + DBPF_RA_SLACK)
+        {
+            /* a read of the same stream overtaken by a later one; leave
+             * the stream alone
+             */
+            gen_mutex_unlock(&ra_stream_mutex);
+            return 0;
+        }
+        else
+        {
+            st->seq_count = 0;
+            st->window = 0;
+            st->ra_offset = 0;
+            st->prev_offset = first;
+            st->next_offset = end;
+        }
+    }
+    else
+    {
+        memset(st, 0, sizeof(*st));
+        st->valid = 1;
+        st->coll_id = coll_id;
+        st->handle = handle;
+        st->prev_offset = first;
+        st->next_offset = end;
+    }
+
+    if (st->seq_count >= DBPF_RA_TRIGGER)
+    {
+        if (st->ra_offset < end)
+        {
+            st->ra_offset = end;
+        }
+        /* only top the window up once half of it has been consumed */
+        if (st->ra_offset - end <= st->window / 2)
+        {
+            if (st->window == 0)
+            {
+                st->window = 2 * (end - first);
+                if (st->window < DBPF_RA_MIN_WINDOW)
+                {
+                    st->window = DBPF_RA_MIN_WINDOW;
+                }
+            }
+            else
+            {
+                st->window *= 2;
+            }
+            if (st->window > ra_window_max)
+            {
+                st->window = ra_window_max;
+            }
+            if (end + st->window > st->ra_offset)
+            {
+                *ra_start = st->ra_offset;
+                *ra_len = end + st->window - st->ra_offset;
+                st->ra_offset = end + st->window;
+                issue = 1;
+            }
+        }
+    }
+    gen_mutex_unlock(&ra_stream_mutex);
+
+    return issue;
+}
+
+/* dbpf_readahead_advise()
+ *
+ * readahead for the buffered methods: passes the window in front of a
+ * sequential reader to the kernel page cache
+ */
+void dbpf_readahead_advise(TROVE_coll_id coll_id,
+                           TROVE_handle handle,
+                           int fd,
+                           const TROVE_offset *stream_offset_array,
+                           const TROVE_size *stream_size_array,
+                           int stream_count)
+{
+#ifdef POSIX_FADV_WILLNEED
+    TROVE_offset start;
+    TROVE_size len;
+
+    if (fd < 0 || ra_window_max == 0)
+    {
+        return;
+    }
+    if (ra_stream_update(coll_id, handle, stream_offset_array,
+                         stream_size_array, stream_count, &start, &len))
+    {
+        gossip_debug(GOSSIP_TROVE_DEBUG, "dbpf readahead: handle %llu "
+                     "advise %lld+%lld\n", llu(handle), lld(start), lld(len));
+        posix_fadvise(fd, start, len, POSIX_FADV_WILLNEED);
+    }
+#endif
+}
+
+static struct ra_chunk *ra_chunk_find(TROVE_coll_id coll_id,
+                                      TROVE_handle handle,
+                                      TROVE_offset offset)
+{
+    int i;
+
+    for (i = 0; i < ra_chunk_count; i++)
+    {
+        if (ra_chunks[i].state != RA_CHUNK_FREE && !ra_chunks[i].stale &&
+            ra_chunks[i].handle == handle &&
+            ra_chunks[i].coll_id == coll_id &&
+            ra_chunks[i].offset == offset)
+        {
+            return &ra_chunks[i];
+        }
+    }
+    return NULL;
+}
+
+/* picks a free chunk, or else the least recently used ready one that
+ * nobody is copying from
+ */
+static struct ra_chunk *ra_chunk_victim(void)
+{
+    struct ra_chunk *victim = NULL;
+    int i;
+
+    for (i = 0; i < ra_chunk_count; i++)
+    {
+        if (ra_chunks[i].state == RA_CHUNK_FREE)
+        {
+            return &ra_chunks[i];
+        }
+        if (ra_chunks[i].state == RA_CHUNK_READY && ra_chunks[i].refs == 0 &&
+            (!victim || ra_chunks[i].stamp < victim->stamp))
+        {
+            victim = &ra_chunks[i];
+        }
+    }
+    return victim;
+}
+
+/* dbpf_readahead_direct()
+ *
+ * readahead for the direct I/O method: queues the chunks covering the
+ * window in front of a sequential reader for the readahead threads.
+ * Nothing beyond b_size is read.
+ */
+void dbpf_readahead_direct(TROVE_coll_id coll_id,
+                           TROVE_handle handle,
+                           const TROVE_offset *stream_offset_array,
+                           const TROVE_size *stream_size_array,
+                           int stream_count,
+                           TROVE_size b_size)
+{
+    struct ra_chunk *chunk;
+    TROVE_offset start, end, off;
+    TROVE_size len;
+    int queued = 0;
+
+    if (!ra_running)
+    {
+        return;
+    }
+    if (!ra_stream_update(coll_id, handle, stream_offset_array,
+                          stream_size_array, stream_count, &start, &len))
+    {
+        return;
+    }
+
+    end = start + len;
+    if (end > b_size)
+    {
+        end = b_size;
+    }
+    start -= start % DBPF_READAHEAD_CHUNK;
+
+    gen_mutex_lock(&ra_pool_mutex);
+    for (off = start; off < end && ra_running; off += DBPF_READAHEAD_CHUNK)
+    {
+        if (ra_chunk_find(coll_id, handle, off))
+        {
+            continue;
+        }
+        chunk = ra_chunk_victim();
+        if (!chunk)
+        {
+            /* every chunk is in flight */
+            break;
+        }
+        chunk->state = RA_CHUNK_QUEUED;
+        chunk->stale = 0;
+        chunk->coll_id = coll_id;
+        chunk->handle = handle;
+        chunk->offset = off;
+        chunk->len = 0;
+        qlist_add_tail(&chunk->link, &ra_pending);
+        queued++;
+    }
+    if (queued)
+    {
+        pthread_cond_broadcast(&ra_pool_cond);
+    }
+    gen_mutex_unlock(&ra_pool_mutex);
+
+    if (queued)
+    {
+        gossip_debug(GOSSIP_TROVE_DEBUG, "dbpf readahead: handle %llu "
+                     "queued %d chunks from %lld\n", llu(handle), queued,
+                     lld(start));
+    }
+}
+
+static void *ra_thread_function(void *ptr)
+{
+    struct ra_chunk *chunk;
+    struct open_cache_ref open_ref;
+    TROVE_coll_id coll_id;
+    TROVE_handle handle;
+    TROVE_offset offset;
+    ssize_t nread;
+    int ret;
+
+    gen_mutex_lock(&ra_pool_mutex);
+    while (ra_running)
+    {
+        if (qlist_empty(&ra_pending))
+        {
+            pthread_cond_wait(&ra_pool_cond, &ra_pool_mutex);
+            continue;
+        }
+        chunk = qlist_entry(ra_pending.next, struct ra_chunk, link);
+        qlist_del(&chunk->link);
+        chunk->state = RA_CHUNK_READING;
+        coll_id = chunk->coll_id;
+        handle = chunk->handle;
+        offset = chunk->offset;
+        gen_mutex_unlock(&ra_pool_mutex);
+
+        nread = -1;
+        ret = dbpf_open_cache_get(coll_id, handle, DBPF_FD_DIRECT_READ,
+                                  &open_ref);
+        if (ret == 0)
+        {
+            nread = dbpf_pread(open_ref.fd, chunk->data,
+                               DBPF_READAHEAD_CHUNK, offset);
+            dbpf_open_cache_put(&open_ref);
+        }
+
+        gen_mutex_lock(&ra_pool_mutex);
+        if (nread <= 0 || chunk->stale)
+        {
+            chunk->state = RA_CHUNK_FREE;
+        }
+        else
+        {
+            chunk->len = nread;
+            chunk->stamp = ++ra_clock;
+            chunk->state = RA_CHUNK_READY;
+        }
+        chunk->stale = 0;
+    }
+    gen_mutex_unlock(&ra_pool_mutex);
+
+    return NULL;
+}
+
+/* dbpf_readahead_copy()
+ *
+ * serves a read of [offset, offset + size) out of ready readahead
+ * chunks.  The caller must already have clipped the range to the
+ * bstream size.
+ *
+ * returns 1 if the whole range was copied into buffer, 0 if the caller
+ * has to read it from disk
+ */
+int dbpf_readahead_copy(TROVE_coll_id coll_id,
+                        TROVE_handle handle,
+                        char *buffer,
+                        TROVE_offset offset,
+                        TROVE_size size)
+{
+    struct ra_chunk *chunk;
+    TROVE_offset pos = offset, end = offset + size;
+    TROVE_size n;
+
+    if (!ra_running || size <= 0)
+    {
+        return 0;
+    }
+
+    while (pos < end)
+    {
+        gen_mutex_lock(&ra_pool_mutex);
+        chunk = ra_chunk_find(coll_id, handle,
+                              pos - (pos % DBPF_READAHEAD_CHUNK));
+        if (!chunk || chunk->state != RA_CHUNK_READY ||
+            pos >= chunk->offset + chunk->len)
+        {
+            gen_mutex_unlock(&ra_pool_mutex);
+            return 0;
+        }
+        chunk->refs++;
+        gen_mutex_unlock(&ra_pool_mutex);
+
+        n = chunk->offset + chunk->len - pos;
+        if (n > end - pos)
+        {
+            n = end - pos;
+        }
+        memcpy(buffer + (pos - offset), chunk->data + (pos - chunk->offset),
+               n);
+        pos += n;
+
+        gen_mutex_lock(&ra_pool_mutex);
+        chunk->refs--;
+        if (chunk->stale && chunk->refs == 0)
+        {
+            chunk->stale = 0;
+            chunk->state = RA_CHUNK_FREE;
+        }
+        else if (pos == chunk->offset + DBPF_READAHEAD_CHUNK)
+        {
+            /* a sequential reader will not come back; reuse it first */
+            chunk->stamp = 0;
+        }
+        else
+        {
+            chunk->stamp = ++ra_clock;
+        }
+        gen_mutex_unlock(&ra_pool_mutex);
+    }
+
+    return 1;
+}
+
+/* dbpf_readahead_invalidate()
+ *
+ * drops all readahead state of a handle after its contents or size
+ * changed.  Chunks still being read or copied are marked stale and
+ * freed once the reader is done with them.
+ */
+void dbpf_readahead_invalidate(TROVE_coll_id coll_id,
+                               TROVE_handle handle)
+{
+    struct ra_stream *st;
+    int i;
+
+    gen_mutex_lock(&ra_stream_mutex);
+    st = ra_stream_slot(coll_id, handle);
+    if (st->valid && st->coll_id == coll_id && st->handle == handle)
+    {
+        st->ra_offset = 0;
+    }
+    gen_mutex_unlock(&ra_stream_mutex);
+
+    if (!ra_running)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&ra_pool_mutex);
+    for (i = 0; i < ra_chunk_count; i++)
+    {
+        if (ra_chunks[i].state == RA_CHUNK_FREE ||
+            ra_chunks[i].handle != handle ||
+            ra_chunks[i].coll_id != coll_id)
+        {
+            continue;
+        }
+        if (ra_chunks[i].state == RA_CHUNK_QUEUED)
+        {
+            qlist_del(&ra_chunks[i].link);
+            ra_chunks[i].state = RA_CHUNK_FREE;
+        }
+        else if (ra_chunks[i].state == RA_CHUNK_READY &&
+                 ra_chunks[i].refs == 0)
+        {
+            ra_chunks[i].state = RA_CHUNK_FREE;
+        }
+        else
+        {
+            ra_chunks[i].stale = 1;
+        }
+    }
+    gen_mutex_unlock(&ra_pool_mutex);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,70 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Sequential readahead for bstream reads.
+ *
+ * Every bstream read is reported to a small per (coll, handle) stream
+ * table.  Once a handle has been read sequentially a couple of times, a
+ * readahead window is kept in front of the reader, doubling on each
+ * sequential hit up to the configured maximum.
+ *
+ * On the buffered methods the window is simply handed to the kernel with
+ * posix_fadvise(POSIX_FADV_WILLNEED).  The direct I/O method bypasses the
+ * page cache, so there the window is read asynchronously, in aligned
+ * chunks, into a bounded pool of buffers by a few readahead threads;
+ * later reads that fall entirely inside ready chunks are copied from
+ * memory instead of going to disk.  Writes, resizes and removes of a
+ * handle drop its chunks.
+ */
+
+#ifndef __DBPF_READAHEAD_H__
+#define __DBPF_READAHEAD_H__
+
+#include "trove.h"
+#include "trove-internal.h"
+
+/* size of one direct readahead chunk */
+#define DBPF_READAHEAD_CHUNK (1024*1024)
+
+void dbpf_readahead_set_size(int window_size);
+void dbpf_readahead_set_buffers(int buffer_count);
+
+int dbpf_readahead_start(void);
+void dbpf_readahead_stop(void);
+
+void dbpf_readahead_advise(TROVE_coll_id coll_id,
+                           TROVE_handle handle,
+                           int fd,
+                           const TROVE_offset *stream_offset_array,
+                           const TROVE_size *stream_size_array,
+                           int stream_count);
+
+void dbpf_readahead_direct(TROVE_coll_id coll_id,
+                           TROVE_handle handle,
+                           const TROVE_offset *stream_offset_array,
+                           const TROVE_size *stream_size_array,
+                           int stream_count,
+                           TROVE_size b_size);
+
+int dbpf_readahead_copy(TROVE_coll_id coll_id,
+                        TROVE_handle handle,
+                        char *buffer,
+                        TROVE_offset offset,
+                        TROVE_size size);
+
+void dbpf_readahead_invalidate(TROVE_coll_id coll_id,
+                               TROVE_handle handle);
+
+#endif /* __DBPF_READAHEAD_H__ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
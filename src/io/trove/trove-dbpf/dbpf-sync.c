@@ -10,6 +10,7 @@
 #include "pint-perf-counter.h"
 #include "dbpf-sync.h"
 #include "dbpf-thread.h"
+#include "trove-handle-mgmt.h"
 
 enum s_sync_context_e
 {
@@ -26,6 +27,7 @@ extern gen_mutex_t dbpf_completion_queue_array_mutex[TROVE_MAX_CONTEXTS];
 extern pthread_cond_t dbpf_op_completed_cond;
 
 static int dbpf_sync_db(
+    struct dbpf_collection *coll,
     dbpf_db * dbp, 
     enum s_sync_context_e sync_context_type, 
     dbpf_sync_context_t * sync_context)
@@ -36,6 +38,15 @@ static int dbpf_sync_db(
                  "in coalesce_queue:%d pending:%d\n",
                  sync_context_type, sync_context->coalesce_counter, 
                  sync_context->sync_counter);
+
+    /* the handle journal has to reach the disk before the dspaces it
+     * allocated handles for
+     */
+    if (sync_context_type == COALESCE_CONTEXT_DSPACE)
+    {
+        trove_handle_mgmt_sync(coll->coll_id);
+    }
+
     ret = dbpf_db_sync(dbp);
     if(ret != 0)
     {
@@ -44,6 +55,11 @@ static int dbpf_sync_db(
         ret = -ret;
         return ret;
     }
+
+    if (sync_context_type == COALESCE_CONTEXT_DSPACE)
+    {
+        trove_handle_mgmt_synced(coll->coll_id);
+    }
     gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG,
                  "[SYNC_COALESCE]:\tcoalesce %d sync stop\n",
                  sync_context_type);
@@ -200,7 +216,7 @@ int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
         if ( do_sync ) {
             gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG,
                          "[SYNC_COALESCE]: syncing now!\n");
-            ret = dbpf_sync_db(dbp, sync_context_type, sync_context);
+            ret = dbpf_sync_db(coll, dbp, sync_context_type, sync_context);
         }
 
         return ret;
@@ -226,7 +242,7 @@ int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
 
         gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG,
                      "[SYNC_COALESCE]: syncing now!\n");
-        ret = dbpf_sync_db(dbp, sync_context_type, sync_context);
+        ret = dbpf_sync_db(coll, dbp, sync_context_type, sync_context);
 
         gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG,
                      "[SYNC_COALESCE]: moving op: %p, handle: %llu , type: %d "
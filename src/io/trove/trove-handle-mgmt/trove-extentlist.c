@@ -44,8 +44,15 @@ static void extent_count(
 static TROVE_handle avltree_extent_search_in_range(
     struct avlnode *n,
     TROVE_extent *req_extent);
+static void extent_tally(
+    struct avlnode *n,
+    int param, int depth);
+static void extent_copy(
+    struct avlnode *n,
+    int param, int depth);
 
 static uint64_t g_counter = 0;
+static TROVE_extent *g_extent_array = NULL;
 
 /* constructor for an extent 
  * first: start of extent range
@@ -480,6 +487,58 @@ void extentlist_count(
     *count = g_counter;
 }
 
+/* extentlist_get_extents()
+ *
+ * appends every extent in the list, in ascending order, to the array
+ * at *extents, which holds *count entries and is grown with realloc.
+ *
+ * returns 0 on success, -1 if out of memory
+ */
+int extentlist_get_extents(
+    struct TROVE_handle_extentlist *elist,
+    TROVE_extent **extents,
+    int64_t *count)
+{
+    TROVE_extent *array;
+
+    /* NOTE: like extentlist_count, this relies on the trove-handle-mgmt
+     * layer to serialize calls.
+     */
+    g_counter = 0;
+    avldepthfirst(elist->index, extent_tally, 0, 0);
+    if (g_counter == 0)
+    {
+        return 0;
+    }
+
+    array = realloc(*extents, (*count + g_counter) * sizeof(TROVE_extent));
+    if (array == NULL)
+    {
+        return -1;
+    }
+    *extents = array;
+
+    g_extent_array = array + *count;
+    avldepthfirst(elist->index, extent_copy, 0, 0);
+    g_extent_array = NULL;
+    *count += g_counter;
+    return 0;
+}
+
+static void extent_tally(struct avlnode *n, int param, int depth)
+{
+    g_counter++;
+}
+
+static void extent_copy(struct avlnode *n, int param, int depth)
+{
+    struct TROVE_handle_extent *e = (struct TROVE_handle_extent *)(n->d);
+
+    g_extent_array->first = e->first;
+    g_extent_array->last = e->last;
+    g_extent_array++;
+}
+
 static void extent_show(struct avlnode *n, int param, int depth)
 {
     struct TROVE_handle_extent *e __attribute__((unused)) =
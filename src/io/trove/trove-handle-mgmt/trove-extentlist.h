@@ -86,6 +86,10 @@ void extentlist_show(
 void extentlist_count(
     struct TROVE_handle_extentlist *elist,
     uint64_t* count);
+int extentlist_get_extents(
+    struct TROVE_handle_extentlist *elist,
+    TROVE_extent **extents,
+    int64_t *count);
 void extentlist_stats(
     struct TROVE_handle_extentlist *elist); 
 int extentlist_hit_cutoff(
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 #include <sys/time.h>
 
 #include "trove.h"
@@ -15,6 +16,7 @@
 #include "extent-utils.h"
 #include "trove-ledger.h"
 #include "trove-handle-mgmt.h"
+#include "trove-handle-store.h"
 #include "gossip.h"
 #include "gen-locks.h"
 #include "pvfs2-internal.h"
@@ -31,6 +33,24 @@ typedef struct
     int have_valid_ranges;
 
     struct handle_ledger *ledger;
+
+    /* snapshot and journal of the ledger; journal_fd is -1 when
+     * the ledger is not being persisted
+     */
+    char *store_dir;
+    char *range_str;
+    int journal_fd;
+    int journal_dirty;
+    uint32_t generation;
+    int journal_records;
+
+    /* frees waiting for the dspace sync that makes them durable;
+     * the first free_synced of them are covered by the running one
+     */
+    TROVE_handle *frees;
+    int free_count;
+    int free_synced;
+    int free_dropped;
 } handle_ledger_t;
 
 static struct qhash_table *s_fsid_to_ledger_table = NULL;
@@ -139,7 +159,8 @@ static int trove_check_handle_ranges(TROVE_coll_id coll_id,
 }
 
 static int trove_map_handle_ranges( PINT_llist *extent_list,
-                                   struct handle_ledger *ledger)
+                                   struct handle_ledger *ledger,
+                                   int add_extents)
 {
     int ret = -1;
     PINT_llist *cur = NULL;
@@ -157,7 +178,9 @@ static int trove_map_handle_ranges( PINT_llist *extent_list,
                 break;
             }
 
-	    ret = trove_handle_ledger_addextent(ledger, cur_extent);
+            /* extents restored from a snapshot are already in place */
+            ret = (add_extents ?
+                   trove_handle_ledger_addextent(ledger, cur_extent) : 0);
 	    if (ret != 0)
             {
 		break;
@@ -194,6 +217,16 @@ static handle_ledger_t *get_or_add_handle_ledger(TROVE_coll_id coll_id)
         {
             ledger->coll_id = coll_id;
             ledger->have_valid_ranges = 0;
+            ledger->store_dir = NULL;
+            ledger->range_str = NULL;
+            ledger->journal_fd = -1;
+            ledger->journal_dirty = 0;
+            ledger->generation = 0;
+            ledger->journal_records = 0;
+            ledger->frees = NULL;
+            ledger->free_count = 0;
+            ledger->free_synced = 0;
+            ledger->free_dropped = 0;
             ledger->ledger = trove_handle_ledger_init(coll_id,NULL);
             if (ledger->ledger)
             {
@@ -210,6 +243,118 @@ static handle_ledger_t *get_or_add_handle_ledger(TROVE_coll_id coll_id)
     return ledger;
 }
 
+/* handle_store_close()
+ *
+ * stops persisting the ledger.  With remove set, the snapshot is also
+ * deleted so that it cannot be used without the journal records that
+ * are now lost.
+ */
+static void handle_store_close(handle_ledger_t *ledger, int remove)
+{
+    if (ledger->journal_fd >= 0)
+    {
+        close(ledger->journal_fd);
+        ledger->journal_fd = -1;
+    }
+    if (remove && ledger->store_dir)
+    {
+        trove_handle_store_remove(ledger->store_dir);
+    }
+    ledger->journal_dirty = 0;
+    ledger->journal_records = 0;
+    ledger->free_count = 0;
+    ledger->free_synced = 0;
+    ledger->free_dropped = 0;
+}
+
+/* handle_store_checkpoint()
+ *
+ * writes a new snapshot of the ledger and starts a new, empty journal.
+ * Every free in the ledger has to be durable in the dspace database.
+ */
+static int handle_store_checkpoint(handle_ledger_t *ledger)
+{
+    int ret, fd = -1;
+
+    if (!ledger->store_dir || !ledger->range_str)
+    {
+        return 0;
+    }
+
+    ret = trove_handle_store_checkpoint(
+        ledger->store_dir, ledger->range_str, ledger->ledger,
+        ledger->generation + 1, &fd);
+    if (ret != 0)
+    {
+        gossip_err("Warning: failed to checkpoint the handle ledger of "
+                   "collection %d; the next start will scan all dspaces\n",
+                   (int)ledger->coll_id);
+        handle_store_close(ledger, 1);
+        return ret;
+    }
+
+    handle_store_close(ledger, 0);
+    ledger->journal_fd = fd;
+    ledger->generation++;
+    return 0;
+}
+
+/* handle_store_log()
+ *
+ * journals handle allocations or frees
+ */
+static void handle_store_log(handle_ledger_t *ledger,
+                             enum trove_handle_store_op op,
+                             const TROVE_handle *handles,
+                             int count)
+{
+    if (ledger->journal_fd < 0 || count == 0)
+    {
+        return;
+    }
+
+    if (trove_handle_store_append(ledger->journal_fd, ledger->generation,
+                                  op, handles, count) != 0)
+    {
+        gossip_err("Warning: failed to journal handles of collection %d; "
+                   "the next start will scan all dspaces\n",
+                   (int)ledger->coll_id);
+        handle_store_close(ledger, 1);
+        return;
+    }
+    ledger->journal_dirty = 1;
+    ledger->journal_records += count;
+}
+
+/* handle_store_queue_free()
+ *
+ * remembers a free until the dspace sync that makes the removal
+ * durable; journaling it earlier could let the next start hand out a
+ * handle whose dspace is still on disk.  If too many frees pile up
+ * between syncs the rest are left out of the journal, which only
+ * keeps them in use until the next checkpoint.
+ */
+static void handle_store_queue_free(handle_ledger_t *ledger,
+                                    TROVE_handle handle)
+{
+    if (ledger->journal_fd < 0)
+    {
+        return;
+    }
+    if (!ledger->frees)
+    {
+        ledger->frees = malloc(TROVE_HANDLE_JOURNAL_MAX_FREES *
+                               sizeof(TROVE_handle));
+    }
+    if (!ledger->frees ||
+        ledger->free_count == TROVE_HANDLE_JOURNAL_MAX_FREES)
+    {
+        ledger->free_dropped = 1;
+        return;
+    }
+    ledger->frees[ledger->free_count++] = handle;
+}
+
 /* hash_fsid()
  *
  * hash function for fsids added to table
@@ -272,11 +417,42 @@ int trove_handle_mgmt_initialize()
     return ret;
 }
 
+/*
+ * trove_set_handle_store: names the directory in which the handle
+ * ledger of a collection is persisted.  Must be called before
+ * trove_set_handle_ranges to take effect; a NULL store_dir stops
+ * persisting the ledger.
+ */
+int trove_set_handle_store(TROVE_coll_id coll_id,
+                           const char *store_dir)
+{
+    int ret = -1;
+    handle_ledger_t *ledger = NULL;
+
+    gen_mutex_lock(&trove_handle_mutex);
+    ledger = get_or_add_handle_ledger(coll_id);
+    if (ledger)
+    {
+        handle_store_close(ledger, 0);
+        free(ledger->store_dir);
+        ledger->store_dir = NULL;
+        ret = 0;
+        if (store_dir)
+        {
+            ledger->store_dir = strdup(store_dir);
+            ret = (ledger->store_dir ? 0 : -1);
+        }
+    }
+    gen_mutex_unlock(&trove_handle_mutex);
+    return ret;
+}
+
 int trove_set_handle_ranges(TROVE_coll_id coll_id,
                             TROVE_context_id context_id,
                             char *handle_range_str)
 {
     int ret = -TROVE_EINVAL;
+    int loaded = 0;
     PINT_llist *extent_list = NULL;
     handle_ledger_t *ledger = NULL;
 
@@ -295,18 +471,43 @@ int trove_set_handle_ranges(TROVE_coll_id coll_id,
             {
                 /* assert the internal ledger struct is valid */
                 assert(ledger->ledger);
+
+                /*
+                  restore the free handles from the last snapshot and
+                  its journal if they are usable; that saves the full
+                  scan below
+                */
+                if (ledger->store_dir)
+                {
+                    free(ledger->range_str);
+                    ledger->range_str = strdup(handle_range_str);
+                    if (ledger->range_str)
+                    {
+                        loaded = trove_handle_store_load(
+                            ledger->store_dir, handle_range_str,
+                            ledger->ledger, &ledger->generation);
+                    }
+                    if (loaded < 0)
+                    {
+                        gen_mutex_unlock(&trove_handle_mutex);
+                        return loaded;
+                    }
+                }
 		
 		/* tell trove what are our valid ranges are */
 		ret = trove_map_handle_ranges(
-                    extent_list, ledger->ledger);
+                    extent_list, ledger->ledger, !loaded);
 		if (ret != 0)
                 {
                     gen_mutex_unlock(&trove_handle_mutex);
                     return ret;
                 }
 
-                ret = trove_check_handle_ranges(
-                    coll_id,context_id,extent_list,ledger->ledger);
+                if (!loaded)
+                {
+                    ret = trove_check_handle_ranges(
+                        coll_id,context_id,extent_list,ledger->ledger);
+                }
 		if (ret != 0)
                 {
                     gen_mutex_unlock(&trove_handle_mutex);
@@ -316,6 +517,9 @@ int trove_set_handle_ranges(TROVE_coll_id coll_id,
                 {
                     ledger->have_valid_ranges = 1;
                 }
+
+                /* start a fresh journal from the current state */
+                handle_store_checkpoint(ledger);
             }
             PINT_release_extent_list(extent_list);
         }
@@ -374,6 +578,11 @@ TROVE_handle trove_handle_alloc(TROVE_coll_id coll_id)
         if (ledger && (ledger->have_valid_ranges == 1))
         {
             handle = trove_ledger_handle_alloc(ledger->ledger);
+            if (handle != TROVE_HANDLE_NULL)
+            {
+                handle_store_log(ledger, TROVE_HANDLE_STORE_ALLOC,
+                                 &handle, 1);
+            }
         }
     }
     gen_mutex_unlock(&trove_handle_mutex);
@@ -402,6 +611,8 @@ TROVE_handle trove_handle_alloc_from_range(
                     ledger->ledger, &(extent_array->extent_array[i]));
                 if (handle != TROVE_HANDLE_NULL)
                 {
+                    handle_store_log(ledger, TROVE_HANDLE_STORE_ALLOC,
+                                     &handle, 1);
                     break;
                 }
             }
@@ -501,6 +712,11 @@ int trove_handle_set_used(TROVE_coll_id coll_id, TROVE_handle handle)
         if (ledger)
         {
             ret = trove_handle_remove(ledger->ledger,handle);
+            if (ret == 0)
+            {
+                handle_store_log(ledger, TROVE_HANDLE_STORE_ALLOC,
+                                 &handle, 1);
+            }
         }
     }
     gen_mutex_unlock(&trove_handle_mutex);
@@ -521,6 +737,131 @@ int trove_handle_free(TROVE_coll_id coll_id, TROVE_handle handle)
         if (ledger)
         {
             ret = trove_ledger_handle_free(ledger->ledger, handle);
+            if (ret == 0)
+            {
+                handle_store_queue_free(ledger, handle);
+            }
+        }
+    }
+    gen_mutex_unlock(&trove_handle_mutex);
+    return ret;
+}
+
+/* trove_handle_mgmt_sync()
+ *
+ * makes the journaled allocations of a collection durable.  Called
+ * right before the dspace database is synced, so that a dspace on disk
+ * is never newer than the journal record of its handle; the frees made
+ * so far are journaled by trove_handle_mgmt_synced() once that sync
+ * is done.
+ *
+ * returns 0 on success, -1 on error
+ */
+int trove_handle_mgmt_sync(TROVE_coll_id coll_id)
+{
+    int ret = 0;
+    handle_ledger_t *ledger = NULL;
+    struct qlist_head *hash_link = NULL;
+
+    gen_mutex_lock(&trove_handle_mutex);
+    hash_link = qhash_search(s_fsid_to_ledger_table,&(coll_id));
+    if (hash_link)
+    {
+        ledger = qlist_entry(hash_link, handle_ledger_t, hash_link);
+        if (ledger && ledger->journal_fd >= 0)
+        {
+            if (ledger->journal_dirty &&
+                fdatasync(ledger->journal_fd) != 0)
+            {
+                gossip_err("Warning: failed to sync the handle journal of "
+                           "collection %d; the next start will scan all "
+                           "dspaces\n", (int)coll_id);
+                handle_store_close(ledger, 1);
+                ret = -1;
+            }
+            ledger->journal_dirty = 0;
+            ledger->free_synced = ledger->free_count;
+        }
+    }
+    gen_mutex_unlock(&trove_handle_mutex);
+    return ret;
+}
+
+/* trove_handle_mgmt_synced()
+ *
+ * called after the dspace database was synced: journals the frees that
+ * sync made durable and, once the journal has grown large enough,
+ * checkpoints the ledger.  The checkpoint runs here rather than on the
+ * allocation path, on the trove thread that allocates handles anyway.
+ *
+ * returns 0 on success, -1 on error
+ */
+int trove_handle_mgmt_synced(TROVE_coll_id coll_id)
+{
+    int ret = 0;
+    handle_ledger_t *ledger = NULL;
+    struct qlist_head *hash_link = NULL;
+
+    gen_mutex_lock(&trove_handle_mutex);
+    hash_link = qhash_search(s_fsid_to_ledger_table,&(coll_id));
+    if (hash_link)
+    {
+        ledger = qlist_entry(hash_link, handle_ledger_t, hash_link);
+        if (ledger && ledger->journal_fd >= 0)
+        {
+            handle_store_log(ledger, TROVE_HANDLE_STORE_FREE,
+                             ledger->frees, ledger->free_synced);
+            if (ledger->journal_fd >= 0 && ledger->free_synced)
+            {
+                ledger->free_count -= ledger->free_synced;
+                memmove(ledger->frees, ledger->frees + ledger->free_synced,
+                        ledger->free_count * sizeof(TROVE_handle));
+            }
+            ledger->free_synced = 0;
+
+            /* frees made since the sync started are not on disk yet */
+            if (ledger->journal_fd >= 0 && ledger->free_count == 0 &&
+                (ledger->journal_records >=
+                 TROVE_HANDLE_JOURNAL_MAX_RECORDS ||
+                 ledger->free_dropped))
+            {
+                ret = handle_store_checkpoint(ledger);
+            }
+        }
+    }
+    gen_mutex_unlock(&trove_handle_mutex);
+    return ret;
+}
+
+/* trove_handle_mgmt_save()
+ *
+ * checkpoints the ledger of a collection for the next start and stops
+ * persisting it.  Called once the dspace database of the collection
+ * has been synced and closed cleanly, so the next start replays no
+ * journal.
+ *
+ * returns 0 on success, -1 on error
+ */
+int trove_handle_mgmt_save(TROVE_coll_id coll_id)
+{
+    int ret = 0;
+    handle_ledger_t *ledger = NULL;
+    struct qlist_head *hash_link = NULL;
+
+    gen_mutex_lock(&trove_handle_mutex);
+    hash_link = qhash_search(s_fsid_to_ledger_table,&(coll_id));
+    if (hash_link)
+    {
+        ledger = qlist_entry(hash_link, handle_ledger_t, hash_link);
+        if (ledger && ledger->journal_fd >= 0)
+        {
+            ret = handle_store_checkpoint(ledger);
+        }
+        if (ledger)
+        {
+            handle_store_close(ledger, 0);
+            free(ledger->store_dir);
+            ledger->store_dir = NULL;
         }
     }
     gen_mutex_unlock(&trove_handle_mutex);
@@ -587,6 +928,11 @@ int trove_handle_mgmt_finalize()
                 assert(ledger);
                 assert(ledger->ledger);
 
+                handle_store_close(ledger, 0);
+                free(ledger->store_dir);
+                free(ledger->range_str);
+                free(ledger->frees);
+
                 trove_handle_ledger_free(ledger->ledger);
                 free(ledger);
             }
@@ -11,12 +11,22 @@
 
 #define TROVE_DEFAULT_HANDLE_PURGATORY_SEC 360
 
+/* journal records after which the handle ledger is checkpointed, and
+ * frees remembered between two dspace syncs
+ */
+#define TROVE_HANDLE_JOURNAL_MAX_RECORDS 65536
+#define TROVE_HANDLE_JOURNAL_MAX_FREES    4096
+
 /*
   public methods.  all methods return -1 on error; 0 on success unless
   otherwise noted
 */
 int trove_handle_mgmt_initialize(void);
 
+int trove_set_handle_store(
+    TROVE_coll_id coll_id,
+    const char *store_dir);
+
 int trove_set_handle_ranges(
     TROVE_coll_id coll_id,
     TROVE_context_id context_id,
@@ -75,6 +85,15 @@ int trove_handle_free(
     TROVE_coll_id coll_id,
     TROVE_handle handle);
 
+int trove_handle_mgmt_sync(
+    TROVE_coll_id coll_id);
+
+int trove_handle_mgmt_synced(
+    TROVE_coll_id coll_id);
+
+int trove_handle_mgmt_save(
+    TROVE_coll_id coll_id);
+
 int trove_handle_mgmt_finalize(void);
 
 int trove_handle_get_statistics(
@@ -0,0 +1,550 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "trove.h"
+#include "trove-ledger.h"
+#include "trove-handle-store.h"
+#include "bmi-byteswap.h"
+#include "gossip.h"
+#include "pvfs2-internal.h"
+
+#define HANDLE_SNAPSHOT_NAME "handle_ledger.snap"
+#define HANDLE_JOURNAL_NAME "handle_ledger.jnl"
+#define HANDLE_TMP_SUFFIX ".tmp"
+
+#define HANDLE_SNAPSHOT_MAGIC 0x50564653534e4150ULL /* "PVFSSNAP" */
+#define HANDLE_JOURNAL_MAGIC 0x505646534a524e4cULL  /* "PVFSJRNL" */
+#define HANDLE_STORE_VERSION 3
+
+/* on disk sizes.  The header of both files holds the magic, version,
+ * generation, extent count and range length, padded to 32 bytes.  A
+ * snapshot header is followed by range_len bytes of handle range
+ * string, extent_count extents (first and last handle) and a 64 bit
+ * checksum over everything before it; a journal header is followed by
+ * records of a handle, an op and a check word.
+ */
+#define HANDLE_STORE_HEADER_SIZE 32
+#define HANDLE_STORE_EXTENT_SIZE 16
+#define HANDLE_STORE_RECORD_SIZE 16
+
+#define HANDLE_STORE_CHECKSUM_SEED 0xcbf29ce484222325ULL
+
+struct handle_store_header
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t generation;
+    uint64_t extent_count;
+    uint32_t range_len;
+};
+
+/* FNV-1a */
+static uint64_t store_checksum(uint64_t sum, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        sum ^= p[i];
+        sum *= 0x100000001b3ULL;
+    }
+    return sum;
+}
+
+static void store_put32(unsigned char *p, uint32_t v)
+{
+    v = htobmi32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static void store_put64(unsigned char *p, uint64_t v)
+{
+    v = htobmi64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static uint32_t store_get32(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return bmitoh32(v);
+}
+
+static uint64_t store_get64(const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return bmitoh64(v);
+}
+
+static void store_encode_header(unsigned char *p,
+                                const struct handle_store_header *hdr)
+{
+    memset(p, 0, HANDLE_STORE_HEADER_SIZE);
+    store_put64(p, hdr->magic);
+    store_put32(p + 8, hdr->version);
+    store_put32(p + 12, hdr->generation);
+    store_put64(p + 16, hdr->extent_count);
+    store_put32(p + 24, hdr->range_len);
+}
+
+static void store_decode_header(const unsigned char *p,
+                                struct handle_store_header *hdr)
+{
+    hdr->magic = store_get64(p);
+    hdr->version = store_get32(p + 8);
+    hdr->generation = store_get32(p + 12);
+    hdr->extent_count = store_get64(p + 16);
+    hdr->range_len = store_get32(p + 24);
+}
+
+/* detects torn or stale journal records */
+static uint32_t store_record_check(uint32_t generation,
+                                   const unsigned char *rec)
+{
+    unsigned char gen[4];
+    uint64_t sum;
+
+    store_put32(gen, generation);
+    sum = store_checksum(HANDLE_STORE_CHECKSUM_SEED, gen, sizeof(gen));
+    sum = store_checksum(sum, rec, 12);
+    return (uint32_t)(sum ^ (sum >> 32));
+}
+
+static void store_path(char *buf, const char *store_dir, const char *name,
+                       const char *suffix)
+{
+    snprintf(buf, PATH_MAX, "%s/%s%s", store_dir, name, suffix);
+}
+
+static int store_sync_dir(const char *store_dir)
+{
+    int fd, ret;
+
+    fd = open(store_dir, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    ret = fsync(fd);
+    close(fd);
+    return ret;
+}
+
+static int store_write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    ssize_t ret;
+
+    while (len > 0)
+    {
+        ret = write(fd, p, len);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        p += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static int store_read_file(const char *path, unsigned char **buf,
+                           size_t *len)
+{
+    struct stat st;
+    ssize_t ret;
+    size_t done = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    *buf = malloc(st.st_size ? st.st_size : 1);
+    if (!*buf)
+    {
+        close(fd);
+        return -1;
+    }
+    while (done < (size_t)st.st_size)
+    {
+        ret = read(fd, *buf + done, st.st_size - done);
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            break;
+        }
+        done += ret;
+    }
+    close(fd);
+    *len = done;
+    return 0;
+}
+
+/* store_replace_file()
+ *
+ * writes a file under its temporary name, syncs it, renames it into
+ * place and syncs the directory.  If fd_out is given the file is left
+ * open for appending.
+ */
+static int store_replace_file(const char *store_dir, const char *name,
+                              const void *buf, size_t len, int *fd_out)
+{
+    char tmp_path[PATH_MAX], path[PATH_MAX];
+    int fd;
+
+    store_path(tmp_path, store_dir, name, HANDLE_TMP_SUFFIX);
+    store_path(path, store_dir, name, "");
+
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    if (fd < 0)
+    {
+        gossip_err("Error: failed to create %s: %s\n",
+                   tmp_path, strerror(errno));
+        return -1;
+    }
+    if (store_write_all(fd, buf, len) || fsync(fd) < 0 ||
+        rename(tmp_path, path) < 0 || store_sync_dir(store_dir) < 0)
+    {
+        gossip_err("Error: failed to write %s: %s\n",
+                   path, strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    if (fd_out)
+    {
+        *fd_out = fd;
+    }
+    else
+    {
+        close(fd);
+    }
+    return 0;
+}
+
+/* trove_handle_store_load()
+ *
+ * restores the free handle extents of a ledger from the snapshot in
+ * store_dir and replays the journal on top of it.  Nothing is added to
+ * the ledger unless both files are usable and the snapshot was taken
+ * with the same handle ranges, so the caller can fall back to a full
+ * dspace scan when this returns 0.  A torn record at the end of the
+ * journal ends the replay; it was never synced, and neither was the
+ * dspace change it describes.
+ *
+ * returns 1 if the ledger was loaded, 0 if there is no usable
+ * snapshot, -1 on error
+ */
+int trove_handle_store_load(
+    const char *store_dir,
+    const char *range_str,
+    struct handle_ledger *hl,
+    uint32_t *generation)
+{
+    char path[PATH_MAX];
+    unsigned char *snap = NULL, *jnl = NULL, *p;
+    size_t snap_len = 0, jnl_len = 0, body_len, off;
+    struct handle_store_header snap_hdr, jnl_hdr;
+    TROVE_extent ext;
+    TROVE_handle handle;
+    uint32_t op;
+    int64_t i, replayed = 0;
+    int ret = 0;
+
+    store_path(path, store_dir, HANDLE_SNAPSHOT_NAME, "");
+    if (store_read_file(path, &snap, &snap_len) < 0)
+    {
+        gossip_debug(GOSSIP_TROVE_DEBUG, "no handle ledger snapshot %s\n",
+                     path);
+        return 0;
+    }
+
+    /* validate the snapshot */
+    if (snap_len < HANDLE_STORE_HEADER_SIZE + 8)
+    {
+        goto invalid;
+    }
+    store_decode_header(snap, &snap_hdr);
+    if (snap_hdr.magic != HANDLE_SNAPSHOT_MAGIC ||
+        snap_hdr.version != HANDLE_STORE_VERSION ||
+        snap_hdr.range_len > snap_len ||
+        snap_hdr.extent_count > snap_len / HANDLE_STORE_EXTENT_SIZE)
+    {
+        goto invalid;
+    }
+    body_len = HANDLE_STORE_HEADER_SIZE + snap_hdr.range_len +
+        snap_hdr.extent_count * HANDLE_STORE_EXTENT_SIZE;
+    if (snap_len != body_len + 8 ||
+        store_get64(snap + body_len) !=
+        store_checksum(HANDLE_STORE_CHECKSUM_SEED, snap, body_len))
+    {
+        goto invalid;
+    }
+    if (snap_hdr.range_len != strlen(range_str) ||
+        memcmp(snap + HANDLE_STORE_HEADER_SIZE, range_str,
+               snap_hdr.range_len))
+    {
+        gossip_debug(GOSSIP_TROVE_DEBUG, "handle ranges changed since "
+                     "the handle ledger snapshot was taken\n");
+        free(snap);
+        return 0;
+    }
+
+    /* the journal must exist, even if it is empty */
+    store_path(path, store_dir, HANDLE_JOURNAL_NAME, "");
+    if (store_read_file(path, &jnl, &jnl_len) < 0 ||
+        jnl_len < HANDLE_STORE_HEADER_SIZE)
+    {
+        goto invalid;
+    }
+    store_decode_header(jnl, &jnl_hdr);
+    if (jnl_hdr.magic != HANDLE_JOURNAL_MAGIC ||
+        jnl_hdr.version != HANDLE_STORE_VERSION ||
+        jnl_hdr.generation > snap_hdr.generation)
+    {
+        goto invalid;
+    }
+
+    p = snap + HANDLE_STORE_HEADER_SIZE + snap_hdr.range_len;
+    for (i = 0; i < (int64_t)snap_hdr.extent_count; i++)
+    {
+        ext.first = store_get64(p);
+        ext.last = store_get64(p + 8);
+        p += HANDLE_STORE_EXTENT_SIZE;
+        if (trove_handle_ledger_addextent(hl, &ext) != 0)
+        {
+            ret = -1;
+            goto done;
+        }
+    }
+
+    /* a journal from an older generation is already in the snapshot */
+    if (jnl_hdr.generation == snap_hdr.generation)
+    {
+        for (off = HANDLE_STORE_HEADER_SIZE;
+             off + HANDLE_STORE_RECORD_SIZE <= jnl_len;
+             off += HANDLE_STORE_RECORD_SIZE)
+        {
+            p = jnl + off;
+            if (store_get32(p + 12) !=
+                store_record_check(jnl_hdr.generation, p))
+            {
+                break;
+            }
+            handle = store_get64(p);
+            op = store_get32(p + 8);
+            if (op == TROVE_HANDLE_STORE_ALLOC)
+            {
+                trove_handle_remove(hl, handle);
+            }
+            else if (op == TROVE_HANDLE_STORE_FREE)
+            {
+                /* removing first keeps a repeated free harmless */
+                trove_handle_remove(hl, handle);
+                ext.first = handle;
+                ext.last = handle;
+                if (trove_handle_ledger_addextent(hl, &ext) != 0)
+                {
+                    ret = -1;
+                    goto done;
+                }
+            }
+            replayed++;
+        }
+    }
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "loaded handle ledger snapshot "
+                 "generation %u: %lld extents, %lld journal records\n",
+                 snap_hdr.generation, lld(snap_hdr.extent_count),
+                 lld(replayed));
+    *generation = snap_hdr.generation;
+    ret = 1;
+
+done:
+    free(snap);
+    free(jnl);
+    return ret;
+
+invalid:
+    gossip_err("Warning: handle ledger snapshot in %s is not usable; "
+               "scanning all dspaces\n", store_dir);
+    free(snap);
+    free(jnl);
+    return 0;
+}
+
+/* trove_handle_store_checkpoint()
+ *
+ * writes a snapshot of the ledger's unused handles with the given
+ * generation, then replaces the journal with an empty one of the same
+ * generation.  The new journal is returned open in *journal_fd.  Only
+ * to be called when every handle free in the ledger is also free in
+ * the dspace database on disk.
+ *
+ * returns 0 on success, -1 on error
+ */
+int trove_handle_store_checkpoint(
+    const char *store_dir,
+    const char *range_str,
+    struct handle_ledger *hl,
+    uint32_t generation,
+    int *journal_fd)
+{
+    struct handle_store_header hdr;
+    unsigned char jnl[HANDLE_STORE_HEADER_SIZE];
+    unsigned char *snap, *p;
+    TROVE_extent *extents = NULL;
+    int64_t count = 0, i;
+    size_t body_len;
+    int ret;
+
+    if (trove_handle_ledger_get_free_extents(hl, &extents, &count) != 0)
+    {
+        return -1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = HANDLE_SNAPSHOT_MAGIC;
+    hdr.version = HANDLE_STORE_VERSION;
+    hdr.generation = generation;
+    hdr.extent_count = count;
+    hdr.range_len = strlen(range_str);
+
+    body_len = HANDLE_STORE_HEADER_SIZE + hdr.range_len +
+        count * HANDLE_STORE_EXTENT_SIZE;
+    snap = malloc(body_len + 8);
+    if (!snap)
+    {
+        free(extents);
+        return -1;
+    }
+    store_encode_header(snap, &hdr);
+    memcpy(snap + HANDLE_STORE_HEADER_SIZE, range_str, hdr.range_len);
+    p = snap + HANDLE_STORE_HEADER_SIZE + hdr.range_len;
+    for (i = 0; i < count; i++)
+    {
+        store_put64(p, extents[i].first);
+        store_put64(p + 8, extents[i].last);
+        p += HANDLE_STORE_EXTENT_SIZE;
+    }
+    free(extents);
+    store_put64(snap + body_len,
+                store_checksum(HANDLE_STORE_CHECKSUM_SEED, snap, body_len));
+
+    ret = store_replace_file(store_dir, HANDLE_SNAPSHOT_NAME,
+                             snap, body_len + 8, NULL);
+    free(snap);
+    if (ret < 0)
+    {
+        return -1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = HANDLE_JOURNAL_MAGIC;
+    hdr.version = HANDLE_STORE_VERSION;
+    hdr.generation = generation;
+    store_encode_header(jnl, &hdr);
+
+    if (store_replace_file(store_dir, HANDLE_JOURNAL_NAME,
+                           jnl, sizeof(jnl), journal_fd) < 0)
+    {
+        return -1;
+    }
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "wrote handle ledger snapshot "
+                 "generation %u: %lld extents\n", generation, lld(count));
+    return 0;
+}
+
+/* trove_handle_store_append()
+ *
+ * appends the allocation or free of count handles to the journal.  The
+ * records are not synced; see trove_handle_mgmt_sync().
+ *
+ * returns 0 on success, -1 on error
+ */
+int trove_handle_store_append(
+    int journal_fd,
+    uint32_t generation,
+    enum trove_handle_store_op op,
+    const TROVE_handle *handles,
+    int count)
+{
+    unsigned char *recs, *p;
+    int i, ret;
+
+    recs = malloc(count * HANDLE_STORE_RECORD_SIZE);
+    if (!recs)
+    {
+        return -1;
+    }
+    for (i = 0, p = recs; i < count; i++, p += HANDLE_STORE_RECORD_SIZE)
+    {
+        store_put64(p, handles[i]);
+        store_put32(p + 8, op);
+        store_put32(p + 12, store_record_check(generation, p));
+    }
+    ret = store_write_all(journal_fd, recs, count * HANDLE_STORE_RECORD_SIZE);
+    free(recs);
+    return ret;
+}
+
+/* trove_handle_store_remove()
+ *
+ * removes the snapshot and journal from store_dir, so that the next
+ * start scans the dspaces
+ */
+void trove_handle_store_remove(const char *store_dir)
+{
+    char path[PATH_MAX];
+
+    store_path(path, store_dir, HANDLE_SNAPSHOT_NAME, "");
+    unlink(path);
+    store_path(path, store_dir, HANDLE_SNAPSHOT_NAME, HANDLE_TMP_SUFFIX);
+    unlink(path);
+    store_path(path, store_dir, HANDLE_JOURNAL_NAME, "");
+    unlink(path);
+    store_path(path, store_dir, HANDLE_JOURNAL_NAME, HANDLE_TMP_SUFFIX);
+    unlink(path);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,69 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Persistent state of the handle allocator.
+ *
+ * Rebuilding a collection's handle ledger means iterating over every
+ * dspace, which takes a long time on servers holding many objects.  To
+ * avoid it, the set of unused handle extents is checkpointed to a
+ * snapshot file in the collection's metadata directory, and the handle
+ * allocations and frees since the checkpoint are appended to a journal.
+ * Loading the snapshot and replaying the journal gives back the ledger
+ * without touching the dspace database, after a crash as well as after
+ * a clean shutdown.
+ *
+ * A checkpoint writes the snapshot with the next generation number and
+ * then starts an empty journal of that generation; each file is written
+ * under a temporary name, synced and renamed into place.  A journal
+ * whose generation is older than the snapshot's is already contained
+ * in the snapshot and is ignored.  Both files are stored little endian.
+ */
+
+#ifndef __TROVE_HANDLE_STORE_H
+#define __TROVE_HANDLE_STORE_H
+
+#include "trove-types.h"
+
+struct handle_ledger;
+
+enum trove_handle_store_op
+{
+    TROVE_HANDLE_STORE_ALLOC = 1,
+    TROVE_HANDLE_STORE_FREE = 2
+};
+
+int trove_handle_store_load(
+    const char *store_dir,
+    const char *range_str,
+    struct handle_ledger *hl,
+    uint32_t *generation);
+
+int trove_handle_store_checkpoint(
+    const char *store_dir,
+    const char *range_str,
+    struct handle_ledger *hl,
+    uint32_t generation,
+    int *journal_fd);
+
+int trove_handle_store_append(
+    int journal_fd,
+    uint32_t generation,
+    enum trove_handle_store_op op,
+    const TROVE_handle *handles,
+    int count);
+
+void trove_handle_store_remove(const char *store_dir);
+
+#endif /* __TROVE_HANDLE_STORE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
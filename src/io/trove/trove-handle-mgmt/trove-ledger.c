@@ -235,6 +235,34 @@ void trove_handle_ledger_get_statistics(
 }
 
 
+/* trove_handle_ledger_get_free_extents()
+ *
+ * collects the extents of every handle not in use: the free list as
+ * well as handles still waiting out their purgatory.  The array
+ * returned in *extents must be freed by the caller.
+ *
+ * returns 0 on success, -1 if out of memory
+ */
+int trove_handle_ledger_get_free_extents(
+    struct handle_ledger *hl,
+    TROVE_extent **extents,
+    int64_t *count)
+{
+    *extents = NULL;
+    *count = 0;
+
+    if (extentlist_get_extents(&(hl->free_list), extents, count) ||
+        extentlist_get_extents(&(hl->recently_freed_list), extents, count) ||
+        extentlist_get_extents(&(hl->overflow_list), extents, count))
+    {
+        free(*extents);
+        *extents = NULL;
+        *count = 0;
+        return -1;
+    }
+    return 0;
+}
+
 void trove_handle_ledger_show(struct handle_ledger *hl) 
 {
     gossip_debug(GOSSIP_TROVE_DEBUG, "====== free list\n");
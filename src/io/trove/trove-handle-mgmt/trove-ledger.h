@@ -74,6 +74,10 @@ int trove_ledger_set_timeout(
 void trove_handle_ledger_get_statistics(
     struct handle_ledger *hl,
     uint64_t *free_count);
+int trove_handle_ledger_get_free_extents(
+    struct handle_ledger *hl,
+    TROVE_extent **extents,
+    int64_t *count);
 #endif
 
 /*
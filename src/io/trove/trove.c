@@ -22,6 +22,7 @@
 #include "gossip.h"
 #include "trove.h"
 #include "trove-internal.h"
+#include "block-cache.h"
 
 extern struct TROVE_keyval_ops  *keyval_method_table[];
 extern struct TROVE_dspace_ops  *dspace_method_table[];
@@ -87,6 +88,8 @@ int trove_bstream_write_at(
 {
     TROVE_method_id method_id;
     method_id = global_trove_method_callback(coll_id);
+    /* drop cached copies before the data can change */
+    PINT_bcache_invalidate_list(coll_id, handle, &offset, inout_size_p, 1);
     return bstream_method_table[method_id]->bstream_write_at(
            coll_id,
            handle,
@@ -118,6 +121,7 @@ int trove_bstream_resize(
 {
     TROVE_method_id method_id;
     method_id = global_trove_method_callback(coll_id);
+    PINT_bcache_invalidate_handle(coll_id, handle);
     return bstream_method_table[method_id]->bstream_resize(
            coll_id,
            handle,
@@ -217,6 +221,8 @@ int trove_bstream_write_list(
 {
     TROVE_method_id method_id;
     method_id = global_trove_method_callback(coll_id);
+    PINT_bcache_invalidate_list(coll_id, handle, stream_offset_array,
+                                stream_size_array, stream_count);
     return bstream_method_table[method_id]->bstream_write_list(
            coll_id,
            handle,
@@ -711,7 +717,12 @@ int trove_dspace_remove_list(
     PVFS_hint hints)
 {
     TROVE_method_id method_id;
+    int i;
     method_id = global_trove_method_callback(coll_id);
+    for (i = 0; i < count; i++)
+    {
+        PINT_bcache_invalidate_handle(coll_id, handle_array[i]);
+    }
     return dspace_method_table[method_id]->dspace_remove_list(
            coll_id,
            handle_array,
@@ -735,6 +746,7 @@ int trove_dspace_remove(TROVE_coll_id coll_id,
 {
     TROVE_method_id method_id;
     method_id = global_trove_method_callback(coll_id);
+    PINT_bcache_invalidate_handle(coll_id, handle);
     return dspace_method_table[method_id]->dspace_remove(
            coll_id,
            handle,
@@ -79,6 +79,7 @@ enum
     TROVE_COLLECTION_ATTR_CACHE_KEYWORDS,
     TROVE_COLLECTION_ATTR_CACHE_SIZE,
     TROVE_COLLECTION_ATTR_CACHE_MAX_NUM_ELEMS,
+    TROVE_COLLECTION_ATTR_CACHE_MEMORY,
     TROVE_COLLECTION_ATTR_CACHE_INITIALIZE,
     TROVE_ALT_AIO_MODE,
     TROVE_MAX_CONCURRENT_IO,
@@ -88,7 +89,9 @@ enum
     TROVE_COLLECTION_IMMEDIATE_COMPLETION,
     TROVE_DIRECTIO_THREADS_NUM,
     TROVE_DIRECTIO_OPS_PER_QUEUE,
-    TROVE_DIRECTIO_TIMEOUT
+    TROVE_DIRECTIO_TIMEOUT,
+    TROVE_READAHEAD_SIZE,
+    TROVE_READAHEAD_BUFFERS
 };
 
 /** Initializes the Trove layer.  Must be called before any other Trove
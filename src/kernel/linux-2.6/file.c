@@ -1377,6 +1377,11 @@ static ssize_t do_readv_writev(struct rw_options *rw)
             gossip_err("%s: Invalid file pointer\n", rw->fnstr);
             goto out;
         }
+        ret = pvfs2_take_write_behind_error(inode);
+        if (ret < 0)
+        {
+            goto out;
+        }
         if (file->f_pos > pvfs2_i_size_read(inode))
         {
             pvfs2_i_size_write(inode, file->f_pos);
@@ -2216,6 +2221,14 @@ static ssize_t do_readx_writex(struct rw_options *rw)
     {
         return 0;
     }
+    if (rw->type == IO_WRITEX)
+    {
+        ret = pvfs2_take_write_behind_error(inode);
+        if (ret < 0)
+        {
+            goto out;
+        }
+    }
     if (count_mem != count_stream) 
     {
         gossip_err("%s: mem count %ld != stream count %ld\n",
@@ -2924,6 +2937,12 @@ static ssize_t do_aio_read_write(struct rw_options *rw)
     if (rw->type == IO_WRITE)
     {
         int ret;
+
+        ret = pvfs2_take_write_behind_error(inode);
+        if (ret < 0)
+        {
+            return ret;
+        }
         /* perform generic tests for sanity of write arguments */
 #ifdef PVFS2_LINUX_KERNEL_2_4
         ret = pvfs2_precheck_file_write(filp, inode, &count, offset);
@@ -3344,6 +3363,36 @@ static int pvfs2_file_mmap(struct file *file, struct vm_area_struct *vma)
 #define mapping_nrpages(idata) (idata)->nrpages
 #endif
 
+/** Called on every close of a file.  Has the client-core write out
+ *  data it holds back for the file, so that close() returns an error
+ *  writing it.  The error is also latched on the inode for the next
+ *  write or fsync, since callers often ignore the result of close().
+ */
+#ifdef HAVE_FLUSH_OWNER_PARAM
+int pvfs2_file_flush(struct file *file, fl_owner_t id)
+#else
+int pvfs2_file_flush(struct file *file)
+#endif
+{
+    struct inode *inode = file->f_dentry->d_inode;
+    int ret;
+
+    if (!(file->f_mode & FMODE_WRITE))
+    {
+        return 0;
+    }
+
+    ret = pvfs2_flush_write_behind(inode);
+    if (ret < 0)
+    {
+        gossip_debug(GOSSIP_FILE_DEBUG, "pvfs2_file_flush: writing out "
+                     "buffered data of %s failed (%d)\n",
+                     file->f_dentry->d_name.name, ret);
+        PVFS2_I(inode)->write_behind_error = ret;
+    }
+    return ret;
+}
+
 /** Called to notify the module that there are no more references to
  *  this file (i.e. no processes have it open).
  *
@@ -3413,6 +3462,11 @@ int pvfs2_fsync(struct file *file,
 
     op_release(new_op);
 
+    if (ret == 0)
+    {
+        ret = pvfs2_take_write_behind_error(file->f_dentry->d_inode);
+    }
+
     pvfs2_flush_inode(file->f_dentry->d_inode);
     return ret;
 }
@@ -3635,6 +3689,7 @@ struct file_operations pvfs2_file_operations =
     ioctl : pvfs2_ioctl,
     mmap : pvfs2_file_mmap,
     open : pvfs2_file_open,
+    flush : pvfs2_file_flush,
     release : pvfs2_file_release,
     fsync : pvfs2_fsync
 #else
@@ -3663,6 +3718,7 @@ struct file_operations pvfs2_file_operations =
 #endif /* HAVE_UNLOCKED_IOCTL_HANDLER */
     .mmap = pvfs2_file_mmap,
     .open = pvfs2_file_open,
+    .flush = pvfs2_file_flush,
     .release = pvfs2_file_release,
     .fsync = pvfs2_fsync,
 #ifdef HAVE_SENDFILE_VFS_SUPPORT
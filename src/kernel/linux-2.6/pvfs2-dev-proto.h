@@ -46,6 +46,8 @@
 
 /* features is a 64-bit unsigned bitmask */
 #define PVFS2_FEATURE_READAHEAD 1
+/* client-core buffers writes; send a cache flush when a file is closed */
+#define PVFS2_FEATURE_WRITE_BEHIND 2
 
 /* Misc constants. Please retain them as multiples of 8!
  * Otherwise 32-64 bit interactions will be messed up :)
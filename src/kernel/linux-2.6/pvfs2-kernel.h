@@ -487,6 +487,9 @@ typedef struct
     sector_t last_failed_block_index_read;
     int error_code;
     int revalidate_failed;
+    /* error writing out client-core write-behind data at a close, kept
+     * for the next write or fsync of the file */
+    int write_behind_error;
 
     /* State of in-memory attributes not yet flushed to disk associated with this object */
     unsigned long pinode_flags;
@@ -957,6 +960,11 @@ int pvfs2_permission(struct inode *,
  ****************************/
 int pvfs2_file_open(struct inode *inode,
                     struct file *file);
+#ifdef HAVE_FLUSH_OWNER_PARAM
+int pvfs2_file_flush(struct file *file, fl_owner_t id);
+#else
+int pvfs2_file_flush(struct file *file);
+#endif
 int pvfs2_file_release(struct inode *inode,
                        struct file *file);
 ssize_t pvfs2_inode_read(struct inode *inode,
@@ -1041,6 +1049,12 @@ void unmask_blocked_signals(sigset_t *orig_sigset);
 int pvfs2_flush_racache(struct inode *inode);
 #endif
 
+int pvfs2_query_client_features(int op_flags);
+
+int pvfs2_flush_write_behind(struct inode *inode);
+
+int pvfs2_take_write_behind_error(struct inode *inode);
+
 int pvfs2_unmount_sb(struct super_block *sb);
 
 int pvfs2_cancel_op_in_progress(uint64_t tag);
@@ -1058,6 +1072,7 @@ extern struct semaphore request_semaphore;
 extern int debug;
 extern int op_timeout_secs;
 extern int slot_timeout_secs;
+extern uint64_t pvfs2_client_features;
 extern struct list_head pvfs2_superblocks;
 extern spinlock_t pvfs2_superblocks_lock;
 extern struct list_head pvfs2_request_list;
@@ -54,6 +54,8 @@ uint64_t gossip_debug_mask = 0;
 unsigned int kernel_mask_set_mod_init = false;
 int op_timeout_secs = PVFS2_DEFAULT_OP_TIMEOUT_SECS;
 int slot_timeout_secs = PVFS2_DEFAULT_SLOT_TIMEOUT_SECS;
+/* features reported by the client-core at the last mount */
+uint64_t pvfs2_client_features = 0;
 uint32_t DEBUG_LINE = 50;
 char debug_help_string[DEBUG_HELP_STRING_SIZE] = {0};
 
@@ -681,6 +681,7 @@ static struct ctl_table pvfs2_capcache_table[] = {
 static int acache_perf_count = PVFS2_PERF_COUNT_REQUEST_ACACHE;
 static int ncache_perf_count = PVFS2_PERF_COUNT_REQUEST_NCACHE;
 static int capcache_perf_count = PVFS2_PERF_COUNT_REQUEST_CAPCACHE;
+static int racache_perf_count = PVFS2_PERF_COUNT_REQUEST_RACACHE;
 static struct ctl_table pvfs2_pc_table[] = {
     {
         CTL_NAME(1)
@@ -706,6 +707,14 @@ static struct ctl_table pvfs2_pc_table[] = {
         .proc_handler = pvfs2_pc_proc_handler,
         .extra1 = &capcache_perf_count
     },
+    {
+        CTL_NAME(4)
+        .procname = "racache",
+        .maxlen = 4096,
+        .mode = 0444,
+        .proc_handler = pvfs2_pc_proc_handler,
+        .extra1 = &racache_perf_count
+    },
     { CTL_NAME(CTL_NONE) }
 };
 
@@ -2072,6 +2072,79 @@ int pvfs2_flush_racache(struct inode *inode)
 }
 #endif
 
+/* pvfs2_query_client_features()
+ *
+ * asks the client-core which optional features it has enabled and
+ * records them in pvfs2_client_features
+ */
+int pvfs2_query_client_features(int op_flags)
+{
+    int ret = -EINVAL;
+    pvfs2_kernel_op_t *new_op = NULL;
+
+    new_op = op_alloc(PVFS2_VFS_OP_FEATURES);
+    if (!new_op)
+    {
+        return -ENOMEM;
+    }
+    new_op->upcall.req.features.features = 0;
+
+    ret = service_operation(new_op, "pvfs2_query_client_features", op_flags);
+
+    pvfs2_client_features =
+        (ret == 0 ? new_op->downcall.resp.features.features : 0);
+    gossip_debug(GOSSIP_UTILS_DEBUG, "pvfs2_query_client_features got "
+                 "return value of %d, features %llx\n", ret,
+                 (unsigned long long) pvfs2_client_features);
+
+    op_release(new_op);
+    return ret;
+}
+
+/* pvfs2_flush_write_behind()
+ *
+ * has the client-core write out data it is holding back for a file,
+ * returning any error from writing it; a no-op unless the client-core
+ * reported PVFS2_FEATURE_WRITE_BEHIND
+ */
+int pvfs2_flush_write_behind(struct inode *inode)
+{
+    int ret = 0;
+    pvfs2_inode_t *pvfs2_inode = PVFS2_I(inode);
+    pvfs2_kernel_op_t *new_op = NULL;
+
+    if (!(pvfs2_client_features & PVFS2_FEATURE_WRITE_BEHIND))
+    {
+        return 0;
+    }
+
+    new_op = op_alloc(PVFS2_VFS_OP_RA_FLUSH);
+    if (!new_op)
+    {
+        return -ENOMEM;
+    }
+    new_op->upcall.req.ra_cache_flush.refn = pvfs2_inode->refn;
+
+    ret = service_operation(new_op, "pvfs2_flush_write_behind",
+                            get_interruptible_flag(inode));
+
+    gossip_debug(GOSSIP_UTILS_DEBUG, "pvfs2_flush_write_behind got return "
+                 "value of %d\n", ret);
+
+    op_release(new_op);
+    return ret;
+}
+
+/* pvfs2_take_write_behind_error()
+ *
+ * returns and clears the error latched by a failed write-behind flush
+ * at close, or 0 if there is none
+ */
+int pvfs2_take_write_behind_error(struct inode *inode)
+{
+    return xchg(&PVFS2_I(inode)->write_behind_error, 0);
+}
+
 int pvfs2_unmount_sb(struct super_block *sb)
 {
     int ret = -EINVAL;
@@ -2147,6 +2220,7 @@ void pvfs2_inode_initialize(pvfs2_inode_t *pvfs2_inode)
         memset(pvfs2_inode->link_target, 0, sizeof(pvfs2_inode->link_target));
         pvfs2_inode->error_code = 0;
         pvfs2_inode->revalidate_failed = 0;
+        pvfs2_inode->write_behind_error = 0;
         pvfs2_inode->pinode_flags = 0;
         SetInitFlag(pvfs2_inode);
     }
@@ -2161,6 +2235,7 @@ void pvfs2_inode_finalize(pvfs2_inode_t *pvfs2_inode)
     pvfs2_inode->refn.fs_id = PVFS_FS_ID_NULL;
     pvfs2_inode->last_failed_block_index_read = 0;
     pvfs2_inode->error_code = 0;
+    pvfs2_inode->write_behind_error = 0;
 }
 
 void pvfs2_op_initialize(pvfs2_kernel_op_t *op)
@@ -711,6 +711,13 @@ int pvfs2_remount(
         }
 
         op_release(new_op);
+
+        if (ret == 0)
+        {
+            /* the restarted client-core may run with other options */
+            pvfs2_query_client_features(PVFS2_OP_PRIORITY |
+                                        PVFS2_OP_NO_SEMAPHORE);
+        }
     }
     return ret;
 }
@@ -1083,6 +1090,8 @@ struct super_block* pvfs2_get_sb(struct super_block *sb,
     PVFS2_SB(sb)->fs_id = new_op->downcall.resp.fs_mount.fs_id;
     PVFS2_SB(sb)->id = new_op->downcall.resp.fs_mount.id;
 
+    pvfs2_query_client_features(0);
+
     sb->s_magic = PVFS2_SUPER_MAGIC;
     sb->s_op = &pvfs2_s_ops;
     sb->s_type = &pvfs2_fs_type;
@@ -1525,6 +1534,8 @@ struct super_block *pvfs2_get_sb(struct file_system_type *fst,
         mount_sb_info.fs_id = new_op->downcall.resp.fs_mount.fs_id;
         mount_sb_info.id = new_op->downcall.resp.fs_mount.id;
 
+        pvfs2_query_client_features(0);
+
         /*
           the mount_sb_info structure looks odd, but it's used because
           the private sb info isn't allocated until we call
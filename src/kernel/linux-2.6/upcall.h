@@ -232,7 +232,8 @@ enum pvfs2_perf_count_request_type
 {
     PVFS2_PERF_COUNT_REQUEST_ACACHE = 1,
     PVFS2_PERF_COUNT_REQUEST_NCACHE = 2,
-    PVFS2_PERF_COUNT_REQUEST_CAPCACHE = 3
+    PVFS2_PERF_COUNT_REQUEST_CAPCACHE = 3,
+    PVFS2_PERF_COUNT_REQUEST_RACACHE = 4
 #if 0
     PVFS2_PERF_COUNT_REQUEST_STATIC_ACACHE = 3,
 #endif
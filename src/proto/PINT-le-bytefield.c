@@ -107,6 +107,8 @@ static void lebf_initialize(void)
             case PVFS_SERV_INVALID:
             case PVFS_SERV_PERF_UPDATE:
             case PVFS_SERV_PRECREATE_POOL_REFILLER:
+            case PVFS_SERV_DIRDATA_SPLIT:
+            case PVFS_SERV_DATAFILE_RECLAIM:
             case PVFS_SERV_JOB_TIMER:
                 /* never used, skip initialization */
                 continue;
@@ -152,6 +154,10 @@ static void lebf_initialize(void)
                 req.u.batch_remove.handle_count = 0;
                 reqsize = extra_size_PVFS_servreq_batch_remove;
                 break;
+            case PVFS_SERV_REMOVE_SUBTREE:
+                zero_credential(&req.u.remove_subtree.credential);
+                reqsize = extra_size_PVFS_servreq_remove_subtree;
+                break;
             case PVFS_SERV_MGMT_REMOVE_OBJECT:
                 /* nothing special, let normal encoding work */
                 break;
@@ -169,6 +175,17 @@ static void lebf_initialize(void)
                 reqsize = extra_size_PVFS_servreq_tree_remove;
                 respsize = extra_size_PVFS_servresp_tree_remove;
                 break;
+            case PVFS_SERV_TREE_TRUNCATE:
+                zero_credential(&req.u.tree_truncate.credential);
+                req.u.tree_truncate.handle_array = NULL;
+                req.u.tree_truncate.size_array = NULL;
+                req.u.tree_truncate.handle_count = 0;
+                resp.u.tree_truncate.status = NULL;
+                resp.u.tree_truncate.handle_count = 0;
+                resp.u.tree_truncate.caller_handle_index = 0;
+                reqsize = extra_size_PVFS_servreq_tree_truncate;
+                respsize = extra_size_PVFS_servresp_tree_truncate;
+                break;
             case PVFS_SERV_IO:
                 req.u.io.io_dist = &tmp_dist;
                 req.u.io.file_req = &tmp_req;
@@ -212,6 +229,9 @@ static void lebf_initialize(void)
             case PVFS_SERV_TRUNCATE:
                 /* nothing special */
                 break;
+            case PVFS_SERV_UPDATE_SIZE:
+                /* nothing special */
+                break;
             case PVFS_SERV_MKDIR:
                 zero_credential(&req.u.mkdir.credential);
                 req.u.mkdir.handle_extent_array.extent_count = 0;
@@ -418,6 +438,33 @@ static int lebf_encode_calc_max_size(
 
     return -PVFS_EINVAL;
 }
+
+/* lebf_encode_calc_resp_size()
+ *
+ * reports the maximum encoded size of the response to the given request:
+ * the maximum for its type, except that a small I/O response carries no
+ * more data than the read asked for, and none for a write
+ *
+ * returns size on success, -errno on failure
+ */
+static int lebf_encode_calc_resp_size(struct PVFS_server_req *req)
+{
+    int size = max_size_array[req->op].resp;
+
+    if (req->op == PVFS_SERV_SMALL_IO)
+    {
+        size -= extra_size_PVFS_servresp_small_io;
+        if (req->u.small_io.io_type == PVFS_IO_READ)
+        {
+            if (req->u.small_io.aggregate_size < PINT_SMALL_IO_MAXSIZE)
+                size += req->u.small_io.aggregate_size;
+            else
+                size += PINT_SMALL_IO_MAXSIZE;
+        }
+    }
+    return size;
+}
+
 #define BF_ENCODE_TARGET_MSG_INIT(_msg) \
     (_msg)->buffer_list = &target_msg->buffer_stub; \
     (_msg)->size_list = &target_msg->size_stub; \
@@ -466,6 +513,45 @@ encode_common(struct PINT_encoded_msg *target_msg, int maxsize)
     return ret;
 }
 
+/* small_io_req_size()
+ *
+ * small I/O messages may carry up to PINT_SMALL_IO_MAXSIZE bytes of data,
+ * which is far more than most of them hold.  Size the encoded request by
+ * the data and file request it actually carries instead of the maximum.
+ */
+static int small_io_req_size(struct PVFS_servreq_small_io *req)
+{
+    int size = max_size_array[PVFS_SERV_SMALL_IO].req
+        - extra_size_PVFS_servreq_small_io;
+
+    if (req->file_req)
+    {
+        size += PVFS_REQUEST_ENCODED_SIZE * req->file_req->num_nested_req;
+    }
+    if (req->io_type == PVFS_IO_WRITE)
+    {
+        size += req->total_bytes;
+    }
+    return size;
+}
+
+/* small_io_resp_size()
+ *
+ * as above, for the response, which only carries data for reads
+ */
+static int small_io_resp_size(struct PVFS_server_resp *resp)
+{
+    int size = max_size_array[PVFS_SERV_SMALL_IO].resp
+        - extra_size_PVFS_servresp_small_io;
+
+    if (resp->status == 0 && resp->u.small_io.io_type == PVFS_IO_READ &&
+        resp->u.small_io.buffer)
+    {
+        size += resp->u.small_io.result_size;
+    }
+    return size;
+}
+
 /* lebf_encode_req()
  *
  * encodes a request structure
@@ -477,12 +563,18 @@ static int lebf_encode_req(
     struct PINT_encoded_msg *target_msg)
 {
     int ret = 0;
+    int maxsize;
     char **p;
 
     gossip_debug(GOSSIP_ENDECODE_DEBUG,"Executing lebf_encode_req...\n");
     gossip_debug(GOSSIP_ENDECODE_DEBUG,"\treq->op:%d\n",req->op);
 
-    ret = encode_common(target_msg, max_size_array[req->op].req);
+    if (req->op == PVFS_SERV_SMALL_IO && !initializing_sizes)
+        maxsize = small_io_req_size(&req->u.small_io);
+    else
+        maxsize = max_size_array[req->op].req;
+
+    ret = encode_common(target_msg, maxsize);
 
     if (ret)
         goto out;
@@ -505,9 +597,12 @@ static int lebf_encode_req(
         CASE(PVFS_SERV_BATCH_CREATE, batch_create);
         CASE(PVFS_SERV_BATCH_REMOVE, batch_remove);
         CASE(PVFS_SERV_REMOVE, remove);
+        CASE(PVFS_SERV_REMOVE_SUBTREE, remove_subtree);
         CASE(PVFS_SERV_MGMT_REMOVE_OBJECT, mgmt_remove_object);
         CASE(PVFS_SERV_MGMT_REMOVE_DIRENT, mgmt_remove_dirent);
         CASE(PVFS_SERV_TREE_REMOVE, tree_remove);
+        CASE(PVFS_SERV_TREE_TRUNCATE, tree_truncate);
+        CASE(PVFS_SERV_UPDATE_SIZE, update_size);
         CASE(PVFS_SERV_TREE_GET_FILE_SIZE, tree_get_file_size);
         CASE(PVFS_SERV_TREE_GETATTR, tree_getattr);
         CASE(PVFS_SERV_TREE_SETATTR, tree_setattr);
@@ -552,6 +647,8 @@ static int lebf_encode_req(
         case PVFS_SERV_WRITE_COMPLETION:
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
+        case PVFS_SERV_DIRDATA_SPLIT:
+        case PVFS_SERV_DATAFILE_RECLAIM:
         case PVFS_SERV_JOB_TIMER:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_err("%s: invalid operation %d\n", __func__, req->op);
@@ -566,12 +663,11 @@ static int lebf_encode_req(
       - (char *) target_msg->buffer_list[0];
     target_msg->size_list[0] = target_msg->total_size;
 
-    if (target_msg->total_size > max_size_array[req->op].req)
+    if (target_msg->total_size > maxsize)
     {
         ret = -PVFS_ENOMEM;
         gossip_err("%s: op %d needed %lld bytes but alloced only %d\n",
-          __func__, req->op, lld(target_msg->total_size),
-          max_size_array[req->op].req);
+          __func__, req->op, lld(target_msg->total_size), maxsize);
     }
 
   out:
@@ -590,9 +686,15 @@ static int lebf_encode_resp(
     struct PINT_encoded_msg *target_msg)
 {
     int ret;
+    int maxsize;
     char **p;
 
-    ret = encode_common(target_msg, max_size_array[resp->op].resp);
+    if (resp->op == PVFS_SERV_SMALL_IO && !initializing_sizes)
+        maxsize = small_io_resp_size(resp);
+    else
+        maxsize = max_size_array[resp->op].resp;
+
+    ret = encode_common(target_msg, maxsize);
     if (ret)
         goto out;
     gossip_debug(GOSSIP_ENDECODE_DEBUG,"lebf_encode_resp\n");
@@ -640,6 +742,9 @@ static int lebf_encode_resp(
         CASE(PVFS_SERV_LISTATTR, listattr);
         CASE(PVFS_SERV_TREE_GET_FILE_SIZE, tree_get_file_size);
         CASE(PVFS_SERV_TREE_REMOVE, tree_remove);
+        CASE(PVFS_SERV_TREE_TRUNCATE, tree_truncate);
+        CASE(PVFS_SERV_UPDATE_SIZE, update_size);
+        CASE(PVFS_SERV_REMOVE_SUBTREE, remove_subtree);
         CASE(PVFS_SERV_TREE_GETATTR, tree_getattr);
         CASE(PVFS_SERV_TREE_SETATTR, tree_setattr);
         CASE(PVFS_SERV_MGMT_GET_UID, mgmt_get_uid);
@@ -668,6 +773,8 @@ static int lebf_encode_resp(
         case PVFS_SERV_INVALID:
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
+        case PVFS_SERV_DIRDATA_SPLIT:
+        case PVFS_SERV_DATAFILE_RECLAIM:
         case PVFS_SERV_JOB_TIMER:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_err("%s: invalid operation %d\n", __func__, resp->op);
@@ -683,11 +790,10 @@ static int lebf_encode_resp(
       - (char *) target_msg->buffer_list[0];
     target_msg->size_list[0] = target_msg->total_size;
 
-    if (target_msg->total_size > max_size_array[resp->op].resp) {
+    if (target_msg->total_size > maxsize) {
         ret = -PVFS_ENOMEM;
         gossip_err("%s: op %d needed %lld bytes but alloced only %d\n",
-          __func__, resp->op, lld(target_msg->total_size),
-          max_size_array[resp->op].resp);
+          __func__, resp->op, lld(target_msg->total_size), maxsize);
     }
 
   out:
@@ -733,9 +839,12 @@ static int lebf_decode_req(
         CASE(PVFS_SERV_BATCH_CREATE, batch_create);
         CASE(PVFS_SERV_BATCH_REMOVE, batch_remove);
         CASE(PVFS_SERV_REMOVE, remove);
+        CASE(PVFS_SERV_REMOVE_SUBTREE, remove_subtree);
         CASE(PVFS_SERV_MGMT_REMOVE_OBJECT, mgmt_remove_object);
         CASE(PVFS_SERV_MGMT_REMOVE_DIRENT, mgmt_remove_dirent);
         CASE(PVFS_SERV_TREE_REMOVE, tree_remove);
+        CASE(PVFS_SERV_TREE_TRUNCATE, tree_truncate);
+        CASE(PVFS_SERV_UPDATE_SIZE, update_size);
         CASE(PVFS_SERV_TREE_GET_FILE_SIZE, tree_get_file_size);
         CASE(PVFS_SERV_TREE_GETATTR, tree_getattr);
         CASE(PVFS_SERV_TREE_SETATTR, tree_setattr);
@@ -779,6 +888,8 @@ static int lebf_decode_req(
         case PVFS_SERV_WRITE_COMPLETION:
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
+        case PVFS_SERV_DIRDATA_SPLIT:
+        case PVFS_SERV_DATAFILE_RECLAIM:
         case PVFS_SERV_JOB_TIMER:
         case PVFS_SERV_PROTO_ERROR:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
@@ -858,6 +969,9 @@ static int lebf_decode_resp(
         CASE(PVFS_SERV_LISTATTR, listattr);
         CASE(PVFS_SERV_TREE_GET_FILE_SIZE, tree_get_file_size);
         CASE(PVFS_SERV_TREE_REMOVE, tree_remove);
+        CASE(PVFS_SERV_TREE_TRUNCATE, tree_truncate);
+        CASE(PVFS_SERV_UPDATE_SIZE, update_size);
+        CASE(PVFS_SERV_REMOVE_SUBTREE, remove_subtree);
         CASE(PVFS_SERV_TREE_GETATTR, tree_getattr);
         CASE(PVFS_SERV_TREE_SETATTR, tree_setattr);
         CASE(PVFS_SERV_MGMT_GET_UID, mgmt_get_uid);
@@ -886,6 +1000,8 @@ static int lebf_decode_resp(
         case PVFS_SERV_INVALID:
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
+        case PVFS_SERV_DIRDATA_SPLIT:
+        case PVFS_SERV_DATAFILE_RECLAIM:
         case PVFS_SERV_JOB_TIMER:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_lerr("%s: invalid operation %d.\n", __func__, resp->op);
@@ -1035,6 +1151,16 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
 #endif
                 break;
 
+            case PVFS_SERV_TREE_TRUNCATE:
+                decode_free(req->u.tree_truncate.handle_array);
+                decode_free(req->u.tree_truncate.size_array);
+                decode_free(req->u.tree_truncate.credential.group_array);
+                decode_free(req->u.tree_truncate.credential.signature);
+#ifdef ENABLE_SECURITY_CERT
+                decode_free(req->u.tree_truncate.credential.certificate.buf);
+#endif
+                break;
+
             case PVFS_SERV_TREE_GET_FILE_SIZE:
                 decode_free(req->u.tree_get_file_size.handle_array);
                 decode_free(req->u.tree_get_file_size.credential.group_array);
@@ -1124,6 +1250,15 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
 #endif
                 break;
 
+            case PVFS_SERV_REMOVE_SUBTREE:
+                decode_free(req->u.remove_subtree.credential.group_array);
+                decode_free(req->u.remove_subtree.credential.signature);
+#ifdef ENABLE_SECURITY_CERT
+                decode_free(
+                    req->u.remove_subtree.credential.certificate.buf);
+#endif
+                break;
+
             case PVFS_SERV_MGMT_SPLIT_DIRENT:
                 decode_free(req->u.mgmt_split_dirent.dist);
                 decode_free(req->u.mgmt_split_dirent.entry_handles);
@@ -1137,6 +1272,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
             case PVFS_SERV_RMDIRENT:
             case PVFS_SERV_CHDIRENT:
             case PVFS_SERV_TRUNCATE:
+            case PVFS_SERV_UPDATE_SIZE:
             case PVFS_SERV_READDIR:
             case PVFS_SERV_FLUSH:
             case PVFS_SERV_MGMT_SETPARAM:
@@ -1160,6 +1296,8 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
             case PVFS_SERV_WRITE_COMPLETION:
             case PVFS_SERV_PERF_UPDATE:
             case PVFS_SERV_PRECREATE_POOL_REFILLER:
+            case PVFS_SERV_DIRDATA_SPLIT:
+            case PVFS_SERV_DATAFILE_RECLAIM:
             case PVFS_SERV_JOB_TIMER:
             case PVFS_SERV_PROTO_ERROR:            
             case PVFS_SERV_NUM_OPS:  /* sentinel */
@@ -1329,6 +1467,12 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                       break;
                    }
 
+                case PVFS_SERV_TREE_TRUNCATE:
+                   {
+                      decode_free(resp->u.tree_truncate.status);
+                      break;
+                   }
+
                 case PVFS_SERV_TREE_GET_FILE_SIZE:
                    {
                       decode_free(resp->u.tree_get_file_size.size);
@@ -1379,6 +1523,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                 case PVFS_SERV_RMDIRENT:
                 case PVFS_SERV_CHDIRENT:
                 case PVFS_SERV_TRUNCATE:
+                case PVFS_SERV_UPDATE_SIZE:
                 case PVFS_SERV_MKDIR:
                 case PVFS_SERV_FLUSH:
                 case PVFS_SERV_MGMT_SETPARAM:
@@ -1387,6 +1532,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                 case PVFS_SERV_WRITE_COMPLETION:
                 case PVFS_SERV_PROTO_ERROR:
                 case PVFS_SERV_BATCH_REMOVE:
+                case PVFS_SERV_REMOVE_SUBTREE:
                 case PVFS_SERV_IMM_COPIES:
                 case PVFS_SERV_MGMT_GET_DIRENT:
                 case PVFS_SERV_MGMT_CREATE_ROOT_DIR:
@@ -1396,6 +1542,8 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                 case PVFS_SERV_INVALID:
                 case PVFS_SERV_PERF_UPDATE:
                 case PVFS_SERV_PRECREATE_POOL_REFILLER:
+                case PVFS_SERV_DIRDATA_SPLIT:
+                case PVFS_SERV_DATAFILE_RECLAIM:
                 case PVFS_SERV_JOB_TIMER:
                 case PVFS_SERV_NUM_OPS:  /* sentinel */
                     gossip_lerr("%s: invalid response operation %d.\n",
@@ -1451,7 +1599,8 @@ static PINT_encoding_functions lebf_functions = {
     lebf_decode_resp,
     lebf_encode_rel,
     lebf_decode_rel,
-    lebf_encode_calc_max_size
+    lebf_encode_calc_max_size,
+    lebf_encode_calc_resp_size
 };
 
 PINT_encoding_table_values le_bytefield_table = {
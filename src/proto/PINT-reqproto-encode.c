@@ -349,6 +349,35 @@ int PINT_encode_calc_max_size(
     return(ret);
 }
 
+/* PINT_encode_calc_resp_size()
+ *
+ * calculates the maximum size of the encoded response to a request.
+ * Unlike PINT_encode_calc_max_size() this looks at the request, so that
+ * responses carrying data are sized by what was asked for.
+ *
+ * returns max size of encoded buffer on success, -PVFS_error on failure
+ */
+int PINT_encode_calc_resp_size(
+    struct PVFS_server_req* request,
+    enum PVFS_encoding_type enc_type)
+{
+    int ret = -PVFS_EINVAL;
+
+    gossip_debug(GOSSIP_ENDECODE_DEBUG,"PINT_encode_calc_resp_size\n");
+    switch(enc_type)
+    {
+	case ENCODING_LE_BFIELD:
+	    ret = PINT_encoding_table[enc_type]->op->encode_calc_resp_size
+		(request);
+	    break;
+	default:
+	    gossip_lerr("Error: encoding type not supported.\n");
+	    break;
+    }
+
+    return(ret);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
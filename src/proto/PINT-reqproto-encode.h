@@ -96,6 +96,10 @@ int PINT_encode_calc_max_size(
     enum PVFS_server_op op_type,
     enum PVFS_encoding_type enc_type);
 
+int PINT_encode_calc_resp_size(
+    struct PVFS_server_req* request,
+    enum PVFS_encoding_type enc_type);
+
 
 #endif /* __PINT_REQUEST_ENCODE_H */
 
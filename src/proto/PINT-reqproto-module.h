@@ -37,6 +37,8 @@ typedef struct
     int (*encode_calc_max_size) (
 	enum PINT_encode_msg_type input_type,
 	enum PVFS_server_op op_type);
+    int (*encode_calc_resp_size) (
+	struct PVFS_server_req * request);
 } PINT_encoding_functions;
 
 /* size of generic header placed at the beginning of all encoded buffers;
@@ -45,6 +45,12 @@
 
 #define PVFS_ATTR_META_UNSTUFFED (1 << 12)
 
+/* contents of a tiny stuffed file, returned by getattr on request */
+#define PVFS_ATTR_META_INLINE_DATA (1 << 14)
+
+/* logical size cached on the metafile of a striped file */
+#define PVFS_ATTR_META_SIZE (1 << 16)
+
 
 /* internal attribute masks for datafile objects */
 #define PVFS_ATTR_DATA_SIZE            (1 << 15)
@@ -98,6 +104,15 @@ struct PVFS_metafile_attr_s
 
     int32_t stuffed_size;
 
+    /* file contents, only present with PVFS_ATTR_META_INLINE_DATA */
+    char *inline_data;
+    uint32_t inline_size;
+
+    /* only present with PVFS_ATTR_META_SIZE; cached_size is -1 if the
+     * metadata server does not know the size */
+    PVFS_size cached_size;
+    uint32_t cached_size_version;
+
     PVFS_metafile_hint hint;
 };
 typedef struct PVFS_metafile_attr_s PVFS_metafile_attr;
@@ -134,6 +149,19 @@ typedef struct PVFS_metafile_attr_s PVFS_metafile_attr;
        decode_PVFS_handle(pptr, &(x)->mirror_dfile_array[handle_i]);    \
     }                                                                   \
 } while (0)
+/* inline data decodes in place, pointing into the message buffer */
+#define encode_PVFS_metafile_attr_inline_data(pptr,x) do {              \
+    encode_uint32_t(pptr, &(x)->inline_size);                           \
+    encode_skip4(pptr,);                                                \
+    memcpy(*(pptr), (x)->inline_data, (x)->inline_size);                \
+    *(pptr) += roundup8((x)->inline_size);                              \
+} while (0)
+#define decode_PVFS_metafile_attr_inline_data(pptr,x) do {              \
+    decode_uint32_t(pptr, &(x)->inline_size);                           \
+    decode_skip4(pptr,);                                                \
+    (x)->inline_data = *(pptr);                                         \
+    *(pptr) += roundup8((x)->inline_size);                              \
+} while (0)
 #define encode_PVFS_metafile_attr_dfiles(pptr,x) do {                   \
     int dfiles_i;                                                       \
     encode_uint32_t(pptr, &(x)->dfile_count);                           \
@@ -307,6 +335,14 @@ typedef struct PVFS_object_attr PVFS_object_attr;
 	encode_PVFS_metafile_attr_dfiles(pptr, &(x)->u.meta); \
     if ((x)->mask & PVFS_ATTR_META_MIRROR_DFILES) \
         encode_PVFS_metafile_attr_mirror_dfiles(pptr, &(x)->u.meta); \
+    if ((x)->mask & PVFS_ATTR_META_INLINE_DATA) \
+        encode_PVFS_metafile_attr_inline_data(pptr, &(x)->u.meta); \
+    if ((x)->mask & PVFS_ATTR_META_SIZE) \
+    { \
+        encode_PVFS_size(pptr, &(x)->u.meta.cached_size); \
+        encode_uint32_t(pptr, &(x)->u.meta.cached_size_version); \
+        encode_skip4(pptr,); \
+    } \
     if ((x)->mask & PVFS_ATTR_DATA_SIZE) \
 	encode_PVFS_datafile_attr(pptr, &(x)->u.data); \
     if ((x)->mask & PVFS_ATTR_SYMLNK_TARGET) \
@@ -349,6 +385,14 @@ typedef struct PVFS_object_attr PVFS_object_attr;
 	decode_PVFS_metafile_attr_dfiles(pptr, &(x)->u.meta); \
     if ((x)->mask & PVFS_ATTR_META_MIRROR_DFILES) \
         decode_PVFS_metafile_attr_mirror_dfiles(pptr, &(x)->u.meta); \
+    if ((x)->mask & PVFS_ATTR_META_INLINE_DATA) \
+        decode_PVFS_metafile_attr_inline_data(pptr, &(x)->u.meta); \
+    if ((x)->mask & PVFS_ATTR_META_SIZE) \
+    { \
+        decode_PVFS_size(pptr, &(x)->u.meta.cached_size); \
+        decode_uint32_t(pptr, &(x)->u.meta.cached_size_version); \
+        decode_skip4(pptr,); \
+    } \
     if ((x)->mask & PVFS_ATTR_DATA_SIZE) \
 	decode_PVFS_datafile_attr(pptr, &(x)->u.data); \
     if ((x)->mask & PVFS_ATTR_SYMLNK_TARGET) \
@@ -384,9 +428,10 @@ typedef struct PVFS_object_attr PVFS_object_attr;
 /*TODO: PVFS_REQ_LIMIT_HANDLES_COUNT really needs to change to something
         indicating the max number of servers */
 
-/* room for distribution, stuffed_size, dfile array, and mirror_dfile_array */
+/* room for distribution, stuffed_size, cached size, dfile array, and
+ * mirror_dfile_array */
 #define extra_size_PVFS_object_attr_meta (PVFS_REQ_LIMIT_DIST_BYTES + \
-  sizeof(int32_t) +                                                   \
+  sizeof(int32_t) + 2 * sizeof(PVFS_size) +                           \
   (PVFS_REQ_LIMIT_DFILE_COUNT * sizeof(PVFS_handle)) +                \
   (PVFS_REQ_LIMIT_MIRROR_DFILE_COUNT * sizeof(PVFS_handle))) 
 
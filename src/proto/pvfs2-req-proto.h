@@ -26,7 +26,7 @@
  * compatibility (such as changing the semantics or protocol fields for an
  * existing request type)
  */
-#define PVFS2_PROTO_MAJOR 7
+#define PVFS2_PROTO_MAJOR 8
 /* update PVFS2_PROTO_MINOR on wire protocol changes that preserve backwards
  * compatibility (such as adding a new request type)
  * NOTE: Incrementing this will make clients unable to talk to older servers.
@@ -36,13 +36,14 @@
 
 #define PVFS2_PROTO_VERSION ((PVFS2_PROTO_MAJOR*1000)+(PVFS2_PROTO_MINOR))
 
-/* we set the maximum possible size of a small I/O packed message as 64K.  This
- * is an upper limit that is used to allocate the request and response encoded
- * buffers, and is independent of the max unexpected message size of the specific
- * BMI module.  All max unexpected message sizes for BMI modules have to be less
- * than this value
+/* we set the maximum possible size of the data packed in a small I/O
+ * message as 256K.  This is the protocol upper limit; the size actually used
+ * is the smaller of the SmallIOSize filesystem option and the max unexpected
+ * message size of the BMI module used to reach the server.  Small I/O
+ * messages are encoded at the size of the data they carry, not at this
+ * limit.  TCP_MODE_UNEXP_LIMIT in bmi-tcp.c is derived from this value.
  */
-#define PINT_SMALL_IO_MAXSIZE (16*1024)
+#define PINT_SMALL_IO_MAXSIZE (256*1024)
 
 enum PVFS_server_op
 {
@@ -98,6 +99,11 @@ enum PVFS_server_op
     PVFS_SERV_TREE_GETATTR = 49,
     PVFS_SERV_MGMT_GET_USER_CERT = 50,
     PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ = 51,
+    PVFS_SERV_DIRDATA_SPLIT = 52, /* not a real protocol request */
+    PVFS_SERV_DATAFILE_RECLAIM = 53, /* not a real protocol request */
+    PVFS_SERV_REMOVE_SUBTREE = 54,
+    PVFS_SERV_TREE_TRUNCATE = 55,
+    PVFS_SERV_UPDATE_SIZE = 56,
 
     /* leave this entry last */
     PVFS_SERV_NUM_OPS
@@ -148,6 +154,8 @@ enum PVFS_server_op
 #define PVFS_REQ_LIMIT_PATH_SEGMENT_COUNT   40
 /*  count of datafiles associated with a logical file */
 #define PVFS_REQ_LIMIT_DFILE_COUNT        1024
+/* max size of file contents returned inline with a getattr */
+#define PVFS_REQ_LIMIT_INLINE_DATA        4096
 #define PVFS_REQ_LIMIT_DFILE_COUNT_IS_VALID(dfile_count) \
 ((dfile_count > 0) && (dfile_count < PVFS_REQ_LIMIT_DFILE_COUNT))
 #define PVFS_REQ_LIMIT_MIRROR_DFILE_COUNT 1024
@@ -392,6 +400,53 @@ do {                                                 \
     (__req).u.batch_remove.handles = (__handles);    \
 } while (0)
 
+/* remove_subtree *********************************************/
+/* - removes up to budget objects below a directory, working on the
+ *   servers that hold its dirdata objects */
+
+struct PVFS_servreq_remove_subtree
+{
+    PVFS_handle handle;           /* directory or dirdata object */
+    PVFS_fs_id  fs_id;
+    uint32_t budget;              /* max objects to remove this call */
+    PVFS_credential credential;   /* checked on every directory */
+};
+endecode_fields_4_struct(
+    PVFS_servreq_remove_subtree,
+    PVFS_handle, handle,
+    PVFS_fs_id, fs_id,
+    uint32_t, budget,
+    PVFS_credential, credential);
+#define extra_size_PVFS_servreq_remove_subtree extra_size_PVFS_credential
+
+#define PINT_SERVREQ_REMOVE_SUBTREE_FILL(__req,         \
+                                         __cap,         \
+                                         __cred,        \
+                                         __fsid,        \
+                                         __handle,      \
+                                         __budget,      \
+                                         __hints)       \
+do {                                                    \
+    memset(&(__req), 0, sizeof(__req));                 \
+    (__req).op = PVFS_SERV_REMOVE_SUBTREE;              \
+    PVFS_REQ_COPY_CAPABILITY((__cap), (__req));         \
+    (__req).u.remove_subtree.credential = (__cred);     \
+    (__req).hints = (__hints);                          \
+    (__req).u.remove_subtree.fs_id = (__fsid);          \
+    (__req).u.remove_subtree.handle = (__handle);       \
+    (__req).u.remove_subtree.budget = (__budget);       \
+} while (0)
+
+struct PVFS_servresp_remove_subtree
+{
+    uint32_t removed;             /* objects removed by this call */
+    uint32_t complete;            /* nonzero once nothing is left */
+};
+endecode_fields_2_struct(
+    PVFS_servresp_remove_subtree,
+    uint32_t, removed,
+    uint32_t, complete);
+
 /* mgmt_remove_object */
 /* - used to remove an existing object reference */
 
@@ -567,6 +622,70 @@ endecode_fields_2a_struct(
 #define extra_size_PVFS_servresp_tree_remove \
     (PVFS_REQ_LIMIT_HANDLES_COUNT * sizeof(int32_t))
 
+/* tree_truncate *********************************************/
+/* - resizes a set of datafiles, fanning out over a tree of servers;
+ *   size_array holds the new physical size of each datafile */
+
+struct PVFS_servreq_tree_truncate
+{
+    PVFS_fs_id  fs_id;
+    PVFS_credential credential;
+    uint32_t caller_handle_index;
+    uint32_t handle_count;
+    PVFS_handle *handle_array;
+    PVFS_size *size_array;
+};
+endecode_fields_4aa_struct(
+    PVFS_servreq_tree_truncate,
+    PVFS_fs_id, fs_id,
+    skip4,,
+    PVFS_credential, credential,
+    uint32_t, caller_handle_index,
+    uint32_t, handle_count,
+    PVFS_handle, handle_array,
+    PVFS_size, size_array);
+#define extra_size_PVFS_servreq_tree_truncate                \
+  ( (PVFS_REQ_LIMIT_HANDLES_COUNT * sizeof(PVFS_handle)) +  \
+    (PVFS_REQ_LIMIT_HANDLES_COUNT * sizeof(PVFS_size)) +    \
+    extra_size_PVFS_credential )
+
+#define PINT_SERVREQ_TREE_TRUNCATE_FILL(__req,                             \
+                                 __cap,                                    \
+                                 __cred,                                   \
+                                 __fsid,                                   \
+                                 __caller_handle_index,                    \
+                                 __handle_count,                           \
+                                 __handle_array,                           \
+                                 __size_array,                             \
+                                 __hints)                                  \
+do {                                                                       \
+    memset(&(__req), 0, sizeof(__req));                                    \
+    (__req).op = PVFS_SERV_TREE_TRUNCATE;                                  \
+    (__req).hints = (__hints);                                             \
+    PVFS_REQ_COPY_CAPABILITY((__cap), (__req));                            \
+    (__req).u.tree_truncate.credential = (__cred);                         \
+    (__req).u.tree_truncate.fs_id = (__fsid);                              \
+    (__req).u.tree_truncate.caller_handle_index = (__caller_handle_index); \
+    (__req).u.tree_truncate.handle_count = (__handle_count);               \
+    (__req).u.tree_truncate.handle_array = (__handle_array);               \
+    (__req).u.tree_truncate.size_array = (__size_array);                   \
+} while (0)
+
+struct PVFS_servresp_tree_truncate
+{
+    uint32_t caller_handle_index;
+    uint32_t handle_count;
+    int32_t *status;
+};
+endecode_fields_2a_struct(
+    PVFS_servresp_tree_truncate,
+    skip4,,
+    uint32_t, caller_handle_index,
+    uint32_t, handle_count,
+    int32_t, status);
+#define extra_size_PVFS_servresp_tree_truncate \
+    (PVFS_REQ_LIMIT_HANDLES_COUNT * sizeof(int32_t))
+
 struct PVFS_servreq_tree_get_file_size
 {
     PVFS_fs_id  fs_id;
@@ -806,7 +925,7 @@ endecode_fields_1_struct(
     PVFS_servresp_getattr,
     PVFS_object_attr, attr);
 #define extra_size_PVFS_servresp_getattr \
-    extra_size_PVFS_object_attr
+    (extra_size_PVFS_object_attr + PVFS_REQ_LIMIT_INLINE_DATA)
 
 /* unstuff ****************************************************/
 /* - creates the datafile handles for the file.  This allows a stuffed
@@ -1423,6 +1542,63 @@ do {                                            \
     (__req).u.truncate.handle = (__handle);     \
 } while (0)
 
+/* update_size ***********************************************/
+/* - updates the logical size cached on a metafile of a striped file */
+
+enum PVFS_update_size_mode
+{
+    /* a datafile grew: raise the size to at least size */
+    PVFS_UPDATE_SIZE_EXTEND = 1,
+    /* set the size if the cache is still at version, a size of -1
+     * invalidates it unconditionally */
+    PVFS_UPDATE_SIZE_SET = 2,
+};
+
+struct PVFS_servreq_update_size
+{
+    PVFS_handle handle;   /* metafile */
+    PVFS_fs_id fs_id;     /* file system */
+    int32_t mode;         /* enum PVFS_update_size_mode */
+    PVFS_size size;       /* logical size */
+    uint32_t version;     /* for PVFS_UPDATE_SIZE_SET */
+};
+endecode_fields_6_struct(
+    PVFS_servreq_update_size,
+    PVFS_handle, handle,
+    PVFS_fs_id, fs_id,
+    int32_t, mode,
+    PVFS_size, size,
+    uint32_t, version,
+    skip4,);
+#define PINT_SERVREQ_UPDATE_SIZE_FILL(__req,       \
+                                      __cap,       \
+                                      __fsid,      \
+                                      __handle,    \
+                                      __mode,      \
+                                      __size,      \
+                                      __version,   \
+                                      __hints)     \
+do {                                               \
+    memset(&(__req), 0, sizeof(__req));            \
+    (__req).op = PVFS_SERV_UPDATE_SIZE;            \
+    PVFS_REQ_COPY_CAPABILITY((__cap), (__req));    \
+    (__req).hints = (__hints);                     \
+    (__req).u.update_size.fs_id = (__fsid);        \
+    (__req).u.update_size.handle = (__handle);     \
+    (__req).u.update_size.mode = (__mode);         \
+    (__req).u.update_size.size = (__size);         \
+    (__req).u.update_size.version = (__version);   \
+} while (0)
+
+struct PVFS_servresp_update_size
+{
+    uint32_t version;     /* version of the cache after the update */
+};
+endecode_fields_2_struct(
+    PVFS_servresp_update_size,
+    uint32_t, version,
+    skip4,);
+
 /* statfs ****************************************************/
 /* - retrieves statistics for a particular file system */
 
@@ -1468,6 +1644,8 @@ struct PVFS_servreq_io
     uint32_t server_nr;
     /* total number of I/O servers involved in distribution */
     uint32_t server_ct;
+    /* metafile of the file, told about writes that grow the datafile */
+    PVFS_handle metafile_handle;
 
     /* distribution */
     PINT_dist *io_dist;
@@ -1487,6 +1665,7 @@ struct PVFS_servreq_io
     encode_enum(pptr, &(x)->flow_type);              \
     encode_uint32_t(pptr, &(x)->server_nr);          \
     encode_uint32_t(pptr, &(x)->server_ct);          \
+    encode_PVFS_handle(pptr, &(x)->metafile_handle); \
     encode_PINT_dist(pptr, &(x)->io_dist);           \
     encode_PINT_Request(pptr, &(x)->file_req);       \
     encode_PVFS_offset(pptr, &(x)->file_req_offset); \
@@ -1500,6 +1679,7 @@ struct PVFS_servreq_io
     decode_enum(pptr, &(x)->flow_type);                            \
     decode_uint32_t(pptr, &(x)->server_nr);                        \
     decode_uint32_t(pptr, &(x)->server_ct);                        \
+    decode_PVFS_handle(pptr, &(x)->metafile_handle);               \
     decode_PINT_dist(pptr, &(x)->io_dist);                         \
     decode_PINT_Request(pptr, &(x)->file_req);                     \
     PINT_request_decode((x)->file_req); /* unpacks the pointers */ \
@@ -1515,6 +1695,7 @@ struct PVFS_servreq_io
                              __cap,                    \
                              __fsid,                   \
                              __handle,                 \
+                             __meta_handle,            \
                              __io_type,                \
                              __flow_type,              \
                              __datafile_nr,            \
@@ -1531,6 +1712,7 @@ do {                                                   \
     (__req).hints              = (__hints);            \
     (__req).u.io.fs_id         = (__fsid);             \
     (__req).u.io.handle        = (__handle);           \
+    (__req).u.io.metafile_handle = (__meta_handle);    \
     (__req).u.io.io_type       = (__io_type);          \
     (__req).u.io.flow_type     = (__flow_type);        \
     (__req).u.io.server_nr       = (__datafile_nr);    \
@@ -1568,6 +1750,7 @@ struct PVFS_servreq_small_io
 
     uint32_t server_nr;
     uint32_t server_ct;
+    PVFS_handle metafile_handle;
 
     PINT_dist * dist;
     struct PINT_Request * file_req;
@@ -1592,6 +1775,7 @@ struct PVFS_servreq_small_io
     encode_enum(pptr, &(x)->io_type);                       \
     encode_uint32_t(pptr, &(x)->server_nr);                 \
     encode_uint32_t(pptr, &(x)->server_ct);                 \
+    encode_PVFS_handle(pptr, &(x)->metafile_handle);        \
     encode_PINT_dist(pptr, &(x)->dist);                     \
     encode_PINT_Request(pptr, &(x)->file_req);              \
     encode_PVFS_offset(pptr, &(x)->file_req_offset);        \
@@ -1617,6 +1801,7 @@ struct PVFS_servreq_small_io
     decode_enum(pptr, &(x)->io_type);                                    \
     decode_uint32_t(pptr, &(x)->server_nr);                              \
     decode_uint32_t(pptr, &(x)->server_ct);                              \
+    decode_PVFS_handle(pptr, &(x)->metafile_handle);                     \
     decode_PINT_dist(pptr, &(x)->dist);                                  \
     decode_PINT_Request(pptr, &(x)->file_req);                           \
     PINT_request_decode((x)->file_req); /* unpacks the pointers */       \
@@ -1643,6 +1828,7 @@ struct PVFS_servreq_small_io
                                    __cap,                           \
                                    __fsid,                          \
                                    __handle,                        \
+                                   __meta_handle,                   \
                                    __io_type,                       \
                                    __dfile_nr,                      \
                                    __dfile_ct,                      \
@@ -1659,6 +1845,7 @@ do {                                                                \
     (__req).hints                             = (__hints);          \
     (__req).u.small_io.fs_id                  = (__fsid);           \
     (__req).u.small_io.handle                 = (__handle);         \
+    (__req).u.small_io.metafile_handle        = (__meta_handle);    \
     (__req).u.small_io.io_type                = (__io_type);        \
     (__req).u.small_io.server_nr              = (__dfile_nr);       \
     (__req).u.small_io.server_ct              = (__dfile_ct);       \
@@ -2566,6 +2753,7 @@ struct PVFS_server_req
         struct PVFS_servreq_batch_create batch_create;
         struct PVFS_servreq_remove remove;
         struct PVFS_servreq_batch_remove batch_remove;
+        struct PVFS_servreq_remove_subtree remove_subtree;
         struct PVFS_servreq_io io;
         struct PVFS_servreq_getattr getattr;
         struct PVFS_servreq_setattr setattr;
@@ -2594,6 +2782,8 @@ struct PVFS_server_req
         struct PVFS_servreq_small_io small_io;
         struct PVFS_servreq_listattr listattr;
         struct PVFS_servreq_tree_remove tree_remove;
+        struct PVFS_servreq_tree_truncate tree_truncate;
+        struct PVFS_servreq_update_size update_size;
         struct PVFS_servreq_tree_get_file_size tree_get_file_size;
         struct PVFS_servreq_tree_getattr tree_getattr;
         struct PVFS_servreq_mgmt_get_uid mgmt_get_uid;
@@ -2660,6 +2850,9 @@ struct PVFS_server_resp
         struct PVFS_servresp_small_io small_io;
         struct PVFS_servresp_listattr listattr;
         struct PVFS_servresp_tree_remove tree_remove;
+        struct PVFS_servresp_tree_truncate tree_truncate;
+        struct PVFS_servresp_update_size update_size;
+        struct PVFS_servresp_remove_subtree remove_subtree;
         struct PVFS_servresp_tree_get_file_size tree_get_file_size;
         struct PVFS_servresp_tree_getattr tree_getattr;
         struct PVFS_servresp_mgmt_get_uid mgmt_get_uid;
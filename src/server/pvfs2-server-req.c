@@ -37,6 +37,7 @@ extern struct PINT_server_req_params pvfs2_perf_update_params;
 extern struct PINT_server_req_params pvfs2_job_timer_params;
 extern struct PINT_server_req_params pvfs2_proto_error_params;
 extern struct PINT_server_req_params pvfs2_perf_mon_params;
+extern struct PINT_server_req_params pvfs2_event_mon_params;
 extern struct PINT_server_req_params pvfs2_iterate_handles_params;
 extern struct PINT_server_req_params pvfs2_get_eattr_params;
 extern struct PINT_server_req_params pvfs2_get_eattr_list_params;
@@ -61,6 +62,11 @@ extern struct PINT_server_req_params pvfs2_mgmt_get_dirent_params;
 extern struct PINT_server_req_params pvfs2_mgmt_create_root_dir_params;
 extern struct PINT_server_req_params pvfs2_mgmt_split_dirent_params;
 extern struct PINT_server_req_params pvfs2_tree_getattr_params;
+extern struct PINT_server_req_params pvfs2_dirdata_split_params;
+extern struct PINT_server_req_params pvfs2_datafile_reclaim_params;
+extern struct PINT_server_req_params pvfs2_remove_subtree_params;
+extern struct PINT_server_req_params pvfs2_tree_truncate_params;
+extern struct PINT_server_req_params pvfs2_update_size_params;
 #ifdef ENABLE_SECURITY_CERT
 extern struct PINT_server_req_params pvfs2_get_user_cert_params;
 extern struct PINT_server_req_params pvfs2_get_user_cert_keyreq_params;
@@ -92,7 +98,7 @@ struct PINT_server_req_entry PINT_server_req_table[] =
     /* 20 */ {PVFS_SERV_MGMT_PERF_MON, &pvfs2_perf_mon_params},
     /* 21 */ {PVFS_SERV_MGMT_ITERATE_HANDLES, &pvfs2_iterate_handles_params},
     /* 22 */ {PVFS_SERV_MGMT_DSPACE_INFO_LIST, NULL},
-    /* 23 */ {PVFS_SERV_MGMT_EVENT_MON, NULL},
+    /* 23 */ {PVFS_SERV_MGMT_EVENT_MON, &pvfs2_event_mon_params},
     /* 24 */ {PVFS_SERV_MGMT_REMOVE_OBJECT, &pvfs2_mgmt_remove_object_params},
     /* 25 */ {PVFS_SERV_MGMT_REMOVE_DIRENT, &pvfs2_mgmt_remove_dirent_params},
     /* 26 */ {PVFS_SERV_MGMT_GET_DIRDATA_HANDLE, &pvfs2_mgmt_get_dirdata_handle_params},
@@ -121,11 +127,16 @@ struct PINT_server_req_entry PINT_server_req_table[] =
     /* 49 */ {PVFS_SERV_TREE_GETATTR, &pvfs2_tree_getattr_params},
 #ifdef ENABLE_SECURITY_CERT    
     /* 50 */ {PVFS_SERV_MGMT_GET_USER_CERT, &pvfs2_get_user_cert_params},
-    /* 51 */ {PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, &pvfs2_get_user_cert_keyreq_params}
+    /* 51 */ {PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, &pvfs2_get_user_cert_keyreq_params},
 #else
     /* 50 */ {PVFS_SERV_MGMT_GET_USER_CERT, NULL},
     /* 51 */ {PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, NULL},
 #endif
+    /* 52 */ {PVFS_SERV_DIRDATA_SPLIT, &pvfs2_dirdata_split_params},
+    /* 53 */ {PVFS_SERV_DATAFILE_RECLAIM, &pvfs2_datafile_reclaim_params},
+    /* 54 */ {PVFS_SERV_REMOVE_SUBTREE, &pvfs2_remove_subtree_params},
+    /* 55 */ {PVFS_SERV_TREE_TRUNCATE, &pvfs2_tree_truncate_params},
+    /* 56 */ {PVFS_SERV_UPDATE_SIZE, &pvfs2_update_size_params}
 };
 
 #define CHECK_OP(_op_) assert(_op_ == PINT_server_req_table[_op_].op_type)
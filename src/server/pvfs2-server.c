@@ -46,6 +46,8 @@
 /* #include "pvfs2-internal.h" */
 #include "src/server/request-scheduler/request-scheduler.h"
 #include "pint-event.h"
+#include "pint-req-trace.h"
+#include "block-cache.h"
 #include "pint-util.h"
 #include "client-state-machine.h"
 /* #include "pint-malloc.h" */
@@ -141,6 +143,8 @@ PINT_server_trove_keys_s Trove_Common_Keys[] =
     {DIST_DIR_ATTR_KEYSTR,        DIST_DIR_ATTR_KEYLEN},
     {DIST_DIRDATA_BITMAP_KEYSTR,  DIST_DIRDATA_BITMAP_KEYLEN},
     {DIST_DIRDATA_HANDLES_KEYSTR, DIST_DIRDATA_HANDLES_KEYLEN},
+    {DATAFILE_INLINE_KEYSTR,      DATAFILE_INLINE_KEYLEN},
+    {METAFILE_SIZE_KEYSTR,        METAFILE_SIZE_KEYLEN},
 };
 
 PINT_server_trove_keys_s Trove_Special_Keys[] =
@@ -199,6 +203,9 @@ static int precreate_pool_launch_refiller(const char* host, PVFS_ds_type type,
     PVFS_BMI_addr_t addr, PVFS_fs_id fsid, PVFS_handle pool_handle);
 static int precreate_pool_count(
     PVFS_fs_id fsid, PVFS_handle pool_handle, int* count);
+static int server_setup_internal_dspace(PVFS_fs_id fsid,
+    const char* key_string, PVFS_handle* handle);
+static int datafile_reclaim_initialize(void);
 
 static TROVE_method_id trove_coll_to_method_callback(TROVE_coll_id);
 
@@ -604,6 +611,22 @@ static int server_initialize(
         return ret;
     }
 
+    /* the log writer thread has to be started after we have forked */
+    if (server_config.log_buffer_size > 0)
+    {
+        ret = gossip_enable_async(server_config.log_buffer_size);
+        if (ret < 0)
+        {
+            gossip_err("Warning: failed to enable buffered logging "
+                       "(error %d); logging synchronously.\n", ret);
+        }
+    }
+    ret = gossip_set_rate_limit(server_config.log_rate_limit);
+    if (ret < 0)
+    {
+        gossip_err("Warning: LogRateLimit is not supported.\n");
+    }
+
     /* initialize the security module */
     ret = PINT_security_initialize();
     if (ret < 0)
@@ -812,6 +835,30 @@ static int server_initialize_subsystems(
         *server_status_flag |= SERVER_EVENT_INIT;
     }
 
+    if (server_config.request_trace_entries > 0)
+    {
+        ret = PINT_req_trace_init(server_config.request_trace_entries);
+        if (ret < 0)
+        {
+            gossip_err("Error initializing request trace buffer.\n");
+            return (ret);
+        }
+        *server_status_flag |= SERVER_REQ_TRACE_INIT;
+    }
+
+    if (server_config.data_cache_size_mb > 0)
+    {
+        ret = PINT_bcache_init(
+            (int64_t)server_config.data_cache_size_mb * 1024 * 1024,
+            server_config.data_cache_block_size);
+        if (ret < 0)
+        {
+            gossip_err("Error initializing data block cache.\n");
+            return (ret);
+        }
+        *server_status_flag |= SERVER_BCACHE_INIT;
+    }
+
     /* Initialize distributions */
     ret = PINT_dist_initialize(0);
     if (ret < 0)
@@ -988,6 +1035,24 @@ static int server_initialize_subsystems(
             gossip_err("Error setting directio threads num\n");
         }
 
+        ret = trove_collection_setinfo(cur_fs->coll_id,
+                                       0,
+                                       TROVE_READAHEAD_SIZE,
+                                       (void *)&cur_fs->readahead_size);
+        if (ret < 0)
+        {
+            gossip_err("Error setting readahead size\n");
+        }
+
+        ret = trove_collection_setinfo(cur_fs->coll_id,
+                                       0,
+                                       TROVE_READAHEAD_BUFFERS,
+                                       (void *)&cur_fs->readahead_buffers);
+        if (ret < 0)
+        {
+            gossip_err("Error setting readahead buffers\n");
+        }
+
         ret = trove_collection_lookup(cur_fs->trove_method,
                                       cur_fs->file_system_name,
                                       &(orig_fsid),
@@ -1061,9 +1126,7 @@ static int server_initialize_subsystems(
                 gossip_err("Error setting handle timeout\n");
             }
 
-            if (cur_fs->attr_cache_keywords &&
-                cur_fs->attr_cache_size &&
-                cur_fs->attr_cache_max_num_elems)
+            if (cur_fs->attr_cache_keywords)
             {
                 ret = trove_collection_setinfo(
                                        cur_fs->coll_id,
@@ -1095,6 +1158,16 @@ static int server_initialize_subsystems(
                     gossip_err("Error setting attr cache max num elems\n");
                 }
 
+                ret = trove_collection_setinfo(
+                                       cur_fs->coll_id,
+                                       trove_context, 
+                                       TROVE_COLLECTION_ATTR_CACHE_MEMORY,
+                                       (void *)&cur_fs->attr_cache_memory_mb);
+                if (ret < 0)
+                {
+                    gossip_err("Error setting attr cache memory limit\n");
+                }
+
                 ret = trove_collection_setinfo(
                                        cur_fs->coll_id,
                                        trove_context, 
@@ -1347,6 +1420,15 @@ static int server_initialize_subsystems(
 
     *server_status_flag |= SERVER_PRECREATE_INIT;
 
+    ret = datafile_reclaim_initialize();
+    if (ret < 0)
+    {
+        gossip_err("Error initializing datafile reclaim.\n");
+        return (ret);
+    }
+
+    *server_status_flag |= SERVER_DATAFILE_RECLAIM_INIT;
+
     return ret;
 }
 
@@ -1802,6 +1884,11 @@ static int server_shutdown(PINT_server_status_flag status,
 
     free(s_server_options.server_alias);
 
+    if (status & SERVER_DATAFILE_RECLAIM_INIT)
+    {
+        PINT_datafile_reclaim_finalize();
+    }
+
     if (status & SERVER_PRECREATE_INIT)
     {
         gossip_debug(GOSSIP_SERVER_DEBUG, "[+] halting precreate pool "
@@ -1838,6 +1925,24 @@ static int server_shutdown(PINT_server_status_flag status,
                      "profiling interface [ stopped ]\n");
     }
 
+    if (status & SERVER_REQ_TRACE_INIT)
+    {
+        gossip_debug(GOSSIP_SERVER_DEBUG, "[+] halting request "
+                     "trace buffer      [   ...   ]\n");
+        PINT_req_trace_finalize();
+        gossip_debug(GOSSIP_SERVER_DEBUG, "[-]         request "
+                     "trace buffer      [ stopped ]\n");
+    }
+
+    if (status & SERVER_BCACHE_INIT)
+    {
+        gossip_debug(GOSSIP_SERVER_DEBUG, "[+] halting data "
+                     "block cache         [   ...   ]\n");
+        PINT_bcache_finalize();
+        gossip_debug(GOSSIP_SERVER_DEBUG, "[-]         data "
+                     "block cache         [ stopped ]\n");
+    }
+
     if (status & SERVER_REQ_SCHED_INIT)
     {
         gossip_debug(GOSSIP_SERVER_DEBUG, "[+] halting request "
@@ -1997,6 +2102,7 @@ static int server_shutdown(PINT_server_status_flag status,
     {
         gossip_debug(GOSSIP_SERVER_DEBUG,
                      "[*] halting logging interface\n");
+        gossip_disable_async();
         gossip_disable();
     }
 
@@ -2357,6 +2463,8 @@ int server_state_machine_start(
     gossip_debug(GOSSIP_SERVER_DEBUG,
             "server_state_machine_start %p\n",smcb);
 
+    s_op->trace_start_us = PINT_REQ_TRACE_START();
+
     ret = PINT_decode(s_op->unexp_bmi_buff.buffer,
                       PINT_DECODE_REQ,
                       &s_op->decoded,
@@ -2393,6 +2501,9 @@ int server_state_machine_start(
                       PVFS_HINT_OP_ID_NAME,    
                       sizeof(uint32_t),
                       &s_op->req->op);
+
+        PINT_REQ_TRACE_END(PVFS_EVENT_TRACE_UNEXP, s_op->req->hints,
+                           s_op->trace_start_us);
     }
     else
     {
@@ -2582,6 +2693,8 @@ int server_state_machine_complete(PINT_smcb *smcb)
                        NULL,
                        s_op->event_id,
                        0);
+        PINT_REQ_TRACE_END(PVFS_EVENT_TRACE_REQUEST, s_op->req->hints,
+                           s_op->trace_start_us);
     }
 
     /* release the decoding of the unexpected request */
@@ -3006,12 +3119,80 @@ static int precreate_pool_initialize(int server_index)
 
 /* precreate_pool_finalize()
  *
- * shuts down infrastructure for managing pools of precreated handles
+ * shuts down infrastructure for managing pools of precreated handles.
+ * Handles that were claimed into memory but never handed out are written
+ * back to their pools so that they are not stranded.
  */
 static void precreate_pool_finalize(void)
 {
-    /* TODO: anything to do here? */
+    PVFS_fs_id fsid;
+    PVFS_handle pool_handle;
+    PVFS_handle* handle_array = NULL;
+    PVFS_ds_keyval* key_array = NULL;
+    job_status_s js;
+    job_id_t job_id;
+    int outcount;
+    int count = 0;
+    int ret;
+    int i;
+
     /* TODO: maybe try to stop pending refiller sms? */
+    while((ret = job_precreate_pool_drain_cache(
+               &fsid, &pool_handle, &handle_array, &count)) == 1)
+    {
+        key_array = calloc(count, sizeof(*key_array));
+        if(!key_array)
+        {
+            ret = -PVFS_ENOMEM;
+        }
+        else
+        {
+            for(i = 0; i < count; i++)
+            {
+                key_array[i].buffer = &handle_array[i];
+                key_array[i].buffer_sz = sizeof(PVFS_handle);
+            }
+
+            ret = job_trove_keyval_write_list(
+                fsid, pool_handle, key_array, NULL, count,
+                (TROVE_BINARY_KEY | TROVE_NOOVERWRITE |
+                 TROVE_KEYVAL_HANDLE_COUNT | TROVE_SYNC),
+                NULL, NULL, 0, &js, &job_id, server_job_context, NULL);
+            while(ret == 0)
+            {
+                ret = job_test(job_id, &outcount, NULL, &js,
+                               PVFS2_SERVER_DEFAULT_TIMEOUT_MS,
+                               server_job_context);
+            }
+            if(ret == 1)
+            {
+                ret = js.error_code;
+            }
+        }
+
+        if(ret < 0)
+        {
+            gossip_err("Error: unable to return %d cached handles to "
+                       "precreate pool %llu.\n", count, llu(pool_handle));
+            gossip_err("Warning: fsck may be needed to recover stranded "
+                       "handles.\n");
+        }
+        else
+        {
+            gossip_debug(GOSSIP_SERVER_DEBUG, "Returned %d cached handles "
+                         "to precreate pool %llu.\n", count,
+                         llu(pool_handle));
+        }
+
+        free(key_array);
+        free(handle_array);
+        key_array = NULL;
+        handle_array = NULL;
+    }
+    if(ret < 0)
+    {
+        gossip_err("Error: unable to drain precreate pool caches.\n");
+    }
     return;
 }
 
@@ -3029,14 +3210,9 @@ static void precreate_pool_finalize(void)
 static int precreate_pool_setup_server(const char* host, PVFS_ds_type type, 
     PVFS_fs_id fsid, PVFS_handle* pool_handle)
 {
-    job_status_s js;
-    job_id_t job_id;
     int ret;
-    int outcount;
-    PVFS_handle_extent_array ext_array;
-
-    PVFS_ds_keyval key;
-    PVFS_ds_keyval val;
+    char *key_string;
+    int key_len;
 
     /* look for the pool handle for this server */
 
@@ -3049,19 +3225,52 @@ static int precreate_pool_setup_server(const char* host, PVFS_ds_type type,
     char type_string[11] = { 0 }; /* 32 bit type only needs 10 digits */
     snprintf(type_string, 11, "%u", type);
 
-    key.buffer_sz = strlen(host) + strlen(type_string) + 
-                    strlen("precreate-pool-") + 2;
-    key.buffer = malloc(key.buffer_sz);
-    if(!key.buffer)
+    key_len = strlen(host) + strlen(type_string) + 
+              strlen("precreate-pool-") + 2;
+    key_string = malloc(key_len);
+    if(!key_string)
     {
         return(-ENOMEM);
     }
-    snprintf((char*)key.buffer, key.buffer_sz, "precreate-pool-%s-%s", 
+    snprintf(key_string, key_len, "precreate-pool-%s-%s", 
              host, type_string);
+
+    ret = server_setup_internal_dspace(fsid, key_string, pool_handle);
+    free(key_string);
+    return(ret);
+}
+
+/* server_setup_internal_dspace()
+ *
+ * makes sure that an internal dspace, recorded under the given collection
+ * eattr key, exists on this server for the specified file system, creating
+ * it if necessary.  Used for the persistent precreate pools and datafile
+ * reclaim queues.
+ *
+ *  fsid: fsid of the filesystem the dspace is associated with
+ *  key_string: name of the collection eattr that refers to the dspace
+ *  handle: out value of the handle of the dspace
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int server_setup_internal_dspace(PVFS_fs_id fsid,
+    const char* key_string, PVFS_handle* handle)
+{
+    job_status_s js;
+    job_id_t job_id;
+    int ret;
+    int outcount;
+    PVFS_handle_extent_array ext_array;
+
+    PVFS_ds_keyval key;
+    PVFS_ds_keyval val;
+
+    key.buffer = (char*)key_string;
+    key.buffer_sz = strlen(key_string) + 1;
     key.read_sz = 0;
 
-    val.buffer = pool_handle;
-    val.buffer_sz = sizeof(*pool_handle);
+    val.buffer = handle;
+    val.buffer_sz = sizeof(*handle);
     val.read_sz = 0;
 
     ret = job_trove_fs_geteattr(fsid, &key, &val, 0, NULL, 0, &js, 
@@ -3073,21 +3282,19 @@ static int precreate_pool_setup_server(const char* host, PVFS_ds_type type,
     }
     if(ret < 0)
     {
-        gossip_err("Error: precreate_pool failed to read fs eattrs.\n");
-        free(key.buffer);
+        gossip_err("Error: %s: failed to read fs eattrs.\n", key_string);
         return(ret);
     }
     if(js.error_code && js.error_code != -TROVE_ENOENT)
     {
-        gossip_err("Error: precreate_pool failed to read fs eattrs.\n");
-        free(key.buffer);
+        gossip_err("Error: %s: failed to read fs eattrs.\n", key_string);
         return(js.error_code);
     }
     else if(js.error_code == -TROVE_ENOENT)
     {
         /* handle doesn't exist yet; let's create it */
-        gossip_debug(GOSSIP_SERVER_DEBUG, "precreate_pool didn't find handle "
-                     "for %s, type %s; creating now.\n", host, type_string);
+        gossip_debug(GOSSIP_SERVER_DEBUG, "%s: didn't find handle; "
+                     "creating now.\n", key_string);
 
         /* find extent array for ourselves */
         ret = PINT_cached_config_get_server(
@@ -3095,11 +3302,10 @@ static int precreate_pool_setup_server(const char* host, PVFS_ds_type type,
         if(ret < 0)
         {
             gossip_err("Error: PINT_cached_config_get_meta() failure.\n");
-            free(key.buffer);
             return(ret);
         }
 
-        /* create a trove object for the pool */
+        /* create a trove object for the dspace */
         ret = job_trove_dspace_create(fsid, &ext_array, PVFS_TYPE_INTERNAL,
             NULL, TROVE_SYNC, NULL, 0, &js, &job_id, server_job_context, NULL);
         while(ret == 0)
@@ -3109,14 +3315,13 @@ static int precreate_pool_setup_server(const char* host, PVFS_ds_type type,
         }
         if(ret < 0 || js.error_code)
         {
-            gossip_err("Error: precreate_pool failed to create pool.\n");
-            free(key.buffer);
+            gossip_err("Error: %s: failed to create dspace.\n", key_string);
             return(ret < 0 ? ret : js.error_code);
         }
 
-        *pool_handle = js.handle;
+        *handle = js.handle;
 
-        /* store reference to pool handle as collection eattr */
+        /* store reference to the handle as collection eattr */
         ret = job_trove_fs_seteattr(fsid, &key, &val, TROVE_SYNC, NULL, 0, &js, 
             &job_id, server_job_context, NULL);
         while(ret == 0)
@@ -3126,24 +3331,80 @@ static int precreate_pool_setup_server(const char* host, PVFS_ds_type type,
         }
         if(ret < 0 || js.error_code)
         {
-            gossip_err("Error: failed to record precreate pool handle.\n");
+            gossip_err("Error: %s: failed to record dspace handle.\n",
+                       key_string);
             gossip_err("Warning: fsck may be needed to recover lost handle.\n");
-            free(key.buffer);
             return(ret < 0 ? ret : js.error_code);
         }
-        gossip_debug(GOSSIP_SERVER_DEBUG, "precreate_pool created handle %llu "
-                     "for %s, type %s.\n", llu(*pool_handle), host, 
-                     type_string);
-
+        gossip_debug(GOSSIP_SERVER_DEBUG, "%s: created handle %llu.\n",
+                     key_string, llu(*handle));
     }
     else
     {
         /* handle already exists */
-        gossip_debug(GOSSIP_SERVER_DEBUG, "precreate_pool found handle %llu "
-                     "for %s, type %s.\n", llu(*pool_handle), host, 
-                     type_string);
+        gossip_debug(GOSSIP_SERVER_DEBUG, "%s: found handle %llu.\n",
+                     key_string, llu(*handle));
+    }
+    return(0);
+}
+
+/* datafile_reclaim_initialize()
+ *
+ * sets up a persistent datafile reclaim queue, and the state machine that
+ * drains it, for each file system on which this server is a metadata
+ * server and asynchronous datafile removal is enabled
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int datafile_reclaim_initialize(void)
+{
+    PINT_llist *cur_f = server_config.file_systems;
+    struct filesystem_configuration_s *cur_fs;
+    PVFS_handle queue_handle;
+    int server_type;
+    int ret;
+
+    for(; cur_f; cur_f = PINT_llist_next(cur_f))
+    {
+        cur_fs = PINT_llist_head(cur_f);
+        if(!cur_fs)
+        {
+            break;
+        }
+        if(!cur_fs->async_datafile_removal)
+        {
+            continue;
+        }
+
+        ret = PINT_cached_config_check_type(
+            cur_fs->coll_id, server_config.host_id, &server_type);
+        if(ret < 0)
+        {
+            return(ret);
+        }
+        if(!(server_type & PINT_SERVER_TYPE_META))
+        {
+            continue;
+        }
+
+        ret = server_setup_internal_dspace(cur_fs->coll_id,
+            "datafile-reclaim-queue", &queue_handle);
+        if(ret < 0)
+        {
+            gossip_err("Error: failed to setup datafile reclaim queue "
+                       "for fsid %d\n", (int)cur_fs->coll_id);
+            return(ret);
+        }
+
+        ret = PINT_datafile_reclaim_launch(cur_fs->coll_id, queue_handle,
+            cur_fs->datafile_reclaim_batch_size);
+        if(ret < 0)
+        {
+            gossip_err("Error: failed to launch datafile reclaim for "
+                       "fsid %d\n", (int)cur_fs->coll_id);
+            return(ret);
+        }
     }
-    free(key.buffer);
     return(0);
 }
 
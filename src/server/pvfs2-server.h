@@ -106,8 +106,9 @@ enum
     NUM_DFILES_REQ_KEY       = 6,       
     DIST_DIR_ATTR_KEY        = 7,
     DIST_DIRDATA_BITMAP_KEY  = 8,
-    DIST_DIRDATA_HANDLES_KEY = 9
-
+    DIST_DIRDATA_HANDLES_KEY = 9,
+    DATAFILE_INLINE_KEY      = 10,
+    METAFILE_SIZE_KEY        = 11
 };
 
 /* This is defined in src/server/get-attr.sm
@@ -159,7 +160,10 @@ typedef enum
     SERVER_SECURITY_INIT       = (1 << 20),
     SERVER_CAPCACHE_INIT       = (1 << 21),
     SERVER_CREDCACHE_INIT      = (1 << 22),
-    SERVER_CERTCACHE_INIT      = (1 << 23)
+    SERVER_CERTCACHE_INIT      = (1 << 23),
+    SERVER_REQ_TRACE_INIT      = (1 << 24),
+    SERVER_BCACHE_INIT         = (1 << 25),
+    SERVER_DATAFILE_RECLAIM_INIT = (1 << 26)
 } PINT_server_status_flag;
 
 typedef enum
@@ -365,6 +369,8 @@ struct PINT_server_readdir_op
     PVFS_handle dirent_handle;  /* holds handle of dirdata dspace from
                                    which entries are read */
     PVFS_size dirdata_size;
+    PVFS_ds_position token;     /* where the next iterate starts */
+    int dirent_count;           /* entries in the response so far */
 };
 
 typedef struct
@@ -390,26 +396,60 @@ struct PINT_server_crdirent_op
     PVFS_object_attr metahandle_attr;
     PVFS_ds_attributes dirdata_ds_attr;
     PVFS_ds_attributes metahandle_ds_attr;
+};
+
+/* background split of a dirdata bucket, see dirdata-split.sm */
+struct PINT_server_dirdata_split_op
+{
+    PVFS_fs_id fs_id;
+    PVFS_handle dirdata_handle;
+    PVFS_handle parent_handle;
+    PVFS_credential credential;
+    PVFS_capability capability;
+    int phase;
+    int locked;     /* holding the scheduler on dirdata_handle */
+    int catch_up_rounds;
 
-    /* index of node to receive directory entries when a split is necessary. */
+    /* index of node to receive directory entries */
     int split_node;
 
-    /* Save the old directory attrs in case we have to back out due to an error. */
+    /* attrs before the split; s_op->attr holds the attrs after it */
     PVFS_object_attr saved_attr;
 
-    /* variables used for sending mgmt_split_dirent request */
-    PVFS_BMI_addr_t svr_addr; /*destination server address*/
-    PVFS_error *split_status; /*status from PVFS_SERV_MGMT_SPLIT_DIRENT*/
-    PINT_dist *dist; /*distribution structure for basic_dist*/
-    int read_all_directory_entries;
+    /* current batch of directory entries */
+    PVFS_ds_position pos;
+    PVFS_dirent *dirents;
+    PVFS_ds_keyval *entries_key_a;
+    PVFS_ds_keyval *entries_val_a;
+
+    /* entries to send to the split node */
     int nentries;
     PVFS_handle *entry_handles;
     char **entry_names;
     int num_msgs_required;
     split_msg_boundary *msg_boundaries;
-    PVFS_ds_keyval *entries_key_a;
-    PVFS_ds_keyval *entries_val_a;
+    PVFS_error *split_status; /*status from PVFS_SERV_MGMT_SPLIT_DIRENT*/
+    PINT_dist *dist; /*distribution structure for basic_dist*/
+
+    /* entries to remove from dirdata_handle */
+    int nremove;
+    PVFS_handle *remove_handles;
+    char **remove_names;
+
+    /* names changed during the copy, replayed in catch-up rounds */
+    char **dirty_names;
+    int dirty_count;
+    PVFS_handle *catch_up_handles;
+    int catch_up_sent;
+
     PVFS_handle *remote_dirdata_handles;
+
+    /* dirdata objects added when the directory grows */
+    int grown;
+    int grow_count;
+    const char **grow_servers;
+    PVFS_handle *grow_handles;
+    PVFS_ds_attributes ds_attr;
 };
 
 struct PINT_server_setattr_op
@@ -442,6 +482,9 @@ struct PINT_server_remove_op
 {
     PVFS_handle handle;
     PVFS_fs_id fs_id;
+    PVFS_handle *datafile_handles;  /* datafiles of a metafile being
+                                     * handed to the reclaim queue */
+    PVFS_ds_keyval *reclaim_key_a;
     PVFS_handle dirdata_handle;   /* holds dirdata dspace handle in
                                    * the event that we are removing a
                                    * directory */
@@ -486,6 +529,97 @@ struct PINT_server_precreate_pool_refiller_op
     PVFS_capability capability;
 };
 
+/* background removal of queued datafiles, see datafile-reclaim.sm */
+struct PINT_server_datafile_reclaim_group
+{
+    PVFS_BMI_addr_t addr;
+    int start;      /* first entry in remote_handles */
+    int count;
+    PVFS_error status;
+};
+
+struct PINT_server_datafile_reclaim_op
+{
+    PVFS_fs_id fs_id;
+    PVFS_handle queue_handle;
+    int batch_size;
+
+    /* current batch, read from the front of the queue */
+    int count;
+    PVFS_handle *handles;
+    PVFS_ds_keyval *key_a;
+    PVFS_ds_keyval *val_a;
+    PVFS_error *error_a;
+    int failed;
+
+    /* handles stored on this server */
+    int local_count;
+    PVFS_handle *local_handles;
+    PVFS_error *local_errors;
+
+    /* handles stored elsewhere, grouped by server; remote_group[i] is the
+     * group of handles[i], -1 if it is local and -2 if unmapped */
+    int remote_count;
+    PVFS_handle *remote_handles;
+    int *remote_group;
+    int group_count;
+    struct PINT_server_datafile_reclaim_group *groups;
+};
+
+/* server-coordinated removal of a directory tree, see remove-subtree.sm */
+struct PINT_server_remove_subtree_group
+{
+    PVFS_BMI_addr_t addr;
+    int start;      /* first entry in the order array */
+    int count;
+    PVFS_error status;      /* batch remove result */
+};
+
+struct PINT_server_remove_subtree_entry
+{
+    PVFS_ds_type type;
+    PVFS_BMI_addr_t addr;
+    int dfile_count;
+    PVFS_handle *dfile_array;
+    uint32_t removed;       /* objects removed below a subdirectory */
+    int complete;           /* the subdirectory is empty */
+    PVFS_error error;
+    int done;               /* the object is gone, its dirent can go */
+};
+
+struct PINT_server_remove_subtree_op
+{
+    uint32_t budget;        /* objects this request may still remove */
+    uint32_t removed;
+    int complete;
+    PVFS_error error;       /* first failure, returned once a batch ends */
+    PVFS_capability capability;
+    PVFS_hint hints;
+    int msg_count;          /* messages posted in the current round */
+
+    /* directory: its dirdata objects */
+    PVFS_dist_dir_attr dist_dir_attr;
+    PVFS_handle *dirdata_handles;
+    void *acl_buf;
+
+    /* dirdata object: the current batch of entries */
+    int count;
+    int requested;
+    PVFS_dirent *dirents;
+    PVFS_ds_keyval *key_a;
+    PVFS_ds_keyval *val_a;
+    PVFS_error *error_a;
+    struct PINT_server_remove_subtree_entry *entries;
+
+    /* per-server groups of the current round; order[] holds entry (or
+     * datafile) indices group by group */
+    int group_count;
+    struct PINT_server_remove_subtree_group *groups;
+    int *order;
+    PVFS_handle *handles;
+    int *owner;             /* entry owning each datafile in handles */
+};
+
 struct PINT_server_batch_create_op
 {
     int saved_error_code;
@@ -512,6 +646,7 @@ struct PINT_server_getconfig_op
 struct PINT_server_io_op
 {
     flow_descriptor* flow_d;
+    PVFS_error flow_error;     /* status of the flow */
 };
 
 struct PINT_server_small_io_op
@@ -519,6 +654,61 @@ struct PINT_server_small_io_op
     PVFS_offset offsets[IO_MAX_REGIONS];
     PVFS_size sizes[IO_MAX_REGIONS];
     PVFS_size result_bytes;
+    int segs;
+    uint32_t bcache_gen;       /* block cache generation for the fill */
+    struct PINT_server_op *inline_op; /* inline data of the datafile */
+};
+
+/* what pvfs2_inline_data_work_sm does with the inline data of a datafile */
+enum PINT_inline_data_action
+{
+    INLINE_DATA_LOAD = 1,    /* read it, if present */
+    INLINE_DATA_MIGRATE = 2, /* move it to the bstream, if present */
+    INLINE_DATA_STORE = 3,   /* replace it and set the datafile size */
+};
+
+struct PINT_server_inline_data_op
+{
+    PVFS_fs_id fs_id;
+    PVFS_handle handle;        /* datafile the data belongs to */
+    enum PINT_inline_data_action action;
+    int loaded;                /* buffer reflects what is on disk */
+    int present;               /* the datafile holds inline data */
+    char *buffer;              /* PVFS_REQ_LIMIT_INLINE_DATA bytes */
+    PVFS_size size;            /* bytes of data in buffer */
+    PVFS_ds_attributes ds_attr; /* datafile attributes, for STORE */
+    PVFS_offset write_offset;
+    PVFS_size write_size;
+    int migrating;             /* holds the migration of the datafile */
+    struct qlist_head migrate_link;
+};
+
+/* value of METAFILE_SIZE_KEY */
+struct PINT_cached_size
+{
+    PVFS_size size;            /* logical file size, -1 if unknown */
+    uint32_t version;          /* changes with every update */
+    uint32_t pad;
+};
+
+struct PINT_server_update_size_op
+{
+    struct PINT_cached_size cached;
+};
+
+/* tells the metadata server that a write grew a datafile, see
+ * pvfs2_size_notify_work_sm */
+struct PINT_server_size_notify_op
+{
+    PVFS_fs_id fs_id;
+    PVFS_handle handle;        /* datafile that was written */
+    PVFS_handle metafile_handle;
+    PVFS_size old_size;        /* datafile size before the write */
+    PINT_dist *dist;
+    uint32_t server_nr;
+    uint32_t server_ct;
+    PVFS_ds_attributes ds_attr;
+    PVFS_error error;          /* status of the write, else of the update */
 };
 
 struct PINT_server_flush_op
@@ -531,6 +721,8 @@ struct PINT_server_truncate_op
 {
     PVFS_handle handle;        /* handle of datafile we resize */
     PVFS_offset size;        /* new size of datafile */
+    struct PINT_server_op *inline_op; /* inline data of the datafile */
+    PVFS_error saved_error_code;
 };
 
 struct PINT_server_mkdir_op
@@ -569,6 +761,7 @@ struct PINT_server_getattr_op
     int num_dfiles_req;
     PVFS_handle *mirror_dfile_status_array;
     PVFS_credential credential;
+    struct PINT_cached_size cached_size;
 };
 
 struct PINT_server_listattr_op
@@ -598,6 +791,7 @@ struct PINT_server_tree_communicate_op
     int num_partitions;
     PVFS_handle* handle_array_local; 
     PVFS_handle* handle_array_remote; 
+    PVFS_size *size_array_remote; /* tree_truncate only */
     uint32_t *local_join_size;
     uint32_t *remote_join_size;
     int handle_array_local_count;
@@ -645,6 +839,8 @@ typedef struct PINT_server_op
     /* variables used for monitoring and timing requests */
     PINT_event_id event_id;
     struct timespec start_time;     /* start time of a timer in ns */
+    PVFS_time trace_start_us;       /* request trace span start times */
+    PVFS_time trace_resp_us;
 
     /* holds id from request scheduler so we can release it later */
     job_id_t scheduled_id; 
@@ -708,6 +904,7 @@ typedef struct PINT_server_op
         struct PINT_server_getconfig_op getconfig;
         struct PINT_server_lookup_op lookup;
         struct PINT_server_crdirent_op crdirent;
+        struct PINT_server_dirdata_split_op dirdata_split;
         struct PINT_server_setattr_op setattr;
         struct PINT_server_readdir_op readdir;
         struct PINT_server_remove_op remove;
@@ -715,6 +912,9 @@ typedef struct PINT_server_op
         struct PINT_server_rmdirent_op rmdirent;
         struct PINT_server_io_op io;
         struct PINT_server_small_io_op small_io;
+        struct PINT_server_inline_data_op inline_data;
+        struct PINT_server_update_size_op update_size;
+        struct PINT_server_size_notify_op size_notify;
         struct PINT_server_flush_op flush;
         struct PINT_server_truncate_op truncate;
         struct PINT_server_mkdir_op mkdir;
@@ -724,6 +924,8 @@ typedef struct PINT_server_op
                                                precreate_pool_refiller;
         struct PINT_server_batch_create_op batch_create;
         struct PINT_server_batch_remove_op batch_remove;
+        struct PINT_server_datafile_reclaim_op datafile_reclaim;
+        struct PINT_server_remove_subtree_op remove_subtree;
         struct PINT_server_unstuff_op unstuff;
         struct PINT_server_create_copies_op create_copies;
         struct PINT_server_mirror_op mirror;
@@ -895,6 +1097,7 @@ extern struct PINT_state_machine_s pvfs2_mirror_sm;
 extern struct PINT_state_machine_s pvfs2_pjmp_call_msgpairarray_sm;
 extern struct PINT_state_machine_s pvfs2_pjmp_get_attr_sm;
 extern struct PINT_state_machine_s pvfs2_pjmp_remove_work_sm;
+extern struct PINT_state_machine_s pvfs2_pjmp_truncate_work_sm;
 extern struct PINT_state_machine_s pvfs2_pjmp_mirror_work_sm;
 extern struct PINT_state_machine_s pvfs2_pjmp_create_immutable_copies_sm;
 extern struct PINT_state_machine_s pvfs2_pjmp_get_attr_work_sm;
@@ -912,23 +1115,50 @@ extern struct PINT_state_machine_s pvfs2_final_response_sm;
 extern struct PINT_state_machine_s pvfs2_check_entry_not_exist_sm;
 extern struct PINT_state_machine_s pvfs2_remove_work_sm;
 extern struct PINT_state_machine_s pvfs2_remove_with_prelude_sm;
+extern struct PINT_state_machine_s pvfs2_truncate_work_sm;
+extern struct PINT_state_machine_s pvfs2_truncate_with_prelude_sm;
 extern struct PINT_state_machine_s pvfs2_mkdir_work_sm;
 extern struct PINT_state_machine_s pvfs2_crdirent_work_sm;
 extern struct PINT_state_machine_s pvfs2_unexpected_sm;
 extern struct PINT_state_machine_s pvfs2_create_immutable_copies_sm;
 extern struct PINT_state_machine_s pvfs2_mirror_work_sm;
 extern struct PINT_state_machine_s pvfs2_tree_remove_work_sm;
+extern struct PINT_state_machine_s pvfs2_tree_truncate_work_sm;
 extern struct PINT_state_machine_s pvfs2_tree_get_file_size_work_sm;
 extern struct PINT_state_machine_s pvfs2_tree_getattr_work_sm;
 extern struct PINT_state_machine_s pvfs2_tree_setattr_work_sm;
 extern struct PINT_state_machine_s pvfs2_call_msgpairarray_sm;
+extern struct PINT_state_machine_s pvfs2_inline_data_work_sm;
+extern struct PINT_state_machine_s pvfs2_size_notify_work_sm;
 
 extern void tree_getattr_free(PINT_server_op *s_op);
 extern void tree_setattr_free(PINT_server_op *s_op);
 extern void tree_remove_free(PINT_server_op *s_op);
+extern void tree_truncate_free(PINT_server_op *s_op);
 extern void mkdir_free(struct PINT_server_op *s_op);
 extern void getattr_free(struct PINT_server_op *s_op);
 
+/* inline data of tiny files, defined in src/server/inline-data.sm */
+int inline_data_limit(PVFS_fs_id fs_id);
+struct PINT_server_op *inline_data_alloc(struct PINT_server_op *s_op,
+                                         PVFS_fs_id fs_id,
+                                         PVFS_handle handle);
+void inline_data_free(struct PINT_server_op *inline_op);
+
+/* cached size of striped files, defined in src/server/update-size.sm */
+int size_notify_push(struct PINT_smcb *smcb,
+                     struct PINT_server_op *s_op,
+                     PVFS_fs_id fs_id,
+                     PVFS_handle handle,
+                     PVFS_handle metafile_handle,
+                     PVFS_size old_size,
+                     PINT_dist *dist,
+                     uint32_t server_nr,
+                     uint32_t server_ct,
+                     PVFS_error error);
+PVFS_error size_notify_pop(struct PINT_smcb *smcb);
+void size_notify_forget(PVFS_fs_id fs_id, PVFS_handle handle);
+
 /* Exported Prototypes */
 int server_perf_start_rollover(struct PINT_perf_counter *pc,
                                struct PINT_perf_counter *tpc);
@@ -958,6 +1188,24 @@ int server_state_machine_start_noreq(
     struct PINT_smcb *new_op);
 int server_state_machine_complete_noreq(PINT_smcb *smcb);
 
+int PINT_datafile_reclaim_launch(PVFS_fs_id fs_id, PVFS_handle queue_handle,
+                                 int batch_size);
+int PINT_datafile_reclaim_queue(PVFS_fs_id fs_id, PVFS_handle *queue_handle);
+void PINT_datafile_reclaim_finalize(void);
+
+int PINT_dirdata_split_launch(PVFS_fs_id fs_id,
+                              PVFS_handle dirdata_handle,
+                              PVFS_handle parent_handle,
+                              const PVFS_credential *credential,
+                              const PVFS_object_attr *attr);
+void PINT_dirdata_split_note_entry(PVFS_fs_id fs_id,
+                                   PVFS_handle dirdata_handle,
+                                   const char *name);
+int PINT_dirdata_split_filter_dirents(PVFS_fs_id fs_id,
+                                      PVFS_handle dirdata_handle,
+                                      PVFS_dirent *dirent_array,
+                                      int count);
+
 /* INCLUDE STATE-MACHINE.H DOWN HERE */
 #if 0
 #define PINT_OP_STATE       PINT_server_op
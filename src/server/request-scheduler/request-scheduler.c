@@ -522,14 +522,38 @@ int PINT_req_sched_post(enum PVFS_server_op op,
             /* possible dirent optimization: see if all scheduled ops for this
              * handle are for crdirent or rmdirent.  
              * If so, we can allow another concurrent
-             * dirent request to proceed.
+             * dirent request to proceed.  Read only requests do not
+             * conflict either, but any other modifying request (such as
+             * a dirdata split holding the bucket) must run alone.
              */
-            tmp_element->state = REQ_SCHEDULED;
-            tmp_element->access_type = PINT_SERVER_REQ_READONLY;
-            gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
-                         "concurrent dirent op, handle: %llu\n", 
-                         llu(handle));
-            ret = 1;
+            tmp_flag = 0;
+            qlist_for_each(iterator, &tmp_list->req_list)
+            {
+                tmp_element2 = qlist_entry(iterator, struct req_sched_element,
+                    list_link);
+                if(tmp_element2->op != PVFS_SERV_CRDIRENT &&
+                   tmp_element2->op != PVFS_SERV_RMDIRENT &&
+                   tmp_element2->access_type != PINT_SERVER_REQ_READONLY)
+                {
+                    tmp_flag = 1;
+                    break;
+                }
+            }
+
+            if(!tmp_flag)
+            {
+                tmp_element->state = REQ_SCHEDULED;
+                tmp_element->access_type = PINT_SERVER_REQ_READONLY;
+                gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
+                             "concurrent dirent op, handle: %llu\n",
+                             llu(handle));
+                ret = 1;
+            }
+            else
+            {
+                tmp_element->state = REQ_QUEUED;
+                ret = 0;
+            }
         }
 	else
 	{
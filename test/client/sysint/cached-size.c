@@ -0,0 +1,429 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Checks that the size reported for a striped file, which usually comes
+ * from the size cached on its metafile, matches the size implied by its
+ * datafiles after extending writes, after a write that failed half way
+ * and after truncates.
+ *
+ * The failed write is done by a copy of this program, with a buffer that
+ * becomes inaccessible half way.  Needs a file system with at least two
+ * I/O servers.
+ */
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "client.h"
+#include "pvfs2-util.h"
+#include "pvfs2-mgmt.h"
+#include "pvfs2-internal.h"
+
+#define DFILE_COUNT 2
+#define CHILD_WRITE_SIZE (8 * 1024 * 1024)
+
+static PVFS_credential creds;
+static PVFS_object_ref file_ref;
+static PVFS_handle dfiles[DFILE_COUNT];
+static PVFS_size strip_size;
+static PVFS_size model_size;
+
+static int write_at(PVFS_offset offset, PVFS_size len)
+{
+    PVFS_Request mem_req;
+    PVFS_sysresp_io resp_io;
+    char *buf;
+    int ret;
+
+    buf = malloc(len);
+    if (!buf)
+    {
+        return -PVFS_ENOMEM;
+    }
+    memset(buf, 'a' + (offset % 26), len);
+
+    ret = PVFS_Request_contiguous(len, PVFS_BYTE, &mem_req);
+    if (ret == 0)
+    {
+        ret = PVFS_sys_write(file_ref, PVFS_BYTE, offset, buf, mem_req,
+                             &creds, &resp_io, NULL);
+        PVFS_Request_free(&mem_req);
+    }
+    free(buf);
+    if (ret == 0 && resp_io.total_completed != len)
+    {
+        ret = -PVFS_EIO;
+    }
+    if (ret == 0 && offset + len > model_size)
+    {
+        model_size = offset + len;
+    }
+    return ret;
+}
+
+/* datafile_size()
+ *
+ * size of datafile nr; this waits for any write of the datafile that is
+ * still running on its server
+ */
+static int datafile_size(int nr, PVFS_size *size)
+{
+    PVFS_object_ref ref;
+    PVFS_sysresp_getattr resp;
+    int ret;
+
+    ref.fs_id = file_ref.fs_id;
+    ref.handle = dfiles[nr];
+    memset(&resp, 0, sizeof(resp));
+    ret = PVFS_sys_getattr(ref, PVFS_ATTR_SYS_SIZE, &creds, &resp, NULL);
+    if (ret == 0)
+    {
+        *size = resp.attr.size;
+    }
+    PVFS_util_release_sys_attr(&resp.attr);
+    return ret;
+}
+
+/* real_size()
+ *
+ * logical size implied by the datafiles of the simple_stripe file
+ */
+static int real_size(PVFS_size *size)
+{
+    PVFS_size dsize, strips, logical;
+    int i, ret;
+
+    *size = 0;
+    for (i = 0; i < DFILE_COUNT; i++)
+    {
+        ret = datafile_size(i, &dsize);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        if (dsize == 0)
+        {
+            continue;
+        }
+        strips = (dsize - 1) / strip_size;
+        logical = (strips * DFILE_COUNT + i) * strip_size +
+            (dsize - 1) % strip_size + 1;
+        if (logical > *size)
+        {
+            *size = logical;
+        }
+    }
+    return 0;
+}
+
+static int reported_size(PVFS_size *size)
+{
+    PVFS_sysresp_getattr resp;
+    int ret;
+
+    memset(&resp, 0, sizeof(resp));
+    ret = PVFS_sys_getattr(file_ref, PVFS_ATTR_SYS_ALL_NOHINT, &creds,
+                           &resp, NULL);
+    if (ret == 0)
+    {
+        *size = resp.attr.size;
+    }
+    PVFS_util_release_sys_attr(&resp.attr);
+    return ret;
+}
+
+/* check_size()
+ *
+ * compares the reported size with the real one, and with the expected
+ * one unless that is -1
+ */
+static int check_size(const char *step, PVFS_size expected)
+{
+    PVFS_size real, reported;
+    int ret;
+
+    /* the real size first: it waits for writes still held by servers */
+    ret = real_size(&real);
+    if (ret == 0)
+    {
+        ret = reported_size(&reported);
+    }
+    if (ret < 0)
+    {
+        PVFS_perror("getattr", ret);
+        return -1;
+    }
+    if (reported != real || (expected >= 0 && real != expected))
+    {
+        fprintf(stderr, "CACHED-SIZE: %s: FAILED: reported %lld, "
+                "datafiles %lld, expected %lld\n", step, lld(reported),
+                lld(real), lld(expected));
+        return -1;
+    }
+    printf("CACHED-SIZE: %s: size %lld ok\n", step, lld(reported));
+    return 0;
+}
+
+static int truncate_to(const char *step, PVFS_size size)
+{
+    int ret;
+
+    ret = PVFS_sys_truncate(file_ref, size, &creds, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_truncate", ret);
+        return -1;
+    }
+    model_size = size;
+    return check_size(step, model_size);
+}
+
+/* child_write()
+ *
+ * a write whose buffer ends in inaccessible memory, so that the client
+ * dies or fails once part of the data is on the servers
+ */
+static int child_write(PVFS_fs_id fs_id, const char *handle,
+                       const char *offset)
+{
+    PVFS_Request mem_req;
+    PVFS_sysresp_io resp_io;
+    char *buf;
+
+    file_ref.fs_id = fs_id;
+    file_ref.handle = strtoull(handle, NULL, 10);
+
+    buf = mmap(NULL, 2 * CHILD_WRITE_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+    {
+        return 1;
+    }
+    memset(buf, 'k', CHILD_WRITE_SIZE);
+    mprotect(buf + CHILD_WRITE_SIZE, CHILD_WRITE_SIZE, PROT_NONE);
+
+    /* fail at once, and leave without a word to the servers */
+    PVFS_sys_set_info(PVFS_SYS_MSG_RETRY_LIMIT, 0);
+    PVFS_Request_contiguous(2 * CHILD_WRITE_SIZE, PVFS_BYTE, &mem_req);
+    PVFS_sys_write(file_ref, PVFS_BYTE, strtoll(offset, NULL, 10), buf,
+                   mem_req, &creds, &resp_io, NULL);
+    _exit(0);
+}
+
+/* failed_write()
+ *
+ * runs a write past the end of the file that fails half way in a copy
+ * of this program
+ */
+static int failed_write(const char *prog)
+{
+    char handle[64], offset[64];
+    PVFS_size before, after;
+    pid_t pid;
+    int status;
+
+    if (real_size(&before) < 0)
+    {
+        return -1;
+    }
+
+    snprintf(handle, sizeof(handle), "%llu", llu(file_ref.handle));
+    snprintf(offset, sizeof(offset), "%lld", lld(model_size + 12345));
+
+    pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0)
+    {
+        execl(prog, prog, "--child", handle, offset, (char *)NULL);
+        _exit(1);
+    }
+    waitpid(pid, &status, 0);
+
+    if (check_size("failed write", -1) < 0 || real_size(&after) < 0)
+    {
+        return -1;
+    }
+    if (after <= before)
+    {
+        fprintf(stderr, "CACHED-SIZE: failed write did not grow the "
+                "file\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    PVFS_fs_id fs_id;
+    PVFS_sysresp_lookup resp_lk;
+    PVFS_sysresp_create resp_cr;
+    PVFS_sysresp_getattr resp_ga;
+    PVFS_sys_attr attr;
+    char name[64];
+    int ret, i;
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return -1;
+    }
+    ret = PVFS_util_get_default_fsid(&fs_id);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_get_default_fsid", ret);
+        return -1;
+    }
+    PVFS_util_gen_credential_defaults(&creds);
+
+    if (argc == 4 && strcmp(argv[1], "--child") == 0)
+    {
+        return child_write(fs_id, argv[2], argv[3]);
+    }
+
+    /* every getattr has to go to the servers */
+    PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, 0);
+
+    ret = PVFS_sys_lookup(fs_id, "/", &creds, &resp_lk,
+                          PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_lookup", ret);
+        return -1;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.owner = creds.userid;
+    attr.group = creds.group_array[0];
+    attr.perms = PVFS_U_WRITE | PVFS_U_READ;
+    attr.atime = attr.ctime = attr.mtime = time(NULL);
+    attr.dfile_count = DFILE_COUNT;
+    attr.mask = PVFS_ATTR_SYS_ALL_SETABLE | PVFS_ATTR_SYS_DFILE_COUNT;
+    snprintf(name, sizeof(name), "cached-size.%d", (int)getpid());
+
+    ret = PVFS_sys_create(name, resp_lk.ref, attr, &creds, NULL,
+                          &resp_cr, NULL, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_create", ret);
+        return -1;
+    }
+    file_ref = resp_cr.ref;
+
+    /* new files are stuffed into one datafile until written past their
+     * first strip */
+    ret = write_at(10 * 1024 * 1024, 100);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_write", ret);
+        goto out;
+    }
+
+    memset(&resp_ga, 0, sizeof(resp_ga));
+    ret = PVFS_sys_getattr(file_ref, PVFS_ATTR_SYS_ALL_NOHINT, &creds,
+                           &resp_ga, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_getattr", ret);
+        goto out;
+    }
+    /* simple_stripe reports a whole stripe as the block size */
+    strip_size = resp_ga.attr.blksize / DFILE_COUNT;
+    i = resp_ga.attr.dfile_count;
+    PVFS_util_release_sys_attr(&resp_ga.attr);
+    if (i != DFILE_COUNT)
+    {
+        printf("CACHED-SIZE: needs %d I/O servers, file got %d datafiles; "
+               "skipped\n", DFILE_COUNT, i);
+        ret = 0;
+        goto out;
+    }
+    i = DFILE_COUNT;
+    ret = PVFS_mgmt_get_dfile_array(file_ref, &creds, dfiles, i, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_get_dfile_array", ret);
+        goto out;
+    }
+
+    ret = -1;
+
+    /* extending writes, small and large, each followed by a getattr */
+    for (i = 0; i < 20; i++)
+    {
+        if (write_at(model_size + i * 1000, 3000 + i * 7919) < 0 ||
+            check_size("write then getattr", model_size) < 0)
+        {
+            goto out;
+        }
+    }
+    if (write_at(model_size + 100, 3 * strip_size + 17) < 0 ||
+        check_size("large write", model_size) < 0)
+    {
+        goto out;
+    }
+
+    /* a stream of appends with no getattr in between */
+    for (i = 0; i < 50; i++)
+    {
+        if (write_at(model_size, 4096) < 0)
+        {
+            goto out;
+        }
+    }
+    if (check_size("appends", model_size) < 0)
+    {
+        goto out;
+    }
+
+    if (failed_write(argv[0]) < 0)
+    {
+        goto out;
+    }
+    if (real_size(&model_size) < 0 ||
+        write_at(model_size, 100) < 0 ||
+        check_size("write after failed write", model_size) < 0)
+    {
+        goto out;
+    }
+
+    if (truncate_to("truncate down", strip_size + 5) < 0 ||
+        write_at(100, 10) < 0 ||
+        check_size("write below the end", model_size) < 0 ||
+        truncate_to("truncate up", 5 * strip_size) < 0 ||
+        truncate_to("truncate to zero", 0) < 0 ||
+        write_at(2 * strip_size, 10) < 0 ||
+        check_size("write after truncate", model_size) < 0)
+    {
+        goto out;
+    }
+
+    ret = 0;
+    printf("CACHED-SIZE: all checks passed\n");
+
+out:
+    PVFS_sys_remove(name, resp_lk.ref, &creds, NULL);
+    PVFS_sys_finalize();
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,655 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Grows a distributed directory past its split size while several copies
+ * of this program create and remove entries in it at the same time, so
+ * that creates and removes land on buckets that are being split.  The
+ * workers fill the directory up to just below its split size first; then
+ * the creates of most workers start the split while the others remove
+ * some of those entries, so that the removes race with the split copying
+ * them.  Meanwhile a few readers read the directory in small batches
+ * and must not lose any entry.  Afterwards every entry that was not
+ * removed has to be found exactly once by readdir and lookup, no removed
+ * entry may come back, and the entries have to end up spread over more
+ * than one dirdata object with no copies left behind.
+ *
+ * Needs a file system with at least two metadata servers.
+ */
+
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "client.h"
+#include "pvfs2-util.h"
+#include "pvfs2-mgmt.h"
+#include "pvfs2-internal.h"
+
+#define WORKERS 12
+/* processes that read the directory while the workers run */
+#define READERS 4
+/* workers that start by removing initial entries */
+#define REMOVERS 4
+#define ENTRIES_PER_WORKER 200
+/* large enough for the split to take a while to copy its half */
+#define SPLIT_SIZE 4096
+/* entries the workers create before they start, named as if by worker
+ * WORKERS */
+#define INITIAL_ENTRIES (SPLIT_SIZE - 1)
+/* names of every worker are numbered below this */
+#define MAX_ENTRIES (INITIAL_ENTRIES > ENTRIES_PER_WORKER ? \
+                     INITIAL_ENTRIES : ENTRIES_PER_WORKER)
+#define MAX_DIRDATA 2
+#define READDIR_BATCH 64
+/* smaller than the entries a split leaves behind in the bucket it splits */
+#define SMALL_READDIR_BATCH 5
+#define SETTLE_SECS 30
+
+static PVFS_credential creds;
+static PVFS_object_ref dir_ref;
+
+/* every third entry of a worker is removed again */
+static int is_removed(int entry)
+{
+    return (entry % 3 == 1);
+}
+
+static void entry_name(char *name, int len, int worker, int entry)
+{
+    snprintf(name, len, "w%d.%d", worker, entry);
+}
+
+/* whether entry of worker was created at all */
+static int entry_created(int worker, int entry)
+{
+    return (entry < (worker == WORKERS ? INITIAL_ENTRIES :
+                     ENTRIES_PER_WORKER));
+}
+
+/* whether entry of worker was created and not removed again */
+static int entry_exists(int worker, int entry)
+{
+    return (entry_created(worker, entry) && !is_removed(entry));
+}
+
+static void init_file_attr(PVFS_sys_attr *attr)
+{
+    memset(attr, 0, sizeof(*attr));
+    attr->owner = creds.userid;
+    attr->group = creds.group_array[0];
+    attr->perms = PVFS_U_WRITE | PVFS_U_READ;
+    attr->atime = attr->ctime = attr->mtime = time(NULL);
+    attr->dfile_count = 1;
+    attr->mask = PVFS_ATTR_SYS_ALL_SETABLE | PVFS_ATTR_SYS_DFILE_COUNT;
+}
+
+static int remove_entry(int worker, int entry)
+{
+    char name[64];
+    int ret;
+
+    entry_name(name, sizeof(name), worker, entry);
+    ret = PVFS_sys_remove(name, dir_ref, &creds, NULL);
+    if (ret < 0)
+    {
+        fprintf(stderr, "DIRDATA-SPLIT: remove of %s failed: ", name);
+        PVFS_perror("", ret);
+    }
+    return ret;
+}
+
+static int create_entry(int worker, int entry, PVFS_sys_attr *attr)
+{
+    PVFS_sysresp_create resp_cr;
+    char name[64];
+    int ret;
+
+    entry_name(name, sizeof(name), worker, entry);
+    ret = PVFS_sys_create(name, dir_ref, *attr, &creds, NULL, &resp_cr,
+                          NULL, NULL);
+    if (ret < 0)
+    {
+        fprintf(stderr, "DIRDATA-SPLIT: create of %s failed: ", name);
+        PVFS_perror("", ret);
+    }
+    return ret;
+}
+
+/* worker()
+ *
+ * creates its share of the initial entries and reports on ready_fd; once
+ * start_fd is closed, creates ENTRIES_PER_WORKER files in the directory
+ * and removes some of them again, while the other workers do the same;
+ * the first REMOVERS workers remove their share of the initial entries
+ * first
+ */
+static int worker(PVFS_fs_id fs_id, const char *handle, int nr,
+                  int start_fd, int ready_fd)
+{
+    PVFS_sys_attr attr;
+    char c = 0;
+    int i, initial;
+
+    dir_ref.fs_id = fs_id;
+    dir_ref.handle = strtoull(handle, NULL, 10);
+    init_file_attr(&attr);
+
+    for (initial = nr; initial < INITIAL_ENTRIES; initial += WORKERS)
+    {
+        if (create_entry(WORKERS, initial, &attr) < 0)
+        {
+            return 1;
+        }
+    }
+
+    /* wait for the other workers */
+    if (write(ready_fd, &c, 1) != 1)
+    {
+        return 1;
+    }
+    close(ready_fd);
+    while (read(start_fd, &c, 1) > 0)
+        ;
+
+    if (nr < REMOVERS)
+    {
+        /* the creates of the other workers start the split meanwhile */
+        for (initial = nr; initial < INITIAL_ENTRIES; initial += REMOVERS)
+        {
+            if (is_removed(initial) && remove_entry(WORKERS, initial) < 0)
+            {
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < ENTRIES_PER_WORKER; i++)
+    {
+        if (create_entry(nr, i, &attr) < 0)
+        {
+            return 1;
+        }
+        /* remove an entry created a little earlier */
+        if (i >= 4 && is_removed(i - 4) && remove_entry(nr, i - 4) < 0)
+        {
+            return 1;
+        }
+    }
+    for (i = ENTRIES_PER_WORKER - 4; i < ENTRIES_PER_WORKER; i++)
+    {
+        if (is_removed(i) && remove_entry(nr, i) < 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int expected_count(void)
+{
+    int w, e, count = 0;
+
+    for (w = 0; w <= WORKERS; w++)
+    {
+        for (e = 0; e < MAX_ENTRIES; e++)
+        {
+            count += entry_exists(w, e);
+        }
+    }
+    return count;
+}
+
+/* check_readdir()
+ *
+ * reads the whole directory and checks that it holds exactly the
+ * entries that were not removed
+ */
+static int check_readdir(void)
+{
+    PVFS_sysresp_readdir resp_rd;
+    PVFS_ds_position token = PVFS_READDIR_START;
+    int seen[WORKERS + 1][MAX_ENTRIES];
+    int ret, i, w, e, errors = 0, total = 0;
+
+    memset(seen, 0, sizeof(seen));
+    do
+    {
+        memset(&resp_rd, 0, sizeof(resp_rd));
+        ret = PVFS_sys_readdir(dir_ref, token, READDIR_BATCH, &creds,
+                               &resp_rd, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_readdir", ret);
+            return -1;
+        }
+        for (i = 0; i < resp_rd.pvfs_dirent_outcount; i++)
+        {
+            if (sscanf(resp_rd.dirent_array[i].d_name, "w%d.%d", &w, &e)
+                != 2 || w < 0 || w > WORKERS || e < 0 ||
+                e >= MAX_ENTRIES)
+            {
+                printf("DIRDATA-SPLIT: unexpected entry %s\n",
+                       resp_rd.dirent_array[i].d_name);
+                errors++;
+                continue;
+            }
+            seen[w][e]++;
+            total++;
+        }
+        token = resp_rd.token;
+        free(resp_rd.dirent_array);
+    } while (resp_rd.pvfs_dirent_outcount != 0 &&
+             token != PVFS_READDIR_END);
+
+    for (w = 0; w <= WORKERS; w++)
+    {
+        for (e = 0; e < MAX_ENTRIES; e++)
+        {
+            if (seen[w][e] != entry_exists(w, e))
+            {
+                printf("DIRDATA-SPLIT: readdir returned w%d.%d %d times\n",
+                       w, e, seen[w][e]);
+                errors++;
+            }
+        }
+    }
+    printf("%s: readdir returned %d entries, expected %d\n",
+           (errors ? "FAIL" : "PASS"), total, expected_count());
+    return (errors ? -1 : 0);
+}
+
+/* check_readdir_kept()
+ *
+ * reads the whole directory SMALL_READDIR_BATCH entries at a time; while
+ * the workers run, whatever the split is doing, the initial entries that
+ * are never removed have to be returned
+ *
+ * returns the number of those entries missing, or -1 on error
+ */
+static int check_readdir_kept(void)
+{
+    PVFS_sysresp_readdir resp_rd;
+    PVFS_ds_position token = PVFS_READDIR_START;
+    static int seen[INITIAL_ENTRIES];
+    int ret, i, w, e, missing = 0;
+
+    memset(seen, 0, sizeof(seen));
+    do
+    {
+        memset(&resp_rd, 0, sizeof(resp_rd));
+        ret = PVFS_sys_readdir(dir_ref, token, SMALL_READDIR_BATCH, &creds,
+                               &resp_rd, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_readdir", ret);
+            return -1;
+        }
+        for (i = 0; i < resp_rd.pvfs_dirent_outcount; i++)
+        {
+            if (sscanf(resp_rd.dirent_array[i].d_name, "w%d.%d", &w, &e)
+                == 2 && w == WORKERS && e >= 0 && e < INITIAL_ENTRIES)
+            {
+                seen[e] = 1;
+            }
+        }
+        token = resp_rd.token;
+        free(resp_rd.dirent_array);
+    } while (resp_rd.pvfs_dirent_outcount != 0 &&
+             token != PVFS_READDIR_END);
+
+    for (e = 0; e < INITIAL_ENTRIES; e++)
+    {
+        if (!is_removed(e) && !seen[e])
+        {
+            missing++;
+        }
+    }
+    return missing;
+}
+
+/* reader()
+ *
+ * reads the whole directory over and over until stop_fd is closed
+ */
+static int reader(PVFS_fs_id fs_id, const char *handle, int stop_fd)
+{
+    char c;
+    int ret, passes = 0, missing = 0;
+
+    dir_ref.fs_id = fs_id;
+    dir_ref.handle = strtoull(handle, NULL, 10);
+    /* every readdir has to see the split as it is on the servers */
+    PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, 0);
+    fcntl(stop_fd, F_SETFL, O_NONBLOCK);
+
+    while (read(stop_fd, &c, 1) < 0 && errno == EAGAIN)
+    {
+        ret = check_readdir_kept();
+        if (ret < 0)
+        {
+            return 1;
+        }
+        missing += ret;
+        passes++;
+    }
+    if (missing)
+    {
+        printf("DIRDATA-SPLIT: %d readdir passes missed %d entries\n",
+               passes, missing);
+    }
+    return (missing ? 1 : 0);
+}
+
+/* check_lookup()
+ *
+ * looks up every name: entries that were not removed have to be found,
+ * removed ones must not be
+ */
+static int check_lookup(void)
+{
+    PVFS_sysresp_lookup resp_lk;
+    char name[64];
+    int ret, w, e, errors = 0;
+
+    for (w = 0; w <= WORKERS; w++)
+    {
+        for (e = 0; e < MAX_ENTRIES; e++)
+        {
+            entry_name(name, sizeof(name), w, e);
+            ret = PVFS_sys_ref_lookup(dir_ref.fs_id, name, dir_ref, &creds,
+                                      &resp_lk, PVFS2_LOOKUP_LINK_NO_FOLLOW,
+                                      NULL);
+            if (entry_exists(w, e) ? (ret != 0) : (ret != -PVFS_ENOENT))
+            {
+                printf("DIRDATA-SPLIT: lookup of %s returned %d\n",
+                       name, ret);
+                errors++;
+            }
+        }
+    }
+    printf("%s: lookup of %d names\n", (errors ? "FAIL" : "PASS"),
+           (WORKERS + 1) * MAX_ENTRIES);
+    return (errors ? -1 : 0);
+}
+
+/* check_spread()
+ *
+ * the entries have to be spread over more than one dirdata object, and
+ * once the split has removed the entries it moved, the dirdata objects
+ * together have to hold each entry once
+ */
+static int check_spread(void)
+{
+    PVFS_handle dirdata[MAX_DIRDATA];
+    PVFS_object_ref ref;
+    PVFS_sysresp_getattr resp_ga;
+    PVFS_size sum = 0;
+    int ret, i, used = 0, waited;
+
+    ret = PVFS_mgmt_get_dirdata_array(dir_ref, &creds, dirdata,
+                                      MAX_DIRDATA, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_get_dirdata_array", ret);
+        return -1;
+    }
+
+    for (waited = 0; waited <= SETTLE_SECS; waited++)
+    {
+        sum = 0;
+        used = 0;
+        for (i = 0; i < MAX_DIRDATA; i++)
+        {
+            ref.fs_id = dir_ref.fs_id;
+            ref.handle = dirdata[i];
+            memset(&resp_ga, 0, sizeof(resp_ga));
+            ret = PVFS_sys_getattr(ref, PVFS_ATTR_SYS_ALL_NOHINT, &creds,
+                                   &resp_ga, NULL);
+            if (ret < 0)
+            {
+                PVFS_perror("PVFS_sys_getattr", ret);
+                return -1;
+            }
+            sum += resp_ga.attr.dirent_count;
+            if (resp_ga.attr.dirent_count > 0)
+            {
+                used++;
+            }
+            PVFS_util_release_sys_attr(&resp_ga.attr);
+        }
+        if (sum == expected_count())
+        {
+            break;
+        }
+        sleep(1);
+    }
+
+    printf("%s: entries spread over %d dirdata objects\n",
+           (used > 1 ? "PASS" : "FAIL"), used);
+    printf("%s: dirdata objects hold %lld entries, expected %d\n",
+           (sum == expected_count() ? "PASS" : "FAIL"), lld(sum),
+           expected_count());
+    return ((used > 1 && sum == expected_count()) ? 0 : -1);
+}
+
+int main(int argc, char **argv)
+{
+    PVFS_fs_id fs_id;
+    PVFS_sysresp_lookup resp_lk;
+    PVFS_sysresp_mkdir resp_mk;
+    PVFS_sys_attr attr;
+    char name[64], handle[64], start_fd[16], ready_fd[16], stop_fd[16], c;
+    pid_t pids[WORKERS + READERS];
+    int ret, i, r, status, server_count = 0, failed = 0, ready = 0;
+    int missing = 0;
+    int start_pipe[2], ready_pipe[2], stop_pipe[2];
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return -1;
+    }
+    ret = PVFS_util_get_default_fsid(&fs_id);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_get_default_fsid", ret);
+        return -1;
+    }
+    PVFS_util_gen_credential_defaults(&creds);
+
+    if (argc == 6 && strcmp(argv[1], "--worker") == 0)
+    {
+        ret = worker(fs_id, argv[2], atoi(argv[3]), atoi(argv[4]),
+                     atoi(argv[5]));
+        PVFS_sys_finalize();
+        return ret;
+    }
+    if (argc == 4 && strcmp(argv[1], "--reader") == 0)
+    {
+        ret = reader(fs_id, argv[2], atoi(argv[3]));
+        PVFS_sys_finalize();
+        return ret;
+    }
+
+    /* the workers remove entries this process created; every lookup
+     * has to go to the servers */
+    PVFS_sys_set_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS, 0);
+    PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, 0);
+
+    ret = PVFS_mgmt_count_servers(fs_id, PVFS_MGMT_META_SERVER,
+                                  &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_count_servers", ret);
+        return -1;
+    }
+    if (server_count < MAX_DIRDATA)
+    {
+        printf("DIRDATA-SPLIT: needs %d metadata servers, found %d; "
+               "skipped\n", MAX_DIRDATA, server_count);
+        PVFS_sys_finalize();
+        return 0;
+    }
+
+    ret = PVFS_sys_lookup(fs_id, "/", &creds, &resp_lk,
+                          PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_lookup", ret);
+        return -1;
+    }
+
+    /* one bucket to begin with, split once it holds SPLIT_SIZE entries */
+    memset(&attr, 0, sizeof(attr));
+    attr.owner = creds.userid;
+    attr.group = creds.group_array[0];
+    attr.perms = PVFS_U_WRITE | PVFS_U_READ | PVFS_U_EXECUTE;
+    attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
+    attr.distr_dir_servers_initial = 1;
+    attr.distr_dir_servers_max = MAX_DIRDATA;
+    attr.distr_dir_split_size = SPLIT_SIZE;
+    snprintf(name, sizeof(name), "dirdata-split.%d", (int)getpid());
+
+    ret = PVFS_sys_mkdir(name, resp_lk.ref, attr, &creds, &resp_mk, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_mkdir", ret);
+        return -1;
+    }
+    dir_ref = resp_mk.ref;
+    snprintf(handle, sizeof(handle), "%llu", llu(dir_ref.handle));
+
+    if (pipe(start_pipe) < 0 || pipe(ready_pipe) < 0 || pipe(stop_pipe) < 0)
+    {
+        perror("pipe");
+        failed = 1;
+        goto out;
+    }
+    snprintf(start_fd, sizeof(start_fd), "%d", start_pipe[0]);
+    snprintf(ready_fd, sizeof(ready_fd), "%d", ready_pipe[1]);
+    snprintf(stop_fd, sizeof(stop_fd), "%d", stop_pipe[0]);
+
+    for (i = 0; i < WORKERS; i++)
+    {
+        char nr[16];
+
+        snprintf(nr, sizeof(nr), "%d", i);
+        pids[i] = fork();
+        if (pids[i] < 0)
+        {
+            perror("fork");
+            failed = 1;
+            break;
+        }
+        if (pids[i] == 0)
+        {
+            close(start_pipe[1]);
+            close(ready_pipe[0]);
+            close(stop_pipe[1]);
+            execl(argv[0], argv[0], "--worker", handle, nr, start_fd,
+                  ready_fd, (char *)NULL);
+            _exit(1);
+        }
+    }
+    /* wait until the bucket is filled up to just below its split size,
+     * then start the workers together; a worker that fails before it is
+     * ready closes its end by exiting */
+    close(ready_pipe[1]);
+    while (ready < i && read(ready_pipe[0], &c, 1) == 1)
+    {
+        ready++;
+    }
+    close(ready_pipe[0]);
+
+    /* readdir has to skip the entries the split moved while it removes
+     * them from the bucket, without cutting its batches short */
+    for (r = 0; r < READERS && !failed; r++)
+    {
+        pids[WORKERS + r] = fork();
+        if (pids[WORKERS + r] < 0)
+        {
+            perror("fork");
+            failed = 1;
+            break;
+        }
+        if (pids[WORKERS + r] == 0)
+        {
+            close(start_pipe[1]);
+            close(stop_pipe[1]);
+            execl(argv[0], argv[0], "--reader", handle, stop_fd,
+                  (char *)NULL);
+            _exit(1);
+        }
+    }
+    close(start_pipe[1]);
+    close(start_pipe[0]);
+    close(stop_pipe[0]);
+    while (--i >= 0)
+    {
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            failed = 1;
+        }
+    }
+    close(stop_pipe[1]);
+    while (--r >= 0)
+    {
+        waitpid(pids[WORKERS + r], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            missing = 1;
+        }
+    }
+    printf("%s: concurrent creates and removes\n",
+           (failed ? "FAIL" : "PASS"));
+    printf("%s: readdir while the directory splits\n",
+           (missing ? "FAIL" : "PASS"));
+
+    if (failed || missing)
+    {
+        failed = 1;
+        goto out;
+    }
+    failed = (check_readdir() < 0);
+    failed |= (check_lookup() < 0);
+    failed |= (check_spread() < 0);
+    if (!failed)
+    {
+        printf("DIRDATA-SPLIT: all checks passed\n");
+    }
+
+out:
+    for (i = 0; i < (WORKERS + 1) * MAX_ENTRIES; i++)
+    {
+        if (!entry_created(i / MAX_ENTRIES, i % MAX_ENTRIES))
+        {
+            continue;
+        }
+        entry_name(handle, sizeof(handle), i / MAX_ENTRIES,
+                   i % MAX_ENTRIES);
+        PVFS_sys_remove(handle, dir_ref, &creds, NULL);
+    }
+    snprintf(name, sizeof(name), "dirdata-split.%d", (int)getpid());
+    PVFS_sys_remove(name, resp_lk.ref, &creds, NULL);
+    PVFS_sys_finalize();
+    return (failed ? -1 : 0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,459 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Checks the contents of tiny files kept as inline data: writes and
+ * reads below the limit, a write that grows the file past it and moves
+ * the data to the bstream, truncates and remove.  Then two copies of
+ * this program write to the same tiny file at once with large writes,
+ * whose flows both find the inline data and must not move it to the
+ * bstream twice.
+ *
+ * Needs a file system with InlineDataSize of at least INLINE_SIZE;
+ * without it the same checks run against ordinary files.
+ */
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "client.h"
+#include "pvfs2-util.h"
+#include "pvfs2-internal.h"
+
+#define INLINE_SIZE 4096
+#define MODEL_SIZE (64 * 1024)
+/* larger than any small I/O (at most 256K), so that the writes are
+ * flows; the files have one datafile, which both writes go to
+ */
+#define FLOW_WRITE_SIZE (320 * 1024)
+#define SECOND_OFFSET (2 * FLOW_WRITE_SIZE)
+#define RACE_SIZE (SECOND_OFFSET + FLOW_WRITE_SIZE)
+#define RACE_ROUNDS 20
+
+static PVFS_credential creds;
+static PVFS_object_ref parent_ref;
+static PVFS_object_ref file_ref;
+static char model[MODEL_SIZE];
+static PVFS_size model_size;
+
+static int write_at(PVFS_offset offset, PVFS_size len, char fill)
+{
+    PVFS_Request mem_req;
+    PVFS_sysresp_io resp_io;
+    char *buf;
+    int ret;
+
+    buf = malloc(len);
+    if (!buf)
+    {
+        return -PVFS_ENOMEM;
+    }
+    memset(buf, fill, len);
+
+    ret = PVFS_Request_contiguous(len, PVFS_BYTE, &mem_req);
+    if (ret == 0)
+    {
+        ret = PVFS_sys_write(file_ref, PVFS_BYTE, offset, buf, mem_req,
+                             &creds, &resp_io, NULL);
+        PVFS_Request_free(&mem_req);
+    }
+    free(buf);
+    if (ret == 0 && resp_io.total_completed != len)
+    {
+        ret = -PVFS_EIO;
+    }
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_write", ret);
+        return ret;
+    }
+    if (offset + len <= MODEL_SIZE)
+    {
+        memset(model + offset, fill, len);
+    }
+    if (offset + len > model_size)
+    {
+        model_size = offset + len;
+    }
+    return 0;
+}
+
+static int truncate_to(PVFS_size size)
+{
+    int ret;
+
+    ret = PVFS_sys_truncate(file_ref, size, &creds, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_truncate", ret);
+        return ret;
+    }
+    if (size > model_size)
+    {
+        memset(model + model_size, 0, size - model_size);
+    }
+    else
+    {
+        memset(model + size, 0, model_size - size);
+    }
+    model_size = size;
+    return 0;
+}
+
+/* check_file()
+ *
+ * reads the whole file and a bit past its end and compares it with
+ * the model, then compares the size
+ */
+static int check_file(const char *step)
+{
+    PVFS_Request mem_req;
+    PVFS_sysresp_io resp_io;
+    PVFS_sysresp_getattr resp_ga;
+    PVFS_size len = model_size + 1000, i;
+    char *buf;
+    int ret;
+
+    buf = calloc(1, len);
+    if (!buf)
+    {
+        return -1;
+    }
+    ret = PVFS_Request_contiguous(len, PVFS_BYTE, &mem_req);
+    if (ret == 0)
+    {
+        ret = PVFS_sys_read(file_ref, PVFS_BYTE, 0, buf, mem_req,
+                            &creds, &resp_io, NULL);
+        PVFS_Request_free(&mem_req);
+    }
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_read", ret);
+        free(buf);
+        return -1;
+    }
+    for (i = 0; i < model_size && buf[i] == model[i]; i++)
+    {
+    }
+    free(buf);
+    if (resp_io.total_completed != model_size || i != model_size)
+    {
+        fprintf(stderr, "INLINE-DATA: %s: FAILED: read %lld bytes, "
+                "expected %lld, first difference at %lld\n", step,
+                lld(resp_io.total_completed), lld(model_size), lld(i));
+        return -1;
+    }
+
+    memset(&resp_ga, 0, sizeof(resp_ga));
+    ret = PVFS_sys_getattr(file_ref, PVFS_ATTR_SYS_ALL_NOHINT, &creds,
+                           &resp_ga, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_getattr", ret);
+        return -1;
+    }
+    PVFS_util_release_sys_attr(&resp_ga.attr);
+    if (resp_ga.attr.size != model_size)
+    {
+        fprintf(stderr, "INLINE-DATA: %s: FAILED: size %lld, expected "
+                "%lld\n", step, lld(resp_ga.attr.size), lld(model_size));
+        return -1;
+    }
+    printf("INLINE-DATA: %s: %lld bytes ok\n", step, lld(model_size));
+    return 0;
+}
+
+static int create_file(const char *name)
+{
+    PVFS_sysresp_create resp_cr;
+    PVFS_sys_attr attr;
+    int ret;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.owner = creds.userid;
+    attr.group = creds.group_array[0];
+    attr.perms = PVFS_U_WRITE | PVFS_U_READ;
+    attr.atime = attr.ctime = attr.mtime = time(NULL);
+    attr.dfile_count = 1;
+    attr.mask = PVFS_ATTR_SYS_ALL_SETABLE | PVFS_ATTR_SYS_DFILE_COUNT;
+
+    ret = PVFS_sys_create((char *)name, parent_ref, attr, &creds, NULL,
+                          &resp_cr, NULL, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_create", ret);
+        return ret;
+    }
+    file_ref = resp_cr.ref;
+    memset(model, 0, sizeof(model));
+    model_size = 0;
+    return 0;
+}
+
+/* child_write()
+ *
+ * one large write; the child reports on ready_fd that it is set up and
+ * starts once the parent closes the pipe on start_fd
+ */
+static int child_write(PVFS_fs_id fs_id, const char *handle,
+                       const char *offset, const char *fill,
+                       const char *ready_fd, const char *start_fd)
+{
+    char c = 0;
+
+    file_ref.fs_id = fs_id;
+    file_ref.handle = strtoull(handle, NULL, 10);
+
+    if (write(atoi(ready_fd), &c, 1) != 1)
+    {
+        return 1;
+    }
+    close(atoi(ready_fd));
+    while (read(atoi(start_fd), &c, 1) > 0)
+    {
+    }
+    return (write_at(strtoll(offset, NULL, 10), FLOW_WRITE_SIZE,
+                     fill[0]) < 0);
+}
+
+static pid_t start_writer(const char *prog, PVFS_offset offset, char fill,
+                          int ready_fd, int start_fd)
+{
+    char handle[64], offset_str[64], fill_str[2], ready_str[16];
+    char start_str[16];
+    pid_t pid;
+
+    snprintf(handle, sizeof(handle), "%llu", llu(file_ref.handle));
+    snprintf(offset_str, sizeof(offset_str), "%lld", lld(offset));
+    snprintf(ready_str, sizeof(ready_str), "%d", ready_fd);
+    snprintf(start_str, sizeof(start_str), "%d", start_fd);
+    fill_str[0] = fill;
+    fill_str[1] = '\0';
+
+    pid = fork();
+    if (pid == 0)
+    {
+        execl(prog, prog, "--child", handle, offset_str, fill_str,
+              ready_str, start_str, (char *)NULL);
+        _exit(1);
+    }
+    return pid;
+}
+
+/* concurrent_writes()
+ *
+ * two large writes to a tiny file at once; the one at offset 0 must not
+ * be overwritten by the old inline data
+ */
+static int concurrent_writes(const char *prog, const char *name)
+{
+    PVFS_sysresp_io resp_io;
+    PVFS_Request mem_req;
+    pid_t pids[2];
+    int ready_pipe[2], start_pipe[2], status, i, ret = -1;
+    char *buf, c;
+    PVFS_size j;
+
+    if (create_file(name) < 0 || write_at(0, 100, 'o') < 0)
+    {
+        return -1;
+    }
+
+    if (pipe(ready_pipe) < 0 || pipe(start_pipe) < 0)
+    {
+        perror("pipe");
+        return -1;
+    }
+    /* the writers only see the start pipe close if they do not hold it */
+    fcntl(ready_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(start_pipe[1], F_SETFD, FD_CLOEXEC);
+
+    pids[0] = start_writer(prog, 0, 'A', ready_pipe[1], start_pipe[0]);
+    pids[1] = start_writer(prog, SECOND_OFFSET, 'B', ready_pipe[1],
+                           start_pipe[0]);
+    close(ready_pipe[1]);
+    close(start_pipe[0]);
+    for (i = 0; i < 2 && read(ready_pipe[0], &c, 1) == 1; i++)
+    {
+    }
+    close(ready_pipe[0]);
+    close(start_pipe[1]);
+
+    for (i = 0; i < 2; i++)
+    {
+        if (pids[i] < 0 || waitpid(pids[i], &status, 0) < 0 ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "INLINE-DATA: concurrent writer failed\n");
+            return -1;
+        }
+    }
+
+    buf = calloc(1, RACE_SIZE);
+    if (!buf)
+    {
+        return -1;
+    }
+    if (PVFS_Request_contiguous(RACE_SIZE, PVFS_BYTE, &mem_req) == 0)
+    {
+        ret = PVFS_sys_read(file_ref, PVFS_BYTE, 0, buf, mem_req, &creds,
+                            &resp_io, NULL);
+        PVFS_Request_free(&mem_req);
+    }
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_read", ret);
+        free(buf);
+        return -1;
+    }
+    ret = -1;
+    for (j = 0; j < RACE_SIZE; j++)
+    {
+        char expected = (j < FLOW_WRITE_SIZE ? 'A' :
+                         (j < SECOND_OFFSET ? '\0' : 'B'));
+
+        if (buf[j] != expected)
+        {
+            fprintf(stderr, "INLINE-DATA: concurrent writes: FAILED: "
+                    "byte %lld is %d, expected %d\n", lld(j),
+                    buf[j], expected);
+            break;
+        }
+    }
+    if (j == RACE_SIZE && resp_io.total_completed == RACE_SIZE)
+    {
+        ret = 0;
+    }
+    free(buf);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    PVFS_fs_id fs_id;
+    PVFS_sysresp_lookup resp_lk;
+    char name[64], path[80];
+    int ret, i;
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return -1;
+    }
+    ret = PVFS_util_get_default_fsid(&fs_id);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_get_default_fsid", ret);
+        return -1;
+    }
+    PVFS_util_gen_credential_defaults(&creds);
+
+    if (argc == 7 && strcmp(argv[1], "--child") == 0)
+    {
+        return child_write(fs_id, argv[2], argv[3], argv[4], argv[5],
+                           argv[6]);
+    }
+
+    /* every getattr has to go to the servers */
+    PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, 0);
+
+    ret = PVFS_sys_lookup(fs_id, "/", &creds, &resp_lk,
+                          PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_lookup", ret);
+        return -1;
+    }
+    parent_ref = resp_lk.ref;
+
+    snprintf(name, sizeof(name), "inline-data.%d", (int)getpid());
+    if (create_file(name) < 0)
+    {
+        return -1;
+    }
+    ret = -1;
+
+    /* below the limit, then past it */
+    if (check_file("empty file") < 0 ||
+        write_at(0, 1000, 'a') < 0 || check_file("small write") < 0 ||
+        write_at(500, 200, 'b') < 0 || check_file("overwrite") < 0 ||
+        write_at(2000, 100, 'c') < 0 || check_file("write past a hole") < 0 ||
+        write_at(3000, INLINE_SIZE, 'd') < 0 ||
+        check_file("grown past the limit") < 0 ||
+        write_at(10, 10, 'e') < 0 || check_file("write after growing") < 0)
+    {
+        goto out;
+    }
+
+    /* truncates of the migrated file, then of an inline one */
+    if (truncate_to(1500) < 0 || check_file("truncate below the limit") < 0 ||
+        truncate_to(0) < 0 || check_file("truncate to zero") < 0 ||
+        write_at(0, 300, 'f') < 0 || check_file("inline again") < 0 ||
+        truncate_to(50) < 0 || check_file("inline truncate down") < 0 ||
+        truncate_to(2000) < 0 || check_file("inline truncate up") < 0 ||
+        truncate_to(INLINE_SIZE + 1) < 0 ||
+        check_file("truncate past the limit") < 0)
+    {
+        goto out;
+    }
+
+    /* remove of an inline file */
+    if (truncate_to(0) < 0 || write_at(0, 100, 'g') < 0 ||
+        check_file("inline before remove") < 0)
+    {
+        goto out;
+    }
+    ret = PVFS_sys_remove(name, parent_ref, &creds, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_remove", ret);
+        ret = -1;
+        goto out;
+    }
+    snprintf(path, sizeof(path), "/%s", name);
+    ret = PVFS_sys_lookup(fs_id, path, &creds, &resp_lk,
+                          PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+    if (ret != -PVFS_ENOENT)
+    {
+        fprintf(stderr, "INLINE-DATA: removed file still found: %d\n", ret);
+        ret = -1;
+        goto out;
+    }
+    printf("INLINE-DATA: remove ok\n");
+
+    for (i = 0; i < RACE_ROUNDS; i++)
+    {
+        ret = concurrent_writes(argv[0], name);
+        PVFS_sys_remove(name, parent_ref, &creds, NULL);
+        if (ret < 0)
+        {
+            goto out;
+        }
+    }
+    printf("INLINE-DATA: concurrent writes ok\n");
+
+    ret = 0;
+    printf("INLINE-DATA: all checks passed\n");
+
+out:
+    PVFS_sys_remove(name, parent_ref, &creds, NULL);
+    PVFS_sys_finalize();
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
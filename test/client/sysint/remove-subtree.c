@@ -0,0 +1,133 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "client.h"
+#include "pvfs2-util.h"
+#include "str-utils.h"
+#include "pint-sysint-utils.h"
+#include "pvfs2-internal.h"
+
+/* Empties a directory with server-side subtree removes, budget objects
+ * per call, then removes the directory itself.
+ */
+int main(int argc,char **argv)
+{
+    int ret = -1;
+    char str_buf[256] = {0};
+    char *dirname = (char *)0;
+    uint32_t budget = 0;
+    uint32_t total = 0;
+    int calls = 0;
+    PVFS_fs_id cur_fs;
+    PVFS_object_ref parent_refn;
+    PVFS_sysresp_lookup resp_lk;
+    PVFS_sysresp_remove_subtree resp_rs;
+    PVFS_credential credentials;
+
+    if (argc != 2 && argc != 3)
+    {
+        printf("usage: %s dir_to_remove [budget]\n", argv[0]);
+        return 1;
+    }
+    dirname = argv[1];
+    if (argc == 3)
+    {
+        budget = (uint32_t)atoi(argv[2]);
+    }
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+	PVFS_perror("PVFS_util_init_defaults", ret);
+	return (-1);
+    }
+    ret = PVFS_util_get_default_fsid(&cur_fs);
+    if (ret < 0)
+    {
+	PVFS_perror("PVFS_util_get_default_fsid", ret);
+	return (-1);
+    }
+
+    if (PINT_remove_base_dir(dirname,str_buf,256))
+    {
+        if (dirname[0] != '/')
+        {
+            printf("You forgot the leading '/'\n");
+        }
+        printf("Cannot retrieve entry name for removal on %s\n",
+               dirname);
+        return(-1);
+    }
+
+    PVFS_util_gen_credential_defaults(&credentials);
+
+    memset(&resp_lk,0,sizeof(PVFS_sysresp_lookup));
+    ret = PVFS_sys_lookup(cur_fs, dirname, &credentials,
+                          &resp_lk, PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_lookup", ret);
+        return(-1);
+    }
+
+    do
+    {
+        ret = PVFS_sys_remove_subtree(resp_lk.ref, budget, &credentials,
+                                      &resp_rs, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("remove_subtree failed ", ret);
+            return(-1);
+        }
+        calls++;
+        total += resp_rs.removed;
+        printf("call %d: removed %u objects (%u total)\n", calls,
+               resp_rs.removed, total);
+    } while (!resp_rs.complete);
+
+    ret = PINT_lookup_parent(dirname, cur_fs, &credentials,
+                             &parent_refn.handle);
+    if(ret < 0)
+    {
+	PVFS_perror("PVFS_util_lookup_parent", ret);
+	return(-1);
+    }
+    parent_refn.fs_id = cur_fs;
+
+    ret = PVFS_sys_remove(str_buf, parent_refn, &credentials, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("remove failed ", ret);
+        return(-1);
+    }
+
+    printf("===================================\n");
+    printf("directory %s and %u objects below it have been removed.\n",
+           dirname, total);
+
+    ret = PVFS_sys_finalize();
+    if (ret < 0)
+    {
+        printf("finalizing sysint failed with errcode = %d\n", ret);
+        return (-1);
+    }
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
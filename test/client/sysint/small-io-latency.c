@@ -0,0 +1,215 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "client.h"
+#include "pvfs2-util.h"
+#include "pvfs2-internal.h"
+
+#define MIN_IO_SIZE (4*1024)
+#define MAX_IO_SIZE (1024*1024)
+#define DEFAULT_ITERATIONS 100
+
+static double Wtime(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return ((double)t.tv_sec + (double)t.tv_usec / 1000000);
+}
+
+/* Reports the average latency of writes and reads of increasing size to
+ * one file, to show where requests stop fitting in a small I/O message
+ * and fall back to a flow.
+ */
+int main(int argc, char **argv)
+{
+    PVFS_sysresp_lookup resp_lk;
+    PVFS_sysresp_create resp_cr;
+    PVFS_sysresp_io resp_io;
+    PVFS_sysresp_getparent gp_resp;
+    PVFS_fs_id fs_id;
+    PVFS_credential credentials;
+    PVFS_sys_attr attr;
+    PVFS_object_ref ref;
+    PVFS_Request mem_req;
+    char name[512] = {0};
+    char *entry_name = NULL;
+    char *buffer = NULL;
+    int iterations = DEFAULT_ITERATIONS;
+    int size, i, ret;
+    double start, wtime, rtime;
+
+    if (argc != 2 && argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <file name> [iterations]\n", argv[0]);
+        return (-1);
+    }
+    if (argc == 3)
+    {
+        iterations = atoi(argv[2]);
+        if (iterations < 1)
+        {
+            iterations = 1;
+        }
+    }
+
+    buffer = malloc(MAX_IO_SIZE);
+    if (!buffer)
+    {
+        return (-1);
+    }
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return (-1);
+    }
+    ret = PVFS_util_get_default_fsid(&fs_id);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_get_default_fsid", ret);
+        return (-1);
+    }
+
+    if (argv[1][0] == '/')
+    {
+        snprintf(name, 512, "%s", argv[1]);
+    }
+    else
+    {
+        snprintf(name, 512, "/%s", argv[1]);
+    }
+
+    PVFS_util_gen_credential_defaults(&credentials);
+    ret = PVFS_sys_lookup(fs_id, name, &credentials,
+                          &resp_lk, PVFS2_LOOKUP_LINK_FOLLOW, NULL);
+    if (ret == -PVFS_ENOENT)
+    {
+        memset(&gp_resp, 0, sizeof(PVFS_sysresp_getparent));
+        ret = PVFS_sys_getparent(fs_id, name, &credentials, &gp_resp, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_getparent failed", ret);
+            return ret;
+        }
+
+        attr.owner = credentials.userid;
+        attr.group = credentials.group_array[0];
+        attr.perms = PVFS_U_WRITE | PVFS_U_READ;
+        attr.atime = attr.ctime = attr.mtime = time(NULL);
+        attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
+
+        entry_name = rindex(name, (int)'/');
+        assert(entry_name);
+        entry_name++;
+
+        ret = PVFS_sys_create(entry_name, gp_resp.parent_ref, attr,
+                              &credentials, NULL, &resp_cr, NULL, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_create() failure", ret);
+            return (-1);
+        }
+        ref = resp_cr.ref;
+    }
+    else if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_lookup", ret);
+        return (-1);
+    }
+    else
+    {
+        ref = resp_lk.ref;
+    }
+
+    printf("%10s %14s %14s\n", "size", "write (usec)", "read (usec)");
+
+    for (size = MIN_IO_SIZE; size <= MAX_IO_SIZE; size *= 2)
+    {
+        for (i = 0; i < size; i++)
+        {
+            buffer[i] = (char)(i + size);
+        }
+
+        ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_Request_contiguous failure", ret);
+            return (-1);
+        }
+
+        start = Wtime();
+        for (i = 0; i < iterations; i++)
+        {
+            ret = PVFS_sys_write(ref, PVFS_BYTE, 0, buffer, mem_req,
+                                 &credentials, &resp_io, NULL);
+            if (ret < 0 || resp_io.total_completed != size)
+            {
+                PVFS_perror("PVFS_sys_write failure", ret);
+                return (-1);
+            }
+        }
+        wtime = Wtime() - start;
+
+        memset(buffer, 0, size);
+
+        start = Wtime();
+        for (i = 0; i < iterations; i++)
+        {
+            ret = PVFS_sys_read(ref, PVFS_BYTE, 0, buffer, mem_req,
+                                &credentials, &resp_io, NULL);
+            if (ret < 0 || resp_io.total_completed != size)
+            {
+                PVFS_perror("PVFS_sys_read failure", ret);
+                return (-1);
+            }
+        }
+        rtime = Wtime() - start;
+
+        for (i = 0; i < size; i++)
+        {
+            if (buffer[i] != (char)(i + size))
+            {
+                fprintf(stderr, "Error: data mismatch at offset %d of "
+                        "%d byte read\n", i, size);
+                return (-1);
+            }
+        }
+
+        printf("%10d %14.1f %14.1f\n", size,
+               wtime * 1000000 / iterations, rtime * 1000000 / iterations);
+
+        PVFS_Request_free(&mem_req);
+    }
+
+    ret = PVFS_sys_finalize();
+    if (ret < 0)
+    {
+        printf("finalizing sysint failed with errcode = %d\n", ret);
+        return (-1);
+    }
+
+    free(buffer);
+    return (0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,174 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Measures the per-name cost of each distributed directory hash
+ * function, the way crdirent, lookup and rmdirent use it: hash an entry
+ * name with PINT_encrypt_dirdata() and map it to a dirdata bucket with
+ * PINT_find_dist_dir_bucket().  The spread of names over the buckets is
+ * reported too, since a cheaper hash is only useful if it still balances
+ * the directory.
+ *
+ * usage: dist-dir-hash-bench [names] [dirdata servers] [passes]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "pvfs2-types.h"
+#include "pvfs2-internal.h"
+#include "dist-dir-utils.h"
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+/* names like those of a large create workload: a common prefix, a
+ * sequence number and a varying suffix length */
+static char **make_names(int count)
+{
+    static const char *suffix[] = {"", ".dat", ".chk.out", ".restart.h5"};
+    char **names;
+    char buf[PVFS_NAME_MAX];
+    int i;
+
+    names = malloc(count * sizeof(*names));
+    if(!names)
+    {
+        return NULL;
+    }
+    for(i = 0; i < count; i++)
+    {
+        snprintf(buf, sizeof(buf), "rank%05d-output-%09d%s",
+                 i % 4096, i, suffix[i % 4]);
+        names[i] = strdup(buf);
+        if(!names[i])
+        {
+            return NULL;
+        }
+    }
+    return names;
+}
+
+static int run(int hash_type, char **names, int count, int servers,
+               int passes)
+{
+    PVFS_dist_dir_attr attr;
+    PVFS_dist_dir_bitmap bitmap = NULL;
+    PVFS_dist_dir_hash_type hash;
+    int *buckets;
+    int i, p, b, min, max;
+    double start, secs;
+    uint64_t sum = 0;
+
+    if(PINT_init_dist_dir_state(&attr, &bitmap, servers, 0, servers,
+                                10000, hash_type) < 0)
+    {
+        return -1;
+    }
+    buckets = calloc(servers, sizeof(*buckets));
+    if(!buckets)
+    {
+        free(bitmap);
+        return -1;
+    }
+
+    start = Wtime();
+    for(p = 0; p < passes; p++)
+    {
+        for(i = 0; i < count; i++)
+        {
+            hash = PINT_encrypt_dirdata(&attr, names[i]);
+            b = PINT_find_dist_dir_bucket(hash, &attr, bitmap);
+            sum += b;
+            if(p == 0)
+            {
+                buckets[b]++;
+            }
+        }
+    }
+    secs = Wtime() - start;
+
+    min = max = buckets[0];
+    for(b = 1; b < servers; b++)
+    {
+        if(buckets[b] < min)
+        {
+            min = buckets[b];
+        }
+        if(buckets[b] > max)
+        {
+            max = buckets[b];
+        }
+    }
+
+    printf("%-8s %10.1f ns/name   buckets min %d max %d (ideal %d)"
+           "   [%llu]\n",
+           PINT_dist_dir_hash_type_name(hash_type),
+           secs * 1e9 / ((double)count * passes),
+           min, max, count / servers, llu(sum));
+
+    free(buckets);
+    free(bitmap);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int count = 1000000;
+    int servers = 16;
+    int passes = 3;
+    char **names;
+
+    if(argc > 1)
+    {
+        count = atoi(argv[1]);
+    }
+    if(argc > 2)
+    {
+        servers = atoi(argv[2]);
+    }
+    if(argc > 3)
+    {
+        passes = atoi(argv[3]);
+    }
+    if(count <= 0 || servers <= 0 || passes <= 0)
+    {
+        fprintf(stderr,
+                "usage: %s [names] [dirdata servers] [passes]\n", argv[0]);
+        return 1;
+    }
+
+    names = make_names(count);
+    if(!names)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("%d names, %d dirdata servers, %d passes\n",
+           count, servers, passes);
+    if(run(PVFS_DIST_DIR_HASH_MD5, names, count, servers, passes) < 0 ||
+       run(PVFS_DIST_DIR_HASH_MURMUR3, names, count, servers, passes) < 0)
+    {
+        fprintf(stderr, "failed to set up dist dir state\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
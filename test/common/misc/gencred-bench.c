@@ -0,0 +1,198 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Measures how many credentials per second PVFS_util_gen_credential()
+ * hands out, with the credential cache on and off, and with the
+ * in-process signer or pvfs2-gencred doing the work in security mode.
+ * Several uids may be given (as root) to model a usrint application
+ * acting for many users; requests cycle through them.  It also starts
+ * short-lived processes that each get one credential, as command line
+ * tools do, with the shared per-user cache on and off.
+ *
+ * usage: gencred-bench [credentials] [uid,uid,...]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "pvfs2-config.h"
+#include "pvfs2-types.h"
+#include "pvfs2-util.h"
+#include "security-util.h"
+
+#define MAX_USERS 64
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+static int run(const char *label, char **users, int nusers, int count)
+{
+    PVFS_credential cred;
+    double start, secs;
+    int i, ret, unsigned_creds = 0;
+
+    start = Wtime();
+    for(i = 0; i < count; i++)
+    {
+        ret = PVFS_util_gen_credential(users[i % nusers], NULL, 0,
+                                       NULL, NULL, &cred);
+        if(ret < 0)
+        {
+            PVFS_perror("PVFS_util_gen_credential", ret);
+            return -1;
+        }
+        if(IS_UNSIGNED_CRED(&cred))
+        {
+            unsigned_creds++;
+        }
+        PINT_cleanup_credential(&cred);
+    }
+    secs = Wtime() - start;
+
+    printf("%-24s %12.1f credentials/sec   (%d unsigned)\n",
+           label, (double)count / secs, unsigned_creds);
+    return 0;
+}
+
+#if defined(ENABLE_SECURITY_CERT) || defined(ENABLE_SECURITY_KEY)
+/* starts count processes in turn that each get one credential */
+static int run_processes(const char *label, const char *prog, int count)
+{
+    double start, secs;
+    int i, status;
+    pid_t pid;
+
+    start = Wtime();
+    for(i = 0; i < count; i++)
+    {
+        pid = fork();
+        if(pid < 0)
+        {
+            perror("fork");
+            return -1;
+        }
+        if(pid == 0)
+        {
+            execl(prog, prog, "--one", (char *)NULL);
+            _exit(1);
+        }
+        if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+           WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "%s: credential process failed\n", label);
+            return -1;
+        }
+    }
+    secs = Wtime() - start;
+
+    printf("%-24s %12.1f processes/sec\n", label, (double)count / secs);
+    return 0;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    int count = 2000;
+    char *users[MAX_USERS];
+    char self[16];
+    char *list = NULL, *tok, *saveptr;
+    int nusers = 0;
+
+    if(argc == 2 && strcmp(argv[1], "--one") == 0)
+    {
+        PVFS_credential cred;
+
+        snprintf(self, sizeof(self), "%u", (unsigned int)getuid());
+        if(PVFS_util_gen_credential(self, NULL, 0, NULL, NULL, &cred) < 0)
+        {
+            return 1;
+        }
+        PINT_cleanup_credential(&cred);
+        return 0;
+    }
+    if(argc > 1)
+    {
+        count = atoi(argv[1]);
+    }
+    if(argc > 2)
+    {
+        list = strdup(argv[2]);
+        for(tok = strtok_r(list, ",", &saveptr);
+            tok && nusers < MAX_USERS;
+            tok = strtok_r(NULL, ",", &saveptr))
+        {
+            users[nusers++] = tok;
+        }
+    }
+    if(count <= 0 || (argc > 2 && nusers == 0))
+    {
+        fprintf(stderr, "usage: %s [credentials] [uid,uid,...]\n", argv[0]);
+        return 1;
+    }
+    if(nusers == 0)
+    {
+        snprintf(self, sizeof(self), "%u", (unsigned int)getuid());
+        users[nusers++] = self;
+    }
+
+    printf("%d credentials, %d users\n", count, nusers);
+
+    setenv("PVFS2_CREDENTIAL_CACHE", "1", 1);
+    if(run("cached", users, nusers, count) < 0)
+    {
+        return 1;
+    }
+
+    setenv("PVFS2_CREDENTIAL_CACHE", "0", 1);
+    if(run("uncached", users, nusers, count) < 0)
+    {
+        return 1;
+    }
+
+#if defined(ENABLE_SECURITY_CERT) || defined(ENABLE_SECURITY_KEY)
+    /* process startup dominates; fewer iterations suffice */
+    setenv("PVFS2_CREDENTIAL_CACHE", "1", 1);
+    if(run_processes("processes, shared cache", argv[0],
+                     count > 200 ? 200 : count) < 0)
+    {
+        return 1;
+    }
+    setenv("PVFS2_CREDENTIAL_CACHE", "0", 1);
+    if(run_processes("processes, uncached", argv[0],
+                     count > 200 ? 200 : count) < 0)
+    {
+        return 1;
+    }
+
+    /* the external helper is much slower; fewer iterations suffice */
+    setenv("PVFS2_GENCRED_EXEC", "1", 1);
+    if(run("uncached pvfs2-gencred", users, nusers,
+           count > 200 ? 200 : count) < 0)
+    {
+        return 1;
+    }
+#endif
+
+    free(list);
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
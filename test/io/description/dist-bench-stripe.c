@@ -0,0 +1,290 @@
+/*
+ * (C) 2002 Clemson University.
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Compares the closed form simple_stripe mapping in PINT_distribute()
+ * against the generic distribution method calls, for contiguous,
+ * strided (vector) and hindexed file requests, in both server and
+ * client mode.  The segments produced by both paths must be identical;
+ * the time per PINT_process_request() call is reported for each.
+ *
+ * usage: dist-bench-stripe [iterations] [server count] [strip size]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <assert.h>
+
+#include <pvfs2-types.h>
+#include <gossip.h>
+#include <pvfs2-debug.h>
+#include <pint-distribution.h>
+#include <pint-dist-utils.h>
+#include <pvfs2-request.h>
+#include <pint-request.h>
+#include <pvfs2-dist-simple-stripe.h>
+#include "pvfs2-internal.h"
+
+#define SEGMAX 64
+#define BYTEMAX (4*1024*1024)
+#define REQ_BYTES (16*1024*1024)
+
+struct pattern
+{
+    const char *name;
+    PINT_Request *file_req;
+    PINT_Request *mem_req;
+};
+
+/* running checksum over every segment produced, used to verify that
+ * both paths generate the same output
+ */
+struct run_result
+{
+    int64_t segs;
+    int64_t bytes;
+    uint64_t sum;
+    double secs;
+};
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+static int run_pattern(struct pattern *pat, PINT_request_file_data *rf,
+                       int mode, int iterations, struct run_result *res)
+{
+    PINT_Request_state *file_state;
+    PINT_Request_state *mem_state = NULL;
+    PINT_Request_result seg;
+    int64_t offsets[SEGMAX];
+    int64_t sizes[SEGMAX];
+    double start;
+    int it, i, ret;
+
+    memset(res, 0, sizeof(*res));
+    seg.offset_array = offsets;
+    seg.size_array = sizes;
+    seg.segmax = SEGMAX;
+    seg.bytemax = BYTEMAX;
+
+    file_state = PINT_new_request_state(pat->file_req);
+    if (mode == PINT_CLIENT)
+    {
+        mem_state = PINT_new_request_state(pat->mem_req);
+    }
+    if (!file_state || (mode == PINT_CLIENT && !mem_state))
+    {
+        return -1;
+    }
+
+    start = Wtime();
+    for (it = 0; it < iterations; it++)
+    {
+        PINT_REQUEST_STATE_RST(file_state);
+        PINT_REQUEST_STATE_SET_TARGET(file_state, 0);
+        PINT_REQUEST_STATE_SET_FINAL(file_state,
+                                     PINT_REQUEST_TOTAL_BYTES(pat->mem_req));
+        if (mem_state)
+        {
+            PINT_REQUEST_STATE_RST(mem_state);
+        }
+        do
+        {
+            seg.bytes = 0;
+            seg.segs = 0;
+            ret = PINT_process_request(file_state, mem_state, rf, &seg,
+                                       mode);
+            if (ret < 0)
+            {
+                return ret;
+            }
+            if (it == 0)
+            {
+                for (i = 0; i < seg.segs; i++)
+                {
+                    res->sum = res->sum * 31 + offsets[i];
+                    res->sum = res->sum * 31 + sizes[i];
+                }
+                res->segs += seg.segs;
+                res->bytes += seg.bytes;
+            }
+        } while (!PINT_REQUEST_DONE(file_state));
+    }
+    res->secs = Wtime() - start;
+
+    PINT_free_request_state(file_state);
+    if (mem_state)
+    {
+        PINT_free_request_state(mem_state);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct pattern patterns[3];
+    PINT_request_file_data rf;
+    PVFS_simple_stripe_params *params;
+    struct run_result generic, fast;
+    int32_t *len_array;
+    PVFS_offset *off_array;
+    int iterations = 200;
+    int server_ct = 4;
+    PVFS_size strip_size = PVFS_DIST_SIMPLE_STRIPE_DEFAULT_STRIP_SIZE;
+    int block_ct = 256;
+    int p, s, m;
+    int errors = 0;
+    int modes[2] = {PINT_SERVER, PINT_CLIENT};
+
+    if (argc > 1)
+    {
+        iterations = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        server_ct = atoi(argv[2]);
+    }
+    if (argc > 3)
+    {
+        strip_size = atoll(argv[3]);
+    }
+    if (iterations < 1 || server_ct < 1 || strip_size < 1)
+    {
+        fprintf(stderr, "usage: %s [iterations] [server count] "
+                "[strip size]\n", argv[0]);
+        return -1;
+    }
+
+    /* contiguous: one 16 MiB region */
+    patterns[0].name = "contiguous";
+    PVFS_Request_contiguous(REQ_BYTES, PVFS_BYTE, &patterns[0].file_req);
+
+    /* strided: 256 blocks of 32 KiB every 64 KiB */
+    patterns[1].name = "strided";
+    PVFS_Request_vector(block_ct, REQ_BYTES / (2 * block_ct),
+                        REQ_BYTES / block_ct, PVFS_BYTE,
+                        &patterns[1].file_req);
+
+    /* hindexed: 256 blocks of varying size at increasing offsets */
+    patterns[2].name = "hindexed";
+    len_array = malloc(block_ct * sizeof(int32_t));
+    off_array = malloc(block_ct * sizeof(PVFS_offset));
+    assert(len_array && off_array);
+    for (p = 0; p < block_ct; p++)
+    {
+        len_array[p] = 4096 * (1 + (p % 13));
+        off_array[p] = (PVFS_offset)p * 65536 + 512 * (p % 7);
+    }
+    PVFS_Request_hindexed(block_ct, len_array, off_array, PVFS_BYTE,
+                          &patterns[2].file_req);
+
+    /* memory is contiguous, sized to match each file request */
+    for (p = 0; p < 3; p++)
+    {
+        PVFS_Request_contiguous(PINT_REQUEST_TOTAL_BYTES(
+                                    patterns[p].file_req),
+                                PVFS_BYTE, &patterns[p].mem_req);
+    }
+
+    PINT_dist_initialize(NULL);
+    rf.server_ct = server_ct;
+    rf.fsize = 0;
+    rf.extend_flag = 1;
+    rf.dist = PINT_dist_create("simple_stripe");
+    assert(rf.dist);
+    params = (PVFS_simple_stripe_params *)rf.dist->params;
+    params->strip_size = strip_size;
+
+    printf("%d servers, strip size %lld, %d iterations\n",
+           server_ct, lld(strip_size), iterations);
+    printf("%-11s %-6s %8s %12s %12s %8s\n", "pattern", "mode",
+           "segs", "generic(us)", "fast(us)", "speedup");
+
+    for (p = 0; p < 3; p++)
+    {
+        for (m = 0; m < 2; m++)
+        {
+            double tg = 0, tf = 0;
+            int64_t segs = 0;
+
+            for (s = 0; s < server_ct; s++)
+            {
+                rf.server_nr = s;
+
+                PINT_distribute_fast_path = 0;
+                if (run_pattern(&patterns[p], &rf, modes[m], iterations,
+                                &generic) < 0)
+                {
+                    fprintf(stderr, "Error: PINT_process_request failed\n");
+                    return -1;
+                }
+                PINT_distribute_fast_path = 1;
+                if (run_pattern(&patterns[p], &rf, modes[m], iterations,
+                                &fast) < 0)
+                {
+                    fprintf(stderr, "Error: PINT_process_request failed\n");
+                    return -1;
+                }
+
+                if (generic.segs != fast.segs ||
+                    generic.bytes != fast.bytes ||
+                    generic.sum != fast.sum)
+                {
+                    fprintf(stderr, "MISMATCH: %s %s server %d: "
+                            "generic %lld segs %lld bytes, "
+                            "fast %lld segs %lld bytes\n",
+                            patterns[p].name,
+                            modes[m] == PINT_SERVER ? "server" : "client",
+                            s, lld(generic.segs), lld(generic.bytes),
+                            lld(fast.segs), lld(fast.bytes));
+                    errors++;
+                }
+                tg += generic.secs;
+                tf += fast.secs;
+                segs += fast.segs;
+            }
+
+            printf("%-11s %-6s %8lld %12.2f %12.2f %7.2fx\n",
+                   patterns[p].name,
+                   modes[m] == PINT_SERVER ? "server" : "client",
+                   lld(segs),
+                   tg * 1e6 / (iterations * server_ct),
+                   tf * 1e6 / (iterations * server_ct),
+                   tf > 0 ? tg / tf : 0.0);
+        }
+    }
+
+    for (p = 0; p < 3; p++)
+    {
+        PVFS_Request_free(&patterns[p].file_req);
+        PVFS_Request_free(&patterns[p].mem_req);
+    }
+    PINT_dist_free(rf.dist);
+    free(len_array);
+    free(off_array);
+
+    if (errors)
+    {
+        fprintf(stderr, "%d mismatches between generic and fast path\n",
+                errors);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
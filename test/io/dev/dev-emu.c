@@ -0,0 +1,603 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Load tests pvfs2-client-core without the kernel module.  dev-emu
+ * plays the part of the pvfs2 character device: it serves a unix socket,
+ * starts the client core with --dev-emulator pointing at it, and sends
+ * upcalls framed the way the kernel would.  After mounting the file
+ * system it runs create, lookup, getattr, optional write and read, and
+ * remove phases over a private directory, keeping a window of upcalls
+ * outstanding, and reports the rate and latency of each phase.
+ *
+ * usage: dev-emu [-f files] [-w window] [-r getattr rounds]
+ *                [-i io size] [-b io buffers] [-s socket]
+ *                -m tcp://host:port/fs_name
+ *                -- /path/to/pvfs2-client-core [client core options]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include "pvfs2-types.h"
+#include "pint-dev.h"
+#include "pvfs2-dev-proto.h"
+
+/* PVFS2_DEVREQ_MAGIC of the kernel module */
+#define EMU_MAGIC          0x20030529
+/* seconds to wait for the client core before giving up */
+#define EMU_TIMEOUT        30
+#define EMU_MAX_TRAILER    (64 * 1024)
+
+/* header the device puts in front of every upcall and downcall */
+struct emu_hdr
+{
+    int32_t proto_ver;
+    int32_t magic;
+    uint64_t tag;
+};
+
+struct emu_slot
+{
+    uint64_t tag;
+    int index;
+    double start;
+};
+
+struct emu_phase
+{
+    const char *name;
+    int count;
+    int window;
+    void (*fill)(int index, pvfs2_upcall_t *upcall);
+    int (*done)(int index, pvfs2_downcall_t *downcall);
+};
+
+static int sock = -1;
+static pid_t core_pid = -1;
+static uint64_t next_tag = 1;
+static char *recv_buf;
+
+static PVFS_object_kref root_refn;
+static PVFS_object_kref dir_refn;
+static PVFS_object_kref *file_refns;
+static char dir_name[PVFS2_NAME_LEN];
+static char *mount_url;
+static int io_size;
+static int io_buffers = PVFS2_BUFMAP_DEFAULT_DESC_COUNT;
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr,
+            "usage: %s [-f files] [-w window] [-r getattr rounds]\n"
+            "          [-i io size] [-b io buffers] [-s socket]\n"
+            "          -m tcp://host:port/fs_name\n"
+            "          -- /path/to/pvfs2-client-core [client core options]\n",
+            progname);
+}
+
+static void init_upcall(pvfs2_upcall_t *upcall, int32_t type)
+{
+    memset(upcall, 0, sizeof(*upcall));
+    upcall->type = type;
+    upcall->uid = getuid();
+    upcall->gid = getgid();
+    upcall->pid = getpid();
+    upcall->tgid = getpid();
+}
+
+static void init_attr(PVFS_sys_attr *attr, int perms)
+{
+    memset(attr, 0, sizeof(*attr));
+    attr->owner = getuid();
+    attr->group = getgid();
+    attr->perms = perms;
+    attr->atime = attr->mtime = attr->ctime = time(NULL);
+    attr->mask = PVFS_ATTR_SYS_ALL_SETABLE;
+}
+
+static int send_upcall(uint64_t tag, pvfs2_upcall_t *upcall)
+{
+    struct emu_hdr hdr;
+    struct iovec iov[2];
+    struct msghdr msg;
+
+    hdr.proto_ver = PVFS_KERNEL_PROTO_VERSION;
+    hdr.magic = EMU_MAGIC;
+    hdr.tag = tag;
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = upcall;
+    iov[1].iov_len = sizeof(*upcall);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    if (sendmsg(sock, &msg, 0) != (ssize_t)(sizeof(hdr) + sizeof(*upcall)))
+    {
+        perror("sendmsg");
+        return -1;
+    }
+    return 0;
+}
+
+/* waits for the next downcall; returns its tag, or 0 on error */
+static uint64_t recv_downcall(pvfs2_downcall_t **downcall)
+{
+    struct pollfd pfd;
+    struct emu_hdr *hdr;
+    ssize_t ret;
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    do
+    {
+        ret = poll(&pfd, 1, EMU_TIMEOUT * 1000);
+    } while (ret < 0 && errno == EINTR);
+    if (ret <= 0)
+    {
+        fprintf(stderr, "no downcall from the client core within %d s\n",
+                EMU_TIMEOUT);
+        return 0;
+    }
+
+    ret = recv(sock, recv_buf,
+               sizeof(*hdr) + sizeof(pvfs2_downcall_t) + EMU_MAX_TRAILER, 0);
+    if (ret < (ssize_t)(sizeof(*hdr) + sizeof(pvfs2_downcall_t)))
+    {
+        fprintf(stderr, "short downcall (%zd bytes); client core exited?\n",
+                ret);
+        return 0;
+    }
+    hdr = (struct emu_hdr *)recv_buf;
+    if (hdr->magic != EMU_MAGIC)
+    {
+        fprintf(stderr, "bad magic in downcall\n");
+        return 0;
+    }
+    *downcall = (pvfs2_downcall_t *)(recv_buf + sizeof(*hdr));
+    return hdr->tag;
+}
+
+/* runs one phase, keeping up to phase->window upcalls outstanding */
+static int run_phase(struct emu_phase *phase)
+{
+    struct emu_slot *slots;
+    pvfs2_upcall_t upcall;
+    pvfs2_downcall_t *downcall;
+    int issued = 0, completed = 0, active = 0, errors = 0;
+    int i;
+    uint64_t tag;
+    double start, now, latency, lat_total = 0, lat_max = 0;
+
+    slots = calloc(phase->window, sizeof(*slots));
+    if (!slots)
+    {
+        return -1;
+    }
+
+    start = Wtime();
+    while (completed < phase->count)
+    {
+        /* fill the window */
+        for (i = 0; i < phase->window && issued < phase->count; i++)
+        {
+            if (slots[i].tag)
+            {
+                continue;
+            }
+            phase->fill(issued, &upcall);
+            slots[i].tag = next_tag++;
+            slots[i].index = issued++;
+            slots[i].start = Wtime();
+            if (send_upcall(slots[i].tag, &upcall) < 0)
+            {
+                free(slots);
+                return -1;
+            }
+            active++;
+        }
+
+        tag = recv_downcall(&downcall);
+        if (tag == 0)
+        {
+            free(slots);
+            return -1;
+        }
+        for (i = 0; i < phase->window; i++)
+        {
+            if (slots[i].tag == tag)
+            {
+                break;
+            }
+        }
+        if (i == phase->window)
+        {
+            fprintf(stderr, "downcall with unknown tag %llu\n",
+                    (unsigned long long)tag);
+            continue;
+        }
+
+        now = Wtime();
+        latency = now - slots[i].start;
+        lat_total += latency;
+        if (latency > lat_max)
+        {
+            lat_max = latency;
+        }
+        if (downcall->status != 0 || phase->done(slots[i].index, downcall))
+        {
+            if (errors++ == 0)
+            {
+                fprintf(stderr, "%s %d failed: status %d\n", phase->name,
+                        slots[i].index, downcall->status);
+            }
+        }
+        slots[i].tag = 0;
+        active--;
+        completed++;
+    }
+    now = Wtime();
+
+    printf("%-8s %8d ops %4d window %10.1f ops/sec   "
+           "latency mean %8.3f ms  max %8.3f ms%s\n",
+           phase->name, phase->count, phase->window,
+           phase->count / (now - start),
+           1000.0 * lat_total / phase->count, 1000.0 * lat_max,
+           errors ? "   ERRORS" : "");
+    free(slots);
+    return errors ? -1 : 0;
+}
+
+static void fill_mount(int index, pvfs2_upcall_t *upcall)
+{
+    init_upcall(upcall, PVFS2_VFS_OP_FS_MOUNT);
+    strncpy(upcall->req.fs_mount.pvfs2_config_server, mount_url,
+            PVFS_MAX_SERVER_ADDR_LEN - 1);
+}
+
+static int done_mount(int index, pvfs2_downcall_t *downcall)
+{
+    root_refn.fs_id = downcall->resp.fs_mount.fs_id;
+    root_refn.khandle = downcall->resp.fs_mount.root_khandle;
+    return 0;
+}
+
+static void fill_mkdir(int index, pvfs2_upcall_t *upcall)
+{
+    init_upcall(upcall, PVFS2_VFS_OP_MKDIR);
+    upcall->req.mkdir.parent_refn = root_refn;
+    init_attr(&upcall->req.mkdir.attributes, 0755);
+    strcpy(upcall->req.mkdir.d_name, dir_name);
+}
+
+static int done_mkdir(int index, pvfs2_downcall_t *downcall)
+{
+    dir_refn = downcall->resp.mkdir.refn;
+    return 0;
+}
+
+static void fill_rmdir(int index, pvfs2_upcall_t *upcall)
+{
+    init_upcall(upcall, PVFS2_VFS_OP_REMOVE);
+    upcall->req.remove.parent_refn = root_refn;
+    strcpy(upcall->req.remove.d_name, dir_name);
+}
+
+static void fill_create(int index, pvfs2_upcall_t *upcall)
+{
+    init_upcall(upcall, PVFS2_VFS_OP_CREATE);
+    upcall->req.create.parent_refn = dir_refn;
+    init_attr(&upcall->req.create.attributes, 0644);
+    snprintf(upcall->req.create.d_name, PVFS2_NAME_LEN, "f%d", index);
+}
+
+static int done_create(int index, pvfs2_downcall_t *downcall)
+{
+    file_refns[index] = downcall->resp.create.refn;
+    return 0;
+}
+
+static void fill_lookup(int index, pvfs2_upcall_t *upcall)
+{
+    init_upcall(upcall, PVFS2_VFS_OP_LOOKUP);
+    upcall->req.lookup.parent_refn = dir_refn;
+    snprintf(upcall->req.lookup.d_name, PVFS2_NAME_LEN, "f%d", index);
+}
+
+static int done_lookup(int index, pvfs2_downcall_t *downcall)
+{
+    return memcmp(&downcall->resp.lookup.refn.khandle,
+                  &file_refns[index].khandle, sizeof(PVFS_khandle)) ? -1 : 0;
+}
+
+static int num_files;
+
+static void fill_getattr(int index, pvfs2_upcall_t *upcall)
+{
+    init_upcall(upcall, PVFS2_VFS_OP_GETATTR);
+    upcall->req.getattr.refn = file_refns[index % num_files];
+    upcall->req.getattr.mask = PVFS_ATTR_SYS_ALL_NOHINT;
+}
+
+static void fill_io(pvfs2_upcall_t *upcall, int index, enum PVFS_io_type type)
+{
+    init_upcall(upcall, PVFS2_VFS_OP_FILE_IO);
+    upcall->req.io.async_vfs_io = 0;
+    upcall->req.io.io_type = type;
+    upcall->req.io.refn = file_refns[index];
+    /* each outstanding I/O uses its own shared buffer; the phase window
+     * is the number of buffers, so slots and buffers line up */
+    upcall->req.io.buf_index = index % io_buffers;
+    upcall->req.io.count = io_size;
+    upcall->req.io.offset = 0;
+    upcall->req.io.readahead_size = 0;
+}
+
+static void fill_write(int index, pvfs2_upcall_t *upcall)
+{
+    fill_io(upcall, index, PVFS_IO_WRITE);
+}
+
+static void fill_read(int index, pvfs2_upcall_t *upcall)
+{
+    fill_io(upcall, index, PVFS_IO_READ);
+}
+
+static int done_io(int index, pvfs2_downcall_t *downcall)
+{
+    return (downcall->resp.io.amt_complete == io_size) ? 0 : -1;
+}
+
+static void fill_remove(int index, pvfs2_upcall_t *upcall)
+{
+    init_upcall(upcall, PVFS2_VFS_OP_REMOVE);
+    upcall->req.remove.parent_refn = dir_refn;
+    snprintf(upcall->req.remove.d_name, PVFS2_NAME_LEN, "f%d", index);
+}
+
+static int done_none(int index, pvfs2_downcall_t *downcall)
+{
+    return 0;
+}
+
+/* starts the client core and waits for it to connect */
+static int start_client_core(const char *sock_name, char **core_argv,
+                             int core_argc)
+{
+    struct sockaddr_un addr;
+    struct PINT_dev_emu_hello hello;
+    struct pollfd pfd;
+    char emu_opt[sizeof(addr.sun_path) + 32];
+    char **args;
+    int lsock, ret, i;
+
+    lsock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (lsock < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sock_name);
+    unlink(sock_name);
+    if (bind(lsock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(lsock, 1) < 0)
+    {
+        perror("bind");
+        close(lsock);
+        return -1;
+    }
+
+    args = calloc(core_argc + 2, sizeof(char *));
+    if (!args)
+    {
+        close(lsock);
+        return -1;
+    }
+    for (i = 0; i < core_argc; i++)
+    {
+        args[i] = core_argv[i];
+    }
+    snprintf(emu_opt, sizeof(emu_opt), "--dev-emulator=%s", sock_name);
+    args[core_argc] = emu_opt;
+
+    core_pid = fork();
+    if (core_pid < 0)
+    {
+        perror("fork");
+        close(lsock);
+        return -1;
+    }
+    if (core_pid == 0)
+    {
+        close(lsock);
+        /* the client core signals its whole process group on shutdown */
+        setpgid(0, 0);
+        execv(args[0], args);
+        perror("execv");
+        _exit(1);
+    }
+    free(args);
+
+    pfd.fd = lsock;
+    pfd.events = POLLIN;
+    ret = poll(&pfd, 1, EMU_TIMEOUT * 1000);
+    if (ret <= 0)
+    {
+        fprintf(stderr, "client core did not connect within %d s\n",
+                EMU_TIMEOUT);
+        close(lsock);
+        return -1;
+    }
+    sock = accept(lsock, NULL, NULL);
+    close(lsock);
+    unlink(sock_name);
+    if (sock < 0)
+    {
+        perror("accept");
+        return -1;
+    }
+
+    hello.proto_ver = PVFS_KERNEL_PROTO_VERSION;
+    hello.magic = EMU_MAGIC;
+    hello.max_upsize = sizeof(struct emu_hdr) + sizeof(pvfs2_upcall_t);
+    hello.max_downsize = sizeof(struct emu_hdr) + sizeof(pvfs2_downcall_t);
+    if (send(sock, &hello, sizeof(hello), 0) != sizeof(hello))
+    {
+        perror("send");
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_client_core(void)
+{
+    int status;
+
+    if (core_pid > 0)
+    {
+        kill(core_pid, SIGTERM);
+        waitpid(core_pid, &status, 0);
+    }
+    if (sock >= 0)
+    {
+        close(sock);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int window = 64;
+    int rounds = 4;
+    char sock_name[108];
+    int opt, ret = 0;
+    struct emu_phase phase;
+
+    num_files = 1000;
+    snprintf(sock_name, sizeof(sock_name), "/tmp/pvfs2-dev-emu.%d",
+             (int)getpid());
+
+    while ((opt = getopt(argc, argv, "f:w:r:i:b:s:m:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f':
+                num_files = atoi(optarg);
+                break;
+            case 'w':
+                window = atoi(optarg);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 'i':
+                io_size = atoi(optarg);
+                break;
+            case 'b':
+                io_buffers = atoi(optarg);
+                break;
+            case 's':
+                snprintf(sock_name, sizeof(sock_name), "%s", optarg);
+                break;
+            case 'm':
+                mount_url = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (!mount_url || optind >= argc || num_files <= 0 || window <= 0 ||
+        rounds < 0 || io_size < 0 || io_buffers <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    file_refns = calloc(num_files, sizeof(*file_refns));
+    recv_buf = malloc(sizeof(struct emu_hdr) + sizeof(pvfs2_downcall_t) +
+                      EMU_MAX_TRAILER);
+    if (!file_refns || !recv_buf)
+    {
+        return 1;
+    }
+    snprintf(dir_name, sizeof(dir_name), "dev-emu.%d", (int)getpid());
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (start_client_core(sock_name, &argv[optind], argc - optind) < 0)
+    {
+        stop_client_core();
+        return 1;
+    }
+
+    printf("%d files, window %d, %d getattr rounds, io size %d\n",
+           num_files, window, rounds, io_size);
+
+#define RUN(_name, _count, _window, _fill, _done)             \
+do {                                                          \
+    phase.name = _name;                                       \
+    phase.count = _count;                                     \
+    phase.window = _window;                                   \
+    phase.fill = _fill;                                       \
+    phase.done = _done;                                       \
+    if (run_phase(&phase) < 0)                                \
+    {                                                         \
+        ret = 1;                                              \
+        goto out;                                             \
+    }                                                         \
+} while (0)
+
+    RUN("mount", 1, 1, fill_mount, done_mount);
+    RUN("mkdir", 1, 1, fill_mkdir, done_mkdir);
+    RUN("create", num_files, window, fill_create, done_create);
+    RUN("lookup", num_files, window, fill_lookup, done_lookup);
+    if (rounds)
+    {
+        RUN("getattr", num_files * rounds, window, fill_getattr, done_none);
+    }
+    if (io_size)
+    {
+        int io_window = window < io_buffers ? window : io_buffers;
+
+        RUN("write", num_files, io_window, fill_write, done_io);
+        RUN("read", num_files, io_window, fill_read, done_io);
+    }
+    RUN("remove", num_files, window, fill_remove, done_none);
+    RUN("rmdir", 1, 1, fill_rmdir, done_none);
+
+out:
+    stop_client_core();
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
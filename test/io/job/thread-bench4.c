@@ -0,0 +1,164 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Measures job completion throughput through the job interface itself
+ * rather than raw condition variables (see thread-bench2/3).  Producer
+ * threads post job_null() jobs, which allocate a job descriptor and push
+ * it straight onto the completion queue, while the main thread drains
+ * the context with job_testcontext() and releases the descriptors.  This
+ * exercises the job descriptor allocator and the completion queue
+ * wakeups from 1 up to the given number of producer threads.
+ *
+ * usage: thread-bench4 [jobs] [max threads]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "pvfs2-types.h"
+#include "gossip.h"
+#include "job.h"
+
+#define MAX_THREADS 64
+#define TEST_COUNT 64
+
+struct bench_thread
+{
+    pthread_t thread;
+    job_context_id context;
+    int jobs;
+};
+
+static double wtime(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)t.tv_usec / 1000000);
+}
+
+static void *producer_fn(void *arg)
+{
+    struct bench_thread *bt = arg;
+    job_status_s status;
+    job_id_t id;
+    int i;
+
+    for(i = 0; i < bt->jobs; i++)
+    {
+        if(job_null(0, NULL, 0, &status, &id, bt->context) != 0)
+        {
+            fprintf(stderr, "job_null() failure.\n");
+            exit(1);
+        }
+    }
+    return NULL;
+}
+
+static int run(job_context_id context, int jobs, int threads)
+{
+    struct bench_thread bt[MAX_THREADS];
+    job_id_t id_array[TEST_COUNT];
+    job_status_s status_array[TEST_COUNT];
+    double start, secs;
+    int i, ret, count, total, expected;
+
+    expected = (jobs / threads) * threads;
+    start = wtime();
+    for(i = 0; i < threads; i++)
+    {
+        bt[i].context = context;
+        bt[i].jobs = jobs / threads;
+        if(pthread_create(&bt[i].thread, NULL, producer_fn, &bt[i]))
+        {
+            return -1;
+        }
+    }
+
+    total = 0;
+    while(total < expected)
+    {
+        count = TEST_COUNT;
+        ret = job_testcontext(id_array, &count, NULL, status_array,
+                              100, context);
+        if(ret < 0)
+        {
+            fprintf(stderr, "job_testcontext() failure.\n");
+            return -1;
+        }
+        total += count;
+    }
+
+    for(i = 0; i < threads; i++)
+    {
+        pthread_join(bt[i].thread, NULL);
+    }
+    secs = wtime() - start;
+
+    printf("%2d producer threads %12.1f jobs/sec\n", threads,
+           (double)total / secs);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    job_context_id context;
+    int jobs = 1000000;
+    int max_threads = 8;
+    int threads;
+
+    if(argc > 1)
+    {
+        jobs = atoi(argv[1]);
+    }
+    if(argc > 2)
+    {
+        max_threads = atoi(argv[2]);
+    }
+    if(jobs <= 0 || max_threads <= 0 || max_threads > MAX_THREADS)
+    {
+        fprintf(stderr, "usage: %s [jobs] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    gossip_enable_stderr();
+    gossip_set_debug_mask(0, 0);
+
+    if(job_initialize(0) < 0)
+    {
+        fprintf(stderr, "job_initialize failure.\n");
+        return 1;
+    }
+    if(job_open_context(&context) < 0)
+    {
+        fprintf(stderr, "job_open_context() failure.\n");
+        return 1;
+    }
+
+    printf("%d jobs per run\n", jobs);
+    for(threads = 1; threads <= max_threads; threads *= 2)
+    {
+        if(run(context, jobs, threads) < 0)
+        {
+            return 1;
+        }
+    }
+
+    job_close_context(context);
+    job_finalize();
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,608 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Behavior tests for the striped dbpf attribute cache.  The cache has to
+ * return what was stored for every handle, stay within its memory and
+ * element limits (cached keyval data included), keep a referenced set of
+ * handles across a scan of many others, lock handles of the same stripe
+ * against each other but not against other stripes, and keep every
+ * element intact while several threads insert, update, read and remove
+ * under the stripe locks.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "trove.h"
+#include "dbpf-attr-cache.h"
+
+#define TEST_COLL_ID 9
+#define MEMORY_MB 1
+#define MEMORY_BYTES ((PVFS_size)MEMORY_MB * 1024 * 1024)
+#define ROUND_TRIP_COUNT 2000
+#define FILL_COUNT 100000
+#define MAX_ELEMS 640
+#define KEYVAL_SIZE 2048
+#define HOT_COUNT 256
+#define SCAN_COUNT 200000
+#define SCAN_TOUCH_INTERVAL 1000
+#define THREADS 8
+#define THREAD_OPS 200000
+#define THREAD_HANDLES 8192
+#define LOCK_KEYS 8
+#define LOCK_WAIT_MS 1000
+
+static char keywords[] = "dh,md";
+static int failures = 0;
+
+static void check(int cond, const char *what)
+{
+    printf("%s: %s\n", (cond ? "PASS" : "FAIL"), what);
+    if (!cond)
+    {
+        failures++;
+    }
+}
+
+static TROVE_object_ref make_ref(TROVE_handle handle)
+{
+    TROVE_object_ref ref;
+
+    ref.fs_id = TEST_COLL_ID;
+    ref.handle = handle;
+    return ref;
+}
+
+/* attributes whose fields can all be derived from value, so that a torn
+ * copy is noticed
+ */
+static void make_attr(TROVE_object_ref ref, uint32_t value,
+                      TROVE_ds_attributes *attr)
+{
+    memset(attr, 0, sizeof(*attr));
+    attr->fs_id = ref.fs_id;
+    attr->handle = ref.handle;
+    attr->type = PVFS_TYPE_DATAFILE;
+    attr->uid = value;
+    attr->gid = ~value;
+    attr->mode = value & 0777;
+    attr->ctime = (PVFS_time)value * 3;
+    attr->mtime = (PVFS_time)value * 5;
+    attr->atime = (PVFS_time)value * 7;
+    attr->u.datafile.b_size = (PVFS_size)value * 11;
+}
+
+static int attr_ok(TROVE_object_ref ref, TROVE_ds_attributes *attr)
+{
+    TROVE_ds_attributes expected;
+
+    make_attr(ref, attr->uid, &expected);
+    return (memcmp(attr, &expected, sizeof(expected)) == 0);
+}
+
+static int setup(int max_elems, int memory_mb)
+{
+    if (dbpf_attr_cache_set_keywords(keywords) != 0)
+    {
+        return -1;
+    }
+    dbpf_attr_cache_set_size(DBPF_ATTR_CACHE_DEFAULT_SIZE);
+    dbpf_attr_cache_set_max_num_elems(max_elems);
+    dbpf_attr_cache_set_memory_mb(memory_mb);
+    return dbpf_attr_cache_do_initialize();
+}
+
+static int insert(TROVE_handle handle, uint32_t value)
+{
+    TROVE_object_ref ref = make_ref(handle);
+    TROVE_ds_attributes attr;
+    int ret;
+
+    make_attr(ref, value, &attr);
+    dbpf_attr_cache_lock(ref);
+    ret = dbpf_attr_cache_insert(ref, &attr);
+    dbpf_attr_cache_unlock(ref);
+    return ret;
+}
+
+/* fetches the attributes of handle; returns 1 if cached and intact, 0 if
+ * not cached and -1 if cached but wrong
+ */
+static int fetch(TROVE_handle handle, uint32_t *value)
+{
+    TROVE_object_ref ref = make_ref(handle);
+    TROVE_ds_attributes attr;
+    int ret;
+
+    dbpf_attr_cache_lock(ref);
+    ret = dbpf_attr_cache_ds_attr_fetch_cached_data(ref, &attr);
+    dbpf_attr_cache_unlock(ref);
+    if (ret != 0)
+    {
+        return 0;
+    }
+    if (!attr_ok(ref, &attr))
+    {
+        return -1;
+    }
+    if (value)
+    {
+        *value = attr.uid;
+    }
+    return 1;
+}
+
+/* bytes the cache holds for handle, keyval data included; 0 if the
+ * handle is not cached
+ */
+static PVFS_size cached_bytes(TROVE_handle handle)
+{
+    TROVE_object_ref ref = make_ref(handle);
+    dbpf_attr_cache_elem_t *elem;
+    PVFS_size bytes = 0;
+    int i;
+
+    dbpf_attr_cache_lock(ref);
+    elem = dbpf_attr_cache_elem_lookup(ref);
+    if (elem)
+    {
+        bytes = sizeof(*elem);
+        for (i = 0; i < elem->num_keyval_pairs; i++)
+        {
+            if (elem->keyval_pairs[i].data)
+            {
+                bytes += elem->keyval_pairs[i].data_sz;
+            }
+        }
+    }
+    dbpf_attr_cache_unlock(ref);
+    return bytes;
+}
+
+static void test_round_trip(void)
+{
+    TROVE_object_ref ref;
+    TROVE_ds_attributes attr;
+    uint32_t value;
+    int i, ok = 1, updated = 1, removed = 1;
+
+    for (i = 0; i < ROUND_TRIP_COUNT; i++)
+    {
+        if (insert(i + 1, i) != 0)
+        {
+            ok = 0;
+        }
+    }
+    for (i = 0; i < ROUND_TRIP_COUNT; i++)
+    {
+        if (fetch(i + 1, &value) != 1 || value != i)
+        {
+            ok = 0;
+        }
+    }
+    check(ok, "inserted attributes read back from every stripe");
+
+    for (i = 0; i < ROUND_TRIP_COUNT; i++)
+    {
+        ref = make_ref(i + 1);
+        make_attr(ref, i + ROUND_TRIP_COUNT, &attr);
+        dbpf_attr_cache_lock(ref);
+        if (dbpf_attr_cache_ds_attr_update_cached_data(ref, &attr) != 0)
+        {
+            updated = 0;
+        }
+        dbpf_attr_cache_unlock(ref);
+        if (fetch(i + 1, &value) != 1 || value != i + ROUND_TRIP_COUNT)
+        {
+            updated = 0;
+        }
+    }
+    check(updated, "updated attributes read back");
+
+    for (i = 0; i < ROUND_TRIP_COUNT; i += 2)
+    {
+        ref = make_ref(i + 1);
+        dbpf_attr_cache_lock(ref);
+        if (dbpf_attr_cache_remove(ref) != 0)
+        {
+            removed = 0;
+        }
+        dbpf_attr_cache_unlock(ref);
+    }
+    for (i = 0; i < ROUND_TRIP_COUNT; i++)
+    {
+        if (fetch(i + 1, NULL) != (i % 2))
+        {
+            removed = 0;
+        }
+    }
+    check(removed, "removed handles gone, the others kept");
+}
+
+/* fills the cache far beyond its limits and checks what it kept */
+static void test_memory_bound(void)
+{
+    PVFS_size used = 0, bytes;
+    int i, count = 0, intact = 1;
+
+    for (i = 0; i < FILL_COUNT; i++)
+    {
+        insert(i + 1, i);
+    }
+    for (i = 0; i < FILL_COUNT; i++)
+    {
+        bytes = cached_bytes(i + 1);
+        if (bytes)
+        {
+            count++;
+            used += bytes;
+            if (fetch(i + 1, NULL) != 1)
+            {
+                intact = 0;
+            }
+        }
+    }
+    printf("%d of %d elements cached in %lld bytes\n", count, FILL_COUNT,
+           lld(used));
+    check(used <= MEMORY_BYTES, "elements stay within the memory limit");
+    check(used >= MEMORY_BYTES / 4, "most of the memory limit is used");
+    check(intact, "elements kept across evictions are intact");
+}
+
+/* cached keyval data counts against the memory limit as well */
+static void test_keyval_bound(void)
+{
+    TROVE_object_ref ref;
+    PVFS_size used = 0, bytes;
+    char *data;
+    int i, count = 0, cached = 1;
+
+    data = malloc(KEYVAL_SIZE);
+    if (!data)
+    {
+        check(0, "keyval buffer allocated");
+        return;
+    }
+    memset(data, 'k', KEYVAL_SIZE);
+
+    for (i = 0; i < FILL_COUNT / 10; i++)
+    {
+        insert(i + 1, i);
+        ref = make_ref(i + 1);
+        dbpf_attr_cache_lock(ref);
+        if (dbpf_attr_cache_elem_set_data_based_on_key(
+                ref, "dh", data, KEYVAL_SIZE) != 0)
+        {
+            cached = 0;
+        }
+        dbpf_attr_cache_unlock(ref);
+    }
+    free(data);
+    check(cached, "keyval data cached for new elements");
+
+    for (i = 0; i < FILL_COUNT / 10; i++)
+    {
+        bytes = cached_bytes(i + 1);
+        if (bytes)
+        {
+            count++;
+            used += bytes;
+        }
+    }
+    printf("%d elements with keyval data cached in %lld bytes\n", count,
+           lld(used));
+    check(used <= MEMORY_BYTES,
+          "elements and keyval data stay within the memory limit");
+}
+
+static void test_elem_bound(void)
+{
+    int i, count = 0;
+
+    for (i = 0; i < FILL_COUNT / 10; i++)
+    {
+        insert(i + 1, i);
+    }
+    for (i = 0; i < FILL_COUNT / 10; i++)
+    {
+        count += (fetch(i + 1, NULL) == 1);
+    }
+    printf("%d elements cached with a limit of %d\n", count, MAX_ELEMS);
+    check(count > 0 && count <= MAX_ELEMS,
+          "element limit holds with memory to spare");
+}
+
+/* a set of handles that is used again and again survives a single pass
+ * over many other handles
+ */
+static void test_scan_resistance(void)
+{
+    int i, j, kept = 0;
+
+    for (i = 0; i < HOT_COUNT; i++)
+    {
+        insert(i + 1, i);
+        fetch(i + 1, NULL);
+    }
+    for (i = 0; i < SCAN_COUNT; i++)
+    {
+        /* the scan looks each handle up once and caches it on a miss */
+        if (fetch(HOT_COUNT + i + 1, NULL) == 0)
+        {
+            insert(HOT_COUNT + i + 1, i);
+        }
+        if (i % SCAN_TOUCH_INTERVAL == 0)
+        {
+            for (j = 0; j < HOT_COUNT; j++)
+            {
+                fetch(j + 1, NULL);
+            }
+        }
+    }
+    for (i = 0; i < HOT_COUNT; i++)
+    {
+        kept += (fetch(i + 1, NULL) == 1);
+    }
+    printf("%d of %d hot elements kept\n", kept, HOT_COUNT);
+    check(kept == HOT_COUNT, "hot elements survive a scan");
+}
+
+struct lock_waiter
+{
+    TROVE_handle handle;
+    pthread_mutex_t mutex;
+    int locked;
+};
+
+static void *lock_waiter_fn(void *arg)
+{
+    struct lock_waiter *waiter = (struct lock_waiter *)arg;
+    TROVE_object_ref ref = make_ref(waiter->handle);
+
+    dbpf_attr_cache_lock(ref);
+    pthread_mutex_lock(&waiter->mutex);
+    waiter->locked = 1;
+    pthread_mutex_unlock(&waiter->mutex);
+    dbpf_attr_cache_unlock(ref);
+    return NULL;
+}
+
+/* whether another thread can lock handle within wait_ms while this
+ * thread holds the lock of handle 1
+ */
+static int locks_while_held(TROVE_handle handle, int wait_ms)
+{
+    TROVE_object_ref ref = make_ref(1);
+    struct lock_waiter waiter;
+    pthread_t thread;
+    int locked = 0, waited;
+
+    waiter.handle = handle;
+    waiter.locked = 0;
+    pthread_mutex_init(&waiter.mutex, NULL);
+
+    dbpf_attr_cache_lock(ref);
+    if (pthread_create(&thread, NULL, lock_waiter_fn, &waiter) != 0)
+    {
+        dbpf_attr_cache_unlock(ref);
+        return -1;
+    }
+    for (waited = 0; !locked && waited < wait_ms; waited++)
+    {
+        usleep(1000);
+        pthread_mutex_lock(&waiter.mutex);
+        locked = waiter.locked;
+        pthread_mutex_unlock(&waiter.mutex);
+    }
+    dbpf_attr_cache_unlock(ref);
+    pthread_join(thread, NULL);
+    pthread_mutex_destroy(&waiter.mutex);
+    return locked;
+}
+
+/* with one element per stripe, a handle shares the stripe of handle 1
+ * exactly if caching it evicts handle 1; such handles have to wait for
+ * the lock of handle 1, all others must not
+ */
+static void test_stripe_locks(void)
+{
+    TROVE_object_ref ref;
+    TROVE_handle handle;
+    int same = 0, other = 0, excluded = 1, independent = 1, shared;
+
+    for (handle = 2; same < LOCK_KEYS || other < LOCK_KEYS; handle++)
+    {
+        insert(1, 1);
+        insert(handle, handle);
+        shared = (fetch(1, NULL) == 0);
+        ref = make_ref(handle);
+        dbpf_attr_cache_lock(ref);
+        dbpf_attr_cache_remove(ref);
+        dbpf_attr_cache_unlock(ref);
+
+        if (shared && same < LOCK_KEYS)
+        {
+            same++;
+            if (locks_while_held(handle, LOCK_WAIT_MS / 10) != 0)
+            {
+                excluded = 0;
+            }
+        }
+        else if (!shared && other < LOCK_KEYS)
+        {
+            other++;
+            if (locks_while_held(handle, LOCK_WAIT_MS) != 1)
+            {
+                independent = 0;
+            }
+        }
+    }
+    check(excluded, "handles of the same stripe wait for its lock");
+    check(independent, "handles of other stripes do not wait");
+}
+
+struct thread_result
+{
+    int seed;
+    int corrupt;
+};
+
+static void *thread_fn(void *arg)
+{
+    struct thread_result *result = (struct thread_result *)arg;
+    unsigned int seed = result->seed;
+    TROVE_object_ref ref;
+    TROVE_ds_attributes attr;
+    dbpf_attr_cache_elem_t *elem;
+    dbpf_keyval_pair_cache_elem_t *pair;
+    char data[4096], read_back[4096];
+    int i, j, op, size, read_size;
+    uint32_t value;
+
+    for (i = 0; i < THREAD_OPS; i++)
+    {
+        ref = make_ref(rand_r(&seed) % THREAD_HANDLES + 1);
+        value = rand_r(&seed);
+        op = rand_r(&seed) % 5;
+
+        dbpf_attr_cache_lock(ref);
+        switch (op)
+        {
+        case 0:
+            make_attr(ref, value, &attr);
+            dbpf_attr_cache_insert(ref, &attr);
+            break;
+        case 1:
+            make_attr(ref, value, &attr);
+            dbpf_attr_cache_ds_attr_update_cached_data(ref, &attr);
+            break;
+        case 2:
+            if (dbpf_attr_cache_ds_attr_fetch_cached_data(ref, &attr) == 0 &&
+                !attr_ok(ref, &attr))
+            {
+                result->corrupt++;
+            }
+            break;
+        case 3:
+            /* keyval data of one repeated byte, sized from that byte */
+            size = value % sizeof(data) + 1;
+            memset(data, size & 0xff, size);
+            dbpf_attr_cache_elem_set_data_based_on_key(ref, "md", data,
+                                                       size);
+            elem = dbpf_attr_cache_elem_lookup(ref);
+            pair = dbpf_attr_cache_elem_get_data_based_on_key(elem, "md");
+            read_size = sizeof(read_back);
+            if (pair && dbpf_attr_cache_keyval_pair_fetch_cached_data(
+                    elem, pair, read_back, &read_size) == 0)
+            {
+                for (j = 0; j < read_size; j++)
+                {
+                    if ((unsigned char)read_back[j] != (read_size & 0xff))
+                    {
+                        result->corrupt++;
+                        break;
+                    }
+                }
+            }
+            break;
+        default:
+            dbpf_attr_cache_remove(ref);
+            break;
+        }
+        dbpf_attr_cache_unlock(ref);
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    pthread_t threads[THREADS];
+    struct thread_result results[THREADS];
+    int i, started, corrupt = 0, intact = 1;
+
+    for (started = 0; started < THREADS; started++)
+    {
+        results[started].seed = started + 1;
+        results[started].corrupt = 0;
+        if (pthread_create(&threads[started], NULL, thread_fn,
+                           &results[started]) != 0)
+        {
+            break;
+        }
+    }
+    check(started == THREADS, "threads started");
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+        corrupt += results[i].corrupt;
+    }
+    check(corrupt == 0, "no torn attributes or keyval data under "
+          "concurrent access");
+
+    for (i = 0; i < THREAD_HANDLES; i++)
+    {
+        if (fetch(i + 1, NULL) < 0)
+        {
+            intact = 0;
+        }
+    }
+    check(intact, "elements intact after concurrent access");
+}
+
+int main(int argc, char **argv)
+{
+    if (setup(0, MEMORY_MB) != 0)
+    {
+        fprintf(stderr, "attr cache initialize failed.\n");
+        return 1;
+    }
+    test_round_trip();
+    dbpf_attr_cache_finalize();
+
+    setup(0, MEMORY_MB);
+    test_memory_bound();
+    dbpf_attr_cache_finalize();
+
+    setup(0, MEMORY_MB);
+    test_keyval_bound();
+    dbpf_attr_cache_finalize();
+
+    setup(MAX_ELEMS, 64 * MEMORY_MB);
+    test_elem_bound();
+    dbpf_attr_cache_finalize();
+
+    setup(0, MEMORY_MB);
+    test_scan_resistance();
+    dbpf_attr_cache_finalize();
+
+    setup(DBPF_ATTR_CACHE_STRIPES, 64 * MEMORY_MB);
+    test_stripe_locks();
+    dbpf_attr_cache_finalize();
+
+    setup(0, MEMORY_MB);
+    test_threads();
+    dbpf_attr_cache_finalize();
+
+    if (failures)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all attr cache checks passed\n");
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
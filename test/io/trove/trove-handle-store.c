@@ -0,0 +1,471 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Recovery tests for the handle ledger snapshot and journal.  After a
+ * crash the last snapshot plus the synced part of its journal must give
+ * back a ledger that never hands out a handle still in use; anything
+ * unusable (a missing or torn snapshot, a journal from a newer
+ * checkpoint, changed handle ranges) must make the loader fall back to
+ * scanning the dspaces.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "trove.h"
+#include "trove-ledger.h"
+#include "trove-handle-mgmt.h"
+#include "trove-handle-store.h"
+#include "trove-test.h"
+
+#define SNAPSHOT_NAME "handle_ledger.snap"
+#define JOURNAL_NAME "handle_ledger.jnl"
+#define RANGE_STR "4-100003"
+#define TEST_COLL_ID 77
+#define USED_COUNT 1000
+#define NEW_COUNT 10
+
+static char store_dir[64];
+static char snap_path[PATH_MAX];
+static char jnl_path[PATH_MAX];
+static int failures = 0;
+
+static void check(int cond, const char *what)
+{
+    printf("%s: %s\n", (cond ? "PASS" : "FAIL"), what);
+    if (!cond)
+    {
+        failures++;
+    }
+}
+
+static int64_t count_free(struct handle_ledger *hl)
+{
+    TROVE_extent *extents = NULL;
+    int64_t count = 0, i, total = 0;
+
+    if (trove_handle_ledger_get_free_extents(hl, &extents, &count) != 0)
+    {
+        return -1;
+    }
+    for (i = 0; i < count; i++)
+    {
+        total += extents[i].last - extents[i].first + 1;
+    }
+    free(extents);
+    return total;
+}
+
+static int is_free(struct handle_ledger *hl, TROVE_handle handle)
+{
+    TROVE_extent *extents = NULL;
+    int64_t count = 0, i;
+    int found = 0;
+
+    trove_handle_ledger_get_free_extents(hl, &extents, &count);
+    for (i = 0; i < count; i++)
+    {
+        if (handle >= extents[i].first && handle <= extents[i].last)
+        {
+            found = 1;
+        }
+    }
+    free(extents);
+    return found;
+}
+
+/* a ledger over RANGE_STR with the first USED_COUNT handles in use and
+ * one of them freed again
+ */
+static struct handle_ledger *make_ledger(TROVE_handle *used)
+{
+    struct handle_ledger *hl;
+    TROVE_extent ext;
+    int i;
+
+    hl = trove_handle_ledger_init(TEST_COLL_ID, NULL);
+    if (!hl)
+    {
+        return NULL;
+    }
+    ext.first = 4;
+    ext.last = 100003;
+    trove_handle_ledger_addextent(hl, &ext);
+    for (i = 0; i < USED_COUNT; i++)
+    {
+        used[i] = trove_ledger_handle_alloc(hl);
+    }
+    trove_ledger_handle_free(hl, used[0]);
+    used[0] = TROVE_HANDLE_NULL;
+    return hl;
+}
+
+/* loads snapshot and journal into a fresh ledger, which the caller
+ * frees; *ret is the load result
+ */
+static struct handle_ledger *load_ledger(const char *range_str, int *ret,
+                                         uint32_t *generation)
+{
+    struct handle_ledger *hl;
+    uint32_t gen = 0;
+
+    hl = trove_handle_ledger_init(TEST_COLL_ID, NULL);
+    *ret = trove_handle_store_load(store_dir, range_str, hl, &gen);
+    if (generation)
+    {
+        *generation = gen;
+    }
+    return hl;
+}
+
+static int load_fresh(const char *range_str)
+{
+    struct handle_ledger *hl;
+    int ret;
+
+    hl = load_ledger(range_str, &ret, NULL);
+    trove_handle_ledger_free(hl);
+    return ret;
+}
+
+/* checkpoints hl; the journal is closed again like after a crash */
+static void checkpoint(struct handle_ledger *hl, uint32_t generation)
+{
+    int fd = -1;
+
+    if (trove_handle_store_checkpoint(store_dir, RANGE_STR, hl,
+                                      generation, &fd) != 0)
+    {
+        check(0, "checkpoint written");
+        return;
+    }
+    close(fd);
+}
+
+static void append(uint32_t generation, enum trove_handle_store_op op,
+                   const TROVE_handle *handles, int count)
+{
+    int fd;
+
+    fd = open(jnl_path, O_WRONLY | O_APPEND);
+    if (fd < 0 ||
+        trove_handle_store_append(fd, generation, op, handles, count) != 0)
+    {
+        check(0, "journal records written");
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+static void corrupt(const char *path, off_t offset, int truncate_to)
+{
+    struct stat st;
+    unsigned char c;
+    int fd;
+
+    fd = open(path, O_RDWR);
+    if (fd < 0)
+    {
+        return;
+    }
+    fstat(fd, &st);
+    if (offset < 0)
+    {
+        offset += st.st_size;
+    }
+    if (truncate_to)
+    {
+        ftruncate(fd, offset);
+    }
+    else if (pread(fd, &c, 1, offset) == 1)
+    {
+        c ^= 0x10;
+        pwrite(fd, &c, 1, offset);
+    }
+    close(fd);
+}
+
+static int read_file(const char *path, char *buf, int len)
+{
+    int fd, ret;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    ret = read(fd, buf, len);
+    close(fd);
+    return ret;
+}
+
+static void write_file(const char *path, const char *buf, int len)
+{
+    int fd;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0)
+    {
+        write(fd, buf, len);
+        close(fd);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct handle_ledger *hl, *loaded;
+    TROVE_handle used[USED_COUNT], added[NEW_COUNT], handle;
+    TROVE_handle freed, late_free = TROVE_HANDLE_NULL;
+    int64_t expected;
+    int ret, i, j, reused;
+    uint32_t generation;
+    unsigned char header[16];
+    static char old_snap[1 << 16], old_jnl[1 << 16];
+    int old_snap_len, old_jnl_len;
+
+    snprintf(store_dir, sizeof(store_dir), "/tmp/trove-handle-store.XXXXXX");
+    if (!mkdtemp(store_dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(snap_path, PATH_MAX, "%s/%s", store_dir, SNAPSHOT_NAME);
+    snprintf(jnl_path, PATH_MAX, "%s/%s", store_dir, JOURNAL_NAME);
+
+    hl = make_ledger(used);
+    if (!hl)
+    {
+        fprintf(stderr, "ledger init failed.\n");
+        return 1;
+    }
+
+    check(load_fresh(RANGE_STR) == 0, "no snapshot, scan needed");
+
+    /* crash after allocations and a free were journaled */
+    checkpoint(hl, 1);
+    for (i = 0; i < NEW_COUNT; i++)
+    {
+        added[i] = trove_ledger_handle_alloc(hl);
+    }
+    append(1, TROVE_HANDLE_STORE_ALLOC, added, NEW_COUNT);
+    freed = used[1];
+    trove_ledger_handle_free(hl, freed);
+    append(1, TROVE_HANDLE_STORE_FREE, &freed, 1);
+    expected = count_free(hl);
+
+    loaded = load_ledger(RANGE_STR, &ret, &generation);
+    check(ret == 1 && generation == 1, "snapshot and journal loaded");
+    check(count_free(loaded) == expected,
+          "journal replayed on top of the snapshot");
+    reused = 0;
+    for (i = 0; i < NEW_COUNT; i++)
+    {
+        reused |= is_free(loaded, added[i]);
+    }
+    for (i = 2; i < USED_COUNT; i++)
+    {
+        reused |= is_free(loaded, used[i]);
+    }
+    check(!reused, "handles in use stay in use after a crash");
+    check(is_free(loaded, freed), "journaled free restored");
+    trove_handle_ledger_free(loaded);
+    used[1] = TROVE_HANDLE_NULL;
+
+    /* a record torn by the crash ends the replay */
+    checkpoint(hl, 1);
+    for (i = 0; i < NEW_COUNT; i++)
+    {
+        added[i] = trove_ledger_handle_alloc(hl);
+    }
+    append(1, TROVE_HANDLE_STORE_ALLOC, added, NEW_COUNT);
+    corrupt(jnl_path, -3, 1);
+    loaded = load_ledger(RANGE_STR, &ret, NULL);
+    check(ret == 1 && is_free(loaded, added[NEW_COUNT - 1]) &&
+          !is_free(loaded, added[NEW_COUNT - 2]),
+          "torn journal tail ignored");
+    trove_handle_ledger_free(loaded);
+
+    checkpoint(hl, 1);
+    for (i = 0; i < NEW_COUNT; i++)
+    {
+        added[i] = trove_ledger_handle_alloc(hl);
+    }
+    append(1, TROVE_HANDLE_STORE_ALLOC, added, NEW_COUNT);
+    freed = used[2];
+    trove_ledger_handle_free(hl, freed);
+    append(1, TROVE_HANDLE_STORE_FREE, &freed, 1);
+    corrupt(jnl_path, -10, 0);
+    loaded = load_ledger(RANGE_STR, &ret, NULL);
+    check(ret == 1 && !is_free(loaded, added[0]) && !is_free(loaded, freed),
+          "replay stops at a damaged record");
+    trove_handle_ledger_free(loaded);
+    used[2] = TROVE_HANDLE_NULL;
+
+    /* records of another generation are not replayed */
+    checkpoint(hl, 1);
+    append(2, TROVE_HANDLE_STORE_FREE, &used[3], 1);
+    loaded = load_ledger(RANGE_STR, &ret, NULL);
+    check(ret == 1 && !is_free(loaded, used[3]),
+          "record of another generation ignored");
+    trove_handle_ledger_free(loaded);
+
+    /* crash between writing the snapshot and the new journal of a
+     * checkpoint: the old journal is contained in the new snapshot,
+     * which already has the journaled handle freed again
+     */
+    checkpoint(hl, 1);
+    handle = trove_ledger_handle_alloc(hl);
+    append(1, TROVE_HANDLE_STORE_ALLOC, &handle, 1);
+    trove_ledger_handle_free(hl, handle);
+    old_snap_len = read_file(snap_path, old_snap, sizeof(old_snap));
+    old_jnl_len = read_file(jnl_path, old_jnl, sizeof(old_jnl));
+    checkpoint(hl, 2);
+    write_file(jnl_path, old_jnl, old_jnl_len);
+    loaded = load_ledger(RANGE_STR, &ret, &generation);
+    check(ret == 1 && generation == 2 &&
+          count_free(loaded) == count_free(hl) && is_free(loaded, handle),
+          "journal older than the snapshot not replayed");
+    trove_handle_ledger_free(loaded);
+
+    /* a snapshot older than its journal lost a checkpoint */
+    checkpoint(hl, 2);
+    write_file(snap_path, old_snap, old_snap_len);
+    check(load_fresh(RANGE_STR) == 0,
+          "journal newer than the snapshot rejected");
+
+    checkpoint(hl, 3);
+    unlink(jnl_path);
+    check(load_fresh(RANGE_STR) == 0, "missing journal rejected");
+
+    /* the snapshot itself damaged */
+    checkpoint(hl, 3);
+    corrupt(snap_path, -5, 1);
+    check(load_fresh(RANGE_STR) == 0, "truncated snapshot rejected");
+
+    checkpoint(hl, 3);
+    corrupt(snap_path, -24, 1);
+    check(load_fresh(RANGE_STR) == 0,
+          "snapshot missing whole extents rejected");
+
+    checkpoint(hl, 3);
+    corrupt(snap_path, 50, 0);
+    check(load_fresh(RANGE_STR) == 0, "torn snapshot rejected");
+
+    checkpoint(hl, 3);
+    corrupt(snap_path, 0, 0);
+    check(load_fresh(RANGE_STR) == 0, "bad magic rejected");
+
+    checkpoint(hl, 3);
+    check(load_fresh("4-200003") == 0,
+          "snapshot with other handle ranges rejected");
+
+    /* the files do not depend on the host byte order */
+    checkpoint(hl, 0x01020304);
+    check(read_file(snap_path, (char *)header, sizeof(header)) ==
+          sizeof(header) && !memcmp(header, "PANSSFVP", 8) &&
+          header[12] == 0x04 && header[15] == 0x01,
+          "snapshot header stored little endian");
+    check(read_file(jnl_path, (char *)header, sizeof(header)) ==
+          sizeof(header) && !memcmp(header, "LNRJSFVP", 8),
+          "journal header stored little endian");
+
+    /* the same through the handle management layer */
+    checkpoint(hl, 1);
+    expected = count_free(hl);
+    trove_handle_ledger_free(hl);
+
+    ret = trove_handle_mgmt_initialize();
+    ret |= trove_set_handle_store(TEST_COLL_ID, store_dir);
+    ret |= trove_set_handle_ranges(TEST_COLL_ID, 0, RANGE_STR);
+    check(ret == 0, "handle ranges set from the snapshot without a scan");
+
+    reused = 0;
+    freed = TROVE_HANDLE_NULL;
+    for (i = 0; i < 2 * USED_COUNT; i++)
+    {
+        handle = trove_handle_alloc(TEST_COLL_ID);
+        for (j = 0; j < USED_COUNT; j++)
+        {
+            if (handle == TROVE_HANDLE_NULL || handle == used[j])
+            {
+                reused = 1;
+            }
+        }
+        if (i == 0)
+        {
+            freed = handle;
+        }
+        else if (i == 1)
+        {
+            late_free = handle;
+        }
+    }
+    check(!reused, "no used handle handed out after a restart");
+
+    /* a free is journaled only after the dspace sync that follows it */
+    trove_handle_free(TEST_COLL_ID, freed);
+    trove_handle_mgmt_sync(TEST_COLL_ID);
+    trove_handle_free(TEST_COLL_ID, late_free);
+    trove_handle_mgmt_synced(TEST_COLL_ID);
+    trove_handle_mgmt_sync(TEST_COLL_ID);
+
+    /* crash: no clean save */
+    trove_handle_mgmt_finalize();
+    loaded = load_ledger(RANGE_STR, &ret, NULL);
+    check(ret == 1 && count_free(loaded) == expected - 2 * USED_COUNT + 1,
+          "allocations since the restart survive a crash");
+    check(is_free(loaded, freed) && !is_free(loaded, late_free),
+          "only frees covered by a dspace sync are journaled");
+    trove_handle_ledger_free(loaded);
+
+    /* restart after the crash, then shut down cleanly */
+    ret = trove_handle_mgmt_initialize();
+    ret |= trove_set_handle_store(TEST_COLL_ID, store_dir);
+    ret |= trove_set_handle_ranges(TEST_COLL_ID, 0, RANGE_STR);
+    check(ret == 0, "restart after a crash without a scan");
+    handle = trove_handle_alloc(TEST_COLL_ID);
+    reused = (handle == TROVE_HANDLE_NULL || handle == late_free);
+    for (j = 0; j < USED_COUNT; j++)
+    {
+        reused |= (handle == used[j]);
+    }
+    check(!reused, "no used handle handed out after the crash");
+    trove_handle_mgmt_save(TEST_COLL_ID);
+    trove_handle_mgmt_finalize();
+
+    loaded = load_ledger(RANGE_STR, &ret, &generation);
+    check(ret == 1 && generation == 4 &&
+          count_free(loaded) == expected - 2 * USED_COUNT,
+          "clean shutdown checkpoints the ledger");
+    trove_handle_ledger_free(loaded);
+
+    trove_handle_store_remove(store_dir);
+    rmdir(store_dir);
+
+    if (failures)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all handle ledger snapshot checks passed\n");
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
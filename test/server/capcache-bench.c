@@ -0,0 +1,316 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Replays a realistic mix of signed capabilities against the server
+ * capability cache the way prelude_validate uses it: look the capability
+ * up, and only on a miss run the RSA verify and insert it.  The mix has
+ * metadata capabilities (one handle) and I/O capabilities (a metafile and
+ * its datafiles) from several issuing servers, requested with a Zipf-like
+ * skew so a few files are hot.  A tenth of the requests are also run
+ * with verification alone for comparison.
+ *
+ * usage: capcache-bench [capabilities] [requests] [threads] [cache MB]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "pvfs2-config.h"
+#include "pvfs2-types.h"
+#include "pvfs2-internal.h"
+#include "pint-security.h"
+
+#ifdef ENABLE_CAPCACHE
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+
+#include "capcache.h"
+
+#define NUM_ISSUERS   8
+#define MAX_THREADS   64
+
+static PVFS_capability *caps;
+static double *cdf;
+static int num_caps;
+static EVP_PKEY *key;
+
+struct bench_thread
+{
+    pthread_t thread;
+    int use_cache;
+    int requests;
+    unsigned int seed;
+    int failures;
+};
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+static EVP_PKEY *make_key(void)
+{
+    EVP_PKEY_CTX *ctx;
+    EVP_PKEY *pkey = NULL;
+
+    ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    if(!ctx || EVP_PKEY_keygen_init(ctx) <= 0 ||
+       EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) <= 0 ||
+       EVP_PKEY_keygen(ctx, &pkey) <= 0)
+    {
+        pkey = NULL;
+    }
+    EVP_PKEY_CTX_free(ctx);
+    return pkey;
+}
+
+/* signs or verifies the fields PINT_sign_capability() covers */
+static int cap_crypt(PVFS_capability *cap, int sign)
+{
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    int ret;
+
+    ret = sign ? EVP_SignInit_ex(ctx, EVP_sha1(), NULL) :
+                 EVP_VerifyInit_ex(ctx, EVP_sha1(), NULL);
+    ret &= EVP_DigestUpdate(ctx, cap->issuer, strlen(cap->issuer));
+    ret &= EVP_DigestUpdate(ctx, &cap->fsid, sizeof(PVFS_fs_id));
+    ret &= EVP_DigestUpdate(ctx, &cap->timeout, sizeof(PVFS_time));
+    ret &= EVP_DigestUpdate(ctx, &cap->op_mask, sizeof(uint32_t));
+    ret &= EVP_DigestUpdate(ctx, &cap->num_handles, sizeof(uint32_t));
+    ret &= EVP_DigestUpdate(ctx, cap->handle_array,
+                            cap->num_handles * sizeof(PVFS_handle));
+    if(ret)
+    {
+        ret = sign ? EVP_SignFinal(ctx, cap->signature, &cap->sig_size, key) :
+                     EVP_VerifyFinal(ctx, cap->signature, cap->sig_size, key);
+    }
+    EVP_MD_CTX_free(ctx);
+    return ret == 1;
+}
+
+/* 70% metadata capabilities, 30% I/O capabilities with 4-32 datafiles */
+static int make_caps(int count)
+{
+    static const uint32_t masks[] = {
+        PINT_CAP_READ | PINT_CAP_EXEC,
+        PINT_CAP_READ | PINT_CAP_WRITE | PINT_CAP_EXEC | PINT_CAP_SETATTR,
+        PINT_CAP_READ,
+        PINT_CAP_READ | PINT_CAP_WRITE | PINT_CAP_CREATE | PINT_CAP_REMOVE};
+    char issuer[32];
+    double sum = 0;
+    int i, j;
+
+    caps = calloc(count, sizeof(*caps));
+    cdf = calloc(count, sizeof(*cdf));
+    if(!caps || !cdf)
+    {
+        return -1;
+    }
+    for(i = 0; i < count; i++)
+    {
+        PVFS_capability *cap = &caps[i];
+
+        snprintf(issuer, sizeof(issuer), "S:server%d", i % NUM_ISSUERS);
+        cap->issuer = strdup(issuer);
+        cap->fsid = 1957135728;
+        cap->timeout = time(NULL) + 3600;
+        cap->op_mask = masks[i % 4];
+        cap->num_handles = (i % 10 < 7) ? 1 : 1 + (4 << (i % 4));
+        cap->handle_array = calloc(cap->num_handles, sizeof(PVFS_handle));
+        cap->signature = malloc(EVP_PKEY_size(key));
+        if(!cap->issuer || !cap->handle_array || !cap->signature)
+        {
+            return -1;
+        }
+        for(j = 0; j < cap->num_handles; j++)
+        {
+            cap->handle_array[j] = 1048576ULL * (i + 1) + j;
+        }
+        if(!cap_crypt(cap, 1))
+        {
+            return -1;
+        }
+
+        /* Zipf-like popularity, s = 1 */
+        sum += 1.0 / (i + 1);
+        cdf[i] = sum;
+    }
+    for(i = 0; i < count; i++)
+    {
+        cdf[i] /= sum;
+    }
+    return 0;
+}
+
+static int pick_cap(unsigned int *seed)
+{
+    double r = (double)rand_r(seed) / ((double)RAND_MAX + 1);
+    int lo = 0, hi = num_caps - 1, mid;
+
+    while(lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if(cdf[mid] < r)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void *bench_thread_fn(void *arg)
+{
+    struct bench_thread *bt = arg;
+    capcache_digest_t digest;
+    PVFS_capability *cap;
+    int i;
+
+    for(i = 0; i < bt->requests; i++)
+    {
+        cap = &caps[pick_cap(&bt->seed)];
+        if(bt->use_cache && PINT_capcache_lookup(cap, &digest))
+        {
+            continue;
+        }
+        if(!cap_crypt(cap, 0))
+        {
+            bt->failures++;
+            continue;
+        }
+        if(bt->use_cache)
+        {
+            PINT_capcache_insert(cap, &digest);
+        }
+    }
+    return NULL;
+}
+
+static int run(const char *label, int use_cache, int requests, int threads)
+{
+    struct bench_thread bt[MAX_THREADS];
+    double start, secs;
+    int i, failures = 0;
+
+    start = Wtime();
+    for(i = 0; i < threads; i++)
+    {
+        bt[i].use_cache = use_cache;
+        bt[i].requests = requests / threads;
+        bt[i].seed = 1234 + i;
+        bt[i].failures = 0;
+        if(pthread_create(&bt[i].thread, NULL, bench_thread_fn, &bt[i]))
+        {
+            return -1;
+        }
+    }
+    for(i = 0; i < threads; i++)
+    {
+        pthread_join(bt[i].thread, NULL);
+        failures += bt[i].failures;
+    }
+    secs = Wtime() - start;
+
+    printf("%-12s %2d threads %12.1f requests/sec%s\n", label, threads,
+           (double)(requests / threads * threads) / secs,
+           failures ? "   VERIFY FAILURES" : "");
+    return failures ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int requests = 200000;
+    int threads = 4;
+    int cache_mb = 64;
+    capcache_stats_t stats;
+
+    num_caps = 20000;
+    if(argc > 1)
+    {
+        num_caps = atoi(argv[1]);
+    }
+    if(argc > 2)
+    {
+        requests = atoi(argv[2]);
+    }
+    if(argc > 3)
+    {
+        threads = atoi(argv[3]);
+    }
+    if(argc > 4)
+    {
+        cache_mb = atoi(argv[4]);
+    }
+    if(num_caps <= 0 || requests <= 0 || threads <= 0 ||
+       threads > MAX_THREADS || cache_mb <= 0)
+    {
+        fprintf(stderr, "usage: %s [capabilities] [requests] [threads] "
+                "[cache MB]\n", argv[0]);
+        return 1;
+    }
+
+    key = make_key();
+    if(!key || make_caps(num_caps) < 0)
+    {
+        fprintf(stderr, "failed to create signed capabilities\n");
+        return 1;
+    }
+    if(PINT_capcache_init_limits(600, (PVFS_size)cache_mb * 1024 * 1024,
+                                 1) < 0)
+    {
+        fprintf(stderr, "failed to initialize capability cache\n");
+        return 1;
+    }
+
+    printf("%d capabilities, %d requests, %d MB cache\n",
+           num_caps, requests, cache_mb);
+
+    if(run("verify only", 0, requests / 10, threads) < 0 ||
+       run("cached", 1, requests, 1) < 0 ||
+       run("cached", 1, requests, threads) < 0)
+    {
+        return 1;
+    }
+
+    PINT_capcache_get_stats(&stats);
+    printf("lookups %llu  hits %llu (%.1f%%)  evictions %llu  "
+           "entries %llu  bytes %llu\n",
+           llu(stats.lookups), llu(stats.hits),
+           100.0 * stats.hits / stats.lookups, llu(stats.evictions),
+           llu(stats.entry_count), llu(stats.cache_size));
+
+    PINT_capcache_finalize();
+    return 0;
+}
+
+#else /* !ENABLE_CAPCACHE */
+
+int main(int argc, char **argv)
+{
+    fprintf(stderr, "%s: server capability cache not enabled\n", argv[0]);
+    return 1;
+}
+
+#endif /* ENABLE_CAPCACHE */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */